@@ -1,7 +1,7 @@
 /***********************************************************************
 ColorCompressionTest - Utility to experiment with methods to compress
 color frame streams.
-Copyright (c) 2010-2018 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -21,6 +21,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 02111-1307 USA
 ***********************************************************************/
 
+#include <string.h>
 #include <iostream>
 #include <IO/File.h>
 #include <IO/OpenFile.h>
@@ -31,48 +32,92 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 int main(int argc,char* argv[])
 	{
+	/* Parse the command line: */
+	Kinect::ColorFrameWriter::Codec codec=Kinect::ColorFrameWriter::DEFAULT_CODEC;
+	const char* colorFrameFileName=0;
+	const char* compressedColorFrameFileName=0;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"theora")==0)
+				codec=Kinect::ColorFrameWriter::THEORA;
+			else if(strcasecmp(argv[i]+1,"tiles")==0)
+				codec=Kinect::ColorFrameWriter::TILES;
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else if(colorFrameFileName==0)
+			colorFrameFileName=argv[i];
+		else if(compressedColorFrameFileName==0)
+			compressedColorFrameFileName=argv[i];
+		}
+	if(compressedColorFrameFileName==0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-theora | -tiles] <uncompressed color frame file name> <compressed color frame file name>"<<std::endl;
+		return 1;
+		}
+	
 	/* Open the uncompressed color stream file: */
-	IO::FilePtr colorFrameFile(IO::openFile("/work/okreylos/3DVideo/Kinect/ColorFrames.dat"));
+	IO::FilePtr colorFrameFile(IO::openFile(colorFrameFileName));
 	colorFrameFile->setEndianness(Misc::LittleEndian);
 	
 	/* Read the file header: */
 	unsigned int size[2];
 	colorFrameFile->read(size,2);
 	
-	/* Create the color frame writer and reader: */
-	IO::FilePtr compressedColorFrameFile(IO::openFile("/work/okreylos/3DVideo/Kinect/CompressedColorFrames.dat",IO::File::ReadWrite));
-	Kinect::ColorFrameWriter colorFrameWriter(*compressedColorFrameFile,size,Kinect::FrameSource::RGB);
-	compressedColorFrameFile->flush();
-	Kinect::ColorFrameReader colorFrameReader(*compressedColorFrameFile);
-	
-	/* Process all frames from the two color frame files: */
-	double totalTime=0.0;
-	double maxTime=0.0;
+	/* Compress all frames from the uncompressed color frame file: */
 	unsigned int numFrames=0;
+	size_t compressedSize=0;
+	double compressTime=0.0;
+	{
+	IO::FilePtr compressedColorFrameFile(IO::openFile(compressedColorFrameFileName,IO::File::WriteOnly));
+	compressedColorFrameFile->setEndianness(Misc::LittleEndian);
+	Kinect::ColorFrameWriter colorFrameWriter(*compressedColorFrameFile,size,Kinect::FrameSource::RGB,codec);
+	codec=colorFrameWriter.getCodec();
 	while(!colorFrameFile->eof())
 		{
 		/* Read the next uncompressed color frame: */
-		Kinect::FrameBuffer frame0(size[0],size[1],size[1]*size[0]*3*sizeof(unsigned char));
-		frame0.timeStamp=colorFrameFile->read<double>();
-		unsigned char* frameBuffer0=frame0.getData<unsigned char>();
-		colorFrameFile->read(frameBuffer0,size[1]*size[0]*3);
-	
-		/* Write the compressed color frame: */
-		colorFrameWriter.writeFrame(frame0);
-		compressedColorFrameFile->flush();
+		Kinect::FrameBuffer frame(size[0],size[1],size[1]*size[0]*3*sizeof(unsigned char));
+		frame.timeStamp=colorFrameFile->read<double>();
+		colorFrameFile->read(frame.getData<unsigned char>(),size[1]*size[0]*3);
 		
+		/* Write the compressed color frame: */
+		Misc::Timer compressTimer;
+		compressedSize+=colorFrameWriter.writeFrame(frame);
+		compressTimer.elapse();
+		compressTime+=compressTimer.getTime();
+		++numFrames;
+		}
+	}
+	
+	/* Decompress all frames from the compressed color frame file: */
+	double totalTime=0.0;
+	double maxTime=0.0;
+	{
+	IO::FilePtr compressedColorFrameFile(IO::openFile(compressedColorFrameFileName));
+	compressedColorFrameFile->setEndianness(Misc::LittleEndian);
+	Kinect::ColorFrameReader colorFrameReader(*compressedColorFrameFile);
+	colorFrameReader.setConvertToRgb(true);
+	for(unsigned int i=0;i<numFrames;++i)
+		{
 		/* Read the next compressed color frame: */
 		Misc::Timer uncompressTime;
-		Kinect::FrameBuffer frame1=colorFrameReader.readNextFrame();
+		Kinect::FrameBuffer frame=colorFrameReader.readNextFrame();
 		uncompressTime.elapse();
 		double time=uncompressTime.getTime();
 		totalTime+=time;
 		if(maxTime<time)
 			maxTime=time;
-		++numFrames;
 		}
+	}
+	
+	/* Print the results: */
+	std::cout<<"Codec: "<<(codec==Kinect::ColorFrameWriter::THEORA?"Theora":"tiles")<<", "<<numFrames<<" frames of "<<size[0]<<'x'<<size[1]<<" pixels"<<std::endl;
+	std::cout<<"Compressed size: "<<double(compressedSize)/double(numFrames)<<" bytes per frame, compression ratio "<<double(size[1]*size[0]*3)*double(numFrames)/double(compressedSize)<<std::endl;
+	std::cout<<"Compression time: "<<compressTime*1000.0/double(numFrames)<<" ms per frame"<<std::endl;
 	std::cout<<"Total decompression time: "<<totalTime*1000.0<<" ms, "<<numFrames<<" frames"<<std::endl;
-	std::cout<<"Maximum decompression time: "<<maxTime*1000.0<<" ms"<<std::endl;
+	std::cout<<"Decompression time: "<<totalTime*1000.0/double(numFrames)<<" ms per frame, maximum "<<maxTime*1000.0<<" ms"<<std::endl;
 	std::cout<<"Decompression frame rate: "<<double(numFrames)/totalTime<<" Hz"<<std::endl;
 	
 	return 0;
@@ -0,0 +1,179 @@
+/***********************************************************************
+DepthFileReadBenchmark - Utility to measure the throughput of reading
+compressed depth streams from files through standard buffered files and
+through memory-mapped files.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <Misc/SizedTypes.h>
+#include <Misc/Timer.h>
+#include <Math/Constants.h>
+#include <IO/File.h>
+#include <IO/SeekableFile.h>
+#include <IO/OpenFile.h>
+#include <Kinect/FrameSource.h>
+#include <Kinect/FrameBuffer.h>
+#include <Kinect/DepthFrameWriter.h>
+#include <Kinect/DepthFrameReader.h>
+
+void createDepthFile(const char* depthFileName,const unsigned int size[2],unsigned int numFrames) // Writes a compressed depth stream of synthetic frames showing a moving surface
+	{
+	IO::FilePtr depthFile=IO::openFile(depthFileName,IO::File::WriteOnly);
+	depthFile->setEndianness(Misc::LittleEndian);
+	Kinect::DepthFrameWriter writer(*depthFile,size);
+	for(unsigned int frameIndex=0;frameIndex<numFrames;++frameIndex)
+		{
+		Kinect::FrameBuffer frame(size[0],size[1],size[1]*size[0]*sizeof(Kinect::FrameSource::DepthPixel));
+		frame.timeStamp=double(frameIndex)/30.0;
+		Kinect::FrameSource::DepthPixel* fPtr=frame.getData<Kinect::FrameSource::DepthPixel>();
+		for(unsigned int y=0;y<size[1];++y)
+			for(unsigned int x=0;x<size[0];++x,++fPtr)
+				{
+				/* Leave a moving region invalid, and fill the rest with a wavy surface plus noise: */
+				if((x+frameIndex*4)%size[0]<size[0]/8)
+					*fPtr=Kinect::FrameSource::invalidDepth;
+				else
+					*fPtr=Kinect::FrameSource::DepthPixel(700.0+50.0*sin(double(x)*0.02+double(frameIndex)*0.1)*cos(double(y)*0.03)+double(rand()%3));
+				}
+		writer.writeFrame(frame);
+		}
+	}
+
+double readDepthFile(const char* depthFileName,size_t memMapThreshold,unsigned int& numFrames,IO::SeekableFile::Offset& fileSize) // Reads all frames from a compressed depth stream; returns elapsed time in seconds
+	{
+	/* Select the file implementation through the opener's memory-mapping threshold: */
+	size_t oldMemMapThreshold=IO::Opener::getMemMapThreshold();
+	IO::Opener::setMemMapThreshold(memMapThreshold);
+	Misc::Timer t;
+	IO::SeekableFilePtr depthFile=IO::openSeekableFile(depthFileName);
+	IO::Opener::setMemMapThreshold(oldMemMapThreshold);
+	depthFile->setEndianness(Misc::LittleEndian);
+	fileSize=depthFile->getSize();
+	
+	/* Read all frames: */
+	Kinect::DepthFrameReader reader(*depthFile);
+	numFrames=0;
+	while(reader.readNextFrame().timeStamp!=Math::Constants<double>::max)
+		++numFrames;
+	t.elapse();
+	
+	return t.getTime();
+	}
+
+double scanFile(const char* depthFileName,size_t memMapThreshold,Misc::UInt32& checksum) // Reads an entire file as a sequence of 32-bit words without decoding it; returns elapsed time in seconds
+	{
+	/* Select the file implementation through the opener's memory-mapping threshold: */
+	size_t oldMemMapThreshold=IO::Opener::getMemMapThreshold();
+	IO::Opener::setMemMapThreshold(memMapThreshold);
+	Misc::Timer t;
+	IO::SeekableFilePtr file=IO::openSeekableFile(depthFileName);
+	IO::Opener::setMemMapThreshold(oldMemMapThreshold);
+	
+	/* Read all complete words: */
+	checksum=0U;
+	for(IO::SeekableFile::Offset numWords=file->getSize()/sizeof(Misc::UInt32);numWords>0;--numWords)
+		checksum+=file->read<Misc::UInt32>();
+	t.elapse();
+	
+	return t.getTime();
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	const char* depthFileName=0;
+	unsigned int size[2]={640,480};
+	unsigned int numCreateFrames=0;
+	int numRuns=5;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"create")==0&&i+1<argc)
+				{
+				++i;
+				numCreateFrames=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"size")==0&&i+2<argc)
+				{
+				for(int j=0;j<2;++j)
+					size[j]=(unsigned int)(atoi(argv[i+1+j]));
+				i+=2;
+				}
+			else if(strcasecmp(argv[i]+1,"runs")==0&&i+1<argc)
+				{
+				++i;
+				numRuns=atoi(argv[i]);
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else if(depthFileName==0)
+			depthFileName=argv[i];
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	if(depthFileName==0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" <depth file name> [-create <number of frames>] [-size <width> <height>] [-runs <number of runs>]"<<std::endl;
+		return 1;
+		}
+	
+	/* Create a synthetic depth stream if requested: */
+	if(numCreateFrames>0)
+		{
+		std::cout<<"Creating "<<numCreateFrames<<" synthetic "<<size[0]<<'x'<<size[1]<<" depth frames in "<<depthFileName<<std::endl;
+		createDepthFile(depthFileName,size,numCreateFrames);
+		}
+	
+	/* Time the best of several runs reading through standard files and through memory-mapped files: */
+	static const char* methodNames[2]={"Standard file","Memory-mapped file"};
+	for(int method=0;method<2;++method)
+		{
+		/* Scan the raw file to measure the I/O path by itself: */
+		double bestScanTime=0.0;
+		Misc::UInt32 checksum=0U;
+		for(int run=0;run<numRuns;++run)
+			{
+			double time=scanFile(depthFileName,method==0?0:1,checksum);
+			if(run==0||bestScanTime>time)
+				bestScanTime=time;
+			}
+		
+		/* Decode all depth frames: */
+		double bestTime=0.0;
+		unsigned int numFrames=0;
+		IO::SeekableFile::Offset fileSize=0;
+		for(int run=0;run<numRuns;++run)
+			{
+			double time=readDepthFile(depthFileName,method==0?0:1,numFrames,fileSize);
+			if(run==0||bestTime>time)
+				bestTime=time;
+			}
+		std::cout<<methodNames[method]<<": raw scan "<<bestScanTime*1000.0<<" ms, "<<double(fileSize)/(bestScanTime*1024.0*1024.0)<<" MB/s (checksum "<<checksum<<")"<<std::endl;
+		std::cout<<methodNames[method]<<": "<<numFrames<<" frames in "<<bestTime*1000.0<<" ms, "<<double(numFrames)/bestTime<<" frames/s, "<<double(fileSize)/(bestTime*1024.0*1024.0)<<" MB/s"<<std::endl;
+		}
+	
+	return 0;
+	}
@@ -0,0 +1,369 @@
+/***********************************************************************
+DepthPointIndexBenchmark - Utility to compare the build and query times
+of depth point indices and kd-trees on recorded or synthetic depth
+frames, and to check that both return the same results.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <Misc/SizedTypes.h>
+#include <Misc/Timer.h>
+#include <IO/File.h>
+#include <IO/OpenFile.h>
+#include <Math/Constants.h>
+#include <Geometry/ArrayKdTree.h>
+#include <Geometry/GeometryMarshallers.h>
+#include <Kinect/FrameSource.h>
+#include <Kinect/FrameBuffer.h>
+#include <Kinect/DepthFrameReader.h>
+#include <Kinect/DepthPointIndex.h>
+
+typedef Kinect::DepthPointIndex::Scalar Scalar;
+typedef Kinect::DepthPointIndex::Point Point;
+typedef Kinect::DepthPointIndex::StoredPoint StoredPoint;
+typedef Geometry::ArrayKdTree<StoredPoint> KdTree;
+
+class SphereCollector // Functor class to collect the pixel indices of kd-tree points inside a sphere
+	{
+	/* Elements: */
+	private:
+	Point center; // Sphere's center
+	Scalar sqrRadius; // Sphere's squared radius
+	std::vector<unsigned int>& pixelIndices; // List of collected pixel indices
+	
+	/* Constructors and destructors: */
+	public:
+	SphereCollector(const Point& sCenter,Scalar sRadius,std::vector<unsigned int>& sPixelIndices)
+		:center(sCenter),sqrRadius(sRadius*sRadius),pixelIndices(sPixelIndices)
+		{
+		}
+	
+	/* Methods: */
+	void operator()(const StoredPoint& point)
+		{
+		if(Geometry::sqrDist(center,point)<=sqrRadius)
+			pixelIndices.push_back(point.value);
+		}
+	};
+
+class FrameProvider // Class delivering a sequence of recorded or synthetic depth frames to a depth point index
+	{
+	/* Elements: */
+	private:
+	IO::FilePtr depthFile; // Recorded depth file, or null for synthetic frames
+	Kinect::FrameSource::DepthCorrection* depthCorrection; // Depth correction parameters from the recorded file
+	Kinect::FrameSource::IntrinsicParameters ips; // Intrinsic parameters from the recorded file
+	Kinect::DepthFrameReader* reader; // Reader for recorded depth frames
+	unsigned int size[2]; // Frame size
+	unsigned int frameIndex; // Index of the next synthetic frame
+	std::vector<Point> gridPoints; // Organized point cloud for synthetic frames
+	bool* valid; // Validity flags for synthetic frames in the form expected by the index
+	
+	/* Constructors and destructors: */
+	public:
+	FrameProvider(const char* depthFileName,const unsigned int sSize[2])
+		:depthCorrection(0),reader(0),frameIndex(0),valid(0)
+		{
+		if(depthFileName!=0)
+			{
+			/* Read the recorded depth file's header: */
+			depthFile=IO::openFile(depthFileName);
+			depthFile->setEndianness(Misc::LittleEndian);
+			Misc::UInt32 fileFormatVersion=depthFile->read<Misc::UInt32>();
+			if(fileFormatVersion>=4)
+				{
+				depthCorrection=new Kinect::FrameSource::DepthCorrection(*depthFile);
+				if(!depthCorrection->isValid())
+					{
+					delete depthCorrection;
+					depthCorrection=0;
+					}
+				}
+			else if(fileFormatVersion>=2&&depthFile->read<Misc::UInt8>()!=0)
+				{
+				Misc::SInt32 dcSize[2];
+				depthFile->read<Misc::SInt32>(dcSize,2);
+				depthFile->skip<Misc::Float32>(dcSize[1]*dcSize[0]*2);
+				}
+			if(fileFormatVersion>=3&&depthFile->read<Misc::UInt8>()!=0)
+				throw std::runtime_error("Lossy depth files are not supported");
+			if(fileFormatVersion>=5)
+				ips.depthLensDistortion.read(*depthFile);
+			ips.depthProjection=Misc::Marshaller<Kinect::FrameSource::IntrinsicParameters::PTransform>::read(*depthFile);
+			ips.depthLensDistortion.setProjection(ips.depthProjection);
+			Misc::Marshaller<Kinect::FrameSource::ExtrinsicParameters>::read(*depthFile);
+			reader=new Kinect::DepthFrameReader(*depthFile);
+			for(int i=0;i<2;++i)
+				size[i]=reader->getSize()[i];
+			}
+		else
+			{
+			for(int i=0;i<2;++i)
+				size[i]=sSize[i];
+			gridPoints.resize(size_t(size[1])*size_t(size[0]));
+			valid=new bool[size_t(size[1])*size_t(size[0])];
+			}
+		}
+	~FrameProvider(void)
+		{
+		delete reader;
+		delete depthCorrection;
+		delete[] valid;
+		}
+	
+	/* Methods: */
+	const unsigned int* getSize(void) const
+		{
+		return size;
+		}
+	Kinect::DepthPointIndex* createIndex(void) const // Creates a depth point index for this provider's frames
+		{
+		if(reader!=0)
+			return new Kinect::DepthPointIndex(size,depthCorrection,ips);
+		else
+			return new Kinect::DepthPointIndex(size);
+		}
+	bool nextFrame(Kinect::DepthPointIndex& index,double& buildTime) // Indexes the next frame; returns false at the end of the sequence
+		{
+		if(reader!=0)
+			{
+			Kinect::FrameBuffer frame=reader->readNextFrame();
+			if(frame.timeStamp==Math::Constants<double>::max)
+				return false;
+			Misc::Timer t;
+			index.setFrame(frame);
+			t.elapse();
+			buildTime=t.getTime();
+			}
+		else
+			{
+			/* Create a wavy surface seen through a pinhole camera in centimeters, with a moving invalid region: */
+			Point* gpPtr=&gridPoints[0];
+			bool* vPtr=valid;
+			Scalar f=Scalar(size[0])*Scalar(0.9);
+			for(unsigned int y=0;y<size[1];++y)
+				for(unsigned int x=0;x<size[0];++x,++gpPtr,++vPtr)
+					{
+					*vPtr=(x+frameIndex*4)%size[0]>=size[0]/8;
+					Scalar z=Scalar(70.0+5.0*sin(double(x)*0.02+double(frameIndex)*0.1)*cos(double(y)*0.03)+double(rand()%3)*0.1);
+					(*gpPtr)[0]=(Scalar(x)+Scalar(0.5)-Scalar(size[0])*Scalar(0.5))*z/f;
+					(*gpPtr)[1]=(Scalar(y)+Scalar(0.5)-Scalar(size[1])*Scalar(0.5))*z/f;
+					(*gpPtr)[2]=-z;
+					}
+			++frameIndex;
+			Misc::Timer t;
+			index.setPoints(&gridPoints[0],valid);
+			t.elapse();
+			buildTime=t.getTime();
+			}
+		
+		return true;
+		}
+	};
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	const char* depthFileName=0;
+	unsigned int size[2]={640,480};
+	unsigned int numFrames=10;
+	unsigned int numQueries=10000;
+	unsigned int numNeighbors=1;
+	Scalar radius(1);
+	int numThreads=1;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"size")==0&&i+2<argc)
+				{
+				for(int j=0;j<2;++j)
+					size[j]=(unsigned int)(atoi(argv[i+1+j]));
+				i+=2;
+				}
+			else if(strcasecmp(argv[i]+1,"frames")==0&&i+1<argc)
+				{
+				++i;
+				numFrames=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"queries")==0&&i+1<argc)
+				{
+				++i;
+				numQueries=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"k")==0&&i+1<argc)
+				{
+				++i;
+				numNeighbors=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"radius")==0&&i+1<argc)
+				{
+				++i;
+				radius=Scalar(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"threads")==0&&i+1<argc)
+				{
+				++i;
+				numThreads=atoi(argv[i]);
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else if(depthFileName==0)
+			depthFileName=argv[i];
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	if(numNeighbors<1)
+		numNeighbors=1;
+	
+	/* Open the frame sequence: */
+	FrameProvider frames(depthFileName,size);
+	Kinect::DepthPointIndex* index=frames.createIndex();
+	if(depthFileName!=0)
+		std::cout<<"Indexing up to "<<numFrames<<" "<<frames.getSize()[0]<<'x'<<frames.getSize()[1]<<" depth frames from "<<depthFileName<<std::endl;
+	else
+		std::cout<<"Indexing "<<numFrames<<" synthetic "<<frames.getSize()[0]<<'x'<<frames.getSize()[1]<<" point clouds"<<std::endl;
+	std::cout<<numQueries<<" queries per frame, "<<numNeighbors<<" closest points, radius "<<radius<<", "<<numThreads<<" thread(s)"<<std::endl;
+	
+	/* Process all frames, querying each frame with points taken from the previous frame: */
+	double totalTimes[2][3]={{0.0,0.0,0.0},{0.0,0.0,0.0}}; // Build, closest-point, and radius query times for index and kd-tree
+	size_t numMismatches=0;
+	size_t numResults=0;
+	std::vector<Point> queryPoints;
+	std::vector<unsigned int> indexPixels(size_t(numQueries)*numNeighbors);
+	std::vector<Scalar> indexDists(size_t(numQueries)*numNeighbors);
+	std::vector<Scalar> treeDists(size_t(numQueries)*numNeighbors);
+	std::vector<unsigned int> offsets,indexSpherePixels;
+	KdTree::ClosePointSet closestPoints(numNeighbors);
+	unsigned int frameIndex;
+	for(frameIndex=0;frameIndex<numFrames;++frameIndex)
+		{
+		/* Index the next frame with the depth point index: */
+		double buildTime;
+		if(!frames.nextFrame(*index,buildTime))
+			break;
+		totalTimes[0][0]+=buildTime;
+		if(index->getNumPoints()==0)
+			continue;
+		
+		/* Index the same points with a kd-tree: */
+		KdTree tree;
+		{
+		Misc::Timer t;
+		tree.setPoints(index->getNumPoints(),index->getPoints(),numThreads);
+		t.elapse();
+		totalTimes[1][0]+=t.getTime();
+		}
+		
+		/* Pick query points from the previous frame, or from this frame initially: */
+		if(queryPoints.empty())
+			{
+			for(unsigned int i=0;i<numQueries;++i)
+				queryPoints.push_back(index->getPoints()[rand()%index->getNumPoints()]);
+			}
+		
+		/* Run closest-point queries on both structures: */
+		{
+		Misc::Timer t;
+		index->findClosestPoints(numQueries,&queryPoints[0],numNeighbors,Math::Constants<Scalar>::max,&indexPixels[0],&indexDists[0],numThreads);
+		t.elapse();
+		totalTimes[0][1]+=t.getTime();
+		}
+		{
+		Misc::Timer t;
+		Scalar* tdPtr=&treeDists[0];
+		for(unsigned int i=0;i<numQueries;++i)
+			{
+			closestPoints.clear();
+			tree.findClosestPoints(queryPoints[i],closestPoints);
+			for(unsigned int j=0;j<numNeighbors;++j,++tdPtr)
+				*tdPtr=int(j)<closestPoints.getNumPoints()?closestPoints.getSqrDist(j):Math::Constants<Scalar>::max;
+			}
+		t.elapse();
+		totalTimes[1][1]+=t.getTime();
+		}
+		for(size_t i=0;i<indexDists.size();++i)
+			if(indexDists[i]!=treeDists[i])
+				++numMismatches;
+		
+		/* Run radius queries on both structures: */
+		{
+		Misc::Timer t;
+		index->findPointsInSpheres(numQueries,&queryPoints[0],radius,offsets,indexSpherePixels,numThreads);
+		t.elapse();
+		totalTimes[0][2]+=t.getTime();
+		}
+		std::vector<unsigned int> treeOffsets,treeSpherePixels;
+		{
+		Misc::Timer t;
+		treeOffsets.push_back(0U);
+		for(unsigned int i=0;i<numQueries;++i)
+			{
+			/* The kd-tree has no radius query, so traverse the sphere's bounding box: */
+			SphereCollector sc(queryPoints[i],radius,treeSpherePixels);
+			tree.traverseTreeInBox(KdTree::Box(queryPoints[i]-KdTree::Box::Vector(radius),queryPoints[i]+KdTree::Box::Vector(radius)),sc);
+			treeOffsets.push_back((unsigned int)(treeSpherePixels.size()));
+			}
+		t.elapse();
+		totalTimes[1][2]+=t.getTime();
+		}
+		numResults+=indexSpherePixels.size();
+		
+		/* Compare the radius query results: */
+		for(unsigned int i=0;i<numQueries;++i)
+			{
+			std::vector<unsigned int> indexResult(indexSpherePixels.begin()+offsets[i],indexSpherePixels.begin()+offsets[i+1]);
+			std::vector<unsigned int> treeResult(treeSpherePixels.begin()+treeOffsets[i],treeSpherePixels.begin()+treeOffsets[i+1]);
+			std::sort(indexResult.begin(),indexResult.end());
+			std::sort(treeResult.begin(),treeResult.end());
+			if(indexResult!=treeResult)
+				++numMismatches;
+			}
+		
+		/* Use a subset of this frame's points as queries for the next frame: */
+		queryPoints.clear();
+		for(unsigned int i=0;i<numQueries;++i)
+			queryPoints.push_back(index->getPoints()[rand()%index->getNumPoints()]);
+		}
+	delete index;
+	
+	/* Print the results: */
+	if(frameIndex==0)
+		{
+		std::cerr<<"No frames indexed"<<std::endl;
+		return 1;
+		}
+	static const char* methodNames[2]={"Depth point index","Kd-tree"};
+	for(int method=0;method<2;++method)
+		{
+		std::cout<<methodNames[method]<<": build "<<totalTimes[method][0]*1000.0/double(frameIndex)<<" ms/frame";
+		std::cout<<", closest points "<<totalTimes[method][1]*1.0e6/(double(frameIndex)*double(numQueries))<<" us/query";
+		std::cout<<", radius "<<totalTimes[method][2]*1.0e6/(double(frameIndex)*double(numQueries))<<" us/query"<<std::endl;
+		}
+	std::cout<<double(numResults)/(double(frameIndex)*double(numQueries))<<" points per radius query, "<<numMismatches<<" mismatched results"<<std::endl;
+	
+	return numMismatches==0?0:1;
+	}
@@ -1,7 +1,7 @@
 /***********************************************************************
 Camera - Wrapper class to represent the color and depth camera interface
 aspects of the Kinect sensor.
-Copyright (c) 2010-2018 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -45,7 +45,9 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <GLMotif/ToggleButton.h>
 #include <GLMotif/TextFieldSlider.h>
 #include <Kinect/Internal/Config.h>
+#include <Kinect/Internal/KinectV1FrameDecoder.h>
 #include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameBufferPool.h>
 
 #define KINECT_CAMERA_DUMP_INIT 0
 
@@ -429,29 +431,6 @@ void Camera::writeRegister(Camera::USBWord address,Camera::USBWord value)
 		Misc::throwStdErr("Kinect::Camera::writeRegister: Protocol error");
 	}
 
-namespace {
-
-/***********************************
-Helper functions for Bayer decoding:
-***********************************/
-
-inline FrameSource::ColorComponent avg(FrameSource::ColorComponent v1,FrameSource::ColorComponent v2)
-	{
-	return FrameSource::ColorComponent(((unsigned int)(v1)+(unsigned int)(v2)+1U)>>1);
-	}
-
-inline FrameSource::ColorComponent avg(FrameSource::ColorComponent v1,FrameSource::ColorComponent v2,FrameSource::ColorComponent v3)
-	{
-	return FrameSource::ColorComponent(((unsigned int)(v1)+(unsigned int)(v2)+(unsigned int)(v3)+1U)/3U);
-	}
-
-inline FrameSource::ColorComponent avg(FrameSource::ColorComponent v1,FrameSource::ColorComponent v2,FrameSource::ColorComponent v3,FrameSource::ColorComponent v4)
-	{
-	return FrameSource::ColorComponent(((unsigned int)(v1)+(unsigned int)(v2)+(unsigned int)(v3)+(unsigned int)(v4)+2U)>>2);
-	}
-
-}
-
 void* Camera::colorDecodingThreadMethod(void)
 	{
 	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
@@ -476,154 +455,11 @@ void* Camera::colorDecodingThreadMethod(void)
 		/* Allocate a new decoded color buffer: */
 		int width=streamers[COLOR]->frameSize[0];
 		int height=streamers[COLOR]->frameSize[1];
-		FrameBuffer decodedFrame(width,height,width*height*sizeof(ColorPixel));
+		FrameBuffer decodedFrame=FrameBufferPool::getDefaultPool().allocate(width,height,width*height*sizeof(ColorPixel));
 		decodedFrame.timeStamp=frameTimeStamp;
 		
 		/* Decode the raw color buffer (which is in Bayer GRBG pattern): */
-		int stride=width;
-		const ColorComponent* rRowPtr=framePtr;
-		ColorComponent* cRowPtr=decodedFrame.getData<ColorComponent>();
-		cRowPtr+=(height-1)*stride*3; // Flip the color image vertically
-		
-		/* Convert the first row: */
-		const ColorComponent* rPtr=rRowPtr;
-		ColorComponent* cPtr=cRowPtr;
-		
-		/* Convert the first row's first (G) pixel: */
-		*(cPtr++)=rPtr[1];
-		*(cPtr++)=rPtr[0];
-		*(cPtr++)=rPtr[stride];
-		++rPtr;
-		
-		/* Convert the first row's central pixels: */
-		for(int x=1;x<width-1;x+=2)
-			{
-			/* Convert the odd (R) pixel: */
-			*(cPtr++)=rPtr[0];
-			*(cPtr++)=avg(rPtr[-1],rPtr[1],rPtr[stride]);
-			*(cPtr++)=avg(rPtr[stride-1],rPtr[stride+1]);
-			++rPtr;
-			
-			/* Convert the even (G) pixel: */
-			*(cPtr++)=avg(rPtr[-1],rPtr[1]);
-			*(cPtr++)=rPtr[0];
-			*(cPtr++)=rPtr[stride];
-			++rPtr;
-			}
-		
-		/* Convert the first row's last (R) pixel: */
-		*(cPtr++)=rPtr[0];
-		*(cPtr++)=avg(rPtr[-1],rPtr[stride]);
-		*(cPtr++)=rPtr[stride-1];
-		++rPtr;
-		
-		rRowPtr+=stride;
-		cRowPtr-=stride*3;
-		
-		/* Convert the central rows: */
-		for(int y=1;y<height-1;y+=2)
-			{
-			/* Convert the odd row: */
-			rPtr=rRowPtr;
-			cPtr=cRowPtr;
-			
-			/* Convert the odd row's first (B) pixel: */
-			*(cPtr++)=avg(rPtr[-stride+1],rPtr[stride+1]);
-			*(cPtr++)=avg(rPtr[-stride],rPtr[1],rPtr[stride]);
-			*(cPtr++)=rPtr[0];
-			++rPtr;
-			
-			/* Convert the odd row's central pixels: */
-			for(int x=1;x<width-1;x+=2)
-				{
-				/* Convert the odd (G) pixel: */
-				*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
-				*(cPtr++)=rPtr[0];
-				*(cPtr++)=avg(rPtr[-1],rPtr[1]);
-				++rPtr;
-				
-				/* Convert the even (B) pixel: */
-				*(cPtr++)=avg(rPtr[-stride-1],rPtr[-stride+1],rPtr[stride-1],rPtr[stride+1]);
-				*(cPtr++)=avg(rPtr[-stride],rPtr[-1],rPtr[1],rPtr[stride]);
-				*(cPtr++)=rPtr[0];
-				++rPtr;
-				}
-			
-			/* Convert the odd row's last (G) pixel: */
-			*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
-			*(cPtr++)=rPtr[0];
-			*(cPtr++)=rPtr[-1];
-			++rPtr;
-			
-			rRowPtr+=stride;
-			cRowPtr-=stride*3;
-			
-			/* Convert the even row: */
-			rPtr=rRowPtr;
-			cPtr=cRowPtr;
-			
-			/* Convert the even row's first (G) pixel: */
-			*(cPtr++)=rPtr[1];
-			*(cPtr++)=rPtr[0];
-			*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
-			++rPtr;
-			
-			/* Convert the even row's central pixels: */
-			for(int x=1;x<width-1;x+=2)
-				{
-				/* Convert the odd (R) pixel: */
-				*(cPtr++)=rPtr[0];
-				*(cPtr++)=avg(rPtr[-stride],rPtr[-1],rPtr[1],rPtr[stride]);
-				*(cPtr++)=avg(rPtr[-stride-1],rPtr[-stride+1],rPtr[stride-1],rPtr[stride+1]);
-				++rPtr;
-				
-				/* Convert the even (G) pixel: */
-				*(cPtr++)=avg(rPtr[-1],rPtr[1]);
-				*(cPtr++)=rPtr[0];
-				*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
-				++rPtr;
-				}
-			
-			/* Convert the even row's last (R) pixel: */
-			*(cPtr++)=rPtr[0];
-			*(cPtr++)=avg(rPtr[-stride],rPtr[-1],rPtr[stride]);
-			*(cPtr++)=avg(rPtr[-stride-1],rPtr[stride-1]);
-			++rPtr;
-			
-			rRowPtr+=stride;
-			cRowPtr-=stride*3;
-			}
-		
-		/* Convert the last row: */
-		rPtr=rRowPtr;
-		cPtr=cRowPtr;
-		
-		/* Convert the last row's first (B) pixel: */
-		*(cPtr++)=rPtr[-stride+1];
-		*(cPtr++)=avg(rPtr[-stride],rPtr[1]);
-		*(cPtr++)=rPtr[0];
-		++rPtr;
-		
-		/* Convert the last row's central pixels: */
-		for(int x=1;x<width-1;x+=2)
-			{
-			/* Convert the odd (G) pixel: */
-			*(cPtr++)=rPtr[-stride];
-			*(cPtr++)=rPtr[0];
-			*(cPtr++)=avg(rPtr[-1],rPtr[1]);
-			++rPtr;
-			
-			/* Convert the even (B) pixel: */
-			*(cPtr++)=avg(rPtr[-stride-1],rPtr[-stride+1]);
-			*(cPtr++)=avg(rPtr[-stride],rPtr[-1],rPtr[1]);
-			*(cPtr++)=rPtr[0];
-			++rPtr;
-			}
-		
-		/* Convert the last row's last (G) pixel: */
-		*(cPtr++)=rPtr[-stride];
-		*(cPtr++)=rPtr[0];
-		*(cPtr++)=rPtr[-1];
+		decodeBayerFrame(framePtr,width,height,decodedFrame.getData<ColorComponent>());
 		
 		/* Pass the decoded color buffer to the streaming callback function: */
 		(*streamers[COLOR]->streamingCallback)(decodedFrame);
@@ -658,33 +494,11 @@ void* Camera::depthDecodingThreadMethod(void)
 		/* Allocate a new decoded depth buffer: */
 		int width=streamers[DEPTH]->frameSize[0];
 		int height=streamers[DEPTH]->frameSize[1];
-		FrameBuffer decodedFrame(width,height,width*height*sizeof(DepthPixel));
+		FrameBuffer decodedFrame=FrameBufferPool::getDefaultPool().allocate(width,height,width*height*sizeof(DepthPixel));
 		decodedFrame.timeStamp=frameTimeStamp;
 		
 		/* Decode the raw depth buffer: */
-		Byte* sPtr=framePtr;
-		DepthPixel* dRowPtr=decodedFrame.getData<DepthPixel>();
-		dRowPtr+=width*(height-1);
-		
-		/* Process rows: */
-		for(int y=0;y<height;++y,dRowPtr-=width) // Flip the depth image vertically
-			{
-			DepthPixel* dPtr=dRowPtr;
-			
-			/* Process pixels in groups of eight: */
-			for(int x=0;x<width;x+=8,sPtr+=11,dPtr+=8)
-				{
-				/* Convert a run of 11 8-bit bytes into 8 11-bit pixels: */
-				dPtr[0]=(DepthPixel(sPtr[0])<<3)|(DepthPixel(sPtr[1])>>5);
-				dPtr[1]=((DepthPixel(sPtr[1])&0x1fU)<<6)|(DepthPixel(sPtr[2])>>2);
-				dPtr[2]=((DepthPixel(sPtr[2])&0x03U)<<9)|(DepthPixel(sPtr[3])<<1)|(DepthPixel(sPtr[4])>>7);
-				dPtr[3]=((DepthPixel(sPtr[4])&0x7fU)<<4)|(DepthPixel(sPtr[5])>>4);
-				dPtr[4]=((DepthPixel(sPtr[5])&0x0fU)<<7)|(DepthPixel(sPtr[6])>>1);
-				dPtr[5]=((DepthPixel(sPtr[6])&0x01U)<<10)|(DepthPixel(sPtr[7])<<2)|(DepthPixel(sPtr[8])>>6);
-				dPtr[6]=((DepthPixel(sPtr[8])&0x3fU)<<5)|(DepthPixel(sPtr[9])>>3);
-				dPtr[7]=((DepthPixel(sPtr[9])&0x07U)<<8)|DepthPixel(sPtr[10]);
-				}
-			}
+		unpackDepthFrame(framePtr,width,height,decodedFrame.getData<DepthPixel>());
 		
 		/* Handle background capture and removal: */
 		processDepthFrameBackground(decodedFrame);
@@ -750,7 +564,7 @@ void* Camera::compressedDepthDecodingThreadMethod(void)
 		/* Allocate a new decoded depth buffer: */
 		int width=streamers[DEPTH]->frameSize[0];
 		int height=streamers[DEPTH]->frameSize[1];
-		FrameBuffer decodedFrame(width,height,width*height*sizeof(DepthPixel));
+		FrameBuffer decodedFrame=FrameBufferPool::getDefaultPool().allocate(width,height,width*height*sizeof(DepthPixel));
 		decodedFrame.timeStamp=frameTimeStamp;
 		
 		/* Decode the raw depth buffer: */
@@ -38,6 +38,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <GLMotif/RowColumn.h>
 #include <GLMotif/Label.h>
 #include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameBufferPool.h>
 #include <Kinect/Internal/LibRealSenseContext.h>
 
 // DEBUGGING
@@ -183,7 +184,7 @@ void* CameraRealSense::streamingThreadMethod(void)
 				handleStreamingError(error);
 				
 				/* Allocate a frame buffer and quantize and flip the depth frame: */
-				FrameBuffer depthFrame(frameSizes[1][0],frameSizes[1][1],frameSizes[1][1]*frameSizes[1][0]*sizeof(FrameSource::DepthPixel));
+				FrameBuffer depthFrame=FrameBufferPool::getDefaultPool().allocate(frameSizes[1][0],frameSizes[1][1],frameSizes[1][1]*frameSizes[1][0]*sizeof(FrameSource::DepthPixel));
 				depthFrame.timeStamp=timeStamp;
 				FrameSource::DepthPixel* dPtr=depthFrame.getData<FrameSource::DepthPixel>();
 				for(unsigned int y=0;y<frameSizes[1][1];++y,sRowPtr-=frameSizes[1][0])
@@ -213,7 +214,7 @@ void* CameraRealSense::streamingThreadMethod(void)
 				handleStreamingError(error);
 				
 				/* Allocate a frame buffer and flip the color frame: */
-				FrameBuffer colorFrame(frameSizes[0][0],frameSizes[0][1],frameSizes[0][1]*frameSizes[0][0]*sizeof(FrameSource::ColorPixel));
+				FrameBuffer colorFrame=FrameBufferPool::getDefaultPool().allocate(frameSizes[0][0],frameSizes[0][1],frameSizes[0][1]*frameSizes[0][0]*sizeof(FrameSource::ColorPixel));
 				colorFrame.timeStamp=timeStamp;
 				FrameSource::ColorPixel* dRowPtr=colorFrame.getData<FrameSource::ColorPixel>();
 				for(unsigned int y=0;y<frameSizes[0][1];++y,sRowPtr-=frameSizes[0][0],dRowPtr+=frameSizes[0][0])
@@ -25,6 +25,8 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <libusb-1.0/libusb.h>
 #include <Misc/ThrowStdErr.h>
 #include <Misc/MessageLogger.h>
+#include <Misc/StandardValueCoders.h>
+#include <Misc/ConfigurationFile.h>
 #include <IO/File.h>
 #include <IO/Directory.h>
 #include <USB/DeviceList.h>
@@ -329,6 +331,18 @@ std::string CameraV2::getSerialNumber(void)
 	return serialNumber;
 	}
 
+void CameraV2::configure(Misc::ConfigurationFileSection& configFileSection)
+	{
+	/* Call the base class method: */
+	DirectFrameSource::configure(configFileSection);
+	
+	/* Select the color frame decompression scale: */
+	setColorDecodeScale(configFileSection.retrieveValue<unsigned int>("./colorDecodeScale",colorStreamReader->getDecodeScale()));
+	
+	/* Select the number of color frame decompression threads: */
+	setNumColorDecodeThreads(configFileSection.retrieveValue<unsigned int>("./numColorDecodeThreads",colorStreamReader->getNumDecoders()));
+	}
+
 void CameraV2::forceRgb(void)
 	{
 	/* Set the JPEG stream reader to RGB mode: */
@@ -338,4 +352,25 @@ void CameraV2::forceRgb(void)
 	colorSpace=RGB;
 	}
 
+void CameraV2::setColorDecodeScale(unsigned int newColorDecodeScale)
+	{
+	/* Set the JPEG stream reader's decompression scale: */
+	colorStreamReader->setDecodeScale(newColorDecodeScale);
+	
+	/* Update the color frame size: */
+	frameSizes[0][0]=(1920+newColorDecodeScale-1)/newColorDecodeScale;
+	frameSizes[0][1]=(1080+newColorDecodeScale-1)/newColorDecodeScale;
+	}
+
+void CameraV2::setNumColorDecodeThreads(unsigned int newNumColorDecodeThreads)
+	{
+	colorStreamReader->setNumDecoders(newNumColorDecodeThreads);
+	}
+
+void CameraV2::setRawDepthCaptureFile(IO::FilePtr newRawDepthCaptureFile)
+	{
+	/* Forward the capture file to the depth stream reader: */
+	depthStreamReader->setRawCaptureFile(newRawDepthCaptureFile);
+	}
+
 }
@@ -24,6 +24,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #define KINECT_CAMERAV2_INCLUDED
 
 #include <stddef.h>
+#include <IO/File.h>
 #include <USB/Device.h>
 #include <Kinect/DirectFrameSource.h>
 
@@ -75,9 +76,17 @@ class CameraV2:public DirectFrameSource
 	
 	/* Methods from DirectFrameSource: */
 	virtual std::string getSerialNumber(void);
+	virtual void configure(Misc::ConfigurationFileSection& configFileSection);
 	
 	/* New methods: */
 	void forceRgb(void); // Forces the camera into RGB color mode
+	void setColorDecodeScale(unsigned int newColorDecodeScale); // Delivers color frames at 1/newColorDecodeScale of their full size; must be 1, 2, 4, or 8; must not be called while streaming
+	void setNumColorDecodeThreads(unsigned int newNumColorDecodeThreads); // Sets the number of threads decompressing color frames in parallel; uses up to three of the host's CPUs if zero; must not be called while streaming
+	KinectV2JpegStreamReader& getColorStreamReader(void) // Returns the color stream reader, e.g., to query its decompression statistics
+		{
+		return *colorStreamReader;
+		}
+	void setRawDepthCaptureFile(IO::FilePtr newRawDepthCaptureFile); // Captures the depth calibration and all raw range-gated IR images received while streaming into the given file; must not be called while streaming
 	};
 
 }
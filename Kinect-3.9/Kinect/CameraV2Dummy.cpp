@@ -92,4 +92,20 @@ std::string CameraV2::getSerialNumber(void)
 	return std::string();
 	}
 
+void CameraV2::configure(Misc::ConfigurationFileSection& configFileSection)
+	{
+	}
+
+void CameraV2::setColorDecodeScale(unsigned int newColorDecodeScale)
+	{
+	}
+
+void CameraV2::setNumColorDecodeThreads(unsigned int newNumColorDecodeThreads)
+	{
+	}
+
+void CameraV2::setRawDepthCaptureFile(IO::FilePtr newRawDepthCaptureFile)
+	{
+	}
+
 }
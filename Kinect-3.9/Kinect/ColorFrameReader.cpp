@@ -27,14 +27,16 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Math/Constants.h>
 #include <Video/Config.h>
 #if VIDEO_CONFIG_HAVE_THEORA
-#include <Video/Colorspaces.h>
 #include <Video/TheoraFrame.h>
 #include <Video/TheoraInfo.h>
 #include <Video/TheoraComment.h>
 #include <Video/TheoraPacket.h>
 #endif
 #include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameBufferPool.h>
 #include <Kinect/FrameSource.h>
+#include <Kinect/Internal/YpCbCr420Conversion.h>
+#include <Kinect/Internal/ColorTileCodec.h>
 
 namespace Kinect {
 
@@ -45,6 +47,7 @@ Methods of class ColorFrameReader:
 ColorFrameReader::ColorFrameReader(IO::File& sSource)
 	:source(sSource),
 	 sourceHasTheora(false),
+	 tileCodec(0),
 	 convertToRgb(false)
 	{
 	/* Read the frame size from the source: */
@@ -53,6 +56,12 @@ ColorFrameReader::ColorFrameReader(IO::File& sSource)
 	
 	/* Read the stream header's size: */
 	size_t streamHeaderSize=source.read<Misc::UInt32>();
+	if(streamHeaderSize==ColorTileCodec::streamTag)
+		{
+		/* Create a decoder for the tile-compressed stream: */
+		tileCodec=ColorTileCodec::readHeader(source,size);
+		streamHeaderSize=0;
+		}
 	sourceHasTheora=streamHeaderSize>0;
 	
 	if(sourceHasTheora)
@@ -88,12 +97,13 @@ ColorFrameReader::ColorFrameReader(IO::File& sSource)
 
 ColorFrameReader::~ColorFrameReader(void)
 	{
+	delete tileCodec;
 	}
 
 FrameBuffer ColorFrameReader::readNextFrame(void)
 	{
 	/* Create the result frame: */
-	FrameBuffer result(size[0],size[1],size[1]*size[0]*sizeof(FrameSource::ColorPixel));
+	FrameBuffer result=FrameBufferPool::getDefaultPool().allocate(size[0],size[1],size[1]*size[0]*sizeof(FrameSource::ColorPixel));
 	
 	/* Return a dummy frame if the file is over: */
 	if(source.eof())
@@ -105,7 +115,12 @@ FrameBuffer ColorFrameReader::readNextFrame(void)
 	/* Read the frame's time stamp from the source: */
 	result.timeStamp=source.read<Misc::Float64>();
 	
-	if(sourceHasTheora)
+	if(tileCodec!=0)
+		{
+		/* Decompress the next frame directly into the result frame: */
+		tileCodec->decodeFrame(source,convertToRgb?FrameSource::RGB:FrameSource::YPCBCR,result.getData<FrameSource::ColorPixel>());
+		}
+	else if(sourceHasTheora)
 		{
 		#if VIDEO_CONFIG_HAVE_THEORA
 		
@@ -122,97 +137,16 @@ FrameBuffer ColorFrameReader::readNextFrame(void)
 		Video::TheoraFrame theoraFrame;
 		theoraDecoder.decodeFrame(theoraFrame);
 		
-		/* Convert the frame to RGB color space if requested: */
+		/* Convert the decompressed frame from Y'CbCr 4:2:0 to RGB or Y'CbCr 4:4:4, flipping it vertically: */
+		const Misc::UInt8* planes[3];
+		for(int i=0;i<3;++i)
+			planes[i]=static_cast<const Misc::UInt8*>(theoraFrame.planes[i].data)+theoraFrame.offsets[i];
+		FrameSource::ColorPixel* resultPtr=result.getData<FrameSource::ColorPixel>()+(size[1]-1)*size[0];
+		ptrdiff_t resultStride=-ptrdiff_t(size[0]);
 		if(convertToRgb)
-			{
-			/* Convert the decompressed frame from Y'CbCr 4:2:0 to RGB: */
-			FrameSource::ColorPixel* resultRowPtr=result.getData<FrameSource::ColorPixel>()+(size[1]-1)*size[0];
-			ptrdiff_t resultStride=size[0];
-			const unsigned char* ypRowPtr=static_cast<const unsigned char*>(theoraFrame.planes[0].data)+theoraFrame.offsets[0];
-			const unsigned char* cbRowPtr=static_cast<const unsigned char*>(theoraFrame.planes[1].data)+theoraFrame.offsets[1];
-			const unsigned char* crRowPtr=static_cast<const unsigned char*>(theoraFrame.planes[2].data)+theoraFrame.offsets[2];
-			for(unsigned int y=0;y<size[1];y+=2)
-				{
-				FrameSource::ColorPixel* resultPtr=resultRowPtr;
-				const unsigned char* ypPtr=ypRowPtr;
-				const unsigned char* cbPtr=cbRowPtr;
-				const unsigned char* crPtr=crRowPtr;
-				for(unsigned int x=0;x<size[0];x+=2)
-					{
-					/* Convert the four pixels in the 2x2 block from Y'CbCr to RGB: */
-					unsigned char ypcbcr[3];
-					ypcbcr[0]=ypPtr[0];
-					ypcbcr[1]=*cbPtr;
-					ypcbcr[2]=*crPtr;
-					Video::ypcbcrToRgb(ypcbcr,resultPtr[0].components);
-					
-					ypcbcr[0]=ypPtr[1];
-					Video::ypcbcrToRgb(ypcbcr,resultPtr[1].components);
-					
-					ypcbcr[0]=ypPtr[theoraFrame.planes[0].stride];
-					Video::ypcbcrToRgb(ypcbcr,resultPtr[-resultStride].components);
-					
-					ypcbcr[0]=ypPtr[theoraFrame.planes[0].stride+1];
-					Video::ypcbcrToRgb(ypcbcr,resultPtr[-resultStride+1].components);
-					
-					/* Go to the next pixel: */
-					resultPtr+=2;
-					ypPtr+=2;
-					++cbPtr;
-					++crPtr;
-					}
-				
-				/* Go to the next row: */
-				resultRowPtr-=2*resultStride;
-				ypRowPtr+=2*theoraFrame.planes[0].stride;
-				cbRowPtr+=theoraFrame.planes[1].stride;
-				crRowPtr+=theoraFrame.planes[2].stride;
-				}
-			}
+			convertYpCbCr420ToRgb(planes[0],theoraFrame.planes[0].stride,planes[1],theoraFrame.planes[1].stride,planes[2],theoraFrame.planes[2].stride,size[0],size[1],resultPtr,resultStride);
 		else
-			{
-			/* Convert the decompressed frame from Y'CbCr 4:2:0 to Y'CbCr 4:4:4: */
-			FrameSource::ColorPixel* resultRowPtr=result.getData<FrameSource::ColorPixel>()+(size[1]-1)*size[0];
-			ptrdiff_t resultStride=size[0];
-			const unsigned char* ypRowPtr=static_cast<const unsigned char*>(theoraFrame.planes[0].data)+theoraFrame.offsets[0];
-			const unsigned char* cbRowPtr=static_cast<const unsigned char*>(theoraFrame.planes[1].data)+theoraFrame.offsets[1];
-			const unsigned char* crRowPtr=static_cast<const unsigned char*>(theoraFrame.planes[2].data)+theoraFrame.offsets[2];
-			for(unsigned int y=0;y<size[1];y+=2)
-				{
-				FrameSource::ColorPixel* resultPtr=resultRowPtr;
-				const unsigned char* ypPtr=ypRowPtr;
-				const unsigned char* cbPtr=cbRowPtr;
-				const unsigned char* crPtr=crRowPtr;
-				for(unsigned int x=0;x<size[0];x+=2)
-					{
-					/* Convert the four pixels in the 2x2 block from 4:2:0 layout to 4:4:4 layout: */
-					resultPtr[0][0]=ypPtr[0];
-					resultPtr[0][1]=cbPtr[0];
-					resultPtr[0][2]=crPtr[0];
-					resultPtr[1][0]=ypPtr[1];
-					resultPtr[1][1]=cbPtr[0];
-					resultPtr[1][2]=crPtr[0];
-					resultPtr[-resultStride][0]=ypPtr[theoraFrame.planes[0].stride];
-					resultPtr[-resultStride][1]=cbPtr[0];
-					resultPtr[-resultStride][2]=crPtr[0];
-					resultPtr[-resultStride+1][0]=ypPtr[theoraFrame.planes[0].stride+1];
-					resultPtr[-resultStride+1][1]=cbPtr[0];
-					resultPtr[-resultStride+1][2]=crPtr[0];
-					
-					/* Go to the next pixel: */
-					resultPtr+=2;
-					ypPtr+=2;
-					++cbPtr;
-					++crPtr;
-					}
-				
-				/* Go to the next row: */
-				resultRowPtr-=2*resultStride;
-				ypRowPtr+=2*theoraFrame.planes[0].stride;
-				cbRowPtr+=theoraFrame.planes[1].stride;
-				crRowPtr+=theoraFrame.planes[2].stride;
-				}
-			}
+			convertYpCbCr420ToYpCbCr444(planes[0],theoraFrame.planes[0].stride,planes[1],theoraFrame.planes[1].stride,planes[2],theoraFrame.planes[2].stride,size[0],size[1],resultPtr,resultStride);
 		
 		#else
 		
@@ -234,7 +168,7 @@ FrameBuffer ColorFrameReader::readNextFrame(void)
 		FrameSource::ColorPixel* resultPtr=result.getData<FrameSource::ColorPixel>();
 		for(unsigned int y=0;y<size[1];++y)
 			for(unsigned int x=0;x<size[0];++x,++resultPtr)
-				resultPtr->rgb[0]=resultPtr->rgb[1]=resultPtr->rgb[2]=FrameSource::ColorComponent(128U);
+				resultPtr->components[0]=resultPtr->components[1]=resultPtr->components[2]=FrameSource::ColorComponent(128U);
 		
 		#endif
 		}
@@ -33,6 +33,9 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 namespace IO {
 class File;
 }
+namespace Kinect {
+class ColorTileCodec;
+}
 
 namespace Kinect {
 
@@ -41,11 +44,12 @@ class ColorFrameReader:public FrameReader
 	/* Elements: */
 	private:
 	IO::File& source; // Data source for compressed color frames
-	bool sourceHasTheora; // Flag whether the source actually contains color frames
+	bool sourceHasTheora; // Flag whether the source contains Theora-encoded color frames
 	#if VIDEO_CONFIG_HAVE_THEORA
 	Video::TheoraDecoder theoraDecoder; // Object to decode the Theora-encoded color frame stream
 	#endif
-	bool convertToRgb; // Flag whether to convert Theora-encoded color frames from their native Y'CbCr color space to RGB for further processing
+	ColorTileCodec* tileCodec; // Object to decode a tile-compressed color frame stream, or null if the source does not contain tile-compressed color frames
+	bool convertToRgb; // Flag whether to convert color frames from their native Y'CbCr color space to RGB for further processing
 	
 	/* Constructors and destructors: */
 	public:
@@ -1,6 +1,6 @@
 /***********************************************************************
 ColorFrameWriter - Class to write compressed color frames to a sink.
-Copyright (c) 2010-2018 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -28,15 +28,14 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <IO/VariableMemoryFile.h>
 #include <Video/Config.h>
 #if VIDEO_CONFIG_HAVE_THEORA
-#include <Video/FrameBuffer.h>
-#include <Video/ImageExtractorRGB8.h>
-#include <Video/ImageExtractorYpCbCr.h>
 #include <Video/OggPage.h>
 #include <Video/TheoraInfo.h>
 #include <Video/TheoraComment.h>
 #endif
 #include <Kinect/FrameBuffer.h>
 #include <Kinect/FrameSource.h>
+#include <Kinect/Internal/YpCbCr420Conversion.h>
+#include <Kinect/Internal/ColorTileCodec.h>
 
 namespace Kinect {
 
@@ -44,71 +43,75 @@ namespace Kinect {
 Methods of class ColorFrameWriter:
 *********************************/
 
-ColorFrameWriter::ColorFrameWriter(IO::File& sSink,const unsigned int sSize[2],FrameSource::ColorSpace sColorSpace)
+ColorFrameWriter::ColorFrameWriter(IO::File& sSink,const unsigned int sSize[2],FrameSource::ColorSpace sColorSpace,ColorFrameWriter::Codec sCodec)
 	:FrameWriter(sSize),
-	 sink(sSink)
-	 #if VIDEO_CONFIG_HAVE_THEORA
-	 ,
-	 imageExtractor(0)
-	 #endif
+	 sink(sSink),colorSpace(sColorSpace),codec(sCodec),
+	 tileCodec(0)
 	{
+	/* Resolve the default codec, and fall back to the tiled codec if the Video library does not support Theora: */
+	#if VIDEO_CONFIG_HAVE_THEORA
+	if(codec==DEFAULT_CODEC)
+		codec=THEORA;
+	#else
+	codec=TILES;
+	#endif
+	
 	/* Write the frame size to the sink: */
 	for(int i=0;i<2;++i)
 		sink.write<Misc::UInt32>(size[i]);
 	
-	#if VIDEO_CONFIG_HAVE_THEORA
-	
-	/* Initialize the Theora encoder: */
-	Video::TheoraInfo theoraInfo;
-	theoraInfo.setImageSize(size);
-	theoraInfo.colorspace=TH_CS_UNSPECIFIED;
-	theoraInfo.pixel_fmt=TH_PF_420;
-	theoraInfo.target_bitrate=0;
-	theoraInfo.quality=48;
-	theoraInfo.setGopSize(64);
-	theoraInfo.fps_numerator=30;
-	theoraInfo.fps_denominator=1;
-	theoraInfo.aspect_numerator=1;
-	theoraInfo.aspect_denominator=1;
-	theoraEncoder.init(theoraInfo);
-	if(!theoraEncoder.isValid())
-		Misc::throwStdErr("ColorFrameWriter::ColorFrameWriter: Error initializing Theora encoder");
-	
-	/* Set the encoder to maximum speed: */
-	theoraEncoder.setSpeedLevel(theoraEncoder.getMaxSpeedLevel());
-	
-	/* Create the frame converter structures: */
-	if(sColorSpace==FrameSource::RGB)
-		imageExtractor=new Video::ImageExtractorRGB8(size);
-	else
-		imageExtractor=new Video::ImageExtractorYpCbCr(size);
-	theoraFrame.init420(theoraInfo);
-	
-	/* Set up a comment structure: */
-	Video::TheoraComment comments;
-	comments.setVendorString("Kinect color stream");
-	
-	/* Write the Theora stream headers into a temporary buffer to calculate their size before writing them to the sink: */
-	IO::VariableMemoryFile theoraHeaders;
-	theoraEncoder.writeHeaders(comments,theoraHeaders);
-	
-	/* Write the header size and header data to the sink: */
-	sink.write<Misc::UInt32>(Misc::UInt32(theoraHeaders.getDataSize()));
-	theoraHeaders.writeToSink(sink);
+	if(codec==TILES)
+		{
+		/* Create the tiled codec and write its stream header in place of the Theora stream header size: */
+		tileCodec=new ColorTileCodec(size,64,2);
+		tileCodec->writeHeader(sink);
+		}
 	
-	#else
+	#if VIDEO_CONFIG_HAVE_THEORA
 	
-	/* Write a dummy header sequence: */
-	sink.write<Misc::UInt32>(0);
+	if(codec==THEORA)
+		{
+		/* Initialize the Theora encoder: */
+		Video::TheoraInfo theoraInfo;
+		theoraInfo.setImageSize(size);
+		theoraInfo.colorspace=TH_CS_UNSPECIFIED;
+		theoraInfo.pixel_fmt=TH_PF_420;
+		theoraInfo.target_bitrate=0;
+		theoraInfo.quality=48;
+		theoraInfo.setGopSize(64);
+		theoraInfo.fps_numerator=30;
+		theoraInfo.fps_denominator=1;
+		theoraInfo.aspect_numerator=1;
+		theoraInfo.aspect_denominator=1;
+		theoraEncoder.init(theoraInfo);
+		if(!theoraEncoder.isValid())
+			Misc::throwStdErr("ColorFrameWriter::ColorFrameWriter: Error initializing Theora encoder");
+		
+		/* Set the encoder to maximum speed: */
+		theoraEncoder.setSpeedLevel(theoraEncoder.getMaxSpeedLevel());
+		
+		/* Create the frame buffer for converted frames: */
+		theoraFrame.init420(theoraInfo);
+		
+		/* Set up a comment structure: */
+		Video::TheoraComment comments;
+		comments.setVendorString("Kinect color stream");
+		
+		/* Write the Theora stream headers into a temporary buffer to calculate their size before writing them to the sink: */
+		IO::VariableMemoryFile theoraHeaders;
+		theoraEncoder.writeHeaders(comments,theoraHeaders);
+		
+		/* Write the header size and header data to the sink: */
+		sink.write<Misc::UInt32>(Misc::UInt32(theoraHeaders.getDataSize()));
+		theoraHeaders.writeToSink(sink);
+		}
 	
 	#endif
 	}
 
 ColorFrameWriter::~ColorFrameWriter(void)
 	{
-	#if VIDEO_CONFIG_HAVE_THEORA
-	delete imageExtractor;
-	#endif
+	delete tileCodec;
 	}
 
 size_t ColorFrameWriter::writeFrame(const FrameBuffer& frame)
@@ -119,23 +122,38 @@ size_t ColorFrameWriter::writeFrame(const FrameBuffer& frame)
 	sink.write<Misc::Float64>(frame.timeStamp);
 	result+=sizeof(Misc::Float64);
 	
-	#if VIDEO_CONFIG_HAVE_THEORA
-	
-	/* Convert the new raw RGB frame to Y'CbCr 4:2:0: */
-	Video::FrameBuffer tempFrame;
-	tempFrame.start=const_cast<FrameSource::ColorComponent*>(frame.getData<FrameSource::ColorComponent>()); // It's OK; Theora won't touch the frame, but has an API failure
-	imageExtractor->extractYpCbCr420(&tempFrame,theoraFrame.planes[0].data,theoraFrame.planes[0].stride,theoraFrame.planes[1].data,theoraFrame.planes[1].stride,theoraFrame.planes[2].data,theoraFrame.planes[2].stride);
+	if(codec==TILES)
+		{
+		/* Compress the frame with the tiled codec: */
+		result+=tileCodec->encodeFrame(frame.getData<FrameSource::ColorPixel>(),colorSpace,sink);
+		}
 	
-	/* Feed the converted Y'CbCr 4:2:0 frame to the Theora encoder: */
-	theoraEncoder.encodeFrame(theoraFrame);
+	#if VIDEO_CONFIG_HAVE_THEORA
 	
-	/* Write all encoded Theora packets to the sink: */
-	Video::TheoraPacket packet;
-	while(theoraEncoder.emitPacket(packet))
+	if(codec==THEORA)
 		{
-		/* Write the packet to the sink: */
-		packet.write(sink);
-		result+=packet.getWireSize();
+		/* Convert the new frame to Y'CbCr 4:2:0, flipping it vertically: */
+		const FrameSource::ColorPixel* framePtr=frame.getData<FrameSource::ColorPixel>()+(size[1]-1)*size[0];
+		ptrdiff_t frameStride=-ptrdiff_t(size[0]);
+		Misc::UInt8* planes[3];
+		for(int i=0;i<3;++i)
+			planes[i]=static_cast<Misc::UInt8*>(theoraFrame.planes[i].data);
+		if(colorSpace==FrameSource::RGB)
+			convertRgbToYpCbCr420(framePtr,frameStride,size[0],size[1],planes[0],theoraFrame.planes[0].stride,planes[1],theoraFrame.planes[1].stride,planes[2],theoraFrame.planes[2].stride);
+		else
+			convertYpCbCr444ToYpCbCr420(framePtr,frameStride,size[0],size[1],planes[0],theoraFrame.planes[0].stride,planes[1],theoraFrame.planes[1].stride,planes[2],theoraFrame.planes[2].stride);
+		
+		/* Feed the converted Y'CbCr 4:2:0 frame to the Theora encoder: */
+		theoraEncoder.encodeFrame(theoraFrame);
+		
+		/* Write all encoded Theora packets to the sink: */
+		Video::TheoraPacket packet;
+		while(theoraEncoder.emitPacket(packet))
+			{
+			/* Write the packet to the sink: */
+			packet.write(sink);
+			result+=packet.getWireSize();
+			}
 		}
 	
 	#endif
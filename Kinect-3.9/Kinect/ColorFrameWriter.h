@@ -1,6 +1,6 @@
 /***********************************************************************
 ColorFrameWriter - Class to write compressed color frames to a sink.
-Copyright (c) 2010-2018 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -36,30 +36,45 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 namespace IO {
 class File;
 }
-namespace Video {
-#if VIDEO_CONFIG_HAVE_THEORA
-class ImageExtractor;
-#endif
+namespace Kinect {
+class ColorTileCodec;
 }
 
 namespace Kinect {
 
 class ColorFrameWriter:public FrameWriter
 	{
+	/* Embedded classes: */
+	public:
+	enum Codec // Enumerated type for color frame compression codecs
+		{
+		DEFAULT_CODEC=0, // Theora if the Video library supports it, intra-only tiled codec otherwise
+		THEORA, // Theora video codec; most compact, but frames can only be decoded in sequence
+		TILES // Intra-only codec compressing independent frame tiles; frames can be decoded individually and in parallel
+		};
+	
 	/* Elements: */
 	private:
 	IO::File& sink; // Data sink for compressed color frames
+	FrameSource::ColorSpace colorSpace; // Color space of incoming color frames
+	Codec codec; // Codec used to compress color frames
 	#if VIDEO_CONFIG_HAVE_THEORA
 	Video::TheoraEncoder theoraEncoder; // Theora encoder object
-	Video::ImageExtractor* imageExtractor; // Extractor to convert RGB or Y'CbCr 4:4:4 images to Y'CbCr 4:2:0 images
 	Video::TheoraFrame theoraFrame; // Frame buffer for frames in Y'CbCr 4:2:0 pixel format
 	#endif
+	ColorTileCodec* tileCodec; // Intra-only tiled codec object
 	
 	/* Constructors and destructors: */
 	public:
-	ColorFrameWriter(IO::File& sSink,const unsigned int sSize[2],FrameSource::ColorSpace sColorSpace); // Creates a color frame writer for the given sink, frame size, and source color space
+	ColorFrameWriter(IO::File& sSink,const unsigned int sSize[2],FrameSource::ColorSpace sColorSpace,Codec sCodec =DEFAULT_CODEC); // Creates a color frame writer for the given sink, frame size, and source color space, using the given codec
 	virtual ~ColorFrameWriter(void);
 	
+	/* Methods: */
+	Codec getCodec(void) const // Returns the codec used to compress color frames
+		{
+		return codec;
+		}
+	
 	/* Methods from frameWriter: */
 	virtual size_t writeFrame(const FrameBuffer& frame);
 	};
@@ -26,6 +26,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <IO/File.h>
 #include <Math/Constants.h>
 #include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameBufferPool.h>
 #include <Kinect/FrameSource.h>
 
 namespace Kinect {
@@ -91,7 +92,7 @@ DepthFrameReader::~DepthFrameReader(void)
 FrameBuffer DepthFrameReader::readNextFrame(void)
 	{
 	/* Create the result frame: */
-	FrameBuffer result(size[0],size[1],size[0]*size[1]*sizeof(FrameSource::DepthPixel));
+	FrameBuffer result=FrameBufferPool::getDefaultPool().allocate(size[0],size[1],size[0]*size[1]*sizeof(FrameSource::DepthPixel));
 	
 	/* Return a dummy frame if the file is over: */
 	if(source.eof())
@@ -0,0 +1,485 @@
+/***********************************************************************
+DepthPointIndex - Class to answer closest-point and radius queries on
+the organized point clouds reconstructed from depth images, using the
+depth image's pixel grid as a two-level spatial subdivision that can be
+rebuilt in linear time for every incoming frame.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Kinect/DepthPointIndex.h>
+
+#include <stdexcept>
+#include <algorithm>
+#include <Math/Constants.h>
+#include <Threads/Thread.h>
+#include <Kinect/FrameBuffer.h>
+
+namespace Kinect {
+
+/********************************
+Declarations of embedded classes:
+********************************/
+
+class DepthPointIndex::FramePointSource // Class to reconstruct points from depth images while indexing
+	{
+	/* Elements: */
+	private:
+	const DepthPointIndex& index; // The index for which to reconstruct points
+	const DepthPixel* frame; // The depth image
+	
+	/* Constructors and destructors: */
+	public:
+	FramePointSource(const DepthPointIndex& sIndex,const DepthPixel* sFrame)
+		:index(sIndex),frame(sFrame)
+		{
+		}
+	
+	/* Methods: */
+	bool getPoint(unsigned int pixelIndex,Point& point) const // Reconstructs the point for the given pixel; returns false if the pixel is invalid
+		{
+		if(frame[pixelIndex]>=FrameSource::invalidDepth)
+			return false;
+		
+		/* Assemble the pixel's lens distortion-corrected depth image space position: */
+		Scalar dip[3];
+		dip[0]=index.framePixels[pixelIndex][0];
+		dip[1]=index.framePixels[pixelIndex][1];
+		dip[2]=index.depthCorrection!=0?index.depthCorrection[pixelIndex].correct(float(frame[pixelIndex])):Scalar(frame[pixelIndex]);
+		
+		/* Project the position into camera space: */
+		const Scalar (*m)[4]=index.depthProjection;
+		Scalar w=m[3][0]*dip[0]+m[3][1]*dip[1]+m[3][2]*dip[2]+m[3][3];
+		for(int i=0;i<3;++i)
+			point[i]=(m[i][0]*dip[0]+m[i][1]*dip[1]+m[i][2]*dip[2]+m[i][3])/w;
+		
+		return true;
+		}
+	};
+
+class DepthPointIndex::GridPointSource // Class to read points from organized point clouds while indexing
+	{
+	/* Elements: */
+	private:
+	const Point* gridPoints; // The organized point cloud
+	const bool* valid; // Validity flags for all points, or null
+	
+	/* Constructors and destructors: */
+	public:
+	GridPointSource(const Point* sGridPoints,const bool* sValid)
+		:gridPoints(sGridPoints),valid(sValid)
+		{
+		}
+	
+	/* Methods: */
+	bool getPoint(unsigned int pixelIndex,Point& point) const // Returns the point for the given pixel; returns false if the pixel is invalid
+		{
+		if(valid!=0&&!valid[pixelIndex])
+			return false;
+		
+		point=gridPoints[pixelIndex];
+		return true;
+		}
+	};
+
+struct DepthPointIndex::BatchQuery // Structure describing a range of a batch query processed by one thread
+	{
+	/* Elements: */
+	public:
+	const DepthPointIndex* index; // The index to query
+	const Point* queryPoints; // Array of all query points
+	unsigned int begin,end; // Range of query points processed by this thread
+	
+	/* Closest-point query state: */
+	unsigned int numNeighbors; // Number of closest points to find per query point
+	Scalar maxSqrDist; // Maximum squared distance of closest points
+	unsigned int* pixelIndices; // Array receiving the pixel indices of closest points
+	Scalar* sqrDists; // Array receiving the squared distances of closest points
+	
+	/* Radius query state: */
+	Scalar sqrRadius; // Squared sphere radius, or negative for closest-point queries
+	std::vector<unsigned int> numResults; // Number of points found for each query point in this thread's range
+	std::vector<unsigned int> results; // Pixel indices of points found for all query points in this thread's range
+	};
+
+/********************************
+Methods of class DepthPointIndex:
+********************************/
+
+void DepthPointIndex::init(void)
+	{
+	/* Calculate the tile and block layout: */
+	for(int i=0;i<2;++i)
+		{
+		numTiles[i]=(frameSize[i]+tileSize-1)/tileSize;
+		numBlocks[i]=(numTiles[i]+blockSize-1)/blockSize;
+		}
+	
+	/* Allocate the maximum required index storage up-front: */
+	points.reserve(size_t(frameSize[1])*size_t(frameSize[0]));
+	tiles.reserve(size_t(numTiles[1])*size_t(numTiles[0]));
+	blocks.reserve(size_t(numBlocks[1])*size_t(numBlocks[0]));
+	}
+
+template <class PointSourceParam>
+void DepthPointIndex::buildIndex(const PointSourceParam& pointSource)
+	{
+	points.clear();
+	tiles.clear();
+	blocks.clear();
+	
+	/* Collect the valid points of all tiles in block order, so that each tile's points and each block's tiles are contiguous: */
+	for(unsigned int by=0;by<numBlocks[1];++by)
+		for(unsigned int bx=0;bx<numBlocks[0];++bx)
+			{
+			Cell block;
+			block.begin=(unsigned int)(tiles.size());
+			unsigned int tyEnd=std::min((by+1)*blockSize,numTiles[1]);
+			unsigned int txEnd=std::min((bx+1)*blockSize,numTiles[0]);
+			for(unsigned int ty=by*blockSize;ty<tyEnd;++ty)
+				for(unsigned int tx=bx*blockSize;tx<txEnd;++tx)
+					{
+					Cell tile;
+					tile.begin=(unsigned int)(points.size());
+					
+					/* Collect the tile's valid points and their bounding box: */
+					Point min=Point(Math::Constants<Scalar>::max);
+					Point max=Point(Math::Constants<Scalar>::min);
+					unsigned int yEnd=std::min((ty+1)*tileSize,frameSize[1]);
+					unsigned int xEnd=std::min((tx+1)*tileSize,frameSize[0]);
+					for(unsigned int y=ty*tileSize;y<yEnd;++y)
+						{
+						unsigned int pixelIndex=y*frameSize[0]+tx*tileSize;
+						for(unsigned int x=tx*tileSize;x<xEnd;++x,++pixelIndex)
+							{
+							Point p;
+							if(pointSource.getPoint(pixelIndex,p))
+								{
+								points.push_back(StoredPoint(p,pixelIndex));
+								for(int i=0;i<3;++i)
+									{
+									if(min[i]>p[i])
+										min[i]=p[i];
+									if(max[i]<p[i])
+										max[i]=p[i];
+									}
+								}
+							}
+						}
+					
+					/* Store the tile if it is not empty: */
+					tile.end=(unsigned int)(points.size());
+					if(tile.end>tile.begin)
+						{
+						tile.box=Box(min,max);
+						tiles.push_back(tile);
+						}
+					}
+			
+			/* Store the block if it is not empty: */
+			block.end=(unsigned int)(tiles.size());
+			if(block.end>block.begin)
+				{
+				block.box=tiles[block.begin].box;
+				for(unsigned int ti=block.begin+1;ti<block.end;++ti)
+					block.box.addBox(tiles[ti].box);
+				blocks.push_back(block);
+				}
+			}
+	}
+
+void DepthPointIndex::findClosestPoints(const Point& queryPoint,ClosePointSet& closestPoints,Traversal& traversal) const
+	{
+	if(blocks.empty())
+		return;
+	
+	/* Seed the closest point set with the points of the tile closest to the query point to prune most other blocks and tiles up-front: */
+	unsigned int seedBlock=0;
+	Scalar seedDist2=blocks[0].box.sqrDist(queryPoint);
+	for(unsigned int bi=1;bi<blocks.size()&&seedDist2>Scalar(0);++bi)
+		{
+		Scalar dist2=blocks[bi].box.sqrDist(queryPoint);
+		if(seedDist2>dist2)
+			{
+			seedBlock=bi;
+			seedDist2=dist2;
+			}
+		}
+	unsigned int seedTile=blocks[seedBlock].begin;
+	seedDist2=tiles[seedTile].box.sqrDist(queryPoint);
+	for(unsigned int ti=seedTile+1;ti<blocks[seedBlock].end&&seedDist2>Scalar(0);++ti)
+		{
+		Scalar dist2=tiles[ti].box.sqrDist(queryPoint);
+		if(seedDist2>dist2)
+			{
+			seedTile=ti;
+			seedDist2=dist2;
+			}
+		}
+	for(unsigned int pi=tiles[seedTile].begin;pi<tiles[seedTile].end;++pi)
+		closestPoints.insertPoint(points[pi],Geometry::sqrDist(queryPoint,points[pi]));
+	
+	/* Collect all blocks that can contain closer points than the current set and sort them by distance: */
+	traversal.blocks.clear();
+	for(unsigned int bi=0;bi<blocks.size();++bi)
+		{
+		Scalar dist2=blocks[bi].box.sqrDist(queryPoint);
+		if(dist2<closestPoints.getMaxSqrDist())
+			traversal.blocks.push_back(std::make_pair(dist2,bi));
+		}
+	std::sort(traversal.blocks.begin(),traversal.blocks.end());
+	
+	/* Visit blocks in order of increasing distance until no block can contain closer points: */
+	for(std::vector<std::pair<Scalar,unsigned int> >::iterator bIt=traversal.blocks.begin();bIt!=traversal.blocks.end()&&bIt->first<closestPoints.getMaxSqrDist();++bIt)
+		{
+		/* Collect and sort the block's tiles in the same way: */
+		const Cell& block=blocks[bIt->second];
+		traversal.tiles.clear();
+		for(unsigned int ti=block.begin;ti<block.end;++ti)
+			{
+			Scalar dist2=tiles[ti].box.sqrDist(queryPoint);
+			if(dist2<closestPoints.getMaxSqrDist()&&ti!=seedTile)
+				traversal.tiles.push_back(std::make_pair(dist2,ti));
+			}
+		std::sort(traversal.tiles.begin(),traversal.tiles.end());
+		
+		/* Check the points of all tiles that can still contain closer points: */
+		for(std::vector<std::pair<Scalar,unsigned int> >::iterator tIt=traversal.tiles.begin();tIt!=traversal.tiles.end()&&tIt->first<closestPoints.getMaxSqrDist();++tIt)
+			{
+			const Cell& tile=tiles[tIt->second];
+			for(unsigned int pi=tile.begin;pi<tile.end;++pi)
+				closestPoints.insertPoint(points[pi],Geometry::sqrDist(queryPoint,points[pi]));
+			}
+		}
+	}
+
+void DepthPointIndex::collectPointsInSphere(const Point& center,Scalar sqrRadius,std::vector<unsigned int>& pixelIndices) const
+	{
+	/* Check all points in tiles and blocks that intersect the sphere: */
+	for(std::vector<Cell>::const_iterator bIt=blocks.begin();bIt!=blocks.end();++bIt)
+		if(bIt->box.sqrDist(center)<=sqrRadius)
+			for(unsigned int ti=bIt->begin;ti<bIt->end;++ti)
+				{
+				const Cell& tile=tiles[ti];
+				if(tile.box.sqrDist(center)<=sqrRadius)
+					for(unsigned int pi=tile.begin;pi<tile.end;++pi)
+						if(Geometry::sqrDist(center,points[pi])<=sqrRadius)
+							pixelIndices.push_back(points[pi].value);
+				}
+	}
+
+void* DepthPointIndex::batchQueryThread(DepthPointIndex::BatchQuery* query)
+	{
+	if(query->sqrRadius>=Scalar(0))
+		{
+		/* Process all radius queries in this thread's range: */
+		for(unsigned int qi=query->begin;qi<query->end;++qi)
+			{
+			size_t numResults=query->results.size();
+			query->index->collectPointsInSphere(query->queryPoints[qi],query->sqrRadius,query->results);
+			query->numResults.push_back((unsigned int)(query->results.size()-numResults));
+			}
+		}
+	else
+		{
+		/* Process all closest-point queries in this thread's range: */
+		ClosePointSet closestPoints(query->numNeighbors,query->maxSqrDist);
+		Traversal traversal;
+		for(unsigned int qi=query->begin;qi<query->end;++qi)
+			{
+			closestPoints.clear();
+			query->index->findClosestPoints(query->queryPoints[qi],closestPoints,traversal);
+			
+			/* Write the query point's results: */
+			unsigned int* piPtr=query->pixelIndices+size_t(qi)*size_t(query->numNeighbors);
+			Scalar* sdPtr=query->sqrDists+size_t(qi)*size_t(query->numNeighbors);
+			int numPoints=closestPoints.getNumPoints();
+			for(int i=0;i<numPoints;++i)
+				{
+				piPtr[i]=closestPoints.getPoint(i).value;
+				sdPtr[i]=closestPoints.getSqrDist(i);
+				}
+			for(unsigned int i=numPoints;i<query->numNeighbors;++i)
+				{
+				piPtr[i]=~0x0U;
+				sdPtr[i]=Math::Constants<Scalar>::max;
+				}
+			}
+		}
+	
+	return 0;
+	}
+
+DepthPointIndex::DepthPointIndex(const unsigned int sFrameSize[2])
+	:framePixels(0),depthCorrection(0)
+	{
+	/* Copy the frame size: */
+	for(int i=0;i<2;++i)
+		frameSize[i]=sFrameSize[i];
+	
+	init();
+	}
+
+DepthPointIndex::DepthPointIndex(const unsigned int sFrameSize[2],const FrameSource::DepthCorrection* dc,const FrameSource::IntrinsicParameters& ips)
+	:framePixels(0),depthCorrection(0)
+	{
+	/* Copy the frame size: */
+	for(int i=0;i<2;++i)
+		frameSize[i]=sFrameSize[i];
+	
+	init();
+	
+	if(dc!=0)
+		{
+		/* Create an array of per-pixel depth correction factors: */
+		depthCorrection=dc->getPixelCorrection(frameSize);
+		}
+	
+	/* Pre-compute a 2D array of lens distortion-corrected image pixel positions: */
+	framePixels=new Scalar[frameSize[1]*frameSize[0]][2];
+	Scalar (*fpPtr)[2]=framePixels;
+	for(unsigned int y=0;y<frameSize[1];++y)
+		for(unsigned int x=0;x<frameSize[0];++x,++fpPtr)
+			{
+			LensDistortion::Point dp(LensDistortion::Scalar(x)+LensDistortion::Scalar(0.5),LensDistortion::Scalar(y)+LensDistortion::Scalar(0.5));
+			if(!ips.depthLensDistortion.isIdentity())
+				dp=ips.depthLensDistortion.undistortPixel(dp);
+			(*fpPtr)[0]=Scalar(dp[0]);
+			(*fpPtr)[1]=Scalar(dp[1]);
+			}
+	
+	/* Copy the depth projection matrix: */
+	const PTransform::Matrix& m=ips.depthProjection.getMatrix();
+	for(int i=0;i<4;++i)
+		for(int j=0;j<4;++j)
+			depthProjection[i][j]=Scalar(m(i,j));
+	}
+
+DepthPointIndex::~DepthPointIndex(void)
+	{
+	delete[] framePixels;
+	delete[] depthCorrection;
+	}
+
+void DepthPointIndex::setFrame(const FrameBuffer& depthFrame)
+	{
+	if(framePixels==0)
+		throw std::runtime_error("Kinect::DepthPointIndex::setFrame: Index has no intrinsic parameters");
+	
+	buildIndex(FramePointSource(*this,depthFrame.getData<DepthPixel>()));
+	}
+
+void DepthPointIndex::setPoints(const DepthPointIndex::Point gridPoints[],const bool valid[])
+	{
+	buildIndex(GridPointSource(gridPoints,valid));
+	}
+
+const DepthPointIndex::StoredPoint* DepthPointIndex::findClosestPoint(const DepthPointIndex::Point& queryPoint,DepthPointIndex::Scalar maxSqrDist) const
+	{
+	ClosePointSet closestPoints(1,maxSqrDist);
+	Traversal traversal;
+	findClosestPoints(queryPoint,closestPoints,traversal);
+	return closestPoints.getNumPoints()>0?&closestPoints.getPoint(0):0;
+	}
+
+DepthPointIndex::ClosePointSet& DepthPointIndex::findClosestPoints(const DepthPointIndex::Point& queryPoint,DepthPointIndex::ClosePointSet& closestPoints) const
+	{
+	Traversal traversal;
+	findClosestPoints(queryPoint,closestPoints,traversal);
+	return closestPoints;
+	}
+
+std::vector<unsigned int>& DepthPointIndex::findPointsInSphere(const DepthPointIndex::Point& center,DepthPointIndex::Scalar radius,std::vector<unsigned int>& pixelIndices) const
+	{
+	pixelIndices.clear();
+	collectPointsInSphere(center,radius*radius,pixelIndices);
+	return pixelIndices;
+	}
+
+void DepthPointIndex::findClosestPoints(unsigned int numQueryPoints,const DepthPointIndex::Point queryPoints[],unsigned int numNeighbors,DepthPointIndex::Scalar maxSqrDist,unsigned int pixelIndices[],DepthPointIndex::Scalar sqrDists[],int numThreads) const
+	{
+	/* Split the query points into equal ranges, one per thread: */
+	if(numThreads<1)
+		numThreads=1;
+	std::vector<BatchQuery> queries(numThreads);
+	for(int i=0;i<numThreads;++i)
+		{
+		BatchQuery& q=queries[i];
+		q.index=this;
+		q.queryPoints=queryPoints;
+		q.begin=(unsigned int)((size_t(numQueryPoints)*size_t(i))/size_t(numThreads));
+		q.end=(unsigned int)((size_t(numQueryPoints)*size_t(i+1))/size_t(numThreads));
+		q.numNeighbors=numNeighbors;
+		q.maxSqrDist=maxSqrDist;
+		q.pixelIndices=pixelIndices;
+		q.sqrDists=sqrDists;
+		q.sqrRadius=Scalar(-1);
+		}
+	
+	/* Process the first range in this thread and the others in background threads: */
+	Threads::Thread* threads=new Threads::Thread[numThreads-1];
+	for(int i=1;i<numThreads;++i)
+		threads[i-1].start(&DepthPointIndex::batchQueryThread,&queries[i]);
+	batchQueryThread(&queries[0]);
+	for(int i=1;i<numThreads;++i)
+		threads[i-1].join();
+	delete[] threads;
+	}
+
+void DepthPointIndex::findPointsInSpheres(unsigned int numQueryPoints,const DepthPointIndex::Point queryPoints[],DepthPointIndex::Scalar radius,std::vector<unsigned int>& offsets,std::vector<unsigned int>& pixelIndices,int numThreads) const
+	{
+	/* Split the query points into equal ranges, one per thread: */
+	if(numThreads<1)
+		numThreads=1;
+	std::vector<BatchQuery> queries(numThreads);
+	for(int i=0;i<numThreads;++i)
+		{
+		BatchQuery& q=queries[i];
+		q.index=this;
+		q.queryPoints=queryPoints;
+		q.begin=(unsigned int)((size_t(numQueryPoints)*size_t(i))/size_t(numThreads));
+		q.end=(unsigned int)((size_t(numQueryPoints)*size_t(i+1))/size_t(numThreads));
+		q.sqrRadius=radius*radius;
+		q.numResults.reserve(q.end-q.begin);
+		}
+	
+	/* Process the first range in this thread and the others in background threads: */
+	Threads::Thread* threads=new Threads::Thread[numThreads-1];
+	for(int i=1;i<numThreads;++i)
+		threads[i-1].start(&DepthPointIndex::batchQueryThread,&queries[i]);
+	batchQueryThread(&queries[0]);
+	for(int i=1;i<numThreads;++i)
+		threads[i-1].join();
+	delete[] threads;
+	
+	/* Concatenate the per-thread results: */
+	offsets.clear();
+	offsets.reserve(numQueryPoints+1);
+	offsets.push_back(0U);
+	pixelIndices.clear();
+	for(int i=0;i<numThreads;++i)
+		{
+		const BatchQuery& q=queries[i];
+		for(std::vector<unsigned int>::const_iterator nrIt=q.numResults.begin();nrIt!=q.numResults.end();++nrIt)
+			offsets.push_back(offsets.back()+*nrIt);
+		pixelIndices.insert(pixelIndices.end(),q.results.begin(),q.results.end());
+		}
+	}
+
+}
@@ -0,0 +1,140 @@
+/***********************************************************************
+DepthPointIndex - Class to answer closest-point and radius queries on
+the organized point clouds reconstructed from depth images, using the
+depth image's pixel grid as a two-level spatial subdivision that can be
+rebuilt in linear time for every incoming frame.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef KINECT_DEPTHPOINTINDEX_INCLUDED
+#define KINECT_DEPTHPOINTINDEX_INCLUDED
+
+#include <vector>
+#include <Geometry/Point.h>
+#include <Geometry/Box.h>
+#include <Geometry/ValuedPoint.h>
+#include <Geometry/ClosePointSet.h>
+#include <Kinect/FrameSource.h>
+
+/* Forward declarations: */
+namespace Kinect {
+class FrameBuffer;
+}
+
+namespace Kinect {
+
+class DepthPointIndex
+	{
+	/* Embedded classes: */
+	public:
+	typedef float Scalar; // Type for scalar values
+	typedef Geometry::Point<Scalar,3> Point; // Type for points in camera space
+	typedef Geometry::Box<Scalar,3> Box; // Type for axis-aligned bounding boxes in camera space
+	typedef Geometry::ValuedPoint<Point,unsigned int> StoredPoint; // Type for indexed points, tagged with the index of their depth image pixel
+	typedef Geometry::ClosePointSet<StoredPoint> ClosePointSet; // Type for sets of closest points
+	
+	static const unsigned int tileSize=8; // Width and height of a tile in depth image pixels
+	static const unsigned int blockSize=8; // Width and height of a block in tiles
+	
+	private:
+	typedef FrameSource::DepthPixel DepthPixel; // Type for depth image pixels
+	typedef FrameSource::DepthCorrection::PixelCorrection PixelDepthCorrection; // Type for per-pixel depth correction factors
+	typedef FrameSource::IntrinsicParameters::PTransform PTransform; // Type for projections from depth image space into camera space
+	
+	struct Cell // Structure for a tile of pixels or a block of tiles
+		{
+		/* Elements: */
+		public:
+		Box box; // Bounding box of all valid points inside the cell
+		unsigned int begin,end; // Range of the cell's points in the point array (for tiles) or of its tiles in the tile array (for blocks)
+		};
+	
+	struct Traversal // Structure holding temporary state for queries
+		{
+		/* Elements: */
+		public:
+		std::vector<std::pair<Scalar,unsigned int> > blocks; // List of blocks to visit, with their squared distances from the query point
+		std::vector<std::pair<Scalar,unsigned int> > tiles; // List of tiles to visit inside the current block
+		};
+	
+	class FramePointSource; // Class to reconstruct points from depth images while indexing
+	class GridPointSource; // Class to read points from organized point clouds while indexing
+	struct BatchQuery; // Structure describing a range of a batch query processed by one thread
+	
+	/* Elements: */
+	unsigned int frameSize[2]; // Width and height of indexed depth images
+	unsigned int numTiles[2]; // Number of tiles horizontally and vertically
+	unsigned int numBlocks[2]; // Number of blocks horizontally and vertically
+	Scalar (*framePixels)[2]; // Lens distortion-corrected depth image positions of all pixel centers
+	PixelDepthCorrection* depthCorrection; // Per-pixel depth correction factors, or null if depth correction is disabled
+	Scalar depthProjection[4][4]; // Matrix of the projection from depth image space into camera space
+	std::vector<StoredPoint> points; // Array of valid points, grouped by tile
+	std::vector<Cell> tiles; // Array of non-empty tiles, grouped by block
+	std::vector<Cell> blocks; // Array of non-empty blocks
+	
+	/* Private methods: */
+	void init(void); // Initializes the tile and block layout
+	template <class PointSourceParam>
+	void buildIndex(const PointSourceParam& pointSource); // Indexes all valid points delivered by the given point source
+	void findClosestPoints(const Point& queryPoint,ClosePointSet& closestPoints,Traversal& traversal) const; // Finds closest points using the given traversal state
+	void collectPointsInSphere(const Point& center,Scalar sqrRadius,std::vector<unsigned int>& pixelIndices) const; // Appends the pixel indices of all points inside the given sphere to the given list
+	static void* batchQueryThread(BatchQuery* query); // Processes a range of a batch query
+	
+	/* Constructors and destructors: */
+	public:
+	DepthPointIndex(const unsigned int sFrameSize[2]); // Creates an empty index for organized point clouds of the given size
+	DepthPointIndex(const unsigned int sFrameSize[2],const FrameSource::DepthCorrection* dc,const FrameSource::IntrinsicParameters& ips); // Creates an empty index for depth images of the given size, using the given depth correction (can be null) and intrinsic parameters
+	private:
+	DepthPointIndex(const DepthPointIndex& source); // Prohibit copy constructor
+	DepthPointIndex& operator=(const DepthPointIndex& source); // Prohibit assignment operator
+	public:
+	~DepthPointIndex(void);
+	
+	/* Methods: */
+	const unsigned int* getFrameSize(void) const // Returns the size of indexed depth images
+		{
+		return frameSize;
+		}
+	unsigned int getNumPoints(void) const // Returns the number of valid points in the index
+		{
+		return (unsigned int)(points.size());
+		}
+	const StoredPoint* getPoints(void) const // Returns the array of valid points, in index order
+		{
+		return points.empty()?0:&points[0];
+		}
+	
+	/* Index creation methods: */
+	void setFrame(const FrameBuffer& depthFrame); // Indexes the camera-space point cloud reconstructed from the given depth image; requires intrinsic parameters
+	void setPoints(const Point gridPoints[],const bool valid[]); // Indexes the given organized point cloud in depth image pixel order, where invalid points are flagged in the given array (which can be null if all points are valid)
+	
+	/* Query methods: */
+	const StoredPoint* findClosestPoint(const Point& queryPoint,Scalar maxSqrDist) const; // Returns the point closest to the query point within the given squared distance, or null if there is none
+	ClosePointSet& findClosestPoints(const Point& queryPoint,ClosePointSet& closestPoints) const; // Returns a set of closest points
+	std::vector<unsigned int>& findPointsInSphere(const Point& center,Scalar radius,std::vector<unsigned int>& pixelIndices) const; // Returns the pixel indices of all points inside the given sphere in no particular order
+	
+	/* Batch query methods: */
+	void findClosestPoints(unsigned int numQueryPoints,const Point queryPoints[],unsigned int numNeighbors,Scalar maxSqrDist,unsigned int pixelIndices[],Scalar sqrDists[],int numThreads =1) const; // Finds up to the given number of closest points within the given squared distance for each query point; writes results in order of increasing distance into the given arrays with numNeighbors entries per query point, and pads unused entries with ~0x0U and maximum distance
+	void findPointsInSpheres(unsigned int numQueryPoints,const Point queryPoints[],Scalar radius,std::vector<unsigned int>& offsets,std::vector<unsigned int>& pixelIndices,int numThreads =1) const; // Finds the pixel indices of all points inside the spheres of the given radius around each query point; results for query point i are pixelIndices[offsets[i]] to pixelIndices[offsets[i+1]-1]
+	};
+
+}
+
+#endif
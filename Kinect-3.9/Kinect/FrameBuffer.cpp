@@ -0,0 +1,50 @@
+/***********************************************************************
+FrameBuffer - Class for reference-counted decoded color or depth frame
+buffers.
+Copyright (c) 2010-2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Kinect/FrameBuffer.h>
+
+#include <Kinect/FrameBufferPool.h>
+
+namespace Kinect {
+
+/****************************
+Methods of class FrameBuffer:
+****************************/
+
+void FrameBuffer::releaseBuffer(void* buffer)
+	{
+	BufferHeader* header=static_cast<BufferHeader*>(buffer)-1;
+	if(header->pool!=0)
+		{
+		/* Return the buffer to its pool: */
+		header->pool->recycleBuffer(buffer);
+		}
+	else
+		{
+		/* Delete the buffer: */
+		header->~BufferHeader();
+		delete[] (static_cast<unsigned char*>(buffer)-sizeof(BufferHeader));
+		}
+	}
+
+}
@@ -1,7 +1,7 @@
 /***********************************************************************
 FrameBuffer - Class for reference-counted decoded color or depth frame
 buffers.
-Copyright (c) 2010-2015 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -29,16 +29,24 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #if KINECT_FRAMEBUFFER_DEBUGLOCK
 #include <assert.h>
 #endif
+#include <stddef.h>
 #include <new>
 #if KINECT_FRAMEBUFFER_DEBUGLOCK
 #include <iostream>
 #endif
 #include <Threads/Atomic.h>
 
+/* Forward declarations: */
+namespace Kinect {
+class FrameBufferPool;
+}
+
 namespace Kinect {
 
 class FrameBuffer
 	{
+	friend class FrameBufferPool;
+	
 	/* Embedded classes: */
 	private:
 	struct BufferHeader
@@ -46,13 +54,15 @@ class FrameBuffer
 		/* Elements: */
 		public:
 		Threads::Atomic<unsigned int> refCount; // Reference counter
+		FrameBufferPool* pool; // Pool to which the buffer is returned once it becomes orphaned, or null if the buffer is deleted
+		size_t bufferSize; // Size of the buffer in bytes, not including the header
 		#if KINECT_FRAMEBUFFER_DEBUGLOCK
 		int destroyed;
 		#endif
 		
 		/* Constructors and destructors: */
-		BufferHeader(void)
-			:refCount(1)
+		BufferHeader(FrameBufferPool* sPool,size_t sBufferSize)
+			:refCount(1),pool(sPool),bufferSize(sBufferSize)
 			#if KINECT_FRAMEBUFFER_DEBUGLOCK
 			 ,destroyed(0)
 			#endif
@@ -91,7 +101,18 @@ class FrameBuffer
 	public:
 	double timeStamp; // Frame's time stamp in originating camera's own clock
 	
+	/* Private methods: */
+	private:
+	static void releaseBuffer(void* buffer); // Destroys an orphaned buffer, or returns it to its pool
+	
 	/* Constructors and destructors: */
+	FrameBuffer(int sizeX,int sizeY,void* sBuffer) // Creates a frame buffer adopting the given buffer, which already has a reference for this frame buffer
+		:buffer(sBuffer),timeStamp(0.0)
+		{
+		/* Copy the frame size: */
+		size[0]=sizeX;
+		size[1]=sizeY;
+		}
 	public:
 	FrameBuffer(void) // Creates invalid frame buffer
 		:buffer(0),timeStamp(0.0)
@@ -107,7 +128,7 @@ class FrameBuffer
 		
 		/* Allocate the enlarged frame buffer: */
 		unsigned char* paddedBuffer=new unsigned char[bufferSize+sizeof(BufferHeader)];
-		new(paddedBuffer) BufferHeader;
+		new(paddedBuffer) BufferHeader(0,bufferSize);
 		
 		/* Store the actual buffer pointer: */
 		buffer=paddedBuffer+sizeof(BufferHeader);
@@ -136,9 +157,8 @@ class FrameBuffer
 				{
 				if(static_cast<BufferHeader*>(buffer)[-1].unref())
 					{
-					/* Delete the unused buffer: */
-					static_cast<BufferHeader*>(buffer)[-1].~BufferHeader();
-					delete[] (static_cast<unsigned char*>(buffer)-sizeof(BufferHeader));
+					/* Release the unused buffer: */
+					releaseBuffer(buffer);
 					}
 				}
 			
@@ -163,9 +183,8 @@ class FrameBuffer
 			{
 			if(static_cast<BufferHeader*>(buffer)[-1].unref())
 				{
-				/* Delete the unused buffer: */
-				static_cast<BufferHeader*>(buffer)[-1].~BufferHeader();
-				delete[] (static_cast<unsigned char*>(buffer)-sizeof(BufferHeader));
+				/* Release the unused buffer: */
+				releaseBuffer(buffer);
 				}
 			}
 		}
@@ -203,9 +222,8 @@ class FrameBuffer
 			{
 			if(static_cast<BufferHeader*>(buffer)[-1].unref())
 				{
-				/* Delete the unused buffer: */
-				static_cast<BufferHeader*>(buffer)[-1].~BufferHeader();
-				delete[] (static_cast<unsigned char*>(buffer)-sizeof(BufferHeader));
+				/* Release the unused buffer: */
+				releaseBuffer(buffer);
 				}
 			
 			/* Drop the buffer reference: */
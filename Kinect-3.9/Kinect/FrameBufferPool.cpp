@@ -0,0 +1,195 @@
+/***********************************************************************
+FrameBufferPool - Class to recycle the memory of orphaned frame buffers
+to avoid allocating new memory for every decoded frame.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Kinect/FrameBufferPool.h>
+
+namespace Kinect {
+
+/********************************
+Methods of class FrameBufferPool:
+********************************/
+
+void FrameBufferPool::deleteBuffer(void* buffer)
+	{
+	static_cast<FrameBuffer::BufferHeader*>(buffer)[-1].~BufferHeader();
+	delete[] (static_cast<unsigned char*>(buffer)-sizeof(FrameBuffer::BufferHeader));
+	}
+
+void FrameBufferPool::recycleBuffer(void* buffer)
+	{
+	size_t bufferSize=static_cast<FrameBuffer::BufferHeader*>(buffer)[-1].bufferSize;
+	bool discard=true;
+	{
+	Threads::Mutex::Lock poolLock(poolMutex);
+	
+	--statistics.numUsedBuffers;
+	
+	/* Find the buffer's size class: */
+	for(std::vector<SizeClass>::iterator scIt=sizeClasses.begin();scIt!=sizeClasses.end();++scIt)
+		if(scIt->bufferSize==bufferSize)
+			{
+			/* Keep the buffer if the size class is not full: */
+			if(scIt->freeBuffers.size()<maxNumFreeBuffers)
+				{
+				scIt->freeBuffers.push_back(buffer);
+				++statistics.numFreeBuffers;
+				statistics.freeBufferSize+=bufferSize;
+				discard=false;
+				}
+			break;
+			}
+	
+	if(discard)
+		++statistics.numDiscards;
+	}
+	
+	/* Delete the buffer if it was not kept: */
+	if(discard)
+		deleteBuffer(buffer);
+	
+	/* Release the buffer's reference to the pool, which might destroy the pool: */
+	unref();
+	}
+
+FrameBufferPool::FrameBufferPool(unsigned int sMaxNumFreeBuffers)
+	:maxNumFreeBuffers(sMaxNumFreeBuffers)
+	{
+	}
+
+FrameBufferPool::~FrameBufferPool(void)
+	{
+	/* Delete all recycled buffers: */
+	for(std::vector<SizeClass>::iterator scIt=sizeClasses.begin();scIt!=sizeClasses.end();++scIt)
+		for(std::vector<void*>::iterator fbIt=scIt->freeBuffers.begin();fbIt!=scIt->freeBuffers.end();++fbIt)
+			deleteBuffer(*fbIt);
+	}
+
+FrameBufferPool& FrameBufferPool::getDefaultPool(void)
+	{
+	/* Create the default pool on first use; frame buffers that are still in use during static destruction keep it alive: */
+	static FrameBufferPoolPtr defaultPool(new FrameBufferPool);
+	return *defaultPool;
+	}
+
+FrameBuffer FrameBufferPool::allocate(int sizeX,int sizeY,size_t bufferSize)
+	{
+	void* buffer=0;
+	{
+	Threads::Mutex::Lock poolLock(poolMutex);
+	
+	/* Find the size class for the requested buffer size: */
+	std::vector<SizeClass>::iterator scIt;
+	for(scIt=sizeClasses.begin();scIt!=sizeClasses.end()&&scIt->bufferSize!=bufferSize;++scIt)
+		;
+	if(scIt==sizeClasses.end())
+		{
+		/* Create a new size class: */
+		sizeClasses.push_back(SizeClass());
+		scIt=sizeClasses.end()-1;
+		scIt->bufferSize=bufferSize;
+		}
+	
+	/* Take a recycled buffer if there is one: */
+	if(!scIt->freeBuffers.empty())
+		{
+		buffer=scIt->freeBuffers.back();
+		scIt->freeBuffers.pop_back();
+		--statistics.numFreeBuffers;
+		statistics.freeBufferSize-=bufferSize;
+		++statistics.numHits;
+		}
+	else
+		++statistics.numMisses;
+	++statistics.numUsedBuffers;
+	}
+	
+	if(buffer!=0)
+		{
+		/* Reset the recycled buffer's header: */
+		FrameBuffer::BufferHeader* header=static_cast<FrameBuffer::BufferHeader*>(buffer)-1;
+		header->~BufferHeader();
+		new(header) FrameBuffer::BufferHeader(this,bufferSize);
+		}
+	else
+		{
+		/* Allocate a new buffer: */
+		unsigned char* paddedBuffer=new unsigned char[bufferSize+sizeof(FrameBuffer::BufferHeader)];
+		new(paddedBuffer) FrameBuffer::BufferHeader(this,bufferSize);
+		buffer=paddedBuffer+sizeof(FrameBuffer::BufferHeader);
+		}
+	
+	/* Keep the pool alive while the buffer is in use: */
+	ref();
+	
+	return FrameBuffer(sizeX,sizeY,buffer);
+	}
+
+void FrameBufferPool::setMaxNumFreeBuffers(unsigned int newMaxNumFreeBuffers)
+	{
+	std::vector<void*> excessBuffers;
+	{
+	Threads::Mutex::Lock poolLock(poolMutex);
+	
+	/* Set the new limit and remove excess recycled buffers from all size classes: */
+	maxNumFreeBuffers=newMaxNumFreeBuffers;
+	for(std::vector<SizeClass>::iterator scIt=sizeClasses.begin();scIt!=sizeClasses.end();++scIt)
+		while(scIt->freeBuffers.size()>maxNumFreeBuffers)
+			{
+			excessBuffers.push_back(scIt->freeBuffers.back());
+			scIt->freeBuffers.pop_back();
+			--statistics.numFreeBuffers;
+			statistics.freeBufferSize-=scIt->bufferSize;
+			}
+	}
+	
+	/* Delete the excess buffers: */
+	for(std::vector<void*>::iterator ebIt=excessBuffers.begin();ebIt!=excessBuffers.end();++ebIt)
+		deleteBuffer(*ebIt);
+	}
+
+FrameBufferPool::Statistics FrameBufferPool::getStatistics(void) const
+	{
+	Threads::Mutex::Lock poolLock(poolMutex);
+	return statistics;
+	}
+
+void FrameBufferPool::resetStatistics(void)
+	{
+	Threads::Mutex::Lock poolLock(poolMutex);
+	statistics.numHits=0;
+	statistics.numMisses=0;
+	statistics.numDiscards=0;
+	}
+
+void FrameBufferPool::trim(void)
+	{
+	/* Delete all recycled buffers by temporarily not allowing any: */
+	unsigned int oldMaxNumFreeBuffers=maxNumFreeBuffers;
+	setMaxNumFreeBuffers(0);
+	{
+	Threads::Mutex::Lock poolLock(poolMutex);
+	maxNumFreeBuffers=oldMaxNumFreeBuffers;
+	}
+	}
+
+}
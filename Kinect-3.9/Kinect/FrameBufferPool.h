@@ -0,0 +1,106 @@
+/***********************************************************************
+FrameBufferPool - Class to recycle the memory of orphaned frame buffers
+to avoid allocating new memory for every decoded frame.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef KINECT_FRAMEBUFFERPOOL_INCLUDED
+#define KINECT_FRAMEBUFFERPOOL_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+#include <Misc/Autopointer.h>
+#include <Threads/Mutex.h>
+#include <Threads/RefCounted.h>
+#include <Kinect/FrameBuffer.h>
+
+namespace Kinect {
+
+class FrameBufferPool:public Threads::RefCounted
+	{
+	friend class FrameBuffer;
+	
+	/* Embedded classes: */
+	public:
+	struct Statistics // Structure reporting a pool's usage
+		{
+		/* Elements: */
+		public:
+		size_t numHits; // Number of allocations that were served from recycled buffers
+		size_t numMisses; // Number of allocations that had to allocate new memory
+		size_t numDiscards; // Number of orphaned buffers that were deleted because the pool already held enough recycled buffers of their size
+		size_t numUsedBuffers; // Number of buffers allocated from the pool that are currently in use
+		size_t numFreeBuffers; // Number of recycled buffers currently held by the pool
+		size_t freeBufferSize; // Total size of recycled buffers currently held by the pool in bytes
+		
+		/* Constructors and destructors: */
+		Statistics(void)
+			:numHits(0),numMisses(0),numDiscards(0),
+			 numUsedBuffers(0),numFreeBuffers(0),freeBufferSize(0)
+			{
+			}
+		};
+	
+	private:
+	struct SizeClass // Structure holding recycled buffers of the same size
+		{
+		/* Elements: */
+		public:
+		size_t bufferSize; // Size of the buffers in bytes, not including their headers
+		std::vector<void*> freeBuffers; // List of recycled buffers
+		};
+	
+	/* Elements: */
+	unsigned int maxNumFreeBuffers; // Maximum number of recycled buffers held for each buffer size
+	mutable Threads::Mutex poolMutex; // Mutex serializing access to the pool's state
+	std::vector<SizeClass> sizeClasses; // List of recycled buffers, grouped by buffer size
+	Statistics statistics; // The pool's current usage statistics
+	
+	/* Private methods: */
+	static void deleteBuffer(void* buffer); // Deletes the given buffer and its header
+	void recycleBuffer(void* buffer); // Returns an orphaned buffer to the pool
+	
+	/* Constructors and destructors: */
+	public:
+	FrameBufferPool(unsigned int sMaxNumFreeBuffers =4); // Creates an empty pool holding at most the given number of recycled buffers per buffer size
+	private:
+	FrameBufferPool(const FrameBufferPool& source); // Prohibit copy constructor
+	FrameBufferPool& operator=(const FrameBufferPool& source); // Prohibit assignment operator
+	public:
+	virtual ~FrameBufferPool(void); // Destroys the pool and all recycled buffers; only called after all buffers allocated from the pool have been orphaned
+	
+	/* Methods: */
+	static FrameBufferPool& getDefaultPool(void); // Returns the pool shared by all frame sources
+	FrameBuffer allocate(int sizeX,int sizeY,size_t bufferSize); // Returns a frame buffer of the given frame size and size in bytes, recycling an orphaned buffer if possible
+	unsigned int getMaxNumFreeBuffers(void) const // Returns the maximum number of recycled buffers held for each buffer size
+		{
+		return maxNumFreeBuffers;
+		}
+	void setMaxNumFreeBuffers(unsigned int newMaxNumFreeBuffers); // Sets the maximum number of recycled buffers held for each buffer size, and deletes excess recycled buffers
+	Statistics getStatistics(void) const; // Returns the pool's current usage statistics
+	void resetStatistics(void); // Resets the pool's hit, miss, and discard counters
+	void trim(void); // Deletes all recycled buffers currently held by the pool
+	};
+
+typedef Misc::Autopointer<FrameBufferPool> FrameBufferPoolPtr; // Type for pointers to frame buffer pools
+
+}
+
+#endif
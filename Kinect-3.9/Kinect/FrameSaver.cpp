@@ -2,7 +2,7 @@
 FrameSaver - Helper class to save raw color and video frames from a
 Kinect camera to a time-stamped file on disk for playback and further
 processing.
-Copyright (c) 2010-2018 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -46,7 +46,7 @@ namespace Kinect {
 Methods of class FrameSaver:
 ***************************/
 
-void FrameSaver::initialize(FrameSource& frameSource)
+void FrameSaver::initialize(FrameSource& frameSource,ColorFrameWriter::Codec colorCodec)
 	{
 	/* Write the file formats' version numbers to the depth and color files: */
 	colorFrameFile->write<Misc::UInt32>(1);
@@ -95,7 +95,7 @@ void FrameSaver::initialize(FrameSource& frameSource)
 	Misc::Marshaller<FrameSource::ExtrinsicParameters>::write(eps,*depthFrameFile);
 	
 	/* Create the color and depth frame writers: */
-	colorFrameWriter=new ColorFrameWriter(*colorFrameFile,frameSource.getActualFrameSize(FrameSource::COLOR),frameSource.getColorSpace());
+	colorFrameWriter=new ColorFrameWriter(*colorFrameFile,frameSource.getActualFrameSize(FrameSource::COLOR),frameSource.getColorSpace(),colorCodec);
 	#if KINECT_FRAMESAVER_LOSSY
 	depthFrameWriter=new LossyDepthFrameWriter(*depthFrameFile,frameSource.getActualFrameSize(FrameSource::DEPTH));
 	#else
@@ -161,7 +161,7 @@ void* FrameSaver::depthFrameWritingThreadMethod(void)
 	return 0;
 	}
 
-FrameSaver::FrameSaver(FrameSource& frameSource,const char* colorFrameFileName,const char* depthFrameFileName)
+FrameSaver::FrameSaver(FrameSource& frameSource,const char* colorFrameFileName,const char* depthFrameFileName,ColorFrameWriter::Codec colorCodec)
 	:timeStampOffset(0.0),
 	 done(false),
 	 colorFrameFile(IO::openFile(colorFrameFileName,IO::File::WriteOnly)),
@@ -174,10 +174,10 @@ FrameSaver::FrameSaver(FrameSource& frameSource,const char* colorFrameFileName,c
 	depthFrameFile->setEndianness(Misc::LittleEndian);
 	
 	/* Initialize the frame saver: */
-	initialize(frameSource);
+	initialize(frameSource,colorCodec);
 	}
 
-FrameSaver::FrameSaver(FrameSource& frameSource,IO::FilePtr sColorFrameFile,IO::FilePtr sDepthFrameFile)
+FrameSaver::FrameSaver(FrameSource& frameSource,IO::FilePtr sColorFrameFile,IO::FilePtr sDepthFrameFile,ColorFrameWriter::Codec colorCodec)
 	:timeStampOffset(0.0),
 	 done(false),
 	 colorFrameFile(sColorFrameFile),
@@ -186,7 +186,7 @@ FrameSaver::FrameSaver(FrameSource& frameSource,IO::FilePtr sColorFrameFile,IO::
 	 depthFrameWriter(0)
 	{
 	/* Initialize the frame saver: */
-	initialize(frameSource);
+	initialize(frameSource,colorCodec);
 	}
 
 FrameSaver::~FrameSaver(void)
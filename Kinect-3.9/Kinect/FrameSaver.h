@@ -2,7 +2,7 @@
 FrameSaver - Helper class to save raw color and video frames from a
 Kinect frame source to a set of time-stamped files for playback and
 further processing.
-Copyright (c) 2010-2015 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -31,6 +31,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Threads/MutexCond.h>
 #include <Threads/Thread.h>
 #include <Kinect/FrameBuffer.h>
+#include <Kinect/ColorFrameWriter.h>
 
 /* Forward declarations: */
 namespace Kinect {
@@ -58,14 +59,14 @@ class FrameSaver
 	Threads::Thread depthFrameWritingThread; // Thread saving depth frames
 	
 	/* Private methods: */
-	void initialize(FrameSource& frameSource); // Initializes the frame files and writers
+	void initialize(FrameSource& frameSource,ColorFrameWriter::Codec colorCodec); // Initializes the frame files and writers
 	void* colorFrameWritingThreadMethod(void); // Thread method saving color frames
 	void* depthFrameWritingThreadMethod(void); // Thread method saving depth frames
 	
 	/* Constructors and destructors: */
 	public:
-	FrameSaver(FrameSource& frameSource,const char* colorFrameFileName,const char* depthFrameFileName); // Creates frame saver for the given frame source, writing to two files of the given names
-	FrameSaver(FrameSource& frameSource,IO::FilePtr sColorFrameFile,IO::FilePtr sDepthFrameFile); // Ditto, to the two already opened files
+	FrameSaver(FrameSource& frameSource,const char* colorFrameFileName,const char* depthFrameFileName,ColorFrameWriter::Codec colorCodec =ColorFrameWriter::DEFAULT_CODEC); // Creates frame saver for the given frame source, writing to two files of the given names and compressing color frames with the given codec
+	FrameSaver(FrameSource& frameSource,IO::FilePtr sColorFrameFile,IO::FilePtr sDepthFrameFile,ColorFrameWriter::Codec colorCodec =ColorFrameWriter::DEFAULT_CODEC); // Ditto, to the two already opened files
 	~FrameSaver(void);
 	
 	/* Methods: */
@@ -0,0 +1,581 @@
+/***********************************************************************
+ColorTileCodec - Class for an intra-only color frame codec that splits
+Y'CbCr 4:2:0 frames into independently compressed tiles, which can be
+encoded and decoded in parallel and without reference to other frames.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Kinect/Internal/ColorTileCodec.h>
+
+#include <unistd.h>
+#include <Misc/ThrowStdErr.h>
+#include <IO/File.h>
+#include <Math/Math.h>
+#include <Kinect/Internal/YpCbCr420Conversion.h>
+
+namespace Kinect {
+
+namespace {
+
+/***********************************************************************
+Each tile is compressed as three Y'CbCr 4:2:0 planes, each predicted
+pixel by pixel from its already reconstructed neighbors using the
+median edge detector of LOCO-I / JPEG-LS. Prediction residuals are
+optionally quantized to a maximum absolute error, and are entropy-coded
+with Golomb-Rice codes whose parameters adapt per local-activity
+context. All coding state is reset at the start of each tile.
+***********************************************************************/
+
+static const unsigned int numContexts=11; // Number of local activity contexts, indexed by the number of significant bits of the activity
+static const unsigned int unaryLimit=24; // Maximum length of unary code prefixes before switching to escape codes
+static const unsigned int escapeBits=9; // Number of bits of escape-coded mapped residuals
+
+/**************
+Helper classes:
+**************/
+
+class BitWriter // Class to write variable-length codes into a byte buffer
+	{
+	/* Elements: */
+	private:
+	std::vector<Misc::UInt8>& data; // Buffer receiving completed bytes
+	Misc::UInt64 buffer; // Bit buffer holding not yet written bits in its least significant bits
+	unsigned int numBits; // Number of not yet written bits in the bit buffer
+	
+	/* Constructors and destructors: */
+	public:
+	BitWriter(std::vector<Misc::UInt8>& sData)
+		:data(sData),buffer(0),numBits(0)
+		{
+		}
+	
+	/* Methods: */
+	void write(unsigned int bits,unsigned int count) // Writes the given number of least significant bits, up to 32
+		{
+		buffer=(buffer<<count)|bits;
+		numBits+=count;
+		while(numBits>=8)
+			{
+			numBits-=8;
+			data.push_back(Misc::UInt8(buffer>>numBits));
+			}
+		}
+	void flush(void) // Writes any remaining bits, padded with zeros to a full byte
+		{
+		if(numBits>0)
+			{
+			data.push_back(Misc::UInt8(buffer<<(8-numBits)));
+			numBits=0;
+			}
+		}
+	};
+
+class BitReader // Class to read variable-length codes from a byte buffer; returns zero bits past the end of the buffer
+	{
+	/* Elements: */
+	private:
+	const Misc::UInt8* dataPtr; // Pointer to the next unread byte
+	const Misc::UInt8* dataEnd; // Pointer to the end of the buffer
+	Misc::UInt64 buffer; // Bit buffer holding unread bits in its most significant bits
+	unsigned int numBits; // Number of unread bits in the bit buffer
+	
+	/* Private methods: */
+	void refill(void) // Fills the bit buffer with at least 57 bits
+		{
+		while(numBits<=56)
+			{
+			Misc::UInt64 byte=dataPtr!=dataEnd?*(dataPtr++):0U;
+			buffer|=byte<<(56-numBits);
+			numBits+=8;
+			}
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	BitReader(const Misc::UInt8* sData,size_t sDataSize)
+		:dataPtr(sData),dataEnd(sData+sDataSize),buffer(0),numBits(0)
+		{
+		}
+	
+	/* Methods: */
+	unsigned int read(unsigned int count) // Reads the given number of bits, up to 32
+		{
+		if(count==0)
+			return 0;
+		if(numBits<count)
+			refill();
+		unsigned int result=(unsigned int)(buffer>>(64-count));
+		buffer<<=count;
+		numBits-=count;
+		return result;
+		}
+	unsigned int readUnary(void) // Reads a unary code of zero bits terminated by a one bit; returns unaryLimit for escape codes
+		{
+		refill();
+		unsigned int numZeros=buffer!=0?(unsigned int)(__builtin_clzll(buffer)):64U;
+		if(numZeros>=unaryLimit)
+			{
+			/* Consume the escape prefix: */
+			buffer<<=unaryLimit;
+			numBits-=unaryLimit;
+			return unaryLimit;
+			}
+		
+		/* Consume the zero bits and the terminating one bit: */
+		buffer<<=numZeros+1;
+		numBits-=numZeros+1;
+		return numZeros;
+		}
+	};
+
+class ContextState // Class holding adaptive Golomb-Rice coding parameters for all contexts of a plane
+	{
+	/* Elements: */
+	private:
+	unsigned int sums[numContexts]; // Accumulated absolute residuals per context
+	unsigned int counts[numContexts]; // Number of coded residuals per context
+	
+	/* Constructors and destructors: */
+	public:
+	ContextState(void)
+		{
+		for(unsigned int i=0;i<numContexts;++i)
+			{
+			sums[i]=4;
+			counts[i]=1;
+			}
+		}
+	
+	/* Methods: */
+	unsigned int getK(unsigned int context) const // Returns the Golomb-Rice parameter for the given context
+		{
+		unsigned int k=0;
+		while((counts[context]<<k)<sums[context])
+			++k;
+		return k;
+		}
+	void update(unsigned int context,int residual) // Updates the given context after coding the given residual
+		{
+		sums[context]+=Math::abs(residual);
+		if(++counts[context]>=64)
+			{
+			sums[context]>>=1;
+			counts[context]>>=1;
+			}
+		}
+	};
+
+/****************
+Helper functions:
+****************/
+
+inline int predict(int a,int b,int c) // Returns the median edge detector prediction for a pixel
+	{
+	int minAB=a<b?a:b;
+	int maxAB=a<b?b:a;
+	if(c>=maxAB)
+		return minAB;
+	else if(c<=minAB)
+		return maxAB;
+	else
+		return a+b-c;
+	}
+
+inline unsigned int getContext(int a,int b,int c,int d) // Returns the local activity context of a pixel
+	{
+	unsigned int activity=Math::abs(d-b)+Math::abs(b-c)+Math::abs(c-a);
+	unsigned int context=activity!=0?32U-(unsigned int)(__builtin_clz(activity)):0U;
+	return context<numContexts-1?context:numContexts-1;
+	}
+
+inline int reconstruct(int prediction,int residual,int step) // Returns the reconstructed pixel value for a prediction and quantized residual
+	{
+	int result=prediction+residual*step;
+	return result<0?0:result>255?255:result;
+	}
+
+class PlaneEncoder // Class to compress a plane, replacing it with its reconstruction
+	{
+	/* Elements: */
+	private:
+	ContextState contexts; // Adaptive coding parameters
+	int quantization; // Maximum absolute reconstruction error
+	int step; // Quantization step size
+	BitWriter& writer; // Writer for compressed data
+	
+	/* Constructors and destructors: */
+	public:
+	PlaneEncoder(unsigned int sQuantization,BitWriter& sWriter)
+		:quantization(int(sQuantization)),step(2*int(sQuantization)+1),writer(sWriter)
+		{
+		}
+	
+	/* Methods: */
+	void codePixel(Misc::UInt8& pixel,int a,int b,int c,int d) // Compresses a pixel given its left, upper, upper-left, and upper-right neighbors
+		{
+		/* Predict the pixel from its neighbors: */
+		int prediction=predict(a,b,c);
+		unsigned int context=getContext(a,b,c,d);
+		
+		/* Quantize the prediction residual and replace the pixel with its reconstruction: */
+		int residual=int(pixel)-prediction;
+		if(quantization!=0)
+			{
+			residual=residual>=0?(residual+quantization)/step:-((quantization-residual)/step);
+			pixel=Misc::UInt8(reconstruct(prediction,residual,step));
+			}
+		
+		/* Encode the mapped residual: */
+		unsigned int mapped=residual>=0?(unsigned int)(residual)*2U:(unsigned int)(-residual)*2U-1U;
+		unsigned int k=contexts.getK(context);
+		unsigned int prefix=mapped>>k;
+		if(prefix<unaryLimit)
+			{
+			writer.write(1U,prefix+1);
+			writer.write(mapped&((1U<<k)-1U),k);
+			}
+		else
+			{
+			writer.write(0U,unaryLimit);
+			writer.write(mapped,escapeBits);
+			}
+		contexts.update(context,residual);
+		}
+	};
+
+class PlaneDecoder // Class to decompress a plane
+	{
+	/* Elements: */
+	private:
+	ContextState contexts; // Adaptive coding parameters
+	int step; // Quantization step size
+	BitReader& reader; // Reader for compressed data
+	
+	/* Constructors and destructors: */
+	public:
+	PlaneDecoder(unsigned int sQuantization,BitReader& sReader)
+		:step(2*int(sQuantization)+1),reader(sReader)
+		{
+		}
+	
+	/* Methods: */
+	void codePixel(Misc::UInt8& pixel,int a,int b,int c,int d) // Decompresses a pixel given its left, upper, upper-left, and upper-right neighbors
+		{
+		/* Predict the pixel from its neighbors: */
+		int prediction=predict(a,b,c);
+		unsigned int context=getContext(a,b,c,d);
+		
+		/* Decode the mapped residual: */
+		unsigned int k=contexts.getK(context);
+		unsigned int prefix=reader.readUnary();
+		unsigned int mapped;
+		if(prefix<unaryLimit)
+			mapped=(prefix<<k)|reader.read(k);
+		else
+			mapped=reader.read(escapeBits);
+		int residual=(mapped&0x1U)?-int((mapped+1U)>>1):int(mapped>>1);
+		
+		/* Reconstruct the pixel: */
+		pixel=Misc::UInt8(reconstruct(prediction,residual,step));
+		contexts.update(context,residual);
+		}
+	};
+
+template <class PlaneCoderParam>
+inline void codePlane(Misc::UInt8* plane,ptrdiff_t stride,unsigned int width,unsigned int height,PlaneCoderParam& coder) // Compresses or decompresses a plane in scan order, replicating neighbors across tile edges
+	{
+	/* Code the first row from left neighbors only: */
+	Misc::UInt8* row=plane;
+	int left=128;
+	for(unsigned int x=0;x<width;++x)
+		{
+		coder.codePixel(row[x],left,left,left,left);
+		left=row[x];
+		}
+	
+	/* Code the remaining rows: */
+	for(unsigned int y=1;y<height;++y)
+		{
+		Misc::UInt8* prevRow=row;
+		row+=stride;
+		
+		/* Code the first pixel, whose left neighbors are replicated from the pixel above: */
+		int up=prevRow[0];
+		coder.codePixel(row[0],up,up,up,width>1?int(prevRow[1]):up);
+		
+		/* Code the interior pixels: */
+		unsigned int x;
+		for(x=1;x+1<width;++x)
+			coder.codePixel(row[x],row[x-1],prevRow[x],prevRow[x-1],prevRow[x+1]);
+		
+		/* Code the last pixel, whose upper-right neighbor is replicated from the pixel above: */
+		if(x<width)
+			coder.codePixel(row[x],row[x-1],prevRow[x],prevRow[x-1],prevRow[x]);
+		}
+	}
+
+unsigned int getDefaultNumThreads(void)
+	{
+	/* Use up to four of the host's CPUs: */
+	long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+	return numCpus>=4?4U:numCpus>=1?(unsigned int)(numCpus):1U;
+	}
+
+}
+
+/***************************************
+Static elements of class ColorTileCodec:
+***************************************/
+
+const Misc::UInt32 ColorTileCodec::streamTag;
+
+/*******************************
+Methods of class ColorTileCodec:
+*******************************/
+
+void ColorTileCodec::encodeTile(ColorTileCodec::Tile& tile,ColorTileCodec::WorkBuffer& buffer)
+	{
+	/* Convert the tile to Y'CbCr 4:2:0, flipping it vertically: */
+	const FrameSource::ColorPixel* framePtr=inputFrame+(size[1]-1-tile.origin[1])*size[0]+tile.origin[0];
+	ptrdiff_t frameStride=-ptrdiff_t(size[0]);
+	ptrdiff_t cStride=tileSize/2;
+	if(colorSpace==FrameSource::RGB)
+		convertRgbToYpCbCr420(framePtr,frameStride,tile.size[0],tile.size[1],buffer.planes[0],tileSize,buffer.planes[1],cStride,buffer.planes[2],cStride);
+	else
+		convertYpCbCr444ToYpCbCr420(framePtr,frameStride,tile.size[0],tile.size[1],buffer.planes[0],tileSize,buffer.planes[1],cStride,buffer.planes[2],cStride);
+	
+	/* Compress the three planes: */
+	tile.data.clear();
+	BitWriter writer(tile.data);
+	{
+	PlaneEncoder encoder(quantization,writer);
+	codePlane(buffer.planes[0],tileSize,tile.size[0],tile.size[1],encoder);
+	}
+	for(int i=1;i<3;++i)
+		{
+		PlaneEncoder encoder(quantization,writer);
+		codePlane(buffer.planes[i],cStride,tile.size[0]/2,tile.size[1]/2,encoder);
+		}
+	writer.flush();
+	}
+
+void ColorTileCodec::decodeTile(const ColorTileCodec::Tile& tile,ColorTileCodec::WorkBuffer& buffer)
+	{
+	/* Decompress the three planes: */
+	ptrdiff_t cStride=tileSize/2;
+	BitReader reader(tile.data.empty()?0:&tile.data[0],tile.data.size());
+	{
+	PlaneDecoder decoder(quantization,reader);
+	codePlane(buffer.planes[0],tileSize,tile.size[0],tile.size[1],decoder);
+	}
+	for(int i=1;i<3;++i)
+		{
+		PlaneDecoder decoder(quantization,reader);
+		codePlane(buffer.planes[i],cStride,tile.size[0]/2,tile.size[1]/2,decoder);
+		}
+	
+	/* Convert the tile from Y'CbCr 4:2:0 into the frame, flipping it vertically: */
+	FrameSource::ColorPixel* framePtr=outputFrame+(size[1]-1-tile.origin[1])*size[0]+tile.origin[0];
+	ptrdiff_t frameStride=-ptrdiff_t(size[0]);
+	if(colorSpace==FrameSource::RGB)
+		convertYpCbCr420ToRgb(buffer.planes[0],tileSize,buffer.planes[1],cStride,buffer.planes[2],cStride,tile.size[0],tile.size[1],framePtr,frameStride);
+	else
+		convertYpCbCr420ToYpCbCr444(buffer.planes[0],tileSize,buffer.planes[1],cStride,buffer.planes[2],cStride,tile.size[0],tile.size[1],framePtr,frameStride);
+	}
+
+bool ColorTileCodec::processTiles(unsigned int threadIndex)
+	{
+	/* Wait for the start of the next frame: */
+	tileBarrier.synchronize();
+	if(shutdownWorkers)
+		return false;
+	
+	/* Process every numThreads-th tile: */
+	for(size_t i=threadIndex;i<tiles.size();i+=numThreads)
+		{
+		if(operation==ENCODE)
+			encodeTile(tiles[i],workBuffers[threadIndex]);
+		else
+			decodeTile(tiles[i],workBuffers[threadIndex]);
+		}
+	
+	/* Wait until all tiles are complete: */
+	tileBarrier.synchronize();
+	
+	return true;
+	}
+
+void* ColorTileCodec::workerThreadMethod(unsigned int threadIndex)
+	{
+	/* Process frames until shut down: */
+	while(processTiles(threadIndex))
+		;
+	
+	return 0;
+	}
+
+ColorTileCodec::ColorTileCodec(const unsigned int sSize[2],unsigned int sTileSize,unsigned int sQuantization,unsigned int sNumThreads)
+	:tileSize(sTileSize),quantization(sQuantization),
+	 numThreads(sNumThreads),workBuffers(0),workerThreads(0),
+	 shutdownWorkers(false),operation(ENCODE),colorSpace(FrameSource::RGB),
+	 inputFrame(0),outputFrame(0)
+	{
+	/* Check the codec parameters: */
+	for(int i=0;i<2;++i)
+		{
+		size[i]=sSize[i];
+		if(size[i]==0||size[i]%2!=0)
+			Misc::throwStdErr("Kinect::ColorTileCodec: Invalid frame size %ux%u",sSize[0],sSize[1]);
+		}
+	if(tileSize<2||tileSize%2!=0||tileSize>4096)
+		Misc::throwStdErr("Kinect::ColorTileCodec: Invalid tile size %u",tileSize);
+	if(quantization>63)
+		Misc::throwStdErr("Kinect::ColorTileCodec: Invalid quantization %u",quantization);
+	
+	/* Split the frame into tiles: */
+	for(int i=0;i<2;++i)
+		numTiles[i]=(size[i]+tileSize-1)/tileSize;
+	tiles.resize(numTiles[1]*numTiles[0]);
+	std::vector<Tile>::iterator tIt=tiles.begin();
+	for(unsigned int ty=0;ty<numTiles[1];++ty)
+		for(unsigned int tx=0;tx<numTiles[0];++tx,++tIt)
+			{
+			tIt->origin[0]=tx*tileSize;
+			tIt->origin[1]=ty*tileSize;
+			for(int i=0;i<2;++i)
+				tIt->size[i]=size[i]-tIt->origin[i]<tileSize?size[i]-tIt->origin[i]:tileSize;
+			}
+	
+	/* Create one tile plane buffer per thread: */
+	if(numThreads==0)
+		numThreads=getDefaultNumThreads();
+	if(numThreads>tiles.size())
+		numThreads=tiles.size();
+	workBuffers=new WorkBuffer[numThreads];
+	size_t ypSize=size_t(tileSize)*size_t(tileSize);
+	for(unsigned int i=0;i<numThreads;++i)
+		{
+		workBuffers[i].planes[0]=new Misc::UInt8[ypSize+ypSize/2];
+		workBuffers[i].planes[1]=workBuffers[i].planes[0]+ypSize;
+		workBuffers[i].planes[2]=workBuffers[i].planes[1]+ypSize/4;
+		}
+	
+	/* Start the worker threads; the calling thread processes the first share of tiles: */
+	tileBarrier.setNumSynchronizingThreads(numThreads);
+	if(numThreads>1)
+		{
+		workerThreads=new Threads::Thread[numThreads-1];
+		for(unsigned int i=1;i<numThreads;++i)
+			workerThreads[i-1].start(this,&ColorTileCodec::workerThreadMethod,i);
+		}
+	}
+
+ColorTileCodec::~ColorTileCodec(void)
+	{
+	if(workerThreads!=0)
+		{
+		/* Shut down the worker threads: */
+		shutdownWorkers=true;
+		tileBarrier.synchronize();
+		for(unsigned int i=1;i<numThreads;++i)
+			workerThreads[i-1].join();
+		delete[] workerThreads;
+		}
+	
+	/* Release allocated resources: */
+	for(unsigned int i=0;i<numThreads;++i)
+		delete[] workBuffers[i].planes[0];
+	delete[] workBuffers;
+	}
+
+ColorTileCodec* ColorTileCodec::readHeader(IO::File& source,const unsigned int sSize[2],unsigned int sNumThreads)
+	{
+	/* Read the codec parameters and create a codec: */
+	unsigned int tileSize=source.read<Misc::UInt32>();
+	unsigned int quantization=source.read<Misc::UInt32>();
+	return new ColorTileCodec(sSize,tileSize,quantization,sNumThreads);
+	}
+
+void ColorTileCodec::writeHeader(IO::File& sink) const
+	{
+	/* Write the stream tag and codec parameters: */
+	sink.write<Misc::UInt32>(streamTag);
+	sink.write<Misc::UInt32>(tileSize);
+	sink.write<Misc::UInt32>(quantization);
+	}
+
+size_t ColorTileCodec::encodeFrame(const FrameSource::ColorPixel* newFrame,FrameSource::ColorSpace newColorSpace,IO::File& sink)
+	{
+	/* Compress all tiles with the help of all worker threads: */
+	operation=ENCODE;
+	colorSpace=newColorSpace;
+	inputFrame=newFrame;
+	processTiles(0);
+	inputFrame=0;
+	
+	/* Write the compressed tile sizes followed by the compressed tiles: */
+	size_t result=0;
+	for(std::vector<Tile>::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+		{
+		sink.write<Misc::UInt32>(Misc::UInt32(tIt->data.size()));
+		result+=sizeof(Misc::UInt32)+tIt->data.size();
+		}
+	for(std::vector<Tile>::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+		if(!tIt->data.empty())
+			sink.write(&tIt->data[0],tIt->data.size());
+	
+	return result;
+	}
+
+void ColorTileCodec::decodeFrame(IO::File& source,FrameSource::ColorSpace newColorSpace,FrameSource::ColorPixel* newFrame)
+	{
+	/* Read the compressed tile sizes and check them against a generous upper bound of eight bytes per pixel: */
+	for(std::vector<Tile>::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+		{
+		size_t dataSize=source.read<Misc::UInt32>();
+		size_t maxDataSize=size_t(tIt->size[1])*size_t(tIt->size[0])*8;
+		if(dataSize>maxDataSize)
+			Misc::throwStdErr("Kinect::ColorTileCodec::decodeFrame: Corrupted tile in compressed color frame");
+		tIt->data.resize(dataSize);
+		}
+	
+	/* Read the compressed tiles: */
+	for(std::vector<Tile>::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+		if(!tIt->data.empty())
+			source.read(&tIt->data[0],tIt->data.size());
+	
+	/* Decompress all tiles with the help of all worker threads: */
+	operation=DECODE;
+	colorSpace=newColorSpace;
+	outputFrame=newFrame;
+	processTiles(0);
+	outputFrame=0;
+	}
+
+void ColorTileCodec::skipFrame(IO::File& source) const
+	{
+	/* Read the compressed tile sizes and skip the compressed tiles: */
+	size_t dataSize=0;
+	for(size_t i=0;i<tiles.size();++i)
+		dataSize+=source.read<Misc::UInt32>();
+	source.skip<Misc::UInt8>(dataSize);
+	}
+
+}
@@ -0,0 +1,125 @@
+/***********************************************************************
+ColorTileCodec - Class for an intra-only color frame codec that splits
+Y'CbCr 4:2:0 frames into independently compressed tiles, which can be
+encoded and decoded in parallel and without reference to other frames.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef KINECT_INTERNAL_COLORTILECODEC_INCLUDED
+#define KINECT_INTERNAL_COLORTILECODEC_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+#include <Misc/SizedTypes.h>
+#include <Threads/Thread.h>
+#include <Threads/Barrier.h>
+#include <Kinect/FrameSource.h>
+
+/* Forward declarations: */
+namespace IO {
+class File;
+}
+
+namespace Kinect {
+
+class ColorTileCodec
+	{
+	/* Embedded classes: */
+	public:
+	static const Misc::UInt32 streamTag=0x454c4954U; // Value written in place of a color stream's Theora header size to mark a tile-compressed color stream
+	
+	private:
+	struct Tile // Structure describing a rectangular frame tile
+		{
+		/* Elements: */
+		public:
+		unsigned int origin[2]; // Position of the tile's top-left corner in the top-down Y'CbCr frame
+		unsigned int size[2]; // Size of the tile in pixels
+		std::vector<Misc::UInt8> data; // Compressed tile data
+		};
+	
+	struct WorkBuffer // Structure holding a thread's Y'CbCr 4:2:0 tile planes
+		{
+		/* Elements: */
+		public:
+		Misc::UInt8* planes[3]; // Y', Cb, and Cr planes
+		};
+	
+	enum Operation // Enumerated type for operations run by the worker threads
+		{
+		ENCODE,DECODE
+		};
+	
+	/* Elements: */
+	unsigned int size[2]; // Frame size in pixels
+	unsigned int tileSize; // Width and height of full tiles in pixels
+	unsigned int quantization; // Maximum absolute reconstruction error per Y'CbCr component; 0 for lossless compression of the Y'CbCr 4:2:0 frame
+	unsigned int numTiles[2]; // Number of tiles horizontally and vertically
+	std::vector<Tile> tiles; // List of tiles in row-major order
+	
+	/* Multithreading state: */
+	unsigned int numThreads; // Number of threads encoding or decoding tiles, including the caller's thread
+	WorkBuffer* workBuffers; // Array of tile plane buffers, one per thread
+	Threads::Thread* workerThreads; // Array of background worker threads; the caller's thread is thread 0
+	Threads::Barrier tileBarrier; // Barrier to synchronize threads at the beginning and end of each frame
+	volatile bool shutdownWorkers; // Flag to shut down the worker threads
+	Operation operation; // Operation to run on the current frame
+	FrameSource::ColorSpace colorSpace; // Color space of the encoded frame, or requested color space of the decoded frame
+	const FrameSource::ColorPixel* inputFrame; // Frame currently being encoded
+	FrameSource::ColorPixel* outputFrame; // Frame currently being decoded
+	
+	/* Private methods: */
+	void encodeTile(Tile& tile,WorkBuffer& buffer); // Compresses the given tile of the current frame
+	void decodeTile(const Tile& tile,WorkBuffer& buffer); // Decompresses the given tile into the current frame
+	bool processTiles(unsigned int threadIndex); // Runs the current operation on the given thread's share of tiles, synchronizing with the other threads; returns false if worker threads are shutting down
+	void* workerThreadMethod(unsigned int threadIndex); // Thread method for background worker threads
+	
+	/* Constructors and destructors: */
+	public:
+	ColorTileCodec(const unsigned int sSize[2],unsigned int sTileSize,unsigned int sQuantization,unsigned int sNumThreads =0); // Creates a codec for frames of the given size using the given tile size, quantization, and number of threads; uses up to four of the host's CPUs if the number of threads is zero
+	private:
+	ColorTileCodec(const ColorTileCodec& source); // Prohibit copy constructor
+	ColorTileCodec& operator=(const ColorTileCodec& source); // Prohibit assignment operator
+	public:
+	~ColorTileCodec(void);
+	
+	/* Methods: */
+	static ColorTileCodec* readHeader(IO::File& source,const unsigned int sSize[2],unsigned int sNumThreads =0); // Creates a codec from stream parameters written by writeHeader, after the stream tag has been read
+	void writeHeader(IO::File& sink) const; // Writes the stream tag and codec parameters to the given sink
+	unsigned int getTileSize(void) const // Returns the tile size
+		{
+		return tileSize;
+		}
+	unsigned int getQuantization(void) const // Returns the quantization
+		{
+		return quantization;
+		}
+	unsigned int getNumThreads(void) const // Returns the number of threads encoding or decoding tiles
+		{
+		return numThreads;
+		}
+	size_t encodeFrame(const FrameSource::ColorPixel* newFrame,FrameSource::ColorSpace newColorSpace,IO::File& sink); // Compresses the given frame of the given color space and writes it to the given sink; returns number of bytes written
+	void decodeFrame(IO::File& source,FrameSource::ColorSpace newColorSpace,FrameSource::ColorPixel* newFrame); // Reads a compressed frame from the given source and decompresses it into the given frame in the given color space
+	void skipFrame(IO::File& source) const; // Skips a compressed frame in the given source
+	};
+
+}
+
+#endif
@@ -0,0 +1,447 @@
+/***********************************************************************
+KinectV1FrameDecoder - Functions to decode raw color and depth frames
+received from first-generation Kinect cameras.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Kinect/Internal/KinectV1FrameDecoder.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+namespace Kinect {
+
+namespace {
+
+/***********************************
+Helper functions for Bayer decoding:
+***********************************/
+
+typedef FrameSource::ColorComponent ColorComponent;
+
+inline ColorComponent avg(ColorComponent v1,ColorComponent v2)
+	{
+	return ColorComponent(((unsigned int)(v1)+(unsigned int)(v2)+1U)>>1);
+	}
+
+inline ColorComponent avg(ColorComponent v1,ColorComponent v2,ColorComponent v3)
+	{
+	return ColorComponent(((unsigned int)(v1)+(unsigned int)(v2)+(unsigned int)(v3)+1U)/3U);
+	}
+
+inline ColorComponent avg(ColorComponent v1,ColorComponent v2,ColorComponent v3,ColorComponent v4)
+	{
+	return ColorComponent(((unsigned int)(v1)+(unsigned int)(v2)+(unsigned int)(v3)+(unsigned int)(v4)+2U)>>2);
+	}
+
+#ifdef __SSE2__
+
+/*****************************************************************
+Vectorized Bayer decoding for the central pixels of central rows,
+processing 16 pixels starting at an odd column at a time. Each
+vector function produces exactly the same results as the scalar
+avg() functions above.
+*****************************************************************/
+
+inline __m128i loadPixels(const ColorComponent* ptr)
+	{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+	}
+
+inline __m128i avg4(__m128i v1,__m128i v2,__m128i v3,__m128i v4)
+	{
+	/* Sum and round in 16 bits: */
+	__m128i zero=_mm_setzero_si128();
+	__m128i two=_mm_set1_epi16(2);
+	__m128i lo=_mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(v1,zero),_mm_unpacklo_epi8(v2,zero)),_mm_add_epi16(_mm_unpacklo_epi8(v3,zero),_mm_unpacklo_epi8(v4,zero)));
+	__m128i hi=_mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(v1,zero),_mm_unpackhi_epi8(v2,zero)),_mm_add_epi16(_mm_unpackhi_epi8(v3,zero),_mm_unpackhi_epi8(v4,zero)));
+	return _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo,two),2),_mm_srli_epi16(_mm_add_epi16(hi,two),2));
+	}
+
+inline __m128i selectBytes(__m128i mask,__m128i ifTrue,__m128i ifFalse)
+	{
+	return _mm_or_si128(_mm_and_si128(mask,ifTrue),_mm_andnot_si128(mask,ifFalse));
+	}
+
+inline void storePixelPairs(__m128i pixels,ColorComponent* cPtr)
+	{
+	/* Squeeze four 32-bit RGBx pixels into two 6-byte pairs and store them with overlapping 8-byte writes: */
+	__m128i pairs=_mm_or_si128(_mm_and_si128(pixels,_mm_set_epi32(0,0x00ffffff,0,0x00ffffff)),_mm_and_si128(_mm_srli_epi64(pixels,8),_mm_set_epi32(0x0000ffff,0xff000000,0x0000ffff,0xff000000)));
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(cPtr),pairs);
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(cPtr+6),_mm_srli_si128(pairs,8));
+	}
+
+inline void storePixels(__m128i r,__m128i g,__m128i b,ColorComponent* cPtr)
+	{
+	/* Interleave the color components into RGBx pixels and store them as RGB; writes two bytes past the 16th pixel: */
+	__m128i zero=_mm_setzero_si128();
+	__m128i rgLo=_mm_unpacklo_epi8(r,g);
+	__m128i rgHi=_mm_unpackhi_epi8(r,g);
+	__m128i bLo=_mm_unpacklo_epi8(b,zero);
+	__m128i bHi=_mm_unpackhi_epi8(b,zero);
+	storePixelPairs(_mm_unpacklo_epi16(rgLo,bLo),cPtr);
+	storePixelPairs(_mm_unpackhi_epi16(rgLo,bLo),cPtr+12);
+	storePixelPairs(_mm_unpacklo_epi16(rgHi,bHi),cPtr+24);
+	storePixelPairs(_mm_unpackhi_epi16(rgHi,bHi),cPtr+36);
+	}
+
+int decodeBGRow(const ColorComponent* rRowPtr,int stride,int width,ColorComponent* cRowPtr)
+	{
+	/* Process runs of (G, B) pixel pairs, leaving at least one pixel for the scalar code to overwrite the last store's spill: */
+	__m128i firstMask=_mm_set1_epi16(0x00ff);
+	int x;
+	for(x=1;x+16<=width-1;x+=16)
+		{
+		const ColorComponent* rPtr=rRowPtr+x;
+		__m128i c=loadPixels(rPtr);
+		__m128i n=loadPixels(rPtr-stride);
+		__m128i s=loadPixels(rPtr+stride);
+		__m128i w=loadPixels(rPtr-1);
+		__m128i e=loadPixels(rPtr+1);
+		__m128i diag=avg4(loadPixels(rPtr-stride-1),loadPixels(rPtr-stride+1),loadPixels(rPtr+stride-1),loadPixels(rPtr+stride+1));
+		__m128i cross=avg4(n,w,e,s);
+		__m128i r=selectBytes(firstMask,_mm_avg_epu8(n,s),diag);
+		__m128i g=selectBytes(firstMask,c,cross);
+		__m128i b=selectBytes(firstMask,_mm_avg_epu8(w,e),c);
+		storePixels(r,g,b,cRowPtr+x*3);
+		}
+	
+	return x;
+	}
+
+int decodeGRRow(const ColorComponent* rRowPtr,int stride,int width,ColorComponent* cRowPtr)
+	{
+	/* Process runs of (R, G) pixel pairs, leaving at least one pixel for the scalar code to overwrite the last store's spill: */
+	__m128i firstMask=_mm_set1_epi16(0x00ff);
+	int x;
+	for(x=1;x+16<=width-1;x+=16)
+		{
+		const ColorComponent* rPtr=rRowPtr+x;
+		__m128i c=loadPixels(rPtr);
+		__m128i n=loadPixels(rPtr-stride);
+		__m128i s=loadPixels(rPtr+stride);
+		__m128i w=loadPixels(rPtr-1);
+		__m128i e=loadPixels(rPtr+1);
+		__m128i diag=avg4(loadPixels(rPtr-stride-1),loadPixels(rPtr-stride+1),loadPixels(rPtr+stride-1),loadPixels(rPtr+stride+1));
+		__m128i cross=avg4(n,w,e,s);
+		__m128i r=selectBytes(firstMask,c,_mm_avg_epu8(w,e));
+		__m128i g=selectBytes(firstMask,cross,c);
+		__m128i b=selectBytes(firstMask,diag,_mm_avg_epu8(n,s));
+		storePixels(r,g,b,cRowPtr+x*3);
+		}
+	
+	return x;
+	}
+
+#endif
+
+void decodeBayer(const ColorComponent* rawFrame,int width,int height,ColorComponent* rgbFrame,bool vectorized)
+	{
+	/* Decode the raw color buffer (which is in Bayer GRBG pattern): */
+	int stride=width;
+	const ColorComponent* rRowPtr=rawFrame;
+	ColorComponent* cRowPtr=rgbFrame;
+	cRowPtr+=(height-1)*stride*3; // Flip the color image vertically
+	
+	/* Convert the first row: */
+	const ColorComponent* rPtr=rRowPtr;
+	ColorComponent* cPtr=cRowPtr;
+	
+	/* Convert the first row's first (G) pixel: */
+	*(cPtr++)=rPtr[1];
+	*(cPtr++)=rPtr[0];
+	*(cPtr++)=rPtr[stride];
+	++rPtr;
+	
+	/* Convert the first row's central pixels: */
+	for(int x=1;x<width-1;x+=2)
+		{
+		/* Convert the odd (R) pixel: */
+		*(cPtr++)=rPtr[0];
+		*(cPtr++)=avg(rPtr[-1],rPtr[1],rPtr[stride]);
+		*(cPtr++)=avg(rPtr[stride-1],rPtr[stride+1]);
+		++rPtr;
+		
+		/* Convert the even (G) pixel: */
+		*(cPtr++)=avg(rPtr[-1],rPtr[1]);
+		*(cPtr++)=rPtr[0];
+		*(cPtr++)=rPtr[stride];
+		++rPtr;
+		}
+	
+	/* Convert the first row's last (R) pixel: */
+	*(cPtr++)=rPtr[0];
+	*(cPtr++)=avg(rPtr[-1],rPtr[stride]);
+	*(cPtr++)=rPtr[stride-1];
+	++rPtr;
+	
+	rRowPtr+=stride;
+	cRowPtr-=stride*3;
+	
+	/* Convert the central rows: */
+	for(int y=1;y<height-1;y+=2)
+		{
+		/* Convert the odd row: */
+		rPtr=rRowPtr;
+		cPtr=cRowPtr;
+		
+		/* Convert the odd row's first (B) pixel: */
+		*(cPtr++)=avg(rPtr[-stride+1],rPtr[stride+1]);
+		*(cPtr++)=avg(rPtr[-stride],rPtr[1],rPtr[stride]);
+		*(cPtr++)=rPtr[0];
+		++rPtr;
+		
+		/* Convert the odd row's central pixels: */
+		int x=1;
+		#ifdef __SSE2__
+		if(vectorized)
+			{
+			x=decodeBGRow(rRowPtr,stride,width,cRowPtr);
+			rPtr=rRowPtr+x;
+			cPtr=cRowPtr+x*3;
+			}
+		#endif
+		for(;x<width-1;x+=2)
+			{
+			/* Convert the odd (G) pixel: */
+			*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
+			*(cPtr++)=rPtr[0];
+			*(cPtr++)=avg(rPtr[-1],rPtr[1]);
+			++rPtr;
+			
+			/* Convert the even (B) pixel: */
+			*(cPtr++)=avg(rPtr[-stride-1],rPtr[-stride+1],rPtr[stride-1],rPtr[stride+1]);
+			*(cPtr++)=avg(rPtr[-stride],rPtr[-1],rPtr[1],rPtr[stride]);
+			*(cPtr++)=rPtr[0];
+			++rPtr;
+			}
+		
+		/* Convert the odd row's last (G) pixel: */
+		*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
+		*(cPtr++)=rPtr[0];
+		*(cPtr++)=rPtr[-1];
+		++rPtr;
+		
+		rRowPtr+=stride;
+		cRowPtr-=stride*3;
+		
+		/* Convert the even row: */
+		rPtr=rRowPtr;
+		cPtr=cRowPtr;
+		
+		/* Convert the even row's first (G) pixel: */
+		*(cPtr++)=rPtr[1];
+		*(cPtr++)=rPtr[0];
+		*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
+		++rPtr;
+		
+		/* Convert the even row's central pixels: */
+		x=1;
+		#ifdef __SSE2__
+		if(vectorized)
+			{
+			x=decodeGRRow(rRowPtr,stride,width,cRowPtr);
+			rPtr=rRowPtr+x;
+			cPtr=cRowPtr+x*3;
+			}
+		#endif
+		for(;x<width-1;x+=2)
+			{
+			/* Convert the odd (R) pixel: */
+			*(cPtr++)=rPtr[0];
+			*(cPtr++)=avg(rPtr[-stride],rPtr[-1],rPtr[1],rPtr[stride]);
+			*(cPtr++)=avg(rPtr[-stride-1],rPtr[-stride+1],rPtr[stride-1],rPtr[stride+1]);
+			++rPtr;
+			
+			/* Convert the even (G) pixel: */
+			*(cPtr++)=avg(rPtr[-1],rPtr[1]);
+			*(cPtr++)=rPtr[0];
+			*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
+			++rPtr;
+			}
+		
+		/* Convert the even row's last (R) pixel: */
+		*(cPtr++)=rPtr[0];
+		*(cPtr++)=avg(rPtr[-stride],rPtr[-1],rPtr[stride]);
+		*(cPtr++)=avg(rPtr[-stride-1],rPtr[stride-1]);
+		++rPtr;
+		
+		rRowPtr+=stride;
+		cRowPtr-=stride*3;
+		}
+	
+	/* Convert the last row: */
+	rPtr=rRowPtr;
+	cPtr=cRowPtr;
+	
+	/* Convert the last row's first (B) pixel: */
+	*(cPtr++)=rPtr[-stride+1];
+	*(cPtr++)=avg(rPtr[-stride],rPtr[1]);
+	*(cPtr++)=rPtr[0];
+	++rPtr;
+	
+	/* Convert the last row's central pixels: */
+	for(int x=1;x<width-1;x+=2)
+		{
+		/* Convert the odd (G) pixel: */
+		*(cPtr++)=rPtr[-stride];
+		*(cPtr++)=rPtr[0];
+		*(cPtr++)=avg(rPtr[-1],rPtr[1]);
+		++rPtr;
+		
+		/* Convert the even (B) pixel: */
+		*(cPtr++)=avg(rPtr[-stride-1],rPtr[-stride+1]);
+		*(cPtr++)=avg(rPtr[-stride],rPtr[-1],rPtr[1]);
+		*(cPtr++)=rPtr[0];
+		++rPtr;
+		}
+	
+	/* Convert the last row's last (G) pixel: */
+	*(cPtr++)=rPtr[-stride];
+	*(cPtr++)=rPtr[0];
+	*(cPtr++)=rPtr[-1];
+	}
+
+/*****************************************
+Helper functions for depth frame decoding:
+*****************************************/
+
+typedef Misc::UInt8 Byte;
+typedef FrameSource::DepthPixel DepthPixel;
+
+inline Misc::UInt64 readBigEndian(const Byte* sPtr)
+	{
+	/* Assemble eight bytes into a big-endian 64-bit word (compilers turn this into a single load and byte swap): */
+	return (Misc::UInt64(sPtr[0])<<56)|(Misc::UInt64(sPtr[1])<<48)|(Misc::UInt64(sPtr[2])<<40)|(Misc::UInt64(sPtr[3])<<32)
+	       |(Misc::UInt64(sPtr[4])<<24)|(Misc::UInt64(sPtr[5])<<16)|(Misc::UInt64(sPtr[6])<<8)|Misc::UInt64(sPtr[7]);
+	}
+
+inline void unpackGroup(const Byte* sPtr,DepthPixel* dPtr)
+	{
+	/* Extract the first five pixels from the first eight bytes of the 88-bit group: */
+	Misc::UInt64 v0=readBigEndian(sPtr);
+	dPtr[0]=DepthPixel(v0>>53);
+	dPtr[1]=DepthPixel((v0>>42)&0x7ffU);
+	dPtr[2]=DepthPixel((v0>>31)&0x7ffU);
+	dPtr[3]=DepthPixel((v0>>20)&0x7ffU);
+	dPtr[4]=DepthPixel((v0>>9)&0x7ffU);
+	
+	/* Extract the last three pixels from the last eight bytes of the group: */
+	Misc::UInt64 v1=readBigEndian(sPtr+3);
+	dPtr[5]=DepthPixel((v1>>22)&0x7ffU);
+	dPtr[6]=DepthPixel((v1>>11)&0x7ffU);
+	dPtr[7]=DepthPixel(v1&0x7ffU);
+	}
+
+#ifdef __SSSE3__
+
+inline void unpackGroupSSSE3(const Byte* sPtr,DepthPixel* dPtr) // Reads five bytes past the end of the group
+	{
+	/*********************************************************************
+	Pixel i starts at bit 11*i, i.e., at bit offset o=(11*i)%8 inside byte
+	k=(11*i)/8. Shuffle bytes k and k+1 into a big-endian 16-bit lane and
+	shift the pixel to the top by multiplying with 2^o. Pixels with o>5
+	spill into byte k+2, whose high bits are shifted into place with a
+	high-half multiplication.
+	*********************************************************************/
+	
+	__m128i raw=_mm_loadu_si128(reinterpret_cast<const __m128i*>(sPtr));
+	__m128i words=_mm_shuffle_epi8(raw,_mm_setr_epi8(1,0,2,1,3,2,5,4,6,5,7,6,9,8,10,9));
+	__m128i spills=_mm_shuffle_epi8(raw,_mm_setr_epi8(-1,-1,-1,-1,-1,4,-1,-1,-1,-1,-1,8,-1,-1,-1,-1));
+	__m128i pixels=_mm_srli_epi16(_mm_mullo_epi16(words,_mm_setr_epi16(1,8,64,2,16,128,4,32)),5);
+	pixels=_mm_or_si128(pixels,_mm_mulhi_epu16(spills,_mm_setr_epi16(0,0,2,0,0,4,0,0)));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dPtr),pixels);
+	}
+
+#endif
+
+}
+
+/******************************
+Functions to decode raw frames:
+******************************/
+
+void decodeBayerFrame(const FrameSource::ColorComponent* rawFrame,int width,int height,FrameSource::ColorComponent* rgbFrame)
+	{
+	decodeBayer(rawFrame,width,height,rgbFrame,true);
+	}
+
+void decodeBayerFrameScalar(const FrameSource::ColorComponent* rawFrame,int width,int height,FrameSource::ColorComponent* rgbFrame)
+	{
+	decodeBayer(rawFrame,width,height,rgbFrame,false);
+	}
+
+void unpackDepthFrame(const Misc::UInt8* rawFrame,int width,int height,FrameSource::DepthPixel* depthFrame)
+	{
+	const Byte* sPtr=rawFrame;
+	DepthPixel* dRowPtr=depthFrame;
+	dRowPtr+=width*(height-1);
+	
+	/* Process rows: */
+	for(int y=0;y<height;++y,dRowPtr-=width) // Flip the depth image vertically
+		{
+		DepthPixel* dPtr=dRowPtr;
+		int x=0;
+		
+		#ifdef __SSSE3__
+		/* Process groups of eight pixels with vector instructions, leaving the frame's last group to the scalar code to not read past the end: */
+		int xEnd=y<height-1?width:width-8;
+		for(;x<xEnd;x+=8,sPtr+=11,dPtr+=8)
+			unpackGroupSSSE3(sPtr,dPtr);
+		#endif
+		
+		/* Process pixels in groups of eight: */
+		for(;x<width;x+=8,sPtr+=11,dPtr+=8)
+			unpackGroup(sPtr,dPtr);
+		}
+	}
+
+void unpackDepthFrameScalar(const Misc::UInt8* rawFrame,int width,int height,FrameSource::DepthPixel* depthFrame)
+	{
+	const Byte* sPtr=rawFrame;
+	DepthPixel* dRowPtr=depthFrame;
+	dRowPtr+=width*(height-1);
+	
+	/* Process rows: */
+	for(int y=0;y<height;++y,dRowPtr-=width) // Flip the depth image vertically
+		{
+		DepthPixel* dPtr=dRowPtr;
+		
+		/* Process pixels in groups of eight: */
+		for(int x=0;x<width;x+=8,sPtr+=11,dPtr+=8)
+			{
+			/* Convert a run of 11 8-bit bytes into 8 11-bit pixels: */
+			dPtr[0]=(DepthPixel(sPtr[0])<<3)|(DepthPixel(sPtr[1])>>5);
+			dPtr[1]=((DepthPixel(sPtr[1])&0x1fU)<<6)|(DepthPixel(sPtr[2])>>2);
+			dPtr[2]=((DepthPixel(sPtr[2])&0x03U)<<9)|(DepthPixel(sPtr[3])<<1)|(DepthPixel(sPtr[4])>>7);
+			dPtr[3]=((DepthPixel(sPtr[4])&0x7fU)<<4)|(DepthPixel(sPtr[5])>>4);
+			dPtr[4]=((DepthPixel(sPtr[5])&0x0fU)<<7)|(DepthPixel(sPtr[6])>>1);
+			dPtr[5]=((DepthPixel(sPtr[6])&0x01U)<<10)|(DepthPixel(sPtr[7])<<2)|(DepthPixel(sPtr[8])>>6);
+			dPtr[6]=((DepthPixel(sPtr[8])&0x3fU)<<5)|(DepthPixel(sPtr[9])>>3);
+			dPtr[7]=((DepthPixel(sPtr[9])&0x07U)<<8)|DepthPixel(sPtr[10]);
+			}
+		}
+	}
+
+}
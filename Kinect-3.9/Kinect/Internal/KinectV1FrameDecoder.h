@@ -0,0 +1,45 @@
+/***********************************************************************
+KinectV1FrameDecoder - Functions to decode raw color and depth frames
+received from first-generation Kinect cameras.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef KINECT_INTERNAL_KINECTV1FRAMEDECODER_INCLUDED
+#define KINECT_INTERNAL_KINECTV1FRAMEDECODER_INCLUDED
+
+#include <Misc/SizedTypes.h>
+#include <Kinect/FrameSource.h>
+
+namespace Kinect {
+
+/****************************************************************
+Both decoders flip the decoded frame vertically. Frame widths and
+heights must be even, and raw depth frame widths must be multiples
+of eight.
+****************************************************************/
+
+void decodeBayerFrame(const FrameSource::ColorComponent* rawFrame,int width,int height,FrameSource::ColorComponent* rgbFrame); // Decodes a raw color frame in Bayer GRBG pattern into an RGB frame using bilinear interpolation
+void decodeBayerFrameScalar(const FrameSource::ColorComponent* rawFrame,int width,int height,FrameSource::ColorComponent* rgbFrame); // Ditto, without using vector instructions
+void unpackDepthFrame(const Misc::UInt8* rawFrame,int width,int height,FrameSource::DepthPixel* depthFrame); // Unpacks a raw depth frame of packed big-endian 11-bit pixels
+void unpackDepthFrameScalar(const Misc::UInt8* rawFrame,int width,int height,FrameSource::DepthPixel* depthFrame); // Ditto, one byte at a time as received from the camera
+
+}
+
+#endif
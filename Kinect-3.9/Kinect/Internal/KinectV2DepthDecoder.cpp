@@ -0,0 +1,869 @@
+/***********************************************************************
+KinectV2DepthDecoder - Class to reconstruct depth images from triplets
+of raw range-gated IR images captured by a Kinect v2 camera.
+Copyright (c) 2015-2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Kinect/Internal/KinectV2DepthDecoder.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <Math/Math.h>
+#include <Math/Constants.h>
+#include <Kinect/LensDistortion.h>
+
+namespace Kinect {
+
+namespace {
+
+/**************************************************************************
+Helper functions implementing the per-pixel reconstruction kernels. Every
+kernel has a scalar version and, if the compiler targets SSE2 (always the
+case on x86-64), a version processing four pixels at a time. Both versions
+perform the same floating-point operations in the same order, and produce
+identical results.
+**************************************************************************/
+
+/* Coefficients of a minimax polynomial approximating atan(a) for a in [0, 1]: */
+const float atanC1=0.99997726f;
+const float atanC3=-0.33262347f;
+const float atanC5=0.19354346f;
+const float atanC7=-0.11643287f;
+const float atanC9=0.05265332f;
+const float atanC11=-0.01172120f;
+
+inline float calcPhaseAngle(float x,float y) // Returns the angle of the given phase vector in the [0, 2pi] range
+	{
+	/* Reduce the angle to the first octant: */
+	float ax=Math::abs(x);
+	float ay=Math::abs(y);
+	float mx=Math::max(ax,ay);
+	float mn=Math::min(ax,ay);
+	float a=mx>0.0f?mn/mx:0.0f;
+	
+	/* Calculate the first-octant angle: */
+	float s=a*a;
+	float result=a*(atanC1+s*(atanC3+s*(atanC5+s*(atanC7+s*(atanC9+s*atanC11)))));
+	
+	/* Expand the angle to the full circle: */
+	if(ay>ax)
+		result=0.5f*Math::Constants<float>::pi-result;
+	if(x<0.0f)
+		result=Math::Constants<float>::pi-result;
+	if(y<0.0f)
+		result=2.0f*Math::Constants<float>::pi-result;
+	return result;
+	}
+
+void calcPhaseRow(unsigned int numPixels,const Misc::SInt16* i0,const Misc::SInt16* i1,const Misc::SInt16* i2,const float* const tt[6],float magnitudeFactor,float* angles,float* magnitudes) // Calculates phase angles and magnitudes for a range of pixels
+	{
+	for(unsigned int i=0;i<numPixels;++i)
+		{
+		/* Check for pixel saturation: */
+		if(i0[i]!=32767&&i1[i]!=32767&&i2[i]!=32767)
+			{
+			/* Calculate the phase vector: */
+			float x=tt[0][i]*float(i0[i])+tt[1][i]*float(i1[i])+tt[2][i]*float(i2[i]);
+			float y=tt[3][i]*float(i0[i])+tt[4][i]*float(i1[i])+tt[5][i]*float(i2[i]);
+			
+			/* Calculate the pixel's phase angle and magnitude: */
+			angles[i]=calcPhaseAngle(x,y);
+			magnitudes[i]=Math::sqrt(x*x+y*y)*magnitudeFactor;
+			}
+		else
+			angles[i]=magnitudes[i]=0.0f;
+		}
+	}
+
+struct DealiasParameters // Structure holding parameters for the dealiasing kernel
+	{
+	/* Elements: */
+	public:
+	float magThreshold1,magThreshold2;
+	const float* confidenceTable;
+	float phaseOffset;
+	float unambiguousDistance;
+	};
+
+void dealiasRow(unsigned int numPixels,const float* const angles[3],const float* const magnitudes[3],const float* xRow,const float* zRow,const DealiasParameters& dp,float* depthRow) // Calculates linear depth values for a range of pixels
+	{
+	const float twoPi=2.0f*Math::Constants<float>::pi;
+	for(unsigned int i=0;i<numPixels;++i)
+		{
+		depthRow[i]=0.0f;
+		
+		float m0=magnitudes[0][i];
+		float m1=magnitudes[1][i];
+		float m2=magnitudes[2][i];
+		float magSum=m0+m1+m2;
+		float magMin=Math::min(m0,Math::min(m1,m2));
+		if(magMin>=dp.magThreshold1&&magSum>=dp.magThreshold2)
+			{
+			/* Convert phase angles to wave distances: */
+			float t0=angles[0][i]*3.0f/twoPi;
+			float t1=angles[1][i]*15.0f/twoPi;
+			float t2=angles[2][i]*2.0f/twoPi;
+			
+			float t5=Math::floor((t1-t0)*0.333333f+0.5f)*3.0f+t0;
+			float t3=t5-t2;
+			float f1=t3>=0.0f?2.0f:-2.0f;
+			float f2=t3>=0.0f?0.5f:-0.5f;
+			t3*=f2;
+			t3=(t3-float(int(t3)))*f1; // t3 is always >=0
+			
+			float t6=t5;
+			float t7=t1;
+			if(0.5f<Math::abs(t3)&&Math::abs(t3)<1.5f)
+				{
+				t6+=15.0f;
+				t7+=15.0f;
+				}
+			
+			float t8=(Math::floor((t6-t2)*0.5f+0.5f)*2.0f+t2)*0.5f;
+			
+			t6/=3.0f;
+			t7/=15.0f;
+			
+			float t9=t6+t7+t8;
+			float t10=t9/3.0f;
+			
+			t6*=twoPi;
+			t7*=twoPi;
+			t8*=twoPi;
+			
+			float t6p=t8*0.551318f-t6*0.826977f;
+			float t7p=t6*0.110264f-t7*0.551318f;
+			float t8p=t7*0.826977f-t8*0.110264f;
+			
+			float norm=t6p*t6p+t7p*t7p+t8p*t8p;
+			if(t9<0.0f)
+				t10=0.0f;
+			
+			/* Check the dealiasing confidence: */
+			float magMax=Math::clamp(Math::max(m0,Math::max(m1,m2)),304.0f,871.0f);
+			float irX=dp.confidenceTable[int(magMax)-304];
+			float phase=irX>=norm?t10:0.0f;
+			if(phase>0.0f)
+				{
+				phase+=dp.phaseOffset;
+				
+				float depthLinear=zRow[i]*phase;
+				float maxDepth=phase*dp.unambiguousDistance*2.0f;
+				
+				float xFactor=xRow[i]*90.0f/(maxDepth*maxDepth*8192.0f);
+				float denominator=1.0f-depthLinear*xFactor;
+				if(denominator>0.0f)
+					depthRow[i]=depthLinear/denominator;
+				}
+			}
+		}
+	}
+
+inline float filterEdgePixel(float c,float o,float threshold) // Low-pass filters a pixel on the image boundary with its single neighbor
+	{
+	return Math::abs(c-o)<threshold?c*0.667f+o*0.333f:c;
+	}
+
+inline float filterPixel(float c,float p,float n,float threshold) // Low-pass filters a pixel with its two neighbors
+	{
+	float sum=c+c;
+	float weight=2.0f;
+	if(Math::abs(c-p)<threshold)
+		{
+		sum+=p;
+		weight+=1.0f;
+		}
+	if(Math::abs(c-n)<threshold)
+		{
+		sum+=n;
+		weight+=1.0f;
+		}
+	return sum/weight;
+	}
+
+void filterRowInterior(unsigned int xBegin,unsigned int xEnd,const float* src,float* dst,float threshold) // Horizontally low-pass filters a range of interior pixels of a row
+	{
+	for(unsigned int x=xBegin;x<xEnd;++x)
+		dst[x]=filterPixel(src[x],src[x-1],src[x+1],threshold);
+	}
+
+inline FrameSource::DepthPixel quantizeDepth(float d,float zMin,float zMax,float A,float B) // Quantizes a linear depth value
+	{
+	if(d<zMin||d>zMax)
+		return FrameSource::invalidDepth;
+	else
+		return FrameSource::DepthPixel(B-A/d);
+	}
+
+void filterColumnsAndQuantize(unsigned int xBegin,unsigned int xEnd,const float* prev,const float* cur,const float* next,float threshold,float zMin,float zMax,float A,float B,FrameSource::DepthPixel* frameRow) // Vertically low-pass filters and quantizes a range of pixels of a row; prev or next are null on the image boundary
+	{
+	for(unsigned int x=xBegin;x<xEnd;++x)
+		{
+		float d;
+		if(prev==0)
+			d=filterEdgePixel(cur[x],next[x],threshold);
+		else if(next==0)
+			d=filterEdgePixel(cur[x],prev[x],threshold);
+		else
+			d=filterPixel(cur[x],prev[x],next[x],threshold);
+		frameRow[x]=quantizeDepth(d,zMin,zMax,A,B);
+		}
+	}
+
+#ifdef __SSE2__
+
+inline __m128 selectPs(__m128 mask,__m128 a,__m128 b) // Returns a where mask is set, and b otherwise
+	{
+	return _mm_or_ps(_mm_and_ps(mask,a),_mm_andnot_ps(mask,b));
+	}
+
+inline __m128 absPs(__m128 v)
+	{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f),v);
+	}
+
+inline __m128 floorPs(__m128 v) // Rounds towards negative infinity; valid for |v|<2^31
+	{
+	__m128 t=_mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+	return _mm_sub_ps(t,_mm_and_ps(_mm_cmpgt_ps(t,v),_mm_set1_ps(1.0f)));
+	}
+
+inline __m128 calcPhaseAngles(__m128 x,__m128 y)
+	{
+	/* Reduce the angles to the first octant: */
+	__m128 zero=_mm_setzero_ps();
+	__m128 ax=absPs(x);
+	__m128 ay=absPs(y);
+	__m128 mx=_mm_max_ps(ax,ay);
+	__m128 mn=_mm_min_ps(ax,ay);
+	__m128 a=_mm_and_ps(_mm_cmpgt_ps(mx,zero),_mm_div_ps(mn,mx));
+	
+	/* Calculate the first-octant angles: */
+	__m128 s=_mm_mul_ps(a,a);
+	__m128 poly=_mm_add_ps(_mm_set1_ps(atanC9),_mm_mul_ps(s,_mm_set1_ps(atanC11)));
+	poly=_mm_add_ps(_mm_set1_ps(atanC7),_mm_mul_ps(s,poly));
+	poly=_mm_add_ps(_mm_set1_ps(atanC5),_mm_mul_ps(s,poly));
+	poly=_mm_add_ps(_mm_set1_ps(atanC3),_mm_mul_ps(s,poly));
+	poly=_mm_add_ps(_mm_set1_ps(atanC1),_mm_mul_ps(s,poly));
+	__m128 result=_mm_mul_ps(a,poly);
+	
+	/* Expand the angles to the full circle: */
+	result=selectPs(_mm_cmpgt_ps(ay,ax),_mm_sub_ps(_mm_set1_ps(0.5f*Math::Constants<float>::pi),result),result);
+	result=selectPs(_mm_cmplt_ps(x,zero),_mm_sub_ps(_mm_set1_ps(Math::Constants<float>::pi),result),result);
+	result=selectPs(_mm_cmplt_ps(y,zero),_mm_sub_ps(_mm_set1_ps(2.0f*Math::Constants<float>::pi),result),result);
+	return result;
+	}
+
+unsigned int calcPhaseRowSSE(unsigned int numPixels,const Misc::SInt16* i0,const Misc::SInt16* i1,const Misc::SInt16* i2,const float* const tt[6],float magnitudeFactor,float* angles,float* magnitudes) // Vectorized version of calcPhaseRow; returns the number of processed pixels
+	{
+	__m128i saturated=_mm_set1_epi16(32767);
+	__m128 mf=_mm_set1_ps(magnitudeFactor);
+	unsigned int i;
+	for(i=0;i+4<=numPixels;i+=4)
+		{
+		/* Load four pixels from each IR image: */
+		__m128i r0=_mm_loadl_epi64(reinterpret_cast<const __m128i*>(i0+i));
+		__m128i r1=_mm_loadl_epi64(reinterpret_cast<const __m128i*>(i1+i));
+		__m128i r2=_mm_loadl_epi64(reinterpret_cast<const __m128i*>(i2+i));
+		
+		/* Check for pixel saturation and widen the saturation mask to 32 bits: */
+		__m128i sat=_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(r0,saturated),_mm_cmpeq_epi16(r1,saturated)),_mm_cmpeq_epi16(r2,saturated));
+		__m128 satMask=_mm_castsi128_ps(_mm_unpacklo_epi16(sat,sat));
+		
+		/* Sign-extend the pixels and convert them to float: */
+		__m128 f0=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(r0,r0),16));
+		__m128 f1=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(r1,r1),16));
+		__m128 f2=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(r2,r2),16));
+		
+		/* Calculate the phase vectors: */
+		__m128 x=_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(tt[0]+i),f0),_mm_mul_ps(_mm_loadu_ps(tt[1]+i),f1)),_mm_mul_ps(_mm_loadu_ps(tt[2]+i),f2));
+		__m128 y=_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(tt[3]+i),f0),_mm_mul_ps(_mm_loadu_ps(tt[4]+i),f1)),_mm_mul_ps(_mm_loadu_ps(tt[5]+i),f2));
+		
+		/* Calculate the phase angles and magnitudes, and zero out saturated pixels: */
+		__m128 angle=calcPhaseAngles(x,y);
+		__m128 mag=_mm_mul_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x,x),_mm_mul_ps(y,y))),mf);
+		_mm_storeu_ps(angles+i,_mm_andnot_ps(satMask,angle));
+		_mm_storeu_ps(magnitudes+i,_mm_andnot_ps(satMask,mag));
+		}
+	
+	return i;
+	}
+
+unsigned int dealiasRowSSE(unsigned int numPixels,const float* const angles[3],const float* const magnitudes[3],const float* xRow,const float* zRow,const DealiasParameters& dp,float* depthRow) // Vectorized version of dealiasRow; returns the number of processed pixels
+	{
+	const float twoPi=2.0f*Math::Constants<float>::pi;
+	__m128 zero=_mm_setzero_ps();
+	__m128 vTwoPi=_mm_set1_ps(twoPi);
+	__m128 half=_mm_set1_ps(0.5f);
+	unsigned int i;
+	for(i=0;i+4<=numPixels;i+=4)
+		{
+		__m128 m0=_mm_loadu_ps(magnitudes[0]+i);
+		__m128 m1=_mm_loadu_ps(magnitudes[1]+i);
+		__m128 m2=_mm_loadu_ps(magnitudes[2]+i);
+		__m128 magSum=_mm_add_ps(_mm_add_ps(m0,m1),m2);
+		__m128 magMin=_mm_min_ps(m0,_mm_min_ps(m1,m2));
+		__m128 valid=_mm_and_ps(_mm_cmpge_ps(magMin,_mm_set1_ps(dp.magThreshold1)),_mm_cmpge_ps(magSum,_mm_set1_ps(dp.magThreshold2)));
+		
+		/* Convert phase angles to wave distances: */
+		__m128 t0=_mm_div_ps(_mm_mul_ps(_mm_loadu_ps(angles[0]+i),_mm_set1_ps(3.0f)),vTwoPi);
+		__m128 t1=_mm_div_ps(_mm_mul_ps(_mm_loadu_ps(angles[1]+i),_mm_set1_ps(15.0f)),vTwoPi);
+		__m128 t2=_mm_div_ps(_mm_mul_ps(_mm_loadu_ps(angles[2]+i),_mm_set1_ps(2.0f)),vTwoPi);
+		
+		__m128 t5=_mm_add_ps(_mm_mul_ps(floorPs(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(t1,t0),_mm_set1_ps(0.333333f)),half)),_mm_set1_ps(3.0f)),t0);
+		__m128 t3=_mm_sub_ps(t5,t2);
+		__m128 t3Pos=_mm_cmpge_ps(t3,zero);
+		t3=_mm_mul_ps(t3,selectPs(t3Pos,half,_mm_set1_ps(-0.5f)));
+		t3=_mm_mul_ps(_mm_sub_ps(t3,_mm_cvtepi32_ps(_mm_cvttps_epi32(t3))),selectPs(t3Pos,_mm_set1_ps(2.0f),_mm_set1_ps(-2.0f)));
+		
+		__m128 t3Abs=absPs(t3);
+		__m128 shift=_mm_and_ps(_mm_and_ps(_mm_cmplt_ps(half,t3Abs),_mm_cmplt_ps(t3Abs,_mm_set1_ps(1.5f))),_mm_set1_ps(15.0f));
+		__m128 t6=_mm_add_ps(t5,shift);
+		__m128 t7=_mm_add_ps(t1,shift);
+		
+		__m128 t8=_mm_mul_ps(_mm_add_ps(_mm_mul_ps(floorPs(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(t6,t2),half),half)),_mm_set1_ps(2.0f)),t2),half);
+		
+		t6=_mm_div_ps(t6,_mm_set1_ps(3.0f));
+		t7=_mm_div_ps(t7,_mm_set1_ps(15.0f));
+		
+		__m128 t9=_mm_add_ps(_mm_add_ps(t6,t7),t8);
+		__m128 t10=_mm_div_ps(t9,_mm_set1_ps(3.0f));
+		
+		t6=_mm_mul_ps(t6,vTwoPi);
+		t7=_mm_mul_ps(t7,vTwoPi);
+		t8=_mm_mul_ps(t8,vTwoPi);
+		
+		__m128 t6p=_mm_sub_ps(_mm_mul_ps(t8,_mm_set1_ps(0.551318f)),_mm_mul_ps(t6,_mm_set1_ps(0.826977f)));
+		__m128 t7p=_mm_sub_ps(_mm_mul_ps(t6,_mm_set1_ps(0.110264f)),_mm_mul_ps(t7,_mm_set1_ps(0.551318f)));
+		__m128 t8p=_mm_sub_ps(_mm_mul_ps(t7,_mm_set1_ps(0.826977f)),_mm_mul_ps(t8,_mm_set1_ps(0.110264f)));
+		
+		__m128 norm=_mm_add_ps(_mm_add_ps(_mm_mul_ps(t6p,t6p),_mm_mul_ps(t7p,t7p)),_mm_mul_ps(t8p,t8p));
+		t10=_mm_andnot_ps(_mm_cmplt_ps(t9,zero),t10);
+		
+		/* Look up the dealiasing confidence; SSE2 has no gather instruction: */
+		__m128 magMax=_mm_min_ps(_mm_max_ps(_mm_max_ps(m0,_mm_max_ps(m1,m2)),_mm_set1_ps(304.0f)),_mm_set1_ps(871.0f));
+		union
+			{
+			__m128i v;
+			int i[4];
+			} index;
+		index.v=_mm_sub_epi32(_mm_cvttps_epi32(magMax),_mm_set1_epi32(304));
+		__m128 irX=_mm_setr_ps(dp.confidenceTable[index.i[0]],dp.confidenceTable[index.i[1]],dp.confidenceTable[index.i[2]],dp.confidenceTable[index.i[3]]);
+		__m128 phase=_mm_and_ps(_mm_cmpge_ps(irX,norm),t10);
+		valid=_mm_and_ps(valid,_mm_cmpgt_ps(phase,zero));
+		phase=_mm_add_ps(phase,_mm_set1_ps(dp.phaseOffset));
+		
+		__m128 depthLinear=_mm_mul_ps(_mm_loadu_ps(zRow+i),phase);
+		__m128 maxDepth=_mm_mul_ps(_mm_mul_ps(phase,_mm_set1_ps(dp.unambiguousDistance)),_mm_set1_ps(2.0f));
+		
+		__m128 xFactor=_mm_div_ps(_mm_mul_ps(_mm_loadu_ps(xRow+i),_mm_set1_ps(90.0f)),_mm_mul_ps(_mm_mul_ps(maxDepth,maxDepth),_mm_set1_ps(8192.0f)));
+		__m128 denominator=_mm_sub_ps(_mm_set1_ps(1.0f),_mm_mul_ps(depthLinear,xFactor));
+		valid=_mm_and_ps(valid,_mm_cmpgt_ps(denominator,zero));
+		_mm_storeu_ps(depthRow+i,_mm_and_ps(valid,_mm_div_ps(depthLinear,denominator)));
+		}
+	
+	return i;
+	}
+
+inline __m128 filterEdgePixels(__m128 c,__m128 o,__m128 threshold)
+	{
+	__m128 filtered=_mm_add_ps(_mm_mul_ps(c,_mm_set1_ps(0.667f)),_mm_mul_ps(o,_mm_set1_ps(0.333f)));
+	return selectPs(_mm_cmplt_ps(absPs(_mm_sub_ps(c,o)),threshold),filtered,c);
+	}
+
+inline __m128 filterPixels(__m128 c,__m128 p,__m128 n,__m128 threshold)
+	{
+	__m128 one=_mm_set1_ps(1.0f);
+	__m128 sum=_mm_add_ps(c,c);
+	__m128 weight=_mm_set1_ps(2.0f);
+	__m128 usePrev=_mm_cmplt_ps(absPs(_mm_sub_ps(c,p)),threshold);
+	sum=_mm_add_ps(sum,_mm_and_ps(usePrev,p));
+	weight=_mm_add_ps(weight,_mm_and_ps(usePrev,one));
+	__m128 useNext=_mm_cmplt_ps(absPs(_mm_sub_ps(c,n)),threshold);
+	sum=_mm_add_ps(sum,_mm_and_ps(useNext,n));
+	weight=_mm_add_ps(weight,_mm_and_ps(useNext,one));
+	return _mm_div_ps(sum,weight);
+	}
+
+unsigned int filterRowInteriorSSE(unsigned int xBegin,unsigned int xEnd,const float* src,float* dst,float threshold) // Vectorized version of filterRowInterior; returns the first unprocessed pixel
+	{
+	__m128 thr=_mm_set1_ps(threshold);
+	unsigned int x;
+	for(x=xBegin;x+4<=xEnd;x+=4)
+		_mm_storeu_ps(dst+x,filterPixels(_mm_loadu_ps(src+x),_mm_loadu_ps(src+x-1),_mm_loadu_ps(src+x+1),thr));
+	
+	return x;
+	}
+
+inline __m128i quantizeDepths(__m128 d,__m128 zMin,__m128 zMax,__m128 A,__m128 B) // Quantizes four linear depth values into 32-bit integers biased by -32768
+	{
+	/* Calculate quantized depths and replace out-of-range depths with the invalid depth value: */
+	__m128i q=_mm_cvttps_epi32(_mm_sub_ps(B,_mm_div_ps(A,d)));
+	__m128i outOfRange=_mm_castps_si128(_mm_or_ps(_mm_cmplt_ps(d,zMin),_mm_cmpgt_ps(d,zMax)));
+	q=_mm_or_si128(_mm_and_si128(outOfRange,_mm_set1_epi32(FrameSource::invalidDepth)),_mm_andnot_si128(outOfRange,q));
+	
+	/* Bias the depths so they can be packed into 16 bits using signed saturation: */
+	return _mm_sub_epi32(q,_mm_set1_epi32(32768));
+	}
+
+unsigned int filterColumnsAndQuantizeSSE(unsigned int xBegin,unsigned int xEnd,const float* prev,const float* cur,const float* next,float threshold,float zMin,float zMax,float A,float B,FrameSource::DepthPixel* frameRow) // Vectorized version of filterColumnsAndQuantize; returns the first unprocessed pixel
+	{
+	__m128 thr=_mm_set1_ps(threshold);
+	__m128 vZMin=_mm_set1_ps(zMin);
+	__m128 vZMax=_mm_set1_ps(zMax);
+	__m128 vA=_mm_set1_ps(A);
+	__m128 vB=_mm_set1_ps(B);
+	__m128i bias=_mm_set1_epi16(-32768);
+	unsigned int x;
+	for(x=xBegin;x+8<=xEnd;x+=8)
+		{
+		/* Filter eight pixels: */
+		__m128 d0,d1;
+		if(prev==0)
+			{
+			d0=filterEdgePixels(_mm_loadu_ps(cur+x),_mm_loadu_ps(next+x),thr);
+			d1=filterEdgePixels(_mm_loadu_ps(cur+x+4),_mm_loadu_ps(next+x+4),thr);
+			}
+		else if(next==0)
+			{
+			d0=filterEdgePixels(_mm_loadu_ps(cur+x),_mm_loadu_ps(prev+x),thr);
+			d1=filterEdgePixels(_mm_loadu_ps(cur+x+4),_mm_loadu_ps(prev+x+4),thr);
+			}
+		else
+			{
+			d0=filterPixels(_mm_loadu_ps(cur+x),_mm_loadu_ps(prev+x),_mm_loadu_ps(next+x),thr);
+			d1=filterPixels(_mm_loadu_ps(cur+x+4),_mm_loadu_ps(prev+x+4),_mm_loadu_ps(next+x+4),thr);
+			}
+		
+		/* Quantize the eight pixels, pack them into 16 bits, and remove the bias: */
+		__m128i q=_mm_packs_epi32(quantizeDepths(d0,vZMin,vZMax,vA,vB),quantizeDepths(d1,vZMin,vZMax,vA,vB));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(frameRow+x),_mm_xor_si128(q,bias));
+		}
+	
+	return x;
+	}
+
+#endif
+
+}
+
+/*************************************
+Methods of class KinectV2DepthDecoder:
+*************************************/
+
+void KinectV2DepthDecoder::calcTrigonometryTables(void)
+	{
+	const unsigned int numPixels=height*width;
+	for(int exposure=0;exposure<3;++exposure)
+		{
+		const Misc::UInt16* ptPtr=p0Tables+exposure*numPixels;
+		float* tt=trigonometryTables[exposure];
+		for(unsigned int i=0;i<numPixels;++i)
+			{
+			/* Convert the per-pixel phase offset to radians: */
+			float p=-2.0f*Math::Constants<float>::pi*float(ptPtr[i])/65536.0f;
+			
+			/* Calculate the per-image phase angles: */
+			float p0=p; // First image in a triplet is at base angle
+			float p1=p+2.0f*Math::Constants<float>::pi/3.0f; // Second image is 120 degrees ahead
+			float p2=p+4.0f*Math::Constants<float>::pi/3.0f; // Third image is 240 degrees ahead
+			
+			/* Calculate the per-image phase angle cosines and sines: */
+			tt[0*numPixels+i]=Math::cos(p0);
+			tt[1*numPixels+i]=Math::cos(p1);
+			tt[2*numPixels+i]=Math::cos(p2);
+			
+			tt[3*numPixels+i]=-Math::sin(p0);
+			tt[4*numPixels+i]=-Math::sin(p1);
+			tt[5*numPixels+i]=-Math::sin(p2);
+			}
+		}
+	}
+
+void KinectV2DepthDecoder::calcDepthRows(const KinectV2DepthDecoder::Band& band)
+	{
+	const unsigned int numPixels=height*width;
+	DealiasParameters dp;
+	dp.magThreshold1=magThreshold1;
+	dp.magThreshold2=magThreshold2;
+	dp.confidenceTable=confidenceTable;
+	dp.phaseOffset=phaseOffset;
+	dp.unambiguousDistance=unambiguousDistance;
+	
+	for(unsigned int y=band.rowBegin;y<band.rowEnd;++y)
+		{
+		unsigned int rowOffset=y*width;
+		
+		/* Dealias the row: */
+		const float* angles[3];
+		const float* magnitudes[3];
+		for(int exposure=0;exposure<3;++exposure)
+			{
+			angles[exposure]=phaseImages[exposure]+rowOffset;
+			magnitudes[exposure]=phaseImages[exposure]+numPixels+rowOffset;
+			}
+		float* depthRow=depthImage+rowOffset;
+		unsigned int x=0;
+		#ifdef __SSE2__
+		x=dealiasRowSSE(width,angles,magnitudes,xTable+rowOffset,zTable+rowOffset,dp,depthRow);
+		#endif
+		for(int exposure=0;exposure<3;++exposure)
+			{
+			angles[exposure]+=x;
+			magnitudes[exposure]+=x;
+			}
+		dealiasRow(width-x,angles,magnitudes,xTable+rowOffset+x,zTable+rowOffset+x,dp,depthRow+x);
+		
+		/* Run the horizontal pass of the low-pass filter over the row; the filter only looks at unfiltered neighbors: */
+		float* filterRow=filterImage+rowOffset;
+		filterRow[0]=filterEdgePixel(depthRow[0],depthRow[1],filterDistanceThreshold);
+		x=1;
+		#ifdef __SSE2__
+		x=filterRowInteriorSSE(x,width-1,depthRow,filterRow,filterDistanceThreshold);
+		#endif
+		filterRowInterior(x,width-1,depthRow,filterRow,filterDistanceThreshold);
+		filterRow[width-1]=filterEdgePixel(depthRow[width-1],depthRow[width-2],filterDistanceThreshold);
+		}
+	}
+
+void KinectV2DepthDecoder::filterDepthRows(const KinectV2DepthDecoder::Band& band)
+	{
+	for(unsigned int y=band.rowBegin;y<band.rowEnd;++y)
+		{
+		/* Run the vertical pass of the low-pass filter over the row and quantize it: */
+		const float* cur=filterImage+y*width;
+		const float* prev=y>0?cur-width:0;
+		const float* next=y<height-1?cur+width:0;
+		FrameSource::DepthPixel* frameRow=depthFrame+y*width;
+		unsigned int x=0;
+		#ifdef __SSE2__
+		x=filterColumnsAndQuantizeSSE(x,width,prev,cur,next,filterDistanceThreshold,zMin,zMax,A,B,frameRow);
+		#endif
+		filterColumnsAndQuantize(x,width,prev,cur,next,filterDistanceThreshold,zMin,zMax,A,B,frameRow);
+		}
+	}
+
+bool KinectV2DepthDecoder::runDepthPasses(unsigned int bandIndex)
+	{
+	/* Wait for the start of the next depth frame: */
+	depthBarrier.synchronize();
+	if(shutdownWorkers)
+		return false;
+	
+	/* Dealias and horizontally filter the band: */
+	calcDepthRows(bands[bandIndex]);
+	
+	/* Wait until the horizontal filter pass is complete, as the vertical pass looks at adjacent bands: */
+	depthBarrier.synchronize();
+	
+	/* Vertically filter and quantize the band: */
+	filterDepthRows(bands[bandIndex]);
+	
+	/* Wait until all bands are complete: */
+	depthBarrier.synchronize();
+	
+	return true;
+	}
+
+void* KinectV2DepthDecoder::workerThreadMethod(unsigned int bandIndex)
+	{
+	/* Reconstruct depth frames until shut down: */
+	while(runDepthPasses(bandIndex))
+		;
+	
+	return 0;
+	}
+
+KinectV2DepthDecoder::KinectV2DepthDecoder(unsigned int sNumThreads)
+	:p0Tables(0),
+	 confidenceTable(0),xTable(0),zTable(0),
+	 depthImage(0),filterImage(0),
+	 numThreads(sNumThreads),bands(0),workerThreads(0),
+	 shutdownWorkers(false),depthFrame(0)
+	{
+	const unsigned int numPixels=height*width;
+	
+	/* Create the phase offset and trigonometry coefficient tables: */
+	p0Tables=new Misc::UInt16[3*numPixels];
+	for(unsigned int i=0;i<3*numPixels;++i)
+		p0Tables[i]=0;
+	for(int exposure=0;exposure<3;++exposure)
+		trigonometryTables[exposure]=new float[6*numPixels];
+	calcTrigonometryTables();
+	
+	/* Initialize the magnitude multipliers: */
+	magnitudeFactors[0]=1.322581f*0.6666667f;
+	magnitudeFactors[1]=1.0f*0.6666667f;
+	magnitudeFactors[2]=1.612903f*0.6666667f;
+	
+	/* Allocate the phase images: */
+	for(int exposure=0;exposure<3;++exposure)
+		phaseImages[exposure]=new float[2*numPixels];
+	
+	/* Initialize the magnitude thresholds: */
+	magThreshold1=3.0f;
+	magThreshold2=10.0f;
+	
+	/* Initialize the dealiasing confidence check parameters: */
+	confidenceSlope=-0.5330578f*0.301030f*3.321928f;
+	confidenceOffset=0.7694894f*3.321928f;
+	
+	minConfidence=0.3490659f;
+	maxConfidence=0.6108653f;
+	
+	/* Initialize the dealiasing confidence table: */
+	confidenceTable=new float[871-304+1];
+	for(int i=304;i<=871;++i)
+		{
+		float irX=float(i)+0.5f;
+		irX=Math::exp(Math::log(irX)*confidenceSlope+confidenceOffset);
+		irX=Math::clamp(irX,minConfidence,maxConfidence);
+		irX*=irX;
+		confidenceTable[i-304]=irX;
+		}
+	
+	/* Initialize phase-to-depth calculation parameters: */
+	phaseOffset=0.0f;
+	unambiguousDistance=6250.0f/3.0f; // Magic number
+	
+	/* Allocate the x and z tables and initialize them for an ideal pinhole camera: */
+	xTable=new float[numPixels];
+	zTable=new float[numPixels];
+	KinectV2CommandDispatcher::DepthCameraParams dcp;
+	dcp.sx=dcp.sy=365.0f;
+	dcp.cx=float(width)*0.5f;
+	dcp.cy=float(height)*0.5f;
+	dcp.k1=dcp.k2=dcp.k3=0.0f;
+	dcp.p1=dcp.p2=0.0f;
+	calcXZTables(dcp);
+	
+	/* Allocate the linear depth images: */
+	depthImage=new float[numPixels];
+	filterImage=new float[numPixels];
+	
+	/* Set the filter threshold: */
+	filterDistanceThreshold=50.0f;
+	
+	/* Initialize the quantization parameters: */
+	dMax=2047U;
+	setZRange(500.0f,5000.0f);
+	
+	/* Split the depth image into horizontal bands of roughly equal size, one per thread: */
+	if(numThreads<1)
+		numThreads=1;
+	if(numThreads>height)
+		numThreads=height;
+	bands=new Band[numThreads];
+	for(unsigned int i=0;i<numThreads;++i)
+		{
+		bands[i].rowBegin=(height*i)/numThreads;
+		bands[i].rowEnd=(height*(i+1))/numThreads;
+		}
+	
+	/* Start the worker threads; the calling thread processes the first band: */
+	depthBarrier.setNumSynchronizingThreads(numThreads);
+	if(numThreads>1)
+		{
+		workerThreads=new Threads::Thread[numThreads-1];
+		for(unsigned int i=1;i<numThreads;++i)
+			workerThreads[i-1].start(this,&KinectV2DepthDecoder::workerThreadMethod,i);
+		}
+	}
+
+KinectV2DepthDecoder::~KinectV2DepthDecoder(void)
+	{
+	if(workerThreads!=0)
+		{
+		/* Shut down the worker threads: */
+		shutdownWorkers=true;
+		depthBarrier.synchronize();
+		for(unsigned int i=1;i<numThreads;++i)
+			workerThreads[i-1].join();
+		delete[] workerThreads;
+		}
+	delete[] bands;
+	
+	/* Delete the phase offset and trigonometry coefficient tables: */
+	delete[] p0Tables;
+	for(int exposure=0;exposure<3;++exposure)
+		delete[] trigonometryTables[exposure];
+	
+	/* Delete the phase images: */
+	for(int exposure=0;exposure<3;++exposure)
+		delete[] phaseImages[exposure];
+	
+	/* Delete the depth calculation tables: */
+	delete[] confidenceTable;
+	delete[] xTable;
+	delete[] zTable;
+	
+	/* Delete the depth images: */
+	delete[] depthImage;
+	delete[] filterImage;
+	}
+
+void KinectV2DepthDecoder::loadP0Tables(IO::FilePtr file)
+	{
+	file->setEndianness(Misc::LittleEndian);
+	
+	/* Skip the file header: */
+	file->skip<Misc::UInt32>(8);
+	
+	/* Load the three tables: */
+	for(int exposure=0;exposure<3;++exposure)
+		{
+		file->skip<Misc::UInt16>(1);
+		file->read(p0Tables+exposure*height*width,height*width);
+		file->skip<Misc::UInt16>(1);
+		}
+	
+	/* Calculate the trigonometry tables: */
+	calcTrigonometryTables();
+	}
+
+void KinectV2DepthDecoder::calcXZTables(const KinectV2CommandDispatcher::DepthCameraParams& newDepthCameraParams)
+	{
+	/* Remember the depth camera parameters: */
+	depthCameraParams=newDepthCameraParams;
+	
+	/* Get depth camera parameters: */
+	double fx=depthCameraParams.sx;
+	double cx=depthCameraParams.cx;
+	double fy=depthCameraParams.sy;
+	double cy=depthCameraParams.cy;
+	LensDistortion ld;
+	ld.setKappa(0,depthCameraParams.k1);
+	ld.setKappa(1,depthCameraParams.k2);
+	ld.setKappa(2,depthCameraParams.k3);
+	ld.setRho(0,depthCameraParams.p1);
+	ld.setRho(1,depthCameraParams.p2);
+	
+	/* Calculate X and Z tables: */
+	float* xTablePtr=xTable;
+	float* zTablePtr=zTable;
+	for(unsigned int y=0;y<height;++y)
+		{
+		/* Calculate the distorted pixel position in normalized projection space: */
+		LensDistortion::Point dp;
+		dp[1]=(double(y)+0.5-cy)/fy;
+		for(unsigned int x=0;x<width;++x,++xTablePtr,++zTablePtr)
+			{
+			dp[0]=(double(x)+0.5-cx)/fx;
+			
+			/* Undistort the pixel position: */
+			LensDistortion::Point up=ld.undistort(dp);
+			
+			/* Calculate the X and Z table entries: */
+			*xTablePtr=8192.0f*float(up[0]); // Correction factor based on x position to account for distance from lens to IR emitter
+			*zTablePtr=float(unambiguousDistance/Math::sqrt(1.0+up.sqr()));
+			}
+		}
+	}
+
+void KinectV2DepthDecoder::writeCalibration(IO::File& file) const
+	{
+	/* Write the depth camera parameters: */
+	file.write<Misc::Float32>(depthCameraParams.sx);
+	file.write<Misc::Float32>(depthCameraParams.sy);
+	file.write<Misc::Float32>(depthCameraParams.cx);
+	file.write<Misc::Float32>(depthCameraParams.cy);
+	file.write<Misc::Float32>(depthCameraParams.k1);
+	file.write<Misc::Float32>(depthCameraParams.k2);
+	file.write<Misc::Float32>(depthCameraParams.k3);
+	file.write<Misc::Float32>(depthCameraParams.p1);
+	file.write<Misc::Float32>(depthCameraParams.p2);
+	
+	/* Write the phase offset tables: */
+	file.write(p0Tables,3*height*width);
+	}
+
+void KinectV2DepthDecoder::readCalibration(IO::File& file)
+	{
+	/* Read the depth camera parameters: */
+	KinectV2CommandDispatcher::DepthCameraParams dcp;
+	dcp.sx=file.read<Misc::Float32>();
+	dcp.sy=file.read<Misc::Float32>();
+	dcp.cx=file.read<Misc::Float32>();
+	dcp.cy=file.read<Misc::Float32>();
+	dcp.k1=file.read<Misc::Float32>();
+	dcp.k2=file.read<Misc::Float32>();
+	dcp.k3=file.read<Misc::Float32>();
+	dcp.p1=file.read<Misc::Float32>();
+	dcp.p2=file.read<Misc::Float32>();
+	
+	/* Read the phase offset tables: */
+	file.read(p0Tables,3*height*width);
+	
+	/* Recalculate the derived tables: */
+	calcTrigonometryTables();
+	calcXZTables(dcp);
+	}
+
+void KinectV2DepthDecoder::setDMax(unsigned int newDMax)
+	{
+	/* Set the new maximum depth value: */
+	dMax=newDMax;
+	
+	/* Update the z value range with the current values to recalculate the conversion parameters: */
+	setZRange(zMin,zMax);
+	}
+
+void KinectV2DepthDecoder::setZRange(float newZMin,float newZMax)
+	{
+	/* Set the new z value range: */
+	zMin=newZMin;
+	zMax=newZMax;
+	
+	/* Calculate the quantization formula coefficients: */
+	A=(float(dMax)*zMax*zMin)/(zMax-zMin);
+	B=float(dMax)+(float(dMax)*zMin)/(zMax-zMin);
+	}
+
+void KinectV2DepthDecoder::calcPhaseImage(unsigned int exposure,const KinectV2DepthDecoder::IRPixel* const irImages[3])
+	{
+	const unsigned int numPixels=height*width;
+	
+	/* Split the trigonometry table into its planes: */
+	const float* tt[6];
+	for(int i=0;i<6;++i)
+		tt[i]=trigonometryTables[exposure]+i*numPixels;
+	
+	/* Process the image triplet: */
+	float* angles=phaseImages[exposure];
+	float* magnitudes=phaseImages[exposure]+numPixels;
+	unsigned int i=0;
+	#ifdef __SSE2__
+	i=calcPhaseRowSSE(numPixels,irImages[0],irImages[1],irImages[2],tt,magnitudeFactors[exposure],angles,magnitudes);
+	#endif
+	for(int j=0;j<6;++j)
+		tt[j]+=i;
+	calcPhaseRow(numPixels-i,irImages[0]+i,irImages[1]+i,irImages[2]+i,tt,magnitudeFactors[exposure],angles+i,magnitudes+i);
+	}
+
+void KinectV2DepthDecoder::calcDepthImage(FrameSource::DepthPixel* newDepthFrame)
+	{
+	/* Reconstruct the depth frame with the help of all worker threads: */
+	depthFrame=newDepthFrame;
+	runDepthPasses(0);
+	depthFrame=0;
+	}
+
+}
@@ -0,0 +1,123 @@
+/***********************************************************************
+KinectV2DepthDecoder - Class to reconstruct depth images from triplets
+of raw range-gated IR images captured by a Kinect v2 camera.
+Copyright (c) 2015-2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef KINECT_INTERNAL_KINECTV2DEPTHDECODER_INCLUDED
+#define KINECT_INTERNAL_KINECTV2DEPTHDECODER_INCLUDED
+
+#include <Misc/SizedTypes.h>
+#include <Threads/Thread.h>
+#include <Threads/Barrier.h>
+#include <IO/File.h>
+#include <Kinect/FrameSource.h>
+#include <Kinect/Internal/KinectV2CommandDispatcher.h>
+
+namespace Kinect {
+
+class KinectV2DepthDecoder
+	{
+	/* Embedded classes: */
+	public:
+	typedef Misc::SInt16 IRPixel; // Type for raw gated IR image pixels
+	
+	static const unsigned int width=512; // Width of raw IR images and depth images
+	static const unsigned int height=424; // Height of raw IR images and depth images
+	
+	private:
+	struct Band // Structure describing a horizontal band of depth image rows processed by one thread
+		{
+		/* Elements: */
+		public:
+		unsigned int rowBegin,rowEnd; // Half-open range of depth image rows processed by the thread
+		};
+	
+	/* Elements: */
+	Misc::UInt16* p0Tables; // Three per-pixel phase offset tables as downloaded from the camera, kept to save calibration data
+	float* trigonometryTables[3]; // Three arrays of coefficients to convert a range-gated IR image triple into a 2D phase vector, stored as six per-pixel planes
+	float magnitudeFactors[3]; // Multiplication factors for IR pixel intensity for each image triplet
+	float* phaseImages[3]; // Three phase images, each containing a plane of phase angles followed by a plane of magnitudes
+	float magThreshold1,magThreshold2; // Validity thresholds for each exposure's magnitude, and sum of magnitudes
+	float confidenceSlope,confidenceOffset; // Slope and offset for dealiasing confidence check
+	float minConfidence,maxConfidence; // Dealiasing confidence interval
+	float* confidenceTable; // Tabulated confidence function
+	float phaseOffset; // Constant offset to dealiased phase values
+	float unambiguousDistance;
+	KinectV2CommandDispatcher::DepthCameraParams depthCameraParams; // Depth camera parameters from which the X and Z tables were calculated
+	float* xTable;
+	float* zTable;
+	float* depthImage; // Dealiased linear depth image
+	float* filterImage; // Linear depth image after the horizontal pass of the low-pass filter
+	float filterDistanceThreshold; // Threshold value for edge-retaining low-pass filter
+	float zMin,zMax; // Z value range for quantization
+	unsigned int dMax; // Maximum integer depth value
+	float A,B; // Z-to-depth conversion formula coefficients
+	
+	/* Multithreading state: */
+	unsigned int numThreads; // Number of threads reconstructing depth images, including the caller's thread
+	Band* bands; // Array of row bands, one per thread
+	Threads::Thread* workerThreads; // Array of background worker threads; the caller's thread processes band 0
+	Threads::Barrier depthBarrier; // Barrier to synchronize threads between the passes of depth image reconstruction
+	volatile bool shutdownWorkers; // Flag to shut down the worker threads
+	FrameSource::DepthPixel* depthFrame; // Quantized depth frame currently being reconstructed
+	
+	/* Private methods: */
+	void calcTrigonometryTables(void); // Calculates the trigonometry tables from the current phase offset tables
+	void calcDepthRows(const Band& band); // Dealiases the given band of the depth image and runs the horizontal low-pass filter pass over it
+	void filterDepthRows(const Band& band); // Runs the vertical low-pass filter pass over the given band of the depth image and quantizes it into the current depth frame
+	bool runDepthPasses(unsigned int bandIndex); // Runs all passes of depth image reconstruction on the given band, synchronizing with the other threads in between; returns false if worker threads are shutting down
+	void* workerThreadMethod(unsigned int bandIndex); // Thread method for background worker threads
+	
+	/* Constructors and destructors: */
+	public:
+	KinectV2DepthDecoder(unsigned int sNumThreads =1); // Creates an uninitialized depth decoder using the given number of threads to reconstruct depth images
+	private:
+	KinectV2DepthDecoder(const KinectV2DepthDecoder& source); // Prohibit copy constructor
+	KinectV2DepthDecoder& operator=(const KinectV2DepthDecoder& source); // Prohibit assignment operator
+	public:
+	~KinectV2DepthDecoder(void);
+	
+	/* Methods: */
+	unsigned int getNumThreads(void) const // Returns the number of threads used to reconstruct depth images
+		{
+		return numThreads;
+		}
+	void loadP0Tables(IO::FilePtr file); // Reads per-pixel and per-exposure phase offset tables from file
+	void calcXZTables(const KinectV2CommandDispatcher::DepthCameraParams& newDepthCameraParams); // Calculates the X and Z depth calculation tables based on depth camera parameters
+	void writeCalibration(IO::File& file) const; // Writes the depth camera parameters and phase offset tables to the given file
+	void readCalibration(IO::File& file); // Reads depth camera parameters and phase offset tables written by writeCalibration from the given file
+	void setDMax(unsigned int newDMax); // Sets the maximum integer depth value contained in returned depth images; current Kinect package expects 2047; maximum is 65535
+	void setZRange(float newZMin,float newZMax); // Sets the range of linear z values for quantization
+	float getA(void) const // Returns the first z-to-depth conversion formula coefficient
+		{
+		return A;
+		}
+	float getB(void) const // Returns the second z-to-depth conversion formula coefficient
+		{
+		return B;
+		}
+	void calcPhaseImage(unsigned int exposure,const IRPixel* const irImages[3]); // Calculates the phase image of the given exposure from its triplet of raw IR images
+	void calcDepthImage(FrameSource::DepthPixel* newDepthFrame); // Reconstructs a quantized depth frame from the three current phase images using all threads
+	};
+
+}
+
+#endif
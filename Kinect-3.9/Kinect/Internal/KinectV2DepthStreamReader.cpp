@@ -1,7 +1,7 @@
 /***********************************************************************
 KinectV2DepthStreamReader - Class to extract depth images from raw gated
 IR images read from a stream of USB transfer buffers.
-Copyright (c) 2015-2017 Oliver Kreylos
+Copyright (c) 2015-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -24,13 +24,13 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Kinect/Internal/KinectV2DepthStreamReader.h>
 
 #include <string.h>
+#include <unistd.h>
+#include <stdexcept>
 #include <libusb-1.0/libusb.h>
 #include <Misc/FunctionCalls.h>
-#include <Math/Math.h>
-#include <Math/Constants.h>
 #include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameBufferPool.h>
 #include <Kinect/FrameSource.h>
-#include <Kinect/LensDistortion.h>
 #include <Kinect/CameraV2.h>
 
 // DEBUGGING
@@ -38,6 +38,21 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 namespace Kinect {
 
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+unsigned int getNumDecoderThreads(void)
+	{
+	/* Use up to four of the host's CPUs to reconstruct depth images: */
+	long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+	return numCpus>=4?4U:numCpus>=1?(unsigned int)(numCpus):1U;
+	}
+
+}
+
 /******************************************
 Methods of class KinectV2DepthStreamReader:
 ******************************************/
@@ -65,92 +80,7 @@ void* KinectV2DepthStreamReader::phaseThreadMethod(int exposure)
 		// std::cout<<"Phase "<<exposure<<": Frame "<<nextFrameNumber<<" at time "<<phaseFrameTimeStamp<<std::endl;
 		
 		/* Process the image triplet: */
-		const IRPixel* i0Ptr=inputBuffers[exposure*3+0];
-		const IRPixel* i1Ptr=inputBuffers[exposure*3+1];
-		const IRPixel* i2Ptr=inputBuffers[exposure*3+2];
-		const float* ttPtr=trigonometryTables[exposure];
-		float* piPtr=phaseImages[exposure];
-		for(unsigned int y=0;y<424;++y)
-			for(unsigned int x=0;x<512;++x,++i0Ptr,++i1Ptr,++i2Ptr,ttPtr+=6,piPtr+=2)
-				{
-				/* Check for pixel saturation: */
-				if(*i0Ptr!=32767&&*i1Ptr!=32767&&*i2Ptr!=32767)
-					{
-					/* Calculate the phase vector normally: */
-					float x=ttPtr[0]*float(*i0Ptr)+ttPtr[1]*float(*i1Ptr)+ttPtr[2]*float(*i2Ptr);
-					float y=ttPtr[3]*float(*i0Ptr)+ttPtr[4]*float(*i1Ptr)+ttPtr[5]*float(*i2Ptr);
-					
-					/* Calculate the pixel's phase angle in the [0, 2pi) range: */
-					if(y>=0.0f)
-						{
-						if(x>=0.0f)
-							{
-							if(y<=x)
-								{
-								if(x>0.0f)
-									{
-									/* 0-45 degrees: */
-									piPtr[0]=arctanTable[int(y*8192.0f/x)];
-									}
-								else
-									piPtr[0]=0.0f; // NaN, actually
-								}
-							else
-								{
-								/* 45-90 degrees: */
-								piPtr[0]=0.5f*Math::Constants<float>::pi-arctanTable[int(x*8192.0f/y)];
-								}
-							}
-						else // x<0.0f
-							{
-							if(-x<=y)
-								{
-								/* 90-135 degrees: */
-								piPtr[0]=0.5f*Math::Constants<float>::pi+arctanTable[int(x*-8192.0f/y)];
-								}
-							else
-								{
-								/* 135-180 degrees: */
-								piPtr[0]=1.0f*Math::Constants<float>::pi-arctanTable[int(y*-8192.0f/x)];
-								}
-							}
-						}
-					else // y<0.0f
-						{
-						if(x<=0.0f)
-							{
-							if(x<=y)
-								{
-								/* 180-225 degrees: */
-								piPtr[0]=1.0f*Math::Constants<float>::pi+arctanTable[int(y*8192.0f/x)];
-								}
-							else
-								{
-								/* 225-270 degrees: */
-								piPtr[0]=1.5f*Math::Constants<float>::pi-arctanTable[int(x*8192.0f/y)];
-								}
-							}
-						else
-							{
-							if(x<=-y)
-								{
-								/* 270-315 degrees: */
-								piPtr[0]=1.5f*Math::Constants<float>::pi+arctanTable[int(x*-8192.0f/y)];
-								}
-							else
-								{
-								/* 315-360 degrees: */
-								piPtr[0]=2.0f*Math::Constants<float>::pi-arctanTable[int(y*-8192.0f/x)];
-								}
-							}
-						}
-					
-					/* Calculate the pixel's squared magnitude: */
-					piPtr[1]=Math::sqrt(x*x+y*y)*magnitudeFactors[exposure];
-					}
-				else
-					piPtr[1]=piPtr[0]=0.0f;
-				}
+		decoder.calcPhaseImage(exposure,inputBuffers+exposure*3);
 		
 		// DEBUGGING
 		// std::cout<<double(start.setAndDiff())*1000.0<<"ms"<<std::endl;
@@ -171,9 +101,6 @@ void* KinectV2DepthStreamReader::phaseThreadMethod(int exposure)
 
 void* KinectV2DepthStreamReader::depthThreadMethod(void)
 	{
-	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
-	// Threads::Thread::setCancelType(Threads::Thread::CANCEL_ASYNCHRONOUS);
-	
 	while(true)
 		{
 		/* Wait for the next wake-up call: */
@@ -181,8 +108,10 @@ void* KinectV2DepthStreamReader::depthThreadMethod(void)
 		double nextFrameTimeStamp;
 		{
 		Threads::MutexCond::Lock depthThreadLock(depthThreadCond);
-		while(depthFrameNumber==phaseFrameNumbers[0]||depthFrameNumber==phaseFrameNumbers[1]||depthFrameNumber==phaseFrameNumbers[2])
+		while(!shutdownDepthThread&&(depthFrameNumber==phaseFrameNumbers[0]||depthFrameNumber==phaseFrameNumbers[1]||depthFrameNumber==phaseFrameNumbers[2]))
 			depthThreadCond.wait(depthThreadLock);
+		if(shutdownDepthThread)
+			break;
 		nextFrameNumber=phaseFrameNumbers[0];
 		nextFrameTimeStamp=phaseFrameTimeStamp;
 		}
@@ -192,169 +121,10 @@ void* KinectV2DepthStreamReader::depthThreadMethod(void)
 		// Realtime::TimePointMonotonic start;
 		// std::cout<<"Depth: Frame "<<nextFrameNumber<<" at time "<<nextFrameTimeStamp<<std::endl;
 		
-		const float* pi0Ptr=phaseImages[0];
-		const float* pi1Ptr=phaseImages[1];
-		const float* pi2Ptr=phaseImages[2];
-		const float* xPtr=xTable;
-		const float* zPtr=zTable;
-		float* diPtr=depthImage;
-		const float twoPi=2.0f*Math::Constants<float>::pi;
-		for(int y=0;y<424;++y)
-			for(int x=0;x<512;++x,pi0Ptr+=2,pi1Ptr+=2,pi2Ptr+=2,++xPtr,++zPtr,++diPtr)
-				{
-				*diPtr=0.0f;
-				
-				float magSum=pi0Ptr[1]+pi1Ptr[1]+pi2Ptr[1];
-				float magMin=Math::min(pi0Ptr[1],Math::min(pi1Ptr[1],pi2Ptr[1]));
-				if(magMin>=magThreshold1&&magSum>=magThreshold2)
-					{
-					/* Convert phase angles to wave distances: */
-					float t0=pi0Ptr[0]*3.0f/twoPi;
-					float t1=pi1Ptr[0]*15.0f/twoPi;
-					float t2=pi2Ptr[0]*2.0f/twoPi;
-					
-					float t5=Math::floor((t1-t0)*0.333333f+0.5f)*3.0f+t0;
-					float t3=t5-t2;
-					float f1=t3>=0.0f?2.0f:-2.0f;
-					float f2=t3>=0.0f?0.5f:-0.5f;
-					t3*=f2;
-					t3=(t3-int(t3))*f1; // t3 is always >=0
-					
-					float t6=t5;
-					float t7=t1;
-					// if(Math::abs(t3-1.0f)<0.5f) // Good optimization; slight changes around edges
-					if(0.5f<Math::abs(t3)&&Math::abs(t3)<1.5f)
-						{
-						t6+=15.0f;
-						t7+=15.0f;
-						}
-					
-					float t8=(Math::floor((t6-t2)*0.5f+0.5f)*2.0f+t2)*0.5f;
-					
-					t6/=3.0f;
-					t7/=15.0f;
-					
-					float t9=(t6+t7+t8);
-					float t10=t9/3.0f;
-					
-					t6*=twoPi;
-					t7*=twoPi;
-					t8*=twoPi;
-					
-        	float t6p=t8*0.551318f-t6*0.826977f;
-        	float t7p=t6*0.110264f-t7*0.551318f;
-        	float t8p=t7*0.826977f-t8*0.110264f;
-					
-					t6=t6p;
-					t7=t7p;
-					t8=t8p;
-					
-					float norm=t6*t6+t7*t7+t8*t8;
-					#if 0
-					float mask=t9>=0.0f?1.0f:0.0f;
-					t10*=mask;
-					#else
-					if(t9<0.0f)
-						t10=0.0f;
-					#endif
-					
-					#if 0 // Use when confidenceSlope>0.0f
-					float irX=confidenceTable[Math::clamp(int(magMin),304,871)-304];
-					#else // Use when confidenceSlope<=0.0f
-					float irX=confidenceTable[Math::clamp(int(Math::max(pi0Ptr[1],Math::max(pi1Ptr[1],pi2Ptr[1]))),304,871)-304];
-					#endif
-					float t11=irX>=norm?t10:0.0f;
-					
-					#if 0
-					if(norm>maxConfidence*maxConfidence)
-						t10=0.0f;
-					#endif
-					
-					float phase=t11;
-					if(phase>0.0f)
-						{
-						phase+=phaseOffset;
-						
-						float depthLinear=*zPtr*phase;
-						float maxDepth=phase*unambiguousDistance*2.0f;
-						
-						float xFactor=*xPtr*90.0f/(maxDepth*maxDepth*8192.0f);
-						float denominator=(1.0f-depthLinear*xFactor);
-						if(denominator>0.0f)
-							*diPtr=depthLinear/denominator;
-						}
-					}
-				}
-		
-		/* Run a spatial low-pass filter over the depth image: */
-		for(int y=0;y<424;++y)
-			{
-			float* diPtr=depthImage+y*512;
-			float last=diPtr[0];
-			if(Math::abs(diPtr[0]-diPtr[1])<filterDistanceThreshold)
-				diPtr[0]=diPtr[0]*0.667f+diPtr[1]*0.333f;
-			++diPtr;
-			for(int x=1;x<512-1;++x,++diPtr)
-				{
-				float sum=diPtr[0]+diPtr[0];
-				float weight=2.0f;
-				if(Math::abs(diPtr[0]-last)<filterDistanceThreshold)
-					{
-					sum+=last;
-					weight+=1.0f;
-					}
-				if(Math::abs(diPtr[0]-diPtr[1])<filterDistanceThreshold)
-					{
-					sum+=diPtr[1];
-					weight+=1.0f;
-					}
-				last=diPtr[0];
-				diPtr[0]=sum/weight;
-				}
-			if(Math::abs(diPtr[0]-last)<filterDistanceThreshold)
-				diPtr[0]=last*0.333f+diPtr[0]*0.667f;
-			}
-		for(int x=0;x<512;++x)
-			{
-			float* diPtr=depthImage+x;
-			float last=diPtr[0];
-			if(Math::abs(diPtr[0]-diPtr[512])<filterDistanceThreshold)
-				diPtr[0]=diPtr[0]*0.667f+diPtr[512]*0.333f;
-			diPtr+=512;
-			for(int y=1;y<424-1;++y,diPtr+=512)
-				{
-				float sum=diPtr[0]+diPtr[0];
-				float weight=2.0f;
-				if(Math::abs(diPtr[0]-last)<filterDistanceThreshold)
-					{
-					sum+=last;
-					weight+=1.0f;
-					}
-				if(Math::abs(diPtr[0]-diPtr[512])<filterDistanceThreshold)
-					{
-					sum+=diPtr[512];
-					weight+=1.0f;
-					}
-				last=diPtr[0];
-				diPtr[0]=sum/weight;
-				}
-			if(Math::abs(diPtr[0]-last)<filterDistanceThreshold)
-				diPtr[0]=last*0.333f+diPtr[0]*0.667f;
-			}
-		
-		/* Quantize the depth image: */
-		FrameBuffer depthFrame(512,424,424*512*sizeof(FrameSource::DepthPixel));
+		/* Reconstruct and quantize the depth image using the decoder's worker threads: */
+		FrameBuffer depthFrame=FrameBufferPool::getDefaultPool().allocate(512,424,424*512*sizeof(FrameSource::DepthPixel));
 		depthFrame.timeStamp=nextFrameTimeStamp;
-		diPtr=depthImage;
-		FrameSource::DepthPixel* fPtr=depthFrame.getData<FrameSource::DepthPixel>();
-		for(int y=0;y<424;++y)
-			for(int x=0;x<512;++x,++diPtr,++fPtr)
-				{
-				if(*diPtr<zMin||*diPtr>zMax)
-					*fPtr=FrameSource::invalidDepth;
-				else
-					*fPtr=FrameSource::DepthPixel(B-A/(*diPtr));
-				}
+		decoder.calcDepthImage(depthFrame.getData<FrameSource::DepthPixel>());
 		
 		// DEBUGGING
 		// std::cout<<double(start.setAndDiff())*1000.0<<"ms"<<std::endl;
@@ -379,18 +149,14 @@ KinectV2DepthStreamReader::KinectV2DepthStreamReader(CameraV2& sCamera)
 	 inputBufferBlock(0),
 	 frameStart(true),frameNumber(0),currentImage(0),nextRow(0),frameValid(true),
 	 rawImageReadyCallback(0),
-	 arctanTable(0),
-	 confidenceTable(0),xTable(0),zTable(0),
-	 depthImage(0),depthFrameNumber(0),
+	 decoder(getNumDecoderThreads()),
+	 shutdownDepthThread(false),depthFrameNumber(0),
 	 imageReadyCallback(0)
 	{
 	for(int i=0;i<10;++i)
 		inputBuffers[i]=0;
 	for(int exposure=0;exposure<3;++exposure)
-		{
-		trigonometryTables[exposure]=0;
-		phaseImages[exposure]=0;
-		}
+		phaseFrameNumbers[exposure]=0;
 	
 	/* Allocate and initialize the uncompression look-up table (upper half of table are negative values): */
 	decompressTable=new IRPixel[2048];
@@ -417,68 +183,6 @@ KinectV2DepthStreamReader::KinectV2DepthStreamReader(CameraV2& sCamera)
 	inputBufferBlock=new IRPixel[10*424*512];
 	for(unsigned int i=0;i<10;++i)
 		inputBuffers[i]=inputBufferBlock+i*424*512;
-	
-	/* Create the trigonometry coefficient tables: */
-	for(int exposure=0;exposure<3;++exposure)
-		trigonometryTables[exposure]=new float[424*512*6];
-	
-	/* Create the arctangent table: */
-	arctanTable=new float[8193];
-	for(int i=0;i<8192;++i)
-		arctanTable[i]=Math::atan((float(i)+0.5f)/8192.0f);
-	arctanTable[8192]=arctanTable[8191];
-	
-	/* Initialize the magnitude multipliers: */
-	magnitudeFactors[0]=1.322581f*0.6666667f;
-	magnitudeFactors[1]=1.0f*0.6666667f;
-	magnitudeFactors[2]=1.612903f*0.6666667f;
-	
-	/* Allocate the phase images: */
-	for(int exposure=0;exposure<3;++exposure)
-		{
-		phaseImages[exposure]=new float[424*512*2];
-		phaseFrameNumbers[exposure]=0;
-		}
-	
-	/* Initialize the magnitude thresholds: */
-	magThreshold1=3.0f;
-	magThreshold2=10.0f;
-	
-	/* Initialize the dealiasing confidence check parameters: */
-	confidenceSlope=-0.5330578f*0.301030f*3.321928f;
-	confidenceOffset=0.7694894f*3.321928f;
-
-	minConfidence=0.3490659f;
-	maxConfidence=0.6108653f;
-	
-	/* Initialize the dealiasing confidence table: */
-	confidenceTable=new float[871-304+1];
-	for(int i=304;i<=871;++i)
-		{
-		float irX=float(i)+0.5f;
-		irX=Math::exp(Math::log(irX)*confidenceSlope+confidenceOffset);
-		irX=Math::clamp(irX,minConfidence,maxConfidence);
-		irX*=irX;
-		confidenceTable[i-304]=irX;
-		}
-	
-	/* Initialize phase-to-depth calculation parameters: */
-	phaseOffset=0.0f;
-	unambiguousDistance=6250.0f/3.0f; // Magic number
-	
-	/* Allocate the x and z tables: */
-	xTable=new float[424*512];
-	zTable=new float[424*512];
-	
-	/* Allocate the linear depth image: */
-	depthImage=new float[424*512];
-	
-	/* Set the filter threshold: */
-	filterDistanceThreshold=50.0f;
-	
-	/* Initialize the quantization parameters: */
-	dMax=2047U;
-	setZRange(500.0f,5000.0f);
 	}
 
 KinectV2DepthStreamReader::~KinectV2DepthStreamReader(void)
@@ -493,125 +197,6 @@ KinectV2DepthStreamReader::~KinectV2DepthStreamReader(void)
 	
 	/* Delete the raw image callback: */
 	delete rawImageReadyCallback;
-	
-	/* Delete the trigonometry coefficient tables: */
-	for(int exposure=0;exposure<3;++exposure)
-		delete[] trigonometryTables[exposure];
-	
-	/* Delete the phase images: */
-	for(int exposure=0;exposure<3;++exposure)
-		delete[] phaseImages[exposure];
-	
-	/* Delete the depth calculation tables: */
-	delete[] confidenceTable;
-	delete[] xTable;
-	delete[] zTable;
-	
-	/* Delete the depth image: */
-	delete[] depthImage;
-	}
-
-void KinectV2DepthStreamReader::loadP0Tables(IO::FilePtr file)
-	{
-	file->setEndianness(Misc::LittleEndian);
-	
-	/* Skip the file header: */
-	file->skip<Misc::UInt32>(8);
-	
-	/* Allocate a temporary table: */
-	Misc::UInt16* p0Table=new Misc::UInt16[424*512];
-	
-	/* Load the three tables: */
-	for(int exposure=0;exposure<3;++exposure)
-		{
-		/* Load the raw p0 table: */
-		file->skip<Misc::UInt16>(1);
-		file->read(p0Table,424*512);
-		file->skip<Misc::UInt16>(1);
-		
-		/* Calculate the trigonometry table: */
-		const Misc::UInt16* ptPtr=p0Table;
-		float* ttPtr=trigonometryTables[exposure];
-		for(unsigned int y=0;y<424;++y)
-			for(unsigned int x=0;x<512;++x,++ptPtr,ttPtr+=6)
-				{
-				/* Convert the per-pixel phase offset to radians: */
-				float p=-2.0f*Math::Constants<float>::pi*float(*ptPtr)/65536.0f;
-				
-				/* Calculate the per-image phase angles: */
-				float p0=p; // First image in a triplet is at base angle
-				float p1=p+2.0f*Math::Constants<float>::pi/3.0f; // Second image is 120 degrees ahead
-				float p2=p+4.0f*Math::Constants<float>::pi/3.0f; // Third image is 240 degrees ahead
-				
-				/* Calculate the per-image phase angle cosines and sines: */
-				ttPtr[0]=Math::cos(p0);
-				ttPtr[1]=Math::cos(p1);
-				ttPtr[2]=Math::cos(p2);
-				
-				ttPtr[3]=-Math::sin(p0);
-				ttPtr[4]=-Math::sin(p1);
-				ttPtr[5]=-Math::sin(p2);
-				}
-		}
-	
-	/* Clean up: */
-	delete[] p0Table;
-	}
-
-void KinectV2DepthStreamReader::calcXZTables(const KinectV2CommandDispatcher::DepthCameraParams& depthCameraParams)
-	{
-	/* Get depth camera parameters: */
-	double fx=depthCameraParams.sx;
-	double cx=depthCameraParams.cx;
-	double fy=depthCameraParams.sy;
-	double cy=depthCameraParams.cy;
-	LensDistortion ld;
-	ld.setKappa(0,depthCameraParams.k1);
-	ld.setKappa(1,depthCameraParams.k2);
-	ld.setKappa(2,depthCameraParams.k3);
-	ld.setRho(0,depthCameraParams.p1);
-	ld.setRho(1,depthCameraParams.p2);
-	
-	/* Calculate X and Z tables: */
-	float* xTablePtr=xTable;
-	float* zTablePtr=zTable;
-	for(int y=0;y<424;++y)
-		{
-		/* Calculate the distorted pixel position in normalized projection space: */
-		LensDistortion::Point dp;
-		dp[1]=(double(y)+0.5-cy)/fy;
-		for(int x=0;x<512;++x,++xTablePtr,++zTablePtr)
-			{
-			dp[0]=(double(x)+0.5-cx)/fx;
-			
-			/* Undistort the pixel position: */
-			LensDistortion::Point up=ld.undistort(dp);
-			
-			/* Calculate the X and Z table entries: */
-			*xTablePtr=8192.0f*float(up[0]); // Correction factor based on x position to account for distance from lens to IR emitter
-			*zTablePtr=float(unambiguousDistance/Math::sqrt(1.0+up.sqr()));
-			}
-		}
-	}
-
-void KinectV2DepthStreamReader::setDMax(unsigned int newDMax)
-	{
-	/* Set the new maximum depth value: */
-	dMax=newDMax;
-	
-	/* Update the z value range with the current values to recalculate the conversion parameters: */
-	setZRange(zMin,zMax);
-	}
-
-void KinectV2DepthStreamReader::setZRange(float newZMin,float newZMax)
-	{
-	/* Set the new z value range: */
-	zMin=newZMin;
-	zMax=newZMax;
-	
-	/* Calculate the quantization formula coefficients: */
-	A=(float(dMax)*zMax*zMin)/(zMax-zMin);
-	B=float(dMax)+(float(dMax)*zMin)/(zMax-zMin);
 	}
 
 void KinectV2DepthStreamReader::postTransfer(USB::TransferPool::Transfer* newTransfer,USB::TransferPool* newTransferPool)
@@ -762,6 +347,21 @@ void KinectV2DepthStreamReader::postTransfer(USB::TransferPool::Transfer* newTra
 						(*rawImageReadyCallback)(ri);
 						}
 					
+					/* Write the raw IR image to the capture file: */
+					if(rawCaptureFile!=0)
+						{
+						try
+							{
+							rawCaptureFile->write<Misc::UInt32>(currentImage);
+							rawCaptureFile->write(inputBuffers[currentImage],424*512);
+							}
+						catch(const std::runtime_error&)
+							{
+							/* Stop capturing after a write error: */
+							rawCaptureFile=0;
+							}
+						}
+					
 					/* Finish the current image: */
 					++currentImage;
 					if(currentImage==10)
@@ -816,6 +416,17 @@ void KinectV2DepthStreamReader::setRawImageReadyCallback(KinectV2DepthStreamRead
 	delete previousCallback;
 	}
 
+void KinectV2DepthStreamReader::setRawCaptureFile(IO::FilePtr newRawCaptureFile)
+	{
+	rawCaptureFile=newRawCaptureFile;
+	if(rawCaptureFile!=0)
+		{
+		/* Write the depth calibration required to reconstruct depth images from the captured raw IR images: */
+		rawCaptureFile->setEndianness(Misc::LittleEndian);
+		decoder.writeCalibration(*rawCaptureFile);
+		}
+	}
+
 USB::TransferPool::UserTransferCallback*  KinectV2DepthStreamReader::startStreaming(USB::TransferPool* newTransferPool,KinectV2DepthStreamReader::ImageReadyCallback* newImageReadyCallback)
 	{
 	/* Remember the source transfer pool: */
@@ -838,13 +449,20 @@ USB::TransferPool::UserTransferCallback*  KinectV2DepthStreamReader::startStream
 
 void KinectV2DepthStreamReader::stopStreaming(void)
 	{
-	/* Shut down the decoding threads: */
+	/* Shut down the phase calculation threads: */
 	for(int exposure=0;exposure<3;++exposure)
 		phaseThreads[exposure].cancel();
-	depthThread.cancel();
 	for(int exposure=0;exposure<3;++exposure)
 		phaseThreads[exposure].join();
+	
+	/* Shut down the depth calculation thread: */
+	{
+	Threads::MutexCond::Lock depthThreadLock(depthThreadCond);
+	shutdownDepthThread=true;
+	depthThreadCond.signal();
+	}
 	depthThread.join();
+	shutdownDepthThread=false;
 	
 	/* Forget the assigned transfer pool: */
 	transferPool=0;
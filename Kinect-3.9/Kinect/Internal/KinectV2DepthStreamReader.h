@@ -30,6 +30,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <IO/File.h>
 #include <USB/TransferPool.h>
 #include <Kinect/Internal/KinectV2CommandDispatcher.h>
+#include <Kinect/Internal/KinectV2DepthDecoder.h>
 
 /* Forward declarations: */
 namespace Misc {
@@ -47,7 +48,7 @@ class KinectV2DepthStreamReader
 	{
 	/* Embedded classes: */
 	public:
-	typedef Misc::SInt16 IRPixel; // Type for raw gated IR image pixels
+	typedef KinectV2DepthDecoder::IRPixel IRPixel; // Type for raw gated IR image pixels
 	
 	struct RawImage // Structure to pass raw range-gated IR images to an interested party
 		{
@@ -75,30 +76,16 @@ class KinectV2DepthStreamReader
 	bool frameValid; // Flag to keep track of errors during frame processing
 	double frameTimeStamp; // Time stamp for the frame that was just received over USB
 	RawImageReadyCallback* rawImageReadyCallback; // Function called whenever a raw range-gated IR image has been decompressed
-	float* trigonometryTables[3]; // Three arrays of coefficients to convert a range-gated IR image triple into a 2D phase vector
-	float* arctanTable; // Table to calculate phase angles from orthogonal vectors
-	float magnitudeFactors[3]; // Multiplication factors for IR pixel intensity for each image triplet
+	IO::FilePtr rawCaptureFile; // File to which decompressed raw gated IR images are written as they are received, or null
+	KinectV2DepthDecoder decoder; // Object reconstructing depth images from raw gated IR images
 	Threads::Thread phaseThreads[3]; // Three threads to calculate phase vector image for each exposure in parallel
 	Threads::MutexCond phaseThreadConds[3]; // Three condition variables to wake up the phase angle calculation threads
-	float* phaseImages[3]; // Three phase images, containing (angle, squared magnitude) pairs
 	double phaseFrameTimeStamp; // Time stamp of the frame currently processed by the phase calculation threads
 	unsigned int phaseFrameNumbers[3]; // Index of phase image currently in the phase image buffers
 	Threads::Thread depthThread; // Thread to convert a triplet of phase images into a depth image
 	Threads::MutexCond depthThreadCond; // Condition variable to wake up the depth calculation thread
-	float magThreshold1,magThreshold2; // Validity thresholds for each exposure's magnitude, and sum of magnitudes
-	float confidenceSlope,confidenceOffset; // Slope and offset for dealiasing confidence check
-	float minConfidence,maxConfidence; // Dealiasing confidence interval
-	float* confidenceTable; // Tabulated confidence function
-	float phaseOffset; // Constant offset to dealiased phase values
-	float unambiguousDistance;
-	float* xTable;
-	float* zTable;
-	float* depthImage; // Final depth image
-	float filterDistanceThreshold; // Threshold value for edge-retaining low-pass filter
+	bool shutdownDepthThread; // Flag to shut down the depth calculation thread, which can not be cancelled while it is synchronizing with the decoder's worker threads
 	unsigned int depthFrameNumber; // Index of depth image currently in the buffer
-	float zMin,zMax; // Z value range for quantization
-	unsigned int dMax; // Maximum integer depth value
-	float A,B; // Z-to-depth conversion formula coefficients
 	ImageReadyCallback* imageReadyCallback; // Function called whenever a new image has been decompressed
 	
 	/* Private methods: */
@@ -111,20 +98,33 @@ class KinectV2DepthStreamReader
 	~KinectV2DepthStreamReader(void); // Destroys the stream reader
 	
 	/* Methods: */
-	void loadP0Tables(IO::FilePtr file); // Reads per-pixel and per-exposure phase offset tables from file
-	void calcXZTables(const KinectV2CommandDispatcher::DepthCameraParams& depthCameraParams); // Calculates the X and Z depth calculation tables based on depth camera parameters
-	void setDMax(unsigned int newDMax); // Sets the maximum integer depth value contained in returned depth images; current Kinect package expects 2047; maximum is 65535
-	void setZRange(float newZMin,float newZMax); // Sets the range of linear z values for quantization
+	void loadP0Tables(IO::FilePtr file) // Reads per-pixel and per-exposure phase offset tables from file
+		{
+		decoder.loadP0Tables(file);
+		}
+	void calcXZTables(const KinectV2CommandDispatcher::DepthCameraParams& depthCameraParams) // Calculates the X and Z depth calculation tables based on depth camera parameters
+		{
+		decoder.calcXZTables(depthCameraParams);
+		}
+	void setDMax(unsigned int newDMax) // Sets the maximum integer depth value contained in returned depth images; current Kinect package expects 2047; maximum is 65535
+		{
+		decoder.setDMax(newDMax);
+		}
+	void setZRange(float newZMin,float newZMax) // Sets the range of linear z values for quantization
+		{
+		decoder.setZRange(newZMin,newZMax);
+		}
 	float getA(void) const // Returns the first z-to-depth conversion formula coefficient
 		{
-		return A;
+		return decoder.getA();
 		}
 	float getB(void) const // Returns the second z-to-depth conversion formula coefficient
 		{
-		return B;
+		return decoder.getB();
 		}
 	void postTransfer(USB::TransferPool::Transfer* newTransfer,USB::TransferPool* newTransferPool); // Writes the given transfer into the raw input buffer
 	void setRawImageReadyCallback(RawImageReadyCallback* newRawImageReadyCallback); // Installs a function to be called when a raw range-gated IR image is decompressed
+	void setRawCaptureFile(IO::FilePtr newRawCaptureFile); // Writes the current depth calibration to the given file, and then all subsequently received raw range-gated IR images; must not be called while streaming
 	USB::TransferPool::UserTransferCallback* startStreaming(USB::TransferPool* newTransferPool,ImageReadyCallback* newImageReadyCallback); // Starts the decoding thread(s) and registers the given callback; returns a callback set up to receive USB transfer buffers
 	void stopStreaming(void); // Stops background decoding
 	};
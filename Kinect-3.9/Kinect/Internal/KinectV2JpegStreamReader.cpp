@@ -1,7 +1,7 @@
 /***********************************************************************
 KinectV2JpegStreamReader - Class to read JPEG-compressed RGB images
 asynchronously from a stream of USB transfer buffers.
-Copyright (c) 2014-2018 Oliver Kreylos
+Copyright (c) 2014-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -23,62 +23,202 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <Kinect/Internal/KinectV2JpegStreamReader.h>
 
+#include <unistd.h>
+#include <string.h>
+#include <stdexcept>
 #include <libusb-1.0/libusb.h>
 #include <Misc/SizedTypes.h>
 #include <Misc/ThrowStdErr.h>
 #include <Misc/FunctionCalls.h>
 #include <Misc/MessageLogger.h>
 #include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameBufferPool.h>
 #include <Kinect/CameraV2.h>
 
-// DEBUGGING
-#include <iostream>
-
 namespace Kinect {
 
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+unsigned int getNumDecoderThreads(void)
+	{
+	/* Use up to three of the host's CPUs to decompress color images: */
+	long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+	return numCpus>=3?3U:numCpus>=1?(unsigned int)(numCpus):1U;
+	}
+
+void errorExitFunction(j_common_ptr cinfo)
+	{
+	/* Throw an exception: */
+	jpeg_error_mgr* err=cinfo->err;
+	Misc::throwStdErr(err->jpeg_message_table[err->msg_code],err->msg_parm.i[0],err->msg_parm.i[1],err->msg_parm.i[2],err->msg_parm.i[3],err->msg_parm.i[4],err->msg_parm.i[5],err->msg_parm.i[6],err->msg_parm.i[7]);
+	}
+
+}
+
+/***********************************************************
+Methods of class KinectV2JpegStreamReader::CompressedFrame:
+***********************************************************/
+
+void KinectV2JpegStreamReader::CompressedFrame::append(const void* newData,size_t newDataSize)
+	{
+	/* Grow the data buffer if necessary: */
+	if(dataSize+newDataSize>allocSize)
+		{
+		size_t newAllocSize=allocSize>0?allocSize:size_t(0x80000);
+		while(newAllocSize<dataSize+newDataSize)
+			newAllocSize*=2;
+		JOCTET* newBuffer=new JOCTET[newAllocSize];
+		memcpy(newBuffer,data,dataSize);
+		delete[] data;
+		data=newBuffer;
+		allocSize=newAllocSize;
+		}
+	
+	/* Append the new data: */
+	memcpy(data+dataSize,newData,newDataSize);
+	dataSize+=newDataSize;
+	}
+
 /*****************************************
 Methods of class KinectV2JpegStreamReader:
 *****************************************/
 
-void KinectV2JpegStreamReader::getNextTransfer(void)
+bool KinectV2JpegStreamReader::getNextTransfer(void)
 	{
 	/* Keep grabbing transfer buffers until a non-empty one is found: */
-	do
+	while(true)
 		{
-		/* Release the current transfer buffer if there is one: */
-		if(currentTransfer!=0)
-			transferPool->release(currentTransfer);
-		
 		/* Wait for the next transfer buffer: */
 		{
 		Threads::MutexCond::Lock inQueueLock(inQueueCond);
 		
 		/* Block while the input queue is empty: */
-		while(inQueue.empty())
+		while(!shutdownThreads&&inQueue.empty())
 			inQueueCond.wait(inQueueLock);
+		if(shutdownThreads)
+			return false;
 		
 		/* Get and remove the first transfer from the input queue: */
 		currentTransfer=inQueue.pop_front();
 		}
+		
+		if(currentTransfer->getTransfer().actual_length!=0)
+			return true;
+		
+		/* Release the empty transfer buffer: */
+		releaseCurrentTransfer();
 		}
-	while(currentTransfer->getTransfer().actual_length==0);
-	
-	/* Set the JPEG decompressor's input buffer to the next transfer's data: */
-	sourceManager.bytes_in_buffer=currentTransfer->getTransfer().actual_length;
-	sourceManager.next_input_byte=currentTransfer->getTransfer().buffer;
-	frameSize+=currentTransfer->getTransfer().actual_length;
 	}
 
-void KinectV2JpegStreamReader::errorExitFunction(j_common_ptr cinfo)
+void KinectV2JpegStreamReader::releaseCurrentTransfer(void)
+	{
+	transferPool->release(currentTransfer);
+	currentTransfer=0;
+	}
+
+bool KinectV2JpegStreamReader::isImageStart(void) const
+	{
+	/* Check the magic number and the JPEG header: */
+	const libusb_transfer& transfer=currentTransfer->getTransfer();
+	if(transfer.actual_length<int(2*sizeof(Misc::UInt32)+2))
+		return false;
+	const Misc::UInt32* rpPtr=reinterpret_cast<const Misc::UInt32*>(transfer.buffer);
+	const unsigned char* jPtr=reinterpret_cast<const unsigned char*>(rpPtr+2);
+	return rpPtr[1]==0x42424242U&&jPtr[0]==0xffU&&jPtr[1]==0xd8U;
+	}
+
+void* KinectV2JpegStreamReader::assemblyThreadMethod(void)
 	{
-	/* Mark the current image as invalid: */
-	static_cast<KinectV2JpegStreamReader*>(cinfo->client_data)->error=true;
+	/* Wait for the first transfer buffer: */
+	if(!getNextTransfer())
+		return 0;
 	
-	/* Log an error message: */
-	jpeg_error_mgr* err=cinfo->err;
-	std::string errorMessage="KinectV2JpegStreamReader: ";
-	errorMessage.append(err->jpeg_message_table[err->msg_code]);
-	Misc::formattedConsoleError(errorMessage.c_str(),err->msg_parm.i[0],err->msg_parm.i[1],err->msg_parm.i[2],err->msg_parm.i[3],err->msg_parm.i[4],err->msg_parm.i[5],err->msg_parm.i[6],err->msg_parm.i[7]);
+	while(true)
+		{
+		/* Skip transfer buffers until one starts a new image: */
+		while(!isImageStart())
+			{
+			releaseCurrentTransfer();
+			if(!getNextTransfer())
+				return 0;
+			}
+		
+		/* Grab a free compressed image buffer: */
+		CompressedFrame* frame;
+		{
+		Threads::MutexCond::Lock decodeQueueLock(decodeQueueCond);
+		if(!freeFrames.empty())
+			{
+			frame=freeFrames.back();
+			freeFrames.pop_back();
+			}
+		else
+			{
+			/* Drop the oldest waiting image: */
+			frame=decodeQueue.front();
+			decodeQueue.pop_front();
+			++statistics.numFramesDropped;
+			}
+		}
+		
+		/* Time-stamp the new image: */
+		frame->arrivalTime.set();
+		
+		/* Shave the Kinect2 image header off the first transfer buffer and start the compressed image: */
+		const libusb_transfer* transfer=&currentTransfer->getTransfer();
+		frame->dataSize=0;
+		frame->append(transfer->buffer+2*sizeof(Misc::UInt32),transfer->actual_length-2*sizeof(Misc::UInt32));
+		
+		/* Append transfer buffers until the end of the current batch of transfers: */
+		bool complete=transfer->actual_length<transfer->length;
+		releaseCurrentTransfer();
+		while(!complete)
+			{
+			if(!getNextTransfer())
+				{
+				/* Return the partial image and bail out: */
+				Threads::MutexCond::Lock decodeQueueLock(decodeQueueCond);
+				freeFrames.push_back(frame);
+				return 0;
+				}
+			
+			/* Stop if the new transfer buffer already starts the next image: */
+			if(isImageStart())
+				break;
+			
+			transfer=&currentTransfer->getTransfer();
+			frame->append(transfer->buffer,transfer->actual_length);
+			complete=transfer->actual_length<transfer->length;
+			releaseCurrentTransfer();
+			}
+		
+		/* Append the compressed image to the decompression queue: */
+		{
+		Threads::MutexCond::Lock decodeQueueLock(decodeQueueCond);
+		if(decodeQueue.size()>=maxQueueDepth)
+			{
+			/* Drop the oldest waiting image to bound latency: */
+			freeFrames.push_back(decodeQueue.front());
+			decodeQueue.pop_front();
+			++statistics.numFramesDropped;
+			}
+		decodeQueue.push_back(frame);
+		++statistics.numFramesReceived;
+		if(statistics.maxQueueDepth<decodeQueue.size())
+			statistics.maxQueueDepth=decodeQueue.size();
+		decodeQueueCond.signal();
+		}
+		
+		/* Wait for the next transfer buffer unless the previous loop already grabbed it: */
+		if(currentTransfer==0&&!getNextTransfer())
+			return 0;
+		}
+	
+	return 0;
 	}
 
 void KinectV2JpegStreamReader::initSourceFunction(j_decompress_ptr cinfo)
@@ -88,36 +228,25 @@ void KinectV2JpegStreamReader::initSourceFunction(j_decompress_ptr cinfo)
 
 boolean KinectV2JpegStreamReader::fillInputBufferFunction(j_decompress_ptr cinfo)
 	{
-	KinectV2JpegStreamReader* thisPtr=static_cast<KinectV2JpegStreamReader*>(cinfo->client_data);
-	
-	/* Get the next transfer buffer: */
-	thisPtr->getNextTransfer();
+	/* The entire compressed image is in memory; insert a fake end-of-image marker to terminate truncated images: */
+	static const JOCTET eoiMarker[2]={0xffU,JPEG_EOI};
+	cinfo->src->next_input_byte=eoiMarker;
+	cinfo->src->bytes_in_buffer=2;
 	
 	return true;
 	}
 
 void KinectV2JpegStreamReader::skipInputDataFunction(j_decompress_ptr cinfo,long count)
 	{
-	KinectV2JpegStreamReader* thisPtr=static_cast<KinectV2JpegStreamReader*>(cinfo->client_data);
-	
 	if(count<0)
 		throw std::runtime_error("KinectV2JpegStreamReader: Unable to skip backwards");
 	size_t skip=size_t(count);
 	
-	while(skip>0U)
-		{
-		/* Skip inside the current transfer: */
-		size_t skipStep=thisPtr->sourceManager.bytes_in_buffer;
-		if(skipStep>skip)
-			skipStep=skip;
-		thisPtr->sourceManager.bytes_in_buffer-=skipStep;
-		thisPtr->sourceManager.next_input_byte+=skipStep;
-		skip-=skipStep;
-		
-		/* Get the next transfer if the current transfer is finished: */
-		if(thisPtr->sourceManager.bytes_in_buffer==0U)
-			thisPtr->getNextTransfer();
-		}
+	/* Skip inside the compressed image, or to its end: */
+	if(skip>cinfo->src->bytes_in_buffer)
+		skip=cinfo->src->bytes_in_buffer;
+	cinfo->src->next_input_byte+=skip;
+	cinfo->src->bytes_in_buffer-=skip;
 	}
 
 void KinectV2JpegStreamReader::termSourceFunction(j_decompress_ptr cinfo)
@@ -125,139 +254,158 @@ void KinectV2JpegStreamReader::termSourceFunction(j_decompress_ptr cinfo)
 	/* Nothing to do */
 	}
 
-void* KinectV2JpegStreamReader::decompressionThreadMethod(void)
+bool KinectV2JpegStreamReader::decompressImage(KinectV2JpegStreamReader::Decoder& decoder,const KinectV2JpegStreamReader::CompressedFrame& frame,FrameBuffer& image)
 	{
-	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
-	// Threads::Thread::setCancelType(Threads::Thread::CANCEL_ASYNCHRONOUS);
+	jpeg_decompress_struct& d=decoder.decompressor;
 	
-	// unsigned int frameIndex=0;
-	FrameSource::Time now;
-	while(true)
+	/* Point the JPEG decompressor's input buffer to the compressed image: */
+	decoder.sourceManager.next_input_byte=frame.data;
+	decoder.sourceManager.bytes_in_buffer=frame.dataSize;
+	
+	try
 		{
-		while(true)
-			{
-			/* Wait for the transfer buffer starting a new image: */
-			getNextTransfer();
-			
-			/* Sample the real-time clock: */
-			now.set();
-			
-			/* Check the magic number and the JPEG header: */
-			const Misc::UInt32* rpPtr=reinterpret_cast<const Misc::UInt32*>(sourceManager.next_input_byte);
-			const unsigned char* jPtr=reinterpret_cast<const unsigned char*>(rpPtr+2);
-			if(rpPtr[1]==0x42424242U&&
-			   jPtr[0]==0xffU&&jPtr[1]==0xd8U)
-				break;
-			
-			/* Skip until the end of the current batch of transfers: */
-			size_t skip=currentTransfer->getTransfer().actual_length;
-			do
-				{
-				getNextTransfer();
-				skip+=currentTransfer->getTransfer().actual_length;
-				}
-			while(currentTransfer->getTransfer().actual_length==currentTransfer->getTransfer().length);
-			}
+		/* Let the decompressor read the JPEG headers and prepare for decompression: */
+		jpeg_read_header(&d,true);
+		d.dct_method=JDCT_FASTEST;
+		d.do_fancy_upsampling=false;
+		d.do_block_smoothing=false;
 		
-		/* Shave the Kinect2 image header off the first transfer buffer: */
-		// const Misc::UInt32* header=reinterpret_cast<const Misc::UInt32*>(sourceManager.next_input_byte);
-		// unsigned int frameNumber=header[0];
-		// unsigned int magic0=header[1];
-		sourceManager.bytes_in_buffer-=2*sizeof(Misc::UInt32);
-		sourceManager.next_input_byte+=2*sizeof(Misc::UInt32);
+		/* Set the decompressor's output color space and scale: */
+		d.out_color_space=forceRgb?JCS_RGB:JCS_YCbCr;
+		d.scale_num=1;
+		d.scale_denom=decodeScale;
 		
-		/* Let the decompressor read the JPEG headers and prepare for decompression: */
-		frameSize=sourceManager.bytes_in_buffer;
-		error=false;
-		jpeg_read_header(&decompressor,true);
-		decompressor.dct_method=JDCT_FASTEST;
-		decompressor.do_fancy_upsampling=false;
-		decompressor.do_block_smoothing=false;
+		jpeg_start_decompress(&d);
 		
-		/* Set the decompressor's output color space: */
-		decompressor.out_color_space=forceRgb?JCS_RGB:JCS_YCbCr;
+		/* Create a frame buffer to hold the decompressed image: */
+		image=FrameBufferPool::getDefaultPool().allocate(d.output_width,d.output_height,d.output_height*d.output_width*sizeof(FrameSource::ColorPixel));
 		
-		// DEBUGGING
-		// std::cout<<"Image's color space: "<<decompressor.jpeg_color_space<<", selected output color space: "<<decompressor.out_color_space<<std::endl;
+		/* Create row pointers to flip the image during reading: */
+		decoder.rowPointers.resize(d.output_height);
+		JSAMPROW rowPtr=reinterpret_cast<JSAMPROW>(image.getData<FrameSource::ColorPixel>()+(d.output_height-1)*d.output_width);
+		for(JDIMENSION y=0;y<d.output_height;++y,rowPtr-=d.output_width*sizeof(FrameSource::ColorPixel))
+			decoder.rowPointers[y]=rowPtr;
 		
-		jpeg_start_decompress(&decompressor);
+		/* Decompress all pixel rows in the result image: */
+		while(d.output_scanline<d.output_height)
+			jpeg_read_scanlines(&d,&decoder.rowPointers[d.output_scanline],d.output_height-d.output_scanline);
 		
-		/* Create a frame buffer to hold the decompressed image: */
-		FrameBuffer decompressedFrame(decompressor.output_width,decompressor.output_height,decompressor.output_height*decompressor.output_width*sizeof(FrameSource::ColorPixel));
+		/* Finish decompressing: */
+		jpeg_finish_decompress(&d);
+		
+		return true;
+		}
+	catch(const std::runtime_error& err)
+		{
+		/* Reset the decompressor and log an error message: */
+		jpeg_abort_decompress(&d);
+		Misc::formattedConsoleError("KinectV2JpegStreamReader: %s",err.what());
+		
+		return false;
+		}
+	}
+
+void* KinectV2JpegStreamReader::decoderThreadMethod(unsigned int decoderIndex)
+	{
+	Decoder& decoder=decoders[decoderIndex];
+	
+	while(true)
+		{
+		/* Wait for the next compressed image: */
+		CompressedFrame* frame;
+		unsigned int sequenceNumber;
+		{
+		Threads::MutexCond::Lock decodeQueueLock(decodeQueueCond);
+		while(!shutdownThreads&&decodeQueue.empty())
+			decodeQueueCond.wait(decodeQueueLock);
+		if(shutdownThreads)
+			break;
+		
+		/* Take the oldest compressed image and assign it the next position in the output order: */
+		frame=decodeQueue.front();
+		decodeQueue.pop_front();
+		sequenceNumber=nextDecodeSequenceNumber;
+		++nextDecodeSequenceNumber;
+		}
+		
+		/* Decompress the image: */
+		FrameSource::Time decodeStart;
+		FrameSource::Time arrivalTime=frame->arrivalTime;
+		FrameBuffer image;
+		bool decoded=decompressImage(decoder,*frame,image);
+		double decodeTime=double(FrameSource::Time()-decodeStart);
+		
+		/* Return the compressed image buffer: */
+		{
+		Threads::MutexCond::Lock decodeQueueLock(decodeQueueCond);
+		freeFrames.push_back(frame);
+		}
 		
 		/*************************************************************
 		This is where we would synchronize clocks to account for
 		random OS delays, subtract expected hardware latency, etc. pp.
 		*************************************************************/
 		
-		/* Time-stamp the new frame: */
-		decompressedFrame.timeStamp=double(now-camera.timeBase);
-		
-		/* Subtract approximate color image capture latency: */
-		decompressedFrame.timeStamp-=0.090;
-		
-		/* Create row pointers to flip the image during reading: */
-		if(imageHeight!=decompressedFrame.getSize(1))
+		if(decoded)
 			{
-			delete[] imageRowPointers;
-			imageHeight=decompressedFrame.getSize(1);
-			imageRowPointers=new FrameSource::ColorPixel*[imageHeight];
+			/* Time-stamp the new frame: */
+			image.timeStamp=double(arrivalTime-camera.timeBase);
+			
+			/* Subtract approximate color image capture latency: */
+			image.timeStamp-=0.090;
 			}
-		FrameSource::ColorPixel* rowPtr=decompressedFrame.getData<FrameSource::ColorPixel>()+(imageHeight-1)*decompressedFrame.getSize(0);
-		for(int y=0;y<imageHeight;++y,rowPtr-=decompressedFrame.getSize(0))
-			imageRowPointers[y]=rowPtr;
 		
-		/* Decompress all pixel rows in the result image: */
-		JDIMENSION scanline=0;
-		while(scanline<decompressor.output_height&&!error)
-			scanline+=jpeg_read_scanlines(&decompressor,reinterpret_cast<JSAMPLE**>(imageRowPointers+scanline),decompressor.output_height-scanline);
+		/* Wait until all images received before this one have been delivered: */
+		{
+		Threads::MutexCond::Lock deliveryLock(deliveryCond);
+		while(!shutdownThreads&&nextDeliverySequenceNumber!=sequenceNumber)
+			deliveryCond.wait(deliveryLock);
+		if(shutdownThreads)
+			break;
+		}
 		
-		/* Finish decompressing and release the current transfer: */
-		if(error)
-			jpeg_abort_decompress(&decompressor);
-		else
-			jpeg_finish_decompress(&decompressor);
-		transferPool->release(currentTransfer);
-		currentTransfer=0;
-		sourceManager.bytes_in_buffer=0;
-		sourceManager.next_input_byte=0;
+		/* Call the callback: */
+		if(decoded)
+			(*imageReadyCallback)(image);
+		double latency=double(FrameSource::Time()-arrivalTime);
 		
-		if(!error)
+		/* Let the thread holding the next image deliver it: */
+		{
+		Threads::MutexCond::Lock deliveryLock(deliveryCond);
+		++nextDeliverySequenceNumber;
+		deliveryCond.broadcast();
+		}
+		
+		/* Update the statistics: */
+		{
+		Threads::MutexCond::Lock decodeQueueLock(decodeQueueCond);
+		size_t numDecodes=statistics.numFramesDelivered+statistics.numDecodeErrors+1;
+		statistics.meanDecodeTime+=(decodeTime-statistics.meanDecodeTime)/double(numDecodes);
+		if(statistics.maxDecodeTime<decodeTime)
+			statistics.maxDecodeTime=decodeTime;
+		if(decoded)
 			{
-			/* Call the callback: */
-			(*imageReadyCallback)(decompressedFrame);
+			++statistics.numFramesDelivered;
+			statistics.meanLatency+=(latency-statistics.meanLatency)/double(statistics.numFramesDelivered);
+			if(statistics.maxLatency<latency)
+				statistics.maxLatency=latency;
 			}
+		else
+			++statistics.numDecodeErrors;
+		}
 		}
 	
 	return 0;
 	}
 
 KinectV2JpegStreamReader::KinectV2JpegStreamReader(CameraV2& sCamera)
-	:camera(sCamera),forceRgb(false),
+	:camera(sCamera),forceRgb(false),decodeScale(1),numDecoders(getNumDecoderThreads()),
 	 transferPool(0),currentTransfer(0),
-	 imageHeight(0),imageRowPointers(0),
+	 maxQueueDepth(0),compressedFrames(0),
+	 nextDecodeSequenceNumber(0),decoders(0),nextDeliverySequenceNumber(0),
+	 shutdownThreads(false),
 	 imageReadyCallback(0)
 	{
-	/* Initialize the JPEG error manager: */
-	jpeg_std_error(&errorManager);
-	errorManager.error_exit=errorExitFunction;
-	
-	/* Initialize the JPEG source manager: */
-	sourceManager.init_source=initSourceFunction;
-	sourceManager.fill_input_buffer=fillInputBufferFunction;
-	sourceManager.skip_input_data=skipInputDataFunction;
-	sourceManager.resync_to_restart=jpeg_resync_to_restart; // Use default function
-	sourceManager.term_source=termSourceFunction;
-	
-	/* Clear the input buffer: */
-	sourceManager.bytes_in_buffer=0;
-	sourceManager.next_input_byte=0;
-	
-	/* Initialize the JPEG decompressor: */
-	decompressor.err=&errorManager;
-	jpeg_create_decompress(&decompressor);
-	decompressor.src=&sourceManager;
-	decompressor.client_data=this;
 	}
 
 KinectV2JpegStreamReader::~KinectV2JpegStreamReader(void)
@@ -265,10 +413,6 @@ KinectV2JpegStreamReader::~KinectV2JpegStreamReader(void)
 	/* Stop streaming if necessary: */
 	if(transferPool!=0)
 		stopStreaming();
-	
-	/* Destroy the JPEG decompressor: */
-	delete[] imageRowPointers;
-	jpeg_destroy_decompress(&decompressor);
 	}
 
 void KinectV2JpegStreamReader::setForceRgb(bool newForceRgb)
@@ -276,6 +420,32 @@ void KinectV2JpegStreamReader::setForceRgb(bool newForceRgb)
 	forceRgb=newForceRgb;
 	}
 
+void KinectV2JpegStreamReader::setDecodeScale(unsigned int newDecodeScale)
+	{
+	if(newDecodeScale!=1&&newDecodeScale!=2&&newDecodeScale!=4&&newDecodeScale!=8)
+		Misc::throwStdErr("KinectV2JpegStreamReader::setDecodeScale: Invalid scale 1/%u",newDecodeScale);
+	decodeScale=newDecodeScale;
+	}
+
+void KinectV2JpegStreamReader::setNumDecoders(unsigned int newNumDecoders)
+	{
+	numDecoders=newNumDecoders!=0?newNumDecoders:getNumDecoderThreads();
+	}
+
+KinectV2JpegStreamReader::Statistics KinectV2JpegStreamReader::getStatistics(void) const
+	{
+	Threads::MutexCond::Lock decodeQueueLock(decodeQueueCond);
+	Statistics result=statistics;
+	result.queueDepth=decodeQueue.size();
+	return result;
+	}
+
+void KinectV2JpegStreamReader::resetStatistics(void)
+	{
+	Threads::MutexCond::Lock decodeQueueLock(decodeQueueCond);
+	statistics=Statistics();
+	}
+
 USB::TransferPool::UserTransferCallback*  KinectV2JpegStreamReader::startStreaming(USB::TransferPool* newTransferPool,KinectV2JpegStreamReader::ImageReadyCallback* newImageReadyCallback)
 	{
 	/* Remember the source transfer pool: */
@@ -285,8 +455,45 @@ USB::TransferPool::UserTransferCallback*  KinectV2JpegStreamReader::startStreami
 	delete imageReadyCallback;
 	imageReadyCallback=newImageReadyCallback;
 	
-	/* Start the background decompression thread: */
-	decompressionThread.start(this,&KinectV2JpegStreamReader::decompressionThreadMethod);
+	/* Create enough compressed image buffers for all waiting images, all images being decompressed, and the image being assembled: */
+	maxQueueDepth=numDecoders;
+	unsigned int numCompressedFrames=maxQueueDepth+numDecoders+1;
+	compressedFrames=new CompressedFrame[numCompressedFrames];
+	for(unsigned int i=0;i<numCompressedFrames;++i)
+		freeFrames.push_back(&compressedFrames[i]);
+	nextDecodeSequenceNumber=0;
+	nextDeliverySequenceNumber=0;
+	
+	/* Initialize the JPEG decompressors and start the decompression threads: */
+	decoders=new Decoder[numDecoders];
+	for(unsigned int i=0;i<numDecoders;++i)
+		{
+		Decoder& decoder=decoders[i];
+		
+		/* Initialize the JPEG error manager: */
+		jpeg_std_error(&decoder.errorManager);
+		decoder.errorManager.error_exit=errorExitFunction;
+		
+		/* Initialize the JPEG source manager: */
+		decoder.sourceManager.init_source=initSourceFunction;
+		decoder.sourceManager.fill_input_buffer=fillInputBufferFunction;
+		decoder.sourceManager.skip_input_data=skipInputDataFunction;
+		decoder.sourceManager.resync_to_restart=jpeg_resync_to_restart; // Use default function
+		decoder.sourceManager.term_source=termSourceFunction;
+		decoder.sourceManager.bytes_in_buffer=0;
+		decoder.sourceManager.next_input_byte=0;
+		
+		/* Initialize the JPEG decompressor: */
+		decoder.decompressor.err=&decoder.errorManager;
+		jpeg_create_decompress(&decoder.decompressor);
+		decoder.decompressor.src=&decoder.sourceManager;
+		decoder.decompressor.client_data=this;
+		
+		decoder.thread.start(this,&KinectV2JpegStreamReader::decoderThreadMethod,i);
+		}
+	
+	/* Start the background image assembly thread: */
+	assemblyThread.start(this,&KinectV2JpegStreamReader::assemblyThreadMethod);
 	
 	/* Create and return a transfer callback: */
 	return Misc::createFunctionCall(this,&KinectV2JpegStreamReader::postTransfer,newTransferPool);
@@ -294,15 +501,44 @@ USB::TransferPool::UserTransferCallback*  KinectV2JpegStreamReader::startStreami
 
 void KinectV2JpegStreamReader::stopStreaming(void)
 	{
-	/* Shut down the decompressor thread: */
-	decompressionThread.cancel();
-	decompressionThread.join();
+	/* Shut down the assembly and decompression threads: */
+	shutdownThreads=true;
+	{
+	Threads::MutexCond::Lock inQueueLock(inQueueCond);
+	inQueueCond.signal();
+	}
+	{
+	Threads::MutexCond::Lock decodeQueueLock(decodeQueueCond);
+	decodeQueueCond.broadcast();
+	}
+	{
+	Threads::MutexCond::Lock deliveryLock(deliveryCond);
+	deliveryCond.broadcast();
+	}
+	assemblyThread.join();
+	for(unsigned int i=0;i<numDecoders;++i)
+		decoders[i].thread.join();
+	shutdownThreads=false;
+	
+	/* Destroy the JPEG decompressors: */
+	for(unsigned int i=0;i<numDecoders;++i)
+		jpeg_destroy_decompress(&decoders[i].decompressor);
+	delete[] decoders;
+	decoders=0;
 	
 	/* Release all remaining queued transfers: */
+	if(currentTransfer!=0)
+		releaseCurrentTransfer();
 	while(!inQueue.empty())
 		transferPool->release(inQueue.pop_front());
 	transferPool=0;
 	
+	/* Delete all compressed image buffers: */
+	decodeQueue.clear();
+	freeFrames.clear();
+	delete[] compressedFrames;
+	compressedFrames=0;
+	
 	/* Delete the callback function: */
 	delete imageReadyCallback;
 	imageReadyCallback=0;
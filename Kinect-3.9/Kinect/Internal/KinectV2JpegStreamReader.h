@@ -1,7 +1,7 @@
 /***********************************************************************
 KinectV2JpegStreamReader - Class to read JPEG-compressed RGB images
 asynchronously from a stream of USB transfer buffers.
-Copyright (c) 2014-2018 Oliver Kreylos
+Copyright (c) 2014-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -27,6 +27,8 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <stddef.h>
 #include <stdio.h>
 #include <jpeglib.h>
+#include <deque>
+#include <vector>
 #include <Threads/Thread.h>
 #include <Threads/MutexCond.h>
 #include <USB/TransferPool.h>
@@ -50,32 +52,100 @@ class KinectV2JpegStreamReader
 	public:
 	typedef Misc::FunctionCall<const FrameBuffer&> ImageReadyCallback; // Type for functions called when a new color image has been decompressed
 	
-	/* Elements: */
+	struct Statistics // Structure reporting the state of the decompression pipeline
+		{
+		/* Elements: */
+		public:
+		size_t numFramesReceived; // Number of complete compressed images received from the camera
+		size_t numFramesDelivered; // Number of decompressed images passed to the image ready callback
+		size_t numFramesDropped; // Number of compressed images dropped because all decompression threads were busy and the decompression queue was full
+		size_t numDecodeErrors; // Number of compressed images that could not be decompressed
+		unsigned int queueDepth; // Number of compressed images currently waiting for a decompression thread
+		unsigned int maxQueueDepth; // Largest number of compressed images that waited for a decompression thread at the same time
+		double meanDecodeTime; // Mean time to decompress an image in seconds
+		double maxDecodeTime; // Maximum time to decompress an image in seconds
+		double meanLatency; // Mean time from arrival of an image's first transfer buffer to delivery of the decompressed image in seconds
+		double maxLatency; // Maximum time from arrival of an image's first transfer buffer to delivery of the decompressed image in seconds
+		
+		/* Constructors and destructors: */
+		Statistics(void)
+			:numFramesReceived(0),numFramesDelivered(0),numFramesDropped(0),numDecodeErrors(0),
+			 queueDepth(0),maxQueueDepth(0),
+			 meanDecodeTime(0.0),maxDecodeTime(0.0),
+			 meanLatency(0.0),maxLatency(0.0)
+			{
+			}
+		};
+	
 	private:
+	struct CompressedFrame // Structure holding a compressed image assembled from a sequence of transfer buffers
+		{
+		/* Elements: */
+		public:
+		FrameSource::Time arrivalTime; // Time at which the image's first transfer buffer was received
+		JOCTET* data; // Buffer holding the compressed image
+		size_t dataSize; // Size of the compressed image in bytes
+		size_t allocSize; // Allocated size of the data buffer in bytes
+		
+		/* Constructors and destructors: */
+		CompressedFrame(void)
+			:data(0),dataSize(0),allocSize(0)
+			{
+			}
+		~CompressedFrame(void)
+			{
+			delete[] data;
+			}
+		
+		/* Methods: */
+		void append(const void* newData,size_t newDataSize); // Appends the given data to the compressed image
+		};
+	
+	struct Decoder // Structure holding the state of a decompression thread
+		{
+		/* Elements: */
+		public:
+		jpeg_error_mgr errorManager; // Manager to handle JPEG decompression errors
+		jpeg_source_mgr sourceManager; // Manager to feed a compressed image from memory to the JPEG decompressor
+		jpeg_decompress_struct decompressor; // The JPEG decompressor
+		std::vector<JSAMPROW> rowPointers; // Array of pointers to image rows to flip image during decompression
+		Threads::Thread thread; // The decompression thread
+		};
+	
+	/* Elements: */
 	CameraV2& camera; // Kinect v2 device with which this JPEG stream reader is associated
 	bool forceRgb; // Flag to force output in RGB color space
-	Threads::MutexCond inQueueCond; // Condition variable to notify the decompression thread of new data
+	unsigned int decodeScale; // Denominator of the scale factor at which images are decompressed; one of 1, 2, 4, or 8
+	unsigned int numDecoders; // Number of decompression threads
+	Threads::MutexCond inQueueCond; // Condition variable to notify the assembly thread of new data
 	USB::TransferPool::TransferQueue inQueue; // Queue of incoming USB transfer buffers
-	jpeg_error_mgr errorManager; // Manager to handle JPEG decompression errors
-	jpeg_source_mgr sourceManager; // Manager to handle streaming compressed data to the JPEG decompressor
 	USB::TransferPool* transferPool; // The transfer pool from which transfer buffers are received
-	USB::TransferPool::Transfer* currentTransfer; // Transfer buffer currently read by the JPEG decompressor
-	jpeg_decompress_struct decompressor; // The JPEG decompressor
-	Threads::Thread decompressionThread; // A background thread running the JPEG decompressor
-	int imageHeight; // Height of last decompressed image
-	FrameSource::ColorPixel** imageRowPointers; // Array of pointers to image rows to flip image during decompression
-	size_t frameSize; // Total compressed image size for the current image
-	bool error; // Flag to remember errors while decompressing the current image
+	USB::TransferPool::Transfer* currentTransfer; // Transfer buffer currently read by the assembly thread
+	Threads::Thread assemblyThread; // A background thread assembling compressed images from transfer buffers
+	unsigned int maxQueueDepth; // Maximum number of compressed images waiting for a decompression thread before the oldest waiting image is dropped
+	CompressedFrame* compressedFrames; // Array of compressed image buffers
+	mutable Threads::MutexCond decodeQueueCond; // Condition variable to notify decompression threads of new compressed images; also protects statistics
+	std::vector<CompressedFrame*> freeFrames; // List of compressed image buffers not currently in use
+	std::deque<CompressedFrame*> decodeQueue; // Queue of compressed images waiting for a decompression thread
+	unsigned int nextDecodeSequenceNumber; // Sequence number to be assigned to the next compressed image taken from the decompression queue
+	Decoder* decoders; // Array of decompression thread states
+	Threads::MutexCond deliveryCond; // Condition variable to deliver decompressed images in the order in which they were received
+	unsigned int nextDeliverySequenceNumber; // Sequence number of the next decompressed image to be delivered
+	volatile bool shutdownThreads; // Flag to shut down the assembly and decompression threads
+	Statistics statistics; // Current state of the decompression pipeline
 	ImageReadyCallback* imageReadyCallback; // Function called whenever a new image has been decompressed
 	
 	/* Private methods: */
-	void getNextTransfer(void); // Grabs the next transfer buffer from the input queue and sets up the JPEG decompressor's input buffer
-	static void errorExitFunction(j_common_ptr cinfo); // JPEG error handler
+	bool getNextTransfer(void); // Grabs the next non-empty transfer buffer from the input queue; returns false if the assembly thread is shutting down
+	void releaseCurrentTransfer(void); // Returns the current transfer buffer to the transfer pool
+	bool isImageStart(void) const; // Returns true if the current transfer buffer starts a new compressed image
+	void* assemblyThreadMethod(void); // Method for the image assembly thread
 	static void initSourceFunction(j_decompress_ptr cinfo);
 	static boolean fillInputBufferFunction(j_decompress_ptr cinfo);
 	static void skipInputDataFunction(j_decompress_ptr cinfo,long count);
 	static void termSourceFunction(j_decompress_ptr cinfo);
-	void* decompressionThreadMethod(void); // Method for the JPEG decompression thread
+	bool decompressImage(Decoder& decoder,const CompressedFrame& frame,FrameBuffer& image); // Decompresses the given compressed image into the given frame buffer using the given decompressor; returns false if the image could not be decompressed
+	void* decoderThreadMethod(unsigned int decoderIndex); // Method for the JPEG decompression threads
 	
 	/* Constructors and destructors: */
 	public:
@@ -84,6 +154,18 @@ class KinectV2JpegStreamReader
 	
 	/* Methods: */
 	void setForceRgb(bool newForceRgb); // Sets the RGB color space flag
+	unsigned int getDecodeScale(void) const // Returns the denominator of the scale factor at which images are decompressed
+		{
+		return decodeScale;
+		}
+	void setDecodeScale(unsigned int newDecodeScale); // Decompresses images at 1/newDecodeScale of their full size; must be 1, 2, 4, or 8; must not be called while streaming
+	unsigned int getNumDecoders(void) const // Returns the number of decompression threads
+		{
+		return numDecoders;
+		}
+	void setNumDecoders(unsigned int newNumDecoders); // Sets the number of decompression threads; uses up to three of the host's CPUs if zero; must not be called while streaming
+	Statistics getStatistics(void) const; // Returns the current state of the decompression pipeline
+	void resetStatistics(void); // Resets the decompression pipeline's counters and timers
 	void postTransfer(USB::TransferPool::Transfer* newTransfer,USB::TransferPool* newTransferPool) // Appends the given transfer buffer to the input queue
 		{
 		#if 0
@@ -102,11 +184,10 @@ class KinectV2JpegStreamReader
 		if(empty)
 			inQueueCond.signal();
 		}
-	USB::TransferPool::UserTransferCallback* startStreaming(USB::TransferPool* newTransferPool,ImageReadyCallback* newImageReadyCallback); // Starts the decompression thread and registers the given callback; returns a callback set up to receive USB transfer buffers
+	USB::TransferPool::UserTransferCallback* startStreaming(USB::TransferPool* newTransferPool,ImageReadyCallback* newImageReadyCallback); // Starts the assembly and decompression threads and registers the given callback; returns a callback set up to receive USB transfer buffers
 	void stopStreaming(void); // Stops background decompression
 	};
 
 }
 
 #endif
-
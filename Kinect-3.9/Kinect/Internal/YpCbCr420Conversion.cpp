@@ -0,0 +1,247 @@
+/***********************************************************************
+YpCbCr420Conversion - Functions to convert color frames between RGB or
+Y'CbCr 4:4:4 pixel format and planar Y'CbCr 4:2:0 pixel format.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Kinect/Internal/YpCbCr420Conversion.h>
+
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#include <Video/Colorspaces.h>
+
+namespace Kinect {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+inline void convertRgbBlock(const FrameSource::ColorPixel* row0,const FrameSource::ColorPixel* row1,Misc::UInt8* yp0,Misc::UInt8* yp1,Misc::UInt8* cb,Misc::UInt8* cr)
+	{
+	/* Convert the 2x2 pixel block to Y'CbCr: */
+	unsigned char ypcbcr[4][3];
+	Video::rgbToYpcbcr(row0[0].components,ypcbcr[0]);
+	Video::rgbToYpcbcr(row0[1].components,ypcbcr[1]);
+	Video::rgbToYpcbcr(row1[0].components,ypcbcr[2]);
+	Video::rgbToYpcbcr(row1[1].components,ypcbcr[3]);
+	
+	/* Subsample and store the Y'CbCr components: */
+	yp0[0]=ypcbcr[0][0];
+	yp0[1]=ypcbcr[1][0];
+	yp1[0]=ypcbcr[2][0];
+	yp1[1]=ypcbcr[3][0];
+	*cb=Misc::UInt8((int(ypcbcr[0][1])+int(ypcbcr[1][1])+int(ypcbcr[2][1])+int(ypcbcr[3][1])+2)>>2);
+	*cr=Misc::UInt8((int(ypcbcr[0][2])+int(ypcbcr[1][2])+int(ypcbcr[2][2])+int(ypcbcr[3][2])+2)>>2);
+	}
+
+#ifdef __SSE2__
+
+inline void loadRgb(const FrameSource::ColorPixel* pixels,__m128i& r,__m128i& g,__m128i& b) // Loads eight RGB pixels into three vectors of 16-bit components
+	{
+	const Misc::UInt8* p=pixels[0].components;
+	#ifdef __SSSE3__
+	
+	/* Shuffle the components out of two overlapping 16-byte loads covering the 24 bytes of the eight pixels: */
+	__m128i lo=_mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+	__m128i hi=_mm_loadu_si128(reinterpret_cast<const __m128i*>(p+8));
+	r=_mm_or_si128(_mm_shuffle_epi8(lo,_mm_setr_epi8(0,-1,3,-1,6,-1,9,-1,12,-1,15,-1,-1,-1,-1,-1)),_mm_shuffle_epi8(hi,_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,10,-1,13,-1)));
+	g=_mm_or_si128(_mm_shuffle_epi8(lo,_mm_setr_epi8(1,-1,4,-1,7,-1,10,-1,13,-1,-1,-1,-1,-1,-1,-1)),_mm_shuffle_epi8(hi,_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,8,-1,11,-1,14,-1)));
+	b=_mm_or_si128(_mm_shuffle_epi8(lo,_mm_setr_epi8(2,-1,5,-1,8,-1,11,-1,14,-1,-1,-1,-1,-1,-1,-1)),_mm_shuffle_epi8(hi,_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,9,-1,12,-1,15,-1)));
+	
+	#else
+	
+	/* Gather the components one at a time: */
+	r=_mm_setr_epi16(p[0],p[3],p[6],p[9],p[12],p[15],p[18],p[21]);
+	g=_mm_setr_epi16(p[1],p[4],p[7],p[10],p[13],p[16],p[19],p[22]);
+	b=_mm_setr_epi16(p[2],p[5],p[8],p[11],p[14],p[17],p[20],p[23]);
+	
+	#endif
+	}
+
+inline __m128i convertComponent(__m128i rg0,__m128i gb0,__m128i rg1,__m128i gb1,__m128i rgWeights,__m128i gbWeights,__m128i offset) // Calculates one Y'CbCr component of eight pixels in 16-bit fixed-point, with results clamped to [0, 255]
+	{
+	/* Evaluate the conversion formula in 32-bit for the low and high four pixels: */
+	__m128i v0=_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg0,rgWeights),_mm_madd_epi16(gb0,gbWeights)),offset);
+	__m128i v1=_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg1,rgWeights),_mm_madd_epi16(gb1,gbWeights)),offset);
+	
+	/* Round to integer and clamp to the valid component range: */
+	__m128i v=_mm_packs_epi32(_mm_srai_epi32(v0,16),_mm_srai_epi32(v1,16));
+	return _mm_min_epi16(_mm_max_epi16(v,_mm_setzero_si128()),_mm_set1_epi16(255));
+	}
+
+inline void convertRgbRow(__m128i r,__m128i g,__m128i b,__m128i& yp,__m128i& cb,__m128i& cr) // Converts eight RGB pixels to Y'CbCr
+	{
+	/* Interleave the components into (r, g) and (g, b) pairs for 16-bit multiply-adds: */
+	__m128i rg0=_mm_unpacklo_epi16(r,g);
+	__m128i rg1=_mm_unpackhi_epi16(r,g);
+	__m128i gb0=_mm_unpacklo_epi16(g,b);
+	__m128i gb1=_mm_unpackhi_epi16(g,b);
+	
+	/* Split the green weight of Y' (33039) between the two multiply-adds to keep all weights in 16-bit range: */
+	yp=convertComponent(rg0,gb0,rg1,gb1,_mm_setr_epi16(16829,32767,16829,32767,16829,32767,16829,32767),_mm_setr_epi16(272,6416,272,6416,272,6416,272,6416),_mm_set1_epi32(1048576+32768));
+	cb=convertComponent(rg0,gb0,rg1,gb1,_mm_setr_epi16(-9714,-19071,-9714,-19071,-9714,-19071,-9714,-19071),_mm_setr_epi16(0,28784,0,28784,0,28784,0,28784),_mm_set1_epi32(8388608+32768));
+	cr=convertComponent(rg0,gb0,rg1,gb1,_mm_setr_epi16(28784,-24103,28784,-24103,28784,-24103,28784,-24103),_mm_setr_epi16(0,-4681,0,-4681,0,-4681,0,-4681),_mm_set1_epi32(8388608+32768));
+	}
+
+inline __m128i subsampleChroma(__m128i c0,__m128i c1) // Averages 2x2 blocks of two rows of eight chroma values into four 32-bit values
+	{
+	__m128i sum=_mm_madd_epi16(_mm_add_epi16(c0,c1),_mm_set1_epi16(1));
+	return _mm_srai_epi32(_mm_add_epi32(sum,_mm_set1_epi32(2)),2);
+	}
+
+inline void storeChroma(__m128i c,Misc::UInt8* dest) // Stores four 32-bit chroma values as bytes
+	{
+	__m128i c16=_mm_packs_epi32(c,c);
+	int bytes=_mm_cvtsi128_si32(_mm_packus_epi16(c16,c16));
+	memcpy(dest,&bytes,4);
+	}
+
+#endif
+
+}
+
+void convertRgbToYpCbCr420(const FrameSource::ColorPixel* frame,ptrdiff_t frameStride,unsigned int width,unsigned int height,Misc::UInt8* yp,ptrdiff_t ypStride,Misc::UInt8* cb,ptrdiff_t cbStride,Misc::UInt8* cr,ptrdiff_t crStride)
+	{
+	/* Process pixels in 2x2 blocks: */
+	for(unsigned int y=0;y<height;y+=2,frame+=frameStride*2,yp+=ypStride*2,cb+=cbStride,cr+=crStride)
+		{
+		const FrameSource::ColorPixel* row0=frame;
+		const FrameSource::ColorPixel* row1=frame+frameStride;
+		unsigned int x=0;
+		
+		#ifdef __SSE2__
+		
+		/* Convert blocks of 8x2 pixels: */
+		for(;x+8<=width;x+=8)
+			{
+			__m128i r,g,b;
+			__m128i yp0,cb0,cr0,yp1,cb1,cr1;
+			loadRgb(row0+x,r,g,b);
+			convertRgbRow(r,g,b,yp0,cb0,cr0);
+			loadRgb(row1+x,r,g,b);
+			convertRgbRow(r,g,b,yp1,cb1,cr1);
+			
+			/* Store the luma components: */
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(yp+x),_mm_packus_epi16(yp0,yp0));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(yp+ypStride+x),_mm_packus_epi16(yp1,yp1));
+			
+			/* Subsample and store the chroma components: */
+			storeChroma(subsampleChroma(cb0,cb1),cb+x/2);
+			storeChroma(subsampleChroma(cr0,cr1),cr+x/2);
+			}
+		
+		#endif
+		
+		/* Convert the remaining blocks: */
+		for(;x<width;x+=2)
+			convertRgbBlock(row0+x,row1+x,yp+x,yp+ypStride+x,cb+x/2,cr+x/2);
+		}
+	}
+
+void convertRgbToYpCbCr420Scalar(const FrameSource::ColorPixel* frame,ptrdiff_t frameStride,unsigned int width,unsigned int height,Misc::UInt8* yp,ptrdiff_t ypStride,Misc::UInt8* cb,ptrdiff_t cbStride,Misc::UInt8* cr,ptrdiff_t crStride)
+	{
+	/* Process pixels in 2x2 blocks: */
+	for(unsigned int y=0;y<height;y+=2,frame+=frameStride*2,yp+=ypStride*2,cb+=cbStride,cr+=crStride)
+		for(unsigned int x=0;x<width;x+=2)
+			convertRgbBlock(frame+x,frame+frameStride+x,yp+x,yp+ypStride+x,cb+x/2,cr+x/2);
+	}
+
+void convertYpCbCr444ToYpCbCr420(const FrameSource::ColorPixel* frame,ptrdiff_t frameStride,unsigned int width,unsigned int height,Misc::UInt8* yp,ptrdiff_t ypStride,Misc::UInt8* cb,ptrdiff_t cbStride,Misc::UInt8* cr,ptrdiff_t crStride)
+	{
+	/* Process pixels in 2x2 blocks: */
+	for(unsigned int y=0;y<height;y+=2,frame+=frameStride*2,yp+=ypStride*2,cb+=cbStride,cr+=crStride)
+		{
+		const FrameSource::ColorPixel* row0=frame;
+		const FrameSource::ColorPixel* row1=frame+frameStride;
+		for(unsigned int x=0;x<width;x+=2)
+			{
+			/* Subsample and store the Y'CbCr components: */
+			yp[x]=row0[x][0];
+			yp[x+1]=row0[x+1][0];
+			yp[ypStride+x]=row1[x][0];
+			yp[ypStride+x+1]=row1[x+1][0];
+			cb[x/2]=Misc::UInt8((int(row0[x][1])+int(row0[x+1][1])+int(row1[x][1])+int(row1[x+1][1])+2)>>2);
+			cr[x/2]=Misc::UInt8((int(row0[x][2])+int(row0[x+1][2])+int(row1[x][2])+int(row1[x+1][2])+2)>>2);
+			}
+		}
+	}
+
+void convertYpCbCr420ToRgb(const Misc::UInt8* yp,ptrdiff_t ypStride,const Misc::UInt8* cb,ptrdiff_t cbStride,const Misc::UInt8* cr,ptrdiff_t crStride,unsigned int width,unsigned int height,FrameSource::ColorPixel* frame,ptrdiff_t frameStride)
+	{
+	/* Process pixels in 2x2 blocks: */
+	for(unsigned int y=0;y<height;y+=2,yp+=ypStride*2,cb+=cbStride,cr+=crStride,frame+=frameStride*2)
+		{
+		FrameSource::ColorPixel* row0=frame;
+		FrameSource::ColorPixel* row1=frame+frameStride;
+		for(unsigned int x=0;x<width;x+=2)
+			{
+			/* Convert the four pixels in the 2x2 block from Y'CbCr to RGB: */
+			unsigned char ypcbcr[3];
+			ypcbcr[0]=yp[x];
+			ypcbcr[1]=cb[x/2];
+			ypcbcr[2]=cr[x/2];
+			Video::ypcbcrToRgb(ypcbcr,row0[x].components);
+			
+			ypcbcr[0]=yp[x+1];
+			Video::ypcbcrToRgb(ypcbcr,row0[x+1].components);
+			
+			ypcbcr[0]=yp[ypStride+x];
+			Video::ypcbcrToRgb(ypcbcr,row1[x].components);
+			
+			ypcbcr[0]=yp[ypStride+x+1];
+			Video::ypcbcrToRgb(ypcbcr,row1[x+1].components);
+			}
+		}
+	}
+
+void convertYpCbCr420ToYpCbCr444(const Misc::UInt8* yp,ptrdiff_t ypStride,const Misc::UInt8* cb,ptrdiff_t cbStride,const Misc::UInt8* cr,ptrdiff_t crStride,unsigned int width,unsigned int height,FrameSource::ColorPixel* frame,ptrdiff_t frameStride)
+	{
+	/* Process pixels in 2x2 blocks: */
+	for(unsigned int y=0;y<height;y+=2,yp+=ypStride*2,cb+=cbStride,cr+=crStride,frame+=frameStride*2)
+		{
+		FrameSource::ColorPixel* row0=frame;
+		FrameSource::ColorPixel* row1=frame+frameStride;
+		for(unsigned int x=0;x<width;x+=2)
+			{
+			/* Convert the four pixels in the 2x2 block from 4:2:0 layout to 4:4:4 layout: */
+			row0[x][0]=yp[x];
+			row0[x][1]=cb[x/2];
+			row0[x][2]=cr[x/2];
+			row0[x+1][0]=yp[x+1];
+			row0[x+1][1]=cb[x/2];
+			row0[x+1][2]=cr[x/2];
+			row1[x][0]=yp[ypStride+x];
+			row1[x][1]=cb[x/2];
+			row1[x][2]=cr[x/2];
+			row1[x+1][0]=yp[ypStride+x+1];
+			row1[x+1][1]=cb[x/2];
+			row1[x+1][2]=cr[x/2];
+			}
+		}
+	}
+
+}
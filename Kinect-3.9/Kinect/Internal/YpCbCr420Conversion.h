@@ -0,0 +1,49 @@
+/***********************************************************************
+YpCbCr420Conversion - Functions to convert color frames between RGB or
+Y'CbCr 4:4:4 pixel format and planar Y'CbCr 4:2:0 pixel format.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef KINECT_INTERNAL_YPCBCR420CONVERSION_INCLUDED
+#define KINECT_INTERNAL_YPCBCR420CONVERSION_INCLUDED
+
+#include <stddef.h>
+#include <Misc/SizedTypes.h>
+#include <Kinect/FrameSource.h>
+
+namespace Kinect {
+
+/***********************************************************************
+All functions convert a region of the given width and height, both of
+which must be even. Color frame rows are addressed by a pointer to the
+first converted pixel and a stride in pixels, which is negative to flip
+Kinect's bottom-up color frames into top-down Y'CbCr 4:2:0 planes.
+Conversion formulas match those in Video/Colorspaces.h exactly.
+***********************************************************************/
+
+void convertRgbToYpCbCr420(const FrameSource::ColorPixel* frame,ptrdiff_t frameStride,unsigned int width,unsigned int height,Misc::UInt8* yp,ptrdiff_t ypStride,Misc::UInt8* cb,ptrdiff_t cbStride,Misc::UInt8* cr,ptrdiff_t crStride); // Converts an RGB color frame region to Y'CbCr 4:2:0
+void convertRgbToYpCbCr420Scalar(const FrameSource::ColorPixel* frame,ptrdiff_t frameStride,unsigned int width,unsigned int height,Misc::UInt8* yp,ptrdiff_t ypStride,Misc::UInt8* cb,ptrdiff_t cbStride,Misc::UInt8* cr,ptrdiff_t crStride); // Ditto, without using vector instructions
+void convertYpCbCr444ToYpCbCr420(const FrameSource::ColorPixel* frame,ptrdiff_t frameStride,unsigned int width,unsigned int height,Misc::UInt8* yp,ptrdiff_t ypStride,Misc::UInt8* cb,ptrdiff_t cbStride,Misc::UInt8* cr,ptrdiff_t crStride); // Subsamples a Y'CbCr 4:4:4 color frame region to Y'CbCr 4:2:0
+void convertYpCbCr420ToRgb(const Misc::UInt8* yp,ptrdiff_t ypStride,const Misc::UInt8* cb,ptrdiff_t cbStride,const Misc::UInt8* cr,ptrdiff_t crStride,unsigned int width,unsigned int height,FrameSource::ColorPixel* frame,ptrdiff_t frameStride); // Converts a Y'CbCr 4:2:0 region to an RGB color frame region
+void convertYpCbCr420ToYpCbCr444(const Misc::UInt8* yp,ptrdiff_t ypStride,const Misc::UInt8* cb,ptrdiff_t cbStride,const Misc::UInt8* cr,ptrdiff_t crStride,unsigned int width,unsigned int height,FrameSource::ColorPixel* frame,ptrdiff_t frameStride); // Upsamples a Y'CbCr 4:2:0 region to a Y'CbCr 4:4:4 color frame region
+
+}
+
+#endif
@@ -35,6 +35,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Video/TheoraPacket.h>
 #endif
 #include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameBufferPool.h>
 #include <Kinect/FrameSource.h>
 
 namespace Kinect {
@@ -93,7 +94,7 @@ LossyDepthFrameReader::~LossyDepthFrameReader(void)
 FrameBuffer LossyDepthFrameReader::readNextFrame(void)
 	{
 	/* Create the result frame: */
-	FrameBuffer result(size[0],size[1],size[1]*size[0]*sizeof(FrameSource::DepthPixel));
+	FrameBuffer result=FrameBufferPool::getDefaultPool().allocate(size[0],size[1],size[1]*size[0]*sizeof(FrameSource::DepthPixel));
 	
 	/* Return a dummy frame if the file is over: */
 	if(source.eof())
@@ -1,7 +1,7 @@
 /***********************************************************************
 MultiplexedFrameSource - Class to stream several pairs of color and
 depth frames from a single source file or pipe.
-Copyright (c) 2010-2018 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -35,6 +35,32 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 namespace Kinect {
 
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+const size_t maxDecodeQueueSize=2; // Maximum number of compressed frames waiting for a decompression thread before the demultiplexer stops receiving from the server
+const size_t maxCompressedBytesPerPixel=8; // Upper limit for the size of a compressed frame received from the server in bytes per pixel, a generous multiple of the raw color and depth pixel sizes
+
+FrameReader* createDepthFrameReader(IO::File& source,bool depthIsLossy) // Creates a lossless or lossy depth frame reader for the given source
+	{
+	if(depthIsLossy)
+		{
+		#if VIDEO_CONFIG_HAVE_THEORA
+		return new LossyDepthFrameReader(source);
+		#else
+		Misc::throwStdErr("Kinect::MultiplexedFrameSource::Stream::Stream: Lossy depth compression not supported due to lack of Theora library");
+		return 0;
+		#endif
+		}
+	else
+		return new DepthFrameReader(source);
+	}
+
+}
+
 /***********************************************
 Methods of class MultiplexedFrameSource::Stream:
 ***********************************************/
@@ -99,17 +125,27 @@ MultiplexedFrameSource::Stream::Stream(MultiplexedFrameSource* sOwner,unsigned i
 	ips.depthLensDistortion.setProjection(ips.depthProjection);
 	
 	/* Create the frame readers: */
-	owner->colorFrameReaders[index]=new ColorFrameReader(source);
-	if(depthIsLossy)
+	if(owner->decoders!=0)
 		{
-		#if VIDEO_CONFIG_HAVE_THEORA
-		owner->depthFrameReaders[index]=new LossyDepthFrameReader(source);
-		#else
-		Misc::throwStdErr("Kinect::MultiplexedFrameSource::Stream::Stream: Lossy depth compression not supported due to lack of Theora library");
-		#endif
+		/* Read the color and depth compression headers, which are preceded by their sizes: */
+		CompressedFrame colorHeaders(0,source.read<Misc::UInt32>());
+		source.readRaw(colorHeaders.data,colorHeaders.dataSize);
+		CompressedFrame depthHeaders(0,source.read<Misc::UInt32>());
+		source.readRaw(depthHeaders.data,depthHeaders.dataSize);
+		
+		/* Create frame readers that read from the decompression threads' files: */
+		Decoder* decoders=owner->decoders+index*2;
+		decoders[0].file.setFrame(&colorHeaders);
+		owner->colorFrameReaders[index]=new ColorFrameReader(decoders[0].file);
+		decoders[1].file.setFrame(&depthHeaders);
+		owner->depthFrameReaders[index]=createDepthFrameReader(decoders[1].file,depthIsLossy);
 		}
 	else
-		owner->depthFrameReaders[index]=new DepthFrameReader(source);
+		{
+		/* Create frame readers that read directly from the source: */
+		owner->colorFrameReaders[index]=new ColorFrameReader(source);
+		owner->depthFrameReaders[index]=createDepthFrameReader(source,depthIsLossy);
+		}
 	
 	/* Set the color space to Y'CbCr: */
 	colorSpace=YPCBCR;
@@ -205,6 +241,36 @@ void MultiplexedFrameSource::Stream::stopStreaming(void)
 	depthStreamingCallback=0;
 	}
 
+/****************************************************
+Methods of class MultiplexedFrameSource::DecoderFile:
+****************************************************/
+
+MultiplexedFrameSource::DecoderFile::DecoderFile(void)
+	{
+	/* Read frames directly from their compressed data buffers: */
+	canReadThrough=false;
+	}
+
+MultiplexedFrameSource::DecoderFile::~DecoderFile(void)
+	{
+	/* Release the current frame's buffer so that the base class does not delete it: */
+	setReadBuffer(0,0,false);
+	}
+
+size_t MultiplexedFrameSource::DecoderFile::resizeReadBuffer(size_t newReadBufferSize)
+	{
+	/* Ignore it and return the current frame's size: */
+	return getReadBufferDataSize();
+	}
+
+void MultiplexedFrameSource::DecoderFile::setFrame(MultiplexedFrameSource::CompressedFrame* newFrame)
+	{
+	/* Use the frame's data buffer as the read buffer; the file will signal end-of-file once the frame has been read completely: */
+	setReadBuffer(newFrame->dataSize,newFrame->data,false);
+	flushReadBuffer();
+	appendReadBufferData(newFrame->dataSize);
+	}
+
 /***************************************
 Methods of class MultiplexedFrameSource:
 ***************************************/
@@ -286,6 +352,247 @@ void* MultiplexedFrameSource::receivingThreadMethod(void)
 	return 0;
 	}
 
+void* MultiplexedFrameSource::bufferingThreadMethod(void)
+	{
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	/* Initialize the demultiplexer state: */
+	unsigned int currentMetaFrameIndex=~0x0U; // Index of the meta frame currently being received from the server
+	
+	try
+		{
+		while(true)
+			{
+			/* Receive the next frame's identifier and compressed size: */
+			unsigned int metaFrameIndex=pipe->read<Misc::UInt32>();
+			unsigned int frameId=pipe->read<Misc::UInt32>();
+			size_t frameSize=pipe->read<Misc::UInt32>();
+			if(frameId>=numStreams*2)
+				Misc::throwStdErr("Kinect::MultiplexedFrameSource: Invalid frame identifier %u",frameId);
+			
+			/* Reject compressed frames that are implausibly large for their component stream's frame size: */
+			FrameReader* frameReader=(frameId&0x1U)?depthFrameReaders[frameId>>1]:colorFrameReaders[frameId>>1];
+			size_t maxFrameSize=size_t(frameReader->getSize(0))*size_t(frameReader->getSize(1))*maxCompressedBytesPerPixel;
+			if(frameSize>maxFrameSize)
+				Misc::throwStdErr("Kinect::MultiplexedFrameSource: Compressed frame size %u exceeds limit of %u",(unsigned int)frameSize,(unsigned int)maxFrameSize);
+			
+			/* Receive the compressed frame: */
+			CompressedFrame* frame=new CompressedFrame(metaFrameIndex,frameSize);
+			pipe->readRaw(frame->data,frame->dataSize);
+			frame->receiveTime.set();
+			
+			/* Check for the beginning of a new meta frame: */
+			if(currentMetaFrameIndex!=metaFrameIndex)
+				{
+				Threads::MutexCond::Lock metaFrameLock(metaFrameCond);
+				
+				/* Start assembling the next meta frame: */
+				MetaFrame* metaFrame;
+				if(freeMetaFrames.empty())
+					metaFrame=new MetaFrame(numStreams*2);
+				else
+					{
+					metaFrame=freeMetaFrames.back();
+					freeMetaFrames.pop_back();
+					}
+				metaFrame->index=metaFrameIndex;
+				metaFrame->numMissingFrames=numStreams*2;
+				pendingMetaFrames.push_back(metaFrame);
+				
+				currentMetaFrameIndex=metaFrameIndex;
+				}
+			
+			/* Hand the compressed frame to its component stream's decompression thread: */
+			Decoder& decoder=decoders[frameId];
+			Threads::MutexCond::Lock queueLock(decoder.queueCond);
+			
+			/* Stop receiving while the decompression thread is falling behind, to let the server's pipe throttle the stream: */
+			while(decoder.queue.size()>=maxDecodeQueueSize)
+				decoder.queueCond.wait(queueLock);
+			
+			decoder.queue.push_back(frame);
+			if(decoder.maxQueueDepth<decoder.queue.size())
+				decoder.maxQueueDepth=decoder.queue.size();
+			decoder.queueCond.broadcast();
+			}
+		}
+	catch(const std::runtime_error& err)
+		{
+		/* Log an error message: */
+		Misc::formattedUserError("Kinect::MultiplexedFrameSource: Terminating streaming thread due to exception %s",err.what());
+		
+		/* Drop the connection, as the stream can not be resynchronized after a protocol error: */
+		try
+			{
+			pipe->shutdown(true,true);
+			}
+		catch(...)
+			{
+			/* Ignore the error; the connection is being dropped anyway */
+			}
+		}
+	
+	return 0;
+	}
+
+void* MultiplexedFrameSource::decodingThreadMethod(unsigned int frameId)
+	{
+	Decoder& decoder=decoders[frameId];
+	FrameReader* frameReader=(frameId&0x1U)?depthFrameReaders[frameId>>1]:colorFrameReaders[frameId>>1];
+	
+	while(true)
+		{
+		/* Wait for the next compressed frame: */
+		CompressedFrame* frame;
+		{
+		Threads::MutexCond::Lock queueLock(decoder.queueCond);
+		while(!shutdownThreads&&decoder.queue.empty())
+			decoder.queueCond.wait(queueLock);
+		if(shutdownThreads)
+			break;
+		frame=decoder.queue.front();
+		decoder.queue.pop_front();
+		
+		/* Wake up the demultiplexer in case it is waiting for room in the queue: */
+		decoder.queueCond.broadcast();
+		}
+		
+		/* Decompress the frame; frame readers keep state between frames, so all frames must be decompressed in order even if their meta frames have already been dropped: */
+		FrameBuffer decodedFrame;
+		bool decoded=false;
+		try
+			{
+			decoder.file.setFrame(frame);
+			decodedFrame=frameReader->readNextFrame();
+			
+			/* Adjust the new frame's time stamp: */
+			decodedFrame.timeStamp-=timeStampOffset;
+			decoded=true;
+			}
+		catch(const std::runtime_error& err)
+			{
+			/* Log an error message; the frame's meta frame will be dropped: */
+			Misc::formattedUserError("Kinect::MultiplexedFrameSource: Unable to decompress frame %u of meta frame %u due to exception %s",frameId,frame->metaFrameIndex,err.what());
+			}
+		
+		if(decoded)
+			{
+			Threads::MutexCond::Lock metaFrameLock(metaFrameCond);
+			
+			/* Find the frame's meta frame in the list of pending meta frames: */
+			std::deque<MetaFrame*>::iterator mfIt;
+			for(mfIt=pendingMetaFrames.begin();mfIt!=pendingMetaFrames.end()&&(*mfIt)->index!=frame->metaFrameIndex;++mfIt)
+				;
+			if(mfIt!=pendingMetaFrames.end())
+				{
+				/* Store the decompressed frame in the meta frame: */
+				MetaFrame* metaFrame=*mfIt;
+				metaFrame->frames[frameId]=decodedFrame;
+				metaFrame->receiveTimes[frameId]=frame->receiveTime;
+				
+				/* Check if the meta frame is now complete: */
+				if(--metaFrame->numMissingFrames==0)
+					{
+					/* Drop all older meta frames, which can no longer be delivered in order: */
+					for(std::deque<MetaFrame*>::iterator dmfIt=pendingMetaFrames.begin();dmfIt!=mfIt;++dmfIt)
+						dropMetaFrame(*dmfIt);
+					pendingMetaFrames.erase(pendingMetaFrames.begin(),mfIt+1);
+					
+					/* Replace any completed meta frame that the delivery thread has not yet picked up: */
+					if(completedMetaFrame!=0)
+						dropMetaFrame(completedMetaFrame);
+					completedMetaFrame=metaFrame;
+					metaFrameCond.signal();
+					}
+				}
+			}
+		
+		/* Release the compressed frame: */
+		delete frame;
+		}
+	
+	return 0;
+	}
+
+void MultiplexedFrameSource::dropMetaFrame(MultiplexedFrameSource::MetaFrame* metaFrame)
+	{
+	/* Release the meta frame's decompressed frames and return it to the free list: */
+	for(unsigned int i=0;i<numStreams*2;++i)
+		metaFrame->frames[i]=FrameBuffer();
+	freeMetaFrames.push_back(metaFrame);
+	
+	/* Count the meta frame as dropped for all streams: */
+	for(unsigned int i=0;i<numStreams;++i)
+		++statistics[i].numMetaFramesDropped;
+	}
+
+void* MultiplexedFrameSource::deliveryThreadMethod(void)
+	{
+	while(true)
+		{
+		/* Wait for the next completed meta frame: */
+		MetaFrame* metaFrame;
+		{
+		Threads::MutexCond::Lock metaFrameLock(metaFrameCond);
+		while(!shutdownThreads&&completedMetaFrame==0)
+			metaFrameCond.wait(metaFrameLock);
+		if(shutdownThreads)
+			break;
+		metaFrame=completedMetaFrame;
+		completedMetaFrame=0;
+		}
+		FrameSource::Time deliveryTime;
+		
+		/* Stream all frames of the meta frame to their respective listeners: */
+		{
+		Threads::Mutex::Lock streamLock(streamMutex);
+		
+		for(unsigned int i=0;i<numStreams;++i)
+			{
+			if(streams[i]!=0)
+				{
+				Threads::Spinlock::Lock streamingLock(streams[i]->streamingMutex);
+				if(streams[i]->streaming)
+					{
+					/* Push the streamer's frames: */
+					if(streams[i]->colorStreamingCallback!=0)
+						(*streams[i]->colorStreamingCallback)(metaFrame->frames[i*2+0]);
+					if(streams[i]->depthStreamingCallback!=0)
+						(*streams[i]->depthStreamingCallback)(metaFrame->frames[i*2+1]);
+					}
+				}
+			}
+		}
+		
+		{
+		Threads::MutexCond::Lock metaFrameLock(metaFrameCond);
+		
+		/* Update all streams' latency statistics: */
+		for(unsigned int i=0;i<numStreams;++i)
+			{
+			/* Measure latency from the arrival of the stream's earlier compressed frame: */
+			double latency=double(deliveryTime-metaFrame->receiveTimes[i*2+0]);
+			double depthLatency=double(deliveryTime-metaFrame->receiveTimes[i*2+1]);
+			if(latency<depthLatency)
+				latency=depthLatency;
+			
+			Statistics& stats=statistics[i];
+			++stats.numMetaFramesDelivered;
+			stats.meanLatency+=(latency-stats.meanLatency)/double(stats.numMetaFramesDelivered);
+			if(stats.maxLatency<latency)
+				stats.maxLatency=latency;
+			}
+		
+		/* Release the meta frame's decompressed frames and return it to the free list: */
+		for(unsigned int i=0;i<numStreams*2;++i)
+			metaFrame->frames[i]=FrameBuffer();
+		freeMetaFrames.push_back(metaFrame);
+		}
+		}
+	
+	return 0;
+	}
+
 MultiplexedFrameSource::MultiplexedFrameSource(Comm::PipePtr sPipe)
 	:pipe(sPipe),
 	 numStreams(0),
@@ -293,7 +600,10 @@ MultiplexedFrameSource::MultiplexedFrameSource(Comm::PipePtr sPipe)
 	 depthFrameReaders(0),
 	 frames(0),
 	 numStreamsAlive(0),
-	 streams(0)
+	 streams(0),
+	 decoders(0),completedMetaFrame(0),
+	 shutdownThreads(false),
+	 statistics(0)
 	{
 	/* Check if the pipe is a cluster-forwarded pipe: */
 	Cluster::ClusterPipe* cPipe=dynamic_cast<Cluster::ClusterPipe*>(pipe.getPointer());
@@ -305,7 +615,7 @@ MultiplexedFrameSource::MultiplexedFrameSource(Comm::PipePtr sPipe)
 	
 	/* Write client's endianness flag and protocol version number: */
 	pipe->write<Misc::UInt32>(0x12345678U);
-	pipe->write<Misc::UInt32>(1U);
+	pipe->write<Misc::UInt32>(2U);
 	pipe->flush();
 	
 	/* Determine server's endianness: */
@@ -323,6 +633,13 @@ MultiplexedFrameSource::MultiplexedFrameSource(Comm::PipePtr sPipe)
 	
 	/* Initialize all streams: */
 	numStreams=pipe->read<Misc::UInt32>();
+	if(serverProtocolVersion>=2U)
+		{
+		/* Create decompression thread states for all component streams, as the server sends frame sizes: */
+		decoders=new Decoder[numStreams*2];
+		for(unsigned int i=0;i<numStreams*2;++i)
+			decoders[i].file.setSwapOnRead(pipe->mustSwapOnRead());
+		}
 	colorFrameReaders=new FrameReader*[numStreams];
 	depthFrameReaders=new FrameReader*[numStreams];
 	streams=new Stream*[numStreams];
@@ -361,14 +678,29 @@ MultiplexedFrameSource::MultiplexedFrameSource(Comm::PipePtr sPipe)
 		delete[] colorFrameReaders;
 		delete[] depthFrameReaders;
 		delete[] streams;
+		delete[] decoders;
 		Misc::throwStdErr("MultiplexedFrameSource::MultiplexedFrameSource: Error while initializing component streams");
 		}
 	
-	/* Allocate the frame buffer array: */
+	/* Allocate the frame buffer array and statistics: */
 	frames=new FrameBuffer[numStreams*2];
+	statistics=new Statistics[numStreams];
 	
-	/* Start the demultiplexer thread: */
-	receivingThread.start(this,&MultiplexedFrameSource::receivingThreadMethod);
+	if(decoders!=0)
+		{
+		/* Start the decompression and delivery threads: */
+		for(unsigned int i=0;i<numStreams*2;++i)
+			decoders[i].thread.start(this,&MultiplexedFrameSource::decodingThreadMethod,i);
+		deliveryThread.start(this,&MultiplexedFrameSource::deliveryThreadMethod);
+		
+		/* Start the demultiplexer thread: */
+		receivingThread.start(this,&MultiplexedFrameSource::bufferingThreadMethod);
+		}
+	else
+		{
+		/* Start the demultiplexer thread: */
+		receivingThread.start(this,&MultiplexedFrameSource::receivingThreadMethod);
+		}
 	}
 
 MultiplexedFrameSource::~MultiplexedFrameSource(void)
@@ -377,6 +709,37 @@ MultiplexedFrameSource::~MultiplexedFrameSource(void)
 	receivingThread.cancel();
 	receivingThread.join();
 	
+	if(decoders!=0)
+		{
+		/* Shut down the decompression and delivery threads: */
+		shutdownThreads=true;
+		for(unsigned int i=0;i<numStreams*2;++i)
+			{
+			Threads::MutexCond::Lock queueLock(decoders[i].queueCond);
+			decoders[i].queueCond.signal();
+			}
+		{
+		Threads::MutexCond::Lock metaFrameLock(metaFrameCond);
+		metaFrameCond.signal();
+		}
+		for(unsigned int i=0;i<numStreams*2;++i)
+			decoders[i].thread.join();
+		deliveryThread.join();
+		
+		/* Delete all compressed frames that were not decompressed: */
+		for(unsigned int i=0;i<numStreams*2;++i)
+			for(std::deque<CompressedFrame*>::iterator qIt=decoders[i].queue.begin();qIt!=decoders[i].queue.end();++qIt)
+				delete *qIt;
+		delete[] decoders;
+		
+		/* Delete all meta frames: */
+		for(std::deque<MetaFrame*>::iterator mfIt=pendingMetaFrames.begin();mfIt!=pendingMetaFrames.end();++mfIt)
+			delete *mfIt;
+		delete completedMetaFrame;
+		for(std::vector<MetaFrame*>::iterator mfIt=freeMetaFrames.begin();mfIt!=freeMetaFrames.end();++mfIt)
+			delete *mfIt;
+		}
+	
 	/* Delete all streams: */
 	for(unsigned int i=0;i<numStreams;++i)
 		{
@@ -388,8 +751,9 @@ MultiplexedFrameSource::~MultiplexedFrameSource(void)
 	delete[] depthFrameReaders;
 	delete[] streams;
 	
-	/* Delete the frame buffers: */
+	/* Delete the frame buffers and statistics: */
 	delete[] frames;
+	delete[] statistics;
 	
 	/* Say goodbye to the server: */
 	try
@@ -409,4 +773,44 @@ MultiplexedFrameSource* MultiplexedFrameSource::create(Comm::PipePtr sPipe)
 	return new MultiplexedFrameSource(sPipe);
 	}
 
+MultiplexedFrameSource::Statistics MultiplexedFrameSource::getStatistics(unsigned int streamIndex) const
+	{
+	Statistics result;
+	{
+	Threads::MutexCond::Lock metaFrameLock(metaFrameCond);
+	result=statistics[streamIndex];
+	}
+	
+	if(decoders!=0)
+		{
+		/* Collect the maximum queue depth of the stream's color and depth decompression threads: */
+		for(unsigned int i=streamIndex*2;i<streamIndex*2+2;++i)
+			{
+			Threads::MutexCond::Lock queueLock(decoders[i].queueCond);
+			if(result.maxDecodeQueueDepth<decoders[i].maxQueueDepth)
+				result.maxDecodeQueueDepth=decoders[i].maxQueueDepth;
+			}
+		}
+	
+	return result;
+	}
+
+void MultiplexedFrameSource::resetStatistics(void)
+	{
+	{
+	Threads::MutexCond::Lock metaFrameLock(metaFrameCond);
+	for(unsigned int i=0;i<numStreams;++i)
+		statistics[i]=Statistics();
+	}
+	
+	if(decoders!=0)
+		{
+		for(unsigned int i=0;i<numStreams*2;++i)
+			{
+			Threads::MutexCond::Lock queueLock(decoders[i].queueCond);
+			decoders[i].maxQueueDepth=0;
+			}
+		}
+	}
+
 }
@@ -1,7 +1,7 @@
 /***********************************************************************
 MultiplexedFrameSource - Class to stream several pairs of color and
 depth frames from a single source file or pipe.
-Copyright (c) 2010-2016 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -24,9 +24,15 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef KINECT_MULTIPLEXEDFRAMESOURCE_INCLUDED
 #define KINECT_MULTIPLEXEDFRAMESOURCE_INCLUDED
 
+#include <stddef.h>
+#include <deque>
+#include <vector>
+#include <Misc/SizedTypes.h>
 #include <Threads/Mutex.h>
 #include <Threads/Spinlock.h>
+#include <Threads/MutexCond.h>
 #include <Threads/Thread.h>
+#include <IO/File.h>
 #include <Comm/Pipe.h>
 #include <Geometry/OrthogonalTransformation.h>
 #include <Geometry/ProjectiveTransformation.h>
@@ -43,6 +49,26 @@ namespace Kinect {
 class MultiplexedFrameSource
 	{
 	/* Embedded classes: */
+	public:
+	struct Statistics // Structure reporting the state of one component stream's decompression pipeline
+		{
+		/* Elements: */
+		public:
+		size_t numMetaFramesDelivered; // Number of meta frames whose frames were passed to the stream's streaming callbacks
+		size_t numMetaFramesDropped; // Number of meta frames that were dropped because a newer meta frame was completed first
+		unsigned int maxDecodeQueueDepth; // Largest number of compressed frames of the stream that waited for decompression at the same time
+		double meanLatency; // Mean time from receiving the stream's first compressed frame of a meta frame to delivering the meta frame in seconds
+		double maxLatency; // Maximum time from receiving the stream's first compressed frame of a meta frame to delivering the meta frame in seconds
+		
+		/* Constructors and destructors: */
+		Statistics(void)
+			:numMetaFramesDelivered(0),numMetaFramesDropped(0),
+			 maxDecodeQueueDepth(0),
+			 meanLatency(0.0),maxLatency(0.0)
+			{
+			}
+		};
+	
 	private:
 	class Stream:public FrameSource // Class representing a single corresponding color and depth frame stream inside the multiplexed stream
 		{
@@ -76,6 +102,80 @@ class MultiplexedFrameSource
 	
 	friend class Stream;
 	
+	struct CompressedFrame // Structure holding a compressed color or depth frame received from the server
+		{
+		/* Elements: */
+		public:
+		unsigned int metaFrameIndex; // Index of the meta frame to which the frame belongs
+		FrameSource::Time receiveTime; // Time at which the frame was received
+		size_t dataSize; // Size of the compressed frame in bytes
+		Misc::UInt8* data; // Buffer holding the compressed frame
+		
+		/* Constructors and destructors: */
+		CompressedFrame(unsigned int sMetaFrameIndex,size_t sDataSize)
+			:metaFrameIndex(sMetaFrameIndex),
+			 dataSize(sDataSize),data(new Misc::UInt8[dataSize])
+			{
+			}
+		~CompressedFrame(void)
+			{
+			delete[] data;
+			}
+		};
+	
+	class DecoderFile:public IO::File // Class to present a sequence of compressed frames to a frame reader
+		{
+		/* Constructors and destructors: */
+		public:
+		DecoderFile(void); // Creates a file without data
+		virtual ~DecoderFile(void);
+		
+		/* Methods from IO::File: */
+		virtual size_t resizeReadBuffer(size_t newReadBufferSize);
+		
+		/* New methods: */
+		void setFrame(CompressedFrame* newFrame); // Makes the given compressed frame the file's current contents; frame must remain valid while the file is read
+		};
+	
+	struct Decoder // Structure holding the state of a decompression thread for one color or depth component stream
+		{
+		/* Elements: */
+		public:
+		DecoderFile file; // File feeding compressed frames to the component stream's frame reader
+		Threads::MutexCond queueCond; // Condition variable to notify the decompression thread of new compressed frames
+		std::deque<CompressedFrame*> queue; // Queue of compressed frames waiting for decompression
+		unsigned int maxQueueDepth; // Largest number of compressed frames that waited for decompression at the same time
+		Threads::Thread thread; // The decompression thread
+		
+		/* Constructors and destructors: */
+		Decoder(void)
+			:maxQueueDepth(0)
+			{
+			}
+		};
+	
+	struct MetaFrame // Structure holding a meta frame being assembled from decompressed frames
+		{
+		/* Elements: */
+		public:
+		unsigned int index; // Index of the meta frame
+		unsigned int numMissingFrames; // Number of decompressed frames still missing from the meta frame
+		FrameBuffer* frames; // Array of decompressed color and depth frames
+		FrameSource::Time* receiveTimes; // Array of times at which the compressed color and depth frames were received
+		
+		/* Constructors and destructors: */
+		MetaFrame(unsigned int numFrames)
+			:index(0),numMissingFrames(numFrames),
+			 frames(new FrameBuffer[numFrames]),receiveTimes(new FrameSource::Time[numFrames])
+			{
+			}
+		~MetaFrame(void)
+			{
+			delete[] frames;
+			delete[] receiveTimes;
+			}
+		};
+	
 	/* Elements: */
 	private:
 	Comm::PipePtr pipe; // The multiplexed source stream
@@ -89,9 +189,21 @@ class MultiplexedFrameSource
 	unsigned int numStreamsAlive; // Number of streams that are still receiving frames
 	Stream** streams; // Array of pointers to streams
 	Threads::Thread receivingThread; // The demultiplexer thread
+	Decoder* decoders; // Array of decompression thread states for the color and depth component streams if the server sends frame sizes; null otherwise
+	mutable Threads::MutexCond metaFrameCond; // Condition variable to notify the delivery thread of completed meta frames; also protects meta frame lists and statistics
+	std::deque<MetaFrame*> pendingMetaFrames; // List of meta frames still waiting for decompressed frames, in order of meta frame index
+	MetaFrame* completedMetaFrame; // Most recently completed meta frame that has not yet been delivered, or null
+	std::vector<MetaFrame*> freeMetaFrames; // List of meta frames not currently in use
+	Threads::Thread deliveryThread; // Thread delivering completed meta frames to the streams' streaming callbacks
+	volatile bool shutdownThreads; // Flag to shut down the decompression and delivery threads
+	Statistics* statistics; // Array of decompression pipeline states for all component streams
 	
 	/* Private methods: */
-	void* receivingThreadMethod(void); // Thread method demultiplexing streams from the source
+	void* receivingThreadMethod(void); // Thread method demultiplexing and decompressing streams from a server that does not send frame sizes
+	void* bufferingThreadMethod(void); // Thread method demultiplexing compressed frames from a server that sends frame sizes, and handing them to the decompression threads
+	void* decodingThreadMethod(unsigned int frameId); // Thread method decompressing frames for the given color or depth component stream
+	void dropMetaFrame(MetaFrame* metaFrame); // Returns the given undelivered meta frame to the free list and counts it as dropped; meta frame lists must be locked
+	void* deliveryThreadMethod(void); // Thread method delivering completed meta frames to the streams' streaming callbacks
 	
 	/* Constructors and destructors: */
 	private:
@@ -109,6 +221,8 @@ class MultiplexedFrameSource
 		{
 		return streams[streamIndex];
 		}
+	Statistics getStatistics(unsigned int streamIndex) const; // Returns the current state of the given stream's decompression pipeline
+	void resetStatistics(void); // Resets all streams' decompression pipeline counters and timers
 	};
 
 }
@@ -42,6 +42,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <GL/GLLightTracker.h>
 #include <GL/GLTransformationWrappers.h>
 #include <Kinect/Internal/Config.h>
+#include <Kinect/FrameBufferPool.h>
 
 // DEBUGGING
 #include <iostream>
@@ -132,7 +133,7 @@ void* Projector2::depthFrameProcessingThreadMethod(void)
 		if(filterDepthFrames)
 			{
 			const FrameSource::DepthPixel* dfPtr=rawDepthFrame.getData<FrameSource::DepthPixel>();
-			newMesh.first=FrameBuffer(depthSize[0],depthSize[1],depthSize[1]*depthSize[0]*sizeof(FrameSource::DepthPixel));
+			newMesh.first=FrameBufferPool::getDefaultPool().allocate(depthSize[0],depthSize[1],depthSize[1]*depthSize[0]*sizeof(FrameSource::DepthPixel));
 			newMesh.first.timeStamp=rawDepthFrame.timeStamp;
 			FrameSource::DepthPixel* mPtr=newMesh.first.getData<FrameSource::DepthPixel>();
 			
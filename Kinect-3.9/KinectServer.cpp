@@ -1,7 +1,7 @@
 /***********************************************************************
 KinectServer - Server to stream 3D video data from one or more Kinect
 cameras to remote clients for tele-immersion.
-Copyright (c) 2010-2018 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -86,7 +86,7 @@ void KinectServer::CameraState::depthStreamingCallback(const Kinect::FrameBuffer
 	write(framePipeFd,&frameIndex,sizeof(frameIndex));
 	}
 
-KinectServer::CameraState::CameraState(const char* serialNumber,bool sLossyDepthCompression)
+KinectServer::CameraState::CameraState(const char* serialNumber,Kinect::ColorFrameWriter::Codec colorCodec,bool sLossyDepthCompression)
 	:camera(Kinect::openDirectFrameSource(serialNumber,false)),cameraIndex(0U),
 	 depthCorrection(0),framePipeFd(-1),
 	 colorFile(16384),colorCompressor(0),
@@ -102,7 +102,7 @@ KinectServer::CameraState::CameraState(const char* serialNumber,bool sLossyDepth
 	eps=camera->getExtrinsicParameters();
 	
 	/* Create the color and depth frame compressors: */
-	colorCompressor=new Kinect::ColorFrameWriter(colorFile,camera->getActualFrameSize(Kinect::FrameSource::COLOR),camera->getColorSpace());
+	colorCompressor=new Kinect::ColorFrameWriter(colorFile,camera->getActualFrameSize(Kinect::FrameSource::COLOR),camera->getColorSpace(),colorCodec);
 	#if VIDEO_CONFIG_HAVE_THEORA
 	if(lossyDepthCompression)
 		depthCompressor=new Kinect::LossyDepthFrameWriter(depthFile,camera->getActualFrameSize(Kinect::FrameSource::DEPTH));
@@ -140,7 +140,7 @@ void KinectServer::CameraState::startStreaming(const Kinect::FrameSource::Time&
 	camera->startStreaming(Misc::createFunctionCall(this,&KinectServer::CameraState::colorStreamingCallback),Misc::createFunctionCall(this,&KinectServer::CameraState::depthStreamingCallback));
 	}
 
-void KinectServer::CameraState::writeHeaders(IO::File& sink) const
+void KinectServer::CameraState::writeHeaders(IO::File& sink,unsigned int protocolVersion) const
 	{
 	/* Write the stream format versions: */
 	sink.write<Misc::UInt32>(1);
@@ -172,8 +172,12 @@ void KinectServer::CameraState::writeHeaders(IO::File& sink) const
 	Misc::Marshaller<Kinect::FrameSource::IntrinsicParameters::PTransform>::write(ips.depthProjection,sink);
 	Misc::Marshaller<Kinect::FrameSource::ExtrinsicParameters>::write(eps,sink);
 	
-	/* Write the color and depth compression headers: */
+	/* Write the color and depth compression headers, preceded by their sizes starting with protocol version 2: */
+	if(protocolVersion>=2U)
+		sink.write<Misc::UInt32>(Misc::UInt32(colorHeaders.getDataSize()));
 	colorHeaders.writeToSink(sink);
+	if(protocolVersion>=2U)
+		sink.write<Misc::UInt32>(Misc::UInt32(depthHeaders.getDataSize()));
 	depthHeaders.writeToSink(sink);
 	}
 
@@ -241,7 +245,9 @@ void KinectServer::newFrameCallback(void)
 						(*csIt)->pipe.write<Misc::UInt32>(metaFrameIndex);
 						(*csIt)->pipe.write<Misc::UInt32>(frameIndex);
 						
-						/* Write the compressed depth frame: */
+						/* Write the compressed depth frame, preceded by its size starting with protocol version 2: */
+						if((*csIt)->protocolVersion>=2U)
+							(*csIt)->pipe.write<Misc::UInt32>(Misc::UInt32(cameraStates[cameraIndex]->depthFrames.getLockedValue().data.getDataSize()));
 						cameraStates[cameraIndex]->depthFrames.getLockedValue().data.writeToSink((*csIt)->pipe);
 						(*csIt)->pipe.flush();
 						}
@@ -283,7 +289,9 @@ void KinectServer::newFrameCallback(void)
 						(*csIt)->pipe.write<Misc::UInt32>(metaFrameIndex);
 						(*csIt)->pipe.write<Misc::UInt32>(frameIndex);
 						
-						/* Write the compressed color frame: */
+						/* Write the compressed color frame, preceded by its size starting with protocol version 2: */
+						if((*csIt)->protocolVersion>=2U)
+							(*csIt)->pipe.write<Misc::UInt32>(Misc::UInt32(cameraStates[cameraIndex]->colorFrames.getLockedValue().data.getDataSize()));
 						cameraStates[cameraIndex]->colorFrames.getLockedValue().data.writeToSink((*csIt)->pipe);
 						(*csIt)->pipe.flush();
 						}
@@ -402,8 +410,8 @@ bool KinectServer::clientMessageCallback(Threads::EventDispatcher::ListenerKey e
 					else if(endiannessFlag!=0x12345678U)
 						throw std::runtime_error("Client has unrecognized endianness");
 					client->protocolVersion=client->pipe.read<Misc::UInt32>();
-					if(client->protocolVersion>1U)
-						client->protocolVersion=1U;
+					if(client->protocolVersion>2U)
+						client->protocolVersion=2U;
 					
 					/* Send stream initialization states to the new client: */
 					#ifdef VERBOSE
@@ -415,7 +423,7 @@ bool KinectServer::clientMessageCallback(Threads::EventDispatcher::ListenerKey e
 					client->pipe.write<Misc::Float64>(double(now-thisPtr->timeBase));
 					client->pipe.write<Misc::UInt32>(thisPtr->numCameras);
 					for(unsigned i=0;i<thisPtr->numCameras;++i)
-						thisPtr->cameraStates[i]->writeHeaders(client->pipe);
+						thisPtr->cameraStates[i]->writeHeaders(client->pipe,client->protocolVersion);
 					
 					/* Finish the reply message: */
 					client->pipe.flush();
@@ -449,7 +457,7 @@ bool KinectServer::clientMessageCallback(Threads::EventDispatcher::ListenerKey e
 						}
 					else
 						throw std::runtime_error("Protocol error in STREAMING state");
-						
+					
 					break;
 					}
 				}
@@ -494,11 +502,21 @@ KinectServer::KinectServer(Misc::ConfigurationFileSection& configFileSection)
 		
 		try
 			{
+			/* Select the camera's color compression codec: */
+			std::string colorCodecName=cameraSection.retrieveString("./colorCodec","Default");
+			Kinect::ColorFrameWriter::Codec colorCodec=Kinect::ColorFrameWriter::DEFAULT_CODEC;
+			if(strcasecmp(colorCodecName.c_str(),"Theora")==0)
+				colorCodec=Kinect::ColorFrameWriter::THEORA;
+			else if(strcasecmp(colorCodecName.c_str(),"Tiles")==0)
+				colorCodec=Kinect::ColorFrameWriter::TILES;
+			else if(strcasecmp(colorCodecName.c_str(),"Default")!=0)
+				Misc::throwStdErr("Unknown color codec %s",colorCodecName.c_str());
+			
 			/* Create a streamer for the Kinect device of the requested serial number: */
 			#ifdef VERBOSE
 			std::cout<<"KinectServer: Creating streamer for camera with serial number "<<serialNumber<<std::endl;
 			#endif
-			cameraStates[numFoundCameras]=new CameraState(serialNumber.c_str(),cameraSection.retrieveValue<bool>("./lossyDepthCompression",false));
+			cameraStates[numFoundCameras]=new CameraState(serialNumber.c_str(),colorCodec,cameraSection.retrieveValue<bool>("./lossyDepthCompression",false));
 			
 			/* Check if camera is to remove background: */
 			if(cameraSection.retrieveValue<bool>("./removeBackground",true))
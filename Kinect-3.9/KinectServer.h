@@ -1,7 +1,7 @@
 /***********************************************************************
 KinectServer - Server to stream 3D video data from one or more Kinect
 cameras to remote clients for tele-immersion.
-Copyright (c) 2010-2017 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -37,6 +37,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Geometry/ProjectiveTransformation.h>
 #include <Kinect/FrameBuffer.h>
 #include <Kinect/FrameSource.h>
+#include <Kinect/ColorFrameWriter.h>
 
 /* Forward declarations: */
 class libusb_device;
@@ -100,12 +101,12 @@ class KinectServer
 		void depthStreamingCallback(const Kinect::FrameBuffer& frame);
 		
 		/* Constructors and destructors: */
-		CameraState(const char* serialNumber,bool sLossyDepthCompression); // Creates a capture and compression state for the given Kinect camera device
+		CameraState(const char* serialNumber,Kinect::ColorFrameWriter::Codec colorCodec,bool sLossyDepthCompression); // Creates a capture and compression state for the given Kinect camera device
 		~CameraState(void);
 		
 		/* Methods: */
 		void startStreaming(const Kinect::FrameSource::Time& timeBase); // Starts streaming from the Kinect camera
-		void writeHeaders(IO::File& sink) const; // Writes the camera's streaming headers to the given sink
+		void writeHeaders(IO::File& sink,unsigned int protocolVersion) const; // Writes the camera's streaming headers to the given sink using the given protocol version
 		};
 	
 	struct ClientState // Class containing state of connected client
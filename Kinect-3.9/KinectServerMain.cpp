@@ -26,6 +26,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <iostream>
 #include <Misc/ConfigurationFile.h>
 #include <Kinect/Internal/Config.h>
+#include <Kinect/FrameBufferPool.h>
 
 #include "KinectServer.h"
 
@@ -72,6 +73,10 @@ int main(void)
 		
 		/* Shut down the server: */
 		delete server;
+		
+		/* Report how well frame buffers were recycled during the server's lifetime: */
+		Kinect::FrameBufferPool::Statistics poolStats=Kinect::FrameBufferPool::getDefaultPool().getStatistics();
+		std::cout<<"KinectServer: Frame buffer pool served "<<poolStats.numHits<<" recycled and "<<poolStats.numMisses<<" new frame buffers; discarded "<<poolStats.numDiscards<<" frame buffers"<<std::endl;
 		}
 	catch(const std::runtime_error& err)
 		{
@@ -0,0 +1,127 @@
+/***********************************************************************
+KinectV1DecodeBenchmark - Utility to measure the performance of the
+raw color and depth frame decoders for first-generation Kinect cameras
+on synthetic raw frames, and to check that the vectorized decoders
+produce the same results as the scalar decoders.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <Misc/SizedTypes.h>
+#include <Misc/Timer.h>
+#include <Kinect/FrameSource.h>
+#include <Kinect/Internal/KinectV1FrameDecoder.h>
+
+typedef void (*ColorDecoder)(const Kinect::FrameSource::ColorComponent*,int,int,Kinect::FrameSource::ColorComponent*);
+typedef void (*DepthDecoder)(const Misc::UInt8*,int,int,Kinect::FrameSource::DepthPixel*);
+
+double timeColorDecoder(ColorDecoder decoder,const Kinect::FrameSource::ColorComponent* rawFrame,int width,int height,Kinect::FrameSource::ColorComponent* rgbFrame,unsigned int numPasses)
+	{
+	Misc::Timer timer;
+	for(unsigned int pass=0;pass<numPasses;++pass)
+		decoder(rawFrame,width,height,rgbFrame);
+	timer.elapse();
+	return timer.getTime()*1000.0/double(numPasses);
+	}
+
+double timeDepthDecoder(DepthDecoder decoder,const Misc::UInt8* rawFrame,int width,int height,Kinect::FrameSource::DepthPixel* depthFrame,unsigned int numPasses)
+	{
+	Misc::Timer timer;
+	for(unsigned int pass=0;pass<numPasses;++pass)
+		decoder(rawFrame,width,height,depthFrame);
+	timer.elapse();
+	return timer.getTime()*1000.0/double(numPasses);
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	int colorSize[2]={640,480};
+	int depthSize[2]={640,480};
+	unsigned int numPasses=200;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"highres")==0)
+				{
+				colorSize[0]=1280;
+				colorSize[1]=1024;
+				}
+			else if(strcasecmp(argv[i]+1,"passes")==0)
+				{
+				++i;
+				numPasses=atoi(argv[i]);
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		}
+	
+	/* Create synthetic raw color and depth frames: */
+	size_t numColorPixels=size_t(colorSize[0])*size_t(colorSize[1]);
+	Kinect::FrameSource::ColorComponent* rawColorFrame=new Kinect::FrameSource::ColorComponent[numColorPixels];
+	for(size_t i=0;i<numColorPixels;++i)
+		rawColorFrame[i]=Kinect::FrameSource::ColorComponent(rand()&0xff);
+	size_t numDepthPixels=size_t(depthSize[0])*size_t(depthSize[1]);
+	size_t rawDepthFrameSize=(numDepthPixels*11)/8;
+	Misc::UInt8* rawDepthFrame=new Misc::UInt8[rawDepthFrameSize];
+	for(size_t i=0;i<rawDepthFrameSize;++i)
+		rawDepthFrame[i]=Misc::UInt8(rand()&0xff);
+	
+	/* Decode the frames with the scalar and vectorized decoders and compare the results: */
+	Kinect::FrameSource::ColorComponent* rgbFrames[2];
+	Kinect::FrameSource::DepthPixel* depthFrames[2];
+	for(int i=0;i<2;++i)
+		{
+		rgbFrames[i]=new Kinect::FrameSource::ColorComponent[numColorPixels*3];
+		depthFrames[i]=new Kinect::FrameSource::DepthPixel[numDepthPixels];
+		}
+	Kinect::decodeBayerFrameScalar(rawColorFrame,colorSize[0],colorSize[1],rgbFrames[0]);
+	Kinect::decodeBayerFrame(rawColorFrame,colorSize[0],colorSize[1],rgbFrames[1]);
+	bool colorMatch=memcmp(rgbFrames[0],rgbFrames[1],numColorPixels*3*sizeof(Kinect::FrameSource::ColorComponent))==0;
+	Kinect::unpackDepthFrameScalar(rawDepthFrame,depthSize[0],depthSize[1],depthFrames[0]);
+	Kinect::unpackDepthFrame(rawDepthFrame,depthSize[0],depthSize[1],depthFrames[1]);
+	bool depthMatch=memcmp(depthFrames[0],depthFrames[1],numDepthPixels*sizeof(Kinect::FrameSource::DepthPixel))==0;
+	
+	/* Time the decoders: */
+	double colorTimes[2],depthTimes[2];
+	colorTimes[0]=timeColorDecoder(Kinect::decodeBayerFrameScalar,rawColorFrame,colorSize[0],colorSize[1],rgbFrames[0],numPasses);
+	colorTimes[1]=timeColorDecoder(Kinect::decodeBayerFrame,rawColorFrame,colorSize[0],colorSize[1],rgbFrames[1],numPasses);
+	depthTimes[0]=timeDepthDecoder(Kinect::unpackDepthFrameScalar,rawDepthFrame,depthSize[0],depthSize[1],depthFrames[0],numPasses);
+	depthTimes[1]=timeDepthDecoder(Kinect::unpackDepthFrame,rawDepthFrame,depthSize[0],depthSize[1],depthFrames[1],numPasses);
+	
+	/* Print the results: */
+	std::cout<<"Bayer decoding ("<<colorSize[0]<<'x'<<colorSize[1]<<"): scalar "<<colorTimes[0]<<" ms, vectorized "<<colorTimes[1]<<" ms, speedup "<<colorTimes[0]/colorTimes[1]<<", results "<<(colorMatch?"identical":"DIFFERENT")<<std::endl;
+	std::cout<<"Depth unpacking ("<<depthSize[0]<<'x'<<depthSize[1]<<"): scalar "<<depthTimes[0]<<" ms, vectorized "<<depthTimes[1]<<" ms, speedup "<<depthTimes[0]/depthTimes[1]<<", results "<<(depthMatch?"identical":"DIFFERENT")<<std::endl;
+	
+	/* Clean up: */
+	for(int i=0;i<2;++i)
+		{
+		delete[] rgbFrames[i];
+		delete[] depthFrames[i];
+		}
+	delete[] rawColorFrame;
+	delete[] rawDepthFrame;
+	
+	return colorMatch&&depthMatch?0:1;
+	}
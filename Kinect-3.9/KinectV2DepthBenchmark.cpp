@@ -0,0 +1,285 @@
+/***********************************************************************
+KinectV2DepthBenchmark - Utility to capture raw range-gated IR images
+from a Kinect v2 camera, and to measure the performance of depth image
+reconstruction from captured or synthetic raw IR images without a
+camera.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Kinect 3D Video Capture Project (Kinect).
+
+The Kinect 3D Video Capture Project is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Kinect 3D Video Capture Project is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Kinect 3D Video Capture Project; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdexcept>
+#include <vector>
+#include <iostream>
+#include <Misc/SizedTypes.h>
+#include <Misc/Timer.h>
+#include <Misc/FunctionCalls.h>
+#include <Threads/MutexCond.h>
+#include <IO/File.h>
+#include <IO/OpenFile.h>
+#include <IO/FixedMemoryFile.h>
+#include <Math/Math.h>
+#include <Math/Constants.h>
+#include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameSource.h>
+#include <Kinect/CameraV2.h>
+#include <Kinect/Internal/KinectV2DepthDecoder.h>
+
+typedef Kinect::KinectV2DepthDecoder::IRPixel IRPixel;
+
+static const unsigned int numPixels=Kinect::KinectV2DepthDecoder::width*Kinect::KinectV2DepthDecoder::height;
+
+struct RawFrame // Structure holding the nine range-gated IR images of a depth frame
+	{
+	/* Elements: */
+	public:
+	IRPixel* images[9];
+	
+	/* Constructors and destructors: */
+	RawFrame(void)
+		{
+		images[0]=new IRPixel[9*numPixels];
+		for(int i=1;i<9;++i)
+			images[i]=images[0]+i*numPixels;
+		}
+	};
+
+/************
+Capture mode:
+************/
+
+Threads::MutexCond captureCond;
+unsigned int numCapturedFrames=0;
+
+void depthFrameCallback(const Kinect::FrameBuffer& frame)
+	{
+	Threads::MutexCond::Lock captureLock(captureCond);
+	++numCapturedFrames;
+	captureCond.signal();
+	}
+
+void captureRawFrames(const char* fileName,unsigned int numFrames)
+	{
+	/* Open the first Kinect v2 camera: */
+	Kinect::CameraV2 camera;
+	
+	/* Capture the camera's depth calibration and all raw IR images into the file: */
+	IO::FilePtr captureFile=IO::openFile(fileName,IO::File::WriteOnly);
+	camera.setRawDepthCaptureFile(captureFile);
+	
+	/* Stream until the requested number of depth frames has been reconstructed: */
+	camera.startStreaming(0,Misc::createFunctionCall(depthFrameCallback));
+	{
+	Threads::MutexCond::Lock captureLock(captureCond);
+	while(numCapturedFrames<numFrames)
+		captureCond.wait(captureLock);
+	}
+	camera.stopStreaming();
+	camera.setRawDepthCaptureFile(0);
+	
+	std::cout<<"Captured "<<numFrames<<" depth frames to "<<fileName<<std::endl;
+	}
+
+/**************
+Benchmark mode:
+**************/
+
+void readRawFrames(const char* fileName,Kinect::KinectV2DepthDecoder& decoder,std::vector<RawFrame>& frames,unsigned int maxNumFrames)
+	{
+	/* Open the capture file and read the depth calibration: */
+	IO::FilePtr file=IO::openFile(fileName);
+	file->setEndianness(Misc::LittleEndian);
+	decoder.readCalibration(*file);
+	
+	/* Read raw IR images until the end of the file and keep only complete frames: */
+	RawFrame frame;
+	unsigned int imageMask=0x0U;
+	while(!file->eof()&&frames.size()<maxNumFrames)
+		{
+		Misc::UInt32 imageIndex=file->read<Misc::UInt32>();
+		if(imageIndex<9)
+			{
+			file->read(frame.images[imageIndex],numPixels);
+			imageMask|=0x1U<<imageIndex;
+			}
+		else
+			{
+			/* Skip the ambient IR image and store the frame if it was complete: */
+			file->skip<IRPixel>(numPixels);
+			if(imageMask==0x1ffU)
+				{
+				frames.push_back(frame);
+				frame=RawFrame();
+				}
+			imageMask=0x0U;
+			}
+		}
+	delete[] frame.images[0];
+	}
+
+void synthesizeRawFrames(Kinect::KinectV2DepthDecoder& decoder,std::vector<RawFrame>& frames,unsigned int numFrames)
+	{
+	/* Create a depth calibration with random phase offsets and a simple lens model directly in a memory file: */
+	Misc::Float32 params[9]={365.0f,365.0f,256.0f,212.0f,0.09f,-0.27f,0.09f,0.0f,0.0f};
+	Misc::UInt16* p0Tables=new Misc::UInt16[3*numPixels];
+	for(unsigned int i=0;i<3*numPixels;++i)
+		p0Tables[i]=Misc::UInt16(rand()&0xffff);
+	IO::FixedMemoryFile* calibration=new IO::FixedMemoryFile(sizeof(params)+3*numPixels*sizeof(Misc::UInt16));
+	IO::FilePtr calibrationFile(calibration);
+	Misc::UInt8* calibrationPtr=static_cast<Misc::UInt8*>(calibration->getMemory());
+	memcpy(calibrationPtr,params,sizeof(params));
+	memcpy(calibrationPtr+sizeof(params),p0Tables,3*numPixels*sizeof(Misc::UInt16));
+	calibration->setReadDataSize(calibration->getMemorySize());
+	calibrationFile->setEndianness(Misc::HostEndianness);
+	decoder.readCalibration(*calibrationFile);
+	
+	/* Create frames showing a slanted plane observed with the three modulation frequencies: */
+	const float twoPi=2.0f*Math::Constants<float>::pi;
+	const float frequencies[3]={5.0f,1.0f,7.5f}; // Modulation frequencies relative to the lowest frequency
+	for(unsigned int frameIndex=0;frameIndex<numFrames;++frameIndex)
+		{
+		RawFrame frame;
+		for(unsigned int y=0;y<Kinect::KinectV2DepthDecoder::height;++y)
+			for(unsigned int x=0;x<Kinect::KinectV2DepthDecoder::width;++x)
+				{
+				unsigned int index=y*Kinect::KinectV2DepthDecoder::width+x;
+				float distance=(800.0f+float(x)*3.0f+float(y)*0.7f+float(frameIndex))/(6250.0f/3.0f*2.0f);
+				float amplitude=float(200+rand()%800);
+				for(int exposure=0;exposure<3;++exposure)
+					{
+					float phase=twoPi*frequencies[exposure]*distance-twoPi*float(p0Tables[exposure*numPixels+index])/65536.0f;
+					for(int i=0;i<3;++i)
+						frame.images[exposure*3+i][index]=IRPixel(amplitude*Math::cos(phase+twoPi*float(i)/3.0f));
+					}
+				}
+		frames.push_back(frame);
+		}
+	
+	delete[] p0Tables;
+	}
+
+void runBenchmark(const char* fileName,unsigned int numThreads,unsigned int maxNumFrames,unsigned int numPasses)
+	{
+	Kinect::KinectV2DepthDecoder decoder(numThreads);
+	
+	/* Load or synthesize the raw frames: */
+	std::vector<RawFrame> frames;
+	if(fileName!=0)
+		readRawFrames(fileName,decoder,frames,maxNumFrames);
+	else
+		synthesizeRawFrames(decoder,frames,maxNumFrames);
+	if(frames.empty())
+		throw std::runtime_error("No complete raw depth frames");
+	
+	/* Reconstruct all frames several times: */
+	Kinect::FrameBuffer depthFrame(Kinect::KinectV2DepthDecoder::width,Kinect::KinectV2DepthDecoder::height,numPixels*sizeof(Kinect::FrameSource::DepthPixel));
+	double phaseTime=0.0;
+	double depthTime=0.0;
+	unsigned int numValidPixels=0;
+	for(unsigned int pass=0;pass<numPasses;++pass)
+		for(std::vector<RawFrame>::iterator fIt=frames.begin();fIt!=frames.end();++fIt)
+			{
+			Misc::Timer phaseTimer;
+			for(unsigned int exposure=0;exposure<3;++exposure)
+				decoder.calcPhaseImage(exposure,fIt->images+exposure*3);
+			phaseTimer.elapse();
+			phaseTime+=phaseTimer.getTime();
+			
+			Misc::Timer depthTimer;
+			decoder.calcDepthImage(depthFrame.getData<Kinect::FrameSource::DepthPixel>());
+			depthTimer.elapse();
+			depthTime+=depthTimer.getTime();
+			
+			const Kinect::FrameSource::DepthPixel* dPtr=depthFrame.getData<Kinect::FrameSource::DepthPixel>();
+			for(unsigned int i=0;i<numPixels;++i,++dPtr)
+				if(*dPtr!=Kinect::FrameSource::invalidDepth)
+					++numValidPixels;
+			}
+	
+	/* Print the results: */
+	unsigned int numDecodedFrames=numPasses*frames.size();
+	std::cout<<"Decoded "<<numDecodedFrames<<" depth frames using "<<decoder.getNumThreads()<<" thread(s)"<<std::endl;
+	std::cout<<"Phase calculation: "<<phaseTime*1000.0/double(numDecodedFrames)<<" ms per frame"<<std::endl;
+	std::cout<<"Depth reconstruction: "<<depthTime*1000.0/double(numDecodedFrames)<<" ms per frame"<<std::endl;
+	std::cout<<"Frame rate: "<<double(numDecodedFrames)/(phaseTime+depthTime)<<" Hz"<<std::endl;
+	std::cout<<"Valid pixels: "<<double(numValidPixels)/double(numDecodedFrames)<<" per frame"<<std::endl;
+	
+	/* Clean up: */
+	for(std::vector<RawFrame>::iterator fIt=frames.begin();fIt!=frames.end();++fIt)
+		delete[] fIt->images[0];
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	bool capture=false;
+	const char* fileName=0;
+	unsigned int numFrames=30;
+	unsigned int numThreads=1;
+	unsigned int numPasses=10;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"capture")==0)
+				capture=true;
+			else if(strcasecmp(argv[i]+1,"frames")==0)
+				{
+				++i;
+				numFrames=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"threads")==0)
+				{
+				++i;
+				numThreads=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"passes")==0)
+				{
+				++i;
+				numPasses=atoi(argv[i]);
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else if(fileName==0)
+			fileName=argv[i];
+		}
+	if(capture&&fileName==0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" -capture [-frames <num frames>] <raw IR file name>"<<std::endl;
+		std::cerr<<"       "<<argv[0]<<" [-threads <num threads>] [-frames <max num frames>] [-passes <num passes>] [<raw IR file name>]"<<std::endl;
+		return 1;
+		}
+	
+	try
+		{
+		if(capture)
+			captureRawFrames(fileName,numFrames);
+		else
+			runBenchmark(fileName,numThreads,numFrames,numPasses);
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cerr<<"KinectV2DepthBenchmark: "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
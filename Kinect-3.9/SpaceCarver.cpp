@@ -1,7 +1,7 @@
 /***********************************************************************
 SpaceCarver - Utility to convert a set of colocated Kinect facades into
 a watertight mesh using a space carving approach.
-Copyright (c) 2011-2018 Oliver Kreylos
+Copyright (c) 2011-2020 Oliver Kreylos
 
 This file is part of the Kinect 3D Video Capture Project (Kinect).
 
@@ -21,11 +21,17 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 02111-1307 USA
 ***********************************************************************/
 
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <vector>
 #include <stdexcept>
 #include <iostream>
 #include <Misc/Array.h>
+#include <Misc/Timer.h>
+#include <Threads/Atomic.h>
+#include <Threads/Thread.h>
 #include <IO/File.h>
 #include <IO/OpenFile.h>
 #include <Geometry/ComponentArray.h>
@@ -45,6 +51,7 @@ typedef Geometry::ProjectiveTransformation<double,3> Projection;
 typedef unsigned char Voxel;
 typedef Misc::Array<Voxel,3> Grid;
 typedef Grid::Index Index;
+typedef Kinect::FrameBuffer FrameBuffer;
 
 FrameBuffer open(const FrameBuffer& frame)
 	{
@@ -56,8 +63,8 @@ FrameBuffer open(const FrameBuffer& frame)
 	for(int dy=-1;dy<=1;++dy)
 		for(int dx=-1;dx<=1;++dx,++noffPtr)
 			*noffPtr=dy*stride+dx;
-	const unsigned short* fPtr=frame.getTypedBuffer<unsigned short>();
-	unsigned short* rPtr=result.getTypedBuffer<unsigned short>();
+	const unsigned short* fPtr=frame.getData<unsigned short>();
+	unsigned short* rPtr=result.getData<unsigned short>();
 	for(int x=0;x<frame.getSize(0);++x,++fPtr,++rPtr)
 		*rPtr=*fPtr;
 	for(int y=1;y<frame.getSize(1)-1;++y)
@@ -105,8 +112,8 @@ FrameBuffer close(const FrameBuffer& frame)
 	for(int dy=-1;dy<=1;++dy)
 		for(int dx=-1;dx<=1;++dx,++noffPtr)
 			*noffPtr=dy*stride+dx;
-	const unsigned short* fPtr=frame.getTypedBuffer<unsigned short>();
-	unsigned short* rPtr=result.getTypedBuffer<unsigned short>();
+	const unsigned short* fPtr=frame.getData<unsigned short>();
+	unsigned short* rPtr=result.getData<unsigned short>();
 	for(int x=0;x<frame.getSize(0);++x,++fPtr,++rPtr)
 		*rPtr=*fPtr;
 	for(int y=1;y<frame.getSize(1)-1;++y)
@@ -134,26 +141,507 @@ FrameBuffer close(const FrameBuffer& frame)
 	return result;
 	}
 
+unsigned int getDefaultNumThreads(void)
+	{
+	/* Use all of the host's CPUs: */
+	long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+	return numCpus>=1?(unsigned int)(numCpus):1U;
+	}
+
+struct GridLayout // Structure describing the position and resolution of a volumetric grid
+	{
+	/* Elements: */
+	public:
+	Box box; // Bounding box of the grid in world space
+	Index size; // Number of voxels along each grid axis
+	std::vector<double> centers[3]; // World-space coordinates of voxel centers along each grid axis
+	
+	/* Constructors and destructors: */
+	GridLayout(const Box& sBox,const Index& sSize)
+		:box(sBox),size(sSize)
+		{
+		/* Calculate the voxel center coordinates once, so that all grid representations carve the exact same grid points: */
+		for(int i=0;i<3;++i)
+			{
+			double cellSize=(box.max[i]-box.min[i])/double(size[i]);
+			centers[i].reserve(size[i]);
+			double center=box.min[i]+0.5*cellSize;
+			for(int j=0;j<size[i];++j,center+=cellSize)
+				centers[i].push_back(center);
+			}
+		}
+	
+	/* Methods: */
+	Point getCenter(const Index& index) const // Returns the center of the voxel of the given index
+		{
+		return Point(centers[0][index[0]],centers[1][index[1]],centers[2][index[2]]);
+		}
+	};
+
+struct Facade // Structure representing a hole-filled depth frame to be carved out of a grid
+	{
+	/* Elements: */
+	public:
+	Projection proj; // Projective transformation from world space into depth image space
+	FrameBuffer frame; // The depth frame
+	double fmax[2]; // Size of the depth frame as floating-point numbers
+	
+	/* Methods: */
+	bool carves(const Point& gridp) const // Returns true if the given grid point is outside the facade
+		{
+		/* Project the grid point into the depth frame: */
+		Point fp=proj.transform(gridp);
+		
+		/* Check if the projected grid point is inside the depth frame: */
+		if(fp[0]>=0.0&&fp[0]<fmax[0]&&fp[1]>=0.0&&fp[1]<fmax[1])
+			{
+			/* Check if the grid point is outside the facade: */
+			int x=int(fp[0]);
+			int y=int(fp[1]);
+			return fp[2]<double(frame.getData<unsigned short>()[y*frame.getSize(0)+x]);
+			}
+		else
+			return true;
+		}
+	};
+
+class DenseGrid // Class representing a volumetric grid as a dense array of voxels
+	{
+	/* Elements: */
+	private:
+	const GridLayout& layout; // Layout of the grid
+	Grid grid; // Array of voxels
+	
+	/* Constructors and destructors: */
+	public:
+	DenseGrid(const GridLayout& sLayout)
+		:layout(sLayout),grid(layout.size)
+		{
+		/* Initialize the grid: */
+		for(Grid::iterator gIt=grid.begin();gIt!=grid.end();++gIt)
+			*gIt=Voxel(255);
+		}
+	
+	/* Methods: */
+	unsigned int getNumWorkItems(void) const // Returns the number of independent work items into which carving is divided
+		{
+		return layout.size[0];
+		}
+	void carve(const Facade& facade,unsigned int firstItem,unsigned int lastItem) // Carves the given facade out of the given range of grid slices
+		{
+		Index index;
+		for(index[0]=int(firstItem);index[0]<int(lastItem);++index[0])
+			for(index[1]=0;index[1]<layout.size[1];++index[1])
+				for(index[2]=0;index[2]<layout.size[2];++index[2])
+					if(facade.carves(layout.getCenter(index)))
+						grid(index)=Voxel(0);
+		}
+	size_t getMemorySize(void) const // Returns the amount of memory used by the grid in bytes
+		{
+		return size_t(grid.getNumElements())*sizeof(Voxel);
+		}
+	void getRow(int i0,int i1,Voxel* row) const // Copies the row of voxels of the given indices along the grid's last axis into the given buffer
+		{
+		memcpy(row,&grid(Index(i0,i1,0)),size_t(layout.size[2])*sizeof(Voxel));
+		}
+	};
+
+class SparseGrid // Class representing a volumetric grid as an array of bricks of voxels, where bricks of uniform value are not stored
+	{
+	/* Embedded classes: */
+	public:
+	static const int brickSize=16; // Number of voxels along each brick edge
+	
+	private:
+	enum BrickState // Enumerated type for brick states
+		{
+		SOLID, // All voxels in the brick are solid
+		EMPTY, // All voxels in the brick have been carved away
+		MIXED // The brick contains solid and carved voxels
+		};
+	
+	struct Brick // Structure representing a brick of voxels
+		{
+		/* Elements: */
+		public:
+		BrickState state; // Current state of the brick
+		Voxel* voxels; // Array of brickSize^3 voxels if the brick is mixed; null otherwise
+		};
+	
+	/* Elements: */
+	const GridLayout& layout; // Layout of the grid
+	Index numBricks; // Number of bricks along each grid axis
+	Brick* bricks; // Array of bricks, in the same order as voxels in a dense grid
+	
+	/* Private methods: */
+	void carveVoxels(Brick& brick,const Index& base,const Index& end,const Facade& facade); // Carves the given facade out of the given brick voxel by voxel
+	
+	/* Constructors and destructors: */
+	public:
+	SparseGrid(const GridLayout& sLayout);
+	~SparseGrid(void);
+	
+	/* Methods: */
+	unsigned int getNumWorkItems(void) const // Returns the number of independent work items into which carving is divided
+		{
+		return numBricks[0]*numBricks[1]*numBricks[2];
+		}
+	void carve(const Facade& facade,unsigned int firstItem,unsigned int lastItem); // Carves the given facade out of the given range of bricks
+	size_t getNumMixedBricks(void) const; // Returns the number of bricks that store voxels
+	size_t getMemorySize(void) const; // Returns the amount of memory used by the grid in bytes
+	void getRow(int i0,int i1,Voxel* row) const; // Copies the row of voxels of the given indices along the grid's last axis into the given buffer
+	};
+
+void SparseGrid::carveVoxels(SparseGrid::Brick& brick,const Index& base,const Index& end,const Facade& facade)
+	{
+	/* Expand a solid brick into an array of solid voxels: */
+	if(brick.state==SOLID)
+		{
+		brick.voxels=new Voxel[brickSize*brickSize*brickSize];
+		memset(brick.voxels,255,brickSize*brickSize*brickSize*sizeof(Voxel));
+		brick.state=MIXED;
+		}
+	
+	/* Carve all voxels that have not been carved yet: */
+	bool haveSolid=false;
+	Index index;
+	for(index[0]=base[0];index[0]<end[0];++index[0])
+		for(index[1]=base[1];index[1]<end[1];++index[1])
+			{
+			Voxel* vPtr=brick.voxels+((index[0]-base[0])*brickSize+(index[1]-base[1]))*brickSize;
+			for(index[2]=base[2];index[2]<end[2];++index[2],++vPtr)
+				if(*vPtr!=Voxel(0))
+					{
+					if(facade.carves(layout.getCenter(index)))
+						*vPtr=Voxel(0);
+					else
+						haveSolid=true;
+					}
+			}
+	
+	/* Release the brick's voxels if all of them have been carved away: */
+	if(!haveSolid)
+		{
+		delete[] brick.voxels;
+		brick.voxels=0;
+		brick.state=EMPTY;
+		}
+	}
+
+SparseGrid::SparseGrid(const GridLayout& sLayout)
+	:layout(sLayout),
+	 bricks(0)
+	{
+	/* Initialize the grid with solid bricks: */
+	for(int i=0;i<3;++i)
+		numBricks[i]=(layout.size[i]+brickSize-1)/brickSize;
+	size_t totalNumBricks=size_t(numBricks[0])*size_t(numBricks[1])*size_t(numBricks[2]);
+	bricks=new Brick[totalNumBricks];
+	for(size_t i=0;i<totalNumBricks;++i)
+		{
+		bricks[i].state=SOLID;
+		bricks[i].voxels=0;
+		}
+	}
+
+SparseGrid::~SparseGrid(void)
+	{
+	size_t totalNumBricks=size_t(numBricks[0])*size_t(numBricks[1])*size_t(numBricks[2]);
+	for(size_t i=0;i<totalNumBricks;++i)
+		delete[] bricks[i].voxels;
+	delete[] bricks;
+	}
+
+void SparseGrid::carve(const Facade& facade,unsigned int firstItem,unsigned int lastItem)
+	{
+	/* Tolerance to make brick classification conservative in the face of rounding errors: */
+	const double eps=1.0e-6;
+	
+	const unsigned short* frameBuffer=facade.frame.getData<unsigned short>();
+	int frameWidth=facade.frame.getSize(0);
+	for(unsigned int brickIndex=firstItem;brickIndex<lastItem;++brickIndex)
+		{
+		/* Skip bricks that have already been carved away completely: */
+		Brick& brick=bricks[brickIndex];
+		if(brick.state==EMPTY)
+			continue;
+		
+		/* Calculate the index range of the brick's voxels: */
+		Index base,end;
+		base[0]=(brickIndex/(numBricks[1]*numBricks[2]))*brickSize;
+		base[1]=((brickIndex/numBricks[2])%numBricks[1])*brickSize;
+		base[2]=(brickIndex%numBricks[2])*brickSize;
+		for(int i=0;i<3;++i)
+			end[i]=base[i]+brickSize<=layout.size[i]?base[i]+brickSize:layout.size[i];
+		
+		/* Calculate the brick's frustum in depth image space by projecting the corners of the box containing its voxel centers: */
+		bool inFront=true;
+		Point fmin,fmax;
+		for(int corner=0;corner<8&&inFront;++corner)
+			{
+			Index cornerIndex;
+			for(int i=0;i<3;++i)
+				cornerIndex[i]=(corner&(0x1<<i))?end[i]-1:base[i];
+			Projection::HVector hfp=facade.proj.transform(Projection::HVector(layout.getCenter(cornerIndex)));
+			if(hfp[3]>0.0)
+				{
+				Point fp=hfp.toPoint();
+				for(int i=0;i<3;++i)
+					{
+					if(corner==0||fmin[i]>fp[i])
+						fmin[i]=fp[i];
+					if(corner==0||fmax[i]<fp[i])
+						fmax[i]=fp[i];
+					}
+				}
+			else
+				inFront=false;
+			}
+		
+		/* Try classifying the entire brick if it is in front of the depth camera: */
+		if(inFront)
+			{
+			/* Carve the entire brick if its frustum is completely outside the depth frame: */
+			if(fmax[0]<-eps||fmin[0]>=facade.fmax[0]+eps||fmax[1]<-eps||fmin[1]>=facade.fmax[1]+eps)
+				{
+				delete[] brick.voxels;
+				brick.voxels=0;
+				brick.state=EMPTY;
+				continue;
+				}
+			
+			/* Check if the brick's frustum is completely inside the depth frame: */
+			if(fmin[0]>=eps&&fmax[0]<facade.fmax[0]-eps&&fmin[1]>=eps&&fmax[1]<facade.fmax[1]-eps)
+				{
+				/* Calculate the range of facade depths inside the brick's frustum: */
+				int x0=int(fmin[0]-eps);
+				int x1=int(fmax[0]+eps);
+				int y0=int(fmin[1]-eps);
+				int y1=int(fmax[1]+eps);
+				unsigned short dmin=0xffffU;
+				unsigned short dmax=0x0000U;
+				for(int y=y0;y<=y1;++y)
+					{
+					const unsigned short* fPtr=frameBuffer+y*frameWidth+x0;
+					for(int x=x0;x<=x1;++x,++fPtr)
+						{
+						if(dmin>*fPtr)
+							dmin=*fPtr;
+						if(dmax<*fPtr)
+							dmax=*fPtr;
+						}
+					}
+				
+				/* Carve the entire brick if it is completely in front of the facade: */
+				if(fmax[2]<double(dmin)-eps)
+					{
+					delete[] brick.voxels;
+					brick.voxels=0;
+					brick.state=EMPTY;
+					continue;
+					}
+				
+				/* Leave the brick alone if it is completely behind the facade: */
+				if(fmin[2]>=double(dmax)+eps)
+					continue;
+				}
+			}
+		
+		/* Carve the brick voxel by voxel: */
+		carveVoxels(brick,base,end,facade);
+		}
+	}
+
+size_t SparseGrid::getNumMixedBricks(void) const
+	{
+	size_t result=0;
+	size_t totalNumBricks=size_t(numBricks[0])*size_t(numBricks[1])*size_t(numBricks[2]);
+	for(size_t i=0;i<totalNumBricks;++i)
+		if(bricks[i].state==MIXED)
+			++result;
+	return result;
+	}
+
+size_t SparseGrid::getMemorySize(void) const
+	{
+	size_t totalNumBricks=size_t(numBricks[0])*size_t(numBricks[1])*size_t(numBricks[2]);
+	return totalNumBricks*sizeof(Brick)+getNumMixedBricks()*brickSize*brickSize*brickSize*sizeof(Voxel);
+	}
+
+void SparseGrid::getRow(int i0,int i1,Voxel* row) const
+	{
+	/* Assemble the row from all bricks it passes through: */
+	const Brick* bPtr=bricks+((i0/brickSize)*numBricks[1]+i1/brickSize)*numBricks[2];
+	size_t voxelOffset=((i0%brickSize)*brickSize+(i1%brickSize))*brickSize;
+	for(int i2=0;i2<layout.size[2];i2+=brickSize,++bPtr)
+		{
+		size_t rowLength=i2+brickSize<=layout.size[2]?brickSize:layout.size[2]-i2;
+		switch(bPtr->state)
+			{
+			case SOLID:
+				memset(row+i2,255,rowLength*sizeof(Voxel));
+				break;
+			
+			case EMPTY:
+				memset(row+i2,0,rowLength*sizeof(Voxel));
+				break;
+			
+			case MIXED:
+				memcpy(row+i2,bPtr->voxels+voxelOffset,rowLength*sizeof(Voxel));
+				break;
+			}
+		}
+	}
+
+template <class GridParam>
+class ParallelCarver // Helper class to carve a facade out of a grid using multiple threads
+	{
+	/* Elements: */
+	private:
+	GridParam& grid; // The grid to be carved
+	const Facade& facade; // The facade to carve
+	unsigned int numItems; // Total number of work items
+	unsigned int chunkSize; // Number of work items a thread processes at once
+	Threads::Atomic<unsigned int> nextItem; // Index of the next unprocessed work item
+	
+	/* Private methods: */
+	void* carvingThreadMethod(void) // Thread method processing chunks of work items until all are done
+		{
+		while(true)
+			{
+			/* Grab the next chunk of work items: */
+			unsigned int firstItem=nextItem.postAdd(chunkSize);
+			if(firstItem>=numItems)
+				break;
+			unsigned int lastItem=firstItem+chunkSize<=numItems?firstItem+chunkSize:numItems;
+			
+			/* Carve the facade out of the work items: */
+			grid.carve(facade,firstItem,lastItem);
+			}
+		
+		return 0;
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	ParallelCarver(GridParam& sGrid,const Facade& sFacade,unsigned int sChunkSize)
+		:grid(sGrid),facade(sFacade),
+		 numItems(grid.getNumWorkItems()),chunkSize(sChunkSize),
+		 nextItem(0)
+		{
+		}
+	
+	/* Methods: */
+	void carve(unsigned int numThreads) // Carves the facade using the given number of threads
+		{
+		/* Start additional carving threads and help out in the calling thread: */
+		Threads::Thread* threads=new Threads::Thread[numThreads-1];
+		for(unsigned int i=0;i<numThreads-1;++i)
+			threads[i].start(this,&ParallelCarver::carvingThreadMethod);
+		carvingThreadMethod();
+		for(unsigned int i=0;i<numThreads-1;++i)
+			threads[i].join();
+		delete[] threads;
+		}
+	};
+
+template <class GridParam>
+void carveFacades(GridParam& grid,const std::vector<Facade>& facades,unsigned int chunkSize,unsigned int numThreads) // Carves all given facades out of the given grid
+	{
+	for(std::vector<Facade>::const_iterator fIt=facades.begin();fIt!=facades.end();++fIt)
+		{
+		Misc::Timer timer;
+		ParallelCarver<GridParam> carver(grid,*fIt,chunkSize);
+		carver.carve(numThreads);
+		timer.elapse();
+		std::cout<<"\tCarved facade "<<fIt-facades.begin()<<" in "<<timer.getTime()*1000.0<<" ms"<<std::endl;
+		}
+	}
+
+template <class GridParam>
+void writeGrid(const GridParam& grid,const GridLayout& layout,IO::File& volFile) // Writes the given grid to a volume file
+	{
+	volFile.setEndianness(Misc::BigEndian);
+	for(int i=0;i<3;++i)
+		volFile.write<int>(int(layout.size[i]));
+	volFile.write<int>(0);
+	for(int i=0;i<3;++i)
+		volFile.write<float>((layout.box.max[i]-layout.box.min[i])*double(layout.size[i]-1)/double(layout.size[i]));
+	std::vector<Voxel> row(layout.size[2]);
+	for(int i0=0;i0<layout.size[0];++i0)
+		for(int i1=0;i1<layout.size[1];++i1)
+			{
+			grid.getRow(i0,i1,&row[0]);
+			volFile.write<Voxel>(&row[0],row.size());
+			}
+	}
+
 int main(int argc,char* argv[])
 	{
-	/* Set up the volumetric grid: */
-	Box gridBox=Box(Point(-32.0,-64.0,16.0),Point(32.0,0.0,80.0));
-	Index gridSize(256,256,256);
-	Grid grid(gridSize);
+	/* Parse the command line: */
+	int gridSize=256;
+	bool carveDense=false;
+	bool carveSparse=true;
+	unsigned int numThreads=getDefaultNumThreads();
+	int facadeIndex=-1;
+	std::vector<const char*> depthFileNames;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"size")==0)
+				{
+				++i;
+				gridSize=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"dense")==0)
+				{
+				carveDense=true;
+				carveSparse=false;
+				}
+			else if(strcasecmp(argv[i]+1,"sparse")==0)
+				{
+				carveDense=false;
+				carveSparse=true;
+				}
+			else if(strcasecmp(argv[i]+1,"compare")==0)
+				{
+				carveDense=true;
+				carveSparse=true;
+				}
+			else if(strcasecmp(argv[i]+1,"threads")==0)
+				{
+				++i;
+				numThreads=atoi(argv[i]);
+				if(numThreads<1)
+					numThreads=1;
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else if(facadeIndex<0)
+			facadeIndex=atoi(argv[i]);
+		else
+			depthFileNames.push_back(argv[i]);
+		}
+	if(facadeIndex<0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-size <grid size>] [-dense | -sparse | -compare] [-threads <num threads>] <facade index> <depth file 1> ... <depth file n>"<<std::endl;
+		return 1;
+		}
 	
-	/* Initialize the grid: */
-	for(Grid::iterator gIt=grid.begin();gIt!=grid.end();++gIt)
-		*gIt=Voxel(255);
+	/* Set up the volumetric grid: */
+	GridLayout layout(Box(Point(-32.0,-64.0,16.0),Point(32.0,0.0,80.0)),Index(gridSize,gridSize,gridSize));
 	
-	/* Carve away the n-th facade from each depth stream file listed on the command line: */
-	unsigned int facadeIndex=atoi(argv[1]);
-	for(int depthFileIndex=2;depthFileIndex<argc;++depthFileIndex)
+	/* Read the n-th facade from each depth stream file listed on the command line: */
+	std::vector<Facade> facades;
+	for(std::vector<const char*>::iterator dfnIt=depthFileNames.begin();dfnIt!=depthFileNames.end();++dfnIt)
 		{
 		try
 			{
 			/* Open the depth file: */
-			IO::AutoFile depthFile(IO::openFile(argv[depthFileIndex]));
-			depthFile->setEndianness(IO::File::LittleEndian);
+			IO::FilePtr depthFile(IO::openFile(*dfnIt));
+			depthFile->setEndianness(Misc::LittleEndian);
 			
 			/* Read the facade projection matrix and the projector transformation: */
 			Projection depthTransform;
@@ -161,14 +649,15 @@ int main(int argc,char* argv[])
 			OGTransform projectorTransform=Misc::Marshaller<OGTransform>::read(*depthFile);
 			
 			/* Calculate the joint projective transformation from 3D world space into depth image space: */
-			Projection proj=Geometry::invert(Projection(projectorTransform)*depthTransform);
+			Facade facade;
+			facade.proj=Geometry::invert(Projection(projectorTransform)*depthTransform);
 			
 			/* Create a depth frame reader: */
-			DepthFrameReader depthFrameReader(*depthFile);
+			Kinect::DepthFrameReader depthFrameReader(*depthFile);
 			
 			/* Read the n-th facade: */
 			FrameBuffer frame;
-			for(unsigned int i=0;i<facadeIndex;++i)
+			for(int i=0;i<facadeIndex;++i)
 				frame=depthFrameReader.readNextFrame();
 			
 			/* Run a sequence of morphological open and close operators on the frame to fill holes: */
@@ -181,66 +670,77 @@ int main(int argc,char* argv[])
 				frame=close(frame);
 			#endif
 			
-			/* Carve the facade out of the grid: */
-			std::cout<<"Processing depth file "<<argv[depthFileIndex]<<std::flush;
-			double fmax[2];
+			facade.frame=frame;
 			for(int i=0;i<2;++i)
-				fmax[i]=double(frame.getSize(i));
-			unsigned short* frameBuffer=frame.getTypedBuffer<unsigned short>();
-			Size cellSize;
-			for(int i=0;i<3;++i)
-				cellSize[i]=(gridBox.max[i]-gridBox.min[i])/double(gridSize[i]);
-			Index index;
-			Point gridp;
-			gridp[0]=gridBox.min[0]+0.5*cellSize[0];
-			for(index[0]=0;index[0]<gridSize[0];++index[0],gridp[0]+=cellSize[0])
-				{
-				gridp[1]=gridBox.min[1]+0.5*cellSize[1];
-				for(index[1]=0;index[1]<gridSize[1];++index[1],gridp[1]+=cellSize[1])
-					{
-					gridp[2]=gridBox.min[2]+0.5*cellSize[2];
-					for(index[2]=0;index[2]<gridSize[2];++index[2],gridp[2]+=cellSize[2])
-						{
-						/* Project the grid point into the depth frame: */
-						Point fp=proj.transform(gridp);
-						
-						/* Check if the projected grid point is inside the depth frame: */
-						if(fp[0]>=0.0&&fp[0]<fmax[0]&&fp[1]>=0.0&&fp[1]<fmax[1])
-							{
-							/* Check if the grid point is outside the facade: */
-							int x=int(fp[0]);
-							int y=int(fp[1]);
-							unsigned short depth=frameBuffer[y*frame.getSize(0)+x];
-							if(fp[2]<double(depth))
-								grid(index)=Voxel(0);
-							}
-						else
-							grid(index)=Voxel(0);
-						}
-					}
-				std::cout<<'.'<<std::flush;
-				}
-			std::cout<<"done"<<std::endl;
+				facade.fmax[i]=double(frame.getSize(i));
+			facades.push_back(facade);
+			std::cout<<"Read facade "<<facades.size()-1<<" from depth file "<<*dfnIt<<std::endl;
 			}
 		catch(const std::runtime_error& err)
 			{
-			std::cerr<<"Ignoring depth file "<<argv[depthFileIndex]<<" due to exception "<<err.what()<<std::endl;
+			std::cerr<<"Ignoring depth file "<<*dfnIt<<" due to exception "<<err.what()<<std::endl;
 			}
 		catch(...)
 			{
-			std::cerr<<"Ignoring depth file "<<argv[depthFileIndex]<<" due to spurious exception"<<std::endl;
+			std::cerr<<"Ignoring depth file "<<*dfnIt<<" due to spurious exception"<<std::endl;
 			}
 		}
 	
+	/* Carve the facades out of a dense grid: */
+	DenseGrid* denseGrid=0;
+	double denseTime=0.0;
+	if(carveDense)
+		{
+		std::cout<<"Carving "<<facades.size()<<" facades out of a dense "<<gridSize<<"^3 grid using "<<numThreads<<" threads"<<std::endl;
+		Misc::Timer timer;
+		denseGrid=new DenseGrid(layout);
+		carveFacades(*denseGrid,facades,1,numThreads);
+		timer.elapse();
+		denseTime=timer.getTime();
+		std::cout<<"Dense grid: "<<denseTime*1000.0<<" ms, "<<denseGrid->getMemorySize()/1024<<" KB"<<std::endl;
+		}
+	
+	/* Carve the facades out of a sparse grid: */
+	SparseGrid* sparseGrid=0;
+	double sparseTime=0.0;
+	if(carveSparse)
+		{
+		std::cout<<"Carving "<<facades.size()<<" facades out of a sparse "<<gridSize<<"^3 grid using "<<numThreads<<" threads"<<std::endl;
+		Misc::Timer timer;
+		sparseGrid=new SparseGrid(layout);
+		carveFacades(*sparseGrid,facades,(gridSize+SparseGrid::brickSize-1)/SparseGrid::brickSize,numThreads);
+		timer.elapse();
+		sparseTime=timer.getTime();
+		std::cout<<"Sparse grid: "<<sparseTime*1000.0<<" ms, "<<sparseGrid->getMemorySize()/1024<<" KB in "<<sparseGrid->getNumMixedBricks()<<" mixed bricks"<<std::endl;
+		}
+	
+	if(denseGrid!=0&&sparseGrid!=0)
+		{
+		/* Compare the two grids: */
+		size_t numMismatches=0;
+		std::vector<Voxel> denseRow(gridSize);
+		std::vector<Voxel> sparseRow(gridSize);
+		for(int i0=0;i0<gridSize;++i0)
+			for(int i1=0;i1<gridSize;++i1)
+				{
+				denseGrid->getRow(i0,i1,&denseRow[0]);
+				sparseGrid->getRow(i0,i1,&sparseRow[0]);
+				for(int i2=0;i2<gridSize;++i2)
+					if(denseRow[i2]!=sparseRow[i2])
+						++numMismatches;
+				}
+		std::cout<<"Sparse carving is "<<denseTime/sparseTime<<" times faster than dense carving; "<<numMismatches<<" voxels differ"<<std::endl;
+		}
+	
 	/* Save the result grid to a volume file: */
-	IO::AutoFile volFile(IO::openFile("SpaceCarverOut.vol",IO::File::WriteOnly));
-	volFile->setEndianness(IO::File::BigEndian);
-	for(int i=0;i<3;++i)
-		volFile->write<int>(int(gridSize[i]));
-	volFile->write<int>(0);
-	for(int i=0;i<3;++i)
-		volFile->write<float>((gridBox.max[i]-gridBox.min[i])*double(gridSize[i]-1)/double(gridSize[i]));
-	volFile->write<Voxel>(grid.getArray(),grid.getNumElements());
+	IO::FilePtr volFile(IO::openFile("SpaceCarverOut.vol",IO::File::WriteOnly));
+	if(sparseGrid!=0)
+		writeGrid(*sparseGrid,layout,*volFile);
+	else
+		writeGrid(*denseGrid,layout,*volFile);
+	
+	delete denseGrid;
+	delete sparseGrid;
 	
 	return 0;
 	}
@@ -1,7 +1,7 @@
 /***********************************************************************
 BathymetrySaverTool - Tool to save the current bathymetry grid of an
 augmented reality sandbox to a file or network socket.
-Copyright (c) 2016-2019 Oliver Kreylos
+Copyright (c) 2016-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -22,8 +22,13 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "BathymetrySaverTool.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <stdexcept>
 #include <iomanip>
+#include <algorithm>
+#include <Misc/SizedTypes.h>
 #include <Misc/PrintInteger.h>
 #include <Misc/ThrowStdErr.h>
 #include <Misc/MessageLogger.h>
@@ -32,8 +37,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <IO/ValueSource.h>
 #include <IO/OpenFile.h>
 #include <IO/OStream.h>
+#include <IO/GzipFilter.h>
 #include <Comm/TCPPipe.h>
 #include <Math/Math.h>
+#include <Vrui/Vrui.h>
 
 #include "WaterTable2.h"
 #include "Sandbox.h"
@@ -46,7 +53,10 @@ BathymetrySaverToolFactory::Configuration::Configuration(void)
 	:saveFileName("BathymetrySaverTool.dem"),
 	 postUpdate(false),postUpdatePort(80),postUpdatePage(""),
 	 postUpdateMessage("app.GenerateTileCache();"),
-	 gridScale(1.0)
+	 gridScale(1.0),
+	 captureMode(false),captureFileName("BathymetrySaverTool.bdz"),
+	 captureInterval(1.0),captureThreshold(0.05f),captureKeyframeInterval(60),
+	 captureMaxFileSize(256)
 	{
 	}
 
@@ -59,6 +69,12 @@ void BathymetrySaverToolFactory::Configuration::read(const Misc::ConfigurationFi
 	postUpdatePage=cfs.retrieveString("./postUpdatePage",postUpdatePage);
 	postUpdateMessage=cfs.retrieveString("./postUpdateMessage",postUpdateMessage);
 	gridScale=cfs.retrieveValue<double>("./gridScale",gridScale);
+	captureMode=cfs.retrieveValue<bool>("./captureMode",captureMode);
+	captureFileName=cfs.retrieveString("./captureFileName",captureFileName);
+	captureInterval=cfs.retrieveValue<double>("./captureInterval",captureInterval);
+	captureThreshold=cfs.retrieveValue<GLfloat>("./captureThreshold",captureThreshold);
+	captureKeyframeInterval=cfs.retrieveValue<unsigned int>("./captureKeyframeInterval",captureKeyframeInterval);
+	captureMaxFileSize=cfs.retrieveValue<unsigned int>("./captureMaxFileSize",captureMaxFileSize);
 	}
 
 void BathymetrySaverToolFactory::Configuration::write(Misc::ConfigurationFileSection& cfs) const
@@ -70,6 +86,12 @@ void BathymetrySaverToolFactory::Configuration::write(Misc::ConfigurationFileSec
 	cfs.storeString("./postUpdatePage",postUpdatePage);
 	cfs.storeString("./postUpdateMessage",postUpdateMessage);
 	cfs.storeValue<double>("./gridScale",gridScale);
+	cfs.storeValue<bool>("./captureMode",captureMode);
+	cfs.storeString("./captureFileName",captureFileName);
+	cfs.storeValue<double>("./captureInterval",captureInterval);
+	cfs.storeValue<GLfloat>("./captureThreshold",captureThreshold);
+	cfs.storeValue<unsigned int>("./captureKeyframeInterval",captureKeyframeInterval);
+	cfs.storeValue<unsigned int>("./captureMaxFileSize",captureMaxFileSize);
 	}
 
 /*******************************************
@@ -207,7 +229,7 @@ std::ostream& printFloat8(std::ostream& os,double value)
 
 }
 
-void BathymetrySaverTool::writeDEMFile(void) const
+void BathymetrySaverTool::writeDEMFile(const GLfloat* grid) const
 	{
 	/* Open the output file as a std::ostream: */
 	IO::OStream demFile(IO::openFile(configuration.saveFileName.c_str(),IO::File::WriteOnly));
@@ -257,8 +279,8 @@ void BathymetrySaverTool::writeDEMFile(void) const
 	
 	/* Calculate and write the grid's elevation range: */
 	GLfloat elevMin,elevMax;
-	elevMin=elevMax=bathymetryBuffer[0];
-	const GLfloat* bbPtr=bathymetryBuffer+1;
+	elevMin=elevMax=grid[0];
+	const GLfloat* bbPtr=grid+1;
 	for(GLsizei count=factory->gridSize[1]*factory->gridSize[0]-1;count>0;--count,++bbPtr)
 		{
 		if(elevMin>*bbPtr)
@@ -325,7 +347,7 @@ void BathymetrySaverTool::writeDEMFile(void) const
 		printFloat8(demFile,elevationBase); // Local datum elevation
 		
 		/* Calculate and write the profile's elevation range: */
-		const GLfloat* pPtr=bathymetryBuffer+column;
+		const GLfloat* pPtr=grid+column;
 		GLfloat elevMin,elevMax;
 		elevMin=elevMax=*pPtr;
 		pPtr+=factory->gridSize[0];
@@ -343,7 +365,7 @@ void BathymetrySaverTool::writeDEMFile(void) const
 		fileSize+=6*4+24*5;
 		
 		/* Quantize and write the profile's elevation postings: */
-		pPtr=bathymetryBuffer+column;
+		pPtr=grid+column;
 		for(GLsizei count=factory->gridSize[1];count>0;--count,pPtr+=factory->gridSize[0])
 			{
 			/* Check if there is enough space left in the current 1024-character record: */
@@ -378,10 +400,104 @@ void BathymetrySaverTool::writeDEMFile(void) const
 		demFile<<' ';
 	}
 
-void BathymetrySaverTool::postUpdate(void) const
+void BathymetrySaverTool::writeSnapshot(const GLfloat* grid,double time)
 	{
-	/* Connect to the HTTP server: */
-	Comm::NetPipePtr pipe=new Comm::TCPPipe(configuration.postUpdateHostName.c_str(),configuration.postUpdatePort);
+	size_t numCells=size_t(factory->gridSize[1])*size_t(factory->gridSize[0]);
+	
+	/* Close the capture file if it has grown too large: */
+	if(captureFile!=0&&captureFile->getWritePos()>=IO::SeekableFile::Offset(configuration.captureMaxFileSize)*IO::SeekableFile::Offset(1024*1024))
+		captureFile=0;
+	
+	/* Start a new capture file if there is none: */
+	if(captureFile==0)
+		{
+		/* Move a non-empty capture file left by a rollover, a previous run, or a write error out of the way instead of truncating it: */
+		struct stat captureFileStat;
+		if(stat(configuration.captureFileName.c_str(),&captureFileStat)==0&&captureFileStat.st_size>0)
+			{
+			std::string rolledFileName=configuration.captureFileName;
+			rolledFileName.append(".1");
+			if(rename(configuration.captureFileName.c_str(),rolledFileName.c_str())!=0)
+				Misc::throwStdErr("Unable to roll over capture file %s",configuration.captureFileName.c_str());
+			}
+		
+		captureFile=IO::openSeekableFile(configuration.captureFileName.c_str(),IO::File::WriteOnly);
+		numSnapshots=0;
+		}
+	
+	/* Write a full snapshot at the beginning of each capture file and at regular intervals, and delta snapshots otherwise: */
+	bool keyframe=numSnapshots==0||(configuration.captureKeyframeInterval!=0&&numSnapshots%configuration.captureKeyframeInterval==0);
+	
+	/* Compress each snapshot into its own gzip member, so that the capture file is a valid gzip file after every snapshot: */
+	{
+	IO::GzipFilter snapshot(captureFile);
+	snapshot.setEndianness(Misc::LittleEndian);
+	
+	if(numSnapshots==0)
+		{
+		/* Write the capture file header: */
+		static const char fileTag[16]="SARndboxBDelta1";
+		snapshot.write(fileTag,sizeof(fileTag));
+		for(int i=0;i<2;++i)
+			snapshot.write<Misc::UInt32>(factory->gridSize[i]);
+		for(int i=0;i<2;++i)
+			snapshot.write<Misc::Float32>(factory->cellSize[i]);
+		snapshot.write<Misc::Float64>(configuration.gridScale);
+		}
+	
+	/* Write the snapshot header: */
+	snapshot.write<Misc::Float64>(time);
+	snapshot.write<Misc::UInt32>(keyframe?0:1);
+	
+	if(keyframe)
+		{
+		/* Write the entire grid and use it as the new reference grid: */
+		snapshot.write(grid,numCells);
+		memcpy(referenceBuffer,grid,numCells*sizeof(GLfloat));
+		}
+	else
+		{
+		/* Collect runs of cells that changed by more than the threshold since they were last written: */
+		runs.clear();
+		const GLfloat* gPtr=grid;
+		GLfloat* rPtr=referenceBuffer;
+		for(size_t i=0;i<numCells;++i,++gPtr,++rPtr)
+			if(Math::abs(*gPtr-*rPtr)>configuration.captureThreshold)
+				{
+				/* Extend the current run or start a new one: */
+				if(!runs.empty()&&runs[runs.size()-2]+runs.back()==i)
+					++runs.back();
+				else
+					{
+					runs.push_back(i);
+					runs.push_back(1);
+					}
+				
+				/* Update the reference grid to match what a reader will reconstruct: */
+				*rPtr=*gPtr;
+				}
+		
+		/* Write the changed runs: */
+		snapshot.write<Misc::UInt32>(runs.size()/2);
+		for(std::vector<unsigned int>::iterator rIt=runs.begin();rIt!=runs.end();rIt+=2)
+			{
+			snapshot.write<Misc::UInt32>(rIt[0]);
+			snapshot.write<Misc::UInt32>(rIt[1]);
+			snapshot.write(grid+rIt[0],rIt[1]);
+			}
+		}
+	}
+	
+	/* Push the finished snapshot to the file: */
+	captureFile->flush();
+	++numSnapshots;
+	}
+
+bool BathymetrySaverTool::sendUpdateRequest(void)
+	{
+	/* Use the persistent connection to the HTTP server: */
+	Comm::NetPipePtr pipe=postUpdatePipe;
+	bool keepAlive=true;
 	
 	/* Assemble the PUT request: */
 	std::string request;
@@ -401,6 +517,8 @@ void BathymetrySaverTool::postUpdate(void) const
 	
 	request.append("Accept: */*\r\n");
 	
+	request.append("Connection: keep-alive\r\n");
+	
 	request.append("Content-Length: ");
 	char contentLengthString[6];
 	request.append(Misc::print(configuration.postUpdateMessage.size(),contentLengthString+5));
@@ -477,6 +595,12 @@ void BathymetrySaverTool::postUpdate(void) const
 				replySized=true;
 				replySize=reply.readUnsignedInteger();
 				}
+			else if(option=="Connection")
+				{
+				/* Check if the server is going to close the connection after this reply: */
+				if(reply.readString()=="close")
+					keepAlive=false;
+				}
 			}
 		
 		/* Skip the rest of the line: */
@@ -575,29 +699,147 @@ void BathymetrySaverTool::postUpdate(void) const
 			// buffer[bufSize]='\0';
 			// std::cout<<buffer;
 			}
+		
+		/* The server closed the connection: */
+		keepAlive=false;
 		}
 	// std::cout<<std::endl;
+	
+	return keepAlive;
+	}
+
+void BathymetrySaverTool::postUpdate(void)
+	{
+	if(postUpdatePipe!=0)
+		{
+		/* Try sending the update message over the existing connection: */
+		try
+			{
+			if(!sendUpdateRequest())
+				postUpdatePipe=0;
+			return;
+			}
+		catch(const std::runtime_error&)
+			{
+			/* The server probably closed the idle connection; retry over a fresh one: */
+			postUpdatePipe=0;
+			}
+		}
+	
+	/* Connect to the HTTP server: */
+	postUpdatePipe=new Comm::TCPPipe(configuration.postUpdateHostName.c_str(),configuration.postUpdatePort);
+	try
+		{
+		if(!sendUpdateRequest())
+			postUpdatePipe=0;
+		}
+	catch(...)
+		{
+		/* Drop the broken connection and let the caller handle the error: */
+		postUpdatePipe=0;
+		throw;
+		}
 	}
 
 void BathymetrySaverTool::readBackCallback(GLfloat* bathymetryBuffer,GLfloat* waterLevelBuffer,void* userData)
 	{
 	BathymetrySaverTool* thisPtr=static_cast<BathymetrySaverTool*>(userData);
 	
-	try
+	/* Hand the grid to the writer thread, and read the next grid into the buffer it replaces: */
+	Threads::MutexCond::Lock writerLock(thisPtr->writerCond);
+	if(thisPtr->pendingSnapshot&&thisPtr->requestSnapshot)
+		++thisPtr->numDroppedSnapshots;
+	std::swap(thisPtr->bathymetryBuffer,thisPtr->pendingBuffer);
+	thisPtr->pendingSave=thisPtr->pendingSave||thisPtr->requestSave;
+	thisPtr->pendingSnapshot=thisPtr->pendingSnapshot||thisPtr->requestSnapshot;
+	thisPtr->pendingTime=thisPtr->requestTime;
+	thisPtr->requestSave=false;
+	thisPtr->requestSnapshot=false;
+	thisPtr->writerCond.signal();
+	}
+
+void* BathymetrySaverTool::writerThreadMethod(void)
+	{
+	while(true)
+		{
+		/* Wait for the next read-back grid: */
+		bool save,snapshot;
+		double time;
 		{
-		/* Export the bathymetry grid: */
-		thisPtr->writeDEMFile();
+		Threads::MutexCond::Lock writerLock(writerCond);
+		while(!shutdownWriter&&!pendingSave&&!pendingSnapshot)
+			writerCond.wait(writerLock);
+		
+		/* Bail out if there is nothing left to write: */
+		if(!pendingSave&&!pendingSnapshot)
+			break;
+		
+		/* Take ownership of the pending grid: */
+		std::swap(pendingBuffer,writerBuffer);
+		save=pendingSave;
+		snapshot=pendingSnapshot;
+		time=pendingTime;
+		pendingSave=false;
+		pendingSnapshot=false;
+		}
 		
-		if(thisPtr->configuration.postUpdate)
+		bool demWritten=false;
+		try
 			{
-			/* Send an update message to the configured web server: */
-			thisPtr->postUpdate();
+			/* Export the bathymetry grid: */
+			if(save)
+				{
+				writeDEMFile(writerBuffer);
+				demWritten=true;
+				}
+			if(snapshot)
+				writeSnapshot(writerBuffer,time);
+			}
+		catch(const std::runtime_error& err)
+			{
+			Misc::formattedUserError("Save Bathymetry: Unable to save bathymetry due to exception \"%s\"",err.what());
+			
+			/* Start a fresh capture file with the next snapshot: */
+			captureFile=0;
+			}
+		
+		if(configuration.postUpdate&&demWritten)
+			{
+			try
+				{
+				/* Notify the configured web server that a new DEM file is available: */
+				postUpdate();
+				}
+			catch(const std::runtime_error& err)
+				{
+				/* Network errors don't affect the saved files: */
+				Misc::formattedUserError("Save Bathymetry: Unable to send update message due to exception \"%s\"",err.what());
+				}
 			}
 		}
-	catch(const std::runtime_error& err)
+	
+	return 0;
+	}
+
+bool BathymetrySaverTool::requestGrid(bool save,bool snapshot)
+	{
+	Threads::MutexCond::Lock writerLock(writerCond);
+	
+	/* Piggy-back on this tool's own pending request if there is one: */
+	if(requestSave||requestSnapshot)
 		{
-		Misc::formattedUserError("Save Bathymetry: Unable to save bathymetry due to exception \"%s\"",err.what());
+		requestSave=requestSave||save;
+		requestSnapshot=requestSnapshot||snapshot;
+		return true;
 		}
+	
+	/* Request a bathymetry grid from the water table: */
+	if(!application->gridRequest.requestGrids(bathymetryBuffer,0,&BathymetrySaverTool::readBackCallback,this))
+		return false;
+	requestSave=save;
+	requestSnapshot=snapshot;
+	requestTime=Vrui::getApplicationTime();
+	return true;
 	}
 
 BathymetrySaverToolFactory* BathymetrySaverTool::initClass(WaterTable2* sWaterTable,Vrui::ToolManager& toolManager)
@@ -613,13 +855,37 @@ BathymetrySaverToolFactory* BathymetrySaverTool::initClass(WaterTable2* sWaterTa
 BathymetrySaverTool::BathymetrySaverTool(const Vrui::ToolFactory* factory,const Vrui::ToolInputAssignment& inputAssignment)
 	:Vrui::Tool(factory,inputAssignment),
 	 configuration(BathymetrySaverTool::factory->configuration),
-	 bathymetryBuffer(new GLfloat[BathymetrySaverTool::factory->gridSize[1]*BathymetrySaverTool::factory->gridSize[0]])
+	 bathymetryBuffer(new GLfloat[BathymetrySaverTool::factory->gridSize[1]*BathymetrySaverTool::factory->gridSize[0]]),
+	 requestSave(false),requestSnapshot(false),requestTime(0.0),
+	 capturing(false),nextCaptureTime(0.0),
+	 pendingBuffer(new GLfloat[BathymetrySaverTool::factory->gridSize[1]*BathymetrySaverTool::factory->gridSize[0]]),
+	 pendingSave(false),pendingSnapshot(false),pendingTime(0.0),
+	 numDroppedSnapshots(0),shutdownWriter(false),
+	 writerBuffer(new GLfloat[BathymetrySaverTool::factory->gridSize[1]*BathymetrySaverTool::factory->gridSize[0]]),
+	 referenceBuffer(new GLfloat[BathymetrySaverTool::factory->gridSize[1]*BathymetrySaverTool::factory->gridSize[0]]),
+	 numSnapshots(0)
 	{
+	/* Start the background writer thread: */
+	writerThread.start(this,&BathymetrySaverTool::writerThreadMethod);
 	}
 
 BathymetrySaverTool::~BathymetrySaverTool(void)
 	{
+	/* Shut down the writer thread after it has written any pending grid: */
+	{
+	Threads::MutexCond::Lock writerLock(writerCond);
+	shutdownWriter=true;
+	writerCond.signal();
+	}
+	writerThread.join();
+	
+	if(numDroppedSnapshots!=0)
+		Misc::formattedConsoleWarning("Save Bathymetry: Dropped %u delta snapshots because the background writer could not keep up",numDroppedSnapshots);
+	
 	delete[] bathymetryBuffer;
+	delete[] pendingBuffer;
+	delete[] writerBuffer;
+	delete[] referenceBuffer;
 	}
 
 void BathymetrySaverTool::configure(const Misc::ConfigurationFileSection& configFileSection)
@@ -643,7 +909,40 @@ void BathymetrySaverTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice::
 	{
 	if(cbData->newButtonState)
 		{
-		/* Request a bathymetry grid from the water table: */
-		application->gridRequest.requestGrids(bathymetryBuffer,0,&BathymetrySaverTool::readBackCallback,this);
+		if(configuration.captureMode)
+			{
+			/* Toggle continuous capture: */
+			capturing=!capturing;
+			if(capturing)
+				{
+				/* Capture the first snapshot right away: */
+				nextCaptureTime=Vrui::getApplicationTime();
+				}
+			Misc::formattedUserNote("Save Bathymetry: %s continuous capture to %s",capturing?"Started":"Stopped",configuration.captureFileName.c_str());
+			}
+		else
+			{
+			/* Request a bathymetry grid for a single DEM file: */
+			requestGrid(true,false);
+			}
+		}
+	}
+
+void BathymetrySaverTool::frame(void)
+	{
+	if(capturing)
+		{
+		/* Check if the next delta snapshot is due: */
+		double now=Vrui::getApplicationTime();
+		if(now>=nextCaptureTime&&requestGrid(false,true))
+			{
+			/* Schedule the next snapshot, but do not try to catch up on missed ones: */
+			nextCaptureTime+=configuration.captureInterval;
+			if(nextCaptureTime<now)
+				nextCaptureTime=now+configuration.captureInterval;
+			}
+		
+		/* Make sure there will be a frame when the next snapshot is due: */
+		Vrui::scheduleUpdate(nextCaptureTime);
 		}
 	}
@@ -1,7 +1,7 @@
 /***********************************************************************
 BathymetrySaverTool - Tool to save the current bathymetry grid of an
 augmented reality sandbox to a file or network socket.
-Copyright (c) 2016-2019 Oliver Kreylos
+Copyright (c) 2016-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -24,6 +24,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define BATHYMETRYSAVERTOOL_INCLUDED
 
 #include <string>
+#include <vector>
+#include <Threads/Thread.h>
+#include <Threads/MutexCond.h>
+#include <IO/SeekableFile.h>
+#include <Comm/NetPipe.h>
 #include <GL/gl.h>
 #include <Vrui/Tool.h>
 #include <Vrui/Application.h>
@@ -52,6 +57,12 @@ class BathymetrySaverToolFactory:public Vrui::ToolFactory
 		std::string postUpdatePage; // Name of page on web server to which update messages are posted
 		std::string postUpdateMessage; // The message to send to the web server
 		double gridScale; // Overall scale factor to applied to grids on export
+		bool captureMode; // Flag whether the tool's button toggles continuous capture of delta snapshots instead of saving a single DEM file
+		std::string captureFileName; // Name of rolling file to which to append delta snapshots in continuous capture mode
+		double captureInterval; // Time between delta snapshots in continuous capture mode in seconds
+		GLfloat captureThreshold; // Minimum elevation change for a bathymetry cell to be included in a delta snapshot
+		unsigned int captureKeyframeInterval; // Number of snapshots after which a full snapshot is written instead of a delta snapshot
+		unsigned int captureMaxFileSize; // Size in megabytes after which the capture file is rolled over
 		
 		/* Constructors and destructors: */
 		Configuration(void); // Creates default configuration
@@ -88,12 +99,37 @@ class BathymetrySaverTool:public Vrui::Tool,public Vrui::Application::Tool<Sandb
 	private:
 	static BathymetrySaverToolFactory* factory; // Pointer to the factory object for this class
 	BathymetrySaverToolFactory::Configuration configuration; // Configuration of this tool
-	GLfloat* bathymetryBuffer; // Bathymetry grid buffer
+	GLfloat* bathymetryBuffer; // Bathymetry grid buffer into which the next requested grid is read back from the GPU
+	bool requestSave; // Flag whether the pending grid request is for saving a DEM file
+	bool requestSnapshot; // Flag whether the pending grid request is for capturing a delta snapshot
+	double requestTime; // Application time at which the pending grid request was made
+	bool capturing; // Flag whether continuous capture is currently active
+	double nextCaptureTime; // Application time at which to request the next delta snapshot
+	
+	/* Background writer state: */
+	Threads::MutexCond writerCond; // Condition variable to wake up the writer thread when a new grid has been read back
+	GLfloat* pendingBuffer; // Most recently read back grid waiting for the writer thread
+	bool pendingSave; // Flag whether the pending grid is to be saved as a DEM file
+	bool pendingSnapshot; // Flag whether the pending grid is to be appended as a delta snapshot
+	double pendingTime; // Application time at which the pending grid was requested
+	unsigned int numDroppedSnapshots; // Number of delta snapshots that were replaced by newer ones before the writer thread got to them
+	bool shutdownWriter; // Flag to shut down the writer thread
+	Threads::Thread writerThread; // Thread writing read-back grids in the background
+	GLfloat* writerBuffer; // Grid currently being written by the writer thread
+	GLfloat* referenceBuffer; // Bathymetry grid as reconstructed by a reader of the capture file up to the most recent snapshot
+	std::vector<unsigned int> runs; // List of (start, length) pairs of runs of changed cells in the current delta snapshot
+	IO::SeekableFilePtr captureFile; // Capture file currently being appended to, or null
+	unsigned int numSnapshots; // Number of snapshots written to the current capture file
+	Comm::NetPipePtr postUpdatePipe; // Persistent connection to the web server to which update messages are sent, or null
 	
 	/* Private methods: */
-	void writeDEMFile(void) const; // Writes the bathymetry grid to a file in USGS DEM format
-	void postUpdate(void) const; // Sends an update message to a web server
+	void writeDEMFile(const GLfloat* grid) const; // Writes the given bathymetry grid to a file in USGS DEM format
+	bool requestGrid(bool save,bool snapshot); // Requests a bathymetry grid read-back for saving and/or capturing; returns true if the request was granted
+	void writeSnapshot(const GLfloat* grid,double time); // Appends the given bathymetry grid as a delta snapshot to the capture file
+	bool sendUpdateRequest(void); // Sends an update message over the current web server connection; returns true if the server keeps the connection alive
+	void postUpdate(void); // Sends an update message to a web server
 	static void readBackCallback(GLfloat* bathymetryBuffer,GLfloat* waterLevelBuffer,void* userData); // Callback when a grid has been read back from the GPU
+	void* writerThreadMethod(void); // Thread method writing read-back grids in the background
 	
 	/* Constructors and destructors: */
 	public:
@@ -106,6 +142,7 @@ class BathymetrySaverTool:public Vrui::Tool,public Vrui::Application::Tool<Sandb
 	virtual void storeState(Misc::ConfigurationFileSection& configFileSection) const;
 	virtual const Vrui::ToolFactory* getFactory(void) const;
 	virtual void buttonCallback(int buttonSlotIndex,Vrui::InputDevice::ButtonCallbackData* cbData);
+	virtual void frame(void);
 	};
 
 #endif
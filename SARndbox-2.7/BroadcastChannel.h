@@ -0,0 +1,195 @@
+/***********************************************************************
+BroadcastChannel - Class to broadcast a stream of values from a single
+producer to multiple consumers through lock-free latest-value slots, so
+that the producer never waits for a slow consumer.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef BROADCASTCHANNEL_INCLUDED
+#define BROADCASTCHANNEL_INCLUDED
+
+#include <sched.h>
+#include <stdexcept>
+#include <Threads/Atomic.h>
+#include <Threads/Mutex.h>
+#include <Threads/MutexCond.h>
+#include <Threads/TripleBuffer.h>
+
+template <class ValueParam>
+class BroadcastChannel
+	{
+	/* Embedded classes: */
+	public:
+	typedef ValueParam Value; // Type of broadcast values
+	
+	class Subscriber // Class for consumers receiving the most recent value broadcast on a channel
+		{
+		friend class BroadcastChannel;
+		
+		/* Elements: */
+		private:
+		Threads::TripleBuffer<Value> slot; // Latest-value slot written by the producer and read by the consumer
+		Threads::Atomic<volatile unsigned int> enabled; // Flag whether the subscriber currently receives values
+		Threads::Atomic<volatile unsigned int> waiting; // Flag whether the consumer is waiting, or about to wait, for a new value
+		Threads::MutexCond wakeCond; // Condition variable to wake up a waiting consumer; never held while the consumer processes values
+		volatile bool shutdown; // Flag to release the consumer from waiting when it shuts down
+		Threads::Atomic<volatile unsigned int> numPosted; // Number of values posted to this subscriber
+		Threads::Atomic<volatile unsigned int> numDropped; // Number of posted values overwritten before the consumer locked them
+		
+		/* Constructors and destructors: */
+		public:
+		Subscriber(void)
+			:enabled(1U),waiting(0U),shutdown(false),numPosted(0U),numDropped(0U)
+			{
+			}
+		private:
+		Subscriber(const Subscriber& source); // Prohibit copy constructor
+		Subscriber& operator=(const Subscriber& source); // Prohibit assignment operator
+		
+		/* Methods: */
+		public:
+		
+		/* Producer-side methods: */
+		void post(const Value& newValue) // Posts a new value; only waits for the consumer briefly if it is going to sleep
+			{
+			/* Push the new value into the slot and count it as dropped if the previous value was never locked: */
+			if(slot.postNewValue(newValue))
+				numDropped.preAdd(1U);
+			numPosted.preAdd(1U);
+			
+			/* Wake up the consumer if it is waiting; the compare-and-swap in postNewValue orders this check after the post: */
+			if(waiting.get()!=0U)
+				{
+				Threads::MutexCond::Lock wakeLock(wakeCond);
+				wakeCond.signal();
+				}
+			}
+		
+		/* Consumer-side methods: */
+		bool isEnabled(void) const // Returns true if the subscriber receives values broadcast on its channel
+			{
+			return enabled.get()!=0U;
+			}
+		void setEnabled(bool newEnabled) // Sets whether the subscriber receives values broadcast on its channel
+			{
+			if(newEnabled)
+				enabled.preOr(1U);
+			else
+				enabled.preAnd(0U);
+			}
+		unsigned int getNumPosted(void) const // Returns the number of values posted to this subscriber
+			{
+			return numPosted.get();
+			}
+		unsigned int getNumDropped(void) const // Returns the number of posted values the consumer never saw
+			{
+			return numDropped.get();
+			}
+		bool wait(void) // Blocks until a new value is available; returns false if the subscriber was shut down
+			{
+			Threads::MutexCond::Lock wakeLock(wakeCond);
+			
+			/* Announce that the consumer is about to sleep before checking for new values, so that the producer can't miss it: */
+			waiting.preOr(1U);
+			while(!shutdown&&!slot.hasNewValue())
+				wakeCond.wait(wakeLock);
+			waiting.preAnd(0U);
+			
+			return !shutdown;
+			}
+		bool lockNewValue(void) // Locks the most recently posted value; returns true if the value is new
+			{
+			return slot.lockNewValue();
+			}
+		const Value& getLockedValue(void) const // Returns the currently locked value
+			{
+			return slot.getLockedValue();
+			}
+		void shutDown(void) // Releases the consumer from waiting for new values, now and in the future
+			{
+			Threads::MutexCond::Lock wakeLock(wakeCond);
+			shutdown=true;
+			wakeCond.signal();
+			}
+		};
+	
+	static const int maxNumSubscribers=32; // Maximum number of simultaneous subscribers to a channel
+	
+	/* Elements: */
+	private:
+	Threads::Mutex subscriptionMutex; // Mutex serializing changes to the subscriber list; never locked by the producer
+	Subscriber* subscribers[maxNumSubscribers]; // Array of subscriber slots
+	Threads::Atomic<volatile unsigned int> activeMask; // Bit mask of subscriber slots in use
+	Threads::Atomic<volatile unsigned int> postEpoch; // Counter incremented before and after each broadcast; odd while the producer is broadcasting
+	
+	/* Constructors and destructors: */
+	public:
+	BroadcastChannel(void)
+		:activeMask(0U),postEpoch(0U)
+		{
+		for(int i=0;i<maxNumSubscribers;++i)
+			subscribers[i]=0;
+		}
+	private:
+	BroadcastChannel(const BroadcastChannel& source); // Prohibit copy constructor
+	BroadcastChannel& operator=(const BroadcastChannel& source); // Prohibit assignment operator
+	
+	/* Methods: */
+	public:
+	void subscribe(Subscriber& subscriber) // Adds a subscriber to the channel
+		{
+		Threads::Mutex::Lock subscriptionLock(subscriptionMutex);
+		
+		/* Find a free subscriber slot: */
+		int index;
+		for(index=0;index<maxNumSubscribers&&(activeMask.get()&(1U<<index))!=0U;++index)
+			;
+		if(index==maxNumSubscribers)
+			throw std::runtime_error("BroadcastChannel::subscribe: Too many subscribers");
+		
+		/* Store the subscriber before activating its slot, which publishes it to the producer: */
+		subscribers[index]=&subscriber;
+		activeMask.preOr(1U<<index);
+		}
+	void unsubscribe(Subscriber& subscriber) // Removes a subscriber from the channel; subscriber can be destroyed when the method returns
+		{
+		Threads::Mutex::Lock subscriptionLock(subscriptionMutex);
+		
+		/* Deactivate the subscriber's slot, but leave the pointer in place for a broadcast that already read the old mask: */
+		for(int index=0;index<maxNumSubscribers;++index)
+			if((activeMask.get()&(1U<<index))!=0U&&subscribers[index]==&subscriber)
+				activeMask.preAnd(~(1U<<index));
+		
+		/* Wait until a broadcast that might still see the subscriber has finished: */
+		unsigned int epoch=postEpoch.get();
+		while((epoch&0x1U)!=0U&&postEpoch.get()==epoch)
+			sched_yield();
+		}
+	void post(const Value& newValue) // Broadcasts a new value to all enabled subscribers; must only be called from a single producer thread
+		{
+		postEpoch.preAdd(1U);
+		unsigned int mask=activeMask.get();
+		for(int index=0;mask!=0U;++index,mask>>=1)
+			if((mask&0x1U)!=0U&&subscribers[index]->isEnabled())
+				subscribers[index]->post(newValue);
+		postEpoch.preAdd(1U);
+		}
+	};
+
+#endif
@@ -0,0 +1,190 @@
+/***********************************************************************
+BroadcastChannelStress - Utility to stress-test broadcast channels by
+posting frames at full speed to consumers of varying speed, while other
+consumers subscribe and unsubscribe continuously.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include <Misc/Timer.h>
+#include <Threads/Thread.h>
+#include <Kinect/FrameBuffer.h>
+
+#include "BroadcastChannel.h"
+
+typedef BroadcastChannel<Kinect::FrameBuffer> FrameChannel;
+
+class Consumer // Class for consumers processing frames at a fixed speed in a background thread
+	{
+	/* Elements: */
+	public:
+	FrameChannel::Subscriber subscriber; // The consumer's subscription
+	unsigned int delay; // Simulated processing time per frame in microseconds
+	unsigned int numReceived; // Number of frames processed
+	unsigned int numErrors; // Number of frames received out of order or with corrupted contents
+	Threads::Thread thread; // The consumer thread
+	
+	/* Private methods: */
+	private:
+	void* threadMethod(void)
+		{
+		double lastSequence=-1.0;
+		while(subscriber.wait())
+			{
+			subscriber.lockNewValue();
+			const Kinect::FrameBuffer& frame=subscriber.getLockedValue();
+			
+			/* Check that frames arrive in order and that their contents match their sequence numbers: */
+			if(frame.timeStamp<=lastSequence||*frame.getData<unsigned int>()!=(unsigned int)(frame.timeStamp))
+				++numErrors;
+			lastSequence=frame.timeStamp;
+			++numReceived;
+			
+			/* Simulate processing the frame: */
+			if(delay>0)
+				usleep(delay);
+			}
+		
+		return 0;
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	Consumer(unsigned int sDelay)
+		:delay(sDelay),numReceived(0),numErrors(0)
+		{
+		}
+	
+	/* Methods: */
+	void start(void)
+		{
+		thread.start(this,&Consumer::threadMethod);
+		}
+	void stop(void)
+		{
+		subscriber.shutDown();
+		thread.join();
+		}
+	};
+
+FrameChannel channel; // The channel under test
+volatile bool runChurnThread=true; // Flag to keep the subscription churn thread running
+
+void* churnThreadMethod(void)
+	{
+	/* Repeatedly subscribe and unsubscribe short-lived consumers: */
+	unsigned int numChurns=0;
+	while(runChurnThread)
+		{
+		Consumer consumer(0);
+		consumer.start();
+		channel.subscribe(consumer.subscriber);
+		usleep(1000);
+		channel.unsubscribe(consumer.subscriber);
+		consumer.stop();
+		++numChurns;
+		}
+	
+	std::cout<<numChurns<<" subscribe/unsubscribe cycles"<<std::endl;
+	return 0;
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numFrames=100000;
+	unsigned int numConsumers=3;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"frames")==0&&i+1<argc)
+				{
+				++i;
+				numFrames=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"consumers")==0&&i+1<argc)
+				{
+				++i;
+				numConsumers=(unsigned int)(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	
+	/* Create consumers with increasing processing times, and start the churn thread: */
+	std::vector<Consumer*> consumers;
+	for(unsigned int i=0;i<numConsumers;++i)
+		{
+		consumers.push_back(new Consumer(i*100U));
+		consumers.back()->start();
+		channel.subscribe(consumers.back()->subscriber);
+		}
+	Threads::Thread churnThread;
+	churnThread.start(churnThreadMethod);
+	
+	/* Post frames as fast as possible and record the longest time spent posting a single frame: */
+	double maxPostTime=0.0;
+	Misc::Timer totalTimer;
+	for(unsigned int frameIndex=0;frameIndex<numFrames;++frameIndex)
+		{
+		Kinect::FrameBuffer frame(1,1,sizeof(unsigned int));
+		*frame.getData<unsigned int>()=frameIndex;
+		frame.timeStamp=double(frameIndex);
+		Misc::Timer postTimer;
+		channel.post(frame);
+		postTimer.elapse();
+		if(maxPostTime<postTimer.getTime())
+			maxPostTime=postTimer.getTime();
+		}
+	totalTimer.elapse();
+	
+	/* Shut down all threads: */
+	runChurnThread=false;
+	churnThread.join();
+	for(std::vector<Consumer*>::iterator cIt=consumers.begin();cIt!=consumers.end();++cIt)
+		{
+		channel.unsubscribe((*cIt)->subscriber);
+		(*cIt)->stop();
+		}
+	
+	/* Check the per-subscriber counters; every posted frame was either seen or dropped, except for the last one, which might still be pending: */
+	std::cout<<"Posted "<<numFrames<<" frames in "<<totalTimer.getTime()*1000.0<<" ms, "<<totalTimer.getTime()*1.0e6/double(numFrames)<<" us per frame, longest post "<<maxPostTime*1.0e6<<" us"<<std::endl;
+	unsigned int numFailures=0;
+	for(unsigned int i=0;i<numConsumers;++i)
+		{
+		const Consumer& c=*consumers[i];
+		unsigned int numPosted=c.subscriber.getNumPosted();
+		unsigned int numDropped=c.subscriber.getNumDropped();
+		bool ok=numPosted==numFrames&&c.numErrors==0&&(c.numReceived+numDropped==numPosted||c.numReceived+numDropped+1==numPosted);
+		std::cout<<"Consumer "<<i<<" ("<<c.delay<<" us/frame): "<<c.numReceived<<" received, "<<numDropped<<" dropped, "<<c.numErrors<<" errors"<<(ok?"":" FAILED")<<std::endl;
+		if(!ok)
+			++numFailures;
+		delete consumers[i];
+		}
+	
+	return numFailures==0?0:1;
+	}
@@ -0,0 +1,524 @@
+/***********************************************************************
+CPUWaterTable - Class to simulate water flowing over a surface on the
+CPU, using the same Saint-Venant discretization as the GPU-based
+WaterTable2 class, for offline simulation on computers without
+OpenGL-capable graphics cards.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "CPUWaterTable.h"
+
+#include <string.h>
+#include <Math/Math.h>
+#include <Math/Constants.h>
+
+namespace {
+
+/*********************************************************************
+Helper functions mirroring the GLSL shaders used by class WaterTable2.
+All grid accesses clamp to the grid boundaries, which matches the
+GL_CLAMP wrapping mode of WaterTable2's rectangle textures.
+*********************************************************************/
+
+inline GLsizei clamp(GLsizei index,GLsizei max)
+	{
+	return index<0?0:(index>max?max:index);
+	}
+
+inline GLfloat minmod(GLfloat d01,GLfloat d02,GLfloat d12)
+	{
+	GLfloat dMin=Math::min(Math::min(d01,d02),d12);
+	GLfloat dMax=Math::max(Math::max(d01,d02),d12);
+	return dMin>0.0f?dMin:dMax<0.0f?dMax:0.0f;
+	}
+
+inline CPUWaterTable::Quantity calcSlope(const CPUWaterTable::Quantity& q0,const CPUWaterTable::Quantity& q1,const CPUWaterTable::Quantity& q2,GLfloat cellSize,GLfloat theta,GLfloat b0,GLfloat b1)
+	{
+	/* Calculate the minmod-limited slope from the left, central, and right differences: */
+	GLfloat tcs=theta/cellSize;
+	GLfloat hcs=0.5f/cellSize;
+	CPUWaterTable::Quantity slope;
+	slope.w=minmod((q1.w-q0.w)*tcs,(q2.w-q0.w)*hcs,(q2.w-q1.w)*tcs);
+	slope.hu=minmod((q1.hu-q0.hu)*tcs,(q2.hu-q0.hu)*hcs,(q2.hu-q1.hu)*tcs);
+	slope.hv=minmod((q1.hv-q0.hv)*tcs,(q2.hv-q0.hv)*hcs,(q2.hv-q1.hv)*tcs);
+	
+	/* Check the calculated slope against the left and right face-centered bathymetry values: */
+	GLfloat hcellSize=cellSize*0.5f;
+	if(q1.w-slope.w*hcellSize<b0)
+		slope.w=(q1.w-b0)/hcellSize;
+	if(q1.w+slope.w*hcellSize<b1)
+		slope.w=(b1-q1.w)/hcellSize;
+	
+	return slope;
+	}
+
+inline CPUWaterTable::Quantity addScaled(const CPUWaterTable::Quantity& q,const CPUWaterTable::Quantity& slope,GLfloat scale)
+	{
+	CPUWaterTable::Quantity result;
+	result.w=q.w+slope.w*scale;
+	result.hu=q.hu+slope.hu*scale;
+	result.hv=q.hv+slope.hv*scale;
+	return result;
+	}
+
+inline void calcUv(CPUWaterTable::Quantity& q,GLfloat h,GLfloat epsilon,GLfloat uv[2])
+	{
+	/* Calculate velocity using a desingularizing division operator: */
+	GLfloat h4=h*h*h*h;
+	GLfloat scale=1.41421356237309f*h/Math::sqrt(h4+Math::max(h4,epsilon));
+	uv[0]=q.hu*scale;
+	uv[1]=q.hv*scale;
+	
+	/* Recalculate discharge based on desingularized velocity: */
+	q.hu=uv[0]*h;
+	q.hv=uv[1]*h;
+	}
+
+GLfloat calcPartialFlux(CPUWaterTable::Quantity qe,CPUWaterTable::Quantity qw,GLfloat bew,int axis,GLfloat cellSize,GLfloat g,GLfloat epsilon,CPUWaterTable::Quantity& flux)
+	{
+	/* Calculate one-sided water column heights: */
+	GLfloat he=Math::max(qe.w-bew,0.0f);
+	GLfloat hw=Math::max(qw.w-bew,0.0f);
+	
+	/* Calculate one-sided velocities: */
+	GLfloat uve[2],uvw[2];
+	calcUv(qe,he,epsilon,uve);
+	calcUv(qw,hw,epsilon,uvw);
+	
+	/* Calculate one-sided flux quadratures along the given axis: */
+	GLfloat de=axis==0?qe.hu:qe.hv;
+	GLfloat dw=axis==0?qw.hu:qw.hv;
+	CPUWaterTable::Quantity fe,fw;
+	fe.w=de;
+	fe.hu=uve[0]*de;
+	fe.hv=uve[1]*de;
+	fw.w=dw;
+	fw.hu=uvw[0]*dw;
+	fw.hv=uvw[1]*dw;
+	if(axis==0)
+		{
+		fe.hu+=0.5f*g*he*he;
+		fw.hu+=0.5f*g*hw*hw;
+		}
+	else
+		{
+		fe.hv+=0.5f*g*he*he;
+		fw.hv+=0.5f*g*hw*hw;
+		}
+	
+	/* Calculate one-sided local speeds of propagation: */
+	GLfloat sghe=Math::sqrt(g*he);
+	GLfloat sghw=Math::sqrt(g*hw);
+	GLfloat ae=Math::min(Math::min(uve[axis]-sghe,uvw[axis]-sghw),0.0f);
+	GLfloat aw=Math::max(Math::max(uve[axis]+sghe,uvw[axis]+sghw),0.0f);
+	
+	/* Calculate complete flux: */
+	if(aw-ae!=0.0f)
+		{
+		GLfloat aa=aw*ae;
+		GLfloat invDa=1.0f/(aw-ae);
+		flux.w=((fe.w*aw-fw.w*ae)+(qw.w-qe.w)*aa)*invDa;
+		flux.hu=((fe.hu*aw-fw.hu*ae)+(qw.hu-qe.hu)*aa)*invDa;
+		flux.hv=((fe.hv*aw-fw.hv*ae)+(qw.hv-qe.hv)*aa)*invDa;
+		}
+	else
+		flux.w=flux.hu=flux.hv=0.0f;
+	
+	/* Return maximum possible step size; dry faces do not limit the step size (avoids division by signed zero): */
+	GLfloat a=Math::max(-ae,aw);
+	return a>0.0f?0.5f*cellSize/a:Math::Constants<GLfloat>::max;
+	}
+	
+}
+
+/******************************
+Methods of class CPUWaterTable:
+******************************/
+
+GLfloat CPUWaterTable::calcDerivative(const CPUWaterTable::Band& band,const CPUWaterTable::Quantity* q)
+	{
+	GLsizei bw=size[0]-1;
+	GLsizei bmx=size[0]-2;
+	GLsizei bmy=size[1]-2;
+	GLsizei qmx=size[0]-1;
+	GLsizei qmy=size[1]-1;
+	const GLfloat* b=bathymetry;
+	GLfloat result=maxStepSize;
+	
+	for(GLsizei y=band.rowBegin;y<band.rowEnd;++y)
+		{
+		/* Calculate clamped row indices into the bathymetry and quantity grids: */
+		const GLfloat* bRowM2=b+clamp(y-2,bmy)*bw;
+		const GLfloat* bRowM1=b+clamp(y-1,bmy)*bw;
+		const GLfloat* bRow0=b+clamp(y,bmy)*bw;
+		const GLfloat* bRowP1=b+clamp(y+1,bmy)*bw;
+		const Quantity* qRowM2=q+clamp(y-2,qmy)*size[0];
+		const Quantity* qRowM1=q+clamp(y-1,qmy)*size[0];
+		const Quantity* qRow0=q+y*size[0];
+		const Quantity* qRowP1=q+clamp(y+1,qmy)*size[0];
+		const Quantity* qRowP2=q+clamp(y+2,qmy)*size[0];
+		Quantity* qtPtr=derivative+y*size[0];
+		
+		for(GLsizei x=0;x<size[0];++x,++qtPtr)
+			{
+			GLsizei xM2=clamp(x-2,bmx);
+			GLsizei xM1=clamp(x-1,bmx);
+			GLsizei x0=clamp(x,bmx);
+			GLsizei xP1=clamp(x+1,bmx);
+			
+			/* Calculate the face-centered bathymetry elevations required for partial flux computations: */
+			GLfloat b00=bRowM1[xM1];
+			GLfloat b10=bRowM1[x0];
+			GLfloat b01=bRow0[xM1];
+			GLfloat b11=bRow0[x0];
+			GLfloat b0=(bRowM2[xM1]+bRowM2[x0])*0.5f;
+			GLfloat b1=(b00+b10)*0.5f;
+			GLfloat b2=(bRowM1[xM2]+bRow0[xM2])*0.5f;
+			GLfloat b3=(b00+b01)*0.5f;
+			GLfloat b4=(b10+b11)*0.5f;
+			GLfloat b5=(bRowM1[xP1]+bRow0[xP1])*0.5f;
+			GLfloat b6=(b01+b11)*0.5f;
+			GLfloat b7=(bRowP1[xM1]+bRowP1[x0])*0.5f;
+			
+			/* Get quantities required for partial flux computations: */
+			const Quantity& q1=qRowM1[x];
+			const Quantity& q3=qRow0[clamp(x-1,qmx)];
+			const Quantity& q4=qRow0[x];
+			const Quantity& q5=qRow0[clamp(x+1,qmx)];
+			const Quantity& q7=qRowP1[x];
+			
+			/* Calculate one-sided quantities required for partial flux computations: */
+			GLfloat hcx=cellSize[0]*0.5f;
+			GLfloat hcy=cellSize[1]*0.5f;
+			Quantity q1n=addScaled(q1,calcSlope(qRowM2[x],q1,q4,cellSize[1],theta,b0,b1),hcy);
+			Quantity q3e=addScaled(q3,calcSlope(qRow0[clamp(x-2,qmx)],q3,q4,cellSize[0],theta,b2,b3),hcx);
+			Quantity q4x=calcSlope(q3,q4,q5,cellSize[0],theta,b3,b4);
+			Quantity q4w=addScaled(q4,q4x,-hcx);
+			Quantity q4e=addScaled(q4,q4x,hcx);
+			Quantity q4y=calcSlope(q1,q4,q7,cellSize[1],theta,b1,b6);
+			Quantity q4s=addScaled(q4,q4y,-hcy);
+			Quantity q4n=addScaled(q4,q4y,hcy);
+			Quantity q5w=addScaled(q5,calcSlope(q4,q5,qRow0[clamp(x+2,qmx)],cellSize[0],theta,b4,b5),-hcx);
+			Quantity q7s=addScaled(q7,calcSlope(q4,q7,qRowP2[x],cellSize[1],theta,b6,b7),-hcy);
+			
+			/* Calculate partial fluxes across the cell's faces and the maximum possible step size for this cell: */
+			Quantity fluxXw,fluxXe,fluxYs,fluxYn;
+			GLfloat cellMaxStepSize=Math::min(Math::min(calcPartialFlux(q3e,q4w,b3,0,cellSize[0],g,epsilon,fluxXw),
+			                                            calcPartialFlux(q4e,q5w,b4,0,cellSize[0],g,epsilon,fluxXe)),
+			                                  Math::min(calcPartialFlux(q1n,q4s,b1,1,cellSize[1],g,epsilon,fluxYs),
+			                                            calcPartialFlux(q4n,q7s,b6,1,cellSize[1],g,epsilon,fluxYn)));
+			if(result>cellMaxStepSize)
+				result=cellMaxStepSize;
+			
+			/* Calculate the water column height at the cell center: */
+			GLfloat h=Math::max(q4.w-(b3+b4)*0.5f,0.0f);
+			
+			/* Calculate the temporal derivative including the equation source terms at the cell center: */
+			qtPtr->w=-(fluxXe.w-fluxXw.w)/cellSize[0]-(fluxYn.w-fluxYs.w)/cellSize[1];
+			qtPtr->hu=-g*h*(b4-b3)/cellSize[0]-(fluxXe.hu-fluxXw.hu)/cellSize[0]-(fluxYn.hu-fluxYs.hu)/cellSize[1];
+			qtPtr->hv=-g*h*(b6-b1)/cellSize[1]-(fluxXe.hv-fluxXw.hv)/cellSize[0]-(fluxYn.hv-fluxYs.hv)/cellSize[1];
+			}
+		}
+	
+	return result;
+	}
+
+bool CPUWaterTable::runStepPasses(unsigned int bandIndex)
+	{
+	/* Wait for the start of the next simulation step: */
+	stepBarrier.synchronize();
+	if(shutdownWorkers)
+		return false;
+	
+	Band& band=bands[bandIndex];
+	size_t rowBegin=size_t(band.rowBegin)*size_t(size[0]);
+	size_t rowEnd=size_t(band.rowEnd)*size_t(size[0]);
+	
+	/*********************************************************************
+	Step 1: Calculate temporal derivative of most recent quantities.
+	*********************************************************************/
+	
+	band.maxStepSize=calcDerivative(band,quantity);
+	stepBarrier.synchronize();
+	
+	/* Gather the step size from all bands; all threads arrive at the same result: */
+	GLfloat bandStepSize=maxStepSize;
+	if(!forceMaxStepSize)
+		for(unsigned int i=0;i<numThreads;++i)
+			if(bandStepSize>bands[i].maxStepSize)
+				bandStepSize=bands[i].maxStepSize;
+	if(bandIndex==0)
+		stepSize=bandStepSize;
+	GLfloat att=Math::pow(attenuation,bandStepSize);
+	
+	/*********************************************************************
+	Step 2: Perform the tentative Euler integration step.
+	*********************************************************************/
+	
+	for(size_t i=rowBegin;i<rowEnd;++i)
+		{
+		quantityStar[i].w=quantity[i].w+derivative[i].w*bandStepSize;
+		quantityStar[i].hu=(quantity[i].hu+derivative[i].hu*bandStepSize)*att;
+		quantityStar[i].hv=(quantity[i].hv+derivative[i].hv*bandStepSize)*att;
+		}
+	stepBarrier.synchronize();
+	
+	/*********************************************************************
+	Step 3: Calculate temporal derivative of intermediate quantities.
+	*********************************************************************/
+	
+	calcDerivative(band,quantityStar);
+	stepBarrier.synchronize();
+	
+	/*********************************************************************
+	Step 4: Perform the final Runge-Kutta integration step, enforce
+	boundary conditions, and add or remove water.
+	*********************************************************************/
+	
+	GLfloat deposit=waterDeposit*bandStepSize;
+	bool updateWater=deposit!=0.0f||waterRates!=0;
+	for(GLsizei y=band.rowBegin;y<band.rowEnd;++y)
+		{
+		size_t rowOffset=size_t(y)*size_t(size[0]);
+		Quantity* qPtr=quantity+rowOffset;
+		const Quantity* qsPtr=quantityStar+rowOffset;
+		const Quantity* qtPtr=derivative+rowOffset;
+		const GLfloat* cbPtr=cellBathymetry+rowOffset;
+		const GLfloat* wrPtr=waterRates!=0?waterRates+rowOffset:0;
+		bool boundaryRow=y==0||y==size[1]-1;
+		for(GLsizei x=0;x<size[0];++x,++qPtr,++qsPtr,++qtPtr,++cbPtr)
+			{
+			if(dryBoundary&&(boundaryRow||x==0||x==size[0]-1))
+				{
+				/* Set the quantities to dry conditions: */
+				qPtr->w=*cbPtr;
+				qPtr->hu=qPtr->hv=0.0f;
+				}
+			else
+				{
+				/* Calculate the Runge-Kutta step: */
+				qPtr->w=(qPtr->w+qsPtr->w+qtPtr->w*bandStepSize)*0.5f;
+				qPtr->hu=(qPtr->hu+qsPtr->hu+qtPtr->hu*bandStepSize)*0.5f*att;
+				qPtr->hv=(qPtr->hv+qsPtr->hv+qtPtr->hv*bandStepSize)*0.5f*att;
+				}
+			
+			if(updateWater)
+				{
+				/* Calculate the old and new water column heights: */
+				GLfloat hOld=qPtr->w-*cbPtr;
+				GLfloat water=deposit;
+				if(wrPtr!=0)
+					water+=wrPtr[x]*bandStepSize;
+				GLfloat hNew=Math::max(hOld+water,0.0f);
+				
+				/* Update the water surface height and the partial discharges; new water is added with zero velocity, water is removed at current velocity: */
+				qPtr->w=hNew+*cbPtr;
+				if(hNew==0.0f)
+					qPtr->hu=qPtr->hv=0.0f;
+				else if(hNew<hOld)
+					{
+					qPtr->hu*=hNew/hOld;
+					qPtr->hv*=hNew/hOld;
+					}
+				}
+			}
+		}
+	
+	/* Wait until all bands have finished the simulation step: */
+	stepBarrier.synchronize();
+	
+	return true;
+	}
+
+void* CPUWaterTable::workerThreadMethod(unsigned int bandIndex)
+	{
+	/* Run simulation steps until shut down: */
+	while(runStepPasses(bandIndex))
+		;
+	
+	return 0;
+	}
+
+CPUWaterTable::CPUWaterTable(GLsizei width,GLsizei height,const GLfloat sCellSize[2],unsigned int sNumThreads)
+	:bathymetry(0),cellBathymetry(0),quantity(0),quantityStar(0),derivative(0),waterRates(0),
+	 numThreads(sNumThreads),bands(0),workerThreads(0),
+	 shutdownWorkers(false),forceMaxStepSize(false),stepSize(0.0f)
+	{
+	/* Initialize the water table size and cell size: */
+	size[0]=width;
+	size[1]=height;
+	for(int i=0;i<2;++i)
+		cellSize[i]=sCellSize[i];
+	
+	/* Initialize simulation parameters to the same defaults as WaterTable2: */
+	theta=1.3f;
+	g=9.81f;
+	epsilon=0.01f*Math::max(Math::max(cellSize[0],cellSize[1]),1.0f);
+	attenuation=127.0f/128.0f;
+	maxStepSize=1.0f;
+	waterDeposit=0.0f;
+	dryBoundary=true;
+	
+	/* Create a flat, dry simulation state at elevation zero: */
+	size_t numCells=size_t(size[0])*size_t(size[1]);
+	bathymetry=new GLfloat[size_t(size[0]-1)*size_t(size[1]-1)];
+	memset(bathymetry,0,size_t(size[0]-1)*size_t(size[1]-1)*sizeof(GLfloat));
+	cellBathymetry=new GLfloat[numCells];
+	memset(cellBathymetry,0,numCells*sizeof(GLfloat));
+	quantity=new Quantity[numCells];
+	memset(quantity,0,numCells*sizeof(Quantity));
+	quantityStar=new Quantity[numCells];
+	derivative=new Quantity[numCells];
+	
+	/* Split the grid into horizontal bands of roughly equal size, one per thread: */
+	if(numThreads<1)
+		numThreads=1;
+	if(numThreads>(unsigned int)size[1])
+		numThreads=size[1];
+	bands=new Band[numThreads];
+	for(unsigned int i=0;i<numThreads;++i)
+		{
+		bands[i].rowBegin=GLsizei((size_t(size[1])*i)/numThreads);
+		bands[i].rowEnd=GLsizei((size_t(size[1])*(i+1))/numThreads);
+		bands[i].maxStepSize=maxStepSize;
+		}
+	
+	/* Start the worker threads; the calling thread processes the first band: */
+	stepBarrier.setNumSynchronizingThreads(numThreads);
+	if(numThreads>1)
+		{
+		workerThreads=new Threads::Thread[numThreads-1];
+		for(unsigned int i=1;i<numThreads;++i)
+			workerThreads[i-1].start(this,&CPUWaterTable::workerThreadMethod,i);
+		}
+	}
+
+CPUWaterTable::~CPUWaterTable(void)
+	{
+	if(workerThreads!=0)
+		{
+		/* Shut down the worker threads: */
+		shutdownWorkers=true;
+		stepBarrier.synchronize();
+		for(unsigned int i=1;i<numThreads;++i)
+			workerThreads[i-1].join();
+		delete[] workerThreads;
+		}
+	delete[] bands;
+	
+	/* Delete the simulation grids: */
+	delete[] bathymetry;
+	delete[] cellBathymetry;
+	delete[] quantity;
+	delete[] quantityStar;
+	delete[] derivative;
+	delete[] waterRates;
+	}
+
+void CPUWaterTable::setAttenuation(GLfloat newAttenuation)
+	{
+	attenuation=newAttenuation;
+	}
+
+void CPUWaterTable::setMaxStepSize(GLfloat newMaxStepSize)
+	{
+	maxStepSize=newMaxStepSize;
+	}
+
+void CPUWaterTable::setWaterDeposit(GLfloat newWaterDeposit)
+	{
+	waterDeposit=newWaterDeposit;
+	}
+
+void CPUWaterTable::setDryBoundary(bool newDryBoundary)
+	{
+	dryBoundary=newDryBoundary;
+	}
+
+void CPUWaterTable::setWaterRates(const GLfloat* newWaterRates)
+	{
+	size_t numCells=size_t(size[0])*size_t(size[1]);
+	if(newWaterRates!=0)
+		{
+		/* Copy the new water rate grid: */
+		if(waterRates==0)
+			waterRates=new GLfloat[numCells];
+		memcpy(waterRates,newWaterRates,numCells*sizeof(GLfloat));
+		}
+	else
+		{
+		/* Remove all water sources and sinks: */
+		delete[] waterRates;
+		waterRates=0;
+		}
+	}
+
+void CPUWaterTable::updateBathymetry(const GLfloat* bathymetryGrid)
+	{
+	/* Copy the new bathymetry grid: */
+	GLsizei bw=size[0]-1;
+	GLsizei bh=size[1]-1;
+	memcpy(bathymetry,bathymetryGrid,size_t(bw)*size_t(bh)*sizeof(GLfloat));
+	
+	/* Update the cell-centered bathymetry and adjust the water surface heights to preserve water column heights: */
+	GLfloat* cbPtr=cellBathymetry;
+	Quantity* qPtr=quantity;
+	for(GLsizei y=0;y<size[1];++y)
+		{
+		const GLfloat* bRow0=bathymetry+clamp(y-1,bh-1)*bw;
+		const GLfloat* bRow1=bathymetry+clamp(y,bh-1)*bw;
+		for(GLsizei x=0;x<size[0];++x,++cbPtr,++qPtr)
+			{
+			GLsizei x0=clamp(x-1,bw-1);
+			GLsizei x1=clamp(x,bw-1);
+			GLfloat bNew=(bRow0[x0]+bRow0[x1]+bRow1[x0]+bRow1[x1])*0.25f;
+			qPtr->w=Math::max(qPtr->w-*cbPtr,0.0f)+bNew;
+			*cbPtr=bNew;
+			}
+		}
+	}
+
+void CPUWaterTable::setWaterLevel(const GLfloat* waterGrid)
+	{
+	/* Adapt the new water level to the current bathymetry and reset the partial discharges: */
+	size_t numCells=size_t(size[0])*size_t(size[1]);
+	for(size_t i=0;i<numCells;++i)
+		{
+		quantity[i].w=Math::max(waterGrid[i],cellBathymetry[i]);
+		quantity[i].hu=quantity[i].hv=0.0f;
+		}
+	}
+
+GLfloat CPUWaterTable::runSimulationStep(bool forceStepSize)
+	{
+	/* Run the simulation step on the first band while the worker threads process the others: */
+	forceMaxStepSize=forceStepSize;
+	runStepPasses(0);
+	
+	/* Return the Runge-Kutta step's step size: */
+	return stepSize;
+	}
+
+void CPUWaterTable::getWaterLevel(GLfloat* waterGrid) const
+	{
+	/* Extract the water surface elevations from the conserved quantity grid: */
+	size_t numCells=size_t(size[0])*size_t(size[1]);
+	for(size_t i=0;i<numCells;++i)
+		waterGrid[i]=quantity[i].w;
+	}
@@ -0,0 +1,137 @@
+/***********************************************************************
+CPUWaterTable - Class to simulate water flowing over a surface on the
+CPU, using the same Saint-Venant discretization as the GPU-based
+WaterTable2 class, for offline simulation on computers without
+OpenGL-capable graphics cards.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef CPUWATERTABLE_INCLUDED
+#define CPUWATERTABLE_INCLUDED
+
+#include <Threads/Thread.h>
+#include <Threads/Barrier.h>
+#include <GL/gl.h>
+
+class CPUWaterTable
+	{
+	/* Embedded classes: */
+	public:
+	struct Quantity // Structure for cell-centered conserved quantities
+		{
+		/* Elements: */
+		public:
+		GLfloat w; // Water surface elevation
+		GLfloat hu,hv; // Partial discharges in x and y
+		};
+	
+	private:
+	struct Band // Structure describing a horizontal band of grid rows processed by one thread
+		{
+		/* Elements: */
+		public:
+		GLsizei rowBegin,rowEnd; // Half-open range of grid rows processed by the thread
+		GLfloat maxStepSize; // Maximum step size gathered by the band's most recent derivative computation
+		};
+	
+	/* Elements: */
+	GLsizei size[2]; // Width and height of water table in cells
+	GLfloat cellSize[2]; // Width and height of water table cells in world coordinate units
+	GLfloat theta; // Coefficient for minmod flux-limiting differential operator
+	GLfloat g; // Gravitiational acceleration constant
+	GLfloat epsilon; // Coefficient for desingularizing division operator
+	GLfloat attenuation; // Attenuation factor for partial discharges
+	GLfloat maxStepSize; // Maximum step size for each Runge-Kutta integration step
+	GLfloat waterDeposit; // A fixed amount of water added at every iteration of the flow simulation, for evaporation etc.
+	bool dryBoundary; // Flag whether to enforce dry boundary conditions at the end of each simulation step
+	GLfloat* bathymetry; // Vertex-centered bathymetry grid of grid size minus 1
+	GLfloat* cellBathymetry; // Cell-centered bathymetry elevations derived from the vertex-centered grid
+	Quantity* quantity; // Cell-centered conserved quantity grid
+	Quantity* quantityStar; // Cell-centered conserved quantity grid after the tentative Euler step
+	Quantity* derivative; // Cell-centered temporal derivative grid
+	GLfloat* waterRates; // Optional cell-centered grid of water source and sink rates
+	
+	/* Multithreading state: */
+	unsigned int numThreads; // Number of threads executing simulation steps, including the caller's thread
+	Band* bands; // Array of row bands, one per thread
+	Threads::Thread* workerThreads; // Array of background worker threads; the caller's thread processes band 0
+	Threads::Barrier stepBarrier; // Barrier to synchronize threads between the passes of a simulation step
+	volatile bool shutdownWorkers; // Flag to shut down the worker threads
+	bool forceMaxStepSize; // Flag whether the current simulation step always uses the maximum step size
+	GLfloat stepSize; // Step size of the current simulation step
+	
+	/* Private methods: */
+	GLfloat calcDerivative(const Band& band,const Quantity* q); // Calculates the temporal derivative of the given conserved quantities for the given band; returns the band's maximum step size
+	bool runStepPasses(unsigned int bandIndex); // Runs all passes of a simulation step on the given band, synchronizing with the other threads in between; returns false if worker threads are shutting down
+	void* workerThreadMethod(unsigned int bandIndex); // Thread method for background worker threads
+	
+	/* Constructors and destructors: */
+	public:
+	CPUWaterTable(GLsizei width,GLsizei height,const GLfloat sCellSize[2],unsigned int sNumThreads =1); // Creates water table of the given size in cells, using the given number of threads
+	private:
+	CPUWaterTable(const CPUWaterTable& source); // Prohibit copy constructor
+	CPUWaterTable& operator=(const CPUWaterTable& source); // Prohibit assignment operator
+	public:
+	~CPUWaterTable(void);
+	
+	/* Methods: */
+	const GLsizei* getSize(void) const // Returns the size of the water table
+		{
+		return size;
+		}
+	const GLfloat* getCellSize(void) const // Returns the water table's cell size
+		{
+		return cellSize;
+		}
+	unsigned int getNumThreads(void) const // Returns the number of threads used to run simulation steps
+		{
+		return numThreads;
+		}
+	GLfloat getAttenuation(void) const // Returns the attenuation factor for partial discharges
+		{
+		return attenuation;
+		}
+	void setAttenuation(GLfloat newAttenuation); // Sets the attenuation factor for partial discharges
+	void setMaxStepSize(GLfloat newMaxStepSize); // Sets the maximum step size for all subsequent integration steps
+	GLfloat getWaterDeposit(void) const // Returns the current amount of water deposited on every simulation step
+		{
+		return waterDeposit;
+		}
+	void setWaterDeposit(GLfloat newWaterDeposit); // Sets the amount of deposited water
+	bool getDryBoundary(void) const // Returns true if dry boundaries are enforced after every simulation step
+		{
+		return dryBoundary;
+		}
+	void setDryBoundary(bool newDryBoundary); // Enables or disables enforcement of dry boundaries
+	void setWaterRates(const GLfloat* newWaterRates); // Sets a cell-centered grid of water source (positive) and sink (negative) rates in elevation units per second; null pointer removes all sources and sinks
+	void updateBathymetry(const GLfloat* bathymetryGrid); // Updates the bathymetry with a vertex-centered elevation grid of grid size minus 1, preserving water column heights
+	void setWaterLevel(const GLfloat* waterGrid); // Sets the current water level to the given grid, and resets flux components to zero
+	GLfloat runSimulationStep(bool forceStepSize =false); // Runs a water flow simulation step, always uses maxStepSize if flag is true (may lead to instability); returns step size taken by Runge-Kutta integration step
+	const GLfloat* getBathymetry(void) const // Returns the vertex-centered bathymetry grid
+		{
+		return bathymetry;
+		}
+	const Quantity* getQuantity(void) const // Returns the current conserved quantity grid
+		{
+		return quantity;
+		}
+	void getWaterLevel(GLfloat* waterGrid) const; // Copies the current cell-centered water surface elevations into the given grid
+	};
+
+#endif
@@ -0,0 +1,145 @@
+/***********************************************************************
+ContourLineBenchmark - Utility to measure the per-frame cost of updating
+contour lines on a synthetic sandbox surface, where a hand-sized object
+moves across otherwise static sand.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <Misc/Timer.h>
+#include <Math/Math.h>
+#include <Kinect/FrameBuffer.h>
+
+#include "Types.h"
+#include "DepthImageRenderer.h"
+#include "ContourLineExtractor.h"
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numFrames=200;
+	float contourLineDistance=0.75f;
+	unsigned int handSize=64;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"frames")==0&&i+1<argc)
+				{
+				++i;
+				numFrames=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"cld")==0&&i+1<argc)
+				{
+				++i;
+				contourLineDistance=float(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"hand")==0&&i+1<argc)
+				{
+				++i;
+				handSize=(unsigned int)(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+
+	/* Create a depth image renderer with a Kinect v1-like disparity projection, looking down at a base plane 100cm below the camera: */
+	unsigned int size[2]={640,480};
+	DepthImageRenderer dir(size);
+	PTransform::Matrix dpm=PTransform::Matrix::one;
+	double f=580.0;
+	double a=-0.0030711e-2;
+	double b=3.3309495e-2;
+	dpm(0,0)=1.0/f;
+	dpm(0,3)=-double(size[0])*0.5/f;
+	dpm(1,1)=1.0/f;
+	dpm(1,3)=-double(size[1])*0.5/f;
+	dpm(2,2)=0.0;
+	dpm(2,3)=-1.0;
+	dpm(3,2)=a;
+	dpm(3,3)=b;
+	dir.setDepthProjection(PTransform(dpm));
+	dir.setBasePlane(Plane(Vector(0,0,1),-100.0));
+	ContourLineExtractor cle(&dir);
+
+	/* Create a hilly sand surface: */
+	float* sand=new float[size[1]*size[0]];
+	for(unsigned int y=0;y<size[1];++y)
+		for(unsigned int x=0;x<size[0];++x)
+			{
+			double elevation=8.0*Math::sin(double(x)*0.021)*Math::cos(double(y)*0.017)+3.0*Math::sin(double(x+y)*0.05);
+			sand[y*size[0]+x]=float((1.0/(100.0-elevation)-b)/a);
+			}
+
+	/* Move a hand-sized bump across the sand, one new filtered frame per iteration: */
+	double setTime=0.0,extractTime=0.0,maxExtractTime=0.0;
+	double dirtyFraction=0.0;
+	size_t numVertices=0;
+	unsigned int numPartial=0;
+	for(unsigned int frame=0;frame<numFrames;++frame)
+		{
+		Kinect::FrameBuffer depthImage(size[0],size[1],size[1]*size[0]*sizeof(float));
+		float* diPtr=depthImage.getData<float>();
+		memcpy(diPtr,sand,size[1]*size[0]*sizeof(float));
+		unsigned int hx=100+(frame*3)%(size[0]-200);
+		unsigned int hy=150+(frame*2)%(size[1]-300);
+		for(unsigned int y=hy;y<hy+handSize;++y)
+			for(unsigned int x=hx;x<hx+handSize;++x)
+				diPtr[y*size[0]+x]=float((1.0/(100.0-20.0)-b)/a);
+
+		/* Hand the frame to the depth image renderer, which calculates its dirty region: */
+		unsigned int lastVersion=dir.getDepthImageVersion();
+		Misc::Timer setTimer;
+		dir.setDepthImage(depthImage);
+		setTimer.elapse();
+		setTime+=setTimer.getTime();
+
+		/* Calculate the fraction of the contour line source that has to be re-rendered: */
+		DepthImageRenderer::Box dirtyRegion;
+		if(dir.getDirtyRegion(lastVersion,dirtyRegion))
+			{
+			if(!dirtyRegion.isNull())
+				dirtyFraction+=(dirtyRegion.max[0]-dirtyRegion.min[0])*(dirtyRegion.max[1]-dirtyRegion.min[1])/double(size[1]*size[0]);
+			++numPartial;
+			}
+		else
+			dirtyFraction+=1.0;
+
+		/* Extract contour lines on the CPU: */
+		Misc::Timer extractTimer;
+		cle.extractContourLines(contourLineDistance);
+		extractTimer.elapse();
+		extractTime+=extractTimer.getTime();
+		maxExtractTime=Math::max(maxExtractTime,extractTimer.getTime());
+		numVertices+=cle.getVertices().size();
+		}
+
+	std::cout<<numFrames<<" frames, "<<numPartial<<" with partial updates"<<std::endl;
+	std::cout<<"Re-rendered contour source: "<<dirtyFraction*100.0/double(numFrames)<<"% per frame (100% without dirty regions)"<<std::endl;
+	std::cout<<"Dirty region calculation: "<<setTime*1000.0/double(numFrames)<<" ms per frame"<<std::endl;
+	std::cout<<"CPU contour extraction: "<<extractTime*1000.0/double(numFrames)<<" ms per frame, "<<maxExtractTime*1000.0<<" ms max, "<<numVertices/numFrames<<" vertices per frame"<<std::endl;
+
+	delete[] sand;
+	return 0;
+	}
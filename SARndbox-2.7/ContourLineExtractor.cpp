@@ -0,0 +1,350 @@
+/***********************************************************************
+ContourLineExtractor - Class to extract topographic contour lines from
+a depth image as polylines on the CPU, using marching squares.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "ContourLineExtractor.h"
+
+#include <Math/Math.h>
+#include <Math/Constants.h>
+#include <IO/File.h>
+#include <IO/OpenFile.h>
+#include <IO/OStream.h>
+#include <GL/gl.h>
+#include <GL/GLGeometryWrappers.h>
+#include <Kinect/FrameBuffer.h>
+#include <Kinect/LensDistortion.h>
+
+#include "DepthImageRenderer.h"
+
+/*************************************
+Methods of class ContourLineExtractor:
+*************************************/
+
+int ContourLineExtractor::getCrossing(unsigned int edgeIndex,unsigned int pixel0,unsigned int pixel1,GLfloat level,const float* depthImage)
+	{
+	/* Return an existing crossing: */
+	if(edgeCrossings[edgeIndex]>=0)
+		return edgeCrossings[edgeIndex];
+	
+	/* Create a new crossing by interpolating the edge's end points in depth image space: */
+	Crossing c;
+	c.edgeIndex=edgeIndex;
+	c.links[0]=c.links[1]=-1;
+	GLfloat t=(level-elevations[pixel0])/(elevations[pixel1]-elevations[pixel0]);
+	const GLfloat* pp0=pixelPositions+pixel0*2;
+	const GLfloat* pp1=pixelPositions+pixel1*2;
+	Point dip(pp0[0]+(pp1[0]-pp0[0])*t,pp0[1]+(pp1[1]-pp0[1])*t,depthImage[pixel0]+(depthImage[pixel1]-depthImage[pixel0])*t);
+	
+	/* Unproject the crossing into camera space: */
+	c.position=depthImageRenderer->getDepthProjection().transform(dip);
+	edgeCrossings[edgeIndex]=int(crossings.size());
+	crossings.push_back(c);
+	
+	return edgeCrossings[edgeIndex];
+	}
+
+void ContourLineExtractor::addSegment(int crossing0,int crossing1)
+	{
+	/* Link the two crossings to each other: */
+	Crossing& c0=crossings[crossing0];
+	c0.links[c0.links[0]<0?0:1]=crossing1;
+	Crossing& c1=crossings[crossing1];
+	c1.links[c1.links[0]<0?0:1]=crossing0;
+	}
+
+void ContourLineExtractor::traceContourLine(int startCrossing,GLfloat elevation)
+	{
+	Polyline pl;
+	pl.elevation=elevation;
+	pl.firstVertex=(unsigned int)(vertices.size());
+	
+	/* Follow the links between crossings until hitting an end or closing the loop: */
+	int prev=-1;
+	int current=startCrossing;
+	while(current>=0&&!visited[current])
+		{
+		const Crossing& c=crossings[current];
+		vertices.push_back(c.position);
+		visited[current]=true;
+		int next=c.links[0]!=prev?c.links[0]:c.links[1];
+		prev=current;
+		current=next;
+		}
+	if(current==startCrossing)
+		{
+		/* Close the loop: */
+		vertices.push_back(crossings[startCrossing].position);
+		}
+	
+	/* Store the contour line if it is not degenerate: */
+	pl.numVertices=(unsigned int)(vertices.size())-pl.firstVertex;
+	if(pl.numVertices>=2)
+		polylines.push_back(pl);
+	else
+		vertices.resize(pl.firstVertex);
+	}
+
+ContourLineExtractor::ContourLineExtractor(const DepthImageRenderer* sDepthImageRenderer)
+	:depthImageRenderer(sDepthImageRenderer),
+	 pixelPositions(0),elevations(0),cellLevels(0),edgeCrossings(0)
+	{
+	/* Copy the depth image size: */
+	for(int i=0;i<2;++i)
+		depthImageSize[i]=depthImageRenderer->getDepthImageSize(i);
+	unsigned int numPixels=depthImageSize[1]*depthImageSize[0];
+	
+	/* Calculate the undistorted positions of all pixel centers: */
+	const Kinect::LensDistortion& ld=depthImageRenderer->getLensDistortion();
+	pixelPositions=new GLfloat[numPixels*2];
+	GLfloat* ppPtr=pixelPositions;
+	for(unsigned int y=0;y<depthImageSize[1];++y)
+		for(unsigned int x=0;x<depthImageSize[0];++x,ppPtr+=2)
+			{
+			Kinect::LensDistortion::Point dp(Kinect::LensDistortion::Scalar(x)+Kinect::LensDistortion::Scalar(0.5),Kinect::LensDistortion::Scalar(y)+Kinect::LensDistortion::Scalar(0.5));
+			if(!ld.isIdentity())
+				dp=ld.undistortPixel(dp);
+			ppPtr[0]=GLfloat(dp[0]);
+			ppPtr[1]=GLfloat(dp[1]);
+			}
+	
+	/* Allocate the elevation, cell level range, and edge crossing arrays: */
+	elevations=new GLfloat[numPixels];
+	cellLevels=new int[(depthImageSize[1]-1)*(depthImageSize[0]-1)*2];
+	edgeCrossings=new int[numPixels*2];
+	for(unsigned int i=0;i<numPixels*2;++i)
+		edgeCrossings[i]=-1;
+	}
+
+ContourLineExtractor::~ContourLineExtractor(void)
+	{
+	delete[] pixelPositions;
+	delete[] elevations;
+	delete[] cellLevels;
+	delete[] edgeCrossings;
+	}
+
+void ContourLineExtractor::extractContourLines(GLfloat contourLineDistance)
+	{
+	vertices.clear();
+	polylines.clear();
+	
+	unsigned int w=depthImageSize[0];
+	unsigned int h=depthImageSize[1];
+	const float* depthImage=depthImageRenderer->getDepthImage().getData<float>();
+	
+	/* Calculate the equations mapping depth image-space points to base plane distances and homogeneous weights: */
+	const PTransform::Matrix& dpm=depthImageRenderer->getDepthProjection().getMatrix();
+	const Plane& basePlane=depthImageRenderer->getBasePlane();
+	const Plane::Vector& bpn=basePlane.getNormal();
+	Scalar bpo=basePlane.getOffset();
+	Scalar planeEq[4],weightEq[4];
+	for(int i=0;i<4;++i)
+		{
+		planeEq[i]=dpm(0,i)*bpn[0]+dpm(1,i)*bpn[1]+dpm(2,i)*bpn[2]-dpm(3,i)*bpo;
+		weightEq[i]=dpm(3,i);
+		}
+	
+	/* Calculate the elevations of all pixels above the base plane: */
+	const GLfloat invalidElevation=Math::Constants<GLfloat>::max;
+	const GLfloat* ppPtr=pixelPositions;
+	const float* dPtr=depthImage;
+	GLfloat* ePtr=elevations;
+	for(unsigned int i=w*h;i>0;--i,ppPtr+=2,++dPtr,++ePtr)
+		{
+		Scalar weight=weightEq[0]*ppPtr[0]+weightEq[1]*ppPtr[1]+weightEq[2]*(*dPtr)+weightEq[3];
+		Scalar elevation=(planeEq[0]*ppPtr[0]+planeEq[1]*ppPtr[1]+planeEq[2]*(*dPtr)+planeEq[3])/weight;
+		*ePtr=weight>Scalar(0)&&Math::isFinite(elevation)?GLfloat(elevation):invalidElevation;
+		}
+	
+	/* Calculate the range of contour levels crossing each grid cell, where level k lies at elevation k*contourLineDistance: */
+	GLfloat invContourLineDistance=GLfloat(1)/contourLineDistance;
+	int levelMin=Math::Constants<int>::max;
+	int levelMax=Math::Constants<int>::min;
+	int* clPtr=cellLevels;
+	for(unsigned int y=0;y<h-1;++y)
+		{
+		const GLfloat* e0Ptr=elevations+y*w;
+		const GLfloat* e1Ptr=e0Ptr+w;
+		for(unsigned int x=0;x<w-1;++x,++e0Ptr,++e1Ptr,clPtr+=2)
+			{
+			/* Find the levels L with cellMin<L<=cellMax, skipping cells with invalid corners: */
+			GLfloat cellMin=Math::min(Math::min(e0Ptr[0],e0Ptr[1]),Math::min(e1Ptr[0],e1Ptr[1]));
+			GLfloat cellMax=Math::max(Math::max(e0Ptr[0],e0Ptr[1]),Math::max(e1Ptr[0],e1Ptr[1]));
+			if(cellMax<invalidElevation)
+				{
+				/* Estimate the level range, then correct it by at most one level using the same float comparisons as the crossing test below: */
+				int l0=int(Math::floor(cellMin*invContourLineDistance))+1;
+				if(GLfloat(l0)*contourLineDistance<=cellMin)
+					++l0;
+				else if(GLfloat(l0-1)*contourLineDistance>cellMin)
+					--l0;
+				int l1=int(Math::floor(cellMax*invContourLineDistance));
+				if(GLfloat(l1)*contourLineDistance>cellMax)
+					--l1;
+				else if(GLfloat(l1+1)*contourLineDistance<=cellMax)
+					++l1;
+				clPtr[0]=l0;
+				clPtr[1]=l1;
+				if(clPtr[0]<=clPtr[1])
+					{
+					levelMin=Math::min(levelMin,clPtr[0]);
+					levelMax=Math::max(levelMax,clPtr[1]);
+					}
+				}
+			else
+				{
+				clPtr[0]=1;
+				clPtr[1]=0;
+				}
+			}
+		}
+	
+	/* Bail out if there are no or implausibly many contour levels: */
+	if(levelMin>levelMax||levelMax-levelMin>=65536)
+		return;
+	
+	/* Sort the cells by the contour levels crossing them: */
+	unsigned int numLevels=levelMax-levelMin+1;
+	levelCellOffsets.assign(numLevels+1,0U);
+	clPtr=cellLevels;
+	for(unsigned int cell=(h-1)*(w-1);cell>0;--cell,clPtr+=2)
+		for(int l=clPtr[0];l<=clPtr[1];++l)
+			++levelCellOffsets[l-levelMin+1];
+	for(unsigned int l=0;l<numLevels;++l)
+		levelCellOffsets[l+1]+=levelCellOffsets[l];
+	levelCells.resize(levelCellOffsets[numLevels]);
+	std::vector<unsigned int> levelCellEnds(levelCellOffsets.begin(),levelCellOffsets.end()-1);
+	clPtr=cellLevels;
+	for(unsigned int y=0;y<h-1;++y)
+		for(unsigned int x=0;x<w-1;++x,clPtr+=2)
+			for(int l=clPtr[0];l<=clPtr[1];++l)
+				levelCells[levelCellEnds[l-levelMin]++]=y*w+x;
+	
+	/* Process each contour level in turn: */
+	for(unsigned int l=0;l<numLevels;++l)
+		{
+		GLfloat level=GLfloat(levelMin+int(l))*contourLineDistance;
+		for(unsigned int cell=levelCellOffsets[l];cell<levelCellOffsets[l+1];++cell)
+			{
+			unsigned int v0=levelCells[cell];
+			GLfloat e[4]={elevations[v0],elevations[v0+1],elevations[v0+w+1],elevations[v0+w]};
+			
+			/* Determine which cell corners lie above the level: */
+			unsigned int pixels[4]={v0,v0+1,v0+w+1,v0+w};
+			bool above[4];
+			for(int i=0;i<4;++i)
+				above[i]=e[i]>=level;
+			
+			/* Create crossings on all cell edges that cross the level: */
+			static const int edgeCorners[4][2]={{0,1},{1,2},{3,2},{0,3}};
+			unsigned int edgeIndices[4]={v0*2,(v0+1)*2+1,(v0+w)*2,v0*2+1};
+			int c[4];
+			int numCrossings=0;
+			for(int i=0;i<4;++i)
+				{
+				int c0=edgeCorners[i][0];
+				int c1=edgeCorners[i][1];
+				if(above[c0]!=above[c1])
+					{
+					c[i]=getCrossing(edgeIndices[i],pixels[c0],pixels[c1],level,depthImage);
+					++numCrossings;
+					}
+				else
+					c[i]=-1;
+				}
+			
+			/* Connect the crossings by contour line segments, ignoring cells that don't actually cross the level: */
+			if(numCrossings==2)
+				{
+				int cs[2];
+				int numCs=0;
+				for(int i=0;i<4;++i)
+					if(c[i]>=0)
+						cs[numCs++]=c[i];
+				addSegment(cs[0],cs[1]);
+				}
+			else if(numCrossings==4)
+				{
+				/* Disambiguate the saddle using the cell center's elevation: */
+				bool centerAbove=(e[0]+e[1]+e[2]+e[3])*0.25f>=level;
+				if(above[0]==centerAbove)
+					{
+					/* Cut off the two corners that differ from the center: */
+					addSegment(c[0],c[1]);
+					addSegment(c[2],c[3]);
+					}
+				else
+					{
+					addSegment(c[3],c[0]);
+					addSegment(c[1],c[2]);
+					}
+				}
+			}
+		
+		/* Trace the level's open contour lines starting from their end points, then its closed contour lines: */
+		visited.assign(crossings.size(),false);
+		for(unsigned int i=0;i<crossings.size();++i)
+			if(!visited[i]&&crossings[i].links[1]<0)
+				traceContourLine(int(i),level);
+		for(unsigned int i=0;i<crossings.size();++i)
+			if(!visited[i])
+				traceContourLine(int(i),level);
+		
+		/* Reset the edge crossing map for the next level: */
+		for(std::vector<Crossing>::iterator cIt=crossings.begin();cIt!=crossings.end();++cIt)
+			edgeCrossings[cIt->edgeIndex]=-1;
+		crossings.clear();
+		}
+	}
+
+void ContourLineExtractor::glRenderAction(void) const
+	{
+	/* Render all contour lines as line strips: */
+	for(PolylineList::const_iterator plIt=polylines.begin();plIt!=polylines.end();++plIt)
+		{
+		glBegin(GL_LINE_STRIP);
+		VertexList::const_iterator vIt=vertices.begin()+plIt->firstVertex;
+		for(unsigned int i=0;i<plIt->numVertices;++i,++vIt)
+			glVertex(*vIt);
+		glEnd();
+		}
+	}
+
+void ContourLineExtractor::saveContourLines(const char* fileName) const
+	{
+	/* Open the output file: */
+	IO::OStream file(IO::openFile(fileName,IO::File::WriteOnly));
+	file.precision(8);
+	
+	/* Write a header: */
+	file<<"# SARndbox contour lines in camera space"<<std::endl;
+	file<<"# Each contour line: <elevation> <number of vertices>, followed by one <x> <y> <z> line per vertex"<<std::endl;
+	file<<polylines.size()<<std::endl;
+	
+	/* Write all contour lines: */
+	for(PolylineList::const_iterator plIt=polylines.begin();plIt!=polylines.end();++plIt)
+		{
+		file<<plIt->elevation<<' '<<plIt->numVertices<<std::endl;
+		VertexList::const_iterator vIt=vertices.begin()+plIt->firstVertex;
+		for(unsigned int i=0;i<plIt->numVertices;++i,++vIt)
+			file<<(*vIt)[0]<<' '<<(*vIt)[1]<<' '<<(*vIt)[2]<<std::endl;
+		}
+	}
@@ -0,0 +1,102 @@
+/***********************************************************************
+ContourLineExtractor - Class to extract topographic contour lines from
+a depth image as polylines on the CPU, using marching squares.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef CONTOURLINEEXTRACTOR_INCLUDED
+#define CONTOURLINEEXTRACTOR_INCLUDED
+
+#include <vector>
+#include <GL/gl.h>
+
+#include "Types.h"
+
+/* Forward declarations: */
+class DepthImageRenderer;
+
+class ContourLineExtractor
+	{
+	/* Embedded classes: */
+	public:
+	struct Polyline // Structure describing one extracted contour line
+		{
+		/* Elements: */
+		public:
+		GLfloat elevation; // Elevation of the contour line above the base plane
+		unsigned int firstVertex; // Index of the contour line's first vertex in the vertex list
+		unsigned int numVertices; // Number of the contour line's vertices; closed contour lines repeat their first vertex at the end
+		};
+	
+	typedef std::vector<Point> VertexList; // Type for lists of contour line vertices
+	typedef std::vector<Polyline> PolylineList; // Type for lists of contour lines
+	
+	private:
+	struct Crossing // Structure for a contour line crossing a depth image grid edge
+		{
+		/* Elements: */
+		public:
+		unsigned int edgeIndex; // Index of the grid edge on which the crossing lies
+		int links[2]; // Indices of the crossings connected to this one by contour line segments, or -1
+		Point position; // Crossing position in camera space
+		};
+	
+	/* Elements: */
+	const DepthImageRenderer* depthImageRenderer; // Renderer holding the depth image and its projection into camera space
+	unsigned int depthImageSize[2]; // Width and height of the depth image
+	GLfloat* pixelPositions; // Array of undistorted depth image-space positions of all pixel centers
+	GLfloat* elevations; // Array of elevations of all depth image pixels above the base plane
+	int* cellLevels; // Array of index ranges of contour levels crossing each grid cell
+	int* edgeCrossings; // Array mapping grid edges to contour line crossings on the current contour level, or -1
+	std::vector<unsigned int> levelCellOffsets; // Offsets of each contour level's first grid cell in the sorted grid cell list
+	std::vector<unsigned int> levelCells; // Indices of the lower-left pixels of grid cells crossed by each contour level, sorted by level
+	std::vector<Crossing> crossings; // List of contour line crossings on the current contour level
+	std::vector<bool> visited; // Flags for crossings that have already been added to a polyline
+	VertexList vertices; // List of vertices of all extracted contour lines
+	PolylineList polylines; // List of extracted contour lines
+	
+	/* Private methods: */
+	int getCrossing(unsigned int edgeIndex,unsigned int pixel0,unsigned int pixel1,GLfloat level,const float* depthImage); // Returns the index of the crossing of the given contour level on the given grid edge, creating it if necessary
+	void addSegment(int crossing0,int crossing1); // Connects two crossings by a contour line segment
+	void traceContourLine(int startCrossing,GLfloat elevation); // Appends the contour line containing the given crossing to the polyline list
+	
+	/* Constructors and destructors: */
+	public:
+	ContourLineExtractor(const DepthImageRenderer* sDepthImageRenderer); // Creates a contour line extractor for depth images of the given depth image renderer, using its current lens distortion correction
+	private:
+	ContourLineExtractor(const ContourLineExtractor& source); // Prohibit copy constructor
+	ContourLineExtractor& operator=(const ContourLineExtractor& source); // Prohibit assignment operator
+	public:
+	~ContourLineExtractor(void);
+	
+	/* Methods: */
+	void extractContourLines(GLfloat contourLineDistance); // Extracts contour lines of the given elevation spacing from the depth image renderer's current depth image
+	const VertexList& getVertices(void) const // Returns the list of contour line vertices
+		{
+		return vertices;
+		}
+	const PolylineList& getPolylines(void) const // Returns the list of contour lines
+		{
+		return polylines;
+		}
+	void glRenderAction(void) const; // Renders the extracted contour lines as line strips using current OpenGL settings
+	void saveContourLines(const char* fileName) const; // Writes the extracted contour lines to a text file
+	};
+
+#endif
@@ -0,0 +1,481 @@
+/***********************************************************************
+ControlServer - Class to receive control commands for a running
+Augmented Reality Sandbox from a named pipe and/or TCP socket, and to
+stream telemetry data back to subscribed clients.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "ControlServer.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <iostream>
+#include <Misc/StringPrintf.h>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/MessageLogger.h>
+
+namespace {
+
+/**************
+Helper objects:
+**************/
+
+const size_t maxLineLength=4096; // Maximum length of a single command line
+const double telemetryTick=0.1; // Interval between checks for due telemetry messages in seconds
+
+/****************
+Helper functions:
+****************/
+
+double toSeconds(const Threads::EventDispatcher::Time& time)
+	{
+	return double(time.tv_sec)+double(time.tv_usec)*1.0e-6;
+	}
+
+std::vector<std::string> tokenizeLine(const std::string& line)
+	{
+	std::vector<std::string> result;
+	
+	/* Extract white-space separated tokens until the end of the line: */
+	std::string::const_iterator lIt=line.begin();
+	while(true)
+		{
+		/* Skip whitespace: */
+		while(lIt!=line.end()&&isspace(*lIt))
+			++lIt;
+		if(lIt==line.end())
+			break;
+		
+		/* Find the end of the current token: */
+		std::string::const_iterator tokenStart=lIt;
+		while(lIt!=line.end()&&!isspace(*lIt))
+			++lIt;
+		
+		/* Extract the token: */
+		result.push_back(std::string(tokenStart,lIt));
+		}
+	
+	return result;
+	}
+	
+}
+
+/**************************************
+Methods of class ControlServer::Client:
+**************************************/
+
+ControlServer::Client::Client(ControlServer* sServer,unsigned int sId,Comm::TCPPipe* sPipe,int sFd)
+	:server(sServer),id(sId),pipe(sPipe),fd(sFd),
+	 telemetryInterval(0.0),nextTelemetryTime(0.0)
+	{
+	}
+
+ControlServer::Client::~Client(void)
+	{
+	/* Close the client's communication channel: */
+	if(pipe!=0)
+		delete pipe;
+	else
+		close(fd);
+	}
+
+/******************************
+Methods of class ControlServer:
+******************************/
+
+void ControlServer::disconnectClient(ControlServer::Client* client,bool removeListener)
+	{
+	/* Find the client in the client list: */
+	for(std::vector<Client*>::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+		if(*cIt==client)
+			{
+			/* Unsubscribe the client from telemetry: */
+			setTelemetryInterval(client,0.0);
+			
+			if(removeListener)
+				{
+				/* Stop watching the client's socket immediately, as the listener is only removed once the dispatcher handles the request, but the socket is closed below: */
+				dispatcher.setIOEventListenerEventTypeMaskFromCallback(client->listenerKey,0x0);
+				
+				/* Remove the client's event listener: */
+				dispatcher.removeIOEventListener(client->listenerKey);
+				}
+			
+			/* Remove the client from the list: */
+			*cIt=clients.back();
+			clients.pop_back();
+			
+			/* Disconnect the client: */
+			delete client;
+			
+			break;
+			}
+	}
+
+bool ControlServer::processInput(ControlServer::Client* client,const char* data,size_t dataSize)
+	{
+	/* Split the received data into lines, carrying over incomplete lines between reads: */
+	const char* dataEnd=data+dataSize;
+	while(data!=dataEnd)
+		{
+		/* Find the end of the current line: */
+		const char* lineEnd;
+		for(lineEnd=data;lineEnd!=dataEnd&&*lineEnd!='\n';++lineEnd)
+			;
+		
+		/* Append the current line fragment to the client's partial line: */
+		client->partialLine.append(data,lineEnd);
+		if(client->partialLine.length()>maxLineLength)
+			return false;
+		
+		if(lineEnd==dataEnd)
+			break;
+		
+		/* Process the now complete line and start a new one: */
+		processLine(client,client->partialLine);
+		client->partialLine.clear();
+		data=lineEnd+1;
+		}
+	
+	return true;
+	}
+
+void ControlServer::processLine(ControlServer::Client* client,const std::string& line)
+	{
+	/* Split the line into tokens and ignore empty lines: */
+	std::vector<std::string> tokens=tokenizeLine(line);
+	if(tokens.empty())
+		return;
+	
+	/* Handle telemetry subscriptions locally: */
+	if(strcasecmp(tokens[0].c_str(),"telemetry")==0&&client->pipe!=0)
+		{
+		if(tokens.size()==2&&strcasecmp(tokens[1].c_str(),"off")==0)
+			{
+			setTelemetryInterval(client,0.0);
+			writeLine(client,"OK telemetry");
+			}
+		else if(tokens.size()==2&&atof(tokens[1].c_str())>0.0)
+			{
+			/* Subscribe the client at the requested interval, clamped to the timer resolution: */
+			double interval=atof(tokens[1].c_str());
+			if(interval<telemetryTick)
+				interval=telemetryTick;
+			setTelemetryInterval(client,interval);
+			writeLine(client,"OK telemetry");
+			}
+		else
+			writeLine(client,"ERROR Wrong arguments for telemetry command");
+		
+		return;
+		}
+	
+	/* Queue the command for the main thread: */
+	Threads::Mutex::Lock commandLock(commandMutex);
+	commands.push_back(Command());
+	commands.back().clientId=client->id;
+	std::swap(commands.back().tokens,tokens);
+	}
+
+void ControlServer::writeLine(ControlServer::Client* client,const std::string& line)
+	{
+	if(client->pipe!=0)
+		{
+		/* Send the line to the remote client: */
+		client->pipe->writeRaw(line.data(),line.length());
+		client->pipe->write<char>('\n');
+		client->pipe->flush();
+		}
+	else if(line.compare(0,6,"ERROR ")==0)
+		{
+		/* Print error messages from control pipe commands to the console: */
+		std::cerr<<line.substr(6)<<std::endl;
+		}
+	}
+
+void ControlServer::setTelemetryInterval(ControlServer::Client* client,double newTelemetryInterval)
+	{
+	/* Update the number of subscribed clients: */
+	if(client->telemetryInterval>0.0)
+		--numSubscribers;
+	client->telemetryInterval=newTelemetryInterval;
+	if(client->telemetryInterval>0.0)
+		{
+		++numSubscribers;
+		client->nextTelemetryTime=0.0;
+		}
+	
+	/* Only run the telemetry timer while there are subscribers: */
+	if(numSubscribers>0&&!telemetryTimerActive)
+		{
+		Threads::EventDispatcher::Time interval(telemetryTick);
+		Threads::EventDispatcher::Time first=Threads::EventDispatcher::Time::now();
+		first+=interval;
+		telemetryTimerKey=dispatcher.addTimerEventListener(first,interval,telemetryTimerCallback,this);
+		telemetryTimerActive=true;
+		}
+	else if(numSubscribers==0&&telemetryTimerActive)
+		{
+		dispatcher.removeTimerEventListener(telemetryTimerKey);
+		telemetryTimerActive=false;
+		}
+	}
+
+bool ControlServer::newConnectionCallback(Threads::EventDispatcher::ListenerKey eventKey,int eventType,void* userData)
+	{
+	/* Get a pointer to the server object: */
+	ControlServer* thisPtr=static_cast<ControlServer*>(userData);
+	
+	Client* newClient=0;
+	try
+		{
+		/* Create a new client object: */
+		newClient=new Client(thisPtr,thisPtr->nextClientId,new Comm::TCPPipe(*thisPtr->listenSocket),-1);
+		++thisPtr->nextClientId;
+		
+		/* Add an event listener for incoming commands from the client: */
+		newClient->listenerKey=thisPtr->dispatcher.addIOEventListener(newClient->pipe->getFd(),Threads::EventDispatcher::Read,clientMessageCallback,newClient);
+		
+		/* Add the new client to the list: */
+		thisPtr->clients.push_back(newClient);
+		}
+	catch(const std::runtime_error& err)
+		{
+		/* Disconnect the new client: */
+		delete newClient;
+		}
+	
+	return false;
+	}
+
+bool ControlServer::clientMessageCallback(Threads::EventDispatcher::ListenerKey eventKey,int eventType,void* userData)
+	{
+	/* Get a pointer to the client object: */
+	Client* client=static_cast<Client*>(userData);
+	ControlServer* server=client->server;
+	
+	try
+		{
+		/* Read whatever data is available without blocking on a complete line: */
+		void* buffer;
+		size_t readSize=client->pipe->readInBuffer(buffer);
+		if(readSize==0)
+			{
+			/* Client closed the connection: */
+			server->disconnectClient(client,false);
+			return true;
+			}
+		
+		/* Process all data in the pipe's read buffer: */
+		if(!server->processInput(client,static_cast<const char*>(buffer),readSize))
+			throw std::runtime_error("Command line too long");
+		}
+	catch(const std::runtime_error& err)
+		{
+		/* Disconnect the client: */
+		Misc::formattedConsoleWarning("ControlServer: Disconnecting client due to exception %s",err.what());
+		server->disconnectClient(client,false);
+		
+		/* Stop listening on the client's socket: */
+		return true;
+		}
+	
+	return false;
+	}
+
+bool ControlServer::controlPipeCallback(Threads::EventDispatcher::ListenerKey eventKey,int eventType,void* userData)
+	{
+	/* Get a pointer to the client object: */
+	Client* client=static_cast<Client*>(userData);
+	ControlServer* server=client->server;
+	
+	/* Read all data currently available on the non-blocking control pipe: */
+	char buffer[1024];
+	ssize_t readResult;
+	while((readResult=read(client->fd,buffer,sizeof(buffer)))>0)
+		{
+		if(!server->processInput(client,buffer,size_t(readResult)))
+			{
+			/* Drop the overlong line: */
+			std::cerr<<"Ignoring overlong control pipe command"<<std::endl;
+			client->partialLine.clear();
+			}
+		}
+	
+	return false;
+	}
+
+bool ControlServer::telemetryTimerCallback(Threads::EventDispatcher::ListenerKey eventKey,void* userData)
+	{
+	/* Get a pointer to the server object: */
+	ControlServer* thisPtr=static_cast<ControlServer*>(userData);
+	
+	/* Lock the most recent telemetry snapshot: */
+	thisPtr->telemetry.lockNewValue();
+	const Telemetry& t=thisPtr->telemetry.getLockedValue();
+	std::string message=Misc::stringPrintf("TELEMETRY time=%.3f fps=%.2f waterSteps=%u filterLatency=%.2f hands=%u filterDrops=%u handDrops=%u contourPixels=%u contourExtraction=%.2f",t.applicationTime,t.frameRate,t.numWaterSteps,t.filterLatency*1000.0,t.numHands,t.numFilterFramesDropped,t.numHandFramesDropped,t.numContourLinePixels,t.contourLineExtractionTime*1000.0);
+	
+	/* Send the snapshot to all clients whose telemetry interval has elapsed: */
+	double now=toSeconds(thisPtr->dispatcher.getCurrentTime());
+	std::vector<Client*> deadClients;
+	for(std::vector<Client*>::iterator cIt=thisPtr->clients.begin();cIt!=thisPtr->clients.end();++cIt)
+		if((*cIt)->telemetryInterval>0.0&&(*cIt)->nextTelemetryTime<=now)
+			{
+			try
+				{
+				thisPtr->writeLine(*cIt,message);
+				}
+			catch(const std::runtime_error& err)
+				{
+				Misc::formattedConsoleWarning("ControlServer: Disconnecting client due to exception %s",err.what());
+				deadClients.push_back(*cIt);
+				}
+			
+			/* Schedule the next message, without accumulating lag: */
+			(*cIt)->nextTelemetryTime+=(*cIt)->telemetryInterval;
+			if((*cIt)->nextTelemetryTime<now)
+				(*cIt)->nextTelemetryTime=now+(*cIt)->telemetryInterval;
+			}
+	
+	/* Disconnect all dead clients: */
+	for(std::vector<Client*>::iterator dcIt=deadClients.begin();dcIt!=deadClients.end();++dcIt)
+		thisPtr->disconnectClient(*dcIt,true);
+	
+	return false;
+	}
+
+void* ControlServer::communicationThreadMethod(void)
+	{
+	/* Dispatch events on the control pipe and socket(s) until stopped by the main thread: */
+	while(dispatcher.dispatchNextEvent())
+		{
+		/* Grab all pending replies: */
+		std::vector<Reply> currentReplies;
+		{
+		Threads::Mutex::Lock replyLock(replyMutex);
+		std::swap(currentReplies,replies);
+		}
+		
+		/* Send all replies to their clients, ignoring replies to clients that have since disconnected: */
+		std::vector<Client*> deadClients;
+		for(std::vector<Reply>::iterator rIt=currentReplies.begin();rIt!=currentReplies.end();++rIt)
+			for(std::vector<Client*>::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+				if((*cIt)->id==rIt->clientId)
+					{
+					try
+						{
+						writeLine(*cIt,rIt->message);
+						}
+					catch(const std::runtime_error& err)
+						{
+						Misc::formattedConsoleWarning("ControlServer: Disconnecting client due to exception %s",err.what());
+						deadClients.push_back(*cIt);
+						}
+					break;
+					}
+		
+		/* Disconnect all dead clients: */
+		for(std::vector<Client*>::iterator dcIt=deadClients.begin();dcIt!=deadClients.end();++dcIt)
+			disconnectClient(*dcIt,true);
+		}
+	
+	return 0;
+	}
+
+ControlServer::ControlServer(const char* controlPipeName,int listenPortId)
+	:listenSocket(0),
+	 nextClientId(1),
+	 numSubscribers(0),telemetryTimerActive(false),telemetryTimerKey(0)
+	{
+	if(controlPipeName!=0&&controlPipeName[0]!='\0')
+		{
+		/* Open the control pipe in non-blocking read/write mode so that it never signals end-of-file when the last writer closes it: */
+		int controlPipeFd=open(controlPipeName,O_RDWR|O_NONBLOCK);
+		if(controlPipeFd>=0)
+			{
+			Client* pipeClient=new Client(this,0,0,controlPipeFd);
+			pipeClient->listenerKey=dispatcher.addIOEventListener(controlPipeFd,Threads::EventDispatcher::Read,controlPipeCallback,pipeClient);
+			clients.push_back(pipeClient);
+			}
+		else
+			std::cerr<<"Unable to open control pipe "<<controlPipeName<<"; ignoring"<<std::endl;
+		}
+	
+	if(listenPortId>=0)
+		{
+		/* Ignore SIGPIPE and leave handling of pipe errors to TCP sockets: */
+		struct sigaction sigPipeAction;
+		memset(&sigPipeAction,0,sizeof(struct sigaction));
+		sigPipeAction.sa_handler=SIG_IGN;
+		sigemptyset(&sigPipeAction.sa_mask);
+		sigPipeAction.sa_flags=0x0;
+		sigaction(SIGPIPE,&sigPipeAction,0);
+		
+		/* Start listening for incoming connections on the listening socket: */
+		listenSocket=new Comm::ListeningTCPSocket(listenPortId,5);
+		dispatcher.addIOEventListener(listenSocket->getFd(),Threads::EventDispatcher::Read,newConnectionCallback,this);
+		}
+	
+	/* Start the communication thread: */
+	communicationThread.start(this,&ControlServer::communicationThreadMethod);
+	}
+
+ControlServer::~ControlServer(void)
+	{
+	/* Shut down the communication thread: */
+	dispatcher.stop();
+	communicationThread.join();
+	
+	/* Disconnect all clients: */
+	for(std::vector<Client*>::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+		delete *cIt;
+	delete listenSocket;
+	}
+
+void ControlServer::getCommands(ControlServer::CommandList& newCommands)
+	{
+	newCommands.clear();
+	Threads::Mutex::Lock commandLock(commandMutex);
+	std::swap(newCommands,commands);
+	}
+
+void ControlServer::sendReply(unsigned int clientId,const std::string& message)
+	{
+	{
+	Threads::Mutex::Lock replyLock(replyMutex);
+	replies.push_back(Reply());
+	replies.back().clientId=clientId;
+	replies.back().message=message;
+	}
+	
+	/* Wake up the communication thread: */
+	dispatcher.interrupt();
+	}
+
+void ControlServer::postTelemetry(const ControlServer::Telemetry& newTelemetry)
+	{
+	telemetry.startNewValue()=newTelemetry;
+	telemetry.postNewValue();
+	}
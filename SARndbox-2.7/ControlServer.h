@@ -0,0 +1,142 @@
+/***********************************************************************
+ControlServer - Class to receive control commands for a running
+Augmented Reality Sandbox from a named pipe and/or TCP socket, and to
+stream telemetry data back to subscribed clients.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef CONTROLSERVER_INCLUDED
+#define CONTROLSERVER_INCLUDED
+
+#include <string>
+#include <vector>
+#include <Threads/Mutex.h>
+#include <Threads/Thread.h>
+#include <Threads/TripleBuffer.h>
+#include <Threads/EventDispatcher.h>
+#include <Comm/ListeningTCPSocket.h>
+#include <Comm/TCPPipe.h>
+
+class ControlServer
+	{
+	/* Embedded classes: */
+	public:
+	struct Command // Structure representing a single control command received from a client
+		{
+		/* Elements: */
+		public:
+		unsigned int clientId; // ID of the client that sent the command, to route replies back
+		std::vector<std::string> tokens; // The command's whitespace-separated tokens; first token is the command name
+		};
+	
+	typedef std::vector<Command> CommandList; // Type for lists of control commands
+	
+	struct Telemetry // Structure holding a snapshot of the AR Sandbox's run-time state
+		{
+		/* Elements: */
+		public:
+		double applicationTime; // Application time at which the snapshot was taken
+		double frameRate; // Current rendering frame rate in Hz
+		unsigned int numWaterSteps; // Number of water simulation steps run during the most recent frame
+		double filterLatency; // Time between arrival of the most recent raw depth frame and release of its filtered frame in seconds
+		unsigned int numHands; // Number of hands detected in the most recent raw depth frame
+		unsigned int numFilterFramesDropped; // Number of raw depth frames the frame filter skipped because it was busy
+		unsigned int numHandFramesDropped; // Number of raw depth frames the hand extractor skipped because it was busy
+		unsigned int numContourLinePixels; // Number of pixels re-rendered during the most recent updates of the GPU contour line source textures
+		double contourLineExtractionTime; // Time taken by the most recent CPU contour line extractions in seconds
+		
+		/* Constructors and destructors: */
+		Telemetry(void)
+			:applicationTime(0.0),frameRate(0.0),numWaterSteps(0),filterLatency(0.0),numHands(0),
+			 numFilterFramesDropped(0),numHandFramesDropped(0),
+			 numContourLinePixels(0),contourLineExtractionTime(0.0)
+			{
+			}
+		};
+	
+	private:
+	struct Client // Structure representing a connected control client, or the control pipe
+		{
+		/* Elements: */
+		public:
+		ControlServer* server; // Pointer to the control server to simplify event handling
+		unsigned int id; // Unique ID of this client; ID 0 is reserved for the control pipe
+		Comm::TCPPipe* pipe; // Pipe connected to a remote client, or null for the control pipe
+		int fd; // File descriptor of the control pipe if pipe is null
+		Threads::EventDispatcher::ListenerKey listenerKey; // Key with which this client is listening for I/O events
+		std::string partialLine; // Buffer holding the beginning of an incomplete command line
+		double telemetryInterval; // Interval between telemetry messages in seconds, or 0 if the client is not subscribed
+		double nextTelemetryTime; // Dispatcher time at which to send the next telemetry message
+		
+		/* Constructors and destructors: */
+		Client(ControlServer* sServer,unsigned int sId,Comm::TCPPipe* sPipe,int sFd);
+		~Client(void);
+		};
+	
+	struct Reply // Structure representing a reply to be sent to a client
+		{
+		/* Elements: */
+		public:
+		unsigned int clientId; // ID of the client to which to send the reply
+		std::string message; // Reply message without line terminator
+		};
+	
+	/* Elements: */
+	Threads::EventDispatcher dispatcher; // Dispatcher for events on the control pipe, the listening socket, and any connected client sockets
+	Comm::ListeningTCPSocket* listenSocket; // Socket on which to listen for incoming control connections, or null
+	std::vector<Client*> clients; // List of current clients, including the control pipe
+	unsigned int nextClientId; // ID to assign to the next connecting client
+	Threads::Mutex commandMutex; // Mutex protecting the command queue
+	CommandList commands; // Queue of commands received since the last call to getCommands
+	Threads::Mutex replyMutex; // Mutex protecting the reply queue
+	std::vector<Reply> replies; // Queue of replies to be sent by the communication thread
+	Threads::TripleBuffer<Telemetry> telemetry; // Triple buffer of telemetry snapshots posted by the main thread
+	unsigned int numSubscribers; // Number of clients currently subscribed to telemetry
+	bool telemetryTimerActive; // Flag whether the telemetry timer is running, i.e., there are subscribers
+	Threads::EventDispatcher::ListenerKey telemetryTimerKey; // Key of the telemetry timer listener while the telemetry timer is running
+	Threads::Thread communicationThread; // Thread handling communication with clients in the background
+	
+	/* Private methods: */
+	void disconnectClient(Client* client,bool removeListener); // Disconnects the given client
+	bool processInput(Client* client,const char* data,size_t dataSize); // Assembles incoming data into complete command lines; returns false if the client exceeded the maximum line length
+	void processLine(Client* client,const std::string& line); // Handles a single complete command line received from a client
+	void writeLine(Client* client,const std::string& line); // Writes a single line to the given client; throws exception on communication errors
+	void setTelemetryInterval(Client* client,double newTelemetryInterval); // Subscribes or unsubscribes the given client to or from telemetry
+	static bool newConnectionCallback(Threads::EventDispatcher::ListenerKey eventKey,int eventType,void* userData); // Callback called when a connection attempt is made at the listening socket
+	static bool clientMessageCallback(Threads::EventDispatcher::ListenerKey eventKey,int eventType,void* userData); // Callback called when data arrives from a connected client
+	static bool controlPipeCallback(Threads::EventDispatcher::ListenerKey eventKey,int eventType,void* userData); // Callback called when data arrives on the control pipe
+	static bool telemetryTimerCallback(Threads::EventDispatcher::ListenerKey eventKey,void* userData); // Callback called periodically to send telemetry to subscribed clients
+	void* communicationThreadMethod(void); // Method handling communication with clients in the background
+	
+	/* Constructors and destructors: */
+	public:
+	ControlServer(const char* controlPipeName,int listenPortId); // Creates a control server reading from the named pipe of the given name if non-empty, and listening on the given TCP port if non-negative
+	private:
+	ControlServer(const ControlServer& source); // Prohibit copy constructor
+	ControlServer& operator=(const ControlServer& source); // Prohibit assignment operator
+	public:
+	~ControlServer(void);
+	
+	/* Methods: */
+	void getCommands(CommandList& newCommands); // Replaces the given command list with all commands received since the last call; called from the main thread at the beginning of a frame
+	void sendReply(unsigned int clientId,const std::string& message); // Sends a reply message to the client of the given ID
+	void postTelemetry(const Telemetry& newTelemetry); // Posts a new telemetry snapshot from the main thread
+	};
+
+#endif
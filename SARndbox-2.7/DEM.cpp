@@ -1,7 +1,7 @@
 /***********************************************************************
 DEM - Class to represent digital elevation models (DEMs) as float-valued
 texture objects.
-Copyright (c) 2013-2016 Oliver Kreylos
+Copyright (c) 2013-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -22,8 +22,19 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "DEM.h"
 
-#include <IO/File.h>
-#include <IO/OpenFile.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string>
+#include <Misc/Endianness.h>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/MessageLogger.h>
+#include <Math/Math.h>
+#include <Math/Constants.h>
 #include <GL/gl.h>
 #include <GL/GLContextData.h>
 #include <GL/Extensions/GLARBTextureFloat.h>
@@ -32,12 +43,37 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <GL/Extensions/GLARBShaderObjects.h>
 #include <Geometry/Matrix.h>
 
+namespace {
+
+/************************************************************************
+Header of resolution pyramid cache files. The header is followed by
+pyramid levels 1 and up, each stored as a row-major array of row-major
+square tiles.
+************************************************************************/
+
+struct PyramidHeader
+	{
+	/* Elements: */
+	public:
+	char tag[16]; // File identification tag
+	Misc::SInt32 demSize[2]; // Width and height of the full-resolution DEM
+	Misc::SInt32 tileSize; // Width and height of pyramid tiles
+	Misc::SInt32 numLevels; // Number of pyramid levels, including the full-resolution DEM
+	Misc::UInt64 demFileSize; // Size of the DEM file from which the pyramid was built
+	Misc::SInt64 demFileTime; // Modification time of the DEM file from which the pyramid was built, in nanoseconds
+	};
+
+const char pyramidFileTag[16]="SARndboxDEMPyr2"; // Identification tag of resolution pyramid cache files; version 2 stores nanosecond modification times
+const size_t demFileHeaderSize=2*sizeof(Misc::SInt32)+4*sizeof(Misc::Float32); // Size of DEM file header preceding the elevation measurements
+
+}
+
 /******************************
 Methods of class DEM::DataItem:
 ******************************/
 
 DEM::DataItem::DataItem(void)
-	:textureObjectId(0)
+	:textureObjectId(0),windowVersion(0)
 	{
 	/* Check for and initialize all required OpenGL extensions: */
 	GLARBTextureFloat::initExtension();
@@ -59,21 +95,32 @@ DEM::DataItem::~DataItem(void)
 Methods of class DEM:
 ********************/
 
-void DEM::calcMatrix(void)
+PTransform DEM::calcPixelTransform(int level,const int origin[2]) const
 	{
 	/* Convert the DEM transformation into a projective transformation matrix: */
-	demTransform=PTransform(transform);
-	PTransform::Matrix& dtm=demTransform.getMatrix();
+	PTransform result(transform);
 	
-	/* Pre-multiply the projective transformation matrix with the DEM space to DEM pixel space transformation: */
+	/* Pre-multiply the projective transformation matrix with the DEM space to window pixel space transformation: */
 	PTransform dem;
-	dem.getMatrix()(0,0)=Scalar(demSize[0]-1)/(demBox[2]-demBox[0]);
-	dem.getMatrix()(0,3)=Scalar(0.5)-Scalar(demSize[0]-1)/(demBox[2]-demBox[0])*demBox[0];
-	dem.getMatrix()(1,1)=Scalar(demSize[1]-1)/(demBox[3]-demBox[1]);
-	dem.getMatrix()(1,3)=Scalar(0.5)-Scalar(demSize[1]-1)/(demBox[3]-demBox[1])*demBox[1];
+	Scalar levelScale=Scalar(1)/Scalar(1<<level);
+	for(int i=0;i<2;++i)
+		{
+		Scalar scale=Scalar(demSize[i]-1)/(demBox[2+i]-demBox[i]);
+		dem.getMatrix()(i,i)=scale*levelScale;
+		dem.getMatrix()(i,3)=(Scalar(0.5)-scale*demBox[i])*levelScale-Scalar(origin[i]);
+		}
 	dem.getMatrix()(2,2)=Scalar(1)/verticalScale;
 	dem.getMatrix()(2,3)=verticalScaleBase-verticalScaleBase/verticalScale;
-	demTransform.leftMultiply(dem);
+	result.leftMultiply(dem);
+	
+	return result;
+	}
+
+void DEM::calcMatrix(void)
+	{
+	/* Calculate the transformation from camera space to the current DEM window's pixel space: */
+	demTransform=calcPixelTransform(windowLevel,windowOrigin);
+	PTransform::Matrix& dtm=demTransform.getMatrix();
 	
 	/* Convert the full transformation to column-major OpenGL format: */
 	GLfloat* dtmPtr=demTransformMatrix;
@@ -82,17 +129,332 @@ void DEM::calcMatrix(void)
 			*dtmPtr=GLfloat(dtm(i,j));
 	}
 
+void DEM::extractRegion(int level,int x0,int y0,int width,int height,float* region) const
+	{
+	const Level& l=levels[level];
+	float* rPtr=region;
+	if(level==0)
+		{
+		/* Copy from the row-major full-resolution DEM: */
+		for(int y=0;y<height;++y)
+			{
+			const float* rowPtr=l.samples+size_t(Math::clamp(y0+y,0,l.size[1]-1))*size_t(l.size[0]);
+			for(int x=0;x<width;++x,++rPtr)
+				*rPtr=rowPtr[Math::clamp(x0+x,0,l.size[0]-1)];
+			}
+		}
+	else if(l.samples==0)
+		{
+		/* Point-sample the full-resolution DEM if the level is not cached: */
+		const Level& l0=levels[0];
+		int step=1<<level;
+		for(int y=0;y<height;++y)
+			{
+			int sy=Math::clamp(y0+y,0,l.size[1]-1)*step+step/2;
+			const float* rowPtr=l0.samples+size_t(Math::min(sy,l0.size[1]-1))*size_t(l0.size[0]);
+			for(int x=0;x<width;++x,++rPtr)
+				{
+				int sx=Math::clamp(x0+x,0,l.size[0]-1)*step+step/2;
+				*rPtr=rowPtr[Math::min(sx,l0.size[0]-1)];
+				}
+			}
+		}
+	else
+		{
+		/* Copy from the level's tiles: */
+		for(int y=0;y<height;++y)
+			{
+			int sy=Math::clamp(y0+y,0,l.size[1]-1);
+			const float* tileRowPtr=l.samples+(size_t(sy/tileSize)*size_t(l.numTiles[0])*size_t(tileSize)+size_t(sy%tileSize))*size_t(tileSize);
+			for(int x=0;x<width;++x,++rPtr)
+				{
+				int sx=Math::clamp(x0+x,0,l.size[0]-1);
+				*rPtr=tileRowPtr[size_t(sx/tileSize)*size_t(tileSize*tileSize)+size_t(sx%tileSize)];
+				}
+			}
+		return;
+		}
+	
+	#if __BYTE_ORDER==__BIG_ENDIAN
+	/* Convert samples read from the little-endian DEM file to host byte order: */
+	Misc::swapEndianness(region,size_t(width)*size_t(height));
+	#endif
+	}
+
+void DEM::buildPyramid(const char* pyramidFileName,Misc::UInt64 demFileSize,Misc::SInt64 demFileTime)
+	{
+	/* Calculate the size of the pyramid cache file: */
+	size_t pyramidFileSize=sizeof(PyramidHeader);
+	for(int level=1;level<numLevels;++level)
+		pyramidFileSize+=size_t(levels[level].numTiles[1])*size_t(levels[level].numTiles[0])*size_t(tileSize*tileSize)*sizeof(float);
+	
+	/* Create a temporary file of the required size, which will be renamed once the pyramid is complete: */
+	std::string tempFileName=pyramidFileName;
+	tempFileName.append(".tmp");
+	int fd=open(tempFileName.c_str(),O_RDWR|O_CREAT|O_TRUNC,S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	if(fd<0)
+		{
+		int error=errno;
+		Misc::throwStdErr("DEM::buildPyramid: Unable to create file %s due to error %d (%s)",tempFileName.c_str(),error,strerror(error));
+		}
+	if(ftruncate(fd,off_t(pyramidFileSize))<0)
+		{
+		int error=errno;
+		close(fd);
+		unlink(tempFileName.c_str());
+		Misc::throwStdErr("DEM::buildPyramid: Unable to resize file %s due to error %d (%s)",tempFileName.c_str(),error,strerror(error));
+		}
+	close(fd);
+	
+	try
+		{
+		/* Memory-map the temporary file: */
+		MemMappedFilePtr tempFile=new IO::MemMappedFile(tempFileName.c_str(),IO::File::ReadWrite);
+		char* tempBase=static_cast<char*>(tempFile->getMemory());
+		
+		/* Create each pyramid level by 2x2 box-filtering the next-finer level, one tile at a time: */
+		float* region=new float[4*tileSize*tileSize];
+		float* tilePtr=reinterpret_cast<float*>(tempBase+sizeof(PyramidHeader));
+		for(int level=1;level<numLevels;++level)
+			{
+			levels[level].samples=tilePtr;
+			for(int ty=0;ty<levels[level].numTiles[1];++ty)
+				for(int tx=0;tx<levels[level].numTiles[0];++tx)
+					{
+					/* Extract the tile's footprint from the next-finer level: */
+					extractRegion(level-1,tx*tileSize*2,ty*tileSize*2,tileSize*2,tileSize*2,region);
+					
+					/* Downsample the footprint into the tile: */
+					for(int y=0;y<tileSize;++y)
+						{
+						const float* r0Ptr=region+y*2*tileSize*2;
+						const float* r1Ptr=r0Ptr+tileSize*2;
+						for(int x=0;x<tileSize;++x,r0Ptr+=2,r1Ptr+=2,++tilePtr)
+							*tilePtr=(r0Ptr[0]+r0Ptr[1]+r1Ptr[0]+r1Ptr[1])*0.25f;
+						}
+					}
+			}
+		delete[] region;
+		
+		/* Write the header last to mark the pyramid as complete: */
+		PyramidHeader* header=reinterpret_cast<PyramidHeader*>(tempBase);
+		memcpy(header->tag,pyramidFileTag,sizeof(pyramidFileTag));
+		for(int i=0;i<2;++i)
+			header->demSize[i]=demSize[i];
+		header->tileSize=tileSize;
+		header->numLevels=numLevels;
+		header->demFileSize=demFileSize;
+		header->demFileTime=demFileTime;
+		}
+	catch(...)
+		{
+		/* Clean up and re-throw the exception: */
+		for(int level=1;level<numLevels;++level)
+			levels[level].samples=0;
+		unlink(tempFileName.c_str());
+		throw;
+		}
+	
+	/* The temporary file has been unmapped; invalidate the level pointers: */
+	for(int level=1;level<numLevels;++level)
+		levels[level].samples=0;
+	
+	/* Move the finished pyramid cache file into place: */
+	if(rename(tempFileName.c_str(),pyramidFileName)<0)
+		{
+		int error=errno;
+		unlink(tempFileName.c_str());
+		Misc::throwStdErr("DEM::buildPyramid: Unable to rename file %s due to error %d (%s)",tempFileName.c_str(),error,strerror(error));
+		}
+	}
+
+void DEM::loadPyramid(const char* demFileName)
+	{
+	/* Calculate the sizes and layouts of all pyramid levels: */
+	numLevels=1;
+	for(int s0=demSize[0],s1=demSize[1];s0>tileSize||s1>tileSize;s0=(s0+1)/2,s1=(s1+1)/2)
+		++numLevels;
+	levels=new Level[numLevels];
+	for(int level=0;level<numLevels;++level)
+		{
+		for(int i=0;i<2;++i)
+			{
+			levels[level].size[i]=level==0?demSize[i]:(levels[level-1].size[i]+1)/2;
+			levels[level].numTiles[i]=(levels[level].size[i]+tileSize-1)/tileSize;
+			}
+		levels[level].samples=0;
+		}
+	levels[0].samples=reinterpret_cast<const float*>(static_cast<const char*>(demFile->getMemory())+demFileHeaderSize);
+	if(numLevels==1)
+		return;
+	
+	/* Identify the DEM file by its size and modification time: */
+	std::string pyramidFileName=demFileName;
+	pyramidFileName.append(".pyramid");
+	struct stat demStat;
+	Misc::UInt64 demFileSize=demFile->getSize();
+	Misc::SInt64 demFileTime=0;
+	if(stat(demFileName,&demStat)==0)
+		{
+		/* Use the full modification time resolution to catch DEM files rewritten within the same second: */
+		#ifdef __APPLE__
+		demFileTime=Misc::SInt64(demStat.st_mtimespec.tv_sec)*1000000000LL+Misc::SInt64(demStat.st_mtimespec.tv_nsec);
+		#else
+		demFileTime=Misc::SInt64(demStat.st_mtim.tv_sec)*1000000000LL+Misc::SInt64(demStat.st_mtim.tv_nsec);
+		#endif
+		}
+	
+	/* Try twice: once to open an existing pyramid cache file, and once more after building it: */
+	for(int attempt=0;attempt<2;++attempt)
+		{
+		try
+			{
+			/* Check if there is a valid pyramid cache file for the DEM file: */
+			bool valid=false;
+			struct stat pyramidStat;
+			if(stat(pyramidFileName.c_str(),&pyramidStat)==0&&size_t(pyramidStat.st_size)>=sizeof(PyramidHeader))
+				{
+				/* Memory-map the pyramid cache file and check its header: */
+				pyramidFile=new IO::MemMappedFile(pyramidFileName.c_str());
+				const char* pyramidBase=static_cast<const char*>(pyramidFile->getMemory());
+				const PyramidHeader* header=reinterpret_cast<const PyramidHeader*>(pyramidBase);
+				valid=memcmp(header->tag,pyramidFileTag,sizeof(pyramidFileTag))==0&&header->demSize[0]==demSize[0]&&header->demSize[1]==demSize[1]&&header->tileSize==tileSize&&header->numLevels==numLevels&&header->demFileSize==demFileSize&&header->demFileTime==demFileTime;
+				
+				/* Assign the pyramid levels' tiles: */
+				size_t offset=sizeof(PyramidHeader);
+				for(int level=1;level<numLevels&&valid;++level)
+					{
+					size_t levelSize=size_t(levels[level].numTiles[1])*size_t(levels[level].numTiles[0])*size_t(tileSize*tileSize)*sizeof(float);
+					valid=offset+levelSize<=size_t(pyramidFile->getSize());
+					levels[level].samples=reinterpret_cast<const float*>(pyramidBase+offset);
+					offset+=levelSize;
+					}
+				}
+			if(valid)
+				return;
+			
+			/* Release an invalid pyramid cache file: */
+			for(int level=1;level<numLevels;++level)
+				levels[level].samples=0;
+			pyramidFile=0;
+			
+			if(attempt==0)
+				{
+				/* Build the pyramid cache file: */
+				buildPyramid(pyramidFileName.c_str(),demFileSize,demFileTime);
+				}
+			}
+		catch(const std::runtime_error& err)
+			{
+			/* Fall back to point-sampling the full-resolution DEM: */
+			for(int level=1;level<numLevels;++level)
+				levels[level].samples=0;
+			pyramidFile=0;
+			Misc::formattedConsoleWarning("DEM: Unable to create resolution pyramid for DEM file %s due to exception %s; using subsampled DEM",demFileName,err.what());
+			return;
+			}
+		}
+	}
+
+void DEM::updateWindow(void)
+	{
+	if(numLevels==0)
+		return;
+	
+	/* Find the finest pyramid level at which the region covering the domain fits into the maximum window size: */
+	int level;
+	int origin[2]={0,0};
+	int size[2]={0,0};
+	for(level=0;level<numLevels;++level)
+		{
+		const Level& l=levels[level];
+		if(haveDomain)
+			{
+			/* Calculate the bounding box of the domain in the level's pixel space: */
+			int zero[2]={0,0};
+			PTransform pixelTransform=calcPixelTransform(level,zero);
+			Scalar min[2],max[2];
+			for(int i=0;i<2;++i)
+				{
+				min[i]=Math::Constants<Scalar>::max;
+				max[i]=-Math::Constants<Scalar>::max;
+				}
+			for(int vertex=0;vertex<8;++vertex)
+				{
+				Point p=pixelTransform.transform(domain.getVertex(vertex));
+				for(int i=0;i<2;++i)
+					{
+					min[i]=Math::min(min[i],p[i]);
+					max[i]=Math::max(max[i],p[i]);
+					}
+				}
+			
+			/* Add a one-sample border for bilinear interpolation and clamp the region to the level: */
+			for(int i=0;i<2;++i)
+				{
+				origin[i]=int(Math::clamp(Math::floor(min[i])-Scalar(1),Scalar(0),Scalar(l.size[i]-1)));
+				int end=int(Math::clamp(Math::ceil(max[i])+Scalar(1),Scalar(origin[i]+1),Scalar(l.size[i])));
+				size[i]=end-origin[i];
+				}
+			}
+		else
+			{
+			/* Use the entire level: */
+			for(int i=0;i<2;++i)
+				{
+				origin[i]=0;
+				size[i]=l.size[i];
+				}
+			}
+		
+		if(size[0]<=maxWindowSize&&size[1]<=maxWindowSize)
+			break;
+		}
+	if(level==numLevels)
+		{
+		/* Crop the region on the coarsest level: */
+		--level;
+		for(int i=0;i<2;++i)
+			size[i]=Math::min(size[i],maxWindowSize);
+		}
+	
+	/* Bail out if the window did not change: */
+	if(window!=0&&level==windowLevel&&origin[0]==windowOrigin[0]&&origin[1]==windowOrigin[1]&&size[0]==windowSize[0]&&size[1]==windowSize[1])
+		return;
+	
+	/* Extract the new window: */
+	if(window==0||size[0]*size[1]!=windowSize[0]*windowSize[1])
+		{
+		delete[] window;
+		window=new float[size[1]*size[0]];
+		}
+	windowLevel=level;
+	for(int i=0;i<2;++i)
+		{
+		windowOrigin[i]=origin[i];
+		windowSize[i]=size[i];
+		}
+	extractRegion(windowLevel,windowOrigin[0],windowOrigin[1],windowSize[0],windowSize[1],window);
+	++windowVersion;
+	}
+
 DEM::DEM(void)
-	:dem(0),
+	:numLevels(0),levels(0),
+	 haveDomain(false),
+	 maxWindowSize(2048),
+	 windowLevel(0),window(0),windowVersion(0),
 	 transform(OGTransform::identity),
 	 verticalScale(1),verticalScaleBase(0)
 	{
 	demSize[0]=demSize[1]=0;
+	for(int i=0;i<2;++i)
+		windowOrigin[i]=windowSize[i]=0;
 	}
 
 DEM::~DEM(void)
 	{
-	delete[] dem;
+	delete[] levels;
+	delete[] window;
 	}
 
 void DEM::initContext(GLContextData& contextData) const
@@ -101,36 +463,77 @@ void DEM::initContext(GLContextData& contextData) const
 	DataItem* dataItem=new DataItem;
 	contextData.addDataItem(this,dataItem);
 	
-	/* Upload the DEM array into the texture object: */
+	/* Initialize the texture object; the DEM window will be uploaded on first use: */
 	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->textureObjectId);
 	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_S,GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_T,GL_CLAMP);
-	glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,0,GL_LUMINANCE32F_ARB,demSize[0],demSize[1],0,GL_LUMINANCE,GL_FLOAT,dem);
 	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
 	}
 
 void DEM::load(const char* demFileName)
 	{
-	/* Read the DEM file: */
-	IO::FilePtr demFile=IO::openFile(demFileName);
+	/* Release a previously loaded DEM: */
+	delete[] levels;
+	levels=0;
+	numLevels=0;
+	pyramidFile=0;
+	delete[] window;
+	window=0;
+	
+	/* Memory-map the DEM file and read its header: */
+	demFile=new IO::MemMappedFile(demFileName);
 	demFile->setEndianness(Misc::LittleEndian);
+	if(size_t(demFile->getSize())<demFileHeaderSize)
+		Misc::throwStdErr("DEM::load: DEM file %s is truncated",demFileName);
 	demFile->read<int>(demSize,2);
-	dem=new float[demSize[1]*demSize[0]];
 	for(int i=0;i<4;++i)
 		demBox[i]=double(demFile->read<float>());
-	demFile->read<float>(dem,demSize[1]*demSize[0]);
+	if(demSize[0]<=0||demSize[1]<=0||size_t(demFile->getSize())<demFileHeaderSize+size_t(demSize[1])*size_t(demSize[0])*sizeof(float))
+		Misc::throwStdErr("DEM::load: DEM file %s is truncated",demFileName);
+	
+	/* Load or build the DEM's resolution pyramid: */
+	loadPyramid(demFileName);
 	
-	/* Update the DEM transformation: */
+	/* Extract the initial DEM window and update the DEM transformation: */
+	updateWindow();
 	calcMatrix();
 	}
 
+void DEM::setDomain(const DEM::Box& newDomain)
+	{
+	haveDomain=true;
+	domain=newDomain;
+	
+	if(numLevels>0)
+		{
+		/* Update the DEM window and transformation: */
+		updateWindow();
+		calcMatrix();
+		}
+	}
+
+void DEM::setMaxWindowSize(int newMaxWindowSize)
+	{
+	maxWindowSize=Math::max(newMaxWindowSize,1);
+	
+	if(numLevels>0)
+		{
+		/* Update the DEM window and transformation: */
+		updateWindow();
+		calcMatrix();
+		}
+	}
+
 float DEM::calcAverageElevation(void) const
 	{
-	/* Sum all elevation measurements: */
+	if(numLevels==0)
+		return 0.0f;
+	
+	/* Sum all elevation measurements of the memory-mapped full-resolution DEM: */
 	double elevSum=0.0;
-	const float* demPtr=dem;
+	const float* demPtr=levels[0].samples;
 	for(int i=demSize[1]*demSize[0];i>0;--i,++demPtr)
 		elevSum+=double(*demPtr);
 	
@@ -144,7 +547,8 @@ void DEM::setTransform(const OGTransform& newTransform,Scalar newVerticalScale,S
 	verticalScale=newVerticalScale;
 	verticalScaleBase=newVerticalScaleBase;
 	
-	/* Update the DEM transformation: */
+	/* Update the DEM window and transformation: */
+	updateWindow();
 	calcMatrix();
 	}
 
@@ -155,6 +559,13 @@ void DEM::bindTexture(GLContextData& contextData) const
 	
 	/* Bind the DEM texture: */
 	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->textureObjectId);
+	
+	/* Upload the current DEM window if the texture object is outdated: */
+	if(dataItem->windowVersion!=windowVersion)
+		{
+		glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,0,GL_LUMINANCE32F_ARB,windowSize[0],windowSize[1],0,GL_LUMINANCE,GL_FLOAT,window);
+		dataItem->windowVersion=windowVersion;
+		}
 	}
 
 void DEM::uploadDemTransform(GLint location) const
@@ -23,6 +23,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #ifndef DEM_INCLUDED
 #define DEM_INCLUDED
 
+#include <Misc/SizedTypes.h>
+#include <Misc/Autopointer.h>
+#include <IO/MemMappedFile.h>
+#include <Geometry/Box.h>
 #include <GL/gl.h>
 #include <GL/GLObject.h>
 
@@ -31,12 +35,27 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 class DEM:public GLObject
 	{
 	/* Embedded classes: */
+	public:
+	typedef Geometry::Box<Scalar,3> Box; // Type for bounding boxes
+	
 	private:
+	typedef Misc::Autopointer<IO::MemMappedFile> MemMappedFilePtr; // Type for pointers to memory-mapped files
+	
+	struct Level // Structure describing one level of the DEM's resolution pyramid
+		{
+		/* Elements: */
+		public:
+		int size[2]; // Width and height of the level in samples
+		int numTiles[2]; // Number of tiles in x and y on tiled levels
+		const float* samples; // Pointer to the level's samples; row-major on level 0, tile by tile on higher levels; null if the level is not cached
+		};
+	
 	struct DataItem:public GLObject::DataItem
 		{
 		/* Elements: */
 		public:
 		GLuint textureObjectId; // ID of texture object holding digital elevation model
+		unsigned int windowVersion; // Version number of the DEM window currently in the texture object
 		
 		/* Constructors and destructors: */
 		DataItem(void);
@@ -45,17 +64,34 @@ class DEM:public GLObject
 	
 	/* Elements: */
 	private:
+	static const int tileSize=256; // Width and height of tiles in the resolution pyramid
 	int demSize[2]; // Width and height of the DEM grid
 	Scalar demBox[4]; // Lower-left and upper-right corner coordinates of the DEM
-	float* dem; // Array of DEM elevation measurements
+	MemMappedFilePtr demFile; // The memory-mapped DEM file
+	MemMappedFilePtr pyramidFile; // The memory-mapped resolution pyramid cache file
+	int numLevels; // Number of levels in the resolution pyramid, including the full-resolution DEM
+	Level* levels; // Array of pyramid levels
+	bool haveDomain; // Flag whether a domain for DEM window selection has been set
+	Box domain; // Camera-space region in which the DEM will be sampled
+	int maxWindowSize; // Maximum width and height of the DEM window uploaded to OpenGL
+	int windowLevel; // Pyramid level from which the current DEM window was extracted
+	int windowOrigin[2]; // Position of the current DEM window's lower-left sample in its pyramid level
+	int windowSize[2]; // Width and height of the current DEM window
+	float* window; // Array of elevation measurements in the current DEM window
+	unsigned int windowVersion; // Version number of the current DEM window
 	OGTransform transform; // Transformation from camera space to DEM space (z up)
 	Scalar verticalScale; // Vertical scale (exaggeration) factor
 	Scalar verticalScaleBase; // Base elevation around which vertical scale is applied
-	PTransform demTransform; // Full transformation matrix from camera space to DEM pixel space
-	GLfloat demTransformMatrix[16]; // Full transformation matrix from camera space to DEM pixel space to upload to OpenGL
+	PTransform demTransform; // Full transformation matrix from camera space to DEM window pixel space
+	GLfloat demTransformMatrix[16]; // Full transformation matrix from camera space to DEM window pixel space to upload to OpenGL
 	
 	/* Private methods: */
-	void calcMatrix(void); // Calculates the camera space to DEM pixel space transformation
+	PTransform calcPixelTransform(int level,const int origin[2]) const; // Returns the camera space to pixel space transformation for a window with the given origin in the given pyramid level
+	void calcMatrix(void); // Calculates the camera space to DEM window pixel space transformation
+	void extractRegion(int level,int x0,int y0,int width,int height,float* region) const; // Copies a region of the given pyramid level into the given row-major array, clamping sample positions to the level's edges
+	void buildPyramid(const char* pyramidFileName,Misc::UInt64 demFileSize,Misc::SInt64 demFileTime); // Builds the resolution pyramid cache file for the current DEM
+	void loadPyramid(const char* demFileName); // Loads or builds the resolution pyramid cache file for the given DEM file
+	void updateWindow(void); // Extracts the DEM window covering the current domain at the needed resolution
 	
 	/* Constructors and destructors: */
 	public:
@@ -66,14 +102,24 @@ class DEM:public GLObject
 	virtual void initContext(GLContextData& contextData) const;
 	
 	/* New methods: */
-	void load(const char* demFileName); // Loads the DEM from the given file
+	void load(const char* demFileName); // Loads the DEM from the given file; builds a resolution pyramid cache file next to it on first load
+	void setDomain(const Box& newDomain); // Sets the camera-space region in which the DEM will be sampled
+	int getMaxWindowSize(void) const // Returns the maximum width and height of the DEM window uploaded to OpenGL
+		{
+		return maxWindowSize;
+		}
+	void setMaxWindowSize(int newMaxWindowSize); // Sets the maximum width and height of the DEM window uploaded to OpenGL
 	const Scalar* getDemBox(void) const // Returns the DEM's bounding box as lower-left x, lower-left y, upper-right x, upper-right y
 		{
 		return demBox;
 		}
 	float calcAverageElevation(void) const; // Calculates the average elevation of the DEM
 	void setTransform(const OGTransform& newTransform,Scalar newVerticalScale,Scalar newVerticalScaleBase); // Sets the DEM transformation
-	const PTransform& getDemTransform(void) const // Returns the full transformation from camera space to vertically-scaled DEM pixel space
+	const int* getWindowSize(void) const // Returns the size of the current DEM window
+		{
+		return windowSize;
+		}
+	const PTransform& getDemTransform(void) const // Returns the full transformation from camera space to vertically-scaled DEM window pixel space
 		{
 		return demTransform;
 		}
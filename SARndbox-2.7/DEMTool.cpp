@@ -175,10 +175,16 @@ void DEMTool::configure(const Misc::ConfigurationFileSection& configFileSection)
 	
 	demVerticalShift=configFileSection.retrieveValue<Scalar>("./demVerticalShift",demVerticalShift);
 	demVerticalScale=configFileSection.retrieveValue<Scalar>("./demVerticalScale",demVerticalScale);
+	
+	/* Read the maximum size of the DEM window to keep in texture memory: */
+	setMaxWindowSize(configFileSection.retrieveValue<int>("./demMaxWindowSize",getMaxWindowSize()));
 	}
 
 void DEMTool::initialize(void)
 	{
+	/* Only extract DEM windows covering the sandbox's domain: */
+	setDomain(application->bbox);
+	
 	/* Bring up a file selection dialog if there is no pre-configured DEM file: */
 	if(demFileName.empty())
 		{
@@ -0,0 +1,298 @@
+/***********************************************************************
+DepthCalibrationRefiner - Class to continuously refine the per-pixel
+depth correction and the elevation base plane in the background, by
+observing flat reference regions of the sandbox in the raw depth stream.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "DepthCalibrationRefiner.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <Math/Math.h>
+#include <Math/Constants.h>
+#include <Math/Matrix.h>
+#include <Geometry/HVector.h>
+#include <Geometry/Matrix.h>
+
+/****************************************
+Methods of class DepthCalibrationRefiner:
+****************************************/
+
+void DepthCalibrationRefiner::calcSurfaceTerms(unsigned int x,unsigned int y,double terms[DepthCalibrationRefiner::numCoefficients]) const
+	{
+	/* Normalize the pixel center's position to [-1, 1]^2 to keep the fitting problem well-conditioned: */
+	double u=(double(x)+0.5)*2.0/double(size[0])-1.0;
+	double v=(double(y)+0.5)*2.0/double(size[1])-1.0;
+	
+	terms[0]=1.0;
+	terms[1]=u;
+	terms[2]=v;
+	terms[3]=u*u;
+	terms[4]=u*v;
+	terms[5]=v*v;
+	}
+
+bool DepthCalibrationRefiner::fitSurface(double newSurface[DepthCalibrationRefiner::numCoefficients]) const
+	{
+	/* Collect the depth-corrected mean depths of all reference pixels that were stable during accumulation: */
+	std::vector<std::pair<unsigned int,double> > samples;
+	samples.reserve(referencePixels.size());
+	const double* sbPtr=statBuffer;
+	for(std::vector<unsigned int>::const_iterator rpIt=referencePixels.begin();rpIt!=referencePixels.end();++rpIt,sbPtr+=3)
+		if(sbPtr[0]>=double(minNumSamples)&&sbPtr[2]*sbPtr[0]<=double(maxVariance)*sbPtr[0]*sbPtr[0]+sbPtr[1]*sbPtr[1])
+			samples.push_back(std::make_pair(*rpIt,double(baseDepthCorrection[*rpIt].correct(float(sbPtr[1]/sbPtr[0])))));
+	double minNumUsed=minCoverage*double(referencePixels.size());
+	
+	/* Fit twice, first to all stable pixels and then only to pixels close to the first fit, to reject objects lying on the reference surface: */
+	double maxSqrResidual=Math::Constants<double>::max;
+	for(int pass=0;pass<2;++pass)
+		{
+		/* Set up the least-squares system, regularized towards the current estimate to handle reference regions that don't constrain all coefficients: */
+		Math::Matrix ata(numCoefficients,numCoefficients,0.0);
+		Math::Matrix atb(numCoefficients,1,0.0);
+		size_t numUsed=0;
+		for(std::vector<std::pair<unsigned int,double> >::iterator sIt=samples.begin();sIt!=samples.end();++sIt)
+			{
+			double terms[numCoefficients];
+			calcSurfaceTerms(sIt->first%size[0],sIt->first/size[0],terms);
+			
+			if(pass>0)
+				{
+				/* Skip the pixel if it is too far away from the first fit: */
+				double residual=sIt->second;
+				for(int i=0;i<numCoefficients;++i)
+					residual-=newSurface[i]*terms[i];
+				if(residual*residual>maxSqrResidual)
+					continue;
+				}
+			
+			for(int i=0;i<numCoefficients;++i)
+				{
+				for(int j=0;j<numCoefficients;++j)
+					ata(i,j)+=terms[i]*terms[j];
+				atb(i,0)+=terms[i]*sIt->second;
+				}
+			++numUsed;
+			}
+		if(double(numUsed)<minNumUsed||numUsed==0)
+			return false;
+		double regularization=1.0e-3*double(numUsed);
+		for(int i=0;i<numCoefficients;++i)
+			{
+			ata(i,i)+=regularization;
+			atb(i,0)+=regularization*surface[i];
+			}
+		
+		/* Solve the least-squares system: */
+		try
+			{
+			Math::Matrix x=atb.divideFullPivot(ata);
+			for(int i=0;i<numCoefficients;++i)
+				newSurface[i]=x(i,0);
+			}
+		catch(const Math::Matrix::RankDeficientError&)
+			{
+			return false;
+			}
+		
+		if(pass==0)
+			{
+			/* Calculate the outlier threshold as three times the first fit's RMS residual: */
+			double sqrResidualSum=0.0;
+			for(std::vector<std::pair<unsigned int,double> >::iterator sIt=samples.begin();sIt!=samples.end();++sIt)
+				{
+				double terms[numCoefficients];
+				calcSurfaceTerms(sIt->first%size[0],sIt->first/size[0],terms);
+				double residual=sIt->second;
+				for(int i=0;i<numCoefficients;++i)
+					residual-=newSurface[i]*terms[i];
+				sqrResidualSum+=residual*residual;
+				}
+			maxSqrResidual=Math::max(9.0*sqrResidualSum/double(samples.size()),1.0e-6);
+			}
+		}
+	
+	return true;
+	}
+
+void DepthCalibrationRefiner::updateCalibration(void)
+	{
+	/* Create a new depth correction buffer that removes the quadratic part of the reference surface's deformation: */
+	Kinect::FrameBuffer newDepthCorrection(size[0],size[1],size[1]*size[0]*sizeof(PixelDepthCorrection));
+	PixelDepthCorrection* ndcPtr=newDepthCorrection.getData<PixelDepthCorrection>();
+	const PixelDepthCorrection* bdcPtr=baseDepthCorrection;
+	for(unsigned int y=0;y<size[1];++y)
+		for(unsigned int x=0;x<size[0];++x,++ndcPtr,++bdcPtr)
+			{
+			double terms[numCoefficients];
+			calcSurfaceTerms(x,y,terms);
+			double deformation=surface[3]*terms[3]+surface[4]*terms[4]+surface[5]*terms[5];
+			ndcPtr->scale=bdcPtr->scale;
+			ndcPtr->offset=bdcPtr->offset-float(deformation);
+			}
+	
+	/* Hand the new depth correction buffer to all consumers: */
+	depthCorrections.post(newDepthCorrection);
+	
+	/* Convert the linear part of the reference surface into a plane equation in depth image space: */
+	PTransform::HVector referencePlaneDic(2.0*surface[1]/double(size[0]),2.0*surface[2]/double(size[1]),-1.0,surface[0]-surface[1]-surface[2]);
+	
+	/* Transform the plane equation to camera space: */
+	PTransform::HVector referencePlaneCc(Geometry::invert(depthProjection.getMatrix()).transposeMultiply(referencePlaneDic));
+	Vector normal(referencePlaneCc[0],referencePlaneCc[1],referencePlaneCc[2]);
+	Scalar offset=-referencePlaneCc[3];
+	
+	/* Orient the plane like the initial base plane and normalize it: */
+	if(normal*initialBasePlane.getNormal()<Scalar(0))
+		{
+		normal=-normal;
+		offset=-offset;
+		}
+	Scalar normalMag=normal.mag();
+	normal/=normalMag;
+	offset/=normalMag;
+	
+	/* Lower the reference plane to the base plane and hand it to the consumer: */
+	basePlanes.postNewValue(Plane(normal,offset-referenceElevation));
+	++numRefinements;
+	}
+
+void* DepthCalibrationRefiner::refinerThreadMethod(void)
+	{
+	/* Run at idle priority so that refinement only ever uses otherwise unused processor time: */
+	sched_param schedParam;
+	schedParam.sched_priority=0;
+	pthread_setschedparam(pthread_self(),SCHED_IDLE,&schedParam);
+	
+	while(true)
+		{
+		/* Wait until a new frame arrives and bail out if the program is shutting down: */
+		if(!inputFrames.wait())
+			break;
+		
+		/* Accumulate the valid raw depth values of all reference pixels: */
+		inputFrames.lockNewValue();
+		const RawDepth* framePixels=inputFrames.getLockedValue().getData<RawDepth>();
+		double* sbPtr=statBuffer;
+		for(std::vector<unsigned int>::iterator rpIt=referencePixels.begin();rpIt!=referencePixels.end();++rpIt,sbPtr+=3)
+			{
+			unsigned int rawDepth=framePixels[*rpIt];
+			if(rawDepth!=0U&&rawDepth<Kinect::FrameSource::invalidDepth)
+				{
+				sbPtr[0]+=1.0; // Number of valid samples
+				sbPtr[1]+=double(rawDepth); // Sum of valid samples
+				sbPtr[2]+=double(rawDepth)*double(rawDepth); // Sum of squares of valid samples
+				}
+			}
+		
+		if(++numAccumulatedFrames>=numAccumulationFrames)
+			{
+			/* Fit a new reference surface and blend it into the current estimate: */
+			double newSurface[numCoefficients];
+			if(fitSurface(newSurface))
+				{
+				for(int i=0;i<numCoefficients;++i)
+					surface[i]+=(newSurface[i]-surface[i])*refinementRate;
+				updateCalibration();
+				}
+			
+			/* Start the next accumulation period: */
+			for(size_t i=0;i<referencePixels.size()*3;++i)
+				statBuffer[i]=0.0;
+			numAccumulatedFrames=0;
+			}
+		}
+	
+	return 0;
+	}
+
+DepthCalibrationRefiner::DepthCalibrationRefiner(const unsigned int sSize[2],const DepthCalibrationRefiner::PixelDepthCorrection* sBaseDepthCorrection,const PTransform& sDepthProjection,const Plane& sBasePlane,const std::vector<DepthCalibrationRefiner::ReferenceRegion>& referenceRegions,Scalar sReferenceElevation)
+	:baseDepthCorrection(0),
+	 depthProjection(sDepthProjection),initialBasePlane(sBasePlane),referenceElevation(sReferenceElevation),
+	 numAccumulationFrames(300),minNumSamples(150),maxVariance(4),minCoverage(0.5),refinementRate(0.1),
+	 statBuffer(0),numAccumulatedFrames(0),numRefinements(0)
+	{
+	/* Remember the frame size: */
+	for(int i=0;i<2;++i)
+		size[i]=sSize[i];
+	
+	/* Collect all pixels inside the reference regions, counting pixels covered by overlapping regions only once: */
+	std::vector<bool> isReference(size[1]*size[0],false);
+	for(std::vector<ReferenceRegion>::const_iterator rrIt=referenceRegions.begin();rrIt!=referenceRegions.end();++rrIt)
+		for(unsigned int y=rrIt->min[1];y<rrIt->max[1]&&y<size[1];++y)
+			for(unsigned int x=rrIt->min[0];x<rrIt->max[0]&&x<size[0];++x)
+				isReference[y*size[0]+x]=true;
+	for(unsigned int i=0;i<size[1]*size[0];++i)
+		if(isReference[i])
+			referencePixels.push_back(i);
+	if(referencePixels.empty())
+		throw std::runtime_error("DepthCalibrationRefiner: No reference pixels inside the depth frame");
+	
+	/* Copy the static depth correction buffer: */
+	baseDepthCorrection=new PixelDepthCorrection[size[1]*size[0]];
+	for(unsigned int i=0;i<size[1]*size[0];++i)
+		baseDepthCorrection[i]=sBaseDepthCorrection[i];
+	
+	/* Initialize the statistics buffer: */
+	statBuffer=new double[referencePixels.size()*3];
+	for(size_t i=0;i<referencePixels.size()*3;++i)
+		statBuffer[i]=0.0;
+	
+	/* Convert the reference plane, the base plane raised by the reference elevation, from camera space to depth image space: */
+	PTransform::HVector referencePlaneCc(initialBasePlane.getNormal());
+	referencePlaneCc[3]=-(initialBasePlane.getOffset()+referenceElevation*initialBasePlane.getNormal().mag());
+	PTransform::HVector referencePlaneDic(depthProjection.getMatrix().transposeMultiply(referencePlaneCc));
+	
+	/* Initialize the reference surface estimate from the reference plane's depth as a function of normalized pixel position: */
+	double hw=double(size[0])*0.5;
+	double hh=double(size[1])*0.5;
+	surface[0]=-(referencePlaneDic[0]*hw+referencePlaneDic[1]*hh+referencePlaneDic[3])/referencePlaneDic[2];
+	surface[1]=-referencePlaneDic[0]*hw/referencePlaneDic[2];
+	surface[2]=-referencePlaneDic[1]*hh/referencePlaneDic[2];
+	for(int i=3;i<numCoefficients;++i)
+		surface[i]=0.0;
+	
+	/* Start the refinement thread: */
+	refinerThread.start(this,&DepthCalibrationRefiner::refinerThreadMethod);
+	}
+
+DepthCalibrationRefiner::~DepthCalibrationRefiner(void)
+	{
+	/* Shut down the refinement thread: */
+	inputFrames.shutDown();
+	refinerThread.join();
+	
+	/* Release all allocated buffers: */
+	delete[] baseDepthCorrection;
+	delete[] statBuffer;
+	}
+
+void DepthCalibrationRefiner::setAccumulationParameters(unsigned int newNumAccumulationFrames,unsigned int newMinNumSamples,unsigned int newMaxVariance)
+	{
+	numAccumulationFrames=newNumAccumulationFrames;
+	minNumSamples=newMinNumSamples;
+	maxVariance=newMaxVariance;
+	}
+
+void DepthCalibrationRefiner::setRefinementRate(double newRefinementRate)
+	{
+	refinementRate=newRefinementRate;
+	}
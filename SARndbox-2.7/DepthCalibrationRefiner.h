@@ -0,0 +1,112 @@
+/***********************************************************************
+DepthCalibrationRefiner - Class to continuously refine the per-pixel
+depth correction and the elevation base plane in the background, by
+observing flat reference regions of the sandbox in the raw depth stream.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef DEPTHCALIBRATIONREFINER_INCLUDED
+#define DEPTHCALIBRATIONREFINER_INCLUDED
+
+#include <vector>
+#include <Threads/Thread.h>
+#include <Threads/TripleBuffer.h>
+#include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameSource.h>
+
+#include "Types.h"
+#include "BroadcastChannel.h"
+
+class DepthCalibrationRefiner
+	{
+	/* Embedded classes: */
+	public:
+	typedef unsigned short RawDepth; // Data type for raw depth values
+	typedef Kinect::FrameSource::DepthCorrection::PixelCorrection PixelDepthCorrection; // Type for per-pixel depth correction factors
+	typedef BroadcastChannel<Kinect::FrameBuffer>::Subscriber FrameSubscriber; // Type for subscribers to channels of raw depth frames
+	
+	struct ReferenceRegion // Structure describing a rectangle of depth image pixels that sees a flat, unchanging surface
+		{
+		/* Elements: */
+		public:
+		unsigned int min[2]; // Lower-left corner of the rectangle, inclusive
+		unsigned int max[2]; // Upper-right corner of the rectangle, exclusive
+		};
+	
+	static const int numCoefficients=6; // Number of coefficients of the quadratic surface fitted to the reference regions
+	
+	/* Elements: */
+	private:
+	unsigned int size[2]; // Width and height of processed frames
+	PixelDepthCorrection* baseDepthCorrection; // Static per-pixel depth correction coefficients from the camera's calibration
+	PTransform depthProjection; // Projection from depth image space into camera space
+	Plane initialBasePlane; // Base plane from the sandbox layout, used to orient refined base planes
+	Scalar referenceElevation; // Elevation of the flat reference surface above the base plane
+	std::vector<unsigned int> referencePixels; // Indices of all depth image pixels inside reference regions
+	unsigned int numAccumulationFrames; // Number of frames to accumulate before each refinement step
+	unsigned int minNumSamples; // Minimum number of valid samples for a reference pixel to take part in a refinement step
+	unsigned int maxVariance; // Maximum variance of a reference pixel's raw depth values to take part in a refinement step
+	double minCoverage; // Minimum fraction of reference pixels that must take part in a refinement step
+	double refinementRate; // Weight of each new estimate when blending it into the current calibration
+	FrameSubscriber inputFrames; // Latest-value slot receiving raw depth frames
+	Threads::Thread refinerThread; // The background refinement thread
+	double* statBuffer; // Number of valid samples, sum, and sum of squares of raw depth values for each reference pixel
+	unsigned int numAccumulatedFrames; // Number of frames accumulated since the last refinement step
+	double surface[numCoefficients]; // Current estimate of the reference surface's corrected depth as a quadratic function of normalized depth image position
+	unsigned int numRefinements; // Number of refinement steps that updated the calibration
+	BroadcastChannel<Kinect::FrameBuffer> depthCorrections; // Channel broadcasting refined per-pixel depth correction buffers
+	Threads::TripleBuffer<Plane> basePlanes; // Triple buffer of refined base planes
+	
+	/* Private methods: */
+	void calcSurfaceTerms(unsigned int x,unsigned int y,double terms[numCoefficients]) const; // Calculates the quadratic surface's basis functions at the given pixel
+	bool fitSurface(double newSurface[numCoefficients]) const; // Fits a quadratic surface to the accumulated reference pixels; returns false if there are not enough stable pixels
+	void updateCalibration(void); // Publishes a new depth correction buffer and base plane based on the current surface estimate
+	void* refinerThreadMethod(void); // Method for the background refinement thread
+	
+	/* Constructors and destructors: */
+	public:
+	DepthCalibrationRefiner(const unsigned int sSize[2],const PixelDepthCorrection* sBaseDepthCorrection,const PTransform& sDepthProjection,const Plane& sBasePlane,const std::vector<ReferenceRegion>& referenceRegions,Scalar sReferenceElevation); // Creates a refiner for frames of the given size and the given static calibration, with reference regions whose surface lies at the given elevation above the base plane
+	~DepthCalibrationRefiner(void); // Destroys the refiner
+	
+	/* Methods: */
+	void setAccumulationParameters(unsigned int newNumAccumulationFrames,unsigned int newMinNumSamples,unsigned int newMaxVariance); // Sets the number of frames per refinement step and the stability criteria for reference pixels
+	void setRefinementRate(double newRefinementRate); // Sets the weight of each new estimate when blending it into the current calibration
+	FrameSubscriber& getRawFrameSubscriber(void) // Returns the slot receiving raw depth frames, to subscribe it to a channel
+		{
+		return inputFrames;
+		}
+	BroadcastChannel<Kinect::FrameBuffer>& getDepthCorrectionChannel(void) // Returns the channel broadcasting refined per-pixel depth correction buffers, to subscribe consumers
+		{
+		return depthCorrections;
+		}
+	bool lockNewBasePlane(void) // Locks the most recently refined base plane; returns true if the locked base plane is new
+		{
+		return basePlanes.lockNewValue();
+		}
+	const Plane& getLockedBasePlane(void) const // Returns the most recently locked base plane
+		{
+		return basePlanes.getLockedValue();
+		}
+	unsigned int getNumRefinements(void) const // Returns the number of refinement steps that updated the calibration
+		{
+		return numRefinements;
+		}
+	};
+
+#endif
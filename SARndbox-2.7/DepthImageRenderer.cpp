@@ -23,6 +23,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "DepthImageRenderer.h"
 
+#include <Math/Math.h>
+#include <Math/Constants.h>
 #include <GL/gl.h>
 #include <GL/GLVertexArrayParts.h>
 #include <GL/GLContextData.h>
@@ -77,6 +79,94 @@ DepthImageRenderer::DataItem::~DataItem(void)
 Methods of class DepthImageRenderer:
 ***********************************/
 
+void DepthImageRenderer::invalidateDepthImage(void)
+	{
+	/* Start a new depth image version that marks the entire depth image as changed: */
+	++depthImageVersion;
+	dirtyRegions[depthImageVersion%numDirtyRegions].full=true;
+	}
+
+void DepthImageRenderer::calcDirtyRegion(const Kinect::FrameBuffer& newDepthImage,DepthImageRenderer::DirtyRegion& dirtyRegion) const
+	{
+	const float* oldImage=depthImage.getData<float>();
+	const float* newImage=newDepthImage.getData<float>();
+	
+	/* Consider everything changed if the new depth image shares the current image's pixel buffer: */
+	dirtyRegion.full=oldImage==newImage;
+	dirtyRegion.box=Box::empty;
+	if(dirtyRegion.full)
+		return;
+	
+	/* Find the bounding rectangle of all pixels that changed: */
+	int w=int(depthImageSize[0]);
+	int h=int(depthImageSize[1]);
+	int min[2]={w,h};
+	int max[2]={-1,-1};
+	const float* oPtr=oldImage;
+	const float* nPtr=newImage;
+	for(int y=0;y<h;++y)
+		for(int x=0;x<w;++x,++oPtr,++nPtr)
+			if(*oPtr!=*nPtr)
+				{
+				if(min[0]>x)
+					min[0]=x;
+				if(max[0]<x)
+					max[0]=x;
+				if(min[1]>y)
+					min[1]=y;
+				max[1]=y;
+				}
+	if(max[0]<0)
+		return;
+	
+	/* Extend the rectangle by one pixel to cover all triangles touching changed pixels: */
+	int size[2]={w,h};
+	for(int i=0;i<2;++i)
+		{
+		min[i]=Math::max(min[i]-1,0);
+		max[i]=Math::min(max[i]+1,size[i]-1);
+		}
+	
+	/* Calculate the range of old and new depth values inside the rectangle: */
+	float depthMin=Math::Constants<float>::max;
+	float depthMax=-Math::Constants<float>::max;
+	for(int y=min[1];y<=max[1];++y)
+		{
+		oPtr=oldImage+y*w+min[0];
+		nPtr=newImage+y*w+min[0];
+		for(int x=min[0];x<=max[0];++x,++oPtr,++nPtr)
+			{
+			depthMin=Math::min(depthMin,Math::min(*oPtr,*nPtr));
+			depthMax=Math::max(depthMax,Math::max(*oPtr,*nPtr));
+			}
+		}
+	
+	/* Transform the rectangle's corners and edge midpoints into undistorted depth image space: */
+	Kinect::LensDistortion::Scalar xs[3],ys[3];
+	xs[0]=Kinect::LensDistortion::Scalar(min[0]);
+	xs[2]=Kinect::LensDistortion::Scalar(max[0]+1);
+	xs[1]=Math::mid(xs[0],xs[2]);
+	ys[0]=Kinect::LensDistortion::Scalar(min[1]);
+	ys[2]=Kinect::LensDistortion::Scalar(max[1]+1);
+	ys[1]=Math::mid(ys[0],ys[2]);
+	for(int yi=0;yi<3;++yi)
+		for(int xi=0;xi<3;++xi)
+			{
+			Kinect::LensDistortion::Point dp(xs[xi],ys[yi]);
+			if(!lensDistortion.isIdentity())
+				dp=lensDistortion.undistortPixel(dp);
+			dirtyRegion.box.addPoint(Point(dp[0],dp[1],depthMin));
+			dirtyRegion.box.addPoint(Point(dp[0],dp[1],depthMax));
+			}
+	
+	/* Add a safety margin of one pixel to account for the non-linearity of lens distortion correction: */
+	for(int i=0;i<2;++i)
+		{
+		dirtyRegion.box.min[i]-=Scalar(1);
+		dirtyRegion.box.max[i]+=Scalar(1);
+		}
+	}
+
 DepthImageRenderer::DepthImageRenderer(const unsigned int sDepthImageSize[2])
 	:depthImageVersion(0)
 	{
@@ -91,6 +181,10 @@ DepthImageRenderer::DepthImageRenderer(const unsigned int sDepthImageSize[2])
 		for(unsigned int x=0;x<depthImageSize[0];++x,++diPtr)
 			*diPtr=0.0f;
 	++depthImageVersion;
+	
+	/* Mark the entire depth image as changed for all retained versions: */
+	for(unsigned int i=0;i<numDirtyRegions;++i)
+		dirtyRegions[i].full=true;
 	}
 
 void DepthImageRenderer::initContext(GLContextData& contextData) const
@@ -212,6 +306,9 @@ void DepthImageRenderer::setBasePlane(const Plane& newBasePlane)
 	/* Set the base plane: */
 	basePlane=newBasePlane;
 	
+	/* Mark the entire depth image as changed: */
+	invalidateDepthImage();
+	
 	/* Transform the base plane to depth image space and into a GLSL-compatible format: */
 	const PTransform::Matrix& dpm=depthProjection.getMatrix();
 	const Plane::Vector& bpn=basePlane.getNormal();
@@ -222,11 +319,33 @@ void DepthImageRenderer::setBasePlane(const Plane& newBasePlane)
 
 void DepthImageRenderer::setDepthImage(const Kinect::FrameBuffer& newDepthImage)
 	{
+	/* Calculate the part of the depth image that changed: */
+	calcDirtyRegion(newDepthImage,dirtyRegions[(depthImageVersion+1)%numDirtyRegions]);
+	
 	/* Update the depth image: */
 	depthImage=newDepthImage;
 	++depthImageVersion;
 	}
 
+bool DepthImageRenderer::getDirtyRegion(unsigned int sinceVersion,DepthImageRenderer::Box& dirtyRegion) const
+	{
+	/* Bail out if the requested version is too old: */
+	if(depthImageVersion-sinceVersion>=numDirtyRegions)
+		return false;
+	
+	/* Combine the dirty regions of all depth image versions after the requested one: */
+	dirtyRegion=Box::empty;
+	for(unsigned int version=sinceVersion+1;version-1!=depthImageVersion;++version)
+		{
+		const DirtyRegion& dr=dirtyRegions[version%numDirtyRegions];
+		if(dr.full)
+			return false;
+		dirtyRegion.addBox(dr.box);
+		}
+	
+	return true;
+	}
+
 Scalar DepthImageRenderer::intersectLine(const Point& p0,const Point& p1,Scalar elevationMin,Scalar elevationMax) const
 	{
 	/* Initialize the line segment: */
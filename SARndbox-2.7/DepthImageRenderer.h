@@ -24,6 +24,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #ifndef DEPTHIMAGERENDERER_INCLUDED
 #define DEPTHIMAGERENDERER_INCLUDED
 
+#include <Geometry/Box.h>
 #include <GL/gl.h>
 #include <GL/Extensions/GLARBShaderObjects.h>
 #include <GL/GLObject.h>
@@ -36,9 +37,20 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 class DepthImageRenderer:public GLObject
 	{
 	/* Embedded classes: */
+	public:
+	typedef Geometry::Box<Scalar,3> Box; // Type for bounding boxes
+	
 	private:
 	typedef GLGeometry::Vertex<void,0,void,0,void,GLfloat,2> Vertex; // Type for template vertices
 	
+	struct DirtyRegion // Structure describing the part of the depth image that changed in one depth image version
+		{
+		/* Elements: */
+		public:
+		bool full; // Flag whether the entire depth image has to be considered changed
+		Box box; // Bounding box of the changed part in undistorted depth image space, including old and new depth values
+		};
+	
 	struct DataItem:public GLObject::DataItem // Structure storing per-context OpenGL state
 		{
 		/* Elements: */
@@ -73,6 +85,12 @@ class DepthImageRenderer:public GLObject
 	/* Transient state: */
 	Kinect::FrameBuffer depthImage; // The most recent float-pixel depth image
 	unsigned int depthImageVersion; // Version number of the depth image
+	static const unsigned int numDirtyRegions=8; // Number of depth image versions for which dirty regions are retained
+	DirtyRegion dirtyRegions[numDirtyRegions]; // Ring buffer of dirty regions of the most recent depth image versions, indexed by version number
+	
+	/* Private methods: */
+	void invalidateDepthImage(void); // Marks the entire depth image as changed after a change to the depth image's geometry
+	void calcDirtyRegion(const Kinect::FrameBuffer& newDepthImage,DirtyRegion& dirtyRegion) const; // Calculates the part of the current depth image that differs in the given new depth image
 	
 	/* Constructors and destructors: */
 	public:
@@ -94,6 +112,10 @@ class DepthImageRenderer:public GLObject
 		{
 		return depthProjection;
 		}
+	const Kinect::LensDistortion& getLensDistortion(void) const // Returns the 2D lens distortion parameters
+		{
+		return lensDistortion;
+		}
 	const Plane& getBasePlane(void) const // Returns the elevation base plane
 		{
 		return basePlane;
@@ -103,10 +125,15 @@ class DepthImageRenderer:public GLObject
 	void setBasePlane(const Plane& newBasePlane); // Sets a new base plane for elevation rendering
 	void setDepthImage(const Kinect::FrameBuffer& newDepthImage); // Sets a new depth image for subsequent surface rendering
 	Scalar intersectLine(const Point& p0,const Point& p1,Scalar elevationMin,Scalar elevationMax) const; // Intersects a line segment with the current depth image in camera space; returns intersection point's parameter along line
+	const Kinect::FrameBuffer& getDepthImage(void) const // Returns the current depth image
+		{
+		return depthImage;
+		}
 	unsigned int getDepthImageVersion(void) const // Returns the version number of the current depth image
 		{
 		return depthImageVersion;
 		}
+	bool getDirtyRegion(unsigned int sinceVersion,Box& dirtyRegion) const; // Returns the bounding box in undistorted depth image space of the part of the depth image that changed since the given version; returns false if the entire depth image has to be considered changed
 	void uploadDepthProjection(GLint location) const; // Uploads the depth unprojection matrix into the GLSL 4x4 matrix at the given uniform location
 	void bindDepthTexture(GLContextData& contextData) const; // Binds the up-to-date depth texture image to the currently active texture unit
 	void renderSurfaceTemplate(GLContextData& contextData) const; // Renders the template quad strip mesh using current OpenGL settings
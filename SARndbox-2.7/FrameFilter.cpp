@@ -2,7 +2,7 @@
 FrameFilter - Class to filter streams of depth frames arriving from a
 depth camera, with code to detect unstable values in each pixel, and
 fill holes resulting from invalid samples.
-Copyright (c) 2012-2016 Oliver Kreylos
+Copyright (c) 2012-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -33,26 +33,19 @@ Methods of class FrameFilter:
 
 void* FrameFilter::filterThreadMethod(void)
 	{
-	unsigned int lastInputFrameVersion=0;
-	
 	while(true)
 		{
-		Kinect::FrameBuffer frame;
-		{
-		Threads::MutexCond::Lock inputLock(inputCond);
-		
-		/* Wait until a new frame arrives or the program shuts down: */
-		while(runFilterThread&&lastInputFrameVersion==inputFrameVersion)
-			inputCond.wait(inputLock);
-		
-		/* Bail out if the program is shutting down: */
-		if(!runFilterThread)
+		/* Wait until a new frame arrives and bail out if the program is shutting down: */
+		if(!inputFrames.wait())
 			break;
 		
-		/* Work on the new frame: */
-		frame=inputFrame;
-		lastInputFrameVersion=inputFrameVersion;
-		}
+		/* Work on the new frame, which stays locked until the next iteration: */
+		inputFrames.lockNewValue();
+		const Kinect::FrameBuffer& inputFrame=inputFrames.getLockedValue();
+		
+		/* Switch to the most recent refined depth correction buffer if a new one arrived: */
+		if(depthCorrections.lockNewValue())
+			pixelDepthCorrection=depthCorrections.getLockedValue().getData<PixelDepthCorrection>();
 		
 		/* Prepare a new output frame: */
 		Kinect::FrameBuffer& newOutputFrame=outputFrames.startNewValue();
@@ -218,9 +211,6 @@ FrameFilter::FrameFilter(const unsigned int sSize[2],unsigned int sNumAveragingS
 	for(int i=0;i<2;++i)
 		size[i]=sSize[i];
 	
-	/* Initialize the input frame slot: */
-	inputFrameVersion=0;
-	
 	/* Initialize the valid depth range: */
 	setValidDepthInterval(0U,2046U);
 	
@@ -270,18 +260,13 @@ FrameFilter::FrameFilter(const unsigned int sSize[2],unsigned int sNumAveragingS
 		outputFrames.getBuffer(i)=Kinect::FrameBuffer(size[0],size[1],size[1]*size[0]*sizeof(float));
 	
 	/* Start the filtering thread: */
-	runFilterThread=true;
 	filterThread.start(this,&FrameFilter::filterThreadMethod);
 	}
 
 FrameFilter::~FrameFilter(void)
 	{
 	/* Shut down the filtering thread: */
-	{
-	Threads::MutexCond::Lock inputLock(inputCond);
-	runFilterThread=false;
-	inputCond.signal();
-	}
+	inputFrames.shutDown();
 	filterThread.join();
 	
 	/* Release all allocated buffers: */
@@ -354,15 +339,3 @@ void FrameFilter::setOutputFrameFunction(FrameFilter::OutputFrameFunction* newOu
 	delete outputFrameFunction;
 	outputFrameFunction=newOutputFrameFunction;
 	}
-
-void FrameFilter::receiveRawFrame(const Kinect::FrameBuffer& newFrame)
-	{
-	Threads::MutexCond::Lock inputLock(inputCond);
-	
-	/* Store the new buffer in the input buffer: */
-	inputFrame=newFrame;
-	++inputFrameVersion;
-	
-	/* Signal the background thread: */
-	inputCond.signal();
-	}
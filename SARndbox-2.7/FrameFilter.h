@@ -2,7 +2,7 @@
 FrameFilter - Class to filter streams of depth frames arriving from a
 depth camera, with code to detect unstable values in each pixel, and
 fill holes resulting from invalid samples.
-Copyright (c) 2012-2016 Oliver Kreylos
+Copyright (c) 2012-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -25,12 +25,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define FRAMEFILTER_INCLUDED
 
 #include <Threads/Thread.h>
-#include <Threads/MutexCond.h>
 #include <Threads/TripleBuffer.h>
 #include <Kinect/FrameBuffer.h>
 #include <Kinect/FrameSource.h>
 
 #include "Types.h"
+#include "BroadcastChannel.h"
 
 /* Forward declarations: */
 namespace Misc {
@@ -46,15 +46,14 @@ class FrameFilter
 	typedef float FilteredDepth; // Data type for filtered depth values
 	typedef Misc::FunctionCall<const Kinect::FrameBuffer&> OutputFrameFunction; // Type for functions called when a new output frame is ready
 	typedef Kinect::FrameSource::DepthCorrection::PixelCorrection PixelDepthCorrection; // Type for per-pixel depth correction factors
+	typedef BroadcastChannel<Kinect::FrameBuffer>::Subscriber FrameSubscriber; // Type for subscribers to channels of raw depth frames
 	
 	/* Elements: */
 	private:
 	unsigned int size[2]; // Width and height of processed frames
 	const PixelDepthCorrection* pixelDepthCorrection; // Buffer of per-pixel depth correction coefficients
-	Threads::MutexCond inputCond; // Condition variable to signal arrival of a new input frame
-	Kinect::FrameBuffer inputFrame; // The most recent input frame
-	unsigned int inputFrameVersion; // Version number of input frame
-	volatile bool runFilterThread; // Flag to keep the background filtering thread running
+	FrameSubscriber inputFrames; // Latest-value slot receiving raw depth frames
+	FrameSubscriber depthCorrections; // Latest-value slot receiving refined per-pixel depth correction buffers
 	Threads::Thread filterThread; // The background filtering thread
 	float minPlane[4]; // Plane equation of the lower bound of valid depth values in depth image space
 	float maxPlane[4]; // Plane equation of the upper bound of valid depth values in depth image space
@@ -89,7 +88,18 @@ class FrameFilter
 	void setInstableValue(float newInstableValue); // Sets the depth value to assign to instable pixels
 	void setSpatialFilter(bool newSpatialFilter); // Sets the spatial filtering flag
 	void setOutputFrameFunction(OutputFrameFunction* newOutputFrameFunction); // Sets the output function; adopts given functor object
-	void receiveRawFrame(const Kinect::FrameBuffer& newFrame); // Called to receive a new raw depth frame
+	FrameSubscriber& getRawFrameSubscriber(void) // Returns the slot receiving raw depth frames, to subscribe it to a channel
+		{
+		return inputFrames;
+		}
+	void receiveRawFrame(const Kinect::FrameBuffer& newFrame) // Called to receive a new raw depth frame directly
+		{
+		inputFrames.post(newFrame);
+		}
+	FrameSubscriber& getDepthCorrectionSubscriber(void) // Returns the slot receiving refined per-pixel depth correction buffers, to subscribe it to a channel
+		{
+		return depthCorrections;
+		}
 	bool lockNewFrame(void) // Locks the most recently produced output frame for reading; returns true if the locked frame is new
 		{
 		return outputFrames.lockNewValue();
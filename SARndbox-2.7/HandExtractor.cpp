@@ -1,6 +1,6 @@
 /***********************************************************************
 HandExtractor - Class to identify hands from a depth image.
-Copyright (c) 2015-2016 Oliver Kreylos
+Copyright (c) 2015-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -230,26 +230,15 @@ Methods of class HandExtractor:
 
 void* HandExtractor::extractorThreadMethod(void)
 	{
-	unsigned int lastInputFrameVersion=0;
-	
 	while(true)
 		{
-		Kinect::FrameBuffer frame;
-		{
-		Threads::MutexCond::Lock inputLock(inputCond);
-		
-		/* Wait until a new frame arrives or the program shuts down: */
-		while(runExtractorThread&&lastInputFrameVersion==inputFrameVersion)
-			inputCond.wait(inputLock);
-		
-		/* Bail out if the program is shutting down: */
-		if(!runExtractorThread)
+		/* Wait until a new frame arrives and bail out if the program is shutting down: */
+		if(!inputFrames.wait())
 			break;
 		
-		/* Work on the new frame: */
-		frame=inputFrame;
-		lastInputFrameVersion=inputFrameVersion;
-		}
+		/* Work on the new frame, which stays locked until the next iteration: */
+		inputFrames.lockNewValue();
+		const Kinect::FrameBuffer& frame=inputFrames.getLockedValue();
 		
 		/* Prepare a new output hand list: */
 		HandList& newHandList=extractedHands.startNewValue();
@@ -270,7 +259,6 @@ void* HandExtractor::extractorThreadMethod(void)
 
 HandExtractor::HandExtractor(const unsigned int sDepthFrameSize[2],const HandExtractor::PixelDepthCorrection* sPixelDepthCorrection,const PTransform& sDepthProjection)
 	:pixelDepthCorrection(sPixelDepthCorrection),depthProjection(sDepthProjection),
-	 inputFrameVersion(0),runExtractorThread(false),
 	 maxFgDepth(0x07ffU-1U),maxDepthDist(1),minBlobSize(1500),maxBlobSize(150000),
 	 blobIdImage(0),
 	 snakeLength(50),snake(0),
@@ -305,18 +293,13 @@ HandExtractor::HandExtractor(const unsigned int sDepthFrameSize[2],const HandExt
 	setSnakeLength(snakeLength);
 	
 	/* Start the hand extraction thread: */
-	runExtractorThread=true;
 	extractorThread.start(this,&HandExtractor::extractorThreadMethod);
 	}
 
 HandExtractor::~HandExtractor(void)
 	{
 	/* Shut down the extraction thread: */
-	{
-	Threads::MutexCond::Lock inputLock(inputCond);
-	runExtractorThread=false;
-	inputCond.signal();
-	}
+	inputFrames.shutDown();
 	extractorThread.join();
 	
 	delete[] blobIdImage;
@@ -891,15 +874,3 @@ void HandExtractor::setHandsExtractedFunction(HandExtractor::HandsExtractedFunct
 	delete handsExtractedFunction;
 	handsExtractedFunction=newHandsExtractedFunction;
 	}
-
-void HandExtractor::receiveRawFrame(const Kinect::FrameBuffer& newFrame)
-	{
-	Threads::MutexCond::Lock inputLock(inputCond);
-	
-	/* Store the new buffer in the input buffer: */
-	inputFrame=newFrame;
-	++inputFrameVersion;
-	
-	/* Signal the background thread: */
-	inputCond.signal();
-	}
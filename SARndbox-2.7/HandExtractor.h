@@ -1,6 +1,6 @@
 /***********************************************************************
 HandExtractor - Class to identify hands from a depth image.
-Copyright (c) 2015-2016 Oliver Kreylos
+Copyright (c) 2015-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -26,13 +26,13 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <vector>
 #include <Misc/SizedTypes.h>
 #include <Threads/Thread.h>
-#include <Threads/MutexCond.h>
 #include <Threads/TripleBuffer.h>
 #include <Images/RGBImage.h>
 #include <Kinect/FrameBuffer.h>
 #include <Kinect/FrameSource.h>
 
 #include "Types.h"
+#include "BroadcastChannel.h"
 
 /* Forward declarations: */
 namespace Misc {
@@ -46,6 +46,7 @@ class HandExtractor
 	public:
 	typedef Misc::UInt16 DepthPixel; // Type for depth frame pixels
 	typedef Kinect::FrameSource::DepthCorrection::PixelCorrection PixelDepthCorrection; // Type for per-pixel depth correction factors
+	typedef BroadcastChannel<Kinect::FrameBuffer>::Subscriber FrameSubscriber; // Type for subscribers to channels of raw depth frames
 	
 	struct Hand // Structure to report detected hand positions
 		{
@@ -73,10 +74,7 @@ class HandExtractor
 	const PixelDepthCorrection* pixelDepthCorrection; // Buffer of per-pixel depth correction coefficients
 	PTransform depthProjection; // Projective transformation from depth image space to camera space
 	
-	Threads::MutexCond inputCond; // Condition variable to signal arrival of a new input frame
-	Kinect::FrameBuffer inputFrame; // The most recent input frame
-	unsigned int inputFrameVersion; // Version number of input frame
-	volatile bool runExtractorThread; // Flag to keep the background extraction thread running
+	FrameSubscriber inputFrames; // Latest-value slot receiving raw depth frames
 	Threads::Thread extractorThread; // The background filtering thread
 	
 	DepthPixel maxFgDepth; // Maximum depth value for foreground blobs
@@ -150,7 +148,14 @@ class HandExtractor
 	void setCornerDists(int newMaxCornerEnterDist,int newMinCenterDist,int newMinCornerExitDist); // Sets distances between snake's head and tail to enter and exit corner state, respectively
 	void extractHands(const DepthPixel* depthFrame,HandList& hands,Images::RGBImage* blobImage); // Extracts hands from the given depth frame
 	void setHandsExtractedFunction(HandsExtractedFunction* newHandsExtractedFunction); // Sets the output function; adopts given functor object
-	void receiveRawFrame(const Kinect::FrameBuffer& newFrame); // Called to receive a new raw depth frame
+	FrameSubscriber& getRawFrameSubscriber(void) // Returns the slot receiving raw depth frames, to subscribe it to a channel
+		{
+		return inputFrames;
+		}
+	void receiveRawFrame(const Kinect::FrameBuffer& newFrame) // Called to receive a new raw depth frame directly
+		{
+		inputFrames.post(newFrame);
+		}
 	bool lockNewExtractedHands(void) // Locks the most recently produced output list of extracted hands for reading; returns true if the locked list is new
 		{
 		return extractedHands.lockNewValue();
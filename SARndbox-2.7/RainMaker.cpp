@@ -1,7 +1,7 @@
 /***********************************************************************
 RainMaker - Class to detect objects moving through a given range of
 depths in a depth image sequence to trigger rainfall on virtual terrain.
-Copyright (c) 2012-2015 Oliver Kreylos
+Copyright (c) 2012-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -22,207 +22,242 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "RainMaker.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <Misc/FunctionCalls.h>
 #include <Geometry/HVector.h>
 #include <Geometry/Plane.h>
 
-#include "FindBlobs.h"
+namespace {
 
-template <>
-class BlobProperty<unsigned short> // Class to calculate the 3D centroid of a blob in depth image space
+/****************
+Helper functions:
+****************/
+
+inline float getDepth(const unsigned short& pixel)
 	{
-	/* Elements: */
-	private:
-	double pxs,pys,pzs; // Accumulated components of centroid
-	size_t numPixels; // Number of accumulated pixels
-	
-	/* Constructors and destructors: */
-	public:
-	BlobProperty(void)
-		:pxs(0.0),pys(0.0),pzs(0.0),
-		 numPixels(0)
-		{
-		}
-	
-	/* Methods: */
-	void addPixel(unsigned int x,unsigned int y,const unsigned short& pixelValue)
-		{
-		pxs+=double(x);
-		pys+=double(y);
-		pzs+=double(pixelValue);
-		++numPixels;
-		}
-	void merge(const BlobProperty& other)
-		{
-		pxs+=other.pxs;
-		pys+=other.pys;
-		pzs+=other.pzs;
-		numPixels+=other.numPixels;
-		}
-	size_t getNumPixels(void) const
-		{
-		return numPixels;
-		}
-	Geometry::Point<double,3> calcCentroid(void) const // Returns the centroid of the blob in depth image space
-		{
-		return Geometry::Point<double,3>(pxs/double(numPixels),pys/double(numPixels),pzs/double(numPixels));
-		}
-	};
+	return float(pixel);
+	}
 
-template <>
-class BlobProperty<float> // Class to calculate the 3D centroid of a blob in depth image space
+inline float getDepth(const float& pixel)
 	{
-	/* Elements: */
-	private:
-	double pxs,pys,pzs; // Accumulated components of centroid
-	size_t numPixels; // Number of accumulated pixels
-	
-	/* Constructors and destructors: */
-	public:
-	BlobProperty(void)
-		:pxs(0.0),pys(0.0),pzs(0.0),
-		 numPixels(0)
-		{
-		}
-	
-	/* Methods: */
-	void addPixel(unsigned int x,unsigned int y,const float& pixelValue)
-		{
-		pxs+=double(x);
-		pys+=double(y);
-		pzs+=double(pixelValue);
-		++numPixels;
-		}
-	void merge(const BlobProperty& other)
-		{
-		pxs+=other.pxs;
-		pys+=other.pys;
-		pzs+=other.pzs;
-		numPixels+=other.numPixels;
-		}
-	size_t getNumPixels(void) const
-		{
-		return numPixels;
-		}
-	Geometry::Point<double,3> calcCentroid(void) const // Returns the centroid of the blob in depth image space
-		{
-		return Geometry::Point<double,3>(pxs/double(numPixels),pys/double(numPixels),pzs/double(numPixels));
-		}
-	};
+	return pixel;
+	}
 
-class ValidPixelProperty // Functor class to identify valid pixels in raw depth frames
+#ifdef __SSE2__
+
+inline __m128 loadDepth(const unsigned short* pixels) // Loads four consecutive depth pixels
 	{
-	/* Elements: */
-	private:
-	float minPlane[4]; // Plane equation of the lower bound of valid depth values in depth image space
-	float maxPlane[4]; // Plane equation of the upper bound of valid depth values in depth image space
-	Geometry::Matrix<float,3,4> colorDepthHomography; // Homography from 3D depth image space into 2D color image space
-	unsigned int colorSize[2]; // Width and height of color frames
-	const unsigned char* colorFrame; // The current color frame
-	
-	/* Constructors and destructors: */
-	public:
-	ValidPixelProperty(const float sMinPlane[4],const float sMaxPlane[4],const Geometry::Matrix<float,3,4>& sColorDepthHomography,const unsigned int sColorSize[2])
-		:colorDepthHomography(sColorDepthHomography),
-		 colorFrame(0)
-		{
-		/* Copy the min and max plane equations: */
-		for(int i=0;i<4;++i)
-			minPlane[i]=sMinPlane[i];
-		for(int i=0;i<4;++i)
-			maxPlane[i]=sMaxPlane[i];
-		
-		/* Copy the color image size: */
-		for(int i=0;i<2;++i)
-			colorSize[i]=sColorSize[i];
-		}
-	
-	/* Methods: */
-	public:
-	void setColorFrame(const unsigned char* newColorFrame) // Sets the color frame for the next blob extraction
+	__m128i depth=_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels));
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(depth,_mm_setzero_si128()));
+	}
+
+inline __m128 loadDepth(const float* pixels) // Ditto
+	{
+	return _mm_loadu_ps(pixels);
+	}
+
+#endif
+
+inline unsigned int findSetBit(const Misc::UInt64* maskRow,unsigned int x,unsigned int width) // Returns the index of the first set bit at or after the given index in the given mask row, or the row width
+	{
+	const Misc::UInt64* mPtr=maskRow+(x>>6);
+	Misc::UInt64 bits=(*mPtr)&(~Misc::UInt64(0)<<(x&63U));
+	unsigned int wordX=x&~63U;
+	while(bits==0U)
 		{
-		colorFrame=newColorFrame;
+		wordX+=64;
+		if(wordX>=width)
+			return width;
+		bits=*(++mPtr);
 		}
-	bool operator()(unsigned int x,unsigned int y,const unsigned short& pixel) const
+	x=wordX+__builtin_ctzll(bits);
+	return x<width?x:width;
+	}
+
+inline unsigned int findClearBit(const Misc::UInt64* maskRow,unsigned int x,unsigned int width) // Returns the index of the first clear bit at or after the given index in the given mask row, or the row width
+	{
+	const Misc::UInt64* mPtr=maskRow+(x>>6);
+	Misc::UInt64 bits=(~*mPtr)&(~Misc::UInt64(0)<<(x&63U));
+	unsigned int wordX=x&~63U;
+	while(bits==0U)
 		{
-		return operator()(x,y,float(pixel));
+		wordX+=64;
+		if(wordX>=width)
+			return width;
+		bits=~*(++mPtr);
 		}
-	bool operator()(unsigned int x,unsigned int y,const float& pixel) const
+	x=wordX+__builtin_ctzll(bits);
+	return x<width?x:width;
+	}
+
+}
+
+/**************************
+Methods of class RainMaker:
+**************************/
+
+template <class DepthPixelParam>
+inline
+void RainMaker::classifyPixels(const DepthPixelParam* depthFrame)
+	{
+	const DepthPixelParam* dRowPtr=depthFrame;
+	Misc::UInt64* mRowPtr=validMask;
+	for(unsigned int y=0;y<depthSize[1];++y,dRowPtr+=depthSize[0],mRowPtr+=maskStride)
 		{
-		/* Plug the pixel into the plane equations to determine its validity: */
-		float px=float(x)+0.5f;
+		/* Calculate the row's contributions to the plane equations: */
 		float py=float(y)+0.5f;
-		float pz=pixel;
-		float minD=minPlane[0]*px+minPlane[1]*py+minPlane[2]*pz+minPlane[3];
-		float maxD=maxPlane[0]*px+maxPlane[1]*py+maxPlane[2]*pz+maxPlane[3];
-		if(minD<0.0f||maxD>0.0f)
-			return false;
-		
-		#if 0
+		float minPy=minPlane[1]*py;
+		float maxPy=maxPlane[1]*py;
 		
-		/* Project the pixel into the color frame: */
-		Geometry::ComponentArray<float,3> colorPos=colorDepthHomography*Geometry::ComponentArray<float,4>(px,py,pz,1.0f);
-		int cx=int(Math::floor(colorPos[0]/colorPos[2]));
-		int cy=int(Math::floor(colorPos[1]/colorPos[2]));
-		if(cx<0||cx>=colorSize[0]||cy<0||cy>=colorSize[1])
-			return false;
+		unsigned int x=0;
+		unsigned int maskIndex=0;
 		
-		#if 0
+		#ifdef __SSE2__
 		
-		/* Check if the pixel is mostly black-ish: */
-		const unsigned char* rgb=colorFrame+((cy*colorSize[0]+cx)*3);
-		return rgb[0]<64U&&rgb[1]<64U&&rgb[2]<64U;
-		
-		#else
-		
-		/* Normalize the pixel's color: */
-		const unsigned char* rgb=colorFrame+((cy*colorSize[0]+cx)*3);
-		unsigned char max=rgb[0];
-		for(int i=1;i<3;++i)
-			if(max<rgb[i])
-				max=rgb[i];
-		float rgb0[3];
-		for(int i=0;i<3;++i)
-			rgb0[i]=float(rgb[i])/float(max);
-		
-		/* Check if the color is red-ish: */
-		return rgb0[0]>=0.8f&&rgb0[1]<0.25f&&rgb0[2]<0.25f;
+		/* Classify all pixels in full mask words four at a time: */
+		__m128 minPlane0=_mm_set1_ps(minPlane[0]);
+		__m128 minPlaneY=_mm_set1_ps(minPy);
+		__m128 minPlane2=_mm_set1_ps(minPlane[2]);
+		__m128 minPlane3=_mm_set1_ps(minPlane[3]);
+		__m128 maxPlane0=_mm_set1_ps(maxPlane[0]);
+		__m128 maxPlaneY=_mm_set1_ps(maxPy);
+		__m128 maxPlane2=_mm_set1_ps(maxPlane[2]);
+		__m128 maxPlane3=_mm_set1_ps(maxPlane[3]);
+		__m128 zero=_mm_setzero_ps();
+		__m128 half=_mm_set1_ps(0.5f);
+		__m128i xOffsets=_mm_set_epi32(3,2,1,0);
+		for(;x+64<=depthSize[0];x+=64,++maskIndex)
+			{
+			Misc::UInt64 bits=0U;
+			for(unsigned int i=0;i<64;i+=4)
+				{
+				/* Plug the pixels into the plane equations, in the same order of operations as the scalar code below: */
+				__m128 px=_mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(int(x+i)),xOffsets)),half);
+				__m128 pz=loadDepth(dRowPtr+(x+i));
+				__m128 minD=_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(minPlane0,px),minPlaneY),_mm_mul_ps(minPlane2,pz)),minPlane3);
+				__m128 maxD=_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(maxPlane0,px),maxPlaneY),_mm_mul_ps(maxPlane2,pz)),maxPlane3);
+				
+				/* Set the bits of pixels that are neither below the min plane nor above the max plane: */
+				int invalid=_mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(minD,zero),_mm_cmpgt_ps(maxD,zero)));
+				bits|=Misc::UInt64(invalid^0xf)<<i;
+				}
+			mRowPtr[maskIndex]=bits;
+			}
 		
 		#endif
 		
-		#else
-		
-		return true;
-		
-		#endif
+		/* Classify all remaining pixels one at a time; unused bits in the last mask word remain clear: */
+		for(;maskIndex<maskStride;++maskIndex)
+			{
+			Misc::UInt64 bits=0U;
+			for(unsigned int i=0;i<64&&x<depthSize[0];++i,++x)
+				{
+				/* Plug the pixel into the plane equations to determine its validity: */
+				float px=float(x)+0.5f;
+				float pz=getDepth(dRowPtr[x]);
+				float minD=minPlane[0]*px+minPy+minPlane[2]*pz+minPlane[3];
+				float maxD=maxPlane[0]*px+maxPy+maxPlane[2]*pz+maxPlane[3];
+				if(!(minD<0.0f||maxD>0.0f))
+					bits|=Misc::UInt64(1U)<<i;
+				}
+			mRowPtr[maskIndex]=bits;
+			}
 		}
-	};
-
-/**************************
-Methods of class RainMaker:
-**************************/
+	}
 
 template <class DepthPixelParam>
 inline
-void RainMaker::extractBlobs(const Kinect::FrameBuffer& depthFrame,const ValidPixelProperty& vpp,RainMaker::BlobList& blobsCc)
+void RainMaker::extractBlobs(const DepthPixelParam* depthFrame,RainMaker::BlobList& blobsCc)
 	{
-	/* Extract raw blobs from the depth frame: */
-	std::vector< ::Blob<DepthPixelParam> > blobsDic=findBlobs(depthSize,depthFrame.getData<DepthPixelParam>(),vpp);
+	/* Extract runs of valid pixels one row at a time, and merge them with touching runs from the previous row: */
+	runs.clear();
+	unsigned int lastRowStart=0; // Index of first run in the previous pixel row
+	unsigned int lastRowEnd=0; // Index one after last run in the previous pixel row
+	const DepthPixelParam* dRowPtr=depthFrame;
+	const Misc::UInt64* mRowPtr=validMask;
+	for(unsigned int y=0;y<depthSize[1];++y,dRowPtr+=depthSize[0],mRowPtr+=maskStride)
+		{
+		unsigned int lastRowIndex=lastRowStart;
+		unsigned int x=findSetBit(mRowPtr,0,depthSize[0]);
+		while(x<depthSize[0])
+			{
+			/* Create a new run: */
+			unsigned int runIndex=runs.size();
+			PixelRun run;
+			run.x1=x;
+			run.x2=findClearBit(mRowPtr,x,depthSize[0]);
+			run.parent=runIndex;
+			run.rank=0;
+			run.min[0]=run.x1;
+			run.min[1]=y;
+			run.max[0]=run.x2;
+			run.max[1]=y+1;
+			run.numPixels=run.x2-run.x1;
+			run.sumX=double(run.x1+run.x2-1)*double(run.numPixels)*0.5;
+			run.sumY=double(y)*double(run.numPixels);
+			run.sumZ=0.0;
+			for(const DepthPixelParam* dPtr=dRowPtr+run.x1;dPtr!=dRowPtr+run.x2;++dPtr)
+				run.sumZ+=double(*dPtr);
+			runs.push_back(run);
+			
+			/* Skip runs from the previous row that end before the new run starts: */
+			while(lastRowIndex<lastRowEnd&&runs[lastRowIndex].x2<run.x1)
+				++lastRowIndex;
+			
+			/* Merge the new run with all runs from the previous row that it touches, detecting eight-connected blobs: */
+			for(unsigned int i=lastRowIndex;i<lastRowEnd&&runs[i].x1<=run.x2;++i)
+				{
+				/* Find the roots of the two runs' blobs: */
+				unsigned int root1=i;
+				while(root1!=runs[root1].parent)
+					root1=runs[root1].parent=runs[runs[root1].parent].parent;
+				unsigned int root2=runIndex;
+				while(root2!=runs[root2].parent)
+					root2=runs[root2].parent=runs[runs[root2].parent].parent;
+				
+				/* Merge the two blobs: */
+				if(root1!=root2)
+					{
+					if(runs[root1].rank>runs[root2].rank)
+						{
+						runs[root2].parent=root1;
+						runs[root1].merge(runs[root2]);
+						}
+					else
+						{
+						runs[root1].parent=root2;
+						if(runs[root1].rank==runs[root2].rank)
+							++runs[root2].rank;
+						runs[root2].merge(runs[root1]);
+						}
+					}
+				}
+			
+			/* Find the start of the next run: */
+			x=findSetBit(mRowPtr,run.x2,depthSize[0]);
+			}
+		
+		/* Go to the next row: */
+		lastRowStart=lastRowEnd;
+		lastRowEnd=runs.size();
+		}
 	
 	/* Transform all blobs larger than the threshold to camera space: */
-	blobsCc.reserve(blobsDic.size());
-	for(typename std::vector< ::Blob<DepthPixelParam> >::const_iterator bIt=blobsDic.begin();bIt!=blobsDic.end();++bIt)
-		if(bIt->max[0]-bIt->min[0]>=minBlobSize&&bIt->max[1]-bIt->min[1]>=minBlobSize)
+	for(std::vector<PixelRun>::const_iterator rIt=runs.begin();rIt!=runs.end();++rIt)
+		if(rIt->parent==(unsigned int)(rIt-runs.begin())&&int(rIt->max[0]-rIt->min[0])>=minBlobSize&&int(rIt->max[1]-rIt->min[1])>=minBlobSize)
 			{
 			Blob blobCc;
-			Point centroidDic=bIt->blobProperty.calcCentroid();
+			double numPixels(rIt->numPixels);
+			Point centroidDic(rIt->sumX/numPixels,rIt->sumY/numPixels,rIt->sumZ/numPixels);
 			blobCc.centroid=depthProjection.transform(centroidDic);
 			
 			/* Estimate the radius of the blob in camera space (this is admittedly ad-hoc): */
-			double radiusDic=double(bIt->max[0]-bIt->min[0])*0.5;
-			if(radiusDic>(bIt->max[1]-bIt->min[1])*0.5)
+			double radiusDic=double(rIt->max[0]-rIt->min[0])*0.5;
+			if(radiusDic>(rIt->max[1]-rIt->min[1])*0.5)
 				{
-				radiusDic=(bIt->max[1]-bIt->min[1])*0.5;
+				radiusDic=(rIt->max[1]-rIt->min[1])*0.5;
 				blobCc.radius=Geometry::dist(depthProjection.transform(Point(centroidDic[0],centroidDic[1]+radiusDic,centroidDic[2])),blobCc.centroid);
 				}
 			else
@@ -235,44 +270,31 @@ void RainMaker::extractBlobs(const Kinect::FrameBuffer& depthFrame,const ValidPi
 
 void* RainMaker::detectionThreadMethod(void)
 	{
-	unsigned int lastInputDepthFrameVersion=0;
-	unsigned int lastInputColorFrameVersion=0;
-	
-	/* Create a pixel validity decider: */
-	ValidPixelProperty vpp(minPlane,maxPlane,colorDepthHomography,colorSize);
-	
 	while(true)
 		{
-		Kinect::FrameBuffer depthFrame,colorFrame;
-		{
-		Threads::MutexCond::Lock inputLock(inputCond);
-		
-		/* Wait until a new depth and color frame arrive, or the program shuts down: */
-		while(runDetectionThread&&(lastInputDepthFrameVersion==inputDepthFrameVersion||lastInputColorFrameVersion==inputColorFrameVersion))
-			inputCond.wait(inputLock);
-		
-		/* Bail out if the program is shutting down: */
-		if(!runDetectionThread)
+		/* Wait until a new depth and color frame arrive, and bail out if the program is shutting down: */
+		if(!inputDepthFrames.wait()||!inputColorFrames.wait())
 			break;
 		
-		/* Work on the new frames: */
-		depthFrame=inputDepthFrame;
-		colorFrame=inputColorFrame;
-		lastInputDepthFrameVersion=inputDepthFrameVersion;
-		lastInputColorFrameVersion=inputColorFrameVersion;
-		}
+		/* Work on the most recent frames, which stay locked until the next iteration: */
+		inputDepthFrames.lockNewValue();
+		inputColorFrames.lockNewValue();
+		const Kinect::FrameBuffer& depthFrame=inputDepthFrames.getLockedValue();
 		
 		if(outputBlobsFunction!=0)
 			{
-			/* Set the most recent color frame in the pixel validator: */
-			vpp.setColorFrame(colorFrame.getData<unsigned char>());
-			
-			/* Detect all objects in the depth frame between the min and max planes: */
+			/* Classify all depth pixels, and detect all objects between the min and max planes: */
 			BlobList blobsCc;
 			if(depthIsFloat)
-				extractBlobs<float>(depthFrame,vpp,blobsCc);
+				{
+				classifyPixels(depthFrame.getData<float>());
+				extractBlobs(depthFrame.getData<float>(),blobsCc);
+				}
 			else
-				extractBlobs<unsigned short>(depthFrame,vpp,blobsCc);
+				{
+				classifyPixels(depthFrame.getData<unsigned short>());
+				extractBlobs(depthFrame.getData<unsigned short>(),blobsCc);
+				}
 			
 			/* Call the callback function: */
 			(*outputBlobsFunction)(blobsCc);
@@ -307,10 +329,6 @@ RainMaker::RainMaker(const unsigned int sDepthSize[2],const unsigned int sColorS
 	for(int j=0;j<4;++j)
 		colorDepthHomography(2,j)=float(hom.getMatrix()(3,j));
 	
-	/* Initialize the input frame slot: */
-	inputDepthFrameVersion=0;
-	inputColorFrameVersion=0;
-	
 	/* Calculate the equations of the minimum and maximum elevation planes in camera space: */
 	PTransform::HVector minPlaneCc(basePlane.getNormal());
 	minPlaneCc[3]=-(basePlane.getOffset()+minElevation*basePlane.getNormal().mag());
@@ -329,23 +347,22 @@ RainMaker::RainMaker(const unsigned int sDepthSize[2],const unsigned int sColorS
 	
 	/* Initialize the blob detector: */
 	minBlobSize=sMinBlobSize;
+	maskStride=(depthSize[0]+63)/64;
+	validMask=new Misc::UInt64[maskStride*depthSize[1]];
 	
 	/* Start the object detection thread: */
-	runDetectionThread=true;
 	detectionThread.start(this,&RainMaker::detectionThreadMethod);
 	}
 
 RainMaker::~RainMaker(void)
 	{
 	/* Shut down the object detection thread: */
-	{
-	Threads::MutexCond::Lock inputLock(inputCond);
-	runDetectionThread=false;
-	inputCond.signal();
-	}
+	inputDepthFrames.shutDown();
+	inputColorFrames.shutDown();
 	detectionThread.join();
 	
 	/* Release all allocated resources: */
+	delete[] validMask;
 	delete outputBlobsFunction;
 	}
 
@@ -359,27 +376,3 @@ void RainMaker::setOutputBlobsFunction(RainMaker::OutputBlobsFunction* newOutput
 	delete outputBlobsFunction;
 	outputBlobsFunction=newOutputBlobsFunction;
 	}
-
-void RainMaker::receiveRawDepthFrame(const Kinect::FrameBuffer& newDepthFrame)
-	{
-	Threads::MutexCond::Lock inputLock(inputCond);
-	
-	/* Store the new buffer in the input buffer: */
-	inputDepthFrame=newDepthFrame;
-	++inputDepthFrameVersion;
-	
-	/* Signal the background thread: */
-	inputCond.signal();
-	}
-
-void RainMaker::receiveRawColorFrame(const Kinect::FrameBuffer& newColorFrame)
-	{
-	Threads::MutexCond::Lock inputLock(inputCond);
-	
-	/* Store the new buffer in the input buffer: */
-	inputColorFrame=newColorFrame;
-	++inputColorFrameVersion;
-	
-	/* Signal the background thread: */
-	inputCond.signal();
-	}
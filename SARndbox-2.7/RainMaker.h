@@ -1,7 +1,7 @@
 /***********************************************************************
 RainMaker - Class to detect objects moving through a given range of
 depths in a depth image sequence to trigger rainfall on virtual terrain.
-Copyright (c) 2012-2015 Oliver Kreylos
+Copyright (c) 2012-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -24,13 +24,15 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define RAINMAKER_INCLUDED
 
 #include <vector>
+#include <Misc/SizedTypes.h>
 #include <Threads/Thread.h>
-#include <Threads/MutexCond.h>
 #include <Geometry/Point.h>
 #include <Geometry/Matrix.h>
 #include <Geometry/ProjectiveTransformation.h>
 #include <Kinect/FrameBuffer.h>
 
+#include "BroadcastChannel.h"
+
 /* Forward declarations: */
 namespace Misc {
 template <class ParameterParam>
@@ -40,7 +42,6 @@ namespace Geometry {
 template <class ScalarParam,int dimensionParam>
 class Plane;
 }
-class ValidPixelProperty;
 
 class RainMaker
 	{
@@ -61,9 +62,37 @@ class RainMaker
 	
 	typedef std::vector<Blob> BlobList; // Type for lists of detected objects
 	typedef Misc::FunctionCall<const BlobList&> OutputBlobsFunction; // Type for functions called when a new object list has been extracted
+	typedef BroadcastChannel<Kinect::FrameBuffer>::Subscriber FrameSubscriber; // Type for subscribers to channels of raw frames
 	
-	/* Elements: */
 	private:
+	struct PixelRun // Structure for horizontal runs of valid pixels, which are assembled into blobs
+		{
+		/* Elements: */
+		public:
+		unsigned int x1,x2; // Half-open range of pixel columns covered by the run
+		unsigned int parent,rank; // Union-find state to merge runs into blobs
+		unsigned int min[2],max[2]; // Bounding box of the blob rooted in this run
+		double sumX,sumY,sumZ; // Accumulated pixel positions and depth values of the blob rooted in this run
+		size_t numPixels; // Number of pixels in the blob rooted in this run
+		
+		/* Methods: */
+		void merge(const PixelRun& other) // Merges the blob rooted in the given run into the blob rooted in this run
+			{
+			for(int i=0;i<2;++i)
+				{
+				if(min[i]>other.min[i])
+					min[i]=other.min[i];
+				if(max[i]<other.max[i])
+					max[i]=other.max[i];
+				}
+			sumX+=other.sumX;
+			sumY+=other.sumY;
+			sumZ+=other.sumZ;
+			numPixels+=other.numPixels;
+			}
+		};
+	
+	/* Elements: */
 	unsigned int depthSize[2]; // Width and height of incoming depth frames
 	bool depthIsFloat; // Flag whether the incoming depth frames have float pixel values
 	unsigned int colorSize[2]; // Width and height of incoming color frames
@@ -73,18 +102,19 @@ class RainMaker
 	float minPlane[4]; // Plane equation of the lower bound of valid depth values in depth image space
 	float maxPlane[4]; // Plane equation of the upper bound of valid depth values in depth image space
 	int minBlobSize; // Minimum size of objects to be detected
-	Threads::MutexCond inputCond; // Condition variable to signal arrival of a new input frame
-	Kinect::FrameBuffer inputDepthFrame; // The most recent input depth frame
-	unsigned int inputDepthFrameVersion; // Version number of input depth frame
-	Kinect::FrameBuffer inputColorFrame; // The most recent input color frame
-	unsigned int inputColorFrameVersion; // Version number of input color frame
-	volatile bool runDetectionThread; // Flag to keep the background object detection thread running
+	unsigned int maskStride; // Number of 64-bit words per row in the valid pixel mask
+	Misc::UInt64* validMask; // Bit mask of depth pixels between the min and max planes, one bit per pixel, LSB first
+	std::vector<PixelRun> runs; // List of runs of valid pixels in the current depth frame
+	FrameSubscriber inputDepthFrames; // Latest-value slot receiving raw depth frames
+	FrameSubscriber inputColorFrames; // Latest-value slot receiving raw color frames
 	Threads::Thread detectionThread; // The background object detection thread
 	OutputBlobsFunction* outputBlobsFunction; // Function called when a new (potentially empty) object list has been extracted
 	
 	/* Private methods: */
 	template <class DepthPixelParam>
-	void extractBlobs(const Kinect::FrameBuffer& depthFrame,const ValidPixelProperty& vpp,BlobList& blobsCc);
+	void classifyPixels(const DepthPixelParam* depthFrame); // Sets the bits of all depth pixels between the min and max planes in the valid pixel mask
+	template <class DepthPixelParam>
+	void extractBlobs(const DepthPixelParam* depthFrame,BlobList& blobsCc); // Assembles runs of valid pixels into blobs and transforms blobs larger than the threshold to camera space
 	void* detectionThreadMethod(void); // Method for the object detection thread
 	
 	/* Constructors and destructors: */
@@ -95,8 +125,22 @@ class RainMaker
 	/* Methods: */
 	void setDepthIsFloat(bool newDepthIsFloat); // Sets whether incoming depth frames have float pixel values
 	void setOutputBlobsFunction(OutputBlobsFunction* newOutputBlobsFunction); // Sets the output function; adopts given functor object
-	void receiveRawDepthFrame(const Kinect::FrameBuffer& newDepthFrame); // Called to receive a new raw depth frame
-	void receiveRawColorFrame(const Kinect::FrameBuffer& newColorFrame); // Called to receive a new raw color frame
+	FrameSubscriber& getRawDepthFrameSubscriber(void) // Returns the slot receiving raw depth frames, to subscribe it to a channel
+		{
+		return inputDepthFrames;
+		}
+	FrameSubscriber& getRawColorFrameSubscriber(void) // Returns the slot receiving raw color frames, to subscribe it to a channel
+		{
+		return inputColorFrames;
+		}
+	void receiveRawDepthFrame(const Kinect::FrameBuffer& newDepthFrame) // Called to receive a new raw depth frame directly
+		{
+		inputDepthFrames.post(newDepthFrame);
+		}
+	void receiveRawColorFrame(const Kinect::FrameBuffer& newColorFrame) // Called to receive a new raw color frame directly
+		{
+		inputColorFrames.post(newColorFrame);
+		}
 	};
 
 #endif
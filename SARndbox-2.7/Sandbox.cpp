@@ -1,6 +1,6 @@
 /***********************************************************************
 Sandbox - Vrui application to drive an augmented reality sandbox.
-Copyright (c) 2012-2019 Oliver Kreylos
+Copyright (c) 2012-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -21,13 +21,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "Sandbox.h"
 
-#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#include <fcntl.h>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -40,7 +35,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Misc/FileNameExtensions.h>
 #include <Misc/StandardValueCoders.h>
 #include <Misc/ArrayValueCoders.h>
+#include <Misc/CompoundValueCoders.h>
 #include <Misc/ConfigurationFile.h>
+#include <Realtime/Time.h>
 #include <IO/File.h>
 #include <IO/ValueSource.h>
 #include <IO/OpenFile.h>
@@ -100,13 +97,16 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #endif
 
 #include "FrameFilter.h"
+#include "DepthCalibrationRefiner.h"
 #include "DepthImageRenderer.h"
 #include "ElevationColorMap.h"
 #include "DEM.h"
 #include "SurfaceRenderer.h"
+#include "ContourLineExtractor.h"
 #include "WaterTable2.h"
 #include "HandExtractor.h"
 #include "RemoteServer.h"
+#include "ControlServer.h"
 #include "WaterRenderer.h"
 #include "GlobalWaterTool.h"
 #include "LocalWaterTool.h"
@@ -164,7 +164,7 @@ Sandbox::RenderSettings::RenderSettings(void)
 	 hillshade(false),surfaceMaterial(GLMaterial::Color(1.0f,1.0f,1.0f)),
 	 useShadows(false),
 	 elevationColorMap(0),
-	 useContourLines(true),contourLineSpacing(0.75f),
+	 useContourLines(true),contourLineSpacing(0.75f),cpuContourLines(false),
 	 renderWaterSurface(false),waterOpacity(2.0f),
 	 surfaceRenderer(0),waterRenderer(0)
 	{
@@ -177,7 +177,7 @@ Sandbox::RenderSettings::RenderSettings(const Sandbox::RenderSettings& source)
 	 hillshade(source.hillshade),surfaceMaterial(source.surfaceMaterial),
 	 useShadows(source.useShadows),
 	 elevationColorMap(source.elevationColorMap!=0?new ElevationColorMap(*source.elevationColorMap):0),
-	 useContourLines(source.useContourLines),contourLineSpacing(source.contourLineSpacing),
+	 useContourLines(source.useContourLines),contourLineSpacing(source.contourLineSpacing),cpuContourLines(source.cpuContourLines),
 	 renderWaterSurface(source.renderWaterSurface),waterOpacity(source.waterOpacity),
 	 surfaceRenderer(0),waterRenderer(0)
 	{
@@ -249,15 +249,18 @@ Methods of class Sandbox:
 
 void Sandbox::rawDepthFrameDispatcher(const Kinect::FrameBuffer& frameBuffer)
 	{
-	/* Pass the received frame to the frame filter and the hand extractor: */
-	if(frameFilter!=0&&!pauseUpdates)
-		frameFilter->receiveRawFrame(frameBuffer);
-	if(handExtractor!=0)
-		handExtractor->receiveRawFrame(frameBuffer);
+	/* Remember the frame's arrival time to measure filter latency: */
+	rawFrameArrivalTime=double(Realtime::TimePointMonotonic());
+	
+	/* Broadcast the received frame to all subscribed consumers without waiting for any of them: */
+	rawDepthFrames.post(frameBuffer);
 	}
 
 void Sandbox::receiveFilteredFrame(const Kinect::FrameBuffer& frameBuffer)
 	{
+	/* Update the filter latency: */
+	filterLatency=double(Realtime::TimePointMonotonic())-rawFrameArrivalTime;
+	
 	/* Put the new frame into the frame input buffer: */
 	filteredFrames.postNewValue(frameBuffer);
 	
@@ -321,6 +324,7 @@ void Sandbox::addWater(GLContextData& contextData) const
 void Sandbox::pauseUpdatesCallback(GLMotif::ToggleButton::ValueChangedCallbackData* cbData)
 	{
 	pauseUpdates=cbData->set;
+	frameFilter->getRawFrameSubscriber().setEnabled(!pauseUpdates);
 	}
 
 void Sandbox::showWaterControlDialogCallback(Misc::CallbackData* cbData)
@@ -533,6 +537,9 @@ void printUsage(void)
 	std::cout<<"     Enables topographic contour lines and sets the elevation distance between"<<std::endl;
 	std::cout<<"     adjacent contour lines to the given value in cm"<<std::endl;
 	std::cout<<"     Default contour line spacing: 0.75"<<std::endl;
+	std::cout<<"  -ccl"<<std::endl;
+	std::cout<<"     Extracts topographic contour lines as polylines on the CPU instead of"<<std::endl;
+	std::cout<<"     rendering them on the GPU, for graphics cards without float render targets"<<std::endl;
 	std::cout<<"  -rws"<<std::endl;
 	std::cout<<"     Renders water surface as geometric surface"<<std::endl;
 	std::cout<<"  -rwt"<<std::endl;
@@ -542,6 +549,9 @@ void printUsage(void)
 	std::cout<<"     Default: 2.0"<<std::endl;
 	std::cout<<"  -cp <control pipe name>"<<std::endl;
 	std::cout<<"     Sets the name of a named POSIX pipe from which to read control commands"<<std::endl;
+	std::cout<<"  -cs <control port ID>"<<std::endl;
+	std::cout<<"     Creates a control server listening on TCP port <control port ID> to"<<std::endl;
+	std::cout<<"     receive control commands and stream telemetry data"<<std::endl;
 	}
 
 }
@@ -550,7 +560,7 @@ Sandbox::Sandbox(int& argc,char**& argv)
 	:Vrui::Application(argc,argv),
 	 remoteServer(0),
 	 camera(0),pixelDepthCorrection(0),
-	 frameFilter(0),pauseUpdates(false),
+	 frameFilter(0),pauseUpdates(false),depthCalibrationRefiner(0),
 	 depthImageRenderer(0),
 	 waterTable(0),
 	 handExtractor(0),addWaterFunction(0),addWaterFunctionRegistered(false),
@@ -558,7 +568,8 @@ Sandbox::Sandbox(int& argc,char**& argv)
 	 activeDem(0),
 	 mainMenu(0),pauseUpdatesToggle(0),waterControlDialog(0),
 	 waterSpeedSlider(0),waterMaxStepsSlider(0),frameRateTextField(0),waterAttenuationSlider(0),
-	 controlPipeFd(-1)
+	 controlServer(0),
+	 rawFrameArrivalTime(0.0),filterLatency(0.0),numWaterSteps(0)
 	{
 	/* Read the sandbox's default configuration parameters: */
 	std::string sandboxConfigFileName=CONFIG_CONFIGDIR;
@@ -582,6 +593,10 @@ Sandbox::Sandbox(int& argc,char**& argv)
 	unsigned int minNumSamples=cfg.retrieveValue<unsigned int>("./minNumSamples",10);
 	unsigned int maxVariance=cfg.retrieveValue<unsigned int>("./maxVariance",2);
 	float hysteresis=cfg.retrieveValue<float>("./hysteresis",0.1f);
+	std::vector<Misc::FixedArray<unsigned int,4> > referenceRegions=cfg.retrieveValue<std::vector<Misc::FixedArray<unsigned int,4> > >("./referenceRegions",std::vector<Misc::FixedArray<unsigned int,4> >());
+	double referenceElevation=cfg.retrieveValue<double>("./referenceElevation",0.0);
+	unsigned int refinementFrames=cfg.retrieveValue<unsigned int>("./refinementFrames",300);
+	double refinementRate=cfg.retrieveValue<double>("./refinementRate",0.1);
 	Misc::FixedArray<unsigned int,2> wtSize;
 	wtSize[0]=640;
 	wtSize[1]=480;
@@ -593,6 +608,7 @@ Sandbox::Sandbox(int& argc,char**& argv)
 	double evaporationRate=cfg.retrieveValue<double>("./evaporationRate",0.0);
 	float demDistScale=cfg.retrieveValue<float>("./demDistScale",1.0f);
 	std::string controlPipeName=cfg.retrieveString("./controlPipeName","");
+	int controlPortId=cfg.retrieveValue<int>("./controlPortId",-1);
 	
 	/* Process command line parameters: */
 	bool printHelp=false;
@@ -781,6 +797,8 @@ Sandbox::Sandbox(int& argc,char**& argv)
 					renderSettings.back().contourLineSpacing=GLfloat(atof(argv[i]));
 					}
 				}
+			else if(strcasecmp(argv[i]+1,"ccl")==0)
+				renderSettings.back().cpuContourLines=true;
 			else if(strcasecmp(argv[i]+1,"rws")==0)
 				renderSettings.back().renderWaterSurface=true;
 			else if(strcasecmp(argv[i]+1,"rwt")==0)
@@ -795,6 +813,11 @@ Sandbox::Sandbox(int& argc,char**& argv)
 				++i;
 				controlPipeName=argv[i];
 				}
+			else if(strcasecmp(argv[i]+1,"cs")==0)
+				{
+				++i;
+				controlPortId=atoi(argv[i]);
+				}
 			else
 				std::cerr<<"Ignoring unrecognized command line switch "<<argv[i]<<std::endl;
 			}
@@ -917,6 +940,7 @@ Sandbox::Sandbox(int& argc,char**& argv)
 		elevationRange*=sf;
 	if(rainElevationRange!=Math::Interval<double>::full)
 		rainElevationRange*=sf;
+	referenceElevation*=sf;
 	for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
 		{
 		if(rsIt->elevationColorMap!=0)
@@ -944,6 +968,35 @@ Sandbox::Sandbox(int& argc,char**& argv)
 		handExtractor=new HandExtractor(frameSize,pixelDepthCorrection,cameraIps.depthProjection);
 		}
 	
+	if(!referenceRegions.empty())
+		{
+		/* Create the depth calibration refiner object: */
+		std::vector<DepthCalibrationRefiner::ReferenceRegion> regions;
+		for(std::vector<Misc::FixedArray<unsigned int,4> >::iterator rrIt=referenceRegions.begin();rrIt!=referenceRegions.end();++rrIt)
+			{
+			DepthCalibrationRefiner::ReferenceRegion region;
+			for(int i=0;i<2;++i)
+				{
+				region.min[i]=(*rrIt)[i];
+				region.max[i]=(*rrIt)[2+i];
+				}
+			regions.push_back(region);
+			}
+		depthCalibrationRefiner=new DepthCalibrationRefiner(frameSize,pixelDepthCorrection,cameraIps.depthProjection,basePlane,regions,referenceElevation);
+		depthCalibrationRefiner->setAccumulationParameters(refinementFrames,(refinementFrames+1)/2,maxVariance);
+		depthCalibrationRefiner->setRefinementRate(refinementRate);
+		
+		/* Let the frame filter pick up refined depth corrections: */
+		depthCalibrationRefiner->getDepthCorrectionChannel().subscribe(frameFilter->getDepthCorrectionSubscriber());
+		}
+	
+	/* Subscribe the frame filter, the hand extractor, and the depth calibration refiner to the raw depth frame channel: */
+	rawDepthFrames.subscribe(frameFilter->getRawFrameSubscriber());
+	if(handExtractor!=0)
+		rawDepthFrames.subscribe(handExtractor->getRawFrameSubscriber());
+	if(depthCalibrationRefiner!=0)
+		rawDepthFrames.subscribe(depthCalibrationRefiner->getRawFrameSubscriber());
+	
 	/* Start streaming depth frames: */
 	camera->startStreaming(0,Misc::createFunctionCall(this,&Sandbox::rawDepthFrameDispatcher));
 	
@@ -1017,6 +1070,7 @@ Sandbox::Sandbox(int& argc,char**& argv)
 		rsIt->surfaceRenderer=new SurfaceRenderer(depthImageRenderer);
 		rsIt->surfaceRenderer->setDrawContourLines(rsIt->useContourLines);
 		rsIt->surfaceRenderer->setContourLineDistance(rsIt->contourLineSpacing);
+		rsIt->surfaceRenderer->setCpuContourLines(rsIt->cpuContourLines);
 		rsIt->surfaceRenderer->setElevationColorMap(rsIt->elevationColorMap);
 		rsIt->surfaceRenderer->setIlluminate(rsIt->hillshade);
 		if(waterTable!=0)
@@ -1059,12 +1113,17 @@ Sandbox::Sandbox(int& argc,char**& argv)
 		BathymetrySaverTool::initClass(waterTable,*Vrui::getToolManager());
 	addEventTool("Pause Topography",0,0);
 	
-	if(!controlPipeName.empty())
+	if(!controlPipeName.empty()||controlPortId>=0)
 		{
-		/* Open the control pipe in non-blocking mode: */
-		controlPipeFd=open(controlPipeName.c_str(),O_RDONLY|O_NONBLOCK);
-		if(controlPipeFd<0)
-			std::cerr<<"Unable to open control pipe "<<controlPipeName<<"; ignoring"<<std::endl;
+		/* Create a control server to receive commands from the control pipe and/or a TCP socket: */
+		try
+			{
+			controlServer=new ControlServer(controlPipeName.c_str(),controlPortId);
+			}
+		catch(const std::runtime_error& err)
+			{
+			Misc::formattedConsoleError("Sandbox: Unable to create control server on port %d due to exception %s",controlPortId,err.what());
+			}
 		}
 	
 	/* Inhibit the screen saver: */
@@ -1079,6 +1138,7 @@ Sandbox::~Sandbox(void)
 	/* Stop streaming depth frames: */
 	camera->stopStreaming();
 	delete camera;
+	delete depthCalibrationRefiner;
 	delete frameFilter;
 	
 	/* Delete helper objects: */
@@ -1092,7 +1152,7 @@ Sandbox::~Sandbox(void)
 	delete mainMenu;
 	delete waterControlDialog;
 	
-	close(controlPipeFd);
+	delete controlServer;
 	}
 
 void Sandbox::toolDestructionCallback(Vrui::ToolManager::ToolDestructionCallbackData* cbData)
@@ -1111,42 +1171,6 @@ namespace {
 Helper functions:
 ****************/
 
-std::vector<std::string> tokenizeLine(const char*& buffer)
-	{
-	std::vector<std::string> result;
-	
-	/* Skip initial whitespace but not end-of-line: */
-	const char* bPtr=buffer;
-	while(*bPtr!='\0'&&*bPtr!='\n'&&isspace(*bPtr))
-		++bPtr;
-	
-	/* Extract white-space separated tokens until a newline or end-of-string are encountered: */
-	while(*bPtr!='\0'&&*bPtr!='\n')
-		{
-		/* Remember the start of the current token: */
-		const char* tokenStart=bPtr;
-		
-		/* Find the end of the current token: */
-		while(*bPtr!='\0'&&!isspace(*bPtr))
-			++bPtr;
-		
-		/* Extract the token: */
-		result.push_back(std::string(tokenStart,bPtr));
-		
-		/* Skip whitespace but not end-of-line: */
-		while(*bPtr!='\0'&&*bPtr!='\n'&&isspace(*bPtr))
-			++bPtr;
-		}
-	
-	/* Skip end-of-line: */
-	if(*bPtr=='\n')
-		++bPtr;
-	
-	/* Set the start of the next line and return the token list: */
-	buffer=bPtr;
-	return result;
-	}
-
 bool isToken(const std::string& token,const char* pattern)
 	{
 	return strcasecmp(token.c_str(),pattern)==0;
@@ -1154,8 +1178,240 @@ bool isToken(const std::string& token,const char* pattern)
 
 }
 
+bool Sandbox::executeControlCommand(const std::vector<std::string>& tokens,std::string& error)
+	{
+	/* Parse the command: */
+	if(isToken(tokens[0],"waterSpeed"))
+		{
+		if(tokens.size()==2)
+			{
+			waterSpeed=atof(tokens[1].c_str());
+			if(waterSpeedSlider!=0)
+				waterSpeedSlider->setValue(waterSpeed);
+			}
+		else
+			error="Wrong number of arguments for waterSpeed control command";
+		}
+	else if(isToken(tokens[0],"waterMaxSteps"))
+		{
+		if(tokens.size()==2)
+			{
+			waterMaxSteps=atoi(tokens[1].c_str());
+			if(waterMaxStepsSlider!=0)
+				waterMaxStepsSlider->setValue(waterMaxSteps);
+			}
+		else
+			error="Wrong number of arguments for waterMaxSteps control command";
+		}
+	else if(isToken(tokens[0],"waterAttenuation"))
+		{
+		if(tokens.size()==2)
+			{
+			double attenuation=atof(tokens[1].c_str());
+			if(waterTable!=0)
+				waterTable->setAttenuation(GLfloat(1.0-attenuation));
+			if(waterAttenuationSlider!=0)
+				waterAttenuationSlider->setValue(attenuation);
+			}
+		else
+			error="Wrong number of arguments for waterAttenuation control command";
+		}
+	else if(isToken(tokens[0],"colorMap"))
+		{
+		if(tokens.size()==2)
+			{
+			try
+				{
+				/* Update all height color maps: */
+				for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
+					if(rsIt->elevationColorMap!=0)
+						rsIt->elevationColorMap->load(tokens[1].c_str());
+				}
+			catch(const std::runtime_error& err)
+				{
+				error="Cannot read height color map "+tokens[1]+" due to exception "+err.what();
+				}
+			}
+		else
+			error="Wrong number of arguments for colorMap control command";
+		}
+	else if(isToken(tokens[0],"heightMapPlane"))
+		{
+		if(tokens.size()==5)
+			{
+			/* Read the height map plane equation: */
+			double hmp[4];
+			for(int i=0;i<4;++i)
+				hmp[i]=atof(tokens[1+i].c_str());
+			Plane heightMapPlane=Plane(Plane::Vector(hmp),hmp[3]);
+			heightMapPlane.normalize();
+			
+			/* Override the height mapping planes of all elevation color maps: */
+			for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
+				if(rsIt->elevationColorMap!=0)
+					rsIt->elevationColorMap->calcTexturePlane(heightMapPlane);
+			}
+		else
+			error="Wrong number of arguments for heightMapPlane control command";
+		}
+	else if(isToken(tokens[0],"useContourLines"))
+		{
+		if(tokens.size()==2)
+			{
+			/* Parse the command parameter: */
+			if(isToken(tokens[1],"on")||isToken(tokens[1],"off"))
+				{
+				/* Enable or disable contour lines on all surface renderers: */
+				bool useContourLines=isToken(tokens[1],"on");
+				for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
+					rsIt->surfaceRenderer->setDrawContourLines(useContourLines);
+				}
+			else
+				error="Invalid parameter "+tokens[1]+" for useContourLines control command";
+			}
+		else
+			error="Wrong number of arguments for useContourLines control command";
+		}
+	else if(isToken(tokens[0],"contourLineSpacing"))
+		{
+		if(tokens.size()==2)
+			{
+			/* Parse the contour line distance: */
+			GLfloat contourLineSpacing=GLfloat(atof(tokens[1].c_str()));
+			
+			/* Check if the requested spacing is valid: */
+			if(contourLineSpacing>0.0f)
+				{
+				/* Override the contour line spacing of all surface renderers: */
+				for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
+					{
+					rsIt->contourLineSpacing=contourLineSpacing;
+					rsIt->surfaceRenderer->setContourLineDistance(contourLineSpacing);
+					}
+				}
+			else
+				error="Invalid parameter "+tokens[1]+" for contourLineSpacing control command";
+			}
+		else
+			error="Wrong number of arguments for contourLineSpacing control command";
+		}
+	else if(isToken(tokens[0],"dippingBed"))
+		{
+		if(tokens.size()==2&&isToken(tokens[1],"off"))
+			{
+			/* Disable dipping bed rendering on all surface renderers: */
+			for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
+				rsIt->surfaceRenderer->setDrawDippingBed(false);
+			}
+		else if(tokens.size()==5)
+			{
+			/* Read the dipping bed plane equation: */
+			GLfloat dbp[4];
+			for(int i=0;i<4;++i)
+				dbp[i]=GLfloat(atof(tokens[1+i].c_str()));
+			SurfaceRenderer::Plane dippingBedPlane=SurfaceRenderer::Plane(SurfaceRenderer::Plane::Vector(dbp),dbp[3]);
+			dippingBedPlane.normalize();
+			
+			/* Enable dipping bed rendering and set the dipping bed plane equation on all surface renderers: */
+			for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
+				{
+				rsIt->surfaceRenderer->setDrawDippingBed(true);
+				rsIt->surfaceRenderer->setDippingBedPlane(dippingBedPlane);
+				}
+			}
+		else
+			error="Wrong number of arguments for dippingBed control command";
+		}
+	else if(isToken(tokens[0],"foldedDippingBed"))
+		{
+		if(tokens.size()==6)
+			{
+			/* Read the dipping bed coefficients: */
+			GLfloat dbc[5];
+			for(int i=0;i<5;++i)
+				dbc[i]=GLfloat(atof(tokens[1+i].c_str()));
+			
+			/* Enable dipping bed rendering and set the dipping bed coefficients on all surface renderers: */
+			for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
+				{
+				rsIt->surfaceRenderer->setDrawDippingBed(true);
+				rsIt->surfaceRenderer->setDippingBedCoeffs(dbc);
+				}
+			}
+		else
+			error="Wrong number of arguments for foldedDippingBed control command";
+		}
+	else if(isToken(tokens[0],"dippingBedThickness"))
+		{
+		if(tokens.size()==2)
+			{
+			/* Read the dipping bed thickness: */
+			float dippingBedThickness=float(atof(tokens[1].c_str()));
+			
+			/* Set the dipping bed thickness on all surface renderers: */
+			for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
+				rsIt->surfaceRenderer->setDippingBedThickness(dippingBedThickness);
+			}
+		else
+			error="Wrong number of arguments for dippingBedThickness control command";
+		}
+	else if(isToken(tokens[0],"saveContourLines"))
+		{
+		if(tokens.size()==2)
+			{
+			try
+				{
+				/* Find a surface renderer that already extracts contour lines on the CPU: */
+				const ContourLineExtractor* contourLineExtractor=0;
+				for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end()&&contourLineExtractor==0;++rsIt)
+					contourLineExtractor=rsIt->surfaceRenderer->getContourLineExtractor();
+				
+				if(contourLineExtractor!=0)
+					{
+					/* Save the renderer's current contour lines: */
+					contourLineExtractor->saveContourLines(tokens[1].c_str());
+					}
+				else
+					{
+					/* Extract contour lines from the current depth image using the main window's contour line spacing: */
+					ContourLineExtractor extractor(depthImageRenderer);
+					extractor.extractContourLines(renderSettings.front().contourLineSpacing);
+					extractor.saveContourLines(tokens[1].c_str());
+					}
+				}
+			catch(const std::runtime_error& err)
+				{
+				error="Unable to save contour lines due to exception "+std::string(err.what());
+				}
+			}
+		else
+			error="Wrong number of arguments for saveContourLines control command";
+		}
+	else
+		error="Unrecognized control command "+tokens[0];
+
+	
+	return error.empty();
+	}
+
 void Sandbox::frame(void)
 	{
+	/* Apply all control commands received since the last frame: */
+	if(controlServer!=0)
+		{
+		ControlServer::CommandList commands;
+		controlServer->getCommands(commands);
+		for(ControlServer::CommandList::iterator cIt=commands.begin();cIt!=commands.end();++cIt)
+			{
+			/* Execute the command and report the result back to the sending client: */
+			std::string error;
+			if(executeControlCommand(cIt->tokens,error))
+				controlServer->sendReply(cIt->clientId,"OK "+cIt->tokens[0]);
+			else
+				controlServer->sendReply(cIt->clientId,"ERROR "+error);
+			}
+		}
+	
 	/* Call the remote server's frame method: */
 	if(remoteServer!=0)
 		remoteServer->frame(Vrui::getApplicationTime());
@@ -1167,6 +1423,13 @@ void Sandbox::frame(void)
 		depthImageRenderer->setDepthImage(filteredFrames.getLockedValue());
 		}
 	
+	/* Check if the depth calibration refiner produced a new base plane: */
+	if(depthCalibrationRefiner!=0&&depthCalibrationRefiner->lockNewBasePlane())
+		{
+		/* Update the depth image renderer's elevation base plane: */
+		depthImageRenderer->setBasePlane(depthCalibrationRefiner->getLockedBasePlane());
+		}
+	
 	if(handExtractor!=0)
 		{
 		/* Lock the most recent extracted hand list: */
@@ -1190,203 +1453,9 @@ void Sandbox::frame(void)
 	
 	/* Update all surface renderers: */
 	for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
-		rsIt->surfaceRenderer->setAnimationTime(Vrui::getApplicationTime());
-	
-	/* Check if there is a control command on the control pipe: */
-	if(controlPipeFd>=0)
 		{
-		/* Try reading a chunk of data (will fail with EAGAIN if no data due to non-blocking access): */
-		char commandBuffer[1024];
-		ssize_t readResult=read(controlPipeFd,commandBuffer,sizeof(commandBuffer)-1);
-		if(readResult>0)
-			{
-			commandBuffer[readResult]='\0';
-			
-			/* Extract commands line-by-line: */
-			const char* cPtr=commandBuffer;
-			while(*cPtr!='\0')
-				{
-				/* Split the current line into tokens and skip empty lines: */
-				std::vector<std::string> tokens=tokenizeLine(cPtr);
-				if(tokens.empty())
-					continue;
-				
-				/* Parse the command: */
-				if(isToken(tokens[0],"waterSpeed"))
-					{
-					if(tokens.size()==2)
-						{
-						waterSpeed=atof(tokens[1].c_str());
-						if(waterSpeedSlider!=0)
-							waterSpeedSlider->setValue(waterSpeed);
-						}
-					else
-						std::cerr<<"Wrong number of arguments for waterSpeed control pipe command"<<std::endl;
-					}
-				else if(isToken(tokens[0],"waterMaxSteps"))
-					{
-					if(tokens.size()==2)
-						{
-						waterMaxSteps=atoi(tokens[1].c_str());
-						if(waterMaxStepsSlider!=0)
-							waterMaxStepsSlider->setValue(waterMaxSteps);
-						}
-					else
-						std::cerr<<"Wrong number of arguments for waterMaxSteps control pipe command"<<std::endl;
-					}
-				else if(isToken(tokens[0],"waterAttenuation"))
-					{
-					if(tokens.size()==2)
-						{
-						double attenuation=atof(tokens[1].c_str());
-						if(waterTable!=0)
-							waterTable->setAttenuation(GLfloat(1.0-attenuation));
-						if(waterAttenuationSlider!=0)
-							waterAttenuationSlider->setValue(attenuation);
-						}
-					else
-						std::cerr<<"Wrong number of arguments for waterAttenuation control pipe command"<<std::endl;
-					}
-				else if(isToken(tokens[0],"colorMap"))
-					{
-					if(tokens.size()==2)
-						{
-						try
-							{
-							/* Update all height color maps: */
-							for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
-								if(rsIt->elevationColorMap!=0)
-									rsIt->elevationColorMap->load(tokens[1].c_str());
-							}
-						catch(const std::runtime_error& err)
-							{
-							std::cerr<<"Cannot read height color map "<<tokens[1]<<" due to exception "<<err.what()<<std::endl;
-							}
-						}
-					else
-						std::cerr<<"Wrong number of arguments for colorMap control pipe command"<<std::endl;
-					}
-				else if(isToken(tokens[0],"heightMapPlane"))
-					{
-					if(tokens.size()==5)
-						{
-						/* Read the height map plane equation: */
-						double hmp[4];
-						for(int i=0;i<4;++i)
-							hmp[i]=atof(tokens[1+i].c_str());
-						Plane heightMapPlane=Plane(Plane::Vector(hmp),hmp[3]);
-						heightMapPlane.normalize();
-						
-						/* Override the height mapping planes of all elevation color maps: */
-						for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
-							if(rsIt->elevationColorMap!=0)
-								rsIt->elevationColorMap->calcTexturePlane(heightMapPlane);
-						}
-					else
-						std::cerr<<"Wrong number of arguments for heightMapPlane control pipe command"<<std::endl;
-					}
-				else if(isToken(tokens[0],"useContourLines"))
-					{
-					if(tokens.size()==2)
-						{
-						/* Parse the command parameter: */
-						if(isToken(tokens[1],"on")||isToken(tokens[1],"off"))
-							{
-							/* Enable or disable contour lines on all surface renderers: */
-							bool useContourLines=isToken(tokens[1],"on");
-							for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
-								rsIt->surfaceRenderer->setDrawContourLines(useContourLines);
-							}
-						else
-							std::cerr<<"Invalid parameter "<<tokens[1]<<" for useContourLines control pipe command"<<std::endl;
-						}
-					else
-						std::cerr<<"Wrong number of arguments for contourLineSpacing control pipe command"<<std::endl;
-					}
-				else if(isToken(tokens[0],"contourLineSpacing"))
-					{
-					if(tokens.size()==2)
-						{
-						/* Parse the contour line distance: */
-						GLfloat contourLineSpacing=GLfloat(atof(tokens[1].c_str()));
-						
-						/* Check if the requested spacing is valid: */
-						if(contourLineSpacing>0.0f)
-							{
-							/* Override the contour line spacing of all surface renderers: */
-							for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
-								rsIt->surfaceRenderer->setContourLineDistance(contourLineSpacing);
-							}
-						else
-							std::cerr<<"Invalid parameter "<<contourLineSpacing<<" for contourLineSpacing control pipe command"<<std::endl;
-						}
-					else
-						std::cerr<<"Wrong number of arguments for contourLineSpacing control pipe command"<<std::endl;
-					}
-				else if(isToken(tokens[0],"dippingBed"))
-					{
-					if(tokens.size()==2&&isToken(tokens[1],"off"))
-						{
-						/* Disable dipping bed rendering on all surface renderers: */
-						for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
-							rsIt->surfaceRenderer->setDrawDippingBed(false);
-						}
-					else if(tokens.size()==5)
-						{
-						/* Read the dipping bed plane equation: */
-						GLfloat dbp[4];
-						for(int i=0;i<4;++i)
-							dbp[i]=GLfloat(atof(tokens[1+i].c_str()));
-						SurfaceRenderer::Plane dippingBedPlane=SurfaceRenderer::Plane(SurfaceRenderer::Plane::Vector(dbp),dbp[3]);
-						dippingBedPlane.normalize();
-						
-						/* Enable dipping bed rendering and set the dipping bed plane equation on all surface renderers: */
-						for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
-							{
-							rsIt->surfaceRenderer->setDrawDippingBed(true);
-							rsIt->surfaceRenderer->setDippingBedPlane(dippingBedPlane);
-							}
-						}
-					else
-						std::cerr<<"Wrong number of arguments for dippingBed control pipe command"<<std::endl;
-					}
-				else if(isToken(tokens[0],"foldedDippingBed"))
-					{
-					if(tokens.size()==6)
-						{
-						/* Read the dipping bed coefficients: */
-						GLfloat dbc[5];
-						for(int i=0;i<5;++i)
-							dbc[i]=GLfloat(atof(tokens[1+i].c_str()));
-						
-						/* Enable dipping bed rendering and set the dipping bed coefficients on all surface renderers: */
-						for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
-							{
-							rsIt->surfaceRenderer->setDrawDippingBed(true);
-							rsIt->surfaceRenderer->setDippingBedCoeffs(dbc);
-							}
-						}
-					else
-						std::cerr<<"Wrong number of arguments for foldedDippingBed control pipe command"<<std::endl;
-					}
-				else if(isToken(tokens[0],"dippingBedThickness"))
-					{
-					if(tokens.size()==2)
-						{
-						/* Read the dipping bed thickness: */
-						float dippingBedThickness=float(atof(tokens[1].c_str()));
-						
-						/* Set the dipping bed thickness on all surface renderers: */
-						for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
-							rsIt->surfaceRenderer->setDippingBedThickness(dippingBedThickness);
-						}
-					else
-						std::cerr<<"Wrong number of arguments for dippingBedThickness control pipe command"<<std::endl;
-					}
-				else
-					std::cerr<<"Unrecognized control pipe command "<<tokens[0]<<std::endl;
-				}
-			}
+		rsIt->surfaceRenderer->updateContourLines();
+		rsIt->surfaceRenderer->setAnimationTime(Vrui::getApplicationTime());
 		}
 	
 	if(frameRateTextField!=0&&Vrui::getWidgetManager()->isVisible(waterControlDialog))
@@ -1395,6 +1464,25 @@ void Sandbox::frame(void)
 		frameRateTextField->setValue(1.0/Vrui::getCurrentFrameTime());
 		}
 	
+	if(controlServer!=0)
+		{
+		/* Post a telemetry snapshot for subscribed control clients: */
+		ControlServer::Telemetry telemetry;
+		telemetry.applicationTime=Vrui::getApplicationTime();
+		telemetry.frameRate=1.0/Vrui::getCurrentFrameTime();
+		telemetry.numWaterSteps=numWaterSteps;
+		telemetry.filterLatency=filterLatency;
+		telemetry.numHands=handExtractor!=0?handExtractor->getLockedExtractedHands().size():0;
+		telemetry.numFilterFramesDropped=frameFilter->getRawFrameSubscriber().getNumDropped();
+		telemetry.numHandFramesDropped=handExtractor!=0?handExtractor->getRawFrameSubscriber().getNumDropped():0;
+		for(std::vector<RenderSettings>::iterator rsIt=renderSettings.begin();rsIt!=renderSettings.end();++rsIt)
+			{
+			telemetry.numContourLinePixels+=rsIt->surfaceRenderer->getNumContourLinePixels();
+			telemetry.contourLineExtractionTime+=rsIt->surfaceRenderer->getContourLineExtractionTime();
+			}
+		controlServer->postTelemetry(telemetry);
+		}
+	
 	if(pauseUpdates)
 		Vrui::scheduleUpdate(Vrui::getApplicationTime()+1.0/30.0);
 	}
@@ -1455,6 +1543,7 @@ void Sandbox::display(GLContextData& contextData) const
 		if(totalTimeStep>1.0e-8f)
 			std::cout<<"Ran out of time by "<<totalTimeStep<<std::endl;
 		#endif
+		numWaterSteps=numSteps;
 		
 		/* Check if the grid request is active and wants water level data: */
 		if(request.isActive()&&request.waterLevelBuffer!=0)
@@ -1709,6 +1798,7 @@ void Sandbox::eventCallback(Vrui::Application::EventID eventId,Vrui::InputDevice
 			case 0:
 				/* Invert the current pause setting: */
 				pauseUpdates=!pauseUpdates;
+				frameFilter->getRawFrameSubscriber().setEnabled(!pauseUpdates);
 				
 				/* Update the main menu toggle: */
 				pauseUpdatesToggle->setToggle(pauseUpdates);
@@ -1,6 +1,6 @@
 /***********************************************************************
 Sandbox - Vrui application to drive an augmented reality sandbox.
-Copyright (c) 2012-2019 Oliver Kreylos
+Copyright (c) 2012-2020 Oliver Kreylos
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -22,6 +22,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #ifndef SANDBOX_INCLUDED
 #define SANDBOX_INCLUDED
 
+#include <string>
+#include <vector>
 #include <Threads/Mutex.h>
 #include <Threads/TripleBuffer.h>
 #include <Geometry/Box.h>
@@ -43,6 +45,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Kinect/FrameSource.h>
 
 #include "Types.h"
+#include "BroadcastChannel.h"
 
 /* Forward declarations: */
 namespace Misc {
@@ -62,6 +65,7 @@ namespace Kinect {
 class Camera;
 }
 class FrameFilter;
+class DepthCalibrationRefiner;
 class DepthImageRenderer;
 class ElevationColorMap;
 class DEM;
@@ -70,6 +74,7 @@ class WaterTable2;
 class HandExtractor;
 typedef Misc::FunctionCall<GLContextData&> AddWaterFunction;
 class RemoteServer;
+class ControlServer;
 class WaterRenderer;
 
 class Sandbox:public Vrui::Application,public GLObject
@@ -172,6 +177,7 @@ class Sandbox:public Vrui::Application,public GLObject
 		ElevationColorMap* elevationColorMap; // Pointer to an elevation color map
 		bool useContourLines; // Flag whether to draw elevation contour lines
 		GLfloat contourLineSpacing; // Spacing between adjacent contour lines in cm
+		bool cpuContourLines; // Flag whether to extract contour lines as polylines on the CPU instead of rendering them on the GPU
 		bool renderWaterSurface; // Flag whether to render the water surface as a geometric surface
 		GLfloat waterOpacity; // Opacity factor for water when rendered as texture
 		SurfaceRenderer* surfaceRenderer; // Surface rendering object for this window
@@ -200,8 +206,10 @@ class Sandbox:public Vrui::Application,public GLObject
 	unsigned int frameSize[2]; // Width and height of the camera's depth frames
 	PixelDepthCorrection* pixelDepthCorrection; // Buffer of per-pixel depth correction coefficients
 	Kinect::FrameSource::IntrinsicParameters cameraIps; // Intrinsic parameters of the Kinect camera
+	BroadcastChannel<Kinect::FrameBuffer> rawDepthFrames; // Channel broadcasting raw depth frames from the camera thread to all frame consumers
 	FrameFilter* frameFilter; // Processing object to filter raw depth frames from the Kinect camera
 	bool pauseUpdates; // Pauses updates of the topography
+	DepthCalibrationRefiner* depthCalibrationRefiner; // Background estimator refining the depth correction and base plane from flat reference regions, or null
 	Threads::TripleBuffer<Kinect::FrameBuffer> filteredFrames; // Triple buffer for incoming filtered depth frames
 	DepthImageRenderer* depthImageRenderer; // Object managing the current filtered depth image
 	ONTransform boxTransform; // Transformation from camera space to baseplane space (x along long sandbox axis, z up)
@@ -225,12 +233,16 @@ class Sandbox:public Vrui::Application,public GLObject
 	GLMotif::TextFieldSlider* waterMaxStepsSlider;
 	GLMotif::TextField* frameRateTextField;
 	GLMotif::TextFieldSlider* waterAttenuationSlider;
-	int controlPipeFd; // File descriptor of an optional named pipe to send control commands to a running AR Sandbox
+	ControlServer* controlServer; // Server receiving control commands from a named pipe and/or TCP socket and streaming telemetry data
+	volatile double rawFrameArrivalTime; // Arrival time of the most recent raw depth frame on the monotonic clock
+	volatile double filterLatency; // Time between arrival of a raw depth frame and release of the resulting filtered frame
+	mutable unsigned int numWaterSteps; // Number of water simulation steps run during the most recent frame
 	
 	/* Private methods: */
-	void rawDepthFrameDispatcher(const Kinect::FrameBuffer& frameBuffer); // Callback receiving raw depth frames from the Kinect camera; forwards them to the frame filter and rain maker objects
+	void rawDepthFrameDispatcher(const Kinect::FrameBuffer& frameBuffer); // Callback receiving raw depth frames from the Kinect camera; broadcasts them to the frame filter and hand extractor objects
 	void receiveFilteredFrame(const Kinect::FrameBuffer& frameBuffer); // Callback receiving filtered depth frames from the filter object
 	void toggleDEM(DEM* dem); // Sets or toggles the currently active DEM
+	bool executeControlCommand(const std::vector<std::string>& tokens,std::string& error); // Executes a control command; returns false and sets an error message if the command failed
 	void addWater(GLContextData& contextData) const; // Function to render geometry that adds water to the water table
 	void pauseUpdatesCallback(GLMotif::ToggleButton::ValueChangedCallbackData* cbData);
 	void showWaterControlDialogCallback(Misc::CallbackData* cbData);
@@ -0,0 +1,674 @@
+/***********************************************************************
+SimulateWater - Utility to run water flow scenarios over a digital
+elevation model offline and as fast as possible, using either the CPU
+or the GPU-based water table, and to stream the resulting water level
+grids to a file.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+/***********************************************************************
+Water level stream file format; all values are little-endian:
+
+Header:
+  char[16]  "SARndboxWater1.0"
+  UInt32[2] width and height of the water table in cells
+  Float32[2] width and height of water table cells
+  Float32[2] position of the first bathymetry vertex in DEM coordinates
+  Float32[(width-1)*(height-1)] vertex-centered bathymetry grid
+
+Followed by any number of frames, each consisting of:
+  Float64   simulation time in seconds
+  UInt32    number of simulation steps run so far
+  Float32[width*height] cell-centered water surface elevations
+
+Frames are flushed to the file as they are written, so a stream can be
+read while the simulation is still running.
+***********************************************************************/
+
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <Misc/SizedTypes.h>
+#include <Misc/FunctionCalls.h>
+#include <IO/File.h>
+#include <IO/OpenFile.h>
+#include <Math/Math.h>
+#include <Math/Constants.h>
+#include <Realtime/Time.h>
+#include <GL/gl.h>
+#include <GL/Extensions/GLARBMultitexture.h>
+#include <GL/Extensions/GLARBTextureRectangle.h>
+#include <GL/Extensions/GLARBVertexProgram.h>
+#include <GL/GLContextData.h>
+#include <GL/GLWindow.h>
+
+#include "CPUWaterTable.h"
+#include "WaterTable2.h"
+
+namespace {
+
+/**************
+Helper classes:
+**************/
+
+struct ElevationGrid // Structure for a regular grid of elevation postings loaded from a DEM file
+	{
+	/* Elements: */
+	public:
+	int size[2]; // Number of postings in x and y
+	double origin[2]; // DEM coordinates of the first posting
+	double cellSize[2]; // Distance between adjacent postings in x and y
+	std::vector<float> elevations; // Elevation postings in row-major order, starting at the lower-left corner
+	};
+
+struct WaterSource // Structure for circular water sources or sinks
+	{
+	/* Elements: */
+	public:
+	double center[2]; // Center of the source in DEM coordinates
+	double radius; // Source radius in DEM coordinate units
+	float rate; // Rate at which water is added (positive) or removed (negative) in elevation units per second
+	};
+
+class Simulator // Abstract base class for water flow simulation back-ends
+	{
+	/* Constructors and destructors: */
+	public:
+	virtual ~Simulator(void)
+		{
+		}
+	
+	/* Methods: */
+	virtual void setWaterLevel(const GLfloat* waterGrid) =0; // Sets the current water level
+	virtual void setRainAndSources(GLfloat rainRate,const std::vector<WaterSource>& sources) =0; // Sets the rain rate and list of active water sources
+	virtual GLfloat runSimulationStep(void) =0; // Runs a simulation step and returns its step size
+	virtual void getWaterLevel(GLfloat* waterGrid) =0; // Reads the current water level
+	virtual void finish(void) // Waits until all simulation steps have been completed
+		{
+		}
+	};
+
+class CPUSimulator:public Simulator // Simulation back-end running on the CPU
+	{
+	/* Elements: */
+	private:
+	CPUWaterTable waterTable; // The CPU water table
+	double origin[2]; // DEM coordinates of the water table's domain origin
+	
+	/* Constructors and destructors: */
+	public:
+	CPUSimulator(const ElevationGrid& dem,const GLfloat cellSize[2],unsigned int numThreads,GLfloat attenuation,GLfloat maxStepSize,bool dryBoundary)
+		:waterTable(dem.size[0]+1,dem.size[1]+1,cellSize,numThreads)
+		{
+		/* Bathymetry vertex (0, 0) is the upper-right corner of water table cell (0, 0): */
+		for(int i=0;i<2;++i)
+			origin[i]=dem.origin[i]-dem.cellSize[i];
+		
+		waterTable.setAttenuation(attenuation);
+		waterTable.setMaxStepSize(maxStepSize);
+		waterTable.setDryBoundary(dryBoundary);
+		waterTable.updateBathymetry(&dem.elevations[0]);
+		}
+	
+	/* Methods from Simulator: */
+	virtual void setWaterLevel(const GLfloat* waterGrid)
+		{
+		waterTable.setWaterLevel(waterGrid);
+		}
+	virtual void setRainAndSources(GLfloat rainRate,const std::vector<WaterSource>& sources)
+		{
+		waterTable.setWaterDeposit(rainRate);
+		
+		if(!sources.empty())
+			{
+			/* Rasterize all water sources into a water rate grid: */
+			const GLsizei* size=waterTable.getSize();
+			const GLfloat* cellSize=waterTable.getCellSize();
+			std::vector<GLfloat> rates(size_t(size[0])*size_t(size[1]),0.0f);
+			for(std::vector<WaterSource>::const_iterator sIt=sources.begin();sIt!=sources.end();++sIt)
+				{
+				double r2=Math::sqr(sIt->radius);
+				for(GLsizei y=0;y<size[1];++y)
+					{
+					double dy=origin[1]+(double(y)+0.5)*double(cellSize[1])-sIt->center[1];
+					for(GLsizei x=0;x<size[0];++x)
+						{
+						double dx=origin[0]+(double(x)+0.5)*double(cellSize[0])-sIt->center[0];
+						if(dx*dx+dy*dy<=r2)
+							rates[size_t(y)*size_t(size[0])+x]+=sIt->rate;
+						}
+					}
+				}
+			waterTable.setWaterRates(&rates[0]);
+			}
+		else
+			waterTable.setWaterRates(0);
+		}
+	virtual GLfloat runSimulationStep(void)
+		{
+		return waterTable.runSimulationStep();
+		}
+	virtual void getWaterLevel(GLfloat* waterGrid)
+		{
+		waterTable.getWaterLevel(waterGrid);
+		}
+	};
+
+class GPUSimulator:public Simulator // Simulation back-end running on the GPU via an off-screen water table
+	{
+	/* Elements: */
+	private:
+	GLWindow window; // Window providing an OpenGL context for the water table
+	WaterTable2* waterTable; // The GPU water table
+	double origin[2]; // DEM coordinates of the water table's domain origin
+	std::vector<WaterSource> sources; // List of currently active water sources
+	AddWaterFunction* addWaterFunction; // Render function to add water from the current water sources
+	
+	/* Private methods: */
+	void addWater(GLContextData& contextData) const
+		{
+		/* Render all water sources as disks in the middle of the water table's elevation range: */
+		const WaterTable2::Box& domain=waterTable->getDomain();
+		GLfloat z=GLfloat(domain.min[2]+domain.max[2]*Scalar(5))*0.5f;
+		for(std::vector<WaterSource>::const_iterator sIt=sources.begin();sIt!=sources.end();++sIt)
+			{
+			glVertexAttrib1fARB(1,sIt->rate);
+			glBegin(GL_POLYGON);
+			for(int i=0;i<32;++i)
+				{
+				double angle=2.0*Math::Constants<double>::pi*double(i)/32.0;
+				glVertex3f(GLfloat(sIt->center[0]+Math::cos(angle)*sIt->radius-origin[0]),GLfloat(sIt->center[1]+Math::sin(angle)*sIt->radius-origin[1]),z);
+				}
+			glEnd();
+			}
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	GPUSimulator(const ElevationGrid& dem,const GLfloat cellSize[2],GLfloat attenuation,GLfloat maxStepSize,bool dryBoundary)
+		:window("SimulateWater",GLWindow::WindowPos(64,64),false),
+		 waterTable(0),addWaterFunction(0)
+		{
+		/* Bathymetry vertex (0, 0) is the upper-right corner of water table cell (0, 0): */
+		for(int i=0;i<2;++i)
+			origin[i]=dem.origin[i]-dem.cellSize[i];
+		
+		/* Calculate the DEM's elevation range: */
+		float elevMin=dem.elevations[0];
+		float elevMax=dem.elevations[0];
+		for(std::vector<float>::const_iterator eIt=dem.elevations.begin();eIt!=dem.elevations.end();++eIt)
+			{
+			if(elevMin>*eIt)
+				elevMin=*eIt;
+			if(elevMax<*eIt)
+				elevMax=*eIt;
+			}
+		
+		/* Create an offline water table: */
+		window.makeCurrent();
+		waterTable=new WaterTable2(dem.size[0]+1,dem.size[1]+1,cellSize);
+		waterTable->setElevationRange(Scalar(elevMin),Scalar(elevMax)+Scalar(elevMax-elevMin));
+		waterTable->setAttenuation(attenuation);
+		waterTable->setMaxStepSize(maxStepSize);
+		waterTable->setDryBoundary(dryBoundary);
+		
+		/* Initialize the water table's OpenGL state and upload the bathymetry: */
+		GLContextData& contextData=window.getContextData();
+		contextData.updateThings();
+		GLARBVertexProgram::initExtension();
+		waterTable->updateBathymetry(&dem.elevations[0],contextData);
+		}
+	virtual ~GPUSimulator(void)
+		{
+		if(addWaterFunction!=0)
+			waterTable->removeRenderFunction(addWaterFunction);
+		delete addWaterFunction;
+		delete waterTable;
+		window.getContextData().updateThings();
+		}
+	
+	/* Methods from Simulator: */
+	virtual void setWaterLevel(const GLfloat* waterGrid)
+		{
+		waterTable->setWaterLevel(waterGrid,window.getContextData());
+		}
+	virtual void setRainAndSources(GLfloat rainRate,const std::vector<WaterSource>& newSources)
+		{
+		waterTable->setWaterDeposit(rainRate);
+		
+		/* Install or remove the water adding render function: */
+		sources=newSources;
+		if(!sources.empty()&&addWaterFunction==0)
+			{
+			addWaterFunction=Misc::createFunctionCall(this,&GPUSimulator::addWater);
+			waterTable->addRenderFunction(addWaterFunction);
+			}
+		else if(sources.empty()&&addWaterFunction!=0)
+			{
+			waterTable->removeRenderFunction(addWaterFunction);
+			delete addWaterFunction;
+			addWaterFunction=0;
+			}
+		}
+	virtual GLfloat runSimulationStep(void)
+		{
+		return waterTable->runSimulationStep(false,window.getContextData());
+		}
+	virtual void getWaterLevel(GLfloat* waterGrid)
+		{
+		/* Read the water surface elevations from the conserved quantity texture: */
+		glActiveTextureARB(GL_TEXTURE0_ARB);
+		waterTable->bindQuantityTexture(window.getContextData());
+		glGetTexImage(GL_TEXTURE_RECTANGLE_ARB,0,GL_RED,GL_FLOAT,waterGrid);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+		}
+	virtual void finish(void)
+		{
+		glFinish();
+		}
+	};
+
+/****************
+Helper functions:
+****************/
+
+void loadBinaryDEM(IO::File& file,ElevationGrid& dem)
+	{
+	/* Read a DEM in the format read by class DEM: */
+	file.setEndianness(Misc::LittleEndian);
+	file.read<int>(dem.size,2);
+	float demBox[4];
+	file.read<float>(demBox,4);
+	for(int i=0;i<2;++i)
+		{
+		dem.origin[i]=demBox[i];
+		dem.cellSize[i]=(double(demBox[2+i])-double(demBox[i]))/double(dem.size[i]-1);
+		}
+	dem.elevations.resize(size_t(dem.size[0])*size_t(dem.size[1]));
+	file.read<float>(&dem.elevations[0],dem.elevations.size());
+	}
+
+double parseUSGSNumber(const std::string& field)
+	{
+	/* Replace FORTRAN-style double precision exponents: */
+	std::string value=field;
+	for(std::string::iterator vIt=value.begin();vIt!=value.end();++vIt)
+		if(*vIt=='D'||*vIt=='d')
+			*vIt='E';
+	return strtod(value.c_str(),0);
+	}
+
+void loadUSGSDEM(const std::string& contents,ElevationGrid& dem)
+	{
+	/* Check the size of the fixed-format "A" record: */
+	if(contents.size()<1024)
+		throw std::runtime_error("Truncated USGS DEM header");
+	
+	/* Read the spatial resolution and the number of profiles from the "A" record: */
+	dem.cellSize[0]=parseUSGSNumber(contents.substr(816,12));
+	dem.cellSize[1]=parseUSGSNumber(contents.substr(828,12));
+	double zResolution=parseUSGSNumber(contents.substr(840,12));
+	dem.size[0]=atoi(contents.substr(858,6).c_str());
+	dem.size[1]=0;
+	if(dem.cellSize[0]<=0.0||dem.cellSize[1]<=0.0||zResolution<=0.0||dem.size[0]<2)
+		throw std::runtime_error("Malformed USGS DEM header");
+	
+	/* Read all "B" records as whitespace-separated tokens: */
+	std::vector<std::string> tokens;
+	size_t pos=1024;
+	while(pos<contents.size())
+		{
+		while(pos<contents.size()&&isspace(contents[pos]))
+			++pos;
+		size_t tokenStart=pos;
+		while(pos<contents.size()&&!isspace(contents[pos]))
+			++pos;
+		if(pos>tokenStart)
+			tokens.push_back(contents.substr(tokenStart,pos-tokenStart));
+		}
+	
+	/* Parse the elevation profiles, one per grid column: */
+	size_t tokenIndex=0;
+	for(int column=0;column<dem.size[0];++column)
+		{
+		if(tokenIndex+9>tokens.size())
+			throw std::runtime_error("Truncated USGS DEM profile header");
+		int numRows=atoi(tokens[tokenIndex+2].c_str());
+		double easting=parseUSGSNumber(tokens[tokenIndex+4]);
+		double northing=parseUSGSNumber(tokens[tokenIndex+5]);
+		double datum=parseUSGSNumber(tokens[tokenIndex+6]);
+		tokenIndex+=9;
+		if(column==0)
+			{
+			/* Initialize the grid from the first profile: */
+			dem.size[1]=numRows;
+			dem.origin[0]=easting;
+			dem.origin[1]=northing;
+			dem.elevations.resize(size_t(dem.size[0])*size_t(dem.size[1]));
+			}
+		else if(numRows!=dem.size[1])
+			throw std::runtime_error("USGS DEM profiles have different lengths");
+		if(tokenIndex+numRows>tokens.size())
+			throw std::runtime_error("Truncated USGS DEM profile");
+		
+		/* Store the profile's postings as a column of the elevation grid: */
+		for(int row=0;row<numRows;++row,++tokenIndex)
+			dem.elevations[size_t(row)*size_t(dem.size[0])+column]=float(datum+double(atoi(tokens[tokenIndex].c_str()))*zResolution);
+		}
+	if(dem.size[1]<2)
+		throw std::runtime_error("USGS DEM has too few rows");
+	}
+
+void loadDEM(const char* fileName,ElevationGrid& dem)
+	{
+	/* Read the entire file into memory: */
+	IO::FilePtr file=IO::openFile(fileName);
+	std::string contents;
+	char buffer[65536];
+	size_t readSize;
+	while((readSize=file->readUpTo(buffer,sizeof(buffer)))>0)
+		contents.append(buffer,readSize);
+	
+	/*********************************************************************
+	Binary DEM files start with two small little-endian integers, whereas
+	USGS DEM files, like the ones written by BathymetrySaverTool, start
+	with a printable file name.
+	*********************************************************************/
+	
+	bool binary=false;
+	if(contents.size()>=8)
+		{
+		Misc::UInt32 header[2];
+		memcpy(header,contents.data(),sizeof(header));
+		binary=header[0]>=2U&&header[0]<=65536U&&header[1]>=2U&&header[1]<=65536U;
+		}
+	if(binary)
+		{
+		IO::FilePtr binaryFile=IO::openFile(fileName);
+		loadBinaryDEM(*binaryFile,dem);
+		}
+	else
+		loadUSGSDEM(contents,dem);
+	}
+
+void writeHeader(IO::File& file,const ElevationGrid& dem)
+	{
+	file.setEndianness(Misc::LittleEndian);
+	file.write<char>("SARndboxWater1.0",16);
+	file.write<Misc::UInt32>(Misc::UInt32(dem.size[0]+1));
+	file.write<Misc::UInt32>(Misc::UInt32(dem.size[1]+1));
+	for(int i=0;i<2;++i)
+		file.write<Misc::Float32>(Misc::Float32(dem.cellSize[i]));
+	for(int i=0;i<2;++i)
+		file.write<Misc::Float32>(Misc::Float32(dem.origin[i]));
+	file.write<Misc::Float32>(&dem.elevations[0],dem.elevations.size());
+	file.flush();
+	}
+
+void writeFrame(IO::File& file,double simulationTime,unsigned int numSteps,const std::vector<GLfloat>& waterLevel)
+	{
+	file.write<Misc::Float64>(simulationTime);
+	file.write<Misc::UInt32>(Misc::UInt32(numSteps));
+	file.write<Misc::Float32>(&waterLevel[0],waterLevel.size());
+	file.flush();
+	}
+
+void printUsage(void)
+	{
+	std::cout<<"Usage: SimulateWater [option 1] ... [option n] <DEM file name> <output file name>"<<std::endl;
+	std::cout<<"  Loads a DEM in binary format or USGS DEM format as written by the"<<std::endl;
+	std::cout<<"  Save Bathymetry tool, runs a water flow scenario, and writes water level"<<std::endl;
+	std::cout<<"  grids to the output file at regular simulation time intervals."<<std::endl;
+	std::cout<<"  Options:"<<std::endl;
+	std::cout<<"  -h"<<std::endl;
+	std::cout<<"     Prints this help message"<<std::endl;
+	std::cout<<"  -cpu"<<std::endl;
+	std::cout<<"     Runs the simulation on the CPU (default)"<<std::endl;
+	std::cout<<"  -gpu"<<std::endl;
+	std::cout<<"     Runs the simulation on the GPU; requires a connection to an X display"<<std::endl;
+	std::cout<<"  -threads <number of threads>"<<std::endl;
+	std::cout<<"     Number of threads for the CPU simulation"<<std::endl;
+	std::cout<<"     Default: number of online CPUs"<<std::endl;
+	std::cout<<"  -duration <simulation time>"<<std::endl;
+	std::cout<<"     Total simulated time in seconds"<<std::endl;
+	std::cout<<"     Default: 60.0"<<std::endl;
+	std::cout<<"  -interval <simulation time>"<<std::endl;
+	std::cout<<"     Simulated time between written water level grids in seconds; 0 disables output"<<std::endl;
+	std::cout<<"     Default: 1.0"<<std::endl;
+	std::cout<<"  -rain <rain rate>"<<std::endl;
+	std::cout<<"     Adds rain over the entire DEM in elevation units per second"<<std::endl;
+	std::cout<<"     Default: 0.0"<<std::endl;
+	std::cout<<"  -source <x> <y> <radius> <rate>"<<std::endl;
+	std::cout<<"     Adds a circular water source (positive rate) or sink (negative rate) in DEM"<<std::endl;
+	std::cout<<"     coordinates; can be given multiple times"<<std::endl;
+	std::cout<<"  -inflowDuration <simulation time>"<<std::endl;
+	std::cout<<"     Simulated time after which rain and water sources are turned off"<<std::endl;
+	std::cout<<"     Default: entire simulation"<<std::endl;
+	std::cout<<"  -flood <elevation>"<<std::endl;
+	std::cout<<"     Initially floods the DEM up to the given water surface elevation"<<std::endl;
+	std::cout<<"  -attenuation <attenuation>"<<std::endl;
+	std::cout<<"     Attenuation factor for partial discharges"<<std::endl;
+	std::cout<<"     Default: 0.9921875"<<std::endl;
+	std::cout<<"  -maxStepSize <step size>"<<std::endl;
+	std::cout<<"     Maximum simulation step size in seconds"<<std::endl;
+	std::cout<<"     Default: 1.0"<<std::endl;
+	std::cout<<"  -wetBoundary"<<std::endl;
+	std::cout<<"     Does not enforce dry boundary conditions at the edges of the DEM"<<std::endl;
+	}
+
+}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	bool useGpu=false;
+	long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int numThreads=numCpus>0?(unsigned int)numCpus:1U;
+	double duration=60.0;
+	double interval=1.0;
+	GLfloat rainRate=0.0f;
+	std::vector<WaterSource> sources;
+	double inflowDuration=-1.0;
+	bool flood=false;
+	GLfloat floodLevel=0.0f;
+	GLfloat attenuation=127.0f/128.0f;
+	GLfloat maxStepSize=1.0f;
+	bool dryBoundary=true;
+	const char* demFileName=0;
+	const char* outputFileName=0;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"h")==0)
+				{
+				printUsage();
+				return 0;
+				}
+			else if(strcasecmp(argv[i]+1,"cpu")==0)
+				useGpu=false;
+			else if(strcasecmp(argv[i]+1,"gpu")==0)
+				useGpu=true;
+			else if(strcasecmp(argv[i]+1,"threads")==0&&i+1<argc)
+				{
+				++i;
+				numThreads=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"duration")==0&&i+1<argc)
+				{
+				++i;
+				duration=atof(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"interval")==0&&i+1<argc)
+				{
+				++i;
+				interval=atof(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"rain")==0&&i+1<argc)
+				{
+				++i;
+				rainRate=GLfloat(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"source")==0&&i+4<argc)
+				{
+				WaterSource source;
+				for(int j=0;j<2;++j)
+					source.center[j]=atof(argv[i+1+j]);
+				source.radius=atof(argv[i+3]);
+				source.rate=float(atof(argv[i+4]));
+				sources.push_back(source);
+				i+=4;
+				}
+			else if(strcasecmp(argv[i]+1,"inflowDuration")==0&&i+1<argc)
+				{
+				++i;
+				inflowDuration=atof(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"flood")==0&&i+1<argc)
+				{
+				++i;
+				flood=true;
+				floodLevel=GLfloat(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"attenuation")==0&&i+1<argc)
+				{
+				++i;
+				attenuation=GLfloat(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"maxStepSize")==0&&i+1<argc)
+				{
+				++i;
+				maxStepSize=GLfloat(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"wetBoundary")==0)
+				dryBoundary=false;
+			else
+				{
+				std::cerr<<"Unrecognized or incomplete command line option "<<argv[i]<<std::endl;
+				printUsage();
+				return 1;
+				}
+			}
+		else if(demFileName==0)
+			demFileName=argv[i];
+		else if(outputFileName==0)
+			outputFileName=argv[i];
+		}
+	if(demFileName==0||outputFileName==0)
+		{
+		std::cerr<<"Missing DEM or output file name"<<std::endl;
+		printUsage();
+		return 1;
+		}
+	
+	try
+		{
+		/* Load the DEM: */
+		ElevationGrid dem;
+		loadDEM(demFileName,dem);
+		std::cout<<"Loaded "<<dem.size[0]<<" x "<<dem.size[1]<<" DEM with cell size "<<dem.cellSize[0]<<" x "<<dem.cellSize[1]<<std::endl;
+		
+		/* Create the simulation back-end: */
+		GLfloat cellSize[2];
+		for(int i=0;i<2;++i)
+			cellSize[i]=GLfloat(dem.cellSize[i]);
+		Simulator* simulator;
+		if(useGpu)
+			simulator=new GPUSimulator(dem,cellSize,attenuation,maxStepSize,dryBoundary);
+		else
+			simulator=new CPUSimulator(dem,cellSize,numThreads,attenuation,maxStepSize,dryBoundary);
+		size_t numCells=size_t(dem.size[0]+1)*size_t(dem.size[1]+1);
+		std::vector<GLfloat> waterLevel(numCells);
+		
+		/* Set up the scenario: */
+		if(flood)
+			{
+			for(size_t i=0;i<numCells;++i)
+				waterLevel[i]=floodLevel;
+			simulator->setWaterLevel(&waterLevel[0]);
+			}
+		bool inflow=rainRate!=0.0f||!sources.empty();
+		if(inflow)
+			simulator->setRainAndSources(rainRate,sources);
+		
+		/* Write the stream header and the initial state: */
+		IO::FilePtr outputFile=IO::openFile(outputFileName,IO::File::WriteOnly);
+		writeHeader(*outputFile,dem);
+		unsigned int numSteps=0;
+		double simulationTime=0.0;
+		if(interval>0.0)
+			{
+			simulator->getWaterLevel(&waterLevel[0]);
+			writeFrame(*outputFile,simulationTime,numSteps,waterLevel);
+			}
+		double nextOutputTime=interval;
+		
+		/* Run the simulation as fast as possible: */
+		Realtime::TimePointMonotonic startTime;
+		double outputTime=0.0;
+		while(simulationTime<duration)
+			{
+			/* Turn off all inflow once its duration has elapsed: */
+			if(inflow&&inflowDuration>=0.0&&simulationTime>=inflowDuration)
+				{
+				simulator->setRainAndSources(0.0f,std::vector<WaterSource>());
+				inflow=false;
+				}
+			
+			simulationTime+=double(simulator->runSimulationStep());
+			++numSteps;
+			
+			if(interval>0.0&&simulationTime>=nextOutputTime)
+				{
+				/* Write the current water level, excluding the write time from the simulation time measurement: */
+				Realtime::TimePointMonotonic outputStart;
+				simulator->getWaterLevel(&waterLevel[0]);
+				writeFrame(*outputFile,simulationTime,numSteps,waterLevel);
+				outputTime+=double(outputStart.setAndDiff());
+				while(nextOutputTime<=simulationTime)
+					nextOutputTime+=interval;
+				
+				std::cout<<"\rSimulated "<<simulationTime<<" s in "<<numSteps<<" steps"<<std::flush;
+				}
+			}
+		simulator->finish();
+		double elapsed=double(startTime.setAndDiff());
+		std::cout<<std::endl;
+		
+		/* Print solver throughput: */
+		double simulationElapsed=elapsed-outputTime;
+		std::cout<<"Simulated "<<simulationTime<<" s in "<<numSteps<<" steps, "<<elapsed<<" s wall time ("<<outputTime<<" s output)"<<std::endl;
+		std::cout<<"Average step size: "<<simulationTime/double(numSteps)<<" s"<<std::endl;
+		std::cout<<"Throughput: "<<double(numCells)*double(numSteps)/simulationElapsed<<" cells*steps/s"<<std::endl;
+		
+		delete simulator;
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cerr<<"SimulateWater: Terminated due to exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
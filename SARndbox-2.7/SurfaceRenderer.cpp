@@ -27,6 +27,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Misc/PrintInteger.h>
 #include <Misc/ThrowStdErr.h>
 #include <Misc/MessageLogger.h>
+#include <Realtime/Time.h>
+#include <Math/Math.h>
+#include <Geometry/HVector.h>
 #include <GL/gl.h>
 #include <GL/GLVertexArrayParts.h>
 #include <GL/Extensions/GLARBFragmentShader.h>
@@ -46,6 +49,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include "ElevationColorMap.h"
 #include "DEM.h"
 #include "WaterTable2.h"
+#include "ContourLineExtractor.h"
 #include "ShaderHelper.h"
 #include "Config.h"
 
@@ -54,7 +58,7 @@ Methods of class SurfaceRenderer::DataItem:
 ******************************************/
 
 SurfaceRenderer::DataItem::DataItem(void)
-	:contourLineFramebufferObject(0),contourLineDepthBufferObject(0),contourLineColorTextureObject(0),contourLineVersion(0),
+	:contourLineFramebufferObject(0),contourLineDepthBufferObject(0),contourLineColorTextureObject(0),contourLineVersion(0),contourLineProjectionModelview(PTransform::identity),
 	 heightMapShader(0),surfaceSettingsVersion(0),lightTrackerVersion(0),
 	 globalAmbientHeightMapShader(0),shadowedIlluminatedHeightMapShader(0)
 	{
@@ -355,7 +359,7 @@ GLhandleARB SurfaceRenderer::createSinglePassSurfaceShader(const GLLightTracker&
 				}
 			}
 		
-		if(drawContourLines)
+		if(drawContourLines&&contourLineExtractor==0)
 			{
 			/* Declare the contour line function: */
 			fragmentDeclarations+="\
@@ -452,7 +456,7 @@ GLhandleARB SurfaceRenderer::createSinglePassSurfaceShader(const GLLightTracker&
 			*(ulPtr++)=glGetUniformLocationARB(result,"heightColorMapPlaneEq");
 			*(ulPtr++)=glGetUniformLocationARB(result,"heightColorMapSampler");
 			}
-		if(drawContourLines)
+		if(drawContourLines&&contourLineExtractor==0)
 			{
 			*(ulPtr++)=glGetUniformLocationARB(result,"pixelCornerElevationSampler");
 			*(ulPtr++)=glGetUniformLocationARB(result,"contourLineFactor");
@@ -517,8 +521,12 @@ void SurfaceRenderer::renderPixelCornerElevations(const int viewport[4],const PT
 	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->contourLineFramebufferObject);
 	
 	/* Check if the contour line frame buffer needs to be resized: */
+	bool fullUpdate=false;
 	if(dataItem->contourLineFramebufferSize[0]!=(unsigned int)(viewport[2]+1)||dataItem->contourLineFramebufferSize[1]!=(unsigned int)(viewport[3]+1))
 		{
+		/* Re-render the entire frame buffer after resizing: */
+		fullUpdate=true;
+		
 		/* Remember if the render buffers must still be attached to the frame buffer: */
 		bool mustAttachBuffers=dataItem->contourLineFramebufferSize[0]==0&&dataItem->contourLineFramebufferSize[1]==0;
 		
@@ -549,11 +557,6 @@ void SurfaceRenderer::renderPixelCornerElevations(const int viewport[4],const PT
 			}
 		}
 	
-	/* Extend the viewport to render the corners of all pixels: */
-	glViewport(0,0,viewport[2]+1,viewport[3]+1);
-	glClearColor(0.0f,0.0f,0.0f,1.0f);
-	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-	
 	/* Shift the projection matrix by half a pixel to render the corners of the final pixels: */
 	PTransform shiftedProjectionModelview=projectionModelview;
 	PTransform::Matrix& spmm=shiftedProjectionModelview.getMatrix();
@@ -565,8 +568,88 @@ void SurfaceRenderer::renderPixelCornerElevations(const int viewport[4],const PT
 		spmm(1,j)*=ys;
 		}
 	
-	/* Render the surface elevation into the half-pixel offset frame buffer: */
-	depthImageRenderer->renderElevation(shiftedProjectionModelview,contextData);
+	/* Re-render the entire frame buffer if the projection changed: */
+	const Scalar* cpmPtr=dataItem->contourLineProjectionModelview.getMatrix().getEntries();
+	const Scalar* pmPtr=projectionModelview.getMatrix().getEntries();
+	for(int i=0;i<16;++i)
+		fullUpdate=fullUpdate||cpmPtr[i]!=pmPtr[i];
+	
+	/* Determine the frame buffer region that needs to be re-rendered: */
+	int fbSize[2]={viewport[2]+1,viewport[3]+1};
+	int update[4]={0,0,fbSize[0],fbSize[1]}; // Lower-left corner and size of update region
+	DepthImageRenderer::Box dirtyRegion;
+	if(!fullUpdate&&depthImageRenderer->getDirtyRegion(dataItem->contourLineVersion,dirtyRegion))
+		{
+		if(dirtyRegion.isNull())
+			{
+			/* Nothing changed: */
+			update[2]=update[3]=0;
+			}
+		else
+			{
+			/* Project the dirty region's corners into the frame buffer: */
+			PTransform pmvdp=shiftedProjectionModelview;
+			pmvdp*=depthImageRenderer->getDepthProjection();
+			Scalar min[2],max[2];
+			for(int i=0;i<2;++i)
+				{
+				min[i]=Scalar(fbSize[i]);
+				max[i]=Scalar(0);
+				}
+			bool inFront=true;
+			for(int vertex=0;vertex<8&&inFront;++vertex)
+				{
+				Geometry::HVector<Scalar,3> clip=pmvdp.transform(Geometry::HVector<Scalar,3>(dirtyRegion.getVertex(vertex)));
+				inFront=clip[3]>Scalar(0);
+				for(int i=0;i<2;++i)
+					{
+					Scalar fb=(clip[i]/clip[3]+Scalar(1))*Scalar(0.5)*Scalar(fbSize[i]);
+					min[i]=Math::min(min[i],fb);
+					max[i]=Math::max(max[i],fb);
+					}
+				}
+			
+			/* Add a safety margin of two pixels and clamp the region to the frame buffer, or fall back to a full update: */
+			for(int i=0;i<2&&inFront;++i)
+				{
+				int rMin=int(Math::floor(Math::max(min[i]-Scalar(2),Scalar(0))));
+				int rMax=int(Math::ceil(Math::min(max[i]+Scalar(2),Scalar(fbSize[i]))));
+				update[i]=rMin;
+				update[2+i]=Math::max(rMax-rMin,0);
+				}
+			if(!inFront)
+				{
+				update[0]=update[1]=0;
+				update[2]=fbSize[0];
+				update[3]=fbSize[1];
+				}
+			}
+		}
+	numContourLinePixels=(unsigned int)(update[2]*update[3]);
+	
+	if(numContourLinePixels>0)
+		{
+		/* Extend the viewport to render the corners of all pixels: */
+		glViewport(0,0,fbSize[0],fbSize[1]);
+		
+		/* Restrict rendering to the update region: */
+		glPushAttrib(GL_SCISSOR_BIT);
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(update[0],update[1],update[2],update[3]);
+		
+		/* Clear the update region: */
+		glClearColor(0.0f,0.0f,0.0f,1.0f);
+		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+		
+		/* Render the surface elevation into the half-pixel offset frame buffer: */
+		depthImageRenderer->renderElevation(shiftedProjectionModelview,contextData);
+		
+		glPopAttrib();
+		}
+	
+	/* Mark the pixel-corner elevation texture as up-to-date: */
+	dataItem->contourLineVersion=depthImageRenderer->getDepthImageVersion();
+	dataItem->contourLineProjectionModelview=projectionModelview;
 	
 	/* Restore the original viewport: */
 	glViewport(viewport[0],viewport[1],viewport[2],viewport[3]);
@@ -579,6 +662,7 @@ void SurfaceRenderer::renderPixelCornerElevations(const int viewport[4],const PT
 SurfaceRenderer::SurfaceRenderer(const DepthImageRenderer* sDepthImageRenderer)
 	:depthImageRenderer(sDepthImageRenderer),
 	 drawContourLines(true),contourLineFactor(1.0f),
+	 contourLineExtractor(0),contourLineExtractorVersion(0),contourLineExtractionTime(0.0),numContourLinePixels(0),
 	 elevationColorMap(0),
 	 drawDippingBed(false),dippingBedFolded(false),
 	 dippingBedPlane(Plane::Vector(0,0,1),0.0f),dippingBedThickness(1),
@@ -612,6 +696,11 @@ SurfaceRenderer::SurfaceRenderer(const DepthImageRenderer* sDepthImageRenderer)
 	fileMonitor.startPolling();
 	}
 
+SurfaceRenderer::~SurfaceRenderer(void)
+	{
+	delete contourLineExtractor;
+	}
+
 void SurfaceRenderer::initContext(GLContextData& contextData) const
 	{
 	/* Create a data item and add it to the context: */
@@ -663,6 +752,41 @@ void SurfaceRenderer::setContourLineDistance(GLfloat newContourLineDistance)
 	{
 	/* Set the new contour line factor: */
 	contourLineFactor=1.0f/newContourLineDistance;
+	
+	/* Invalidate the current contour line polylines: */
+	contourLineExtractorVersion=0;
+	}
+
+void SurfaceRenderer::setCpuContourLines(bool newCpuContourLines)
+	{
+	if(newCpuContourLines&&contourLineExtractor==0)
+		{
+		/* Create a contour line extractor: */
+		contourLineExtractor=new ContourLineExtractor(depthImageRenderer);
+		contourLineExtractorVersion=0;
+		}
+	else if(!newCpuContourLines&&contourLineExtractor!=0)
+		{
+		/* Delete the contour line extractor: */
+		delete contourLineExtractor;
+		contourLineExtractor=0;
+		}
+	
+	/* Remove the contour line function from the surface shader or add it back: */
+	++surfaceSettingsVersion;
+	}
+
+void SurfaceRenderer::updateContourLines(void)
+	{
+	/* Check if contour line polylines need to be extracted from a new depth image or with a new contour line distance: */
+	if(drawContourLines&&contourLineExtractor!=0&&contourLineExtractorVersion!=depthImageRenderer->getDepthImageVersion())
+		{
+		/* Extract and time contour line polylines: */
+		Realtime::TimePointMonotonic extractionStart;
+		contourLineExtractor->extractContourLines(1.0f/contourLineFactor);
+		contourLineExtractionTime=double(extractionStart.setAndDiff());
+		contourLineExtractorVersion=depthImageRenderer->getDepthImageVersion();
+		}
 	}
 
 void SurfaceRenderer::setElevationColorMap(ElevationColorMap* newElevationColorMap)
@@ -770,8 +894,8 @@ void SurfaceRenderer::renderSinglePass(const int viewport[4],const PTransform& p
 	PTransform projectionModelview=projection;
 	projectionModelview*=modelview;
 	
-	/* Check if contour line rendering is enabled: */
-	if(drawContourLines)
+	/* Check if contour line rendering on the GPU is enabled: */
+	if(drawContourLines&&contourLineExtractor==0)
 		{
 		/* Run the first rendering pass to create a half-pixel offset texture of surface elevations: */
 		renderPixelCornerElevations(viewport,projectionModelview,contextData,dataItem);
@@ -843,7 +967,7 @@ void SurfaceRenderer::renderSinglePass(const int viewport[4],const PTransform& p
 		glUniform1iARB(*(ulPtr++),1);
 		}
 	
-	if(drawContourLines)
+	if(drawContourLines&&contourLineExtractor==0)
 		{
 		/* Bind the pixel corner elevation texture: */
 		glActiveTextureARB(GL_TEXTURE2_ARB);
@@ -948,7 +1072,7 @@ void SurfaceRenderer::renderSinglePass(const int viewport[4],const PTransform& p
 		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_T,GL_CLAMP);
 		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
 		}
-	if(drawContourLines)
+	if(drawContourLines&&contourLineExtractor==0)
 		{
 		glActiveTextureARB(GL_TEXTURE2_ARB);
 		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
@@ -968,6 +1092,34 @@ void SurfaceRenderer::renderSinglePass(const int viewport[4],const PTransform& p
 	
 	/* Unbind the height map shader: */
 	glUseProgramObjectARB(0);
+	
+	if(drawContourLines&&contourLineExtractor!=0)
+		{
+		/* Render the contour line polylines on top of the surface, pulled slightly towards the viewer to prevent z fighting: */
+		glPushAttrib(GL_ENABLE_BIT|GL_CURRENT_BIT|GL_DEPTH_BUFFER_BIT|GL_LINE_BIT|GL_VIEWPORT_BIT);
+		glDisable(GL_LIGHTING);
+		glDepthFunc(GL_LEQUAL);
+		glDepthRange(0.0,0.9999);
+		glLineWidth(1.0f);
+		glColor3f(0.0f,0.0f,0.0f);
+		
+		/* Set up the surface's projection and modelview matrices: */
+		glMatrixMode(GL_PROJECTION);
+		glPushMatrix();
+		glLoadMatrix(projection);
+		glMatrixMode(GL_MODELVIEW);
+		glPushMatrix();
+		glLoadMatrix(modelview);
+		
+		contourLineExtractor->glRenderAction();
+		
+		/* Restore OpenGL state: */
+		glPopMatrix();
+		glMatrixMode(GL_PROJECTION);
+		glPopMatrix();
+		glMatrixMode(GL_MODELVIEW);
+		glPopAttrib();
+		}
 	}
 
 #if 0
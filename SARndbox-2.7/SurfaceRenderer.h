@@ -39,6 +39,7 @@ class ElevationColorMap;
 class GLLightTracker;
 class DEM;
 class WaterTable2;
+class ContourLineExtractor;
 
 class SurfaceRenderer:public GLObject
 	{
@@ -56,6 +57,7 @@ class SurfaceRenderer:public GLObject
 		GLuint contourLineDepthBufferObject; // Depth render buffer for topographic contour line frame buffer
 		GLuint contourLineColorTextureObject; // Color texture object for topographic contour line frame buffer
 		unsigned int contourLineVersion; // Version number of depth image used for contour line generation
+		PTransform contourLineProjectionModelview; // Projection and modelview matrix used for contour line generation
 		GLhandleARB heightMapShader; // Shader program to render the surface using a height color map
 		GLint heightMapShaderUniforms[16]; // Locations of the height map shader's uniform variables
 		unsigned int surfaceSettingsVersion; // Version number of surface settings for which the height map shader was built
@@ -78,6 +80,10 @@ class SurfaceRenderer:public GLObject
 	
 	bool drawContourLines; // Flag if topographic contour lines are enabled
 	GLfloat contourLineFactor; // Inverse elevation distance between adjacent topographic contour lines
+	ContourLineExtractor* contourLineExtractor; // Extractor for contour line polylines if contour lines are extracted on the CPU
+	unsigned int contourLineExtractorVersion; // Version number of depth image from which contour line polylines were extracted
+	double contourLineExtractionTime; // Time taken by the most recent contour line polyline extraction in seconds
+	mutable unsigned int numContourLinePixels; // Number of pixels re-rendered during the most recent update of the pixel-corner elevation texture
 	
 	ElevationColorMap* elevationColorMap; // Pointer to a color map for topographic elevation map coloring
 	
@@ -107,6 +113,7 @@ class SurfaceRenderer:public GLObject
 	/* Constructors and destructors: */
 	public:
 	SurfaceRenderer(const DepthImageRenderer* sDepthImageRenderer); // Creates a renderer for the given depth image renderer
+	virtual ~SurfaceRenderer(void);
 	
 	/* Methods from GLObject: */
 	virtual void initContext(GLContextData& contextData) const;
@@ -114,6 +121,20 @@ class SurfaceRenderer:public GLObject
 	/* New methods: */
 	void setDrawContourLines(bool newDrawContourLines); // Enables or disables topographic contour lines
 	void setContourLineDistance(GLfloat newContourLineDistance); // Sets the elevation distance between adjacent topographic contour lines
+	void setCpuContourLines(bool newCpuContourLines); // Enables or disables extracting topographic contour lines as polylines on the CPU instead of rendering them on the GPU
+	void updateContourLines(void); // Extracts contour line polylines from the current depth image if CPU contour line extraction is enabled
+	const ContourLineExtractor* getContourLineExtractor(void) const // Returns the CPU contour line extractor, or null if contour lines are rendered on the GPU
+		{
+		return contourLineExtractor;
+		}
+	double getContourLineExtractionTime(void) const // Returns the time taken by the most recent CPU contour line extraction in seconds
+		{
+		return contourLineExtractionTime;
+		}
+	unsigned int getNumContourLinePixels(void) const // Returns the number of pixels re-rendered during the most recent update of the GPU contour line source texture
+		{
+		return numContourLinePixels;
+		}
 	void setElevationColorMap(ElevationColorMap* newElevationColorMap); // Sets an elevation color map
 	void setDrawDippingBed(bool newDrawDippingBed); // Sets the dipping bed flag
 	void setDippingBedPlane(const Plane& newDippingBedPlane); // Sets the dipping bed plane equation
@@ -1,7 +1,7 @@
 /***********************************************************************
 ClusterPipe - Base class providing a 1-to-n intra-cluster communication
 pattern using a cluster multiplexer.
-Copyright (c) 2011-2012 Oliver Kreylos
+Copyright (c) 2011-2020 Oliver Kreylos
 
 This file is part of the Cluster Abstraction Library (Cluster).
 
@@ -73,6 +73,10 @@ class ClusterPipe
 		{
 		return multiplexer->getNodeIndex();
 		}
+	Multiplexer::PipeStatistics getStatistics(void) const // Convenience method to get this pipe's traffic counters
+		{
+		return multiplexer->getPipeStatistics(pipeId);
+		}
 	bool isReadCoupled(void) const // Returns true if reading on the master and slaves is tightly coupled
 		{
 		return readCoupled;
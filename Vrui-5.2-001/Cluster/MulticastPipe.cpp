@@ -2,7 +2,7 @@
 MulticastPipe - Class to represent data streams between a single master
 and several slaves, with the bulk of communication from the master to
 all the slaves in parallel.
-Copyright (c) 2005-2015 Oliver Kreylos
+Copyright (c) 2005-2020 Oliver Kreylos
 
 This file is part of the Cluster Abstraction Library (Cluster).
 
@@ -64,7 +64,7 @@ void MulticastPipe::writeData(const IO::File::Byte* buffer,size_t bufferSize)
 	
 	/* Install a fresh cluster packet as the write buffer: */
 	packet=multiplexer->newPacket();
-	setWriteBuffer(Packet::maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
+	setWriteBuffer(maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
 	}
 
 size_t MulticastPipe::writeDataUpTo(const IO::File::Byte* buffer,size_t bufferSize)
@@ -79,7 +79,7 @@ size_t MulticastPipe::writeDataUpTo(const IO::File::Byte* buffer,size_t bufferSi
 	
 	/* Install a fresh cluster packet as the write buffer: */
 	packet=multiplexer->newPacket();
-	setWriteBuffer(Packet::maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
+	setWriteBuffer(maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
 	
 	return bufferSize;
 	}
@@ -92,14 +92,15 @@ void MulticastPipe::flushPipe(void)
 
 MulticastPipe::MulticastPipe(Multiplexer* sMultiplexer)
 	:IO::File(),ClusterPipe(sMultiplexer),
-	 packet(0)
+	 packet(0),
+	 maxPacketSize(Packet::maxPacketSize)
 	{
 	/* Set up the master or slave buffers: */
 	if(isMaster())
 		{
 		/* Install a fresh cluster packet as the write buffer: */
 		packet=multiplexer->newPacket();
-		setWriteBuffer(Packet::maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
+		setWriteBuffer(maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
 		
 		/* Disable direct writes: */
 		canWriteThrough=false;
@@ -142,6 +143,23 @@ MulticastPipe::~MulticastPipe(void)
 		multiplexer->deletePacket(packet);
 	}
 
+void MulticastPipe::setFecGroupSize(unsigned int newFecGroupSize)
+	{
+	/* Send any buffered data with the current packet size: */
+	if(isMaster())
+		flush();
+	
+	/* Configure the multiplexer: */
+	multiplexer->setFecGroupSize(pipeId,newFecGroupSize);
+	
+	if(isMaster())
+		{
+		/* Leave room for the parity header in packets if forward error correction is enabled: */
+		maxPacketSize=newFecGroupSize!=0?Multiplexer::getMaxFecPacketSize():Packet::maxPacketSize;
+		setWriteBuffer(maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
+		}
+	}
+
 size_t MulticastPipe::getReadBufferSize(void) const
 	{
 	/* Return the maximum cluster packet size: */
@@ -150,8 +168,8 @@ size_t MulticastPipe::getReadBufferSize(void) const
 
 size_t MulticastPipe::getWriteBufferSize(void) const
 	{
-	/* Return the maximum cluster packet size: */
-	return Packet::maxPacketSize;
+	/* Return the maximum amount of data written into a single packet: */
+	return maxPacketSize;
 	}
 
 size_t MulticastPipe::resizeReadBuffer(size_t newReadBufferSize)
@@ -2,7 +2,7 @@
 MulticastPipe - Class to represent data streams between a single master
 and several slaves, with the bulk of communication from the master to
 all the slaves in parallel.
-Copyright (c) 2005-2015 Oliver Kreylos
+Copyright (c) 2005-2020 Oliver Kreylos
 
 This file is part of the Cluster Abstraction Library (Cluster).
 
@@ -41,6 +41,7 @@ class MulticastPipe:public IO::File,public ClusterPipe
 	private:
 	Packet* packet; // Pointer to current packet
 	size_t packetPos; // Data position in current packet
+	size_t maxPacketSize; // Maximum amount of data written into a single packet
 	
 	/* Protected methods from IO::File: */
 	protected:
@@ -67,6 +68,7 @@ class MulticastPipe:public IO::File,public ClusterPipe
 	virtual void resizeWriteBuffer(size_t newWriteBufferSize);
 	
 	/* New methods: */
+	void setFecGroupSize(unsigned int newFecGroupSize); // Protects every group of up to the given number of packets with a parity packet to recover from single packet losses without retransmission; 0 disables forward error correction; must be called on all nodes; implies a barrier
 	template <class DataParam>
 	void broadcast(DataParam& data) // Sends single value of arbitrary type from master to all slaves; does not change value on master
 		{
@@ -1,7 +1,7 @@
 /***********************************************************************
 Multiplexer - Class to share several intra-cluster multicast pipes
 across a single UDP socket connection.
-Copyright (c) 2005-2012 Oliver Kreylos
+Copyright (c) 2005-2020 Oliver Kreylos
 
 This file is part of the Cluster Abstraction Library (Cluster).
 
@@ -29,6 +29,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -53,6 +54,28 @@ inline bool isMulticast(const struct in_addr& netAddress) // Returns true if the
 	return address>=(0xe0<<24)&&address<(0xf0<<24);
 	}
 
+const unsigned int parityPipeIdFlag=0x40000000U; // Flag set in the pipe ID of forward error correction parity packets
+
+inline void xorBytes(char* dest,const char* source,size_t size) // XORs the given source bytes into the given destination bytes
+	{
+	for(size_t i=0;i<size;++i)
+		dest[i]^=source[i];
+	}
+
+void accumulateParity(Packet* parity,const Packet* packet,size_t headerSize) // Folds the given packet's data into the given parity packet's parity data following a header of the given size
+	{
+	/* Extend the parity data with zeros if the packet is larger than any previous packet in the group: */
+	size_t paritySize=headerSize+packet->packetSize;
+	if(parity->packetSize<paritySize)
+		{
+		memset(parity->packet+parity->packetSize,0,paritySize-parity->packetSize);
+		parity->packetSize=paritySize;
+		}
+	
+	/* Fold the packet's data into the parity data: */
+	xorBytes(parity->packet+headerSize,packet->packet,packet->packetSize);
+	}
+
 }
 
 /***************************************************
@@ -123,11 +146,8 @@ Multiplexer::PipeState::PipeState(unsigned int nodeIndex,unsigned int numSlaves)
 	 headStreamPos(0),
 	 slaveStreamPosOffsets(0),numHeadSlaves(0),
 	 barrierId(0),slaveBarrierIds(0),minSlaveBarrierId(0),
-	 slaveGatherValues(0)
-	 #if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-	 ,
-	 numResentPackets(0),numResentBytes(0)
-	 #endif
+	 slaveGatherValues(0),
+	 fecGroupSize(0),fecSynchronized(false),fecGroupStart(0),fecNumPackets(0),fecParity(0)
 	{
 	if(nodeIndex==0)
 		{
@@ -162,6 +182,9 @@ Multiplexer::PipeState::~PipeState(void)
 	
 	/* Destroy slave gather value array: */
 	delete[] slaveGatherValues;
+	
+	/* Destroy the parity accumulator: */
+	delete fecParity;
 	}
 	}
 
@@ -279,6 +302,319 @@ Packet* Multiplexer::allocatePacket(void)
 	return new Packet;
 	}
 
+unsigned int Multiplexer::receiveBatch(void* const buffers[],ssize_t bufferSizes[])
+	{
+	#if CLUSTER_CONFIG_HAVE_MMSG
+	
+	/* Set up message headers pointing to the given buffers: */
+	struct iovec iovecs[ioBatchSize];
+	struct mmsghdr messages[ioBatchSize];
+	memset(messages,0,sizeof(messages));
+	for(unsigned int i=0;i<ioBatchSize;++i)
+		{
+		iovecs[i].iov_base=buffers[i];
+		iovecs[i].iov_len=Packet::maxRawPacketSize;
+		messages[i].msg_hdr.msg_iov=&iovecs[i];
+		messages[i].msg_hdr.msg_iovlen=1;
+		}
+	
+	/* Block until the first packet arrives, then grab any others that are already waiting: */
+	int numReceived=recvmmsg(socketFd,messages,ioBatchSize,MSG_WAITFORONE,0);
+	if(numReceived<=0)
+		{
+		/* Report the error in the first buffer: */
+		bufferSizes[0]=-1;
+		return 1;
+		}
+	
+	for(int i=0;i<numReceived;++i)
+		bufferSizes[i]=ssize_t(messages[i].msg_len);
+	return (unsigned int)numReceived;
+	
+	#else
+	
+	/* Receive a single packet: */
+	bufferSizes[0]=recv(socketFd,buffers[0],Packet::maxRawPacketSize,0);
+	return 1;
+	
+	#endif
+	}
+
+void Multiplexer::adjustReceiveBufferSize(void)
+	{
+	/* Request a socket receive buffer that can hold the full send queues of several pipes, which matters for large MTU sizes: */
+	int receiveBufferSize=int(4*sendBufferSize*Packet::maxRawPacketSize);
+	int currentReceiveBufferSize=0;
+	socklen_t optionLen=sizeof(int);
+	if(getsockopt(socketFd,SOL_SOCKET,SO_RCVBUF,&currentReceiveBufferSize,&optionLen)==0&&currentReceiveBufferSize<receiveBufferSize)
+		setsockopt(socketFd,SOL_SOCKET,SO_RCVBUF,&receiveBufferSize,sizeof(int));
+	}
+
+void Multiplexer::sendPacketList(Packet* packets)
+	{
+	#if CLUSTER_CONFIG_HAVE_MMSG
+	
+	struct iovec iovecs[ioBatchSize];
+	struct mmsghdr messages[ioBatchSize];
+	memset(messages,0,sizeof(messages));
+	while(packets!=0)
+		{
+		/* Collect the next batch of packets: */
+		unsigned int numMessages;
+		for(numMessages=0;numMessages<ioBatchSize&&packets!=0;++numMessages,packets=packets->succ)
+			{
+			iovecs[numMessages].iov_base=&packets->pipeId;
+			iovecs[numMessages].iov_len=packets->packetSize+2*sizeof(unsigned int);
+			messages[numMessages].msg_hdr.msg_name=otherAddress;
+			messages[numMessages].msg_hdr.msg_namelen=sizeof(sockaddr_in);
+			messages[numMessages].msg_hdr.msg_iov=&iovecs[numMessages];
+			messages[numMessages].msg_hdr.msg_iovlen=1;
+			}
+		
+		/* Send the batch; the kernel might send fewer messages than requested: */
+		unsigned int numSent=0;
+		while(numSent<numMessages)
+			{
+			int result=sendmmsg(socketFd,messages+numSent,numMessages-numSent,0);
+			if(result<=0)
+				break; // Lost packets will be requested again by the slaves
+			numSent+=result;
+			}
+		}
+	
+	#else
+	
+	/* Send the packets one at a time: */
+	for(;packets!=0;packets=packets->succ)
+		sendto(socketFd,&packets->pipeId,packets->packetSize+2*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+	
+	#endif
+	}
+
+void Multiplexer::resetFec(Multiplexer::PipeState& pipeState)
+	{
+	/* Start a new empty packet group at the current stream position: */
+	pipeState.fecSynchronized=true;
+	pipeState.fecGroupStart=pipeState.streamPos;
+	pipeState.fecNumPackets=0;
+	if(pipeState.fecParity!=0)
+		pipeState.fecParity->packetSize=fecHeaderSize;
+	}
+
+Packet* Multiplexer::closeFecGroup(Multiplexer::PipeState& pipeState)
+	{
+	/* Bail out if there is no open packet group: */
+	if(pipeState.fecGroupSize==0||pipeState.fecNumPackets==0)
+		return 0;
+	
+	/* Finalize the current parity packet: */
+	Packet* result=pipeState.fecParity;
+	result->succ=0;
+	result->pipeId=pipeState.pipeId|parityPipeIdFlag;
+	result->streamPos=pipeState.fecGroupStart;
+	unsigned int header[2];
+	header[0]=pipeState.streamPos; // Stream position after the last packet in the group
+	header[1]=pipeState.fecNumPackets;
+	memcpy(result->packet,header,fecHeaderSize);
+	++pipeState.statistics.numParityPackets;
+	
+	/* Start a new packet group with a fresh parity accumulator: */
+	pipeState.fecParity=newPacket();
+	resetFec(pipeState);
+	
+	return result;
+	}
+
+void Multiplexer::requestResend(Multiplexer::LockedPipe& pipeState,unsigned int packetPos)
+	{
+	/* Don't send further loss messages until the missing packet arrives: */
+	if(pipeState->packetLossMode)
+		return;
+	
+	/* Send negative acknowledgment to the master: */
+	StreamMessage msg(nodeIndex|0x80000000U,Message::PACKETLOSS,pipeState->pipeId,pipeState->streamPos,packetPos);
+	{
+	// SocketMutex::Lock socketLock(socketMutex);
+	for(int i=0;i<slaveMessageBurstSize;++i)
+		sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
+	}
+	++pipeState->statistics.numPacketLossMessages;
+	
+	/* Enable packet loss mode: */
+	pipeState->packetLossMode=true;
+	}
+
+void Multiplexer::deliverPacket(Multiplexer::LockedPipe& pipeState,Packet* packet,unsigned int& sendAckIn)
+	{
+	/* Disable packet loss mode: */
+	pipeState->packetLossMode=false;
+	++pipeState->statistics.numReceivedPackets;
+	pipeState->statistics.numReceivedBytes+=packet->packetSize;
+	
+	++sendAckIn;
+	if(sendAckIn==numSlaves)
+		{
+		/* Send positive acknowledgment to the master: */
+		StreamMessage msg(nodeIndex|0x80000000U,Message::ACKNOWLEDGMENT,pipeState->pipeId,pipeState->streamPos,packet->streamPos);
+		{
+		// SocketMutex::Lock socketLock(socketMutex);
+		sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
+		}
+		sendAckIn=0;
+		}
+	
+	/* Wake up sleeping receivers if the delivery queue is currently empty: */
+	if(pipeState->packetList.empty())
+		pipeState->receiveCond.signal();
+	
+	/* Append the packet to the pipe state's delivery queue: */
+	pipeState->streamPos+=packet->packetSize;
+	pipeState->packetList.push_back(packet);
+	}
+
+void Multiplexer::deliverPendingPackets(Multiplexer::LockedPipe& pipeState,unsigned int& sendAckIn)
+	{
+	/* Deliver pending packets as long as they continue the stream: */
+	while(!pipeState->pendingPackets.empty()&&pipeState->pendingPackets.front()->streamPos==pipeState->streamPos)
+		deliverPacket(pipeState,pipeState->pendingPackets.pop_front(),sendAckIn);
+	}
+
+void Multiplexer::receiveFecPacket(Multiplexer::LockedPipe& pipeState,Packet*& packet,unsigned int& sendAckIn)
+	{
+	/* Discard the packet if it was already delivered; watch for stream position wrap-around: */
+	unsigned int packetOffset=packet->streamPos-pipeState->streamPos;
+	if(packetOffset>=0x80000000U)
+		{
+		++pipeState->statistics.numDiscardedPackets;
+		return;
+		}
+	
+	/* Find the packet's position in the pending list, and discard the packet if it was already received: */
+	PipeState::PacketList& pending=pipeState->pendingPackets;
+	Packet* pred=0;
+	Packet* succ;
+	for(succ=pending.head;succ!=0&&succ->streamPos-pipeState->streamPos<packetOffset;pred=succ,succ=succ->succ)
+		;
+	if(succ!=0&&succ->streamPos==packet->streamPos)
+		{
+		++pipeState->statistics.numDiscardedPackets;
+		return;
+		}
+	
+	/* Fold the packet into the current packet group's parity if it belongs to the group: */
+	if(pipeState->fecSynchronized&&packet->streamPos-pipeState->fecGroupStart<0x80000000U)
+		{
+		accumulateParity(pipeState->fecParity,packet,fecHeaderSize);
+		++pipeState->fecNumPackets;
+		}
+	
+	if(packetOffset==0)
+		{
+		/* Deliver the packet and any pending packets following it: */
+		deliverPacket(pipeState,packet,sendAckIn);
+		deliverPendingPackets(pipeState,sendAckIn);
+		}
+	else
+		{
+		/* Insert the packet into the pending list to wait for the missing data to be reconstructed: */
+		packet->succ=succ;
+		if(pred!=0)
+			pred->succ=packet;
+		else
+			pending.head=packet;
+		if(succ==0)
+			pending.tail=packet;
+		++pending.numPackets;
+		
+		/* Fall back to retransmission if parity packets can't keep up with the lost data: */
+		if(pending.size()>2*pipeState->fecGroupSize)
+			requestResend(pipeState,pending.front()->streamPos);
+		}
+	
+	/* Get a new packet: */
+	packet=newPacket();
+	}
+
+void Multiplexer::receiveParityPacket(Multiplexer::LockedPipe& pipeState,const Packet* parity,unsigned int& sendAckIn)
+	{
+	/* Ignore the parity packet if the pipe does not use forward error correction or the packet is malformed: */
+	if(pipeState->fecGroupSize==0||parity->packetSize<fecHeaderSize)
+		return;
+	++pipeState->statistics.numParityPackets;
+	
+	/* Extract the packet group's end stream position and number of packets: */
+	unsigned int header[2];
+	memcpy(header,parity->packet,fecHeaderSize);
+	unsigned int groupEnd=header[0];
+	unsigned int groupNumPackets=header[1];
+	
+	PipeState::PacketList& pending=pipeState->pendingPackets;
+	if(!pipeState->fecSynchronized||parity->streamPos!=pipeState->fecGroupStart)
+		{
+		/* The parity packet does not match the accumulated parity; request any missing data from the master: */
+		if(!pending.empty())
+			requestResend(pipeState,pending.front()->streamPos);
+		}
+	else if(pipeState->fecNumPackets+1==groupNumPackets)
+		{
+		/* Exactly one packet of the group is missing; find the gap it leaves in the group's stream range: */
+		unsigned int missingStart=parity->streamPos;
+		if(missingStart-pipeState->streamPos>=0x80000000U)
+			missingStart=pipeState->streamPos;
+		Packet* pred=0;
+		Packet* succ;
+		for(succ=pending.head;succ!=0&&succ->streamPos-pipeState->streamPos<=missingStart-pipeState->streamPos;pred=succ,succ=succ->succ)
+			if(succ->streamPos==missingStart)
+				missingStart+=succ->packetSize;
+		unsigned int missingEnd=groupEnd;
+		if(succ!=0&&succ->streamPos-pipeState->streamPos<groupEnd-pipeState->streamPos)
+			missingEnd=succ->streamPos;
+		size_t missingSize=missingEnd-missingStart;
+		if(missingSize>0&&missingSize<=parity->packetSize-fecHeaderSize)
+			{
+			/* Reconstruct the missing packet from the parity packet and the accumulated parity: */
+			Packet* recovered=newPacket();
+			recovered->pipeId=pipeState->pipeId;
+			recovered->streamPos=missingStart;
+			recovered->packetSize=missingSize;
+			memcpy(recovered->packet,parity->packet+fecHeaderSize,missingSize);
+			size_t accumulatedSize=pipeState->fecParity->packetSize-fecHeaderSize;
+			xorBytes(recovered->packet,pipeState->fecParity->packet+fecHeaderSize,missingSize<accumulatedSize?missingSize:accumulatedSize);
+			++pipeState->statistics.numRecoveredPackets;
+			
+			if(missingStart==pipeState->streamPos)
+				{
+				/* Deliver the reconstructed packet and any pending packets following it: */
+				deliverPacket(pipeState,recovered,sendAckIn);
+				deliverPendingPackets(pipeState,sendAckIn);
+				}
+			else
+				{
+				/* Insert the reconstructed packet into the pending list; earlier data is still missing: */
+				recovered->succ=succ;
+				if(pred!=0)
+					pred->succ=recovered;
+				else
+					pending.head=recovered;
+				if(succ==0)
+					pending.tail=recovered;
+				++pending.numPackets;
+				}
+			}
+		}
+	else if(pipeState->fecNumPackets<groupNumPackets)
+		{
+		/* More than one packet of the group is missing; fall back to retransmission: */
+		requestResend(pipeState,pending.empty()?groupEnd:pending.front()->streamPos);
+		}
+	
+	/* Start accumulating the next packet group: */
+	pipeState->fecSynchronized=true;
+	pipeState->fecGroupStart=groupEnd;
+	pipeState->fecNumPackets=0;
+	pipeState->fecParity->packetSize=fecHeaderSize;
+	}
+
 void Multiplexer::processAcknowledgment(Multiplexer::LockedPipe& pipeState,int slaveIndex,unsigned int streamPos)
 	{
 	/* Check if the reported stream position points into the packet queue: */
@@ -369,10 +705,10 @@ void* Multiplexer::packetHandlingThreadMaster(void)
 	while(numConnectedSlaves<numSlaves)
 		{
 		/* Wait for a connection initialization packet: */
-		ssize_t numBytesReceived=recv(socketFd,messageBuffer,Packet::maxRawPacketSize,0);
+		ssize_t numBytesReceived=recv(socketFd,messageBuffers,Packet::maxRawPacketSize,0);
 		if(numBytesReceived==sizeof(Message))
 			{
-			Message* msg=static_cast<Message*>(messageBuffer);
+			Message* msg=static_cast<Message*>(messageBuffers);
 			if(msg->nodeIndex&0x80000000U) // Check if the message is from a slave
 				{
 				unsigned int slaveIndex=(msg->nodeIndex&0x7fffffffU)-1;
@@ -402,371 +738,384 @@ void* Multiplexer::packetHandlingThreadMaster(void)
 	connectionCond.broadcast();
 	}
 	
+	/* Set up the batch of message buffers: */
+	void* messageBufferPtrs[ioBatchSize];
+	for(unsigned int i=0;i<ioBatchSize;++i)
+		messageBufferPtrs[i]=static_cast<unsigned char*>(messageBuffers)+i*Packet::maxRawPacketSize;
+	ssize_t messageSizes[ioBatchSize];
+	
 	/* Handle messages from the slaves: */
 	while(true)
 		{
-		/* Wait for a message from any slave: */
-		ssize_t numBytesReceived=recv(socketFd,messageBuffer,Packet::maxRawPacketSize,0);
-		if(numBytesReceived>0&&size_t(numBytesReceived)>=sizeof(Message))
+		/* Wait for one or more messages from any slaves: */
+		unsigned int numMessages=receiveBatch(messageBufferPtrs,messageSizes);
+		for(unsigned int messageIndex=0;messageIndex<numMessages;++messageIndex)
 			{
-			/* Check that the message is not the echo of a server message: */
-			if(static_cast<Message*>(messageBuffer)->nodeIndex&0x80000000U)
+			void* messageBuffer=messageBufferPtrs[messageIndex];
+			ssize_t numBytesReceived=messageSizes[messageIndex];
+			if(numBytesReceived>0&&size_t(numBytesReceived)>=sizeof(Message))
 				{
-				/* Remove the slave message indicator bit from the message's node index: */
-				unsigned int msgNodeIndex=static_cast<Message*>(messageBuffer)->nodeIndex&0x7fffffffU;
-				
-				switch(static_cast<Message*>(messageBuffer)->messageId)
+				/* Check that the message is not the echo of a server message: */
+				if(static_cast<Message*>(messageBuffer)->nodeIndex&0x80000000U)
 					{
-					case Message::CONNECTION:
-						{
-						/* One slave must have missed the connection establishment packet; send another one: */
-						Message msg(0,Message::CONNECTION);
-						{
-						// SocketMutex::Lock socketLock(socketMutex);
-						sendto(socketFd,&msg,sizeof(Message),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-						}
-						break;
-						}
+					/* Remove the slave message indicator bit from the message's node index: */
+					unsigned int msgNodeIndex=static_cast<Message*>(messageBuffer)->nodeIndex&0x7fffffffU;
 					
-					case Message::PING:
-						{
-						/* Broadcast a ping reply to all slaves: */
-						Message msg(0,Message::PING);
+					switch(static_cast<Message*>(messageBuffer)->messageId)
 						{
-						// SocketMutex::Lock socketLock(socketMutex);
-						sendto(socketFd,&msg,sizeof(Message),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-						}
-						break;
-						}
-					
-					case Message::CREATEPIPE1:
-						{
-						CreatePipe1Message* msg=static_cast<CreatePipe1Message*>(messageBuffer);
-						if(size_t(numBytesReceived)>=sizeof(CreatePipe1Message)&&size_t(numBytesReceived)==sizeof(CreatePipe1Message)+msg->idNumParts*sizeof(unsigned int))
+						case Message::CONNECTION:
 							{
-							/* Extract the originating thread's ID from the message: */
-							Threads::Thread::ID senderId(msg->idNumParts,reinterpret_cast<unsigned int*>(msg+1));
-							
-							/* Find the new pipe state corresponding to the thread ID: */
-							PipeState* newPipeState;
+							/* One slave must have missed the connection establishment packet; send another one: */
+							Message msg(0,Message::CONNECTION);
 							{
-							Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
-							NewPipeHasher::Iterator npIt=newPipes.findEntry(senderId);
-							if(npIt.isFinished())
-								{
-								/* If the new pipe state hasn't been created already, do it here: */
-								newPipeState=new PipeState(nodeIndex,numSlaves);
-								
-								/* Add the new pipe state to the new pipe map: */
-								newPipes[senderId]=newPipeState;
-								}
-							else
-								newPipeState=npIt->getDest();
+							// SocketMutex::Lock socketLock(socketMutex);
+							sendto(socketFd,&msg,sizeof(Message),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
 							}
-							
-							/* Lock the new pipe: */
-							LockedPipe pipeState(newPipeState);
-							
-							/* Check the pipe's barrier state for first-stage completion: */
-							bool sendReply=false;
-							if(pipeState->barrierId<1)
+							break;
+							}
+						
+						case Message::PING:
+							{
+							/* Broadcast a ping reply to all slaves: */
+							Message msg(0,Message::PING);
+							{
+							// SocketMutex::Lock socketLock(socketMutex);
+							sendto(socketFd,&msg,sizeof(Message),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+							}
+							break;
+							}
+						
+						case Message::CREATEPIPE1:
+							{
+							CreatePipe1Message* msg=static_cast<CreatePipe1Message*>(messageBuffer);
+							if(size_t(numBytesReceived)>=sizeof(CreatePipe1Message)&&size_t(numBytesReceived)==sizeof(CreatePipe1Message)+msg->idNumParts*sizeof(unsigned int))
 								{
-								/* Remember the slave's barrier completion: */
-								pipeState->slaveBarrierIds[msgNodeIndex-1]=1;
+								/* Extract the originating thread's ID from the message: */
+								Threads::Thread::ID senderId(msg->idNumParts,reinterpret_cast<unsigned int*>(msg+1));
 								
-								/* Check if the current barrier is complete: */
-								pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
-								for(unsigned int i=1;i<numSlaves;++i)
-									if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
-										pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
-								if(pipeState->minSlaveBarrierId>=1)
+								/* Find the new pipe state corresponding to the thread ID: */
+								PipeState* newPipeState;
+								{
+								Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
+								NewPipeHasher::Iterator npIt=newPipes.findEntry(senderId);
+								if(npIt.isFinished())
 									{
-									/* Complete the first barrier: */
-									pipeState->barrierId=1;
-									
-									/* Assign a pipe ID to the new pipe and store it in the pipe state table: */
-									Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
-									do
-										{
-										++lastPipeId;
-										if(lastPipeId==0x80000000U) // Ensure that pipeId never has the MSB set
-											lastPipeId=1;
-										}
-									while(pipeStateTable.isEntry(lastPipeId));
-									pipeState->pipeId=lastPipeId;
-									pipeStateTable[lastPipeId]=newPipeState;
+									/* If the new pipe state hasn't been created already, do it here: */
+									newPipeState=new PipeState(nodeIndex,numSlaves);
 									
-									/* Wake up the thread blocked on the new pipe: */
-									pipeState->barrierCond.signal();
-									
-									/* Send a stage-one pipe creation completion message: */
-									sendReply=true;
+									/* Add the new pipe state to the new pipe map: */
+									newPipes[senderId]=newPipeState;
 									}
+								else
+									newPipeState=npIt->getDest();
 								}
-							else
-								{
-								/* One slave must have missed a stage-one pipe creation completion message; send another one: */
-								sendReply=true;
-								}
-							
-							if(sendReply)
-								{
-								CreatePipe1Message* msg2=static_cast<CreatePipe1Message*>(messageBuffer);
-								msg2->nodeIndex=0;
-								msg2->messageId=Message::CREATEPIPE1;
-								msg2->pipeId=pipeState->pipeId;
-								msg2->idNumParts=senderId.getNumParts();
-								for(unsigned int i=0;i<msg2->idNumParts;++i)
-									reinterpret_cast<unsigned int*>(msg2+1)[i]=senderId.getPart(i);
-								{
-								// SocketMutex::Lock socketLock(socketMutex);
-								sendto(socketFd,messageBuffer,sizeof(CreatePipe1Message)+msg2->idNumParts*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-								}
-								}
-							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE1 message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::CREATEPIPE2:
-						{
-						if(numBytesReceived==sizeof(PipeMessage))
-							{
-							PipeMessage* msg=static_cast<PipeMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
-								{
-								/* Check the pipe's barrier state for second-stage completion: */
-								if(pipeState->barrierId<2)
+								
+								/* Lock the new pipe: */
+								LockedPipe pipeState(newPipeState);
+								
+								/* Check the pipe's barrier state for first-stage completion: */
+								bool sendReply=false;
+								if(pipeState->barrierId<1)
 									{
 									/* Remember the slave's barrier completion: */
-									pipeState->slaveBarrierIds[msgNodeIndex-1]=2;
+									pipeState->slaveBarrierIds[msgNodeIndex-1]=1;
 									
 									/* Check if the current barrier is complete: */
 									pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
 									for(unsigned int i=1;i<numSlaves;++i)
 										if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
 											pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
-									if(pipeState->minSlaveBarrierId>=2)
+									if(pipeState->minSlaveBarrierId>=1)
 										{
-										/* Complete the second barrier: */
-										pipeState->barrierId=2;
-
+										/* Complete the first barrier: */
+										pipeState->barrierId=1;
+										
+										/* Assign a pipe ID to the new pipe and store it in the pipe state table: */
+										Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
+										do
+											{
+											++lastPipeId;
+											if(lastPipeId==parityPipeIdFlag) // Ensure that pipeId never has the MSB or the parity flag set
+												lastPipeId=1;
+											}
+										while(pipeStateTable.isEntry(lastPipeId));
+										pipeState->pipeId=lastPipeId;
+										pipeStateTable[lastPipeId]=newPipeState;
+										
 										/* Wake up the thread blocked on the new pipe: */
 										pipeState->barrierCond.signal();
+										
+										/* Send a stage-one pipe creation completion message: */
+										sendReply=true;
 										}
 									}
+								else
+									{
+									/* One slave must have missed a stage-one pipe creation completion message; send another one: */
+									sendReply=true;
+									}
+								
+								if(sendReply)
+									{
+									CreatePipe1Message* msg2=static_cast<CreatePipe1Message*>(messageBuffer);
+									msg2->nodeIndex=0;
+									msg2->messageId=Message::CREATEPIPE1;
+									msg2->pipeId=pipeState->pipeId;
+									msg2->idNumParts=senderId.getNumParts();
+									for(unsigned int i=0;i<msg2->idNumParts;++i)
+										reinterpret_cast<unsigned int*>(msg2+1)[i]=senderId.getPart(i);
+									{
+									// SocketMutex::Lock socketLock(socketMutex);
+									sendto(socketFd,messageBuffer,sizeof(CreatePipe1Message)+msg2->idNumParts*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+									}
+									}
 								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE2 message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE1 message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE2 message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::ACKNOWLEDGMENT:
-						{
-						if(numBytesReceived==sizeof(StreamMessage))
+						
+						case Message::CREATEPIPE2:
 							{
-							StreamMessage* msg=static_cast<StreamMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							if(numBytesReceived==sizeof(PipeMessage))
 								{
-								/* Process the acknowledgment packet: */
-								processAcknowledgment(pipeState,msgNodeIndex-1,msg->streamPos);
+								PipeMessage* msg=static_cast<PipeMessage*>(messageBuffer);
+								
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
+								
+								if(pipeState.isValid())
+									{
+									/* Check the pipe's barrier state for second-stage completion: */
+									if(pipeState->barrierId<2)
+										{
+										/* Remember the slave's barrier completion: */
+										pipeState->slaveBarrierIds[msgNodeIndex-1]=2;
+										
+										/* Check if the current barrier is complete: */
+										pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
+										for(unsigned int i=1;i<numSlaves;++i)
+											if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
+												pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
+										if(pipeState->minSlaveBarrierId>=2)
+											{
+											/* Complete the second barrier: */
+											pipeState->barrierId=2;
+
+											/* Wake up the thread blocked on the new pipe: */
+											pipeState->barrierCond.signal();
+											}
+										}
+									}
+								#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+								else
+									std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE2 message for non-existent pipe "<<msg->pipeId<<std::endl;
+								#endif
 								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received ACKNOWLEDGMENT message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE2 message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received ACKNOWLEDGMENT message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::PACKETLOSS:
-						{
-						if(numBytesReceived==sizeof(StreamMessage))
+						
+						case Message::ACKNOWLEDGMENT:
 							{
-							StreamMessage* msg=static_cast<StreamMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							if(numBytesReceived==sizeof(StreamMessage))
+								{
+								StreamMessage* msg=static_cast<StreamMessage*>(messageBuffer);
+								
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
+								
+								if(pipeState.isValid())
+									{
+									/* Process the acknowledgment packet: */
+									processAcknowledgment(pipeState,msgNodeIndex-1,msg->streamPos);
+									}
+								#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+								else
+									std::cerr<<"Node "<<nodeIndex<<": received ACKNOWLEDGMENT message for non-existent pipe "<<msg->pipeId<<std::endl;
+								#endif
+								}
+							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+							else
+								std::cerr<<"Node "<<nodeIndex<<": received ACKNOWLEDGMENT message of wrong size "<<numBytesReceived<<std::endl;
+							#endif
+							break;
+							}
+						
+						case Message::PACKETLOSS:
+							{
+							if(numBytesReceived==sizeof(StreamMessage))
 								{
-								/* Use the stream position reported by the client as positive acknowledgment: */
-								processAcknowledgment(pipeState,msgNodeIndex-1,msg->streamPos);
+								StreamMessage* msg=static_cast<StreamMessage*>(messageBuffer);
+								
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
 								
-								/* Resend requested packets if there are any; otherwise, do nothing because master is busy: */
-								if(msg->streamPos!=pipeState->streamPos)
+								if(pipeState.isValid())
 									{
-									#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER_VERBOSE
-									std::cerr<<"Packet loss of "<<msg->packetPos-msg->streamPos<<" bytes from "<<msg->streamPos<<" detected by node "<<msgNodeIndex<<", stream pos is "<<pipeState->streamPos<<", buffer starts at "<<pipeState->headStreamPos<<std::endl;
-									#endif
-									
-									/* Find the recently-sent packet starting at the slave's current stream position: */
-									Packet* packet;
-									for(packet=pipeState->packetList.front();packet!=0&&packet->streamPos!=msg->streamPos;packet=packet->succ)
-										;
+									++pipeState->statistics.numPacketLossMessages;
 									
-									/* Signal a fatal error if the required packet has already been discarded: */
-									if(packet==0)
-										Misc::throwStdErr("Cluster::Multiplexer: Node %u: Fatal packet loss detected at stream position %u",msgNodeIndex,msg->streamPos);
+									/* Use the stream position reported by the client as positive acknowledgment: */
+									processAcknowledgment(pipeState,msgNodeIndex-1,msg->streamPos);
 									
-									{
-									/* Resend all recent packets in order: */
-									// SocketMutex::Lock socketLock(socketMutex);
-									for(;packet!=0;packet=packet->succ)
+									/* Resend requested packets if there are any; otherwise, do nothing because master is busy: */
+									if(msg->streamPos!=pipeState->streamPos)
 										{
-										sendto(socketFd,&packet->pipeId,packet->packetSize+2*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-										#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-										++pipeState->numResentPackets;
-										pipeState->numResentBytes+=packet->packetSize;
+										#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER_VERBOSE
+										std::cerr<<"Packet loss of "<<msg->packetPos-msg->streamPos<<" bytes from "<<msg->streamPos<<" detected by node "<<msgNodeIndex<<", stream pos is "<<pipeState->streamPos<<", buffer starts at "<<pipeState->headStreamPos<<std::endl;
 										#endif
+										
+										/* Find the recently-sent packet starting at the slave's current stream position: */
+										Packet* packet;
+										for(packet=pipeState->packetList.front();packet!=0&&packet->streamPos!=msg->streamPos;packet=packet->succ)
+											;
+										
+										/* Signal a fatal error if the required packet has already been discarded: */
+										if(packet==0)
+											Misc::throwStdErr("Cluster::Multiplexer: Node %u: Fatal packet loss detected at stream position %u",msgNodeIndex,msg->streamPos);
+										
+										/* Update the pipe's resend counters: */
+										for(Packet* pPtr=packet;pPtr!=0;pPtr=pPtr->succ)
+											{
+											++pipeState->statistics.numResentPackets;
+											pipeState->statistics.numResentBytes+=pPtr->packetSize;
+											}
+										
+										{
+										/* Resend all recent packets in order: */
+										// SocketMutex::Lock socketLock(socketMutex);
+										sendPacketList(packet);
+										}
 										}
 									}
-									}
+								#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+								else
+									std::cerr<<"Node "<<nodeIndex<<": received PACKETLOSS message for non-existent pipe "<<msg->pipeId<<std::endl;
+								#endif
 								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received PACKETLOSS message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received PACKETLOSS message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received PACKETLOSS message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::BARRIER:
-						{
-						if(numBytesReceived==sizeof(BarrierMessage))
+						
+						case Message::BARRIER:
 							{
-							BarrierMessage* msg=static_cast<BarrierMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							if(numBytesReceived==sizeof(BarrierMessage))
 								{
-								/* Update the barrier ID array: */
-								if(pipeState->barrierId>=msg->barrierId)
+								BarrierMessage* msg=static_cast<BarrierMessage*>(messageBuffer);
+								
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
+								
+								if(pipeState.isValid())
 									{
-									/* One slave must have missed a barrier completion message; send another one: */
+									/* Update the barrier ID array: */
+									if(pipeState->barrierId>=msg->barrierId)
+										{
+										/* One slave must have missed a barrier completion message; send another one: */
+										BarrierMessage msg2(0,Message::BARRIER,msg->pipeId,msg->barrierId);
+										{
+										// SocketMutex::Lock socketLock(socketMutex);
+										sendto(socketFd,&msg2,sizeof(BarrierMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+										}
+										}
+									else
+										{
+										pipeState->slaveBarrierIds[msgNodeIndex-1]=msg->barrierId;
+										
+										/* Check if the current barrier is complete: */
+										pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
+										for(unsigned int i=1;i<numSlaves;++i)
+											if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
+												pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
+										if(pipeState->minSlaveBarrierId>pipeState->barrierId)
+											{
+											/* Wake up thread waiting on barrier: */
+											pipeState->barrierCond.signal();
+											}
+										}
+									}
+								else
+									{
+									/* One slave must have missed the completion message for a pipe-closing barrier; send another one: */
 									BarrierMessage msg2(0,Message::BARRIER,msg->pipeId,msg->barrierId);
 									{
 									// SocketMutex::Lock socketLock(socketMutex);
 									sendto(socketFd,&msg2,sizeof(BarrierMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
 									}
 									}
-								else
-									{
-									pipeState->slaveBarrierIds[msgNodeIndex-1]=msg->barrierId;
-									
-									/* Check if the current barrier is complete: */
-									pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
-									for(unsigned int i=1;i<numSlaves;++i)
-										if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
-											pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
-									if(pipeState->minSlaveBarrierId>pipeState->barrierId)
-										{
-										/* Wake up thread waiting on barrier: */
-										pipeState->barrierCond.signal();
-										}
-									}
 								}
+							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								{
-								/* One slave must have missed the completion message for a pipe-closing barrier; send another one: */
-								BarrierMessage msg2(0,Message::BARRIER,msg->pipeId,msg->barrierId);
-								{
-								// SocketMutex::Lock socketLock(socketMutex);
-								sendto(socketFd,&msg2,sizeof(BarrierMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-								}
-								}
+								std::cerr<<"Node "<<nodeIndex<<": received BARRIER message of wrong size "<<numBytesReceived<<std::endl;
+							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received BARRIER message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::GATHER:
-						{
-						if(numBytesReceived==sizeof(GatherMessage))
+						
+						case Message::GATHER:
 							{
-							GatherMessage* msg=static_cast<GatherMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							if(numBytesReceived==sizeof(GatherMessage))
 								{
-								/* Update the barrier ID array: */
-								if(pipeState->barrierId>=msg->barrierId)
-									{
-									/* One slave must have missed a gather completion message; send another one: */
-									GatherMessage msg2(0,Message::GATHER,msg->pipeId,msg->barrierId,pipeState->masterGatherValue);
-									{
-									// SocketMutex::Lock socketLock(socketMutex);
-									sendto(socketFd,&msg2,sizeof(GatherMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-									}
-									}
-								else
+								GatherMessage* msg=static_cast<GatherMessage*>(messageBuffer);
+								
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
+								
+								if(pipeState.isValid())
 									{
-									pipeState->slaveBarrierIds[msgNodeIndex-1]=msg->barrierId;
-									pipeState->slaveGatherValues[msgNodeIndex-1]=msg->value;
-									
-									/* Check if the current gather operation is complete: */
-									pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
-									for(unsigned int i=1;i<numSlaves;++i)
-										if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
-											pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
-									if(pipeState->minSlaveBarrierId>pipeState->barrierId)
+									/* Update the barrier ID array: */
+									if(pipeState->barrierId>=msg->barrierId)
 										{
-										/* Wake up thread waiting on barrier: */
-										pipeState->barrierCond.signal();
+										/* One slave must have missed a gather completion message; send another one: */
+										GatherMessage msg2(0,Message::GATHER,msg->pipeId,msg->barrierId,pipeState->masterGatherValue);
+										{
+										// SocketMutex::Lock socketLock(socketMutex);
+										sendto(socketFd,&msg2,sizeof(GatherMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+										}
+										}
+									else
+										{
+										pipeState->slaveBarrierIds[msgNodeIndex-1]=msg->barrierId;
+										pipeState->slaveGatherValues[msgNodeIndex-1]=msg->value;
+										
+										/* Check if the current gather operation is complete: */
+										pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
+										for(unsigned int i=1;i<numSlaves;++i)
+											if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
+												pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
+										if(pipeState->minSlaveBarrierId>pipeState->barrierId)
+											{
+											/* Wake up thread waiting on barrier: */
+											pipeState->barrierCond.signal();
+											}
 										}
 									}
+								#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+								else
+									std::cerr<<"Node "<<nodeIndex<<": received GATHER message for non-existent pipe "<<msg->pipeId<<std::endl;
+								#endif
 								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received GATHER message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received GATHER message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received GATHER message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
 						}
 					}
 				}
+			#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+			else
+				std::cerr<<"Node "<<nodeIndex<<": received short message of size "<<numBytesReceived<<std::endl;
+			#endif
 			}
-		#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-		else
-			std::cerr<<"Node "<<nodeIndex<<": received short message of size "<<numBytesReceived<<std::endl;
-		#endif
 		}
 	
 	return 0;
@@ -833,216 +1182,228 @@ void* Multiplexer::packetHandlingThreadSlave(void)
 			Misc::throwStdErr("Cluster::Multiplexer: Node %u: Communication error",nodeIndex);
 			}
 		
-		/* Read the waiting packet: */
-		ssize_t numBytesReceived=recv(socketFd,&slaveThreadPacket->pipeId,Packet::maxRawPacketSize,0);
-		if(numBytesReceived<0)
-			{
-			/* Try to recover from this error: */
-			#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-			std::cerr<<"Node "<<nodeIndex<<": Error "<<errno<<" on receive, slaveThreadPacket="<<slaveThreadPacket<<std::endl;
-			#endif
-			delete slaveThreadPacket;
-			slaveThreadPacket=newPacket();
-			}
-		else if(size_t(numBytesReceived)>=2*sizeof(unsigned int))
+		/* Read the waiting packet and any others that arrived at the same time: */
+		void* packetBuffers[ioBatchSize];
+		for(unsigned int i=0;i<ioBatchSize;++i)
+			packetBuffers[i]=&slaveThreadPackets[i]->pipeId;
+		ssize_t packetSizes[ioBatchSize];
+		unsigned int numPackets=receiveBatch(packetBuffers,packetSizes);
+		for(unsigned int packetIndex=0;packetIndex<numPackets;++packetIndex)
 			{
-			slaveThreadPacket->packetSize=size_t(numBytesReceived-2*sizeof(unsigned int));
-			
-			if(slaveThreadPacket->pipeId==0)
+			Packet*& slaveThreadPacket=slaveThreadPackets[packetIndex];
+			ssize_t numBytesReceived=packetSizes[packetIndex];
+			if(numBytesReceived<0)
 				{
-				/* It's a message for the pipe multiplexer itself: */
-				void* messageBuffer=&slaveThreadPacket->pipeId;
-				switch(static_cast<Message*>(messageBuffer)->messageId)
+				/* Try to recover from this error: */
+				#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+				std::cerr<<"Node "<<nodeIndex<<": Error "<<errno<<" on receive, slaveThreadPacket="<<slaveThreadPacket<<std::endl;
+				#endif
+				delete slaveThreadPacket;
+				slaveThreadPacket=newPacket();
+				}
+			else if(size_t(numBytesReceived)>=2*sizeof(unsigned int))
+				{
+				slaveThreadPacket->packetSize=size_t(numBytesReceived-2*sizeof(unsigned int));
+				
+				/* Drop stream and parity packets to simulate an unreliable network: */
+				if(slaveThreadPacket->pipeId!=0&&simulatedPacketLossRate>0.0)
 					{
-					case Message::CONNECTION:
-						/* Signal connection establishment: */
+					packetLossRandomState^=packetLossRandomState<<13;
+					packetLossRandomState^=packetLossRandomState>>17;
+					packetLossRandomState^=packetLossRandomState<<5;
+					if(double(packetLossRandomState)<simulatedPacketLossRate*4294967296.0)
+						continue;
+					}
+				
+				if(slaveThreadPacket->pipeId==0)
+					{
+					/* It's a message for the pipe multiplexer itself: */
+					void* messageBuffer=&slaveThreadPacket->pipeId;
+					switch(static_cast<Message*>(messageBuffer)->messageId)
 						{
-						Threads::MutexCond::Lock connectionCondLock(connectionCond);
-						if(!connected)
+						case Message::CONNECTION:
+							/* Signal connection establishment: */
 							{
-							connected=true;
-							connectionCond.broadcast();
+							Threads::MutexCond::Lock connectionCondLock(connectionCond);
+							if(!connected)
+								{
+								connected=true;
+								connectionCond.broadcast();
+								}
 							}
-						}
-						break;
-					
-					case Message::PING:
-						/* Just ignore the packet... */
-						break;
-					
-					case Message::CREATEPIPE1:
-						{
-						CreatePipe1Message* msg=static_cast<CreatePipe1Message*>(messageBuffer);
-						if(size_t(numBytesReceived)>=sizeof(CreatePipe1Message)&&size_t(numBytesReceived)==sizeof(CreatePipe1Message)+msg->idNumParts*sizeof(unsigned int))
-							{
+							break;
+						
+						case Message::PING:
+							/* Just ignore the packet... */
+							break;
+						
+						case Message::CREATEPIPE1:
 							{
-							Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
-							
-							/* Check if the pipe is not yet in the pipe state table: */
-							if(!pipeStateTable.isEntry(msg->pipeId))
+							CreatePipe1Message* msg=static_cast<CreatePipe1Message*>(messageBuffer);
+							if(size_t(numBytesReceived)>=sizeof(CreatePipe1Message)&&size_t(numBytesReceived)==sizeof(CreatePipe1Message)+msg->idNumParts*sizeof(unsigned int))
 								{
-								/* Extract the originating thread's ID from the message: */
-								Threads::Thread::ID senderId(msg->idNumParts,reinterpret_cast<unsigned int*>(msg+1));
-								
-								/* Find the new pipe state corresponding to the thread ID: */
-								NewPipeHasher::Iterator npIt=newPipes.findEntry(senderId);
-								PipeState* newPipeState=npIt->getDest();
+								{
+								Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
 								
-								/* Remove the new pipe state from the new pipe map and insert it into the pipe state table: */
-								newPipes.removeEntry(npIt);
-								pipeStateTable[msg->pipeId]=newPipeState;
+								/* Check if the pipe is not yet in the pipe state table: */
+								if(!pipeStateTable.isEntry(msg->pipeId))
+									{
+									/* Extract the originating thread's ID from the message: */
+									Threads::Thread::ID senderId(msg->idNumParts,reinterpret_cast<unsigned int*>(msg+1));
+									
+									/* Find the new pipe state corresponding to the thread ID: */
+									NewPipeHasher::Iterator npIt=newPipes.findEntry(senderId);
+									PipeState* newPipeState=npIt->getDest();
+									
+									/* Remove the new pipe state from the new pipe map and insert it into the pipe state table: */
+									newPipes.removeEntry(npIt);
+									pipeStateTable[msg->pipeId]=newPipeState;
+									
+									/* Signal pipe creation completion: */
+									{
+									Threads::Mutex::Lock pipeStateLock(newPipeState->stateMutex);
+									newPipeState->pipeId=msg->pipeId;
+									newPipeState->barrierId=2;
+									newPipeState->barrierCond.signal();
+									}
+									}
+								}
 								
-								/* Signal pipe creation completion: */
+								/* Send a stage-two pipe creation message to the master: */
+								PipeMessage msg2(sendNodeIndex,Message::CREATEPIPE2,msg->pipeId);
 								{
-								Threads::Mutex::Lock pipeStateLock(newPipeState->stateMutex);
-								newPipeState->pipeId=msg->pipeId;
-								newPipeState->barrierId=2;
-								newPipeState->barrierCond.signal();
+								// SocketMutex::Lock socketLock(socketMutex);
+								for(int i=0;i<slaveMessageBurstSize;++i)
+									sendto(socketFd,&msg2,sizeof(PipeMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
 								}
 								}
+							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+							else
+								std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE1 message of wrong size "<<numBytesReceived<<std::endl;
+							#endif
+							break;
 							}
-							
-							/* Send a stage-two pipe creation message to the master: */
-							PipeMessage msg2(sendNodeIndex,Message::CREATEPIPE2,msg->pipeId);
-							{
-							// SocketMutex::Lock socketLock(socketMutex);
-							for(int i=0;i<slaveMessageBurstSize;++i)
-								sendto(socketFd,&msg2,sizeof(PipeMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
-							}
-							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE1 message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::BARRIER:
-						{
-						if(numBytesReceived==sizeof(BarrierMessage))
+						
+						case Message::BARRIER:
 							{
-							BarrierMessage* msg=static_cast<BarrierMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							if(numBytesReceived==sizeof(BarrierMessage))
 								{
-								/* Signal barrier completion if the completion message is for the current barrier: */
-								if(pipeState->barrierId<msg->barrierId)
+								BarrierMessage* msg=static_cast<BarrierMessage*>(messageBuffer);
+								
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
+								
+								if(pipeState.isValid())
 									{
-									pipeState->barrierId=msg->barrierId;
-									pipeState->barrierCond.signal();
+									/* Signal barrier completion if the completion message is for the current barrier: */
+									if(pipeState->barrierId<msg->barrierId)
+										{
+										pipeState->barrierId=msg->barrierId;
+										resetFec(*pipeState);
+										pipeState->barrierCond.signal();
+										}
 									}
+								#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+								else
+									std::cerr<<"Node "<<nodeIndex<<": received BARRIER message for non-existent pipe "<<msg->pipeId<<std::endl;
+								#endif
 								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received BARRIER message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received BARRIER message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received BARRIER message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::GATHER:
-						{
-						if(numBytesReceived==sizeof(GatherMessage))
+						
+						case Message::GATHER:
 							{
-							GatherMessage* msg=static_cast<GatherMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							if(numBytesReceived==sizeof(GatherMessage))
 								{
-								/* Signal barrier completion if the completion message is for the current barrier: */
-								if(pipeState->barrierId<msg->barrierId)
+								GatherMessage* msg=static_cast<GatherMessage*>(messageBuffer);
+								
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
+								
+								if(pipeState.isValid())
 									{
-									pipeState->barrierId=msg->barrierId;
-									pipeState->masterGatherValue=msg->value;
-									pipeState->barrierCond.signal();
+									/* Signal barrier completion if the completion message is for the current barrier: */
+									if(pipeState->barrierId<msg->barrierId)
+										{
+										pipeState->barrierId=msg->barrierId;
+										pipeState->masterGatherValue=msg->value;
+										resetFec(*pipeState);
+										pipeState->barrierCond.signal();
+										}
 									}
+								#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+								else
+									std::cerr<<"Node "<<nodeIndex<<": received GATHER message for non-existent pipe "<<msg->pipeId<<std::endl;
+								#endif
 								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received GATHER message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received GATHER message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received GATHER message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
 						}
 					}
-				}
-			else
-				{
-				/* Get a handle on the state object of the pipe the packet is meant for: */
-				LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,slaveThreadPacket->pipeId);
-				
-				if(pipeState.isValid())
+				else if(slaveThreadPacket->pipeId&parityPipeIdFlag)
 					{
-					/* Check if the received packet is the next expected one: */
-					if(pipeState->streamPos==slaveThreadPacket->streamPos)
+					/* Get a handle on the state object of the pipe the parity packet is meant for: */
+					LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,slaveThreadPacket->pipeId&~parityPipeIdFlag);
+					
+					if(pipeState.isValid())
 						{
-						/* Disable packet loss mode: */
-						pipeState->packetLossMode=false;
-						
-						++sendAckIn;
-						if(sendAckIn==numSlaves)
-							{
-							/* Send positive acknowledgment to the master: */
-							StreamMessage msg(sendNodeIndex,Message::ACKNOWLEDGMENT,slaveThreadPacket->pipeId,pipeState->streamPos,slaveThreadPacket->streamPos);
-							{
-							// SocketMutex::Lock socketLock(socketMutex);
-							sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
-							}
-							sendAckIn=0;
-							}
-						
-						/* Wake up sleeping receivers if the delivery queue is currently empty: */
-						if(pipeState->packetList.empty())
-							pipeState->receiveCond.signal();
-						
-						/* Append the packet to the pipe state's delivery queue: */
-						pipeState->streamPos+=slaveThreadPacket->packetSize;
-						pipeState->packetList.push_back(slaveThreadPacket);
-						
-						/* Get a new packet: */
-						slaveThreadPacket=newPacket();
+						/* Process the parity packet: */
+						receiveParityPacket(pipeState,slaveThreadPacket,sendAckIn);
 						}
+					#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 					else
+						std::cerr<<"Node "<<nodeIndex<<": received parity packet for non-existent pipe "<<(slaveThreadPacket->pipeId&~parityPipeIdFlag)<<std::endl;
+					#endif
+					}
+				else
+					{
+					/* Get a handle on the state object of the pipe the packet is meant for: */
+					LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,slaveThreadPacket->pipeId);
+					
+					if(pipeState.isValid())
 						{
-						/* Check if there is data missing between the packet's stream position and the pipe's stream position; watch for stream position wrap-around: */
-						if(!pipeState->packetLossMode&&slaveThreadPacket->streamPos-pipeState->streamPos<=0x80000000U)
+						if(pipeState->fecGroupSize!=0)
 							{
-							/* At least one packet must have been lost; send negative acknowledgment to the master: */
-							StreamMessage msg(sendNodeIndex,Message::PACKETLOSS,slaveThreadPacket->pipeId,pipeState->streamPos,slaveThreadPacket->streamPos);
+							/* Let forward error correction handle the packet: */
+							receiveFecPacket(pipeState,slaveThreadPacket,sendAckIn);
+							}
+						else if(pipeState->streamPos==slaveThreadPacket->streamPos)
 							{
-							// SocketMutex::Lock socketLock(socketMutex);
-							for(int i=0;i<slaveMessageBurstSize;++i)
-								sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
+							/* Deliver the next expected packet and get a new packet: */
+							deliverPacket(pipeState,slaveThreadPacket,sendAckIn);
+							slaveThreadPacket=newPacket();
 							}
-
-							/* Enable packet loss mode to prohibit sending further loss messages until the missing packet arrives: */
-							pipeState->packetLossMode=true;
+						else
+							{
+							++pipeState->statistics.numDiscardedPackets;
+							
+							/* Check if there is data missing between the packet's stream position and the pipe's stream position; watch for stream position wrap-around: */
+							if(slaveThreadPacket->streamPos-pipeState->streamPos<=0x80000000U)
+								{
+								/* At least one packet must have been lost; send negative acknowledgment to the master: */
+								requestResend(pipeState,slaveThreadPacket->streamPos);
+								}
 							}
 						}
+					#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+					else
+						std::cerr<<"Node "<<nodeIndex<<": received stream packet for non-existent pipe "<<slaveThreadPacket->pipeId<<std::endl;
+					#endif
 					}
-				#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-				else
-					std::cerr<<"Node "<<nodeIndex<<": received stream packet for non-existent pipe "<<slaveThreadPacket->pipeId<<std::endl;
-				#endif
 				}
+			#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+			else
+				std::cerr<<"Node "<<nodeIndex<<": received short message of size "<<numBytesReceived<<std::endl;
+			#endif
 			}
-		#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-		else
-			std::cerr<<"Node "<<nodeIndex<<": received short message of size "<<numBytesReceived<<std::endl;
-		#endif
 		}
 	
 	return 0;
@@ -1057,16 +1418,19 @@ Multiplexer::Multiplexer(unsigned int sNumSlaves,unsigned int sNodeIndex,std::st
 	 newPipes(17),
 	 lastPipeId(0),
 	 pipeStateTable(17),
-	 messageBuffer(0),
-	 slaveThreadPacket(0),
+	 messageBuffers(0),
 	 masterMessageBurstSize(1),slaveMessageBurstSize(1),
 	 connectionWaitTimeout(0.5),
 	 pingTimeout(10.0),maxPingRequests(3),
 	 receiveWaitTimeout(0.25),
 	 barrierWaitTimeout(0.1),
 	 sendBufferSize(20),
-	 packetPoolHead(0)
+	 packetPoolHead(0),
+	 simulatedPacketLossRate(0.0),packetLossRandomState(0x9e3779b9U^sNodeIndex)
 	{
+	for(unsigned int i=0;i<ioBatchSize;++i)
+		slaveThreadPackets[i]=0;
+	
 	/* Lookup master's IP address: */
 	struct hostent* masterEntry=gethostbyname(masterHostName.c_str());
 	if(masterEntry==0)
@@ -1098,6 +1462,13 @@ Multiplexer::Multiplexer(unsigned int sNumSlaves,unsigned int sNodeIndex,std::st
 	if(socketFd<0)
 		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Unable to create socket",nodeIndex);
 	
+	if(nodeIndex!=0&&isMulticast(slaveNetAddress))
+		{
+		/* Allow several slaves on the same host to join the slave multicast group: */
+		int reuseFlag=1;
+		setsockopt(socketFd,SOL_SOCKET,SO_REUSEADDR,&reuseFlag,sizeof(int));
+		}
+	
 	/* Bind the socket to the local address/port number: */
 	int localPortNumber=nodeIndex==0?masterPortNumber:slavePortNumber;
 	struct sockaddr_in socketAddress;
@@ -1165,12 +1536,14 @@ Multiplexer::Multiplexer(unsigned int sNumSlaves,unsigned int sNodeIndex,std::st
 	/* Create the packet handling thread: */
 	if(nodeIndex==0)
 		{
-		messageBuffer=new unsigned char[Packet::maxRawPacketSize];
+		messageBuffers=new unsigned char[ioBatchSize*Packet::maxRawPacketSize];
 		packetHandlingThread.start(this,&Multiplexer::packetHandlingThreadMaster);
 		}
 	else
 		{
-		slaveThreadPacket=newPacket();
+		adjustReceiveBufferSize();
+		for(unsigned int i=0;i<ioBatchSize;++i)
+			slaveThreadPackets[i]=newPacket();
 		packetHandlingThread.start(this,&Multiplexer::packetHandlingThreadSlave);
 		}
 	}
@@ -1181,9 +1554,10 @@ Multiplexer::~Multiplexer(void)
 	packetHandlingThread.cancel();
 	packetHandlingThread.join();
 	
-	/* Delete the packet handling thread's receive packet: */
-	delete slaveThreadPacket;
-	delete[] static_cast<unsigned char*>(messageBuffer);
+	/* Delete the packet handling thread's receive packets: */
+	for(unsigned int i=0;i<ioBatchSize;++i)
+		delete slaveThreadPackets[i];
+	delete[] static_cast<unsigned char*>(messageBuffers);
 	
 	/* Close all leftover pipes: */
 	for(PipeHasher::Iterator psIt=pipeStateTable.begin();psIt!=pipeStateTable.end();++psIt)
@@ -1246,6 +1620,15 @@ void Multiplexer::setBarrierWaitTimeout(Misc::Time newBarrierWaitTimeout)
 void Multiplexer::setSendBufferSize(unsigned int newSendBufferSize)
 	{
 	sendBufferSize=newSendBufferSize;
+	
+	/* Make room for the new send queue size on slave nodes: */
+	if(nodeIndex!=0)
+		adjustReceiveBufferSize();
+	}
+
+void Multiplexer::setSimulatedPacketLoss(double newSimulatedPacketLossRate)
+	{
+	simulatedPacketLossRate=newSimulatedPacketLossRate;
 	}
 
 void Multiplexer::waitForConnection(void)
@@ -1407,7 +1790,7 @@ void Multiplexer::closePipe(unsigned int pipeId)
 	if(nodeIndex==0)
 		{
 		std::cerr<<"Closing pipe "<<pipeId;
-		std::cerr<<". Re-sent "<<pipeState->numResentPackets<<" packets, "<<pipeState->numResentBytes<<" bytes"<<std::endl;
+		std::cerr<<". Re-sent "<<pipeState->statistics.numResentPackets<<" packets, "<<pipeState->statistics.numResentBytes<<" bytes"<<std::endl;
 		}
 	#endif
 	
@@ -1431,12 +1814,51 @@ void Multiplexer::closePipe(unsigned int pipeId)
 	delete pipeState;
 	}
 
+void Multiplexer::setFecGroupSize(unsigned int pipeId,unsigned int newFecGroupSize)
+	{
+	{
+	/* Get a handle on the state object for the given pipe: */
+	LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,pipeId);
+	if(!pipeState.isValid())
+		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to configure closed pipe",nodeIndex);
+	
+	/* Close the master's current packet group and set the new group size: */
+	Packet* parity=closeFecGroup(*pipeState);
+	if(parity!=0)
+		{
+		sendPacketList(parity);
+		deletePacket(parity);
+		}
+	pipeState->fecGroupSize=newFecGroupSize;
+	if(newFecGroupSize!=0&&pipeState->fecParity==0)
+		pipeState->fecParity=newPacket();
+	
+	/* Ignore parity packets on slaves until the next barrier aligns the packet groups: */
+	pipeState->fecSynchronized=false;
+	}
+	
+	/* Synchronize all nodes so that they start packet groups at the same stream position: */
+	barrier(pipeId);
+	}
+
+Multiplexer::PipeStatistics Multiplexer::getPipeStatistics(unsigned int pipeId)
+	{
+	/* Get a handle on the state object for the given pipe: */
+	LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,pipeId);
+	if(!pipeState.isValid())
+		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to query closed pipe",nodeIndex);
+	
+	return pipeState->statistics;
+	}
+
 void Multiplexer::sendPacket(unsigned int pipeId,Packet* packet)
 	{
 	/* Get a handle on the state object for the given pipe: */
 	LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,pipeId);
 	if(!pipeState.isValid())
 		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to write to closed pipe",nodeIndex);
+	if(pipeState->fecGroupSize!=0&&packet->packetSize>getMaxFecPacketSize())
+		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Packet too large for pipe using forward error correction",nodeIndex);
 	
 	/* Block if the pipe's send queue is full: */
 	#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER_VERBOSE
@@ -1457,6 +1879,20 @@ void Multiplexer::sendPacket(unsigned int pipeId,Packet* packet)
 	packet->streamPos=pipeState->streamPos;
 	pipeState->streamPos+=packet->packetSize;
 	pipeState->packetList.push_back(packet);
+	++pipeState->statistics.numSentPackets;
+	pipeState->statistics.numSentBytes+=packet->packetSize;
+	
+	/* Fold the packet into the current packet group's parity: */
+	Packet* parity=0;
+	if(pipeState->fecGroupSize!=0)
+		{
+		accumulateParity(pipeState->fecParity,packet,fecHeaderSize);
+		++pipeState->fecNumPackets;
+		
+		/* Close the group if it is full, or if a short packet indicates that the writer flushed the pipe: */
+		if(pipeState->fecNumPackets==pipeState->fecGroupSize||packet->packetSize<getMaxFecPacketSize())
+			parity=closeFecGroup(*pipeState);
+		}
 	
 	/* It's safe to unlock the pipe state now: */
 	pipeState.unlock();
@@ -1466,6 +1902,13 @@ void Multiplexer::sendPacket(unsigned int pipeId,Packet* packet)
 	// SocketMutex::Lock socketLock(socketMutex);
 	sendto(socketFd,&packet->pipeId,packet->packetSize+2*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
 	}
+	
+	if(parity!=0)
+		{
+		/* Send the closed group's parity packet: */
+		sendPacketList(parity);
+		deletePacket(parity);
+		}
 	}
 
 Packet* Multiplexer::receivePacket(unsigned int pipeId)
@@ -1494,6 +1937,7 @@ Packet* Multiplexer::receivePacket(unsigned int pipeId)
 			for(int i=0;i<slaveMessageBurstSize;++i)
 				sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
 			}
+			++pipeState->statistics.numPacketLossMessages;
 			}
 		}
 	
@@ -1507,12 +1951,20 @@ void Multiplexer::barrier(unsigned int pipeId)
 	LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,pipeId);
 	if(!pipeState.isValid())
 		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to synchronize closed pipe",nodeIndex);
-		
+	
 	/* Bump up barrier ID: */
 	unsigned int nextBarrierId=pipeState->barrierId+1;
 	
 	if(nodeIndex==0)
 		{
+		/* Send the parity packet of any partially filled packet group: */
+		Packet* parity=closeFecGroup(*pipeState);
+		if(parity!=0)
+			{
+			sendPacketList(parity);
+			deletePacket(parity);
+			}
+		
 		/* Wait until barrier messages from all slaves have been received: */
 		while(pipeState->minSlaveBarrierId<nextBarrierId)
 			{
@@ -1535,6 +1987,7 @@ void Multiplexer::barrier(unsigned int pipeId)
 		for(unsigned int i=0;i<numSlaves;++i)
 			pipeState->slaveStreamPosOffsets[i]=0;
 		pipeState->numHeadSlaves=numSlaves;
+		resetFec(*pipeState);
 		
 		/* Add all packets in the list to the list of free packets: */
 		if(pipeState->packetList.numPackets>0)
@@ -1581,6 +2034,14 @@ unsigned int Multiplexer::gather(unsigned int pipeId,unsigned int value,GatherOp
 	
 	if(nodeIndex==0)
 		{
+		/* Send the parity packet of any partially filled packet group: */
+		Packet* parity=closeFecGroup(*pipeState);
+		if(parity!=0)
+			{
+			sendPacketList(parity);
+			deletePacket(parity);
+			}
+		
 		/* Wait until gather messages from all slaves have been received: */
 		while(pipeState->minSlaveBarrierId<nextBarrierId)
 			{
@@ -1640,6 +2101,7 @@ unsigned int Multiplexer::gather(unsigned int pipeId,unsigned int value,GatherOp
 		for(unsigned int i=0;i<numSlaves;++i)
 			pipeState->slaveStreamPosOffsets[i]=0;
 		pipeState->numHeadSlaves=numSlaves;
+		resetFec(*pipeState);
 		
 		/* Add all packets in the list to the list of free packets: */
 		if(pipeState->packetList.numPackets>0)
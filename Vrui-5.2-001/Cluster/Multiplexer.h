@@ -1,7 +1,7 @@
 /***********************************************************************
 Multiplexer - Class to share several intra-cluster multicast pipes
 across a single UDP socket connection.
-Copyright (c) 2005-2012 Oliver Kreylos
+Copyright (c) 2005-2020 Oliver Kreylos
 
 This file is part of the Cluster Abstraction Library (Cluster).
 
@@ -23,6 +23,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #ifndef CLUSTER_MULTIPLEXER_INCLUDED
 #define CLUSTER_MULTIPLEXER_INCLUDED
 
+#include <stddef.h>
+#include <sys/types.h>
 #include <string>
 #include <Misc/HashTable.h>
 #include <Misc/Time.h>
@@ -43,6 +45,35 @@ namespace Cluster {
 class Multiplexer
 	{
 	/* Embedded classes: */
+	public:
+	struct PipeStatistics // Structure reporting traffic on a pipe since it was opened
+		{
+		/* Elements: */
+		public:
+		Misc::Time openTime; // Time at which the pipe state was created; used to calculate throughput
+		size_t numSentPackets; // Number of packets sent by the master
+		size_t numSentBytes; // Number of payload bytes sent by the master
+		size_t numResentPackets; // Number of packets re-sent by the master in response to packet loss messages
+		size_t numResentBytes; // Number of payload bytes re-sent by the master in response to packet loss messages
+		size_t numReceivedPackets; // Number of in-order packets received by a slave
+		size_t numReceivedBytes; // Number of in-order payload bytes received by a slave
+		size_t numDiscardedPackets; // Number of duplicate or out-of-order packets discarded by a slave
+		size_t numPacketLossMessages; // Number of packet loss messages sent by a slave or received by the master
+		size_t numParityPackets; // Number of forward error correction parity packets sent by the master or received by a slave
+		size_t numRecoveredPackets; // Number of lost packets reconstructed by a slave from parity packets
+		
+		/* Constructors and destructors: */
+		PipeStatistics(void)
+			:openTime(Misc::Time::now()),
+			 numSentPackets(0),numSentBytes(0),
+			 numResentPackets(0),numResentBytes(0),
+			 numReceivedPackets(0),numReceivedBytes(0),
+			 numDiscardedPackets(0),numPacketLossMessages(0),
+			 numParityPackets(0),numRecoveredPackets(0)
+			{
+			}
+		};
+	
 	private:
 	struct PipeState // Structure storing the current state of a pipe
 		{
@@ -98,10 +129,13 @@ class Multiplexer
 		unsigned int minSlaveBarrierId; // Smallest barrier ID currently in the state array
 		unsigned int* slaveGatherValues; // Array of most recently received gather values from the slaves
 		unsigned int masterGatherValue; // Final value of last completed gather operation in pipe
-		#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-		size_t numResentPackets;
-		size_t numResentBytes;
-		#endif
+		unsigned int fecGroupSize; // Maximum number of packets protected by a single parity packet; 0 disables forward error correction
+		bool fecSynchronized; // Flag whether a slave's parity accumulator is aligned with the master's packet groups
+		unsigned int fecGroupStart; // Stream position of the first packet in the current packet group
+		unsigned int fecNumPackets; // Number of packets folded into the current packet group's parity
+		Packet* fecParity; // Running parity of the current packet group, or NULL if forward error correction was never enabled
+		PacketList pendingPackets; // List of packets received by a slave ahead of the current stream position, sorted by stream position
+		PipeStatistics statistics; // Traffic counters for this pipe
 		
 		/* Constructors and destructors: */
 		PipeState(unsigned int nodeIndex,unsigned int numSlaves); // Creates empty pipe state
@@ -177,6 +211,8 @@ class Multiplexer
 	
 	/* Elements: */
 	private:
+	static const unsigned int ioBatchSize=CLUSTER_CONFIG_HAVE_MMSG?16:1; // Maximum number of UDP packets sent or received in a single system call
+	static const size_t fecHeaderSize=2*sizeof(unsigned int); // Size of the header preceding the parity data in a parity packet
 	unsigned int numSlaves; // Number of slaves in the multicast group
 	unsigned int nodeIndex; // Index of this node; master node == 0
 	struct sockaddr_in* masterAddress; // Pointer to socket address of master
@@ -189,9 +225,9 @@ class Multiplexer
 	NewPipeHasher newPipes; // Hash table to map from thread IDs to pipe states not completely opened yet
 	unsigned int lastPipeId; // ID of the most-recently created pipe
 	PipeHasher pipeStateTable; // Hash table to map from pipe IDs to pipe state table entries
-	void* messageBuffer; // A buffer to receive message packets on the master node
+	void* messageBuffers; // A buffer to receive a batch of message packets on the master node
 	Threads::Thread packetHandlingThread; // Packet handling thread
-	Packet* slaveThreadPacket; // Pointer to the one packet always held by the packet handling thread on slave nodes
+	Packet* slaveThreadPackets[ioBatchSize]; // Array of packets always held by the packet handling thread on slave nodes to receive a batch of packets
 	int masterMessageBurstSize; // Number of server messages sent in a single burst
 	int slaveMessageBurstSize; // Number of client messages sent in a single burst
 	Misc::Time connectionWaitTimeout; // Timeout between connection messages from the slaves
@@ -202,9 +238,21 @@ class Multiplexer
 	unsigned int sendBufferSize; // Maximum number of packets buffered for each pipe
 	Threads::Spinlock packetPoolMutex; // Mutex protecting the free packet pool
 	Packet* packetPoolHead; // Pool of recently deleted packets to minimize number of new/delete calls
+	double simulatedPacketLossRate; // Probability with which a slave drops a received stream or parity packet to simulate an unreliable network
+	unsigned int packetLossRandomState; // State of the random number generator used to simulate packet loss
 	
 	/* Private methods: */
 	Packet* allocatePacket(void);
+	unsigned int receiveBatch(void* const buffers[],ssize_t bufferSizes[]); // Blocks until at least one UDP packet arrives and receives up to ioBatchSize packets into the given buffers of maximum raw packet size; stores received sizes or -1 on error and returns number of sizes stored
+	void adjustReceiveBufferSize(void); // Enlarges the UDP socket's receive buffer to hold the current send queue size on slave nodes
+	void sendPacketList(Packet* packets); // Sends the given packet and all its successors to the slaves
+	void resetFec(PipeState& pipeState); // Starts a new packet group at the pipe's current stream position
+	Packet* closeFecGroup(PipeState& pipeState); // Returns the parity packet of the master's current packet group and starts a new group; returns NULL if there is no open group
+	void requestResend(LockedPipe& pipeState,unsigned int packetPos); // Sends a packet loss message from a slave to the master unless the pipe is already recovering from lost data
+	void deliverPacket(LockedPipe& pipeState,Packet* packet,unsigned int& sendAckIn); // Appends the next expected packet to a slave pipe's delivery queue and acknowledges it if it's the slave's turn
+	void deliverPendingPackets(LockedPipe& pipeState,unsigned int& sendAckIn); // Delivers packets from a slave pipe's pending list that have become the next expected packets
+	void receiveFecPacket(LockedPipe& pipeState,Packet*& packet,unsigned int& sendAckIn); // Handles a stream packet received by a slave on a pipe using forward error correction; replaces the packet if it was kept
+	void receiveParityPacket(LockedPipe& pipeState,const Packet* parity,unsigned int& sendAckIn); // Handles a parity packet received by a slave, reconstructing a single lost packet if possible
 	void processAcknowledgment(LockedPipe& pipeState,int slaveIndex,unsigned int streamPos); // Processes an acknowlegment (positive or implied-positive) from a slave
 	void* packetHandlingThreadMaster(void); // Packet handling thread method for the master
 	void* packetHandlingThreadSlave(void); // Packet handling thread method for the slaves
@@ -256,11 +304,22 @@ class Multiplexer
 	void setReceiveWaitTimeout(Misc::Time newReceiveWaitTimeout); // Sets the timeout when waiting for data packages
 	void setBarrierWaitTimeout(Misc::Time newBarrierWaitTimeout); // Sets the timeout when waiting for barrier messages
 	void setSendBufferSize(unsigned int newSendBufferSize); // Sets the maximum number of packets held in each pipe's send queue
+	static size_t getMaxPacketSize(void) // Returns the maximum payload size of a multicast packet, as configured by the cluster MTU size
+		{
+		return Packet::maxPacketSize;
+		}
+	static size_t getMaxFecPacketSize(void) // Returns the maximum payload size of a multicast packet on a pipe using forward error correction
+		{
+		return Packet::maxPacketSize-fecHeaderSize;
+		}
+	void setSimulatedPacketLoss(double newSimulatedPacketLossRate); // Makes a slave drop the given fraction of received stream and parity packets, to test recovery from packet loss
 	void waitForConnection(void); // Waits until all slaves have connected to the master
 	
 	/* Pipe management interface: */
 	unsigned int openPipe(void); // Creates a new multicast pipe and returns its pipe ID
 	void closePipe(unsigned int pipeId); // Destroys the multicast pipe of the given ID
+	void setFecGroupSize(unsigned int pipeId,unsigned int newFecGroupSize); // Protects every group of up to the given number of packets sent on the given pipe with a parity packet from which slaves can reconstruct one lost packet; 0 disables forward error correction; must be called on all nodes; implies a barrier
+	PipeStatistics getPipeStatistics(unsigned int pipeId); // Returns the traffic counters of the multicast pipe of the given ID
 	
 	/* Pipe communication interface: */
 	void sendPacket(unsigned int pipeId,Packet* packet); // Sends a packet from the master to the slaves
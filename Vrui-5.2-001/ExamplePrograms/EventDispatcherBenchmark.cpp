@@ -0,0 +1,260 @@
+/***********************************************************************
+EventDispatcherBenchmark - Utility to measure the per-event overhead of
+Threads::EventDispatcher with a few busy and many idle file descriptors,
+and to check its handling of unpollable files, hang-ups, and timers.
+Copyright (c) 2020 Oliver Kreylos
+
+This program is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <iostream>
+#include <vector>
+#include <Misc/Timer.h>
+#include <Threads/Thread.h>
+#include <Threads/EventDispatcher.h>
+
+typedef Threads::EventDispatcher EventDispatcher;
+
+/****************
+Global variables:
+****************/
+
+EventDispatcher dispatcher; // The dispatcher under test
+volatile unsigned int numIterations=0; // Number of dispatcher loop iterations
+volatile unsigned int numIdleEvents=0; // Number of events signaled on idle file descriptors
+volatile unsigned int numFileEvents=0; // Number of events signaled on a regular file
+volatile unsigned int numHangupEvents=0; // Number of events signaled on a hung-up socket
+volatile unsigned int numTimerEvents=0; // Number of timer events
+
+/****************
+Helper functions:
+****************/
+
+double getCpuTime(void) // Returns the process's consumed CPU time in seconds
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&ts);
+	return double(ts.tv_sec)+double(ts.tv_nsec)*1.0e-9;
+	}
+
+bool echoCallback(EventDispatcher::ListenerKey,int,void* userData) // Sends all received data back on the same socket
+	{
+	int fd=*static_cast<int*>(userData);
+	char buffer[256];
+	ssize_t readSize=read(fd,buffer,sizeof(buffer));
+	if(readSize>0&&write(fd,buffer,readSize)!=readSize)
+		return true;
+	return readSize<=0;
+	}
+
+bool idleCallback(EventDispatcher::ListenerKey,int,void*)
+	{
+	++numIdleEvents;
+	return false;
+	}
+
+bool fileCallback(EventDispatcher::ListenerKey,int,void*)
+	{
+	/* Remove the listener after the first event: */
+	++numFileEvents;
+	return true;
+	}
+
+bool hangupCallback(EventDispatcher::ListenerKey,int,void*)
+	{
+	++numHangupEvents;
+	return false;
+	}
+
+bool timerCallback(EventDispatcher::ListenerKey,void*)
+	{
+	++numTimerEvents;
+	return false;
+	}
+
+bool iterationCallback(EventDispatcher::ListenerKey,void*)
+	{
+	++numIterations;
+	return false;
+	}
+
+void* dispatcherThreadMethod(void)
+	{
+	dispatcher.dispatchEvents();
+	return 0;
+	}
+
+void settle(void) // Gives the dispatcher thread time to process pending listener changes
+	{
+	usleep(20000);
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numIdle=1000;
+	unsigned int numBusy=4;
+	unsigned int numRounds=20000;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"idle")==0&&i+1<argc)
+				{
+				++i;
+				numIdle=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"busy")==0&&i+1<argc)
+				{
+				++i;
+				numBusy=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"rounds")==0&&i+1<argc)
+				{
+				++i;
+				numRounds=(unsigned int)(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	
+	/* Start dispatching events: */
+	dispatcher.addProcessListener(iterationCallback,0);
+	Threads::Thread dispatcherThread;
+	dispatcherThread.start(dispatcherThreadMethod);
+	
+	/* Create idle and busy socket pairs, and listen on one side of each: */
+	std::vector<int> sockets;
+	unsigned int numPairs=numIdle+numBusy;
+	sockets.reserve(numPairs*2);
+	for(unsigned int i=0;i<numPairs;++i)
+		{
+		int pair[2];
+		if(socketpair(AF_UNIX,SOCK_STREAM,0,pair)<0)
+			{
+			std::cerr<<"Unable to create socket pair "<<i<<"; try raising the file descriptor limit"<<std::endl;
+			return 1;
+			}
+		sockets.push_back(pair[0]);
+		sockets.push_back(pair[1]);
+		}
+	for(unsigned int i=0;i<numIdle;++i)
+		{
+		dispatcher.addIOEventListener(sockets[i*2+1],EventDispatcher::Read,idleCallback,0);
+		
+		/* Don't overflow the dispatcher's command pipe: */
+		if(i%512==511)
+			settle();
+		}
+	for(unsigned int i=numIdle;i<numPairs;++i)
+		dispatcher.addIOEventListener(sockets[i*2+1],EventDispatcher::Read,echoCallback,&sockets[i*2+1]);
+	settle();
+	
+	/* Send one byte through each busy socket per round and wait for all echoes: */
+	unsigned int iterations0=numIterations;
+	double cpu0=getCpuTime();
+	Misc::Timer timer;
+	for(unsigned int round=0;round<numRounds;++round)
+		{
+		char byte=char(round);
+		for(unsigned int i=numIdle;i<numPairs;++i)
+			if(write(sockets[i*2],&byte,1)!=1)
+				{
+				std::cerr<<"Unable to write to busy socket"<<std::endl;
+				return 1;
+				}
+		for(unsigned int i=numIdle;i<numPairs;++i)
+			if(read(sockets[i*2],&byte,1)!=1)
+				{
+				std::cerr<<"Unable to read from busy socket"<<std::endl;
+				return 1;
+				}
+		}
+	timer.elapse();
+	double cpuTime=getCpuTime()-cpu0;
+	double numEvents=double(numRounds)*double(numBusy);
+	std::cout<<numBusy<<" busy and "<<numIdle<<" idle sockets: "<<timer.getTime()*1.0e6/numEvents<<" us wall time and "<<cpuTime*1.0e6/numEvents<<" us CPU time per echoed event, ";
+	std::cout<<double(numIterations-iterations0)/double(numRounds)<<" dispatcher iterations per round"<<std::endl;
+	
+	unsigned int numFailures=0;
+	if(numIdleEvents!=0)
+		{
+		std::cout<<"FAILED: "<<numIdleEvents<<" events on idle sockets"<<std::endl;
+		++numFailures;
+		}
+	
+	/* Check that regular files, which can't be polled, are signaled as always ready: */
+	FILE* file=tmpfile();
+	dispatcher.addIOEventListener(fileno(file),EventDispatcher::Read,fileCallback,0);
+	settle();
+	std::cout<<"Regular file: "<<numFileEvents<<" events"<<std::endl;
+	if(numFileEvents!=1)
+		{
+		std::cout<<"FAILED: regular file was not signaled exactly once"<<std::endl;
+		++numFailures;
+		}
+	fclose(file);
+	
+	/* Check that a hang-up on a socket whose listener only wants exceptions doesn't make the dispatcher spin: */
+	int pair[2];
+	socketpair(AF_UNIX,SOCK_STREAM,0,pair);
+	dispatcher.addIOEventListener(pair[1],EventDispatcher::Exception,hangupCallback,0);
+	settle();
+	iterations0=numIterations;
+	close(pair[0]);
+	usleep(200000);
+	unsigned int hangupIterations=numIterations-iterations0;
+	std::cout<<"Hang-up on exception-only listener: "<<numHangupEvents<<" events, "<<hangupIterations<<" dispatcher iterations in 200 ms"<<std::endl;
+	if(hangupIterations>10)
+		{
+		std::cout<<"FAILED: dispatcher spins on hang-up"<<std::endl;
+		++numFailures;
+		}
+	
+	/* Check that timer events don't cause more than one dispatcher iteration each: */
+	iterations0=numIterations;
+	EventDispatcher::Time start=EventDispatcher::Time::now();
+	start+=EventDispatcher::Time(0,10000);
+	EventDispatcher::ListenerKey timerKey=dispatcher.addTimerEventListener(start,EventDispatcher::Time(0,10000),timerCallback,0);
+	usleep(500000);
+	dispatcher.removeTimerEventListener(timerKey);
+	settle();
+	unsigned int timerIterations=numIterations-iterations0;
+	std::cout<<"Timer: "<<numTimerEvents<<" events, "<<timerIterations<<" dispatcher iterations in 500 ms"<<std::endl;
+	if(numTimerEvents<40||timerIterations>numTimerEvents*2+10)
+		{
+		std::cout<<"FAILED: timer events missed or dispatcher spins on timers"<<std::endl;
+		++numFailures;
+		}
+	
+	/* Shut down: */
+	dispatcher.stop();
+	dispatcherThread.join();
+	close(pair[1]);
+	for(std::vector<int>::iterator sIt=sockets.begin();sIt!=sockets.end();++sIt)
+		close(*sIt);
+	
+	return numFailures==0?0:1;
+	}
@@ -0,0 +1,194 @@
+/***********************************************************************
+FlatHashTableBenchmark - Utility to check Misc::FlatHashTable against
+std::map, and to compare its insert, lookup, and erase performance with
+Misc::HashTable for pointer keys.
+Copyright (c) 2020 Oliver Kreylos
+
+This program is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <Misc/Timer.h>
+#include <Misc/HashTable.h>
+#include <Misc/FlatHashTable.h>
+
+struct Object // Dummy heap object whose addresses serve as keys, like GLContextData's
+	{
+	/* Elements: */
+	public:
+	char padding[48];
+	};
+
+typedef std::vector<const Object*> KeyList;
+
+/****************
+Helper functions:
+****************/
+
+bool checkCorrectness(void) // Compares a flat hash table with std::map under a random sequence of operations
+	{
+	typedef Misc::FlatHashTable<unsigned int,int> Table;
+	Table table(3);
+	std::map<unsigned int,int> reference;
+	for(int i=0;i<2000000;++i)
+		{
+		unsigned int key=rand()%5000;
+		switch(rand()%4)
+			{
+			case 0:
+				table.setEntry(Table::Entry(key,i));
+				reference[key]=i;
+				break;
+			
+			case 1:
+				table.removeEntry(key);
+				reference.erase(key);
+				break;
+			
+			case 2:
+				{
+				bool isEntry=table.isEntry(key);
+				if(isEntry!=(reference.count(key)!=0)||(isEntry&&table.getEntry(key).getDest()!=reference[key]))
+					return false;
+				break;
+				}
+			
+			default:
+				/* Create missing entries with an explicit zero, as table entries created by operator[] have undefined values: */
+				if(!table.isEntry(key))
+					table.setEntry(Table::Entry(key,0));
+				table[key].getDest()+=1;
+				reference[key]+=1;
+			}
+		
+		if(table.getNumEntries()!=reference.size())
+			return false;
+		}
+	
+	/* Check that iteration visits every entry exactly once: */
+	size_t numIterated=0;
+	for(Table::Iterator tIt=table.begin();!tIt.isFinished();++tIt,++numIterated)
+		if(reference[tIt->getSource()]!=tIt->getDest())
+			return false;
+	
+	return numIterated==reference.size();
+	}
+
+template <class TableParam>
+void benchmark(const char* tableName,const KeyList& keys,const KeyList& order,unsigned int numRounds,bool presize)
+	{
+	double insertTime=0.0,lookupTime=0.0,eraseTime=0.0;
+	size_t sum=0;
+	for(unsigned int round=0;round<numRounds;++round)
+		{
+		TableParam table(presize?keys.size()*2:101);
+		
+		/* Insert all keys: */
+		Misc::Timer insertTimer;
+		for(KeyList::const_iterator kIt=keys.begin();kIt!=keys.end();++kIt)
+			table.setEntry(typename TableParam::Entry(*kIt,reinterpret_cast<const int*>(*kIt)+1));
+		insertTimer.elapse();
+		insertTime+=insertTimer.getTime();
+		
+		/* Look up all keys in random order, and look up the same number of missing keys: */
+		Misc::Timer lookupTimer;
+		for(KeyList::const_iterator oIt=order.begin();oIt!=order.end();++oIt)
+			{
+			typename TableParam::Iterator tIt=table.findEntry(*oIt);
+			if(!tIt.isFinished())
+				sum+=size_t(tIt->getDest());
+			if(table.isEntry(*oIt+1))
+				++sum;
+			}
+		lookupTimer.elapse();
+		lookupTime+=lookupTimer.getTime();
+		
+		/* Erase all keys in random order: */
+		Misc::Timer eraseTimer;
+		for(KeyList::const_iterator oIt=order.begin();oIt!=order.end();++oIt)
+			table.removeEntry(*oIt);
+		eraseTimer.elapse();
+		eraseTime+=eraseTimer.getTime();
+		}
+	
+	double numOps=double(keys.size())*double(numRounds);
+	std::cout<<std::setw(14)<<tableName<<std::setw(7)<<keys.size()<<(presize?" pre-sized":"   growing");
+	std::cout<<": insert "<<std::setw(6)<<insertTime*1.0e9/numOps<<" ns, lookup "<<std::setw(6)<<lookupTime*1.0e9/(numOps*2.0)<<" ns, erase "<<std::setw(6)<<eraseTime*1.0e9/numOps<<" ns"<<(sum==0?" ":"")<<std::endl;
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numOps=2000000;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"ops")==0&&i+1<argc)
+				{
+				++i;
+				numOps=(unsigned int)(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	
+	srand(1);
+	if(!checkCorrectness())
+		{
+		std::cout<<"FlatHashTable does not match std::map"<<std::endl;
+		return 1;
+		}
+	std::cout<<"FlatHashTable matches std::map"<<std::endl;
+	
+	std::cout<<std::fixed<<std::setprecision(1);
+	static const size_t numKeys[]={64,512,4096,32768};
+	for(int sizeIndex=0;sizeIndex<4;++sizeIndex)
+		{
+		/* Create heap objects with some gaps between them, and a random lookup order: */
+		KeyList keys;
+		std::vector<Object*> objects;
+		for(size_t i=0;i<numKeys[sizeIndex];++i)
+			{
+			objects.push_back(new Object);
+			keys.push_back(objects.back());
+			if(rand()%3==0)
+				objects.push_back(new Object);
+			}
+		KeyList order=keys;
+		std::random_shuffle(order.begin(),order.end());
+		
+		unsigned int numRounds=numOps/numKeys[sizeIndex]+1;
+		for(int presize=0;presize<2;++presize)
+			{
+			benchmark<Misc::HashTable<const Object*,const int*> >("HashTable",keys,order,numRounds,presize!=0);
+			benchmark<Misc::FlatHashTable<const Object*,const int*> >("FlatHashTable",keys,order,numRounds,presize!=0);
+			}
+		
+		for(std::vector<Object*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+			delete *oIt;
+		}
+	
+	return 0;
+	}
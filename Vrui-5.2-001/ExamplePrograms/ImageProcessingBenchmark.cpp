@@ -0,0 +1,173 @@
+/***********************************************************************
+ImageProcessingBenchmark - Utility to measure the performance of the
+basic image processing methods of class Images::BaseImage on large
+synthetic images.
+Copyright (c) 2020 Oliver Kreylos
+
+This program is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <Misc/SizedTypes.h>
+#include <Misc/Timer.h>
+#include <GL/gl.h>
+#include <Images/BaseImage.h>
+
+/****************
+Helper functions:
+****************/
+
+template <class ScalarParam>
+void fillImage(Images::BaseImage& image,double scale) // Fills an image with a smooth color gradient plus noise
+	{
+	unsigned int width=image.getWidth();
+	unsigned int height=image.getHeight();
+	unsigned int nc=image.getNumChannels();
+	ScalarParam* pPtr=static_cast<ScalarParam*>(image.replacePixels());
+	for(unsigned int y=0;y<height;++y)
+		for(unsigned int x=0;x<width;++x)
+			for(unsigned int c=0;c<nc;++c,++pPtr)
+				{
+				double value=(double(x)/double(width)*double(c+1)+double(y)/double(height)*double(nc-c))/double(nc+1);
+				value+=double(rand()%256)/2048.0;
+				*pPtr=ScalarParam((value-double(int(value)))*scale);
+				}
+	}
+
+Images::BaseImage createImage(unsigned int width,unsigned int height,GLenum format,GLenum scalarType) // Creates a synthetic image of the given size and format
+	{
+	unsigned int numChannels=format==GL_LUMINANCE?1:format==GL_LUMINANCE_ALPHA?2:format==GL_RGB?3:4;
+	unsigned int channelSize=scalarType==GL_UNSIGNED_BYTE?1:scalarType==GL_UNSIGNED_SHORT?2:4;
+	Images::BaseImage result(width,height,numChannels,channelSize,format,scalarType);
+	switch(scalarType)
+		{
+		case GL_UNSIGNED_BYTE:
+			fillImage<Misc::UInt8>(result,256.0);
+			break;
+		
+		case GL_UNSIGNED_SHORT:
+			fillImage<Misc::UInt16>(result,65536.0);
+			break;
+		
+		case GL_FLOAT:
+			fillImage<Misc::Float32>(result,1.0);
+			break;
+		}
+	
+	return result;
+	}
+
+const char* getFormatName(GLenum format,GLenum scalarType) // Returns a name for the given pixel format
+	{
+	static char name[64];
+	strcpy(name,format==GL_LUMINANCE?"L":format==GL_LUMINANCE_ALPHA?"LA":format==GL_RGB?"RGB":"RGBA");
+	strcat(name,scalarType==GL_UNSIGNED_BYTE?" 8":scalarType==GL_UNSIGNED_SHORT?" 16":" f32");
+	return name;
+	}
+
+void printResult(const char* operation,const Images::BaseImage& image,double time) // Prints the time and throughput of an operation
+	{
+	double mpix=double(image.getWidth())*double(image.getHeight())*1.0e-6;
+	std::cout<<std::setw(12)<<std::left<<operation<<std::setw(10)<<getFormatName(image.getFormat(),image.getScalarType())<<std::right;
+	std::cout<<std::setw(10)<<std::fixed<<std::setprecision(2)<<time*1000.0<<" ms"<<std::setw(10)<<std::setprecision(1)<<mpix/time<<" MPixel/s"<<std::endl;
+	}
+
+Images::BaseImage createMipmap(const Images::BaseImage& image) // Creates all mipmap levels of the given image and returns the smallest one
+	{
+	Images::BaseImage level=image;
+	while(level.getWidth()>1||level.getHeight()>1)
+		level=level.shrink();
+	return level;
+	}
+
+/* Macro to time the best of several runs of an image processing operation: */
+#define TIME_OPERATION(name,image,op) \
+	{ \
+	double bestTime=0.0; \
+	for(int run=0;run<numRuns;++run) \
+		{ \
+		Misc::Timer t; \
+		Images::BaseImage result=op; \
+		t.elapse(); \
+		if(run==0||bestTime>t.getTime()) \
+			bestTime=t.getTime(); \
+		} \
+	printResult(name,image,bestTime); \
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int size[2]={4096,4096};
+	int numRuns=10;
+	unsigned int numThreads=0;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"size")==0&&i+2<argc)
+				{
+				for(int j=0;j<2;++j)
+					size[j]=(unsigned int)(atoi(argv[i+1+j]));
+				i+=2;
+				}
+			else if(strcasecmp(argv[i]+1,"runs")==0&&i+1<argc)
+				{
+				++i;
+				numRuns=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"threads")==0&&i+1<argc)
+				{
+				++i;
+				numThreads=(unsigned int)(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	
+	/* Set the number of image processing threads: */
+	if(numThreads!=0)
+		Images::BaseImage::setNumProcessingThreads(numThreads);
+	std::cout<<"Processing "<<size[0]<<"x"<<size[1]<<" images on "<<Images::BaseImage::getNumProcessingThreads()<<" thread(s), best of "<<numRuns<<" runs"<<std::endl;
+	
+	/* Benchmark all operations on a set of common pixel formats: */
+	static const GLenum scalarTypes[3]={GL_UNSIGNED_BYTE,GL_UNSIGNED_SHORT,GL_FLOAT};
+	for(int sti=0;sti<3;++sti)
+		{
+		Images::BaseImage rgb=createImage(size[0],size[1],GL_RGB,scalarTypes[sti]);
+		Images::BaseImage rgba=createImage(size[0],size[1],GL_RGBA,scalarTypes[sti]);
+		Images::BaseImage grey=createImage(size[0],size[1],GL_LUMINANCE,scalarTypes[sti]);
+		
+		TIME_OPERATION("toGrey",rgb,rgb.toGrey());
+		TIME_OPERATION("toGrey",rgba,rgba.toGrey());
+		TIME_OPERATION("toRgb",grey,grey.toRgb());
+		TIME_OPERATION("dropAlpha",rgba,rgba.dropAlpha());
+		TIME_OPERATION("addAlpha",rgb,rgb.addAlpha(1.0));
+		TIME_OPERATION("shrink",rgb,rgb.shrink());
+		TIME_OPERATION("shrink",rgba,rgba.shrink());
+		TIME_OPERATION("shrink",grey,grey.shrink());
+		
+		/* Time the creation of a full mipmap pyramid: */
+		TIME_OPERATION("mipmap",rgba,createMipmap(rgba));
+		}
+	
+	return 0;
+	}
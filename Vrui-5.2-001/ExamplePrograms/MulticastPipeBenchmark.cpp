@@ -0,0 +1,185 @@
+/***********************************************************************
+MulticastPipeBenchmark - Utility to measure the bulk throughput of a
+multicast pipe from a master to a set of slaves, all running as
+processes on the local host.
+Copyright (c) 2020 Oliver Kreylos
+
+This program is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdexcept>
+#include <iostream>
+#include <vector>
+#include <Misc/SizedTypes.h>
+#include <Misc/Timer.h>
+#include <Cluster/Multiplexer.h>
+#include <Cluster/MulticastPipe.h>
+
+/****************
+Helper functions:
+****************/
+
+inline Misc::UInt8 chunkByte(unsigned int chunkIndex,size_t offset) // Returns the expected value of a sampled byte of the given chunk
+	{
+	return Misc::UInt8(chunkIndex*13U+offset/4096U);
+	}
+
+int runNode(unsigned int numSlaves,unsigned int nodeIndex,int portId,unsigned int sendBufferSize,unsigned int numChunks,size_t chunkSize)
+	{
+	/* Connect the node to the multicast group: */
+	Cluster::Multiplexer multiplexer(numSlaves,nodeIndex,"127.0.0.1",portId,"239.255.42.1",portId+1);
+	if(sendBufferSize!=0)
+		multiplexer.setSendBufferSize(sendBufferSize);
+	multiplexer.waitForConnection();
+	Cluster::MulticastPipe pipe(&multiplexer);
+	
+	/* Send or receive the requested number of chunks between two barriers: */
+	std::vector<Misc::UInt8> buffer(chunkSize,0);
+	unsigned int numBadChunks=0;
+	pipe.barrier();
+	Misc::Timer timer;
+	for(unsigned int chunkIndex=0;chunkIndex<numChunks;++chunkIndex)
+		{
+		if(nodeIndex==0)
+			{
+			/* Mark one byte per page and send the chunk: */
+			for(size_t i=0;i<chunkSize;i+=4096)
+				buffer[i]=chunkByte(chunkIndex,i);
+			pipe.write(&buffer[0],chunkSize);
+			}
+		else
+			{
+			/* Receive the chunk and check the marked bytes: */
+			pipe.read(&buffer[0],chunkSize);
+			for(size_t i=0;i<chunkSize;i+=4096)
+				if(buffer[i]!=chunkByte(chunkIndex,i))
+					{
+					++numBadChunks;
+					break;
+					}
+			}
+		}
+	pipe.flush();
+	pipe.barrier();
+	timer.elapse();
+	
+	/* Print throughput and traffic statistics: */
+	Cluster::Multiplexer::PipeStatistics stats=pipe.getStatistics();
+	if(nodeIndex==0)
+		{
+		double megabytes=double(numChunks)*double(chunkSize)/(1024.0*1024.0);
+		std::cout<<numSlaves<<" slaves, "<<megabytes<<" MB in "<<timer.getTime()<<" s: "<<megabytes/timer.getTime()<<" MB/s, "<<Cluster::Multiplexer::getMaxPacketSize()<<" bytes per packet"<<std::endl;
+		std::cout<<"Master: sent "<<stats.numSentPackets<<", re-sent "<<stats.numResentPackets<<", loss messages "<<stats.numPacketLossMessages<<std::endl;
+		}
+	else
+		{
+		std::cout<<"Slave "<<nodeIndex<<": received "<<stats.numReceivedPackets<<", discarded "<<stats.numDiscardedPackets<<", loss messages "<<stats.numPacketLossMessages;
+		if(numBadChunks!=0)
+			std::cout<<", CORRUPTED "<<numBadChunks<<" chunks";
+		std::cout<<std::endl;
+		}
+	
+	return numBadChunks==0?0:1;
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numSlaves=3;
+	int portId=26300;
+	unsigned int sendBufferSize=0;
+	unsigned int numChunks=300;
+	size_t chunkSize=1024*1024;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"slaves")==0&&i+1<argc)
+				{
+				++i;
+				numSlaves=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"port")==0&&i+1<argc)
+				{
+				++i;
+				portId=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"sendBufferSize")==0&&i+1<argc)
+				{
+				++i;
+				sendBufferSize=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"chunks")==0&&i+1<argc)
+				{
+				++i;
+				numChunks=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"chunkSize")==0&&i+1<argc)
+				{
+				++i;
+				chunkSize=size_t(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	if(numSlaves<1||numChunks<1||chunkSize<1)
+		{
+		std::cerr<<"Need at least one slave, one chunk, and one byte per chunk"<<std::endl;
+		return 1;
+		}
+	
+	/* Fork the slave processes: */
+	unsigned int nodeIndex=0;
+	for(unsigned int i=1;i<=numSlaves&&nodeIndex==0;++i)
+		{
+		pid_t pid=fork();
+		if(pid==0)
+			nodeIndex=i;
+		else if(pid<0)
+			{
+			std::cerr<<"Unable to start slave "<<i<<std::endl;
+			return 1;
+			}
+		}
+	
+	int result=1;
+	try
+		{
+		result=runNode(numSlaves,nodeIndex,portId,sendBufferSize,numChunks,chunkSize);
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cerr<<"Node "<<nodeIndex<<": caught exception "<<err.what()<<std::endl;
+		}
+	
+	if(nodeIndex==0)
+		{
+		/* Collect the slaves' results: */
+		int status;
+		while(wait(&status)>0)
+			if(!WIFEXITED(status)||WEXITSTATUS(status)!=0)
+				result=1;
+		}
+	
+	return result;
+	}
@@ -0,0 +1,228 @@
+/***********************************************************************
+MulticastPipeLossTest - Utility to check the integrity of data streams
+sent over a multicast pipe while slaves drop a fraction of received
+packets, with and without forward error correction. Runs a master and
+the requested number of slaves as processes on the local host.
+Copyright (c) 2020 Oliver Kreylos
+
+This program is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdexcept>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <Misc/SizedTypes.h>
+#include <Misc/Timer.h>
+#include <Cluster/Multiplexer.h>
+#include <Cluster/MulticastPipe.h>
+
+/****************
+Helper functions:
+****************/
+
+inline Misc::UInt8 streamByte(unsigned int frameIndex,size_t offset) // Returns the expected value of the given byte of the given frame
+	{
+	return Misc::UInt8((offset*31U+frameIndex*7U)^(offset>>8));
+	}
+
+size_t frameSize(unsigned int frameIndex,size_t maxFrameSize) // Returns the size of the given frame; sizes vary to exercise partial and multi-packet frames
+	{
+	switch(frameIndex%4)
+		{
+		case 0:
+			return maxFrameSize;
+		
+		case 1:
+			return 1;
+		
+		case 2:
+			return Cluster::Multiplexer::getMaxFecPacketSize()+1;
+		
+		default:
+			return (size_t(frameIndex)*7919U)%maxFrameSize+1;
+		}
+	}
+
+int runNode(unsigned int numSlaves,unsigned int nodeIndex,int portId,double lossRate,unsigned int fecGroupSize,unsigned int numFrames,size_t maxFrameSize)
+	{
+	/* Connect the node to the multicast group: */
+	Cluster::Multiplexer multiplexer(numSlaves,nodeIndex,"127.0.0.1",portId,"239.255.42.1",portId+1);
+	multiplexer.setReceiveWaitTimeout(Misc::Time(0.01));
+	multiplexer.setBarrierWaitTimeout(Misc::Time(0.01));
+	multiplexer.waitForConnection();
+	Cluster::MulticastPipe pipe(&multiplexer);
+	pipe.setFecGroupSize(fecGroupSize);
+	multiplexer.setSimulatedPacketLoss(lossRate);
+	
+	/* Send or receive frames of varying sizes, each followed by a barrier: */
+	std::vector<Misc::UInt8> buffer(maxFrameSize);
+	std::vector<double> latencies;
+	latencies.reserve(numFrames);
+	size_t numBadBytes=0;
+	unsigned int numBadFrames=0;
+	for(unsigned int frameIndex=0;frameIndex<numFrames;++frameIndex)
+		{
+		size_t size=frameSize(frameIndex,maxFrameSize);
+		Misc::Timer timer;
+		if(nodeIndex==0)
+			{
+			/* Send the frame's size and contents: */
+			for(size_t i=0;i<size;++i)
+				buffer[i]=streamByte(frameIndex,i);
+			pipe.write<Misc::UInt32>(Misc::UInt32(size));
+			pipe.write(&buffer[0],size);
+			pipe.flush();
+			}
+		else
+			{
+			/* Receive the frame and check its size and contents: */
+			size_t receivedSize=pipe.read<Misc::UInt32>();
+			if(receivedSize!=size)
+				{
+				std::cerr<<"Slave "<<nodeIndex<<": frame "<<frameIndex<<" has size "<<receivedSize<<" instead of "<<size<<std::endl;
+				return 1;
+				}
+			pipe.read(&buffer[0],size);
+			size_t numBad=0;
+			for(size_t i=0;i<size;++i)
+				if(buffer[i]!=streamByte(frameIndex,i))
+					++numBad;
+			if(numBad!=0)
+				{
+				numBadBytes+=numBad;
+				++numBadFrames;
+				}
+			}
+		pipe.barrier();
+		timer.elapse();
+		latencies.push_back(timer.getTime()*1000.0);
+		}
+	
+	/* Print traffic statistics: */
+	Cluster::Multiplexer::PipeStatistics stats=pipe.getStatistics();
+	std::sort(latencies.begin(),latencies.end());
+	if(nodeIndex==0)
+		{
+		std::cout<<"Loss "<<lossRate*100.0<<"%, FEC group size "<<fecGroupSize<<": frame+barrier p50 "<<latencies[latencies.size()/2]<<" ms, p99 "<<latencies[latencies.size()*99/100]<<" ms, max "<<latencies.back()<<" ms"<<std::endl;
+		std::cout<<"Master: sent "<<stats.numSentPackets<<", parity "<<stats.numParityPackets<<", re-sent "<<stats.numResentPackets<<", loss messages "<<stats.numPacketLossMessages<<std::endl;
+		}
+	else
+		{
+		std::cout<<"Slave "<<nodeIndex<<": received "<<stats.numReceivedPackets<<", recovered "<<stats.numRecoveredPackets<<", parity "<<stats.numParityPackets<<", discarded "<<stats.numDiscardedPackets<<", loss messages "<<stats.numPacketLossMessages;
+		if(numBadFrames!=0)
+			std::cout<<", CORRUPTED "<<numBadFrames<<" frames ("<<numBadBytes<<" bytes)";
+		std::cout<<std::endl;
+		}
+	
+	return numBadFrames==0?0:1;
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numSlaves=2;
+	int portId=26200;
+	double lossRate=0.05;
+	unsigned int fecGroupSize=8;
+	unsigned int numFrames=500;
+	size_t maxFrameSize=64*1024;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"slaves")==0&&i+1<argc)
+				{
+				++i;
+				numSlaves=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"port")==0&&i+1<argc)
+				{
+				++i;
+				portId=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"loss")==0&&i+1<argc)
+				{
+				++i;
+				lossRate=atof(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"fec")==0&&i+1<argc)
+				{
+				++i;
+				fecGroupSize=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"frames")==0&&i+1<argc)
+				{
+				++i;
+				numFrames=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"size")==0&&i+1<argc)
+				{
+				++i;
+				maxFrameSize=size_t(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	if(numSlaves<1||numFrames<1||maxFrameSize<1)
+		{
+		std::cerr<<"Need at least one slave, one frame, and one byte per frame"<<std::endl;
+		return 1;
+		}
+	
+	/* Fork the slave processes: */
+	unsigned int nodeIndex=0;
+	for(unsigned int i=1;i<=numSlaves&&nodeIndex==0;++i)
+		{
+		pid_t pid=fork();
+		if(pid==0)
+			nodeIndex=i;
+		else if(pid<0)
+			{
+			std::cerr<<"Unable to start slave "<<i<<std::endl;
+			return 1;
+			}
+		}
+	
+	int result=1;
+	try
+		{
+		result=runNode(numSlaves,nodeIndex,portId,lossRate,fecGroupSize,numFrames,maxFrameSize);
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cerr<<"Node "<<nodeIndex<<": caught exception "<<err.what()<<std::endl;
+		}
+	
+	if(nodeIndex==0)
+		{
+		/* Collect the slaves' results: */
+		int status;
+		while(wait(&status)>0)
+			if(!WIFEXITED(status)||WEXITSTATUS(status)!=0)
+				result=1;
+		std::cout<<(result==0?"Stream integrity check passed":"Stream integrity check FAILED")<<std::endl;
+		}
+	
+	return result;
+	}
@@ -0,0 +1,151 @@
+/***********************************************************************
+VideoExtractorBenchmark - Utility to measure the performance of the
+image extractors for common raw video formats on synthetic frames.
+Copyright (c) 2020 Oliver Kreylos
+
+This program is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Misc/Timer.h>
+#include <Video/FrameBuffer.h>
+#include <Video/ImageExtractor.h>
+#include <Video/ImageExtractorYUYV.h>
+#include <Video/ImageExtractorUYVY.h>
+#include <Video/ImageExtractorYV12.h>
+#include <Video/ImageExtractorBA81.h>
+
+/****************
+Helper functions:
+****************/
+
+void fillFrame(std::vector<unsigned char>& frame,size_t frameSize) // Fills a raw video frame with random data
+	{
+	frame.resize(frameSize);
+	for(std::vector<unsigned char>::iterator fIt=frame.begin();fIt!=frame.end();++fIt)
+		*fIt=(unsigned char)(rand()%256);
+	}
+
+void printResult(const char* format,const char* operation,const unsigned int size[2],double time) // Prints the time and throughput of an extraction operation
+	{
+	double mpix=double(size[0])*double(size[1])*1.0e-6;
+	std::cout<<std::setw(12)<<std::left<<format<<std::setw(12)<<operation<<std::right;
+	std::cout<<std::setw(10)<<std::fixed<<std::setprecision(2)<<time*1000.0<<" ms"<<std::setw(10)<<std::setprecision(1)<<mpix/time<<" MPixel/s"<<std::endl;
+	}
+
+void benchmarkExtractor(const char* format,Video::ImageExtractor& extractor,std::vector<unsigned char>& frame,const unsigned int size[2],int numRuns) // Times the greyscale and RGB extraction methods of the given extractor
+	{
+	/* Wrap the frame into a frame buffer: */
+	Video::FrameBuffer frameBuffer;
+	frameBuffer.start=&frame[0];
+	frameBuffer.size=frame.size();
+	frameBuffer.used=frame.size();
+	
+	/* Time the best of several greyscale and RGB extractions: */
+	std::vector<unsigned char> image(size_t(size[0])*size_t(size[1])*3);
+	for(int operation=0;operation<2;++operation)
+		{
+		double bestTime=0.0;
+		for(int run=0;run<numRuns;++run)
+			{
+			Misc::Timer t;
+			if(operation==0)
+				extractor.extractGrey(&frameBuffer,&image[0]);
+			else
+				extractor.extractRGB(&frameBuffer,&image[0]);
+			t.elapse();
+			if(run==0||bestTime>t.getTime())
+				bestTime=t.getTime();
+			}
+		printResult(format,operation==0?"extractGrey":"extractRGB",size,bestTime);
+		}
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int size[2]={1920,1080};
+	int numRuns=20;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"size")==0&&i+2<argc)
+				{
+				for(int j=0;j<2;++j)
+					size[j]=(unsigned int)(atoi(argv[i+1+j]));
+				i+=2;
+				}
+			else if(strcasecmp(argv[i]+1,"runs")==0&&i+1<argc)
+				{
+				++i;
+				numRuns=atoi(argv[i]);
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	
+	/* All extractors require even frame sizes: */
+	for(int i=0;i<2;++i)
+		size[i]&=~1U;
+	if(size[0]<2||size[1]<2)
+		{
+		std::cerr<<"Frame size must be at least 2x2 pixels"<<std::endl;
+		return 1;
+		}
+	std::cout<<"Extracting "<<size[0]<<"x"<<size[1]<<" frames, best of "<<numRuns<<" runs"<<std::endl;
+	size_t numPixels=size_t(size[0])*size_t(size[1]);
+	std::vector<unsigned char> frame;
+	
+	/* Benchmark the packed Y'CbCr 4:2:2 extractors: */
+	fillFrame(frame,numPixels*2);
+	{
+	Video::ImageExtractorYUYV extractor(size);
+	benchmarkExtractor("YUYV",extractor,frame,size,numRuns);
+	}
+	{
+	Video::ImageExtractorUYVY extractor(size);
+	benchmarkExtractor("UYVY",extractor,frame,size,numRuns);
+	}
+	
+	/* Benchmark the planar Y'CbCr 4:2:0 extractor: */
+	fillFrame(frame,numPixels+numPixels/2);
+	{
+	ptrdiff_t ypSize=ptrdiff_t(numPixels);
+	ptrdiff_t cSize=ptrdiff_t(numPixels/4);
+	Video::ImageExtractorYV12 extractor(size,0,size[0],ypSize+cSize,size[0]/2,ypSize,size[0]/2);
+	benchmarkExtractor("YV12",extractor,frame,size,numRuns);
+	}
+	
+	/* Benchmark the Bayer-filtered extractors: */
+	fillFrame(frame,numPixels);
+	{
+	Video::ImageExtractorBA81 extractor(size,Video::BAYER_RGGB);
+	benchmarkExtractor("BA81 RGGB",extractor,frame,size,numRuns);
+	}
+	{
+	Video::ImageExtractorBA81 extractor(size,Video::BAYER_BGGR);
+	benchmarkExtractor("BA81 BGGR",extractor,frame,size,numRuns);
+	}
+	
+	return 0;
+	}
@@ -1,7 +1,7 @@
 /***********************************************************************
 GLContextData - Class to store per-GL-context data for application
 objects.
-Copyright (c) 2000-2012 Oliver Kreylos
+Copyright (c) 2000-2020 Oliver Kreylos
 
 This file is part of the OpenGL Support Library (GLSupport).
 
@@ -23,7 +23,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #ifndef GLCONTEXTDATA_INCLUDED
 #define GLCONTEXTDATA_INCLUDED
 
-#include <Misc/HashTable.h>
+#include <Misc/FlatHashTable.h>
 #include <Misc/CallbackData.h>
 #include <Misc/CallbackList.h>
 #include <GL/TLSHelper.h>
@@ -52,7 +52,7 @@ class GLContextData
 		};
 	
 	private:
-	typedef Misc::HashTable<const GLObject*,GLObject::DataItem*> ItemHash; // Class for hash table mapping pointers to data items
+	typedef Misc::FlatHashTable<const GLObject*,GLObject::DataItem*> ItemHash; // Class for hash table mapping pointers to data items
 	
 	/* Elements: */
 	static Misc::CallbackList currentContextDataChangedCallbacks; // List of callbacks called whenever the current context data object changes
@@ -113,11 +113,12 @@ class GLContextData
 		ItemHash::Iterator dataIt=context.findEntry(thing);
 		if(!dataIt.isFinished())
 			{
-			/* Delete the data item (hopefully freeing all resources): */
-			delete dataIt->getDest();
-			
-			/* Remove the data item from the hash table: */
+			/* Remove the data item from the hash table first, as removing entries invalidates iterators: */
+			GLObject::DataItem* dataItem=dataIt->getDest();
 			context.removeEntry(dataIt);
+			
+			/* Delete the data item (hopefully freeing all resources): */
+			delete dataItem;
 			}
 		}
 	
@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <IO/Directory.h>
 
 #include <Misc/ThrowStdErr.h>
+#include <IO/MemMappedFile.h>
 #include <IO/SeekableFilter.h>
 
 namespace IO {
@@ -214,6 +215,13 @@ SeekableFilePtr Directory::openSeekableFile(const char* fileName,File::AccessMod
 		/* Wrap a seekable filter around the file: */
 		result=new SeekableFilter(file);
 		}
+	else
+		{
+		/* Restore normal read-ahead on files that IO::Opener memory-mapped for sequential reading: */
+		MemMappedFile* mmFile=dynamic_cast<MemMappedFile*>(result.getPointer());
+		if(mmFile!=0)
+			mmFile->setAccessPattern(MemMappedFile::NormalAccess);
+		}
 	
 	return result;
 	}
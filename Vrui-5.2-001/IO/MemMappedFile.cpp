@@ -1,7 +1,7 @@
 /***********************************************************************
 MemMappedFile - Class for read/write access to memory-mapped files using
 the File abstraction; mostly for simplified resource management.
-Copyright (c) 2011-2019 Oliver Kreylos
+Copyright (c) 2011-2020 Oliver Kreylos
 
 This file is part of the I/O Support Library (IO).
 
@@ -38,6 +38,20 @@ namespace IO {
 Methods of class MemMappedFile:
 ******************************/
 
+size_t MemMappedFile::readData(File::Byte* buffer,size_t bufferSize)
+	{
+	/* The read buffer always extends to the end of the memory map; bail out unless a seek moved the read position back inside the map: */
+	if(readPos>=Offset(memSize))
+		return 0;
+	
+	/* Expose the memory map from the read position to its end as the new read buffer: */
+	size_t readSize=memSize-size_t(readPos);
+	setReadBuffer(readSize,static_cast<Byte*>(memBase)+readPos,false);
+	readPos=memSize;
+	
+	return readSize;
+	}
+
 void MemMappedFile::openFile(const char* fileName,File::AccessMode accessMode,int flags,int mode)
 	{
 	/* Adjust flags according to access mode: */
@@ -85,10 +99,13 @@ void MemMappedFile::openFile(const char* fileName,File::AccessMode accessMode,in
 	
 	/* Memory-map the file: */
 	int prot;
+	int mapFlags=MAP_SHARED;
 	switch(accessMode)
 		{
 		case ReadOnly:
-			prot=PROT_READ;
+			/* Map privately and writable without reserving swap space, so that in-buffer operations like ungetChar only modify private copies of pages: */
+			prot=PROT_READ|PROT_WRITE;
+			mapFlags=MAP_PRIVATE|MAP_NORESERVE;
 			break;
 		
 		case WriteOnly:
@@ -102,12 +119,16 @@ void MemMappedFile::openFile(const char* fileName,File::AccessMode accessMode,in
 		default:
 			prot=0x0;
 		}
-	memBase=mmap(0,memSize,prot,MAP_SHARED,fd,0);
-	if(memBase==MAP_FAILED)
+	if(memSize>0)
 		{
-		close(fd);
-		char buffer[1024];
-		throw OpenError(Misc::printStdErrMsgReentrant(buffer,sizeof(buffer),"IO::MemMappedFile: Unable to memory-map file %s",fileName));
+		memBase=mmap(0,memSize,prot,mapFlags,fd,0);
+		if(memBase==MAP_FAILED)
+			{
+			memBase=0;
+			close(fd);
+			char buffer[1024];
+			throw OpenError(Misc::printStdErrMsgReentrant(buffer,sizeof(buffer),"IO::MemMappedFile: Unable to memory-map file %s",fileName));
+			}
 		}
 	
 	/* Close the file again: */
@@ -116,8 +137,12 @@ void MemMappedFile::openFile(const char* fileName,File::AccessMode accessMode,in
 	/* Re-allocate the buffered file's buffers: */
 	setReadBuffer(memSize,static_cast<Byte*>(memBase),false);
 	canReadThrough=false;
-	setWriteBuffer(memSize,static_cast<Byte*>(memBase),false);
-	canWriteThrough=false;
+	if(accessMode==WriteOnly||accessMode==ReadWrite)
+		{
+		/* Only expose a write buffer if the file can be written, so that filters can tell the file's access mode: */
+		setWriteBuffer(memSize,static_cast<Byte*>(memBase),false);
+		canWriteThrough=false;
+		}
 	
 	/* Pretend putting the file data into the read buffer: */
 	appendReadBufferData(memSize);
@@ -177,4 +202,33 @@ SeekableFile::Offset MemMappedFile::getSize(void) const
 	return memSize;
 	}
 
+void MemMappedFile::setAccessPattern(MemMappedFile::AccessPattern newAccessPattern)
+	{
+	/* Find the page-aligned range of the memory map from the current read position to its end: */
+	size_t pageSize=size_t(sysconf(_SC_PAGESIZE));
+	Offset readOffset=getReadPos();
+	if(readOffset>=Offset(memSize))
+		return;
+	size_t rangeStart=(size_t(readOffset)/pageSize)*pageSize;
+	Byte* range=static_cast<Byte*>(memBase)+rangeStart;
+	size_t rangeSize=memSize-rangeStart;
+	
+	/* Pass the advice to the operating system; failures are not fatal, as the advice is only a hint: */
+	switch(newAccessPattern)
+		{
+		case NormalAccess:
+			madvise(range,rangeSize,MADV_NORMAL);
+			break;
+		
+		case SequentialAccess:
+			/* Enable aggressive read-ahead and early release of read pages; an additional MADV_WILLNEED interferes with the kernel's read-ahead window: */
+			madvise(range,rangeSize,MADV_SEQUENTIAL);
+			break;
+		
+		case RandomAccess:
+			madvise(range,rangeSize,MADV_RANDOM);
+			break;
+		}
+	}
+
 }
@@ -1,7 +1,7 @@
 /***********************************************************************
 MemMappedFile - Class for read/write access to memory-mapped files using
 the File abstraction; mostly for simplified resource management.
-Copyright (c) 2011 Oliver Kreylos
+Copyright (c) 2011-2020 Oliver Kreylos
 
 This file is part of the I/O Support Library (IO).
 
@@ -30,12 +30,24 @@ namespace IO {
 
 class MemMappedFile:public SeekableFile
 	{
+	/* Embedded classes: */
+	public:
+	enum AccessPattern // Enumerated type for expected patterns of access to the file's memory map
+		{
+		NormalAccess,SequentialAccess,RandomAccess
+		};
+	
 	/* Elements: */
 	private:
 	void* memBase; // Base address of file's memory space
 	size_t memSize; // Size of file's memory space
 	
+	/* Protected methods from File: */
+	protected:
+	virtual size_t readData(Byte* buffer,size_t bufferSize);
+	
 	/* Private methods: */
+	private:
 	void openFile(const char* fileName,AccessMode accessMode,int flags,int mode); // Opens and memory-maps a file and handles errors
 	
 	/* Constructors and destructors: */
@@ -52,6 +64,7 @@ class MemMappedFile:public SeekableFile
 	virtual Offset getSize(void) const;
 	
 	/* New methods: */
+	void setAccessPattern(AccessPattern newAccessPattern); // Advises the operating system how the file's memory map will be accessed from the current read position onwards, to tune read-ahead
 	const void* getMemory(void) const // Returns a pointer to the file's memory map
 		{
 		return memBase;
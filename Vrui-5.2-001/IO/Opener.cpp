@@ -2,7 +2,7 @@
 Opener - Class to encapsulate how files and other file-like objects are
 opened, to expose functionality of higher-level libraries at the base IO
 level.
-Copyright (c) 2018 Oliver Kreylos
+Copyright (c) 2018-2020 Oliver Kreylos
 
 This file is part of the I/O Support Library (IO).
 
@@ -23,8 +23,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include <IO/Opener.h>
 
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <Misc/FileNameExtensions.h>
 #include <IO/StandardFile.h>
+#include <IO/MemMappedFile.h>
 #include <IO/GzipFilter.h>
 #include <IO/SeekableFilter.h>
 #include <IO/StandardDirectory.h>
@@ -41,6 +44,7 @@ Static elements of class Opener:
 
 Opener Opener::theOpener(true);
 Opener* Opener::opener=0;
+size_t Opener::memMapThreshold=size_t(64)*size_t(1024)*size_t(1024);
 
 /***********************
 Methods of class Opener:
@@ -90,12 +94,37 @@ void Opener::resetOpener(void)
 	opener=&theOpener;
 	}
 
+void Opener::setMemMapThreshold(size_t newMemMapThreshold)
+	{
+	memMapThreshold=newMemMapThreshold;
+	}
+
 FilePtr Opener::openFile(const char* fileName,File::AccessMode accessMode)
 	{
 	FilePtr result;
 	
-	/* Open a standard file: */
-	result=new StandardFile(fileName,accessMode);
+	/* Check if the file is a large regular file that is only going to be read: */
+	struct stat fileStat;
+	if(accessMode==File::ReadOnly&&memMapThreshold!=0&&stat(fileName,&fileStat)==0&&S_ISREG(fileStat.st_mode)&&size_t(fileStat.st_size)>=memMapThreshold)
+		{
+		try
+			{
+			/* Memory-map the file and expose the mapping directly as its read buffer: */
+			MemMappedFile* file=new MemMappedFile(fileName,accessMode);
+			result=file;
+			
+			/* Files opened this way are usually read front to back; openSeekableFile undoes this advice: */
+			file->setAccessPattern(MemMappedFile::SequentialAccess);
+			}
+		catch(const File::OpenError&)
+			{
+			/* Fall back to a standard file, e.g., if the address space is exhausted: */
+			}
+		}
+	
+	/* Open a standard file if the file was not memory-mapped: */
+	if(result==0)
+		result=new StandardFile(fileName,accessMode);
 	
 	/* Check if the file name has the .gz extension: */
 	if(Misc::hasCaseExtension(fileName,".gz"))
@@ -120,6 +149,13 @@ SeekableFilePtr Opener::openSeekableFile(const char* fileName,File::AccessMode a
 		/* Wrap a seekable filter around the file: */
 		result=new SeekableFilter(file);
 		}
+	else
+		{
+		/* Undo the sequential read-ahead advice given to memory-mapped files, as seekable files are often read out of order; callers can re-enable it via MemMappedFile::setAccessPattern: */
+		MemMappedFile* mmFile=dynamic_cast<MemMappedFile*>(result.getPointer());
+		if(mmFile!=0)
+			mmFile->setAccessPattern(MemMappedFile::NormalAccess);
+		}
 	
 	return result;
 	}
@@ -2,7 +2,7 @@
 Opener - Class to encapsulate how files and other file-like objects are
 opened, to expose functionality of higher-level libraries at the base IO
 level.
-Copyright (c) 2018 Oliver Kreylos
+Copyright (c) 2018-2020 Oliver Kreylos
 
 This file is part of the I/O Support Library (IO).
 
@@ -36,6 +36,7 @@ class Opener
 	private:
 	static Opener theOpener; // Static opener object active unless another one is installed
 	static Opener* opener; // Pointer to the active opener
+	static size_t memMapThreshold; // Minimum size of regular files in bytes that are memory-mapped when opened for reading only; 0 disables memory-mapping
 	
 	/* Constructors and destructors: */
 	public:
@@ -49,6 +50,11 @@ class Opener
 		}
 	static Opener* installOpener(Opener* newOpener); // Installs the given opener as the current opener; returns previous opener
 	static void resetOpener(void); // Installs the basic opener as the current opener
+	static size_t getMemMapThreshold(void) // Returns the minimum size of regular files that are memory-mapped when opened for reading only
+		{
+		return memMapThreshold;
+		}
+	static void setMemMapThreshold(size_t newMemMapThreshold); // Sets the minimum size of regular files that are memory-mapped when opened for reading only; 0 disables memory-mapping
 	
 	/* File opening methods: */
 	virtual FilePtr openFile(const char* fileName,File::AccessMode accessMode); // Opens a file of the given name
@@ -25,9 +25,14 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include <stddef.h>
 #include <string.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <stdexcept>
 #include <Misc/SizedTypes.h>
 #include <IO/File.h>
+#include <Threads/Thread.h>
 #include <Math/Math.h>
 #include <GL/Extensions/GLEXTFramebufferObject.h>
 
@@ -76,30 +81,150 @@ BaseImage::ImageRepresentation::~ImageRepresentation(void)
 
 namespace {
 
+/************************************************************
+Helper classes and functions for row-parallel image processing:
+************************************************************/
+
+unsigned int numProcessingThreads=0; // Maximum number of threads used to process large images; 0 if not yet determined
+const size_t minBandComponents=size_t(1)<<18; // Minimum number of pixel components a thread has to process to be worth starting
+
+template <class KernelParam>
+struct RowBand // Structure describing a band of image rows processed by one thread
+	{
+	/* Elements: */
+	public:
+	const KernelParam* kernel; // Kernel processing the band
+	unsigned int rowBegin,rowEnd; // Range of image rows in the band
+	};
+
+template <class KernelParam>
+void* rowBandThreadMethod(RowBand<KernelParam>* band)
+	{
+	/* Process the band's rows: */
+	band->kernel->processRows(band->rowBegin,band->rowEnd);
+	
+	return 0;
+	}
+
+template <class KernelParam>
+inline
+void
+processRows(
+	const KernelParam& kernel,
+	unsigned int numRows,
+	size_t rowComponents)
+	{
+	/* Determine the number of threads to use based on the amount of work: */
+	size_t numThreads=(size_t(numRows)*rowComponents)/minBandComponents;
+	if(numThreads>BaseImage::getNumProcessingThreads())
+		numThreads=BaseImage::getNumProcessingThreads();
+	if(numThreads>numRows)
+		numThreads=numRows;
+	
+	if(numThreads<=1)
+		{
+		/* Process all rows in the caller's thread: */
+		kernel.processRows(0,numRows);
+		}
+	else
+		{
+		/* Split the rows into bands of roughly equal size: */
+		RowBand<KernelParam>* bands=new RowBand<KernelParam>[numThreads];
+		for(size_t i=0;i<numThreads;++i)
+			{
+			bands[i].kernel=&kernel;
+			bands[i].rowBegin=(unsigned int)((size_t(numRows)*i)/numThreads);
+			bands[i].rowEnd=(unsigned int)((size_t(numRows)*(i+1))/numThreads);
+			}
+		
+		/* Process all bands but the first in background threads: */
+		Threads::Thread* threads=new Threads::Thread[numThreads-1];
+		for(size_t i=1;i<numThreads;++i)
+			threads[i-1].start(rowBandThreadMethod<KernelParam>,&bands[i]);
+		
+		/* Process the first band in the caller's thread: */
+		kernel.processRows(bands[0].rowBegin,bands[0].rowEnd);
+		
+		/* Wait for all background threads to finish: */
+		for(size_t i=1;i<numThreads;++i)
+			threads[i-1].join();
+		delete[] threads;
+		delete[] bands;
+		}
+	}
+
 /*******************************************************
 Helper classes and functions for basic image operations:
 *******************************************************/
 
 template <class ScalarParam>
+class ConversionKernel // Base class for kernels converting an image into another image of the same size and scalar type
+	{
+	/* Elements: */
+	protected:
+	size_t width; // Image width in pixels
+	const ScalarParam* sPixels; // Source image's pixel array
+	ScalarParam* dPixels; // Destination image's pixel array
+	
+	/* Constructors and destructors: */
+	public:
+	ConversionKernel(const BaseImage& source,BaseImage& dest)
+		:width(source.getWidth()),
+		 sPixels(static_cast<const ScalarParam*>(source.getPixels())),
+		 dPixels(static_cast<ScalarParam*>(dest.modifyPixels()))
+		{
+		}
+	};
+
+template <class KernelParam>
 inline
 void
-dropAlphaTyped(
+convertImage(
 	const BaseImage& source,
 	BaseImage& dest)
 	{
-	/* Drop the alpha value of all pixels: */
-	unsigned int numChannels=dest.getNumChannels();
-	const ScalarParam* sPtr=static_cast<const ScalarParam*>(source.getPixels());
-	ScalarParam* dPtr=static_cast<ScalarParam*>(dest.modifyPixels());
-	for(size_t i=size_t(source.getSize(0))*size_t(source.getSize(1));i>0;--i)
+	/* Process the image with a kernel of the given type: */
+	KernelParam kernel(source,dest);
+	processRows(kernel,source.getHeight(),size_t(source.getWidth())*size_t(source.getNumChannels()+dest.getNumChannels()));
+	}
+
+template <class ScalarParam,unsigned int numChannelsParam>
+class DropAlphaKernel:public ConversionKernel<ScalarParam> // Kernel to drop the alpha channel from an image with the given number of non-alpha channels
+	{
+	/* Constructors and destructors: */
+	public:
+	DropAlphaKernel(const BaseImage& source,BaseImage& dest)
+		:ConversionKernel<ScalarParam>(source,dest)
 		{
-		/* Copy the non-alpha channels: */
-		for(size_t j=0;j<numChannels;++j)
-			*(dPtr++)=*(sPtr++);
-		
-		/* Skip the source's alpha channel: */
-		++sPtr;
 		}
+	
+	/* Methods: */
+	void processRows(unsigned int rowBegin,unsigned int rowEnd) const
+		{
+		/* Drop the alpha value of all pixels: */
+		const ScalarParam* sPtr=this->sPixels+size_t(rowBegin)*this->width*(numChannelsParam+1);
+		ScalarParam* dPtr=this->dPixels+size_t(rowBegin)*this->width*numChannelsParam;
+		for(size_t i=size_t(rowEnd-rowBegin)*this->width;i>0;--i,sPtr+=numChannelsParam+1,dPtr+=numChannelsParam)
+			{
+			/* Copy the non-alpha channels: */
+			for(unsigned int j=0;j<numChannelsParam;++j)
+				dPtr[j]=sPtr[j];
+			}
+		}
+	};
+
+template <class ScalarParam>
+inline
+void
+dropAlphaTyped(
+	const BaseImage& source,
+	BaseImage& dest)
+	{
+	/* Delegate to a kernel for the destination's number of channels: */
+	if(dest.getNumChannels()==3)
+		convertImage<DropAlphaKernel<ScalarParam,3> >(source,dest);
+	else
+		convertImage<DropAlphaKernel<ScalarParam,1> >(source,dest);
 	}
 
 void dropAlphaImpl(const BaseImage& source,BaseImage& dest)
@@ -144,6 +269,39 @@ void dropAlphaImpl(const BaseImage& source,BaseImage& dest)
 		}
 	}
 
+template <class ScalarParam,unsigned int numChannelsParam>
+class AddAlphaKernel:public ConversionKernel<ScalarParam> // Kernel to add a constant alpha channel to an image with the given number of channels
+	{
+	/* Elements: */
+	private:
+	ScalarParam alpha; // Alpha value to add
+	
+	/* Constructors and destructors: */
+	public:
+	AddAlphaKernel(const BaseImage& source,BaseImage& dest,ScalarParam sAlpha)
+		:ConversionKernel<ScalarParam>(source,dest),
+		 alpha(sAlpha)
+		{
+		}
+	
+	/* Methods: */
+	void processRows(unsigned int rowBegin,unsigned int rowEnd) const
+		{
+		/* Add the constant alpha value to all pixels: */
+		const ScalarParam* sPtr=this->sPixels+size_t(rowBegin)*this->width*numChannelsParam;
+		ScalarParam* dPtr=this->dPixels+size_t(rowBegin)*this->width*(numChannelsParam+1);
+		for(size_t i=size_t(rowEnd-rowBegin)*this->width;i>0;--i,sPtr+=numChannelsParam,dPtr+=numChannelsParam+1)
+			{
+			/* Copy the non-alpha channels: */
+			for(unsigned int j=0;j<numChannelsParam;++j)
+				dPtr[j]=sPtr[j];
+			
+			/* Add an alpha value to the destination: */
+			dPtr[numChannelsParam]=alpha;
+			}
+		}
+	};
+
 template <class ScalarParam>
 inline
 void
@@ -152,18 +310,16 @@ addAlphaTyped(
 	BaseImage& dest,
 	ScalarParam alpha)
 	{
-	/* Add the constant alpha value to all pixels: */
-	unsigned int numChannels=source.getNumChannels();
-	const ScalarParam* sPtr=static_cast<const ScalarParam*>(source.getPixels());
-	ScalarParam* dPtr=static_cast<ScalarParam*>(dest.modifyPixels());
-	for(size_t i=size_t(source.getSize(0))*size_t(source.getSize(1));i>0;--i)
+	/* Delegate to a kernel for the source's number of channels: */
+	if(source.getNumChannels()==3)
 		{
-		/* Copy the non-alpha channels: */
-		for(size_t j=0;j<numChannels;++j)
-			*(dPtr++)=*(sPtr++);
-		
-		/* Add an alpha value to the destination: */
-		*(dPtr++)=alpha;
+		AddAlphaKernel<ScalarParam,3> kernel(source,dest,alpha);
+		processRows(kernel,source.getHeight(),size_t(source.getWidth())*7);
+		}
+	else
+		{
+		AddAlphaKernel<ScalarParam,1> kernel(source,dest,alpha);
+		processRows(kernel,source.getHeight(),size_t(source.getWidth())*3);
 		}
 	}
 
@@ -211,35 +367,125 @@ void addAlphaImpl(const BaseImage& source,BaseImage& dest,double alpha)
 
 template <class ScalarParam,class WeightParam>
 inline
-void
-toGreyTypedInt(
-	const BaseImage& source,
-	BaseImage& dest)
+ScalarParam
+calcLuminanceInt(
+	const ScalarParam* rgb)
 	{
-	/* Convert all pixels to luminance and retain an existing alpha channel: */
-	const ScalarParam* sPtr=static_cast<const ScalarParam*>(source.getPixels());
-	ScalarParam* dPtr=static_cast<ScalarParam*>(dest.modifyPixels());
-	if(source.getNumChannels()==4)
+	return ScalarParam((WeightParam(rgb[0])*WeightParam(77)+WeightParam(rgb[1])*WeightParam(150)+WeightParam(rgb[2])*WeightParam(29))>>WeightParam(8));
+	}
+
+template <class ScalarParam,class WeightParam,unsigned int numChannelsParam>
+class ToGreyIntKernel:public ConversionKernel<ScalarParam> // Kernel to convert an RGB or RGBA image with integer components to luminance
+	{
+	/* Constructors and destructors: */
+	public:
+	ToGreyIntKernel(const BaseImage& source,BaseImage& dest)
+		:ConversionKernel<ScalarParam>(source,dest)
+		{
+		}
+	
+	/* Methods: */
+	void processRows(unsigned int rowBegin,unsigned int rowEnd) const
 		{
-		/* Convert RGBA to LUMINANCE_ALPHA: */
-		for(size_t i=size_t(source.getSize(0))*size_t(source.getSize(1));i>0;--i,sPtr+=4)
+		/* Convert all pixels to luminance and retain an existing alpha channel: */
+		const ScalarParam* sPtr=this->sPixels+size_t(rowBegin)*this->width*numChannelsParam;
+		ScalarParam* dPtr=this->dPixels+size_t(rowBegin)*this->width*(numChannelsParam-2);
+		for(size_t i=size_t(rowEnd-rowBegin)*this->width;i>0;--i,sPtr+=numChannelsParam,dPtr+=numChannelsParam-2)
 			{
 			/* Calculate pixel luminance: */
-			*(dPtr++)=ScalarParam((WeightParam(sPtr[0])*WeightParam(77)+WeightParam(sPtr[1])*WeightParam(150)+WeightParam(sPtr[2])*WeightParam(29))>>WeightParam(8));
+			dPtr[0]=calcLuminanceInt<ScalarParam,WeightParam>(sPtr);
 			
-			/* Copy alpha channel: */
-			*(dPtr++)=sPtr[3];
+			/* Copy an alpha channel: */
+			if(numChannelsParam==4)
+				dPtr[1]=sPtr[3];
 			}
 		}
-	else
+	};
+
+#ifdef __SSE2__
+
+template <>
+inline
+void
+ToGreyIntKernel<unsigned char,unsigned short,4>::processRows(
+	unsigned int rowBegin,
+	unsigned int rowEnd) const
+	{
+	/* Convert eight RGBA pixels at a time to luminance-alpha: */
+	const unsigned char* sPtr=sPixels+size_t(rowBegin)*width*4;
+	unsigned char* dPtr=dPixels+size_t(rowBegin)*width*2;
+	size_t numPixels=size_t(rowEnd-rowBegin)*width;
+	const __m128i lowByte=_mm_set1_epi32(0xff);
+	for(;numPixels>=8;numPixels-=8,sPtr+=32,dPtr+=16)
+		{
+		/* Load the pixels and separate their components into vectors of 16-bit values: */
+		__m128i p0=_mm_loadu_si128(reinterpret_cast<const __m128i*>(sPtr));
+		__m128i p1=_mm_loadu_si128(reinterpret_cast<const __m128i*>(sPtr+16));
+		__m128i r=_mm_packs_epi32(_mm_and_si128(p0,lowByte),_mm_and_si128(p1,lowByte));
+		__m128i g=_mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0,8),lowByte),_mm_and_si128(_mm_srli_epi32(p1,8),lowByte));
+		__m128i b=_mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0,16),lowByte),_mm_and_si128(_mm_srli_epi32(p1,16),lowByte));
+		__m128i a=_mm_packs_epi32(_mm_srli_epi32(p0,24),_mm_srli_epi32(p1,24));
+		
+		/* Calculate pixel luminances; the weighted sums fit into unsigned 16 bits: */
+		__m128i lum=_mm_mullo_epi16(r,_mm_set1_epi16(77));
+		lum=_mm_add_epi16(lum,_mm_mullo_epi16(g,_mm_set1_epi16(150)));
+		lum=_mm_add_epi16(lum,_mm_mullo_epi16(b,_mm_set1_epi16(29)));
+		lum=_mm_srli_epi16(lum,8);
+		
+		/* Interleave the luminances with the alpha channel and store the result: */
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dPtr),_mm_or_si128(lum,_mm_slli_epi16(a,8)));
+		}
+	
+	/* Convert the remaining pixels one at a time: */
+	for(;numPixels>0;--numPixels,sPtr+=4,dPtr+=2)
+		{
+		dPtr[0]=calcLuminanceInt<unsigned char,unsigned short>(sPtr);
+		dPtr[1]=sPtr[3];
+		}
+	}
+
+#endif
+
+template <class ScalarParam,unsigned int numChannelsParam>
+class ToGreyFloatKernel:public ConversionKernel<ScalarParam> // Kernel to convert an RGB or RGBA image with floating-point components to luminance
+	{
+	/* Constructors and destructors: */
+	public:
+	ToGreyFloatKernel(const BaseImage& source,BaseImage& dest)
+		:ConversionKernel<ScalarParam>(source,dest)
+		{
+		}
+	
+	/* Methods: */
+	void processRows(unsigned int rowBegin,unsigned int rowEnd) const
 		{
-		/* Convert RGB to LUMINANCE: */
-		for(size_t i=size_t(source.getSize(0))*size_t(source.getSize(1));i>0;--i,sPtr+=3)
+		/* Convert all pixels to luminance and retain an existing alpha channel: */
+		const ScalarParam* sPtr=this->sPixels+size_t(rowBegin)*this->width*numChannelsParam;
+		ScalarParam* dPtr=this->dPixels+size_t(rowBegin)*this->width*(numChannelsParam-2);
+		for(size_t i=size_t(rowEnd-rowBegin)*this->width;i>0;--i,sPtr+=numChannelsParam,dPtr+=numChannelsParam-2)
 			{
 			/* Calculate pixel luminance: */
-			*(dPtr++)=ScalarParam((WeightParam(sPtr[0])*WeightParam(77)+WeightParam(sPtr[1])*WeightParam(150)+WeightParam(sPtr[2])*WeightParam(29))>>WeightParam(8));
+			dPtr[0]=sPtr[0]*ScalarParam(0.299)+sPtr[1]*ScalarParam(0.587)+sPtr[2]*ScalarParam(0.114);
+			
+			/* Copy an alpha channel: */
+			if(numChannelsParam==4)
+				dPtr[1]=sPtr[3];
 			}
 		}
+	};
+
+template <class ScalarParam,class WeightParam>
+inline
+void
+toGreyTypedInt(
+	const BaseImage& source,
+	BaseImage& dest)
+	{
+	/* Delegate to a kernel for the source's number of channels: */
+	if(source.getNumChannels()==4)
+		convertImage<ToGreyIntKernel<ScalarParam,WeightParam,4> >(source,dest);
+	else
+		convertImage<ToGreyIntKernel<ScalarParam,WeightParam,3> >(source,dest);
 	}
 
 template <class ScalarParam>
@@ -249,30 +495,11 @@ toGreyTypedFloat(
 	const BaseImage& source,
 	BaseImage& dest)
 	{
-	/* Convert all pixels to luminance and retain an existing alpha channel: */
-	const ScalarParam* sPtr=static_cast<const ScalarParam*>(source.getPixels());
-	ScalarParam* dPtr=static_cast<ScalarParam*>(dest.modifyPixels());
+	/* Delegate to a kernel for the source's number of channels: */
 	if(source.getNumChannels()==4)
-		{
-		/* Convert RGBA to LUMINANCE_ALPHA: */
-		for(size_t i=size_t(source.getSize(0))*size_t(source.getSize(1));i>0;--i,sPtr+=4)
-			{
-			/* Calculate pixel luminance: */
-			*(dPtr++)=sPtr[0]*ScalarParam(0.299)+sPtr[1]*ScalarParam(0.587)+sPtr[2]*ScalarParam(0.114);
-			
-			/* Copy alpha channel: */
-			*(dPtr++)=sPtr[3];
-			}
-		}
+		convertImage<ToGreyFloatKernel<ScalarParam,4> >(source,dest);
 	else
-		{
-		/* Convert RGB to LUMINANCE: */
-		for(size_t i=size_t(source.getSize(0))*size_t(source.getSize(1));i>0;--i,sPtr+=3)
-			{
-			/* Calculate pixel luminance: */
-			*(dPtr++)=sPtr[0]*ScalarParam(0.299)+sPtr[1]*ScalarParam(0.587)+sPtr[2]*ScalarParam(0.114);
-			}
-		}
+		convertImage<ToGreyFloatKernel<ScalarParam,3> >(source,dest);
 	}
 
 void toGreyImpl(const BaseImage& source,BaseImage& dest)
@@ -317,6 +544,36 @@ void toGreyImpl(const BaseImage& source,BaseImage& dest)
 		}
 	}
 
+template <class ScalarParam,unsigned int numChannelsParam>
+class ToRgbKernel:public ConversionKernel<ScalarParam> // Kernel to convert a luminance or luminance-alpha image to RGB
+	{
+	/* Constructors and destructors: */
+	public:
+	ToRgbKernel(const BaseImage& source,BaseImage& dest)
+		:ConversionKernel<ScalarParam>(source,dest)
+		{
+		}
+	
+	/* Methods: */
+	void processRows(unsigned int rowBegin,unsigned int rowEnd) const
+		{
+		/* Convert all pixels to RGB and retain an existing alpha channel: */
+		const ScalarParam* sPtr=this->sPixels+size_t(rowBegin)*this->width*numChannelsParam;
+		ScalarParam* dPtr=this->dPixels+size_t(rowBegin)*this->width*(numChannelsParam+2);
+		for(size_t i=size_t(rowEnd-rowBegin)*this->width;i>0;--i,sPtr+=numChannelsParam,dPtr+=numChannelsParam+2)
+			{
+			/* Copy pixel luminance: */
+			dPtr[0]=sPtr[0];
+			dPtr[1]=sPtr[0];
+			dPtr[2]=sPtr[0];
+			
+			/* Copy an alpha channel: */
+			if(numChannelsParam==2)
+				dPtr[3]=sPtr[1];
+			}
+		}
+	};
+
 template <class ScalarParam>
 inline
 void
@@ -324,34 +581,11 @@ toRgbTyped(
 	const BaseImage& source,
 	BaseImage& dest)
 	{
-	/* Convert all pixels to RGB and retain an existing alpha channel: */
-	const ScalarParam* sPtr=static_cast<const ScalarParam*>(source.getPixels());
-	ScalarParam* dPtr=static_cast<ScalarParam*>(dest.modifyPixels());
+	/* Delegate to a kernel for the source's number of channels: */
 	if(source.getNumChannels()==2)
-		{
-		/* Convert LUMINANCE_ALPHA to RGBA: */
-		for(size_t i=size_t(source.getSize(0))*size_t(source.getSize(1));i>0;--i,sPtr+=2)
-			{
-			/* Copy pixel luminance: */
-			*(dPtr++)=sPtr[0];
-			*(dPtr++)=sPtr[0];
-			*(dPtr++)=sPtr[0];
-			
-			/* Copy alpha channel: */
-			*(dPtr++)=sPtr[1];
-			}
-		}
+		convertImage<ToRgbKernel<ScalarParam,2> >(source,dest);
 	else
-		{
-		/* Convert LUMINANCE to RGB: */
-		for(size_t i=size_t(source.getSize(0))*size_t(source.getSize(1));i>0;--i,++sPtr)
-			{
-			/* Copy pixel luminance: */
-			*(dPtr++)=sPtr[0];
-			*(dPtr++)=sPtr[0];
-			*(dPtr++)=sPtr[0];
-			}
-		}
+		convertImage<ToRgbKernel<ScalarParam,1> >(source,dest);
 	}
 
 void toRgbImpl(const BaseImage& source,BaseImage& dest)
@@ -397,61 +631,251 @@ void toRgbImpl(const BaseImage& source,BaseImage& dest)
 	}
 
 template <class ScalarParam,class AccumParam>
+class IntAverager // Class to average pixel components of integer scalar types
+	{
+	/* Embedded classes: */
+	public:
+	typedef ScalarParam Scalar; // Type of pixel components
+	typedef AccumParam Accum; // Type to accumulate sums of up to nine pixel components
+	
+	/* Methods: */
+	static Scalar average4(Accum sum) // Returns the average of four components from their sum
+		{
+		return Scalar((sum+Accum(2))>>2);
+		}
+	static Scalar average(Accum sum,unsigned int numComponents) // Returns the average of the given number of components from their sum, rounded to nearest
+		{
+		Accum num=sum+Accum(numComponents/2);
+		Accum result=num/Accum(numComponents);
+		if(result*Accum(numComponents)>num) // Round towards negative infinity, like the shift in average4
+			--result;
+		return Scalar(result);
+		}
+	};
+
+template <class ScalarParam>
+class FloatAverager // Class to average pixel components of floating-point scalar types
+	{
+	/* Embedded classes: */
+	public:
+	typedef ScalarParam Scalar; // Type of pixel components
+	typedef ScalarParam Accum; // Type to accumulate sums of pixel components
+	
+	/* Methods: */
+	static Scalar average4(Accum sum) // Returns the average of four components from their sum
+		{
+		return sum*Scalar(0.25);
+		}
+	static Scalar average(Accum sum,unsigned int numComponents) // Returns the average of the given number of components from their sum
+		{
+		return sum/Scalar(numComponents);
+		}
+	};
+
+template <class AveragerParam,unsigned int numChannelsParam>
 inline
 void
-shrinkTypedInt(
-	const BaseImage& source,
-	BaseImage& dest)
+shrinkRow(
+	const typename AveragerParam::Scalar* s0Ptr,
+	const typename AveragerParam::Scalar* s1Ptr,
+	typename AveragerParam::Scalar* dPtr,
+	size_t numPixels)
+	{
+	typedef typename AveragerParam::Accum Accum;
+	
+	/* Average all blocks of 2x2 pixels in the source rows: */
+	for(;numPixels>0;--numPixels,s0Ptr+=numChannelsParam*2,s1Ptr+=numChannelsParam*2,dPtr+=numChannelsParam)
+		for(unsigned int i=0;i<numChannelsParam;++i)
+			{
+			Accum sum=Accum(s0Ptr[i])+Accum(s0Ptr[numChannelsParam+i]);
+			sum+=Accum(s1Ptr[i]);
+			sum+=Accum(s1Ptr[numChannelsParam+i]);
+			dPtr[i]=AveragerParam::average4(sum);
+			}
+	}
+
+#ifdef __SSE2__
+
+template <>
+inline
+void
+shrinkRow<IntAverager<unsigned char,unsigned short>,4>(
+	const unsigned char* s0Ptr,
+	const unsigned char* s1Ptr,
+	unsigned char* dPtr,
+	size_t numPixels)
 	{
-	/* Average all blocks of 2x2 pixels in the source image: */
-	unsigned int nc=source.getNumChannels();
-	const ScalarParam* sRow0Ptr=static_cast<const ScalarParam*>(source.getPixels());
-	const ptrdiff_t sStride=source.getSize(0)*nc;
-	const ScalarParam* sRow1Ptr=sRow0Ptr+sStride;
-	ScalarParam* dPtr=static_cast<ScalarParam*>(dest.modifyPixels());
-	for(unsigned int y=0;y<source.getSize(1);y+=2,sRow0Ptr+=sStride*2,sRow1Ptr+=sStride*2)
+	/* Average blocks of 2x2 RGBA pixels into four destination pixels at a time: */
+	const __m128i zero=_mm_setzero_si128();
+	const __m128i two=_mm_set1_epi16(2);
+	for(;numPixels>=4;numPixels-=4,s0Ptr+=32,s1Ptr+=32,dPtr+=16)
 		{
-		const ScalarParam* s0Ptr=sRow0Ptr;
-		const ScalarParam* s1Ptr=sRow1Ptr;
-		for(unsigned int x=0;x<source.getSize(0);x+=2,s0Ptr+=nc,s1Ptr+=nc)
+		__m128i result[2];
+		for(int i=0;i<2;++i)
 			{
-			for(unsigned int i=0;i<source.getNumChannels();++i,++s0Ptr,++s1Ptr,++dPtr)
-				{
-				/* Average the current 2x2 pixel block: */
-				AccumParam sum0=AccumParam(s0Ptr[0])+AccumParam(s0Ptr[nc]);
-				AccumParam sum1=AccumParam(s1Ptr[0])+AccumParam(s1Ptr[nc]);
-				*dPtr=ScalarParam((sum0+sum1+2)>>2);
-				}
+			/* Load four pixels from each source row and add them vertically: */
+			__m128i r0=_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0Ptr+i*16));
+			__m128i r1=_mm_loadu_si128(reinterpret_cast<const __m128i*>(s1Ptr+i*16));
+			__m128i lo=_mm_add_epi16(_mm_unpacklo_epi8(r0,zero),_mm_unpacklo_epi8(r1,zero));
+			__m128i hi=_mm_add_epi16(_mm_unpackhi_epi8(r0,zero),_mm_unpackhi_epi8(r1,zero));
+			
+			/* Add horizontally adjacent pixels and round: */
+			__m128i sum=_mm_add_epi16(_mm_unpacklo_epi64(lo,hi),_mm_unpackhi_epi64(lo,hi));
+			result[i]=_mm_srli_epi16(_mm_add_epi16(sum,two),2);
 			}
+		
+		/* Store the four averaged pixels: */
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dPtr),_mm_packus_epi16(result[0],result[1]));
 		}
+	
+	/* Average the remaining pixel blocks one at a time: */
+	for(;numPixels>0;--numPixels,s0Ptr+=8,s1Ptr+=8,dPtr+=4)
+		for(int i=0;i<4;++i)
+			dPtr[i]=(unsigned char)((int(s0Ptr[i])+int(s0Ptr[4+i])+int(s1Ptr[i])+int(s1Ptr[4+i])+2)>>2);
 	}
 
-template <class ScalarParam>
+template <>
 inline
 void
-shrinkTypedFloat(
-	const BaseImage& source,
-	BaseImage& dest)
+shrinkRow<IntAverager<unsigned char,unsigned short>,1>(
+	const unsigned char* s0Ptr,
+	const unsigned char* s1Ptr,
+	unsigned char* dPtr,
+	size_t numPixels)
+	{
+	/* Average blocks of 2x2 luminance pixels into eight destination pixels at a time: */
+	const __m128i lowByte=_mm_set1_epi16(0xff);
+	const __m128i two=_mm_set1_epi16(2);
+	for(;numPixels>=8;numPixels-=8,s0Ptr+=16,s1Ptr+=16,dPtr+=8)
+		{
+		/* Load sixteen pixels from each source row and add even and odd pixels separately: */
+		__m128i r0=_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0Ptr));
+		__m128i r1=_mm_loadu_si128(reinterpret_cast<const __m128i*>(s1Ptr));
+		__m128i even=_mm_add_epi16(_mm_and_si128(r0,lowByte),_mm_and_si128(r1,lowByte));
+		__m128i odd=_mm_add_epi16(_mm_srli_epi16(r0,8),_mm_srli_epi16(r1,8));
+		
+		/* Round and store the eight averaged pixels: */
+		__m128i result=_mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(even,odd),two),2);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dPtr),_mm_packus_epi16(result,result));
+		}
+	
+	/* Average the remaining pixel blocks one at a time: */
+	for(;numPixels>0;--numPixels,s0Ptr+=2,s1Ptr+=2,++dPtr)
+		*dPtr=(unsigned char)((int(s0Ptr[0])+int(s0Ptr[1])+int(s1Ptr[0])+int(s1Ptr[1])+2)>>2);
+	}
+
+#endif
+
+template <class AveragerParam,unsigned int numChannelsParam>
+class ShrinkKernel // Kernel to downsample an image by a factor of two using a box filter
 	{
-	/* Average all blocks of 2x2 pixels in the source image: */
-	unsigned int nc=source.getNumChannels();
-	const ScalarParam* sRow0Ptr=static_cast<const ScalarParam*>(source.getPixels());
-	const ptrdiff_t sStride=source.getSize(0)*nc;
-	const ScalarParam* sRow1Ptr=sRow0Ptr+sStride;
-	ScalarParam* dPtr=static_cast<ScalarParam*>(dest.modifyPixels());
-	for(unsigned int y=0;y<source.getSize(1);y+=2,sRow0Ptr+=sStride*2,sRow1Ptr+=sStride*2)
+	/* Embedded classes: */
+	private:
+	typedef typename AveragerParam::Scalar Scalar;
+	typedef typename AveragerParam::Accum Accum;
+	
+	/* Elements: */
+	private:
+	unsigned int sSize[2]; // Source image size
+	unsigned int dSize[2]; // Destination image size
+	const Scalar* sPixels; // Source image's pixel array
+	Scalar* dPixels; // Destination image's pixel array
+	
+	/* Private methods: */
+	void averageBlock(const Scalar* sPtr,unsigned int numCols,unsigned int numRows,Scalar* dPtr) const // Averages a block of source pixels into a single destination pixel
+		{
+		ptrdiff_t sStride=ptrdiff_t(sSize[0])*numChannelsParam;
+		for(unsigned int i=0;i<numChannelsParam;++i)
+			{
+			Accum sum(0);
+			for(unsigned int y=0;y<numRows;++y)
+				for(unsigned int x=0;x<numCols;++x)
+					sum+=Accum(sPtr[y*sStride+x*numChannelsParam+i]);
+			dPtr[i]=AveragerParam::average(sum,numRows*numCols);
+			}
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	ShrinkKernel(const BaseImage& source,BaseImage& dest)
+		:sPixels(static_cast<const Scalar*>(source.getPixels())),
+		 dPixels(static_cast<Scalar*>(dest.modifyPixels()))
+		{
+		for(int i=0;i<2;++i)
+			{
+			sSize[i]=source.getSize(i);
+			dSize[i]=dest.getSize(i);
+			}
+		}
+	
+	/* Methods: */
+	void processRows(unsigned int rowBegin,unsigned int rowEnd) const
 		{
-		const ScalarParam* s0Ptr=sRow0Ptr;
-		const ScalarParam* s1Ptr=sRow1Ptr;
-		for(unsigned int x=0;x<source.getSize(0);x+=2,s0Ptr+=nc,s1Ptr+=nc)
+		/*******************************************************************
+		Each destination pixel averages a block of 2x2 source pixels. Along
+		an odd image dimension, the last destination pixel averages the last
+		three source pixels instead, and a dimension of size one is retained.
+		*******************************************************************/
+		
+		ptrdiff_t sStride=ptrdiff_t(sSize[0])*numChannelsParam;
+		ptrdiff_t dStride=ptrdiff_t(dSize[0])*numChannelsParam;
+		unsigned int numRegularCols=sSize[0]>1?sSize[0]/2-sSize[0]%2:0;
+		for(unsigned int y=rowBegin;y<rowEnd;++y)
 			{
-			for(unsigned int i=0;i<source.getNumChannels();++i,++s0Ptr,++s1Ptr,++dPtr)
+			const Scalar* sRowPtr=sPixels+ptrdiff_t(y)*2*sStride;
+			Scalar* dRowPtr=dPixels+ptrdiff_t(y)*dStride;
+			
+			/* Determine the number of source rows contributing to this destination row: */
+			unsigned int numRows=sSize[1]==1?1:y==dSize[1]-1&&sSize[1]%2!=0?3:2;
+			
+			/* Average the regular 2x2 pixel blocks: */
+			unsigned int x=0;
+			if(numRows==2)
+				{
+				shrinkRow<AveragerParam,numChannelsParam>(sRowPtr,sRowPtr+sStride,dRowPtr,numRegularCols);
+				x=numRegularCols;
+				}
+			
+			/* Average the remaining irregular pixel blocks: */
+			for(;x<dSize[0];++x)
 				{
-				/* Average the current 2x2 pixel block: */
-				*dPtr=(s0Ptr[0]+s0Ptr[nc]+s1Ptr[0]+s1Ptr[nc])*ScalarParam(0.25);
+				unsigned int numCols=sSize[0]==1?1:x==dSize[0]-1&&sSize[0]%2!=0?3:2;
+				averageBlock(sRowPtr+ptrdiff_t(x)*2*numChannelsParam,numCols,numRows,dRowPtr+ptrdiff_t(x)*numChannelsParam);
 				}
 			}
 		}
+	};
+
+template <class AveragerParam>
+inline
+void
+shrinkTyped(
+	const BaseImage& source,
+	BaseImage& dest)
+	{
+	/* Delegate to a kernel for the image's number of channels: */
+	size_t sourceComponents=size_t(source.getWidth())*size_t(source.getNumChannels())*2;
+	switch(source.getNumChannels())
+		{
+		case 1:
+			processRows(ShrinkKernel<AveragerParam,1>(source,dest),dest.getHeight(),sourceComponents);
+			break;
+		
+		case 2:
+			processRows(ShrinkKernel<AveragerParam,2>(source,dest),dest.getHeight(),sourceComponents);
+			break;
+		
+		case 3:
+			processRows(ShrinkKernel<AveragerParam,3>(source,dest),dest.getHeight(),sourceComponents);
+			break;
+		
+		case 4:
+			processRows(ShrinkKernel<AveragerParam,4>(source,dest),dest.getHeight(),sourceComponents);
+			break;
+		
+		default:
+			throw std::runtime_error("Images::BaseImage::shrink: Image has unsupported number of channels");
+		}
 	}
 
 /***************************************************************************
@@ -776,6 +1200,23 @@ BaseImage::BaseImage(IO::File& imageFile)
 		}
 	}
 
+unsigned int BaseImage::getNumProcessingThreads(void)
+	{
+	/* Default to the number of online CPUs on first use: */
+	if(numProcessingThreads==0)
+		{
+		long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+		numProcessingThreads=numCpus>1?(unsigned int)numCpus:1U;
+		}
+	
+	return numProcessingThreads;
+	}
+
+void BaseImage::setNumProcessingThreads(unsigned int newNumProcessingThreads)
+	{
+	numProcessingThreads=newNumProcessingThreads;
+	}
+
 void BaseImage::write(IO::File& imageFile) const
 	{
 	/* Write the image's format: */
@@ -941,46 +1382,42 @@ BaseImage BaseImage::toRgb(void) const
 
 BaseImage BaseImage::shrink(void) const
 	{
-	/* Check that the image's size is even: */
-	if(rep->size[0]%2!=0||rep->size[1]%2!=0)
-		throw std::runtime_error("Images::BaseImage::shrink: Image size is not divisible by two");
-	
 	/* Create a reduced-sized image with the same pixel format: */
-	BaseImage result(rep->size[0]/2,rep->size[1]/2,rep->numChannels,rep->channelSize,rep->format,rep->scalarType);
+	BaseImage result(rep->size[0]>1?rep->size[0]/2:1,rep->size[1]>1?rep->size[1]/2:1,rep->numChannels,rep->channelSize,rep->format,rep->scalarType);
 	
 	/* Delegate to a typed version of this function: */
 	switch(rep->scalarType)
 		{
 		case GL_BYTE:
-			shrinkTypedInt<signed char,signed short>(*this,result);
+			shrinkTyped<IntAverager<signed char,signed short> >(*this,result);
 			break;
 		
 		case GL_UNSIGNED_BYTE:
-			shrinkTypedInt<unsigned char,unsigned short>(*this,result);
+			shrinkTyped<IntAverager<unsigned char,unsigned short> >(*this,result);
 			break;
 		
 		case GL_SHORT:
-			shrinkTypedInt<signed short,signed int>(*this,result);
+			shrinkTyped<IntAverager<signed short,signed int> >(*this,result);
 			break;
 		
 		case GL_UNSIGNED_SHORT:
-			shrinkTypedInt<unsigned short,unsigned int>(*this,result);
+			shrinkTyped<IntAverager<unsigned short,unsigned int> >(*this,result);
 			break;
 		
 		case GL_INT:
-			shrinkTypedInt<signed int,signed long>(*this,result);
+			shrinkTyped<IntAverager<signed int,signed long> >(*this,result);
 			break;
 		
 		case GL_UNSIGNED_INT:
-			shrinkTypedInt<unsigned int,unsigned long>(*this,result);
+			shrinkTyped<IntAverager<unsigned int,unsigned long> >(*this,result);
 			break;
 		
 		case GL_FLOAT:
-			shrinkTypedFloat<float>(*this,result);
+			shrinkTyped<FloatAverager<float> >(*this,result);
 			break;
 		
 		case GL_DOUBLE:
-			shrinkTypedFloat<double>(*this,result);
+			shrinkTyped<FloatAverager<double> >(*this,result);
 			break;
 		
 		default:
@@ -1100,8 +1537,10 @@ void BaseImage::glTexImage2DMipmap(GLenum target,GLint internalFormat,bool padIm
 			level.glTexImage2D(target,levelIndex,internalFormat,padImageSize);
 			++levelIndex;
 			
-			/* Bail out if we can't shrink further: */
-			if(level.getSize(0)%2!=0||level.getSize(1)%2!=0)
+			/* Bail out if the mipmap is complete, or if padded level sizes would no longer halve exactly: */
+			if(level.getSize(0)==1&&level.getSize(1)==1)
+				break;
+			if(padImageSize&&(level.getSize(0)%2!=0||level.getSize(1)%2!=0))
 				break;
 			
 			/* Downsample the current level image: */
@@ -198,7 +198,9 @@ class BaseImage
 	BaseImage addAlpha(double alpha) const; // Returns a new image with an alpha channel of the given alpha value in [0, 1] added; returns itself without changing the alpha channel if there is already one
 	BaseImage toGrey(void) const; // Returns a new image representing this image's luminance; returns itself if the image is already greyscale; retains existing alpha channel
 	BaseImage toRgb(void) const; // Returns a new image representing this greyscale image in RGB color space; returns itself if the image is already RGB; retains existing alpha channel
-	BaseImage shrink(void) const; // Returns a version of this image downsampled by a factor of two (for mipmap generation); assumes size of image is even in both directions
+	BaseImage shrink(void) const; // Returns a version of this image downsampled by a factor of two using a box filter (for mipmap generation); the last pixel along an odd dimension averages three source pixels, and dimensions of size one are retained
+	static unsigned int getNumProcessingThreads(void); // Returns the maximum number of threads used by the basic image processing methods on large images
+	static void setNumProcessingThreads(unsigned int newNumProcessingThreads); // Sets the maximum number of threads used by the basic image processing methods on large images; 0 selects the number of online CPUs
 	
 	/* OpenGL interface methods: */
 	GLenum getInternalFormat(void) const; // Returns an internal OpenGL texture format compatible with this image
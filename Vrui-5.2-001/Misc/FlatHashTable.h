@@ -0,0 +1,450 @@
+/***********************************************************************
+FlatHashTable - Class for storing and finding values (open addressing
+version using Robin Hood linear probing in a flat array of entries).
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Miscellaneous Support Library (Misc).
+
+The Miscellaneous Support Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Miscellaneous Support Library is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Miscellaneous Support Library; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef MISC_FLATHASHTABLE_INCLUDED
+#define MISC_FLATHASHTABLE_INCLUDED
+
+#include <stddef.h>
+#include <Misc/StandardHashFunction.h>
+#include <Misc/HashTable.h>
+
+namespace Misc {
+
+/***********************************************************************
+Usage prerequisites:
+- class Source must provide operator!= and a default constructor
+- class Dest must provide a default constructor
+- class HashFunction must provide static size_t rawHash(const Source&
+  source)
+Unlike HashTable, FlatHashTable moves entries around when other entries
+are inserted or removed. Inserting or removing entries invalidates all
+iterators and entry references.
+***********************************************************************/
+
+template <class Source,class Dest,class HashFunction =StandardHashFunction<Source> >
+class FlatHashTable
+	{
+	/* Embedded classes: */
+	public:
+	typedef HashTableEntry<Source,Dest> Entry; // Type for hash table entries
+	typedef typename HashTable<Source,Dest,HashFunction>::EntryNotFoundError EntryNotFoundError; // Class for exceptions when requested hash table entry does not exist
+	
+	private:
+	class Slot:public Entry // Class for slots in the flat entry array
+		{
+		/* Elements: */
+		public:
+		size_t probeLength; // One plus distance of the slot from its entry's home slot, or zero if the slot is empty
+		
+		/* Constructors and destructors: */
+		Slot(void) // Creates an empty slot
+			:Entry(Source()),probeLength(0)
+			{
+			}
+		
+		/* Methods: */
+		void setEntry(const Entry& source) // Copies a hash table entry into the slot
+			{
+			Entry::operator=(source);
+			}
+		};
+	
+	public:
+	class Iterator
+		{
+		friend class FlatHashTable;
+		
+		/* Elements: */
+		private:
+		FlatHashTable* table; // Pointer to table this iterator is pointing into
+		size_t slotIndex; // Index of current slot
+		
+		/* Constructors and destructors: */
+		public:
+		Iterator(void) // Creates invalid iterator
+			:table(0),slotIndex(0)
+			{
+			}
+		private:
+		Iterator(FlatHashTable* sTable,size_t sSlotIndex) // Creates iterator to first used slot at or after the given slot index
+			:table(sTable),slotIndex(sSlotIndex)
+			{
+			while(slotIndex<table->tableSize&&table->slots[slotIndex].probeLength==0)
+				++slotIndex;
+			}
+		
+		/* Methods: */
+		public:
+		bool isFinished(void) const
+			{
+			return slotIndex>=table->tableSize;
+			}
+		friend bool operator==(const Iterator& it1,const Iterator& it2)
+			{
+			return it1.slotIndex==it2.slotIndex;
+			}
+		friend bool operator!=(const Iterator& it1,const Iterator& it2)
+			{
+			return it1.slotIndex!=it2.slotIndex;
+			}
+		Entry& operator*(void) const
+			{
+			return table->slots[slotIndex];
+			}
+		Entry* operator->(void) const
+			{
+			return table->slots+slotIndex;
+			}
+		Iterator& operator++(void)
+			{
+			/* Go to the next used slot: */
+			do
+				{
+				++slotIndex;
+				}
+			while(slotIndex<table->tableSize&&table->slots[slotIndex].probeLength==0);
+			return *this;
+			}
+		};
+	
+	class ConstIterator
+		{
+		friend class FlatHashTable;
+		
+		/* Elements: */
+		private:
+		const FlatHashTable* table; // Pointer to table this iterator is pointing into
+		size_t slotIndex; // Index of current slot
+		
+		/* Constructors and destructors: */
+		public:
+		ConstIterator(void) // Creates invalid iterator
+			:table(0),slotIndex(0)
+			{
+			}
+		private:
+		ConstIterator(const FlatHashTable* sTable,size_t sSlotIndex) // Creates iterator to first used slot at or after the given slot index
+			:table(sTable),slotIndex(sSlotIndex)
+			{
+			while(slotIndex<table->tableSize&&table->slots[slotIndex].probeLength==0)
+				++slotIndex;
+			}
+		
+		/* Methods: */
+		public:
+		bool isFinished(void) const
+			{
+			return slotIndex>=table->tableSize;
+			}
+		friend bool operator==(const ConstIterator& it1,const ConstIterator& it2)
+			{
+			return it1.slotIndex==it2.slotIndex;
+			}
+		friend bool operator!=(const ConstIterator& it1,const ConstIterator& it2)
+			{
+			return it1.slotIndex!=it2.slotIndex;
+			}
+		const Entry& operator*(void) const
+			{
+			return table->slots[slotIndex];
+			}
+		const Entry* operator->(void) const
+			{
+			return table->slots+slotIndex;
+			}
+		ConstIterator& operator++(void)
+			{
+			/* Go to the next used slot: */
+			do
+				{
+				++slotIndex;
+				}
+			while(slotIndex<table->tableSize&&table->slots[slotIndex].probeLength==0);
+			return *this;
+			}
+		};
+	
+	friend class Iterator;
+	friend class ConstIterator;
+	
+	/* Elements: */
+	private:
+	size_t tableSize; // Current table size, always a power of two
+	int hashShift; // Number of bits by which scrambled raw hash values are shifted to get slot indices
+	float waterMark; // Maximum table usage ratio
+	float growRate; // Rate the table grows at
+	Slot* slots; // Flat array of slots
+	size_t usedEntries; // Number of entries currently used
+	size_t maxEntries; // Maximum number of entries at current table size
+	
+	/* Private methods: */
+	void calcTableSize(size_t requestedTableSize) // Sets the table size to the smallest power of two not smaller than the requested size
+		{
+		tableSize=8;
+		hashShift=sizeof(size_t)*8-3;
+		while(tableSize<requestedTableSize)
+			{
+			tableSize<<=1;
+			--hashShift;
+			}
+		
+		/* Always keep at least one slot empty to terminate probe sequences: */
+		maxEntries=(size_t)(tableSize*waterMark);
+		if(maxEntries>=tableSize)
+			maxEntries=tableSize-1;
+		}
+	size_t getHomeSlot(const Source& source) const // Returns the index of the slot where the given source would ideally be stored
+		{
+		/* Scramble the raw hash value by Fibonacci hashing and use its most significant bits, which depend on all bits of the raw hash value: */
+		return (HashFunction::rawHash(source)*size_t(sizeof(size_t)>4?0x9e3779b97f4a7c15ULL:0x9e3779b9UL))>>hashShift;
+		}
+	size_t findSlot(const Source& findSource) const // Returns the index of the slot containing the given source, or tableSize if the source is not in the table
+		{
+		/* Probe slots starting from the source's home slot: */
+		size_t index=getHomeSlot(findSource);
+		for(size_t probeLength=1;probeLength<=slots[index].probeLength;++probeLength)
+			{
+			/* Check if the slot contains the searched source: */
+			if(!(slots[index].getSource()!=findSource))
+				return index;
+			
+			/* Go to the next slot: */
+			index=(index+1)&(tableSize-1);
+			}
+		
+		/* A slot that is empty or closer to its own home slot than the searched source would be means the source is not in the table: */
+		return tableSize;
+		}
+	void insertNewEntry(const Entry& newEntry,size_t index,size_t probeLength) // Inserts an entry not already in the table, starting at the given slot and probe length
+		{
+		/* Find the first empty slot, displacing entries that are closer to their home slots than the carried entry along the way: */
+		Slot carried;
+		carried.setEntry(newEntry);
+		carried.probeLength=probeLength;
+		while(slots[index].probeLength!=0)
+			{
+			if(slots[index].probeLength<carried.probeLength)
+				{
+				/* Swap the carried entry with the slot's entry: */
+				Slot temp=slots[index];
+				slots[index]=carried;
+				carried=temp;
+				}
+			
+			/* Go to the next slot: */
+			index=(index+1)&(tableSize-1);
+			++carried.probeLength;
+			}
+		slots[index]=carried;
+		}
+	size_t findOrInsertSlot(const Entry& newEntry,bool& found) // Returns the index of the slot containing the given entry's source; inserts the given entry if the source is not in the table
+		{
+		/* Grow the table first if necessary, so that a newly inserted entry does not move afterwards: */
+		if(usedEntries>=maxEntries)
+			growTable((size_t)(tableSize*growRate)+1);
+		
+		/* Probe slots starting from the source's home slot until the source, an empty slot, or a slot closer to its home slot is found: */
+		size_t index=getHomeSlot(newEntry.getSource());
+		size_t probeLength=1;
+		for(;probeLength<=slots[index].probeLength;++probeLength)
+			{
+			/* Check if the slot contains the searched source: */
+			if(!(slots[index].getSource()!=newEntry.getSource()))
+				{
+				found=true;
+				return index;
+				}
+			
+			/* Go to the next slot: */
+			index=(index+1)&(tableSize-1);
+			}
+		
+		/* Insert the new entry into the slot: */
+		insertNewEntry(newEntry,index,probeLength);
+		++usedEntries;
+		found=false;
+		
+		return index;
+		}
+	void removeSlot(size_t index) // Removes the entry in the given used slot
+		{
+		/* Shift all following entries that are not in their home slots back by one slot: */
+		size_t next=(index+1)&(tableSize-1);
+		while(slots[next].probeLength>1)
+			{
+			slots[index]=slots[next];
+			--slots[index].probeLength;
+			index=next;
+			next=(index+1)&(tableSize-1);
+			}
+		
+		/* Clear the last shifted slot to release the entry's resources: */
+		slots[index]=Slot();
+		--usedEntries;
+		}
+	void growTable(size_t newTableSize) // Grows the table without deleting current entries
+		{
+		/* Allocate new slots: */
+		Slot* oldSlots=slots;
+		size_t oldTableSize=tableSize;
+		calcTableSize(newTableSize);
+		slots=new Slot[tableSize];
+		
+		/* Move all entries to the new table: */
+		for(size_t i=0;i<oldTableSize;++i)
+			if(oldSlots[i].probeLength!=0)
+				insertNewEntry(oldSlots[i],getHomeSlot(oldSlots[i].getSource()),1);
+		
+		/* Delete the old slots: */
+		delete[] oldSlots;
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	FlatHashTable(size_t sTableSize,float sWaterMark =0.9f,float sGrowRate =1.7312543)
+		:waterMark(sWaterMark),growRate(sGrowRate),
+		 slots(0),
+		 usedEntries(0)
+		{
+		/* Allocate the initial slots: */
+		calcTableSize(sTableSize);
+		slots=new Slot[tableSize];
+		}
+	private:
+	FlatHashTable(const FlatHashTable& source); // Prohibit copy constructor
+	FlatHashTable& operator=(const FlatHashTable& source); // Prohibit assignment operator
+	public:
+	~FlatHashTable(void)
+		{
+		delete[] slots;
+		}
+	
+	/* Methods: */
+	void setTableSize(size_t newTableSize)
+		{
+		/* Never shrink the table below what is needed to hold the current entries: */
+		if(size_t(newTableSize*waterMark)<usedEntries)
+			newTableSize=size_t(usedEntries/waterMark)+1;
+		growTable(newTableSize);
+		}
+	void clear(void)
+		{
+		/* Empty all slots: */
+		for(size_t i=0;i<tableSize;++i)
+			slots[i]=Slot();
+		
+		usedEntries=0;
+		}
+	size_t getNumEntries(void) const // Returns the number of entries currently in the hash table
+		{
+		return usedEntries;
+		}
+	bool setEntry(const Entry& newEntry)
+		{
+		/* Find the entry's slot or insert the new entry: */
+		bool found;
+		size_t index=findOrInsertSlot(newEntry,found);
+		if(found)
+			{
+			/* Set value of existing entry: */
+			slots[index].setEntry(newEntry);
+			}
+		
+		return found;
+		}
+	void removeEntry(const Source& findSource) // Removes entry
+		{
+		size_t index=findSlot(findSource);
+		if(index<tableSize)
+			removeSlot(index);
+		}
+	bool isEntry(const Source& findSource) const
+		{
+		return findSlot(findSource)<tableSize;
+		}
+	bool isEntry(const Entry& entry) const // Wrapper for isEntry function
+		{
+		return isEntry(entry.getSource());
+		}
+	const Entry& getEntry(const Source& findSource) const // Returns reference to entry; throws exception if entry is not found
+		{
+		size_t index=findSlot(findSource);
+		
+		/* Throw an exception if the requested entry does not exist: */
+		if(index>=tableSize)
+			throw EntryNotFoundError(findSource);
+		
+		return slots[index];
+		}
+	Entry& getEntry(const Source& findSource) // Ditto
+		{
+		size_t index=findSlot(findSource);
+		
+		/* Throw an exception if the requested entry does not exist: */
+		if(index>=tableSize)
+			throw EntryNotFoundError(findSource);
+		
+		return slots[index];
+		}
+	Entry& operator[](const Source& source) // Returns reference to entry; inserts new entry if source is not found
+		{
+		/* Find the entry's slot or insert a new entry with default destination: */
+		bool found;
+		size_t index=findOrInsertSlot(Entry(source),found);
+		
+		return slots[index];
+		}
+	Iterator begin(void)
+		{
+		return Iterator(this,0); // Create iterator to first entry
+		}
+	ConstIterator begin(void) const
+		{
+		return ConstIterator(this,0); // Create iterator to first entry
+		}
+	Iterator end(void)
+		{
+		return Iterator(this,tableSize); // Create iterator past end of table
+		}
+	ConstIterator end(void) const
+		{
+		return ConstIterator(this,tableSize); // Create iterator past end of table
+		}
+	Iterator findEntry(const Source& findSource)
+		{
+		return Iterator(this,findSlot(findSource));
+		}
+	ConstIterator findEntry(const Source& findSource) const
+		{
+		return ConstIterator(this,findSlot(findSource));
+		}
+	void removeEntry(const Iterator& it) // Removes entry pointed to by iterator
+		{
+		if(it.table==this&&it.slotIndex<tableSize&&slots[it.slotIndex].probeLength!=0)
+			removeSlot(it.slotIndex);
+		}
+	};
+
+}
+
+#endif
@@ -23,5 +23,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define SCENEGRAPH_INTERNAL_CONFIG_INCLUDED
 
 #define SCENEGRAPH_CONFIG_DOOM3MATERIALMANAGER_SHADERDIR "/usr/local/share/Vrui-5.2/Shaders/SceneGraph"
+#define SCENEGRAPH_CONFIG_MESHFILECACHEDIR ".cache/Vrui-5.2/MeshFiles"
 
 #endif
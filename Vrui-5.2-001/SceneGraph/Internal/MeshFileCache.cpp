@@ -0,0 +1,577 @@
+/***********************************************************************
+MeshFileCache - Helper class to store the shapes read from a mesh file
+in a binary cache file that can be memory-mapped and restored quickly
+the next time the same unchanged mesh file is loaded.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <SceneGraph/Internal/MeshFileCache.h>
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include <Misc/StringPrintf.h>
+#include <Misc/FileTests.h>
+#include <IO/File.h>
+#include <IO/OpenFile.h>
+#include <IO/Directory.h>
+#include <IO/StandardDirectory.h>
+#include <IO/MemMappedFile.h>
+#include <SceneGraph/TextureCoordinateNode.h>
+#include <SceneGraph/ColorNode.h>
+#include <SceneGraph/NormalNode.h>
+#include <SceneGraph/CoordinateNode.h>
+#include <SceneGraph/IndexedFaceSetNode.h>
+#include <SceneGraph/PointSetNode.h>
+#include <SceneGraph/AppearanceNode.h>
+#include <SceneGraph/MaterialLibraryNode.h>
+#include <SceneGraph/ShapeNode.h>
+#include <SceneGraph/MeshFileNode.h>
+#include <SceneGraph/Internal/Config.h>
+#include <SceneGraph/Internal/ReadMtlFile.h>
+
+namespace SceneGraph {
+
+namespace {
+
+/*******************************************
+Constants describing the cache file format:
+*******************************************/
+
+const char cacheFileMagic[16]="VruiMeshCache2\n"; // Identifier at the beginning of each cache file; version 2 stores nanosecond modification times
+const Misc::UInt32 cacheFileEndiannessMarker=0x01020304U; // Marker to detect cache files written on hosts of different endianness
+
+enum PropertyType // Enumerated type for vertex property arrays stored in cache files
+	{
+	TEXCOORDS=0,COLORS,NORMALS,COORDS,NUM_PROPERTYTYPES
+	};
+
+enum GeometryType // Enumerated type for geometry nodes stored in cache files
+	{
+	INDEXEDFACESET=0,POINTSET
+	};
+
+/***************
+Helper classes:
+***************/
+
+class CacheFileReader // Helper class to read data from a memory-mapped cache file with bounds checking
+	{
+	/* Elements: */
+	private:
+	const char* ptr; // Current read position
+	const char* end; // End of the cache file's memory
+	
+	/* Constructors and destructors: */
+	public:
+	CacheFileReader(const void* memory,size_t size)
+		:ptr(static_cast<const char*>(memory)),end(static_cast<const char*>(memory)+size)
+		{
+		}
+	
+	/* Methods: */
+	void read(void* data,size_t dataSize) // Reads a block of raw data
+		{
+		if(dataSize>size_t(end-ptr))
+			throw std::runtime_error("Truncated cache file");
+		memcpy(data,ptr,dataSize);
+		ptr+=dataSize;
+		}
+	template <class ValueParam>
+	ValueParam read(void) // Reads a single value
+		{
+		ValueParam result;
+		read(&result,sizeof(ValueParam));
+		return result;
+		}
+	std::string readString(void) // Reads a string
+		{
+		Misc::UInt32 length=read<Misc::UInt32>();
+		if(length>size_t(end-ptr))
+			throw std::runtime_error("Truncated cache file");
+		std::string result(ptr,ptr+length);
+		ptr+=length;
+		return result;
+		}
+	template <class ValueParam>
+	void readList(std::vector<ValueParam>& list) // Reads a list of values
+		{
+		Misc::UInt64 numValues=read<Misc::UInt64>();
+		if(numValues>Misc::UInt64(end-ptr)/sizeof(ValueParam))
+			throw std::runtime_error("Truncated cache file");
+		list.resize(numValues);
+		if(numValues>0)
+			read(&list[0],numValues*sizeof(ValueParam));
+		}
+	bool eof(void) const // Returns true if the entire cache file has been read
+		{
+		return ptr==end;
+		}
+	};
+
+struct PropertyArray // Structure referencing a vertex property node shared by one or more shapes
+	{
+	/* Elements: */
+	public:
+	PropertyType type; // Type of the property node
+	const Node* node; // Pointer to the property node
+	};
+
+/*****************
+Helper functions:
+*****************/
+
+void writeString(IO::File& file,const std::string& string)
+	{
+	file.write<Misc::UInt32>(Misc::UInt32(string.size()));
+	file.write(string.data(),string.size());
+	}
+
+template <class ValueParam>
+void writeList(IO::File& file,const std::vector<ValueParam>& list)
+	{
+	file.write<Misc::UInt64>(Misc::UInt64(list.size()));
+	if(!list.empty())
+		file.writeRaw(&list[0],list.size()*sizeof(ValueParam));
+	}
+
+int findPropertyArray(std::vector<PropertyArray>& arrays,PropertyType type,const Node* node) // Returns the index of the given property node in the given list, adding it if necessary; returns -1 for null pointers
+	{
+	if(node==0)
+		return -1;
+	
+	/* Check if the node is already in the list: */
+	for(std::vector<PropertyArray>::iterator aIt=arrays.begin();aIt!=arrays.end();++aIt)
+		if(aIt->node==node)
+			return int(aIt-arrays.begin());
+	
+	/* Add the node to the list: */
+	PropertyArray newArray;
+	newArray.type=type;
+	newArray.node=node;
+	arrays.push_back(newArray);
+	return int(arrays.size())-1;
+	}
+
+template <class PropertyNodeParam>
+Misc::Autopointer<PropertyNodeParam> getPropertyNode(const std::vector<NodePointer>& arrays,Misc::SInt32 index) // Returns the property node of the given index and type, or null if the index is -1
+	{
+	if(index<0)
+		return 0;
+	if(size_t(index)>=arrays.size())
+		throw std::runtime_error("Invalid property array index");
+	Misc::Autopointer<PropertyNodeParam> result=arrays[index];
+	if(result==0)
+		throw std::runtime_error("Mismatching property array type");
+	return result;
+	}
+
+bool createDirectories(const std::string& path) // Creates the given directory and all its missing parent directories
+	{
+	for(std::string::size_type slashPos=path.find('/',1);true;slashPos=path.find('/',slashPos+1))
+		{
+		std::string prefix(path,0,slashPos);
+		if(mkdir(prefix.c_str(),S_IRWXU|S_IRWXG|S_IRWXO)!=0&&errno!=EEXIST)
+			return false;
+		if(slashPos==std::string::npos)
+			break;
+		}
+	
+	return true;
+	}
+
+}
+
+/*******************************
+Methods of class MeshFileCache:
+*******************************/
+
+MeshFileCache::MeshFileCache(const IO::Directory& directory,const std::string& fileName)
+	:meshFileName(fileName),meshFileSize(0),meshFileTime(0)
+	{
+	/* Only mesh files in the local file system can be cached: */
+	if(dynamic_cast<const IO::StandardDirectory*>(&directory)==0)
+		return;
+	
+	/* Place cache files in the user's home directory: */
+	const char* home=getenv("HOME");
+	if(home==0||home[0]=='\0')
+		return;
+	
+	/* Get the mesh file's absolute path, size, and modification time: */
+	try
+		{
+		meshFilePath=directory.getPath(fileName.c_str());
+		}
+	catch(const std::runtime_error&)
+		{
+		return;
+		}
+	struct stat meshFileStats;
+	if(stat(meshFilePath.c_str(),&meshFileStats)!=0||!S_ISREG(meshFileStats.st_mode))
+		return;
+	meshFileSize=Misc::UInt64(meshFileStats.st_size);
+	#ifdef __APPLE__
+	meshFileTime=Misc::SInt64(meshFileStats.st_mtimespec.tv_sec)*1000000000LL+Misc::SInt64(meshFileStats.st_mtimespec.tv_nsec);
+	#else
+	meshFileTime=Misc::SInt64(meshFileStats.st_mtim.tv_sec)*1000000000LL+Misc::SInt64(meshFileStats.st_mtim.tv_nsec);
+	#endif
+	
+	/* Name the cache file after a hash of the mesh file's absolute path: */
+	Misc::UInt64 pathHash=0xcbf29ce484222325ULL;
+	for(std::string::const_iterator pIt=meshFilePath.begin();pIt!=meshFilePath.end();++pIt)
+		{
+		pathHash^=Misc::UInt64((unsigned char)(*pIt));
+		pathHash*=0x100000001b3ULL;
+		}
+	cacheFileName=Misc::stringPrintf("%s/%s/%016llx.cache",home,SCENEGRAPH_CONFIG_MESHFILECACHEDIR,(unsigned long long)pathHash);
+	}
+
+void MeshFileCache::addMaterialLibrary(const std::string& materialLibraryFileName)
+	{
+	materialLibraryFileNames.push_back(materialLibraryFileName);
+	}
+
+void MeshFileCache::addShapeMaterial(const char* materialName)
+	{
+	ShapeMaterial sm;
+	sm.useDefault=materialName==0;
+	if(materialName!=0)
+		sm.materialName=materialName;
+	shapeMaterials.push_back(sm);
+	}
+
+bool MeshFileCache::load(const IO::Directory& directory,MeshFileNode& node) const
+	{
+	/* Bail out if the mesh file can not be cached or there is no cache file: */
+	if(cacheFileName.empty()||!Misc::isPathFile(cacheFileName.c_str()))
+		return false;
+	
+	std::vector<ShapeNodePointer> shapes;
+	try
+		{
+		/* Memory-map the cache file: */
+		IO::MemMappedFile cacheFile(cacheFileName.c_str());
+		CacheFileReader cache(cacheFile.getMemory(),cacheFile.getSize());
+		
+		/* Check that the cache file is compatible and up-to-date: */
+		char magic[sizeof(cacheFileMagic)];
+		cache.read(magic,sizeof(magic));
+		if(memcmp(magic,cacheFileMagic,sizeof(magic))!=0||cache.read<Misc::UInt32>()!=cacheFileEndiannessMarker)
+			return false;
+		if(cache.read<Misc::UInt32>()!=sizeof(Point)||cache.read<Misc::UInt32>()!=sizeof(Color)||cache.read<Misc::UInt32>()!=sizeof(TexCoord))
+			return false;
+		if(cache.read<Misc::UInt64>()!=meshFileSize||cache.read<Misc::SInt64>()!=meshFileTime||cache.readString()!=meshFilePath)
+			return false;
+		
+		/* Read the names of the mesh file's material library files: */
+		std::vector<std::string> mtlFileNames;
+		Misc::UInt32 numMtlFiles=cache.read<Misc::UInt32>();
+		for(Misc::UInt32 i=0;i<numMtlFiles;++i)
+			mtlFileNames.push_back(cache.readString());
+		
+		/* Read all vertex property arrays: */
+		std::vector<NodePointer> arrays;
+		Misc::UInt32 numArrays=cache.read<Misc::UInt32>();
+		for(Misc::UInt32 i=0;i<numArrays;++i)
+			{
+			switch(cache.read<Misc::UInt32>())
+				{
+				case TEXCOORDS:
+					{
+					TextureCoordinateNodePointer texCoord=new TextureCoordinateNode;
+					cache.readList(texCoord->point.getValues());
+					texCoord->update();
+					arrays.push_back(texCoord);
+					break;
+					}
+				
+				case COLORS:
+					{
+					ColorNodePointer color=new ColorNode;
+					cache.readList(color->color.getValues());
+					color->update();
+					arrays.push_back(color);
+					break;
+					}
+				
+				case NORMALS:
+					{
+					NormalNodePointer normal=new NormalNode;
+					cache.readList(normal->vector.getValues());
+					normal->update();
+					arrays.push_back(normal);
+					break;
+					}
+				
+				case COORDS:
+					{
+					CoordinateNodePointer coord=new CoordinateNode;
+					cache.readList(coord->point.getValues());
+					coord->update();
+					arrays.push_back(coord);
+					break;
+					}
+				
+				default:
+					throw std::runtime_error("Invalid property array type");
+				}
+			}
+		
+		/* Recreate all shapes: */
+		MaterialLibraryNodePointer materialLibrary=node.materialLibrary.getValue();
+		Misc::UInt32 numShapes=cache.read<Misc::UInt32>();
+		for(Misc::UInt32 shapeIndex=0;shapeIndex<numShapes;++shapeIndex)
+			{
+			ShapeNodePointer shape=new ShapeNode;
+			
+			/* Set the shape's appearance: */
+			if(cache.read<Misc::UInt8>()!=0)
+				shape->appearance.setValue(node.appearance.getValue());
+			else
+				{
+				std::string materialName=cache.readString();
+				if(materialLibrary==0)
+					{
+					/* Read the mesh file's material libraries into a temporary material library node: */
+					materialLibrary=new MaterialLibraryNode;
+					IO::DirectoryPtr meshDirectory=directory.openFileDirectory(meshFileName.c_str());
+					for(std::vector<std::string>::iterator mfnIt=mtlFileNames.begin();mfnIt!=mtlFileNames.end();++mfnIt)
+						readMtlFile(*meshDirectory,*mfnIt,*materialLibrary,node.disableTextures.getValue());
+					}
+				shape->appearance.setValue(materialLibrary->getMaterial(materialName));
+				}
+			
+			/* Read the shape's geometry type and property array indices: */
+			Misc::UInt8 geometryType=cache.read<Misc::UInt8>();
+			Misc::SInt32 arrayIndices[NUM_PROPERTYTYPES];
+			cache.read(arrayIndices,sizeof(arrayIndices));
+			if(geometryType==INDEXEDFACESET)
+				{
+				/* Create an indexed face set: */
+				Misc::Autopointer<IndexedFaceSetNode> faceSet=new IndexedFaceSetNode;
+				faceSet->texCoord.setValue(getPropertyNode<TextureCoordinateNode>(arrays,arrayIndices[TEXCOORDS]));
+				faceSet->color.setValue(getPropertyNode<ColorNode>(arrays,arrayIndices[COLORS]));
+				faceSet->normal.setValue(getPropertyNode<NormalNode>(arrays,arrayIndices[NORMALS]));
+				faceSet->coord.setValue(getPropertyNode<CoordinateNode>(arrays,arrayIndices[COORDS]));
+				faceSet->colorPerVertex.setValue(cache.read<Misc::UInt8>()!=0);
+				faceSet->normalPerVertex.setValue(cache.read<Misc::UInt8>()!=0);
+				cache.readList(faceSet->texCoordIndex.getValues());
+				cache.readList(faceSet->colorIndex.getValues());
+				cache.readList(faceSet->normalIndex.getValues());
+				cache.readList(faceSet->coordIndex.getValues());
+				
+				/* Copy face set parameters from the mesh file node: */
+				faceSet->ccw.setValue(node.ccw.getValue());
+				faceSet->solid.setValue(node.solid.getValue());
+				faceSet->creaseAngle.setValue(node.creaseAngle.getValue());
+				
+				faceSet->update();
+				shape->geometry.setValue(faceSet);
+				}
+			else if(geometryType==POINTSET)
+				{
+				/* Create a point set: */
+				Misc::Autopointer<PointSetNode> pointSet=new PointSetNode;
+				pointSet->color.setValue(getPropertyNode<ColorNode>(arrays,arrayIndices[COLORS]));
+				pointSet->coord.setValue(getPropertyNode<CoordinateNode>(arrays,arrayIndices[COORDS]));
+				
+				/* Copy point set parameters from the mesh file node: */
+				pointSet->pointSize.setValue(node.pointSize.getValue());
+				
+				pointSet->update();
+				shape->geometry.setValue(pointSet);
+				}
+			else
+				throw std::runtime_error("Invalid geometry type");
+			
+			shape->update();
+			shapes.push_back(shape);
+			}
+		
+		if(!cache.eof())
+			throw std::runtime_error("Trailing data in cache file");
+		}
+	catch(const std::runtime_error&)
+		{
+		/* Treat the cache file as missing: */
+		return false;
+		}
+	
+	/* Add the restored shapes to the mesh file node: */
+	for(std::vector<ShapeNodePointer>::iterator sIt=shapes.begin();sIt!=shapes.end();++sIt)
+		node.addShape(*sIt);
+	
+	return true;
+	}
+
+bool MeshFileCache::save(const MeshFileNode& node) const
+	{
+	/* Bail out if the mesh file can not be cached: */
+	if(cacheFileName.empty())
+		return false;
+	
+	/* Collect the vertex property arrays of all shapes and check that all shapes can be cached: */
+	std::vector<PropertyArray> arrays;
+	for(unsigned int shapeIndex=0;shapeIndex<node.getNumShapes();++shapeIndex)
+		{
+		const ShapeNode& shape=*node.getShape(shapeIndex);
+		if(shapeIndex>=shapeMaterials.size()&&shape.appearance.getValue().getPointer()!=node.appearance.getValue().getPointer())
+			return false;
+		const IndexedFaceSetNode* faceSet=dynamic_cast<const IndexedFaceSetNode*>(shape.geometry.getValue().getPointer());
+		const PointSetNode* pointSet=dynamic_cast<const PointSetNode*>(shape.geometry.getValue().getPointer());
+		if(faceSet!=0)
+			{
+			findPropertyArray(arrays,TEXCOORDS,faceSet->texCoord.getValue().getPointer());
+			findPropertyArray(arrays,COLORS,faceSet->color.getValue().getPointer());
+			findPropertyArray(arrays,NORMALS,faceSet->normal.getValue().getPointer());
+			findPropertyArray(arrays,COORDS,faceSet->coord.getValue().getPointer());
+			}
+		else if(pointSet!=0)
+			{
+			findPropertyArray(arrays,COLORS,pointSet->color.getValue().getPointer());
+			findPropertyArray(arrays,COORDS,pointSet->coord.getValue().getPointer());
+			}
+		else
+			return false;
+		}
+	
+	/* Create the cache directory: */
+	std::string cacheDirName(cacheFileName,0,cacheFileName.rfind('/'));
+	if(!createDirectories(cacheDirName))
+		return false;
+	
+	/* Write into a temporary file first so that concurrent readers never see a partial cache file: */
+	std::string tempFileName=Misc::stringPrintf("%s.%d.tmp",cacheFileName.c_str(),int(getpid()));
+	try
+		{
+		IO::FilePtr cacheFile=IO::openFile(tempFileName.c_str(),IO::File::WriteOnly);
+		
+		/* Write the cache file header: */
+		cacheFile->write(cacheFileMagic,sizeof(cacheFileMagic));
+		cacheFile->write<Misc::UInt32>(cacheFileEndiannessMarker);
+		cacheFile->write<Misc::UInt32>(sizeof(Point));
+		cacheFile->write<Misc::UInt32>(sizeof(Color));
+		cacheFile->write<Misc::UInt32>(sizeof(TexCoord));
+		cacheFile->write<Misc::UInt64>(meshFileSize);
+		cacheFile->write<Misc::SInt64>(meshFileTime);
+		writeString(*cacheFile,meshFilePath);
+		
+		/* Write the names of the mesh file's material library files: */
+		cacheFile->write<Misc::UInt32>(Misc::UInt32(materialLibraryFileNames.size()));
+		for(std::vector<std::string>::const_iterator mfnIt=materialLibraryFileNames.begin();mfnIt!=materialLibraryFileNames.end();++mfnIt)
+			writeString(*cacheFile,*mfnIt);
+		
+		/* Write all vertex property arrays: */
+		cacheFile->write<Misc::UInt32>(Misc::UInt32(arrays.size()));
+		for(std::vector<PropertyArray>::iterator aIt=arrays.begin();aIt!=arrays.end();++aIt)
+			{
+			cacheFile->write<Misc::UInt32>(aIt->type);
+			switch(aIt->type)
+				{
+				case TEXCOORDS:
+					writeList(*cacheFile,static_cast<const TextureCoordinateNode*>(aIt->node)->point.getValues());
+					break;
+				
+				case COLORS:
+					writeList(*cacheFile,static_cast<const ColorNode*>(aIt->node)->color.getValues());
+					break;
+				
+				case NORMALS:
+					writeList(*cacheFile,static_cast<const NormalNode*>(aIt->node)->vector.getValues());
+					break;
+				
+				case COORDS:
+					writeList(*cacheFile,static_cast<const CoordinateNode*>(aIt->node)->point.getValues());
+					break;
+				
+				default:
+					;
+				}
+			}
+		
+		/* Write all shapes: */
+		cacheFile->write<Misc::UInt32>(node.getNumShapes());
+		for(unsigned int shapeIndex=0;shapeIndex<node.getNumShapes();++shapeIndex)
+			{
+			const ShapeNode& shape=*node.getShape(shapeIndex);
+			
+			/* Write the shape's material: */
+			if(shapeIndex>=shapeMaterials.size()||shapeMaterials[shapeIndex].useDefault)
+				cacheFile->write<Misc::UInt8>(1);
+			else
+				{
+				cacheFile->write<Misc::UInt8>(0);
+				writeString(*cacheFile,shapeMaterials[shapeIndex].materialName);
+				}
+			
+			/* Write the shape's geometry: */
+			const IndexedFaceSetNode* faceSet=dynamic_cast<const IndexedFaceSetNode*>(shape.geometry.getValue().getPointer());
+			if(faceSet!=0)
+				{
+				Misc::SInt32 arrayIndices[NUM_PROPERTYTYPES];
+				arrayIndices[TEXCOORDS]=findPropertyArray(arrays,TEXCOORDS,faceSet->texCoord.getValue().getPointer());
+				arrayIndices[COLORS]=findPropertyArray(arrays,COLORS,faceSet->color.getValue().getPointer());
+				arrayIndices[NORMALS]=findPropertyArray(arrays,NORMALS,faceSet->normal.getValue().getPointer());
+				arrayIndices[COORDS]=findPropertyArray(arrays,COORDS,faceSet->coord.getValue().getPointer());
+				cacheFile->write<Misc::UInt8>(INDEXEDFACESET);
+				cacheFile->write(arrayIndices,NUM_PROPERTYTYPES);
+				cacheFile->write<Misc::UInt8>(faceSet->colorPerVertex.getValue()?1:0);
+				cacheFile->write<Misc::UInt8>(faceSet->normalPerVertex.getValue()?1:0);
+				writeList(*cacheFile,faceSet->texCoordIndex.getValues());
+				writeList(*cacheFile,faceSet->colorIndex.getValues());
+				writeList(*cacheFile,faceSet->normalIndex.getValues());
+				writeList(*cacheFile,faceSet->coordIndex.getValues());
+				}
+			else
+				{
+				const PointSetNode* pointSet=static_cast<const PointSetNode*>(shape.geometry.getValue().getPointer());
+				Misc::SInt32 arrayIndices[NUM_PROPERTYTYPES];
+				arrayIndices[TEXCOORDS]=-1;
+				arrayIndices[COLORS]=findPropertyArray(arrays,COLORS,pointSet->color.getValue().getPointer());
+				arrayIndices[NORMALS]=-1;
+				arrayIndices[COORDS]=findPropertyArray(arrays,COORDS,pointSet->coord.getValue().getPointer());
+				cacheFile->write<Misc::UInt8>(POINTSET);
+				cacheFile->write(arrayIndices,NUM_PROPERTYTYPES);
+				}
+			}
+		}
+	catch(const std::runtime_error&)
+		{
+		/* Discard the partial cache file: */
+		unlink(tempFileName.c_str());
+		return false;
+		}
+	
+	/* Atomically replace any previous cache file: */
+	if(rename(tempFileName.c_str(),cacheFileName.c_str())!=0)
+		{
+		unlink(tempFileName.c_str());
+		return false;
+		}
+	
+	return true;
+	}
+
+}
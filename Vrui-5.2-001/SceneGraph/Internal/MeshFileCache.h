@@ -0,0 +1,83 @@
+/***********************************************************************
+MeshFileCache - Helper class to store the shapes read from a mesh file
+in a binary cache file that can be memory-mapped and restored quickly
+the next time the same unchanged mesh file is loaded.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef SCENEGRAPH_INTERNAL_MESHFILECACHE_INCLUDED
+#define SCENEGRAPH_INTERNAL_MESHFILECACHE_INCLUDED
+
+#include <string>
+#include <vector>
+#include <Misc/SizedTypes.h>
+
+/* Forward declarations: */
+namespace IO {
+class Directory;
+}
+namespace SceneGraph {
+class MeshFileNode;
+}
+
+namespace SceneGraph {
+
+class MeshFileCache
+	{
+	/* Embedded classes: */
+	private:
+	struct ShapeMaterial // Structure recording the material used by a shape read from a mesh file
+		{
+		/* Elements: */
+		public:
+		bool useDefault; // Flag if the shape uses the mesh file node's appearance
+		std::string materialName; // Name of the shape's material in the mesh file's material libraries
+		};
+	
+	/* Elements: */
+	std::string meshFileName; // Mesh file name relative to the mesh file's directory
+	std::string meshFilePath; // Absolute path of the mesh file
+	Misc::UInt64 meshFileSize; // Size of the mesh file in bytes
+	Misc::SInt64 meshFileTime; // Modification time of the mesh file in nanoseconds, to catch rewrites within the same second
+	std::string cacheFileName; // Absolute name of the cache file; empty if the mesh file can not be cached
+	std::vector<std::string> materialLibraryFileNames; // Names of material library files referenced by the mesh file
+	std::vector<ShapeMaterial> shapeMaterials; // Materials used by the shapes read from the mesh file, in shape order
+	
+	/* Constructors and destructors: */
+	public:
+	MeshFileCache(const IO::Directory& directory,const std::string& fileName); // Creates a cache for the mesh file of the given name relative to the given directory
+	
+	/* Methods: */
+	bool isValid(void) const // Returns true if the mesh file can be cached
+		{
+		return !cacheFileName.empty();
+		}
+	const std::string& getCacheFileName(void) const // Returns the name of the cache file
+		{
+		return cacheFileName;
+		}
+	void addMaterialLibrary(const std::string& materialLibraryFileName); // Records the name of a material library file referenced by the mesh file
+	void addShapeMaterial(const char* materialName); // Records the material used by the next shape read from the mesh file; null pointer for the mesh file node's appearance
+	bool load(const IO::Directory& directory,MeshFileNode& node) const; // Appends the shapes stored in an up-to-date cache file to the given mesh file node; returns false if there is no valid cache file
+	bool save(const MeshFileNode& node) const; // Writes the given mesh file node's shapes to the cache file; returns false if the shapes could not be cached
+	};
+
+}
+
+#endif
@@ -1,7 +1,7 @@
 /***********************************************************************
 ReadObjFile - Helper function to read a 3D polygon file in Wavefront OBJ
 format into a list of shape nodes.
-Copyright (c) 2018-2019 Oliver Kreylos
+Copyright (c) 2018-2020 Oliver Kreylos
 
 This file is part of the Simple Scene Graph Renderer (SceneGraph).
 
@@ -44,6 +44,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <SceneGraph/MeshFileNode.h>
 #include <SceneGraph/Internal/OBJValueSource.h>
 #include <SceneGraph/Internal/ReadMtlFile.h>
+#include <SceneGraph/Internal/MeshFileCache.h>
 
 namespace SceneGraph {
 
@@ -78,6 +79,8 @@ class OBJFileReader // Helper class to maintain state while parsing an OBJ file
 	
 	/* Appearance node representing the current material properties: */
 	AppearanceNodePointer currentAppearance;
+	bool currentMaterialIsDefault; // Flag if the current appearance is the mesh file node's appearance
+	std::string currentMaterialName; // Name of the current material if it was selected from a material library
 	
 	/* Geometry nodes collecting geometric primitives: */
 	FaceSetMap faceSetMap; // Map of indexed face sets by appearances
@@ -90,6 +93,7 @@ class OBJFileReader // Helper class to maintain state while parsing an OBJ file
 	
 	/* Output state: */
 	MeshFileNode& node; // Mesh file node in which to collect created shapes
+	MeshFileCache* cache; // Optional mesh file cache in which to record referenced materials
 	
 	/* Private methods: */
 	void storeFaceSet(void) // Adds the current face set as a shape to the mesh file node
@@ -134,6 +138,8 @@ class OBJFileReader // Helper class to maintain state while parsing an OBJ file
 			/* Finalize the shape node and add it to the mesh file node's representation: */
 			shape->update();
 			node.addShape(shape);
+			if(cache!=0)
+				cache->addShapeMaterial(currentMaterialIsDefault?0:currentMaterialName.c_str());
 			
 			/* If there is a current appearance node, add a mapping from it to the face set to the face set map: */
 			if(currentAppearance!=0)
@@ -146,7 +152,7 @@ class OBJFileReader // Helper class to maintain state while parsing an OBJ file
 	
 	/* Constructors and destructors: */
 	public:
-	OBJFileReader(IO::Directory& sDirectory,const std::string& fileName,MeshFileNode& sNode)
+	OBJFileReader(IO::Directory& sDirectory,const std::string& fileName,MeshFileNode& sNode,MeshFileCache* sCache)
 		:directory(sDirectory),
 		 objFile(sDirectory,fileName),
 		 texCoord(new TextureCoordinateNode),texCoords(texCoord->point.getValues()),numTexCoords(0),
@@ -154,9 +160,9 @@ class OBJFileReader // Helper class to maintain state while parsing an OBJ file
 		 normal(new NormalNode),normals(normal->vector.getValues()),numNormals(0),
 		 coord(new CoordinateNode),coords(coord->point.getValues()),numCoords(0),
 		 materialLibrary(sNode.materialLibrary.getValue()==0?new MaterialLibraryNode:0),
-		 currentAppearance(sNode.appearance.getValue()),
+		 currentAppearance(sNode.appearance.getValue()),currentMaterialIsDefault(true),
 		 faceSetMap(17),currentFaceSet(0),
-		 node(sNode)
+		 node(sNode),cache(sCache)
 		{
 		}
 	
@@ -345,6 +351,8 @@ class OBJFileReader // Helper class to maintain state while parsing an OBJ file
 					{
 					/* Read the material library file name: */
 					std::string materialLibraryFileName=objFile.readLine();
+					if(cache!=0)
+						cache->addMaterialLibrary(materialLibraryFileName);
 					
 					/* Check if the mesh file node does not have a defined material library node: */
 					if(node.materialLibrary.getValue()==0)
@@ -367,6 +375,8 @@ class OBJFileReader // Helper class to maintain state while parsing an OBJ file
 					
 					/* Read the name of the new material and get its appearance node from the active material library: */
 					std::string materialName=objFile.readLine();
+					currentMaterialIsDefault=false;
+					currentMaterialName=materialName;
 					if(node.materialLibrary.getValue()!=0)
 						currentAppearance=node.materialLibrary.getValue()->getMaterial(materialName);
 					else
@@ -385,7 +395,7 @@ class OBJFileReader // Helper class to maintain state while parsing an OBJ file
 
 }
 
-void readObjFile(const IO::Directory& directory,const std::string& fileName,MeshFileNode& node)
+void readObjFile(const IO::Directory& directory,const std::string& fileName,MeshFileNode& node,MeshFileCache* cache)
 	{
 	/* Open the directory containing the OBJ file: */
 	IO::DirectoryPtr objDirectory=directory.openFileDirectory(fileName.c_str());
@@ -394,7 +404,7 @@ void readObjFile(const IO::Directory& directory,const std::string& fileName,Mesh
 	std::string objFileName=Misc::getFileName(fileName.c_str());
 	
 	/* Create a reader for the OBJ file: */
-	OBJFileReader objFileReader(*objDirectory,objFileName,node);
+	OBJFileReader objFileReader(*objDirectory,objFileName,node,cache);
 	
 	/* Parse the OBJ file: */
 	objFileReader.parse();
@@ -1,7 +1,7 @@
 /***********************************************************************
 ReadObjFile - Helper function to read a 3D polygon file in Wavefront OBJ
 format into a list of shape nodes.
-Copyright (c) 2018 Oliver Kreylos
+Copyright (c) 2018-2020 Oliver Kreylos
 
 This file is part of the Simple Scene Graph Renderer (SceneGraph).
 
@@ -31,11 +31,12 @@ class Directory;
 }
 namespace SceneGraph {
 class MeshFileNode;
+class MeshFileCache;
 }
 
 namespace SceneGraph {
 
-void readObjFile(const IO::Directory& directory,const std::string& fileName,MeshFileNode& node); // Reads the Wavefront OBJ file of the given name from the given directory and appends read shape nodes to the given mesh file node's representation
+void readObjFile(const IO::Directory& directory,const std::string& fileName,MeshFileNode& node,MeshFileCache* cache =0); // Reads the Wavefront OBJ file of the given name from the given directory and appends read shape nodes to the given mesh file node's representation; records referenced materials in the given optional mesh file cache
 
 }
 
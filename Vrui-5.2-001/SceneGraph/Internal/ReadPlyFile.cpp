@@ -1,7 +1,7 @@
 /***********************************************************************
 ReadPlyFile - Helper function to read a 3D polygon file in PLY format
 into a list of shape nodes.
-Copyright (c) 2018 Oliver Kreylos
+Copyright (c) 2018-2020 Oliver Kreylos
 
 This file is part of the Simple Scene Graph Renderer (SceneGraph).
 
@@ -22,9 +22,16 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include <SceneGraph/Internal/ReadPlyFile.h>
 
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <vector>
 #include <stdexcept>
+#include <Misc/SizedTypes.h>
+#include <Misc/Endianness.h>
 #include <Misc/Autopointer.h>
 #include <Misc/ThrowStdErr.h>
+#include <Threads/Thread.h>
 #include <IO/File.h>
 #include <IO/Directory.h>
 #include <IO/ValueSource.h>
@@ -41,9 +48,1072 @@ namespace SceneGraph {
 
 namespace {
 
-/****************
+/************************************************************************
+Helper classes and functions to parse large PLY files in parallel bands:
+************************************************************************/
+
+const size_t minBandBytes=size_t(1)<<20; // Minimum amount of file data a thread has to parse to be worth starting
+
+unsigned int getNumBands(size_t numBytes,size_t numItems) // Returns the number of bands into which to split the given amount of work
+	{
+	/* Default to the number of online CPUs on first use: */
+	static unsigned int numParsingThreads=0;
+	if(numParsingThreads==0)
+		{
+		long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+		numParsingThreads=numCpus>1?(unsigned int)numCpus:1U;
+		}
+	
+	size_t numBands=numBytes/minBandBytes;
+	if(numBands>numParsingThreads)
+		numBands=numParsingThreads;
+	if(numBands>numItems)
+		numBands=numItems;
+	return numBands>1?(unsigned int)numBands:1U;
+	}
+
+template <class KernelParam>
+struct Band // Structure describing a band of PLY file values parsed by one thread
+	{
+	/* Elements: */
+	public:
+	KernelParam* kernel; // Kernel parsing the band
+	unsigned int bandIndex; // Index of the band
+	};
+
+template <class KernelParam>
+void* bandThreadMethod(Band<KernelParam>* band)
+	{
+	/* Parse the band: */
+	band->kernel->processBand(band->bandIndex);
+	
+	return 0;
+	}
+
+template <class KernelParam>
+void processBands(KernelParam& kernel,unsigned int numBands) // Parses all bands of the given kernel, one per thread
+	{
+	if(numBands<=1)
+		{
+		/* Parse the only band in the caller's thread: */
+		kernel.processBand(0);
+		}
+	else
+		{
+		/* Parse all bands but the first in background threads: */
+		Band<KernelParam>* bands=new Band<KernelParam>[numBands];
+		Threads::Thread* threads=new Threads::Thread[numBands-1];
+		for(unsigned int i=0;i<numBands;++i)
+			{
+			bands[i].kernel=&kernel;
+			bands[i].bandIndex=i;
+			if(i>0)
+				threads[i-1].start(bandThreadMethod<KernelParam>,&bands[i]);
+			}
+		
+		/* Parse the first band in the caller's thread: */
+		kernel.processBand(0);
+		
+		/* Wait for all background threads to finish: */
+		for(unsigned int i=1;i<numBands;++i)
+			threads[i-1].join();
+		delete[] threads;
+		delete[] bands;
+		}
+	}
+
+class ChunkReader // Helper class to read the rest of a file in large chunks of complete lines or records
+	{
+	/* Elements: */
+	private:
+	IO::File& file; // File from which to read
+	std::vector<char> buffer; // Buffer holding the current chunk
+	size_t dataBegin,dataEnd; // Range of unprocessed data in the buffer
+	bool eof; // Flag if the end of the file has been reached
+	
+	/* Constructors and destructors: */
+	public:
+	ChunkReader(IO::File& sFile,size_t chunkSize)
+		:file(sFile),buffer(chunkSize),dataBegin(0),dataEnd(0),eof(false)
+		{
+		}
+	
+	/* Methods: */
+	const char* getData(void) const // Returns the beginning of unprocessed data
+		{
+		return &buffer[0]+dataBegin;
+		}
+	const char* getDataEnd(void) const // Returns the end of unprocessed data
+		{
+		return &buffer[0]+dataEnd;
+		}
+	bool isEof(void) const // Returns true if the entire file has been read
+		{
+		return eof;
+		}
+	void consume(const char* newData) // Marks all data up to the given position as processed
+		{
+		dataBegin=newData-&buffer[0];
+		}
+	bool fill(void) // Appends more data from the file to the unprocessed data; returns false if there is no more data
+		{
+		/* Move unprocessed data to the beginning of the buffer: */
+		if(dataBegin>0)
+			{
+			memmove(&buffer[0],&buffer[dataBegin],dataEnd-dataBegin);
+			dataEnd-=dataBegin;
+			dataBegin=0;
+			}
+		
+		/* Grow the buffer if it is full: */
+		if(dataEnd==buffer.size())
+			buffer.resize(buffer.size()*2);
+		
+		/* Read until the buffer is full or the file ends: */
+		size_t oldDataEnd=dataEnd;
+		while(!eof&&dataEnd<buffer.size())
+			{
+			size_t readSize=file.readUpTo(&buffer[dataEnd],buffer.size()-dataEnd);
+			if(readSize==0)
+				eof=true;
+			dataEnd+=readSize;
+			}
+		
+		return dataEnd!=oldDataEnd;
+		}
+	};
+
+const size_t chunkSize=size_t(1)<<24; // Initial size of chunks in which to read face elements and ASCII PLY files
+
+/**********************************************************
+Helper classes and functions to extract vertex properties:
+**********************************************************/
+
+struct VertexProperties // Structure describing the supported properties of a PLY file's vertex element
+	{
+	/* Elements: */
+	public:
+	unsigned int colorIndex[3];
+	int colorMask;
+	bool colorIsUInt;
+	Color::Scalar colorScale;
+	unsigned int normalIndex[3];
+	int normalMask;
+	unsigned int coordIndex[3];
+	int coordMask;
+	
+	/* Constructors and destructors: */
+	VertexProperties(const PLYElement& element) // Finds supported properties in the given vertex element
+		:colorMask(0x0),colorIsUInt(false),colorScale(1),
+		 normalMask(0x0),coordMask(0x0)
+		{
+		/* Get the indices of all supported vertex properties: */
+		const char* colorNames[3]={"red","green","blue"};
+		const char* normalNames[3]={"nx","ny","nz"};
+		const char* coordNames[3]={"x","y","z"};
+		unsigned int propertyIndex=0;
+		for(PLYElement::PropertyList::const_iterator pIt=element.propertiesBegin();pIt!=element.propertiesEnd();++pIt,++propertyIndex)
+			if(pIt->getPropertyType()==PLYProperty::SCALAR)
+				{
+				/* Check for any of the supported properties: */
+				for(int i=0;i<3;++i)
+					if(pIt->getName()==colorNames[i])
+						{
+						colorIndex[i]=propertyIndex;
+						colorMask|=0x1<<i;
+						if(colorMask==0x7)
+							{
+							/* Determine the color component scalar type: */
+							switch(pIt->getScalarType())
+								{
+								case PLY_UINT8:
+									colorIsUInt=true;
+									colorScale=Color::Scalar(1)/Color::Scalar(255);
+									break;
+								
+								case PLY_UINT16:
+									colorIsUInt=true;
+									colorScale=Color::Scalar(1)/Color::Scalar(65535);
+									break;
+								
+								case PLY_FLOAT32:
+								case PLY_FLOAT64:
+									colorIsUInt=false;
+									break;
+								
+								default:
+									/* Ignore color values due to unsupported scalar type: */
+									colorMask=0x0;
+								}
+							}
+						}
+				for(int i=0;i<3;++i)
+					if(pIt->getName()==normalNames[i])
+						{
+						normalIndex[i]=propertyIndex;
+						normalMask|=0x1<<i;
+						}
+				for(int i=0;i<3;++i)
+					if(pIt->getName()==coordNames[i])
+						{
+						coordIndex[i]=propertyIndex;
+						coordMask|=0x1<<i;
+						}
+				}
+		}
+	};
+
+class VertexWriter // Helper class to store vertex properties extracted from element values into pre-allocated arrays
+	{
+	/* Elements: */
+	private:
+	const VertexProperties& vp; // Vertex property layout
+	Color* colors; // Pointer to color array, or null
+	Vector* normals; // Pointer to normal vector array, or null
+	Point* coords; // Pointer to position array
+	
+	/* Constructors and destructors: */
+	public:
+	VertexWriter(const VertexProperties& sVp,ColorNode* color,NormalNode* normal,CoordinateNode* coord)
+		:vp(sVp),
+		 colors(color!=0&&!color->color.getValues().empty()?&color->color.getValues()[0]:0),
+		 normals(normal!=0&&!normal->vector.getValues().empty()?&normal->vector.getValues()[0]:0),
+		 coords(coord!=0&&!coord->point.getValues().empty()?&coord->point.getValues()[0]:0)
+		{
+		}
+	
+	/* Methods: */
+	void store(size_t vertexIndex,const double* values) const // Stores the vertex of the given index from the given property values
+		{
+		if(colors!=0)
+			{
+			Color& c=colors[vertexIndex];
+			if(vp.colorIsUInt)
+				{
+				for(int i=0;i<3;++i)
+					c[i]=Color::Scalar((unsigned int)(values[vp.colorIndex[i]]))*vp.colorScale;
+				}
+			else
+				{
+				for(int i=0;i<3;++i)
+					c[i]=Color::Scalar(values[vp.colorIndex[i]]);
+				}
+			}
+		if(normals!=0)
+			{
+			Vector& n=normals[vertexIndex];
+			for(int i=0;i<3;++i)
+				n[i]=Scalar(values[vp.normalIndex[i]]);
+			}
+		Point& p=coords[vertexIndex];
+		for(int i=0;i<3;++i)
+			p[i]=Scalar(values[vp.coordIndex[i]]);
+		}
+	};
+
+void resizeVertexArrays(size_t numVertices,ColorNode* color,NormalNode* normal,CoordinateNode* coord) // Allocates property arrays for the given number of vertices
+	{
+	if(color!=0)
+		color->color.getValues().resize(numVertices);
+	if(normal!=0)
+		normal->vector.getValues().resize(numVertices);
+	coord->point.getValues().resize(numVertices);
+	}
+
+/**************************************************
+Helper classes and functions for binary PLY files:
+**************************************************/
+
+size_t getBinarySize(PLYDataType dataType) // Returns the size of a value of the given data type in binary PLY files
+	{
+	static const size_t sizes[8]={1,1,2,2,4,4,4,8};
+	return sizes[dataType];
+	}
+
+template <class FileTypeParam>
+inline
+double
+decodeBinaryValue(
+	const Misc::UInt8* valuePtr,
+	bool swap)
+	{
+	FileTypeParam value;
+	memcpy(&value,valuePtr,sizeof(FileTypeParam));
+	if(swap)
+		Misc::swapEndianness(value);
+	return double(value);
+	}
+
+inline
+double
+decodeBinaryValue(
+	const Misc::UInt8* valuePtr,
+	PLYDataType dataType,
+	bool swap)
+	{
+	switch(dataType)
+		{
+		case PLY_SINT8:
+			return double(*reinterpret_cast<const Misc::SInt8*>(valuePtr));
+		
+		case PLY_UINT8:
+			return double(*valuePtr);
+		
+		case PLY_SINT16:
+			return decodeBinaryValue<Misc::SInt16>(valuePtr,swap);
+		
+		case PLY_UINT16:
+			return decodeBinaryValue<Misc::UInt16>(valuePtr,swap);
+		
+		case PLY_SINT32:
+			return decodeBinaryValue<Misc::SInt32>(valuePtr,swap);
+		
+		case PLY_UINT32:
+			return decodeBinaryValue<Misc::UInt32>(valuePtr,swap);
+		
+		case PLY_FLOAT32:
+			return decodeBinaryValue<Misc::Float32>(valuePtr,swap);
+		
+		default:
+			return decodeBinaryValue<Misc::Float64>(valuePtr,swap);
+		}
+	}
+
+class BinaryVertexDecoder // Kernel to decode a block of fixed-size binary vertex records in parallel
+	{
+	/* Elements: */
+	private:
+	const VertexWriter& writer; // Writer storing decoded vertices
+	std::vector<unsigned int> usedProperties; // Indices of vertex properties that need to be decoded
+	std::vector<size_t> offsets; // Offsets of all vertex properties inside a vertex record
+	std::vector<PLYDataType> dataTypes; // Data types of all vertex properties
+	size_t recordSize; // Size of a vertex record in bytes
+	bool swap; // Flag if property values need to be endianness-swapped
+	const Misc::UInt8* records; // Pointer to the current block of vertex records
+	size_t firstVertex; // Index of the first vertex in the current block
+	size_t numVertices; // Number of vertices in the current block
+	unsigned int numBands; // Number of bands into which the current block is split
+	
+	/* Constructors and destructors: */
+	public:
+	BinaryVertexDecoder(const PLYElement& element,const VertexProperties& vp,const VertexWriter& sWriter,bool sSwap)
+		:writer(sWriter),recordSize(0),swap(sSwap),
+		 records(0),firstVertex(0),numVertices(0),numBands(1)
+		{
+		/* Calculate the layout of vertex records: */
+		for(PLYElement::PropertyList::const_iterator pIt=element.propertiesBegin();pIt!=element.propertiesEnd();++pIt)
+			{
+			offsets.push_back(recordSize);
+			dataTypes.push_back(pIt->getScalarType());
+			recordSize+=getBinarySize(pIt->getScalarType());
+			}
+		
+		/* Collect the properties that need to be decoded: */
+		for(int i=0;i<3;++i)
+			{
+			if(vp.colorMask==0x7)
+				usedProperties.push_back(vp.colorIndex[i]);
+			if(vp.normalMask==0x7)
+				usedProperties.push_back(vp.normalIndex[i]);
+			usedProperties.push_back(vp.coordIndex[i]);
+			}
+		}
+	
+	/* Methods: */
+	size_t getRecordSize(void) const
+		{
+		return recordSize;
+		}
+	void setBlock(const Misc::UInt8* newRecords,size_t newFirstVertex,size_t newNumVertices,unsigned int newNumBands) // Sets the block of vertex records to decode
+		{
+		records=newRecords;
+		firstVertex=newFirstVertex;
+		numVertices=newNumVertices;
+		numBands=newNumBands;
+		}
+	void processBand(unsigned int bandIndex) // Decodes one band of the current block
+		{
+		size_t begin=(numVertices*bandIndex)/numBands;
+		size_t end=(numVertices*(bandIndex+1))/numBands;
+		std::vector<double> values(offsets.size(),0.0);
+		const Misc::UInt8* rPtr=records+begin*recordSize;
+		for(size_t i=begin;i<end;++i,rPtr+=recordSize)
+			{
+			for(std::vector<unsigned int>::const_iterator upIt=usedProperties.begin();upIt!=usedProperties.end();++upIt)
+				values[*upIt]=decodeBinaryValue(rPtr+offsets[*upIt],dataTypes[*upIt],swap);
+			writer.store(firstVertex+i,&values[0]);
+			}
+		}
+	};
+
+bool readVertexBlock(const PLYElement& element,const VertexProperties& vp,IO::File& ply,ColorNode* color,NormalNode* normal,CoordinateNode* coord) // Reads the fixed-size vertex records of a binary PLY file in large blocks and decodes them in parallel; returns false if the vertex element has variable size
+	{
+	if(element.hasListProperty())
+		return false;
+	
+	/* Allocate the vertex property arrays: */
+	size_t numVertices=element.getNumValues();
+	resizeVertexArrays(numVertices,color,normal,coord);
+	VertexWriter writer(vp,color,normal,coord);
+	BinaryVertexDecoder decoder(element,vp,writer,ply.mustSwapOnRead());
+	
+	/* Read and decode the vertex records block by block: */
+	size_t recordSize=decoder.getRecordSize();
+	size_t blockSize=(size_t(1)<<24)/recordSize+1;
+	if(blockSize>numVertices)
+		blockSize=numVertices;
+	std::vector<Misc::UInt8> block(blockSize*recordSize);
+	for(size_t firstVertex=0;firstVertex<numVertices;firstVertex+=blockSize)
+		{
+		size_t numBlockVertices=numVertices-firstVertex;
+		if(numBlockVertices>blockSize)
+			numBlockVertices=blockSize;
+		ply.readRaw(&block[0],numBlockVertices*recordSize);
+		unsigned int numBands=getNumBands(numBlockVertices*recordSize,numBlockVertices);
+		decoder.setBlock(&block[0],firstVertex,numBlockVertices,numBands);
+		processBands(decoder,numBands);
+		}
+	
+	return true;
+	}
+
+inline bool readVertexBlock(const PLYElement&,const VertexProperties&,IO::ValueSource&,ColorNode*,NormalNode*,CoordinateNode*) // ASCII PLY files are never read in blocks by the generic reader
+	{
+	return false;
+	}
+
+inline bool isIntegerType(PLYDataType dataType)
+	{
+	return dataType!=PLY_FLOAT32&&dataType!=PLY_FLOAT64;
+	}
+
+bool isPlainFaceElement(const PLYElement& element) // Returns true if the given face element consists only of a vertex index list of integer type
+	{
+	if(element.getNumProperties()!=1)
+		return false;
+	const PLYProperty& property=*element.propertiesBegin();
+	return property.getPropertyType()==PLYProperty::LIST&&property.getName()=="vertex_indices"&&isIntegerType(property.getListSizeType())&&isIntegerType(property.getListElementType());
+	}
+
+inline unsigned int decodeListSize(const Misc::UInt8*& recordPtr,PLYDataType listSizeType,size_t listSizeSize,bool swap) // Decodes a face's number of vertices and advances the record pointer
+	{
+	unsigned int result=(unsigned int)(decodeBinaryValue(recordPtr,listSizeType,swap));
+	recordPtr+=listSizeSize;
+	return result;
+	}
+
+template <class IndexParam>
+class BinaryFaceDecoder // Kernel to decode a chunk of variable-size binary face records in parallel
+	{
+	/* Elements: */
+	private:
+	PLYDataType listSizeType; // Data type for face vertex counts
+	size_t listSizeSize; // Size of face vertex counts in bytes
+	bool swap; // Flag if values need to be endianness-swapped
+	const Misc::UInt8* chunk; // Beginning of the current chunk
+	const Misc::UInt8* chunkEnd; // End of the complete face records in the current chunk
+	size_t numFaces; // Number of complete face records in the current chunk
+	size_t numIndices; // Number of vertex indices, including face terminators, in the current chunk
+	std::vector<const Misc::UInt8*> bandStarts; // Beginnings of all bands of face records
+	std::vector<size_t> bandNumFaces; // Number of face records in each band
+	std::vector<size_t> bandOutputs; // Offsets of each band's first vertex index in the output array
+	int* output; // Output array for vertex indices
+	
+	/* Constructors and destructors: */
+	public:
+	BinaryFaceDecoder(PLYDataType sListSizeType,bool sSwap)
+		:listSizeType(sListSizeType),listSizeSize(getBinarySize(sListSizeType)),swap(sSwap),
+		 chunk(0),chunkEnd(0),numFaces(0),numIndices(0),output(0)
+		{
+		}
+	
+	/* Methods: */
+	size_t scan(const char* data,const char* dataEnd,size_t maxNumFaces) // Finds up to the given number of complete face records in the given data; returns the number of found records
+		{
+		chunk=reinterpret_cast<const Misc::UInt8*>(data);
+		const Misc::UInt8* end=reinterpret_cast<const Misc::UInt8*>(dataEnd);
+		chunkEnd=chunk;
+		numFaces=0;
+		numIndices=0;
+		while(numFaces<maxNumFaces&&size_t(end-chunkEnd)>=listSizeSize)
+			{
+			const Misc::UInt8* recordPtr=chunkEnd;
+			unsigned int numFaceVertices=decodeListSize(recordPtr,listSizeType,listSizeSize,swap);
+			if(size_t(end-recordPtr)<size_t(numFaceVertices)*sizeof(IndexParam))
+				break;
+			chunkEnd=recordPtr+size_t(numFaceVertices)*sizeof(IndexParam);
+			++numFaces;
+			numIndices+=numFaceVertices+1;
+			}
+		
+		return numFaces;
+		}
+	const char* getChunkEnd(void) const // Returns the end of the complete face records in the current chunk
+		{
+		return reinterpret_cast<const char*>(chunkEnd);
+		}
+	size_t getNumIndices(void) const // Returns the number of vertex indices in the current chunk
+		{
+		return numIndices;
+		}
+	void split(unsigned int numBands,int* newOutput) // Splits the current chunk into the given number of bands writing into the given output array
+		{
+		bandStarts.clear();
+		bandNumFaces.clear();
+		bandOutputs.clear();
+		output=newOutput;
+		const Misc::UInt8* recordPtr=chunk;
+		size_t outputOffset=0;
+		size_t face=0;
+		for(unsigned int band=0;band<numBands;++band)
+			{
+			/* Start a new band: */
+			bandStarts.push_back(recordPtr);
+			bandOutputs.push_back(outputOffset);
+			size_t bandEnd=(numFaces*(band+1))/numBands;
+			bandNumFaces.push_back(bandEnd-face);
+			
+			/* Skip the band's face records: */
+			if(band+1<numBands)
+				for(;face<bandEnd;++face)
+					{
+					unsigned int numFaceVertices=decodeListSize(recordPtr,listSizeType,listSizeSize,swap);
+					recordPtr+=size_t(numFaceVertices)*sizeof(IndexParam);
+					outputOffset+=numFaceVertices+1;
+					}
+			}
+		}
+	void processBand(unsigned int bandIndex) // Decodes one band of face records
+		{
+		const Misc::UInt8* recordPtr=bandStarts[bandIndex];
+		int* outPtr=output+bandOutputs[bandIndex];
+		for(size_t i=0;i<bandNumFaces[bandIndex];++i)
+			{
+			unsigned int numFaceVertices=decodeListSize(recordPtr,listSizeType,listSizeSize,swap);
+			for(unsigned int j=0;j<numFaceVertices;++j,recordPtr+=sizeof(IndexParam))
+				{
+				IndexParam index;
+				memcpy(&index,recordPtr,sizeof(IndexParam));
+				if(swap)
+					Misc::swapEndianness(index);
+				*(outPtr++)=int(index);
+				}
+			*(outPtr++)=-1;
+			}
+		}
+	};
+
+template <class IndexParam>
+void readFaceIndices(size_t numFaces,PLYDataType listSizeType,IO::File& ply,bool isLastElement,MFInt::ValueList& coordIndices) // Reads the vertex index lists of all faces
+	{
+	if(isLastElement)
+		{
+		/* Read the rest of the file in large chunks and decode complete face records in parallel: */
+		ChunkReader reader(ply,chunkSize);
+		BinaryFaceDecoder<IndexParam> decoder(listSizeType,ply.mustSwapOnRead());
+		size_t facesLeft=numFaces;
+		while(facesLeft>0)
+			{
+			/* Find complete face records in the current chunk: */
+			size_t numChunkFaces=decoder.scan(reader.getData(),reader.getDataEnd(),facesLeft);
+			if(numChunkFaces==0)
+				{
+				/* Read more data: */
+				if(!reader.fill())
+					throw std::runtime_error("Face element is truncated");
+				continue;
+				}
+			
+			/* Decode the chunk's face records directly into the vertex index array: */
+			size_t outputBase=coordIndices.size();
+			coordIndices.resize(outputBase+decoder.getNumIndices());
+			unsigned int numBands=getNumBands(decoder.getChunkEnd()-reader.getData(),numChunkFaces);
+			decoder.split(numBands,&coordIndices[outputBase]);
+			processBands(decoder,numBands);
+			
+			/* Continue with the next chunk: */
+			reader.consume(decoder.getChunkEnd());
+			facesLeft-=numChunkFaces;
+			}
+		}
+	else
+		{
+		/* Read faces with directly typed reads to leave the file positioned at the next element: */
+		IndexParam faceIndices[256];
+		for(size_t i=0;i<numFaces;++i)
+			{
+			/* Read the face's number of vertices: */
+			unsigned int numFaceVertices;
+			switch(listSizeType)
+				{
+				case PLY_SINT8:
+					numFaceVertices=(unsigned int)(ply.read<Misc::SInt8>());
+					break;
+				
+				case PLY_UINT8:
+					numFaceVertices=ply.read<Misc::UInt8>();
+					break;
+				
+				case PLY_SINT16:
+					numFaceVertices=(unsigned int)(ply.read<Misc::SInt16>());
+					break;
+				
+				case PLY_UINT16:
+					numFaceVertices=ply.read<Misc::UInt16>();
+					break;
+				
+				case PLY_SINT32:
+					numFaceVertices=(unsigned int)(ply.read<Misc::SInt32>());
+					break;
+				
+				default:
+					numFaceVertices=ply.read<Misc::UInt32>();
+				}
+			
+			/* Read the face's vertex indices in chunks: */
+			for(unsigned int first=0;first<numFaceVertices;first+=256)
+				{
+				unsigned int numChunkVertices=numFaceVertices-first;
+				if(numChunkVertices>256)
+					numChunkVertices=256;
+				ply.read(faceIndices,numChunkVertices);
+				for(unsigned int j=0;j<numChunkVertices;++j)
+					coordIndices.push_back(int(faceIndices[j]));
+				}
+			coordIndices.push_back(-1);
+			}
+		}
+	}
+
+bool readFaceBlock(const PLYElement& element,IO::File& ply,bool isLastElement,MFInt::ValueList& coordIndices) // Reads the vertex indices of all faces of a binary PLY file; returns false if the face element has an unsupported layout
+	{
+	if(!isPlainFaceElement(element))
+		return false;
+	
+	const PLYProperty& property=*element.propertiesBegin();
+	switch(property.getListElementType())
+		{
+		case PLY_SINT8:
+			readFaceIndices<Misc::SInt8>(element.getNumValues(),property.getListSizeType(),ply,isLastElement,coordIndices);
+			break;
+		
+		case PLY_UINT8:
+			readFaceIndices<Misc::UInt8>(element.getNumValues(),property.getListSizeType(),ply,isLastElement,coordIndices);
+			break;
+		
+		case PLY_SINT16:
+			readFaceIndices<Misc::SInt16>(element.getNumValues(),property.getListSizeType(),ply,isLastElement,coordIndices);
+			break;
+		
+		case PLY_UINT16:
+			readFaceIndices<Misc::UInt16>(element.getNumValues(),property.getListSizeType(),ply,isLastElement,coordIndices);
+			break;
+		
+		case PLY_SINT32:
+			readFaceIndices<Misc::SInt32>(element.getNumValues(),property.getListSizeType(),ply,isLastElement,coordIndices);
+			break;
+		
+		default:
+			readFaceIndices<Misc::UInt32>(element.getNumValues(),property.getListSizeType(),ply,isLastElement,coordIndices);
+		}
+	
+	return true;
+	}
+
+inline bool readFaceBlock(const PLYElement&,IO::ValueSource&,bool,MFInt::ValueList&) // ASCII PLY files are never read in blocks by the generic reader
+	{
+	return false;
+	}
+
+/*************************************************
+Helper classes and functions for ASCII PLY files:
+*************************************************/
+
+inline bool isLineSpace(char c) // Returns true if the given character separates values inside a line
+	{
+	return c==' '||c=='\t'||c=='\r'||c=='\f'||c=='\v';
+	}
+
+inline bool isDigit(char c)
+	{
+	return c>='0'&&c<='9';
+	}
+
+/* The following parsers replicate IO::ValueSource's number parsing exactly to produce identical values: */
+
+bool parseUnsignedInteger(const char*& ptr,const char* end,unsigned int& result)
+	{
+	if(ptr==end||!isDigit(*ptr))
+		return false;
+	result=0;
+	while(ptr!=end&&isDigit(*ptr))
+		{
+		result=result*10+(unsigned int)(*ptr-'0');
+		++ptr;
+		}
+	return true;
+	}
+
+bool parseInteger(const char*& ptr,const char* end,int& result)
+	{
+	bool negate=ptr!=end&&*ptr=='-';
+	if(ptr!=end&&(*ptr=='-'||*ptr=='+'))
+		++ptr;
+	if(ptr==end||!isDigit(*ptr))
+		return false;
+	result=0;
+	while(ptr!=end&&isDigit(*ptr))
+		{
+		result=result*10+int(*ptr-'0');
+		++ptr;
+		}
+	if(negate)
+		result=-result;
+	return true;
+	}
+
+bool parseNumber(const char*& ptr,const char* end,double& result)
+	{
+	bool negate=ptr!=end&&*ptr=='-';
+	if(ptr!=end&&(*ptr=='-'||*ptr=='+'))
+		++ptr;
+	
+	/* Parse the integral part: */
+	bool haveDigit=false;
+	result=0.0;
+	while(ptr!=end&&isDigit(*ptr))
+		{
+		haveDigit=true;
+		result=result*10.0+double(*ptr-'0');
+		++ptr;
+		}
+	
+	/* Parse the fractional part: */
+	if(ptr!=end&&*ptr=='.')
+		{
+		++ptr;
+		double fraction=0.0;
+		double fractionBase=1.0;
+		while(ptr!=end&&isDigit(*ptr))
+			{
+			haveDigit=true;
+			fraction=fraction*10.0+double(*ptr-'0');
+			fractionBase*=10.0;
+			++ptr;
+			}
+		result+=fraction/fractionBase;
+		}
+	if(!haveDigit)
+		return false;
+	if(negate)
+		result=-result;
+	
+	/* Parse the exponent: */
+	if(ptr!=end&&(*ptr=='e'||*ptr=='E'))
+		{
+		++ptr;
+		bool negateExponent=ptr!=end&&*ptr=='-';
+		if(ptr!=end&&(*ptr=='-'||*ptr=='+'))
+			++ptr;
+		if(ptr==end||!isDigit(*ptr))
+			return false;
+		double exponent=0.0;
+		while(ptr!=end&&isDigit(*ptr))
+			{
+			exponent=exponent*10.0+double(*ptr-'0');
+			++ptr;
+			}
+		result*=pow(10.0,negateExponent?-exponent:exponent);
+		}
+	
+	return true;
+	}
+
+bool parseAsciiValue(const char*& ptr,const char* end,PLYDataType dataType,double& result) // Parses a value of the given data type followed by whitespace
+	{
+	/* Skip whitespace preceding the value: */
+	while(ptr!=end&&isLineSpace(*ptr))
+		++ptr;
+	
+	/* Parse the value according to its type: */
+	bool ok;
+	switch(dataType)
+		{
+		case PLY_SINT8:
+		case PLY_SINT16:
+		case PLY_SINT32:
+			{
+			int value=0;
+			ok=parseInteger(ptr,end,value);
+			result=double(value);
+			break;
+			}
+		
+		case PLY_UINT8:
+		case PLY_UINT16:
+		case PLY_UINT32:
+			{
+			unsigned int value=0;
+			ok=parseUnsignedInteger(ptr,end,value);
+			result=double(value);
+			break;
+			}
+		
+		default:
+			ok=parseNumber(ptr,end,result);
+		}
+	
+	/* Check that the value is terminated properly: */
+	return ok&&(ptr==end||isLineSpace(*ptr)||*ptr=='\n');
+	}
+
+bool finishLine(const char*& ptr,const char* end) // Skips trailing whitespace and the line break; returns false if there is unexpected data
+	{
+	while(ptr!=end&&isLineSpace(*ptr))
+		++ptr;
+	if(ptr!=end)
+		{
+		if(*ptr!='\n')
+			return false;
+		++ptr;
+		}
+	return true;
+	}
+
+const char* findLines(const char* text,const char* end,bool atEof,size_t maxNumLines,size_t& numLines) // Finds up to the given number of complete lines in the given text; returns the end of the last found line
+	{
+	const char* ptr=text;
+	numLines=0;
+	while(numLines<maxNumLines&&ptr!=end)
+		{
+		/* Find the end of the next line; an unterminated line is only complete at the end of the file: */
+		const char* lineEnd=static_cast<const char*>(memchr(ptr,'\n',end-ptr));
+		if(lineEnd!=0)
+			ptr=lineEnd+1;
+		else if(atEof)
+			ptr=end;
+		else
+			break;
+		++numLines;
+		}
+	
+	return ptr;
+	}
+
+void splitLines(const char* text,const char* linesEnd,size_t numLines,unsigned int numBands,std::vector<const char*>& bandStarts) // Finds the beginnings of bands of roughly equal numbers of the given complete lines
+	{
+	bandStarts.clear();
+	bandStarts.push_back(text);
+	const char* ptr=text;
+	size_t line=0;
+	for(unsigned int band=1;band<numBands;++band)
+		{
+		/* Skip the previous band's lines: */
+		size_t bandStart=(numLines*band)/numBands;
+		for(;line<bandStart;++line)
+			ptr=static_cast<const char*>(memchr(ptr,'\n',linesEnd-ptr))+1;
+		bandStarts.push_back(ptr);
+		}
+	bandStarts.push_back(linesEnd);
+	}
+
+class AsciiVertexParser // Kernel to parse a chunk of vertex lines of an ASCII PLY file in parallel
+	{
+	/* Elements: */
+	private:
+	const VertexWriter& writer; // Writer storing parsed vertices
+	std::vector<PLYDataType> dataTypes; // Data types of all vertex properties
+	const std::vector<const char*>* bandStarts; // Beginnings of all bands, followed by the end of the chunk's vertex lines
+	size_t firstVertex; // Index of the chunk's first vertex
+	size_t numVertices; // Number of vertices in the chunk
+	unsigned int numBands; // Number of bands
+	std::vector<char> bandFailed; // Flags for bands that contained malformed lines
+	
+	/* Constructors and destructors: */
+	public:
+	AsciiVertexParser(const PLYElement& element,const VertexWriter& sWriter)
+		:writer(sWriter),bandStarts(0),firstVertex(0),numVertices(0),numBands(0)
+		{
+		for(PLYElement::PropertyList::const_iterator pIt=element.propertiesBegin();pIt!=element.propertiesEnd();++pIt)
+			dataTypes.push_back(pIt->getScalarType());
+		}
+	
+	/* Methods: */
+	void setChunk(const std::vector<const char*>& newBandStarts,size_t newFirstVertex,size_t newNumVertices) // Sets the chunk of vertex lines to parse next
+		{
+		bandStarts=&newBandStarts;
+		firstVertex=newFirstVertex;
+		numVertices=newNumVertices;
+		numBands=(unsigned int)(newBandStarts.size()-1);
+		bandFailed.assign(numBands,0);
+		}
+	void processBand(unsigned int bandIndex) // Parses one band of vertex lines
+		{
+		size_t begin=(numVertices*bandIndex)/numBands;
+		size_t end=(numVertices*(bandIndex+1))/numBands;
+		const char* ptr=(*bandStarts)[bandIndex];
+		const char* bandEnd=(*bandStarts)[bandIndex+1];
+		std::vector<double> values(dataTypes.size(),0.0);
+		for(size_t i=begin;i<end;++i)
+			{
+			/* Parse all property values in the vertex's line: */
+			for(size_t j=0;j<dataTypes.size();++j)
+				if(!parseAsciiValue(ptr,bandEnd,dataTypes[j],values[j]))
+					{
+					bandFailed[bandIndex]=1;
+					return;
+					}
+			if(!finishLine(ptr,bandEnd))
+				{
+				bandFailed[bandIndex]=1;
+				return;
+				}
+			
+			writer.store(firstVertex+i,&values[0]);
+			}
+		}
+	bool failed(void) const // Returns true if any band contained malformed lines
+		{
+		for(std::vector<char>::const_iterator bfIt=bandFailed.begin();bfIt!=bandFailed.end();++bfIt)
+			if(*bfIt)
+				return true;
+		return false;
+		}
+	};
+
+class AsciiFaceParser // Kernel to parse a chunk of face lines of an ASCII PLY file in parallel
+	{
+	/* Elements: */
+	private:
+	PLYDataType listSizeType; // Data type for face vertex counts
+	PLYDataType listElementType; // Data type for face vertex indices
+	const std::vector<const char*>* bandStarts; // Beginnings of all bands, followed by the end of the chunk's face lines
+	size_t numFaces; // Number of faces in the chunk
+	unsigned int numBands; // Number of bands
+	std::vector<std::vector<int> > bandIndices; // Face vertex indices parsed from each band
+	std::vector<char> bandFailed; // Flags for bands that contained malformed lines
+	
+	/* Constructors and destructors: */
+	public:
+	AsciiFaceParser(PLYDataType sListSizeType,PLYDataType sListElementType)
+		:listSizeType(sListSizeType),listElementType(sListElementType),
+		 bandStarts(0),numFaces(0),numBands(0)
+		{
+		}
+	
+	/* Methods: */
+	void setChunk(const std::vector<const char*>& newBandStarts,size_t newNumFaces) // Sets the chunk of face lines to parse next
+		{
+		bandStarts=&newBandStarts;
+		numFaces=newNumFaces;
+		numBands=(unsigned int)(newBandStarts.size()-1);
+		if(bandIndices.size()<numBands)
+			bandIndices.resize(numBands);
+		bandFailed.assign(numBands,0);
+		}
+	void processBand(unsigned int bandIndex) // Parses one band of face lines
+		{
+		size_t begin=(numFaces*bandIndex)/numBands;
+		size_t end=(numFaces*(bandIndex+1))/numBands;
+		const char* ptr=(*bandStarts)[bandIndex];
+		const char* bandEnd=(*bandStarts)[bandIndex+1];
+		std::vector<int>& indices=bandIndices[bandIndex];
+		indices.clear();
+		for(size_t i=begin;i<end;++i)
+			{
+			/* Parse the face's number of vertices and vertex indices: */
+			double value;
+			if(!parseAsciiValue(ptr,bandEnd,listSizeType,value))
+				{
+				bandFailed[bandIndex]=1;
+				return;
+				}
+			unsigned int numFaceVertices=(unsigned int)(value);
+			for(unsigned int j=0;j<numFaceVertices;++j)
+				{
+				if(!parseAsciiValue(ptr,bandEnd,listElementType,value))
+					{
+					bandFailed[bandIndex]=1;
+					return;
+					}
+				indices.push_back(int(value));
+				}
+			indices.push_back(-1);
+			if(!finishLine(ptr,bandEnd))
+				{
+				bandFailed[bandIndex]=1;
+				return;
+				}
+			}
+		}
+	bool failed(void) const // Returns true if any band contained malformed lines
+		{
+		for(std::vector<char>::const_iterator bfIt=bandFailed.begin();bfIt!=bandFailed.end();++bfIt)
+			if(*bfIt)
+				return true;
+		return false;
+		}
+	void appendIndices(MFInt::ValueList& coordIndices) const // Appends the face vertex indices parsed from all bands of the current chunk
+		{
+		for(unsigned int i=0;i<numBands;++i)
+			coordIndices.insert(coordIndices.end(),bandIndices[i].begin(),bandIndices[i].end());
+		}
+	};
+
+/*****************
 Helper functions:
-****************/
+*****************/
+
+void addPlyShape(ColorNodePointer color,NormalNodePointer normal,CoordinateNodePointer coord,Misc::Autopointer<IndexedFaceSetNode> faceSet,MeshFileNode& node) // Creates a shape node from the property and geometry nodes extracted from a PLY file
+	{
+	/* Create a new shape node: */
+	ShapeNodePointer shape=new ShapeNode;
+	
+	/* Set the shape node's appearance to the mesh file node's appearance: */
+	shape->appearance.setValue(node.appearance.getValue());
+	
+	/* Check if the PLY file defined faces: */
+	if(faceSet!=0)
+		{
+		/* Attach the property nodes to the face set node: */
+		faceSet->color.setValue(color);
+		faceSet->normal.setValue(normal);
+		faceSet->coord.setValue(coord);
+		
+		/* Set up face set parameters: */
+		faceSet->colorPerVertex.setValue(true);
+		faceSet->normalPerVertex.setValue(true);
+		
+		/* Copy face set parameters from the mesh file node: */
+		faceSet->ccw.setValue(node.ccw.getValue());
+		faceSet->solid.setValue(node.solid.getValue());
+		faceSet->creaseAngle.setValue(node.creaseAngle.getValue());
+		
+		/* Finalize the face set and set it as the shape's geometry node: */
+		faceSet->update();
+		shape->geometry.setValue(faceSet);
+		}
+	else
+		{
+		/* Create a point set node to render the vertices read from the PLY file: */
+		Misc::Autopointer<PointSetNode> pointSet=new PointSetNode;
+		
+		/* Attach the property nodes to the point set node: */
+		pointSet->color.setValue(color);
+		pointSet->coord.setValue(coord);
+		
+		/* Copy point set parameters from the mesh file node: */
+		pointSet->pointSize.setValue(node.pointSize.getValue());
+		
+		/* Finalize the point set and set it as the shape's geometry node: */
+		pointSet->update();
+		shape->geometry.setValue(pointSet);
+		}
+	
+	/* Finalize the shape node and add it to the mesh file node's shape list: */
+	shape->update();
+	node.addShape(shape);
+	}
 
 template <class PLYFileParam>
 void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileNode& node)
@@ -64,85 +1134,30 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 		if(element.isElement("vertex")&&element.getNumValues()>0)
 			{
 			/* Get the indices of all supported vertex properties: */
-			const char* colorNames[3]={"red","green","blue"};
-			unsigned int colorIndex[3];
-			int colorMask=0x0;
-			bool colorIsUInt=false;
-			Color::Scalar colorScale(1);
-			const char* normalNames[3]={"nx","ny","nz"};
-			unsigned int normalIndex[3];
-			int normalMask=0x0;
-			const char* coordNames[3]={"x","y","z"};
-			unsigned int coordIndex[3];
-			int coordMask=0x0;
-			unsigned int propertyIndex=0;
-			for(PLYElement::PropertyList::const_iterator pIt=element.propertiesBegin();pIt!=element.propertiesEnd();++pIt,++propertyIndex)
-				if(pIt->getPropertyType()==PLYProperty::SCALAR)
-					{
-					/* Check for any of the supported properties: */
-					for(int i=0;i<3;++i)
-						if(pIt->getName()==colorNames[i])
-							{
-							colorIndex[i]=propertyIndex;
-							colorMask|=0x1<<i;
-							if(colorMask==0x7)
-								{
-								/* Determine the color component scalar type: */
-								switch(pIt->getScalarType())
-									{
-									case PLY_UINT8:
-										colorIsUInt=true;
-										colorScale=Color::Scalar(1)/Color::Scalar(255);
-										break;
-									
-									case PLY_UINT16:
-										colorIsUInt=true;
-										colorScale=Color::Scalar(1)/Color::Scalar(65535);
-										break;
-									
-									case PLY_FLOAT32:
-									case PLY_FLOAT64:
-										colorIsUInt=false;
-										break;
-									
-									default:
-										/* Ignore color values due to unsupported scalar type: */
-										colorMask=0x0;
-									}
-								}
-							}
-					for(int i=0;i<3;++i)
-						if(pIt->getName()==normalNames[i])
-							{
-							normalIndex[i]=propertyIndex;
-							normalMask|=0x1<<i;
-							}
-					for(int i=0;i<3;++i)
-						if(pIt->getName()==coordNames[i])
-							{
-							coordIndex[i]=propertyIndex;
-							coordMask|=0x1<<i;
-							}
-					}
+			VertexProperties vp(element);
 			
 			/* Check that the PLY file at least defines vertex positions: */
-			if(coordMask!=0x7)
+			if(vp.coordMask!=0x7)
 				throw std::runtime_error("Vertex element does not contain x, y, z properties");
 			
 			/* Create property nodes for defined properties: */
-			if(colorMask==0x7)
+			if(vp.colorMask==0x7)
 				color=new ColorNode;
-			if(normalMask==0x7)
+			if(vp.normalMask==0x7)
 				normal=new NormalNode;
 			coord=new CoordinateNode;
 			
 			/* Read vertices based on their defined properties: */
-			if(colorMask==0x7)
+			if(readVertexBlock(element,vp,ply,color.getPointer(),normal.getPointer(),coord.getPointer()))
+				{
+				/* Vertices were read in large blocks */
+				}
+			else if(vp.colorMask==0x7)
 				{
 				/* Check if colors are stored as unsigned integers: */
-				if(colorIsUInt)
+				if(vp.colorIsUInt)
 					{
-					if(normalMask==0x7)
+					if(vp.normalMask==0x7)
 						{
 						/* Read vertex colors, normal vectors, and positions: */
 						MFColor::ValueList& colors=color->color.getValues();
@@ -160,19 +1175,19 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 							/* Extract vertex color: */
 							Color color;
 							for(int i=0;i<3;++i)
-								color[i]=Color::Scalar(vertexValue.getValue(colorIndex[i]).getScalar()->getUnsignedInt())*colorScale;
+								color[i]=Color::Scalar(vertexValue.getValue(vp.colorIndex[i]).getScalar()->getUnsignedInt())*vp.colorScale;
 							colors.push_back(color);
 							
 							/* Extract vertex normal vector: */
 							Vector normal;
 							for(int i=0;i<3;++i)
-								normal[i]=Scalar(vertexValue.getValue(normalIndex[i]).getScalar()->getDouble());
+								normal[i]=Scalar(vertexValue.getValue(vp.normalIndex[i]).getScalar()->getDouble());
 							normals.push_back(normal);
 							
 							/* Extract vertex position: */
 							Point coord;
 							for(int i=0;i<3;++i)
-								coord[i]=Scalar(vertexValue.getValue(coordIndex[i]).getScalar()->getDouble());
+								coord[i]=Scalar(vertexValue.getValue(vp.coordIndex[i]).getScalar()->getDouble());
 							coords.push_back(coord);
 							}
 						}
@@ -192,20 +1207,20 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 							/* Extract vertex color: */
 							Color color;
 							for(int i=0;i<3;++i)
-								color[i]=Color::Scalar(vertexValue.getValue(colorIndex[i]).getScalar()->getUnsignedInt())*colorScale;
+								color[i]=Color::Scalar(vertexValue.getValue(vp.colorIndex[i]).getScalar()->getUnsignedInt())*vp.colorScale;
 							colors.push_back(color);
 							
 							/* Extract vertex position: */
 							Point coord;
 							for(int i=0;i<3;++i)
-								coord[i]=Scalar(vertexValue.getValue(coordIndex[i]).getScalar()->getDouble());
+								coord[i]=Scalar(vertexValue.getValue(vp.coordIndex[i]).getScalar()->getDouble());
 							coords.push_back(coord);
 							}
 						}
 					}
 				else
 					{
-					if(normalMask==0x7)
+					if(vp.normalMask==0x7)
 						{
 						/* Read vertex colors, normal vectors, and positions: */
 						MFColor::ValueList& colors=color->color.getValues();
@@ -223,19 +1238,19 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 							/* Extract vertex color: */
 							Color color;
 							for(int i=0;i<3;++i)
-								color[i]=Color::Scalar(vertexValue.getValue(colorIndex[i]).getScalar()->getDouble());
+								color[i]=Color::Scalar(vertexValue.getValue(vp.colorIndex[i]).getScalar()->getDouble());
 							colors.push_back(color);
 							
 							/* Extract vertex normal vector: */
 							Vector normal;
 							for(int i=0;i<3;++i)
-								normal[i]=Scalar(vertexValue.getValue(normalIndex[i]).getScalar()->getDouble());
+								normal[i]=Scalar(vertexValue.getValue(vp.normalIndex[i]).getScalar()->getDouble());
 							normals.push_back(normal);
 							
 							/* Extract vertex position: */
 							Point coord;
 							for(int i=0;i<3;++i)
-								coord[i]=Scalar(vertexValue.getValue(coordIndex[i]).getScalar()->getDouble());
+								coord[i]=Scalar(vertexValue.getValue(vp.coordIndex[i]).getScalar()->getDouble());
 							coords.push_back(coord);
 							}
 						}
@@ -255,13 +1270,13 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 							/* Extract vertex color: */
 							Color color;
 							for(int i=0;i<3;++i)
-								color[i]=Color::Scalar(vertexValue.getValue(colorIndex[i]).getScalar()->getDouble());
+								color[i]=Color::Scalar(vertexValue.getValue(vp.colorIndex[i]).getScalar()->getDouble());
 							colors.push_back(color);
 							
 							/* Extract vertex position: */
 							Point coord;
 							for(int i=0;i<3;++i)
-								coord[i]=Scalar(vertexValue.getValue(coordIndex[i]).getScalar()->getDouble());
+								coord[i]=Scalar(vertexValue.getValue(vp.coordIndex[i]).getScalar()->getDouble());
 							coords.push_back(coord);
 							}
 						}
@@ -269,7 +1284,7 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 				}
 			else
 				{
-				if(normalMask==0x7)
+				if(vp.normalMask==0x7)
 					{
 					/* Read vertex normal vectors and positions: */
 					MFVector::ValueList& normals=normal->vector.getValues();
@@ -285,13 +1300,13 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 						/* Extract vertex normal vector: */
 						Vector normal;
 						for(int i=0;i<3;++i)
-							normal[i]=Scalar(vertexValue.getValue(normalIndex[i]).getScalar()->getDouble());
+							normal[i]=Scalar(vertexValue.getValue(vp.normalIndex[i]).getScalar()->getDouble());
 						normals.push_back(normal);
 						
 						/* Extract vertex position: */
 						Point coord;
 						for(int i=0;i<3;++i)
-							coord[i]=Scalar(vertexValue.getValue(coordIndex[i]).getScalar()->getDouble());
+							coord[i]=Scalar(vertexValue.getValue(vp.coordIndex[i]).getScalar()->getDouble());
 						coords.push_back(coord);
 						}
 					}
@@ -309,16 +1324,16 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 						/* Extract vertex position: */
 						Point coord;
 						for(int i=0;i<3;++i)
-							coord[i]=Scalar(vertexValue.getValue(coordIndex[i]).getScalar()->getDouble());
+							coord[i]=Scalar(vertexValue.getValue(vp.coordIndex[i]).getScalar()->getDouble());
 						coords.push_back(coord);
 						}
 					}
 				}
 			
 			/* Finalize the property nodes: */
-			if(colorMask==0x7)
+			if(vp.colorMask==0x7)
 				color->update();
-			if(normalMask==0x7)
+			if(vp.normalMask==0x7)
 				normal->update();
 			coord->update();
 			}
@@ -334,16 +1349,19 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 			unsigned int vertexIndicesIndex=element.getPropertyIndex("vertex_indices");
 			if(vertexIndicesIndex>=element.getNumProperties())
 				throw std::runtime_error("Face element does not contain vertex_indices property");
-			for(size_t i=0;i<element.getNumValues();++i)
+			if(!readFaceBlock(element,ply,elementIndex+1==header.getNumElements(),coordIndices))
 				{
-				/* Read face element from file: */
-				faceValue.read(ply);
-				
-				/* Extract vertex indices from face element: */
-				unsigned int numFaceVertices=faceValue.getValue(vertexIndicesIndex).getListSize()->getUnsignedInt();
-				for(unsigned int j=0;j<numFaceVertices;++j)
-					coordIndices.push_back(int(faceValue.getValue(vertexIndicesIndex).getListElement(j)->getUnsignedInt()));
-				coordIndices.push_back(-1);
+				for(size_t i=0;i<element.getNumValues();++i)
+					{
+					/* Read face element from file: */
+					faceValue.read(ply);
+					
+					/* Extract vertex indices from face element: */
+					unsigned int numFaceVertices=faceValue.getValue(vertexIndicesIndex).getListSize()->getUnsignedInt();
+					for(unsigned int j=0;j<numFaceVertices;++j)
+						coordIndices.push_back(int(faceValue.getValue(vertexIndicesIndex).getListElement(j)->getUnsignedInt()));
+					coordIndices.push_back(-1);
+					}
 				}
 			}
 		else
@@ -355,55 +1373,120 @@ void readPlyFileElements(const PLYFileHeader& header,PLYFileParam& ply,MeshFileN
 	
 	/* Check if the PLY file defined vertex coordinates: */
 	if(coord!=0)
+		addPlyShape(color,normal,coord,faceSet,node);
+	}
+
+bool readAsciiPlyFileElements(const PLYFileHeader& header,IO::File& plyFile,MeshFileNode& node) // Parses the body of an ASCII PLY file in large chunks of lines split into parallel bands; returns false if the file has to be read by the generic reader
+	{
+	/* Collect attribute and geometry nodes extracted from the PLY file: */
+	ColorNodePointer color;
+	NormalNodePointer normal;
+	CoordinateNodePointer coord;
+	Misc::Autopointer<IndexedFaceSetNode> faceSet;
+	
+	/* Process all PLY file elements in order, assuming that each element value occupies one line: */
+	ChunkReader reader(plyFile,chunkSize);
+	std::vector<const char*> bandStarts;
+	for(size_t elementIndex=0;elementIndex<header.getNumElements();++elementIndex)
 		{
-		/* Create a new shape node: */
-		ShapeNodePointer shape=new ShapeNode;
-		
-		/* Set the shape node's appearance to the mesh file node's appearance: */
-		shape->appearance.setValue(node.appearance.getValue());
+		/* Get the next element and check if it's the vertex or face element: */
+		const PLYElement& element=header.getElement(elementIndex);
+		bool isVertex=element.isElement("vertex")&&element.getNumValues()>0;
+		bool isFace=!isVertex&&element.isElement("face")&&element.getNumValues()>0;
 		
-		/* Check if the PLY file defined faces: */
-		if(faceSet!=0)
+		/* Prepare to parse the element: */
+		VertexProperties vp(element);
+		PLYDataType listSizeType=PLY_UINT8;
+		PLYDataType listElementType=PLY_UINT32;
+		if(isVertex)
 			{
-			/* Attach the property nodes to the face set node: */
-			faceSet->color.setValue(color);
-			faceSet->normal.setValue(normal);
-			faceSet->coord.setValue(coord);
+			if(element.hasListProperty())
+				return false;
 			
-			/* Set up face set parameters: */
-			faceSet->colorPerVertex.setValue(true);
-			faceSet->normalPerVertex.setValue(true);
-			
-			/* Copy face set parameters from the mesh file node: */
-			faceSet->ccw.setValue(node.ccw.getValue());
-			faceSet->solid.setValue(node.solid.getValue());
-			faceSet->creaseAngle.setValue(node.creaseAngle.getValue());
+			/* Check that the PLY file at least defines vertex positions: */
+			if(vp.coordMask!=0x7)
+				throw std::runtime_error("Vertex element does not contain x, y, z properties");
 			
-			/* Finalize the face set and set it as the shape's geometry node: */
-			faceSet->update();
-			shape->geometry.setValue(faceSet);
+			/* Create property nodes for defined properties: */
+			if(vp.colorMask==0x7)
+				color=new ColorNode;
+			if(vp.normalMask==0x7)
+				normal=new NormalNode;
+			coord=new CoordinateNode;
+			resizeVertexArrays(element.getNumValues(),color.getPointer(),normal.getPointer(),coord.getPointer());
 			}
-		else
+		else if(isFace)
 			{
-			/* Create a point set node to render the vertices read from the PLY file: */
-			Misc::Autopointer<PointSetNode> pointSet=new PointSetNode;
+			if(!isPlainFaceElement(element))
+				return false;
 			
-			/* Attach the property nodes to the point set node: */
-			pointSet->color.setValue(color);
-			pointSet->coord.setValue(coord);
+			/* Create an indexed face set node: */
+			faceSet=new IndexedFaceSetNode;
+			listSizeType=element.propertiesBegin()->getListSizeType();
+			listElementType=element.propertiesBegin()->getListElementType();
+			}
+		VertexWriter writer(vp,color.getPointer(),normal.getPointer(),coord.getPointer());
+		AsciiVertexParser vertexParser(element,writer);
+		AsciiFaceParser faceParser(listSizeType,listElementType);
+		
+		/* Process the element's lines chunk by chunk: */
+		size_t lineIndex=0;
+		while(lineIndex<element.getNumValues())
+			{
+			/* Find complete lines in the current chunk: */
+			size_t numLines;
+			const char* linesEnd=findLines(reader.getData(),reader.getDataEnd(),reader.isEof(),element.getNumValues()-lineIndex,numLines);
+			if(numLines==0)
+				{
+				/* Read more data; let the generic reader deal with truncated files: */
+				if(!reader.fill())
+					return false;
+				continue;
+				}
 			
-			/* Copy point set parameters from the mesh file node: */
-			pointSet->pointSize.setValue(node.pointSize.getValue());
+			if(isVertex||isFace)
+				{
+				/* Split the chunk's lines into bands and parse them in parallel: */
+				unsigned int numBands=getNumBands(linesEnd-reader.getData(),numLines);
+				splitLines(reader.getData(),linesEnd,numLines,numBands,bandStarts);
+				if(isVertex)
+					{
+					vertexParser.setChunk(bandStarts,lineIndex,numLines);
+					processBands(vertexParser,numBands);
+					if(vertexParser.failed())
+						return false;
+					}
+				else
+					{
+					faceParser.setChunk(bandStarts,numLines);
+					processBands(faceParser,numBands);
+					if(faceParser.failed())
+						return false;
+					faceParser.appendIndices(faceSet->coordIndex.getValues());
+					}
+				}
 			
-			/* Finalize the point set and set it as the shape's geometry node: */
-			pointSet->update();
-			shape->geometry.setValue(pointSet);
+			/* Continue with the next chunk: */
+			reader.consume(linesEnd);
+			lineIndex+=numLines;
 			}
 		
-		/* Finalize the shape node and add it to the mesh file node's shape list: */
-		shape->update();
-		node.addShape(shape);
+		if(isVertex)
+			{
+			/* Finalize the property nodes: */
+			if(vp.colorMask==0x7)
+				color->update();
+			if(vp.normalMask==0x7)
+				normal->update();
+			coord->update();
+			}
 		}
+	
+	/* Check if the PLY file defined vertex coordinates: */
+	if(coord!=0)
+		addPlyShape(color,normal,coord,faceSet,node);
+	
+	return true;
 	}
 
 }
@@ -423,11 +1506,19 @@ void readPlyFile(const IO::Directory& directory,const std::string& fileName,Mesh
 		/* Read the PLY file in ASCII or binary mode: */
 		if(header.getFileType()==PLYFileHeader::Ascii)
 			{
-			/* Attach a value source to the PLY file: */
-			IO::ValueSource ply(plyFile);
-			
-			/* Read the PLY file in ASCII mode: */
-			readPlyFileElements(header,ply,node);
+			/* Parse the PLY file in large chunks of lines in parallel: */
+			if(!readAsciiPlyFileElements(header,*plyFile,node))
+				{
+				/* Re-open the PLY file: */
+				plyFile=directory.openFile(fileName.c_str());
+				PLYFileHeader asciiHeader(*plyFile);
+				
+				/* Attach a value source to the PLY file: */
+				IO::ValueSource ply(plyFile);
+				
+				/* Read the PLY file in ASCII mode: */
+				readPlyFileElements(asciiHeader,ply,node);
+				}
 			}
 		else
 			{
@@ -1,7 +1,7 @@
 /***********************************************************************
 MeshFileNode - Meta node class to represent the contents of a mesh file
 in one of several supported formats as a sub-scene graph.
-Copyright (c) 2018-2019 Oliver Kreylos
+Copyright (c) 2018-2020 Oliver Kreylos
 
 This file is part of the Simple Scene Graph Renderer (SceneGraph).
 
@@ -23,8 +23,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <SceneGraph/MeshFileNode.h>
 
 #include <string.h>
+#include <iostream>
 #include <Misc/ThrowStdErr.h>
+#include <Misc/Timer.h>
 #include <SceneGraph/VRMLFile.h>
+#include <SceneGraph/Internal/MeshFileCache.h>
 #include <SceneGraph/Internal/ReadPlyFile.h>
 #include <SceneGraph/Internal/ReadObjFile.h>
 
@@ -35,7 +38,8 @@ Methods of class MeshFileNode:
 *****************************/
 
 MeshFileNode::MeshFileNode(void)
-	:disableTextures(false),ccw(true),solid(true),pointSize(1)
+	:disableTextures(false),ccw(true),solid(true),pointSize(1),useCache(true),reportLoadTime(false),
+	 loadTime(0.0)
 	{
 	}
 
@@ -74,6 +78,10 @@ void MeshFileNode::parseField(const char* fieldName,VRMLFile& vrmlFile)
 		vrmlFile.parseField(creaseAngle);
 	else if(strcmp(fieldName,"pointSize")==0)
 		vrmlFile.parseField(pointSize);
+	else if(strcmp(fieldName,"useCache")==0)
+		vrmlFile.parseField(useCache);
+	else if(strcmp(fieldName,"reportLoadTime")==0)
+		vrmlFile.parseField(reportLoadTime);
 	else
 		GraphNode::parseField(fieldName,vrmlFile);
 	}
@@ -99,13 +107,34 @@ void MeshFileNode::update(void)
 	for(extIt=endIt;extIt>=url.getValue(0).begin()&&*extIt!='.';--extIt)
 		;
 	
-	/* Read a mesh file: */
-	if(extIt>url.getValue(0).begin()&&strncasecmp(&*extIt,".ply",endIt-extIt)==0)
-		readPlyFile(*baseDirectory,url.getValue(0),*this);
-	else if(extIt>url.getValue(0).begin()&&strncasecmp(&*extIt,".obj",endIt-extIt)==0)
-		readObjFile(*baseDirectory,url.getValue(0),*this);
-	else
+	/* Determine the mesh file's format: */
+	bool isPly=extIt>url.getValue(0).begin()&&strncasecmp(&*extIt,".ply",endIt-extIt)==0;
+	bool isObj=extIt>url.getValue(0).begin()&&strncasecmp(&*extIt,".obj",endIt-extIt)==0;
+	if(!isPly&&!isObj)
 		Misc::throwStdErr("SceneGraph::MeshFileNode: Mesh file %s has unknown format",url.getValue(0).c_str());
+	
+	Misc::Timer loadTimer;
+	
+	/* Try restoring the mesh file's shapes from an up-to-date cache file: */
+	MeshFileCache cache(*baseDirectory,url.getValue(0));
+	bool fromCache=useCache.getValue()&&cache.load(*baseDirectory,*this);
+	if(!fromCache)
+		{
+		/* Read a mesh file: */
+		if(isPly)
+			readPlyFile(*baseDirectory,url.getValue(0),*this);
+		else
+			readObjFile(*baseDirectory,url.getValue(0),*this,&cache);
+		
+		/* Store the read shapes in a cache file for next time: */
+		if(useCache.getValue())
+			cache.save(*this);
+		}
+	
+	loadTimer.elapse();
+	loadTime=loadTimer.getTime();
+	if(reportLoadTime.getValue())
+		std::cout<<"SceneGraph::MeshFileNode: Loaded mesh file "<<url.getValue(0)<<(fromCache?" from cache":"")<<" in "<<loadTime*1000.0<<" ms"<<std::endl;
 	}
 
 Box MeshFileNode::calcBoundingBox(void) const
@@ -1,7 +1,7 @@
 /***********************************************************************
 MeshFileNode - Meta node class to represent the contents of a mesh file
 in one of several supported formats as a sub-scene graph.
-Copyright (c) 2018-2019 Oliver Kreylos
+Copyright (c) 2018-2020 Oliver Kreylos
 
 This file is part of the Simple Scene Graph Renderer (SceneGraph).
 
@@ -53,11 +53,14 @@ class MeshFileNode:public GraphNode
 	SFBool solid; // Flag whether the mesh file defines a solid surfaces whose backfaces are not rendered
 	SFFloat pointSize; // Cosmetic point size for rendering points
 	SFFloat creaseAngle; // Maximum angle between adjacent faces to create a sharp edge
+	SFBool useCache; // Flag whether to store the mesh file's shapes in a binary cache file and restore them from there when the mesh file is loaded again
+	SFBool reportLoadTime; // Flag whether to print the time it took to load the mesh file
 	
 	/* Derived elements: */
 	protected:
 	IO::DirectoryPtr baseDirectory; // Base directory for relative URLs
 	std::vector<ShapeNodePointer> shapes; // List of shape nodes read from the mesh file
+	double loadTime; // Time in seconds it took to load the mesh file during the last update
 	
 	/* Constructors and destructors: */
 	public:
@@ -75,6 +78,18 @@ class MeshFileNode:public GraphNode
 	
 	/* New methods: */
 	void addShape(ShapeNodePointer newShape); // Adds a shape node to the representation
+	unsigned int getNumShapes(void) const // Returns the number of shape nodes in the representation
+		{
+		return (unsigned int)(shapes.size());
+		}
+	ShapeNodePointer getShape(unsigned int index) const // Returns the shape node of the given index
+		{
+		return shapes[index];
+		}
+	double getLoadTime(void) const // Returns the time in seconds it took to load the mesh file during the last update
+		{
+		return loadTime;
+		}
 	};
 
 }
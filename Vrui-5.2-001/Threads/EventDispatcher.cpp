@@ -1,7 +1,7 @@
 /***********************************************************************
 EventDispatcher - Class to dispatch events from a central listener to
 any number of interested clients.
-Copyright (c) 2016-2019 Oliver Kreylos
+Copyright (c) 2016-2020 Oliver Kreylos
 
 This file is part of the Portable Threading Library (Threads).
 
@@ -29,6 +29,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
+#if THREADS_CONFIG_HAVE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 #include <stdexcept>
 #include <Misc/ThrowStdErr.h>
 #include <Misc/MessageLogger.h>
@@ -42,6 +46,11 @@ Helper functions:
 ****************/
 
 EventDispatcher* stopDispatcher=0; // Event dispatcher to be stopped when a SIGINT or SIGTERM occur
+#if THREADS_CONFIG_HAVE_EPOLL
+const uint64_t pipeEventTag=uint64_t(1)<<32; // Tag identifying epoll events on the self-pipe; cannot collide with any listener key
+const uint64_t timerEventTag=uint64_t(2)<<32; // Tag identifying epoll events on the timer descriptor
+const int maxNumEpollEvents=64; // Maximum number of events retrieved by one call to epoll_wait
+#endif
 
 void stopSignalHandler(int signum)
 	{
@@ -65,10 +74,24 @@ struct EventDispatcher::IOEventListener
 	int typeMask; // Mask of event types (read, write, exception) in which the listener is interested
 	IOEventCallback callback; // Function called when an event occurs
 	void* callbackUserData; // Opaque pointer to be passed to callback function
+	#if THREADS_CONFIG_HAVE_EPOLL
+	enum WatchState // Enumerated type for the ways in which the listener's file descriptor can be watched
+		{
+		Unwatched, // File descriptor is not in the epoll set
+		Watched, // File descriptor is in the epoll set
+		HungUp, // File descriptor was taken out of the epoll set after an error or hang-up that the listener is not interested in
+		AlwaysReady // File descriptor does not support epoll, e.g., a regular file, and is treated as always ready like select does
+		};
+	
+	WatchState watchState; // How the listener's file descriptor is currently watched
+	#endif
 	
 	/* Constructors and destructors: */
 	IOEventListener(ListenerKey sKey,int sFd,int sTypeMask,IOEventCallback sCallback,void* sCallbackUserData)
 		:key(sKey),fd(sFd),typeMask(sTypeMask),callback(sCallback),callbackUserData(sCallbackUserData)
+		 #if THREADS_CONFIG_HAVE_EPOLL
+		 ,watchState(Unwatched)
+		 #endif
 		{
 		}
 	};
@@ -306,8 +329,61 @@ void EventDispatcher::writePipeMessage(const EventDispatcher::PipeMessage& pm,co
 		}
 	}
 
-void EventDispatcher::updateFdSets(int fd,int oldEventMask,int newEventMask)
+void EventDispatcher::updateEventMask(EventDispatcher::IOEventListener& listener,int oldEventMask)
 	{
+	#if THREADS_CONFIG_HAVE_EPOLL
+	
+	/* Stop watching the file descriptor if the listener has no more interests, to suppress error and hang-up events: */
+	if(listener.typeMask==0x0)
+		{
+		if(listener.watchState==IOEventListener::Watched)
+			{
+			/* Closed file descriptors are removed from the epoll set automatically: */
+			struct epoll_event event;
+			memset(&event,0,sizeof(struct epoll_event));
+			if(epoll_ctl(epollFd,EPOLL_CTL_DEL,listener.fd,&event)<0&&errno!=EBADF&&errno!=ENOENT)
+				Misc::formattedLogWarning("Threads::EventDispatcher: Error %d (%s) while unwatching file descriptor %d",errno,strerror(errno),listener.fd);
+			}
+		else if(listener.watchState==IOEventListener::AlwaysReady)
+			--numAlwaysReadyListeners;
+		listener.watchState=IOEventListener::Unwatched;
+		
+		return;
+		}
+	
+	/* Leave always-ready file descriptors alone, and hung-up file descriptors until the listener is interested in reads or writes again: */
+	if(listener.watchState==IOEventListener::AlwaysReady||(listener.watchState==IOEventListener::HungUp&&(listener.typeMask&(Read|Write))==0x0))
+		return;
+	
+	/* Translate the listener's interest mask into an epoll event: */
+	struct epoll_event event;
+	memset(&event,0,sizeof(struct epoll_event));
+	if(listener.typeMask&Read)
+		event.events|=EPOLLIN;
+	if(listener.typeMask&Write)
+		event.events|=EPOLLOUT;
+	if(listener.typeMask&Exception)
+		event.events|=EPOLLPRI;
+	event.data.u64=listener.key;
+	
+	/* Add or modify the file descriptor: */
+	int op=listener.watchState==IOEventListener::Watched?EPOLL_CTL_MOD:EPOLL_CTL_ADD;
+	if(epoll_ctl(epollFd,op,listener.fd,&event)>=0)
+		listener.watchState=IOEventListener::Watched;
+	else if(op==EPOLL_CTL_ADD&&errno==EPERM)
+		{
+		/* The file descriptor, e.g., a regular file or a redirected stdin, does not support epoll; treat it as always ready like select does: */
+		listener.watchState=IOEventListener::AlwaysReady;
+		++numAlwaysReadyListeners;
+		}
+	else
+		Misc::formattedLogWarning("Threads::EventDispatcher: Error %d (%s) while watching file descriptor %d",errno,strerror(errno),listener.fd);
+	
+	#else
+	
+	int fd=listener.fd;
+	int newEventMask=listener.typeMask;
+	
 	/* Check if the read set needs to be updated: */
 	if((oldEventMask^newEventMask)&Read)
 		{
@@ -373,20 +449,226 @@ void EventDispatcher::updateFdSets(int fd,int oldEventMask,int newEventMask)
 					maxFd=it->fd;
 			}
 		}
+	
+	#endif
+	}
+
+void EventDispatcher::addIOEventListenerInternal(const EventDispatcher::IOEventListener& listener)
+	{
+	/* Append the input/output event listener to the list and remember its position: */
+	ioEventListenerIndices.setEntry(IOEventListenerIndexMap::Entry(listener.key,ioEventListeners.size()));
+	ioEventListeners.push_back(listener);
+	
+	/* Start watching the listener's file descriptor: */
+	updateEventMask(ioEventListeners.back(),0x0);
+	}
+
+void EventDispatcher::removeIOEventListenerInternal(size_t listenerIndex)
+	{
+	/* Remove the input/output event listener from the list by moving the last listener into its place: */
+	IOEventListener listener=ioEventListeners[listenerIndex];
+	ioEventListenerIndices.removeEntry(listener.key);
+	if(listenerIndex+1<ioEventListeners.size())
+		{
+		ioEventListeners[listenerIndex]=ioEventListeners.back();
+		ioEventListenerIndices.setEntry(IOEventListenerIndexMap::Entry(ioEventListeners[listenerIndex].key,listenerIndex));
+		}
+	ioEventListeners.pop_back();
+	
+	/* Stop watching the listener's file descriptor: */
+	int typeMask=listener.typeMask;
+	listener.typeMask=0x0;
+	updateEventMask(listener,typeMask);
+	}
+
+bool EventDispatcher::handlePipeMessages(void)
+	{
+	/* Read and handle pipe messages: */
+	size_t numMessages=readPipeMessages();
+	PipeMessage* pmPtr=messages;
+	for(size_t i=0;i<numMessages;++i,++pmPtr)
+		{
+		switch(pmPtr->messageType)
+			{
+			case PipeMessage::INTERRUPT: // Interrupt wait
+				
+				/* Do nothing */
+				
+				break;
+			
+			case PipeMessage::STOP: // Stop dispatching events
+				return false;
+				break;
+			
+			case PipeMessage::ADD_IO_LISTENER: // Add input/output event listener
+				
+				/* Add the new input/output event listener to the list: */
+				addIOEventListenerInternal(IOEventListener(pmPtr->addIOListener.key,pmPtr->addIOListener.fd,pmPtr->addIOListener.typeMask,pmPtr->addIOListener.callback,pmPtr->addIOListener.callbackUserData));
+				
+				break;
+			
+			case PipeMessage::SET_IO_LISTENER_TYPEMASK: // Change the event type mask of an input/output event listener
+				{
+				/* Find the input/output event listener with the given key: */
+				IOEventListenerIndexMap::Iterator ielIt=ioEventListenerIndices.findEntry(pmPtr->setIOListenerEventTypeMask.key);
+				if(!ielIt.isFinished())
+					{
+					/* Update the input/output event listener: */
+					IOEventListener& el=ioEventListeners[ielIt->getDest()];
+					int typeMask=el.typeMask;
+					el.typeMask=pmPtr->setIOListenerEventTypeMask.newTypeMask;
+					
+					/* Update the set of watched file descriptors: */
+					updateEventMask(el,typeMask);
+					}
+				
+				break;
+				}
+			
+			case PipeMessage::REMOVE_IO_LISTENER: // Remove input/output event listener
+				{
+				/* Find the input/output event listener with the given key: */
+				IOEventListenerIndexMap::Iterator ielIt=ioEventListenerIndices.findEntry(pmPtr->removeIOListener);
+				if(!ielIt.isFinished())
+					{
+					/* Remove the input/output event listener from the list: */
+					removeIOEventListenerInternal(ielIt->getDest());
+					}
+				
+				break;
+				}
+			
+			case PipeMessage::ADD_TIMER_LISTENER: // Add timer event listener
+				
+				/* Add the new timer event listener to the heap: */
+				timerEventListeners.insert(new TimerEventListener(pmPtr->addTimerListener.key,pmPtr->addTimerListener.time,pmPtr->addTimerListener.interval,pmPtr->addTimerListener.callback,pmPtr->addTimerListener.callbackUserData));
+				
+				break;
+			
+			case PipeMessage::REMOVE_TIMER_LISTENER: // Remove timer event listener
+				
+				/* Find the timer event listener with the given key: */
+				for(TimerEventListenerHeap::Iterator elIt=timerEventListeners.begin();elIt!=timerEventListeners.end();++elIt)
+					if((*elIt)->key==pmPtr->removeTimerListener)
+						{
+						/* Remove the timer event listener from the heap: */
+						delete *elIt;
+						timerEventListeners.remove(elIt);
+						
+						/* Stop looking: */
+						break;
+						}
+				
+				break;
+			
+			case PipeMessage::ADD_PROCESS_LISTENER:
+				
+				/* Add the new process listener to the list: */
+				processListeners.push_back(ProcessListener(pmPtr->addProcessListener.key,pmPtr->addProcessListener.callback,pmPtr->addProcessListener.callbackUserData));
+				
+				break;
+			
+			case PipeMessage::REMOVE_PROCESS_LISTENER:
+				
+				/* Find the process listener with the given key: */
+				for(std::vector<ProcessListener>::iterator plIt=processListeners.begin();plIt!=processListeners.end();++plIt)
+					if(plIt->key==pmPtr->removeProcessListener)
+						{
+						/* Remove the process listener from the list: */
+						*plIt=processListeners.back();
+						processListeners.pop_back();
+						
+						/* Stop looking: */
+						break;
+						}
+				
+				break;
+			
+			case PipeMessage::ADD_SIGNAL_LISTENER:
+				
+				/* Add the new signal listener to the map: */
+				signalListeners.setEntry(SignalListenerMap::Entry(pmPtr->addSignalListener.key,SignalListener(pmPtr->addSignalListener.key,pmPtr->addSignalListener.callback,pmPtr->addSignalListener.callbackUserData)));
+				
+				break;
+			
+			case PipeMessage::REMOVE_SIGNAL_LISTENER:
+				
+				/* Remove the signal listener with the given key from the map: */
+				signalListeners.removeEntry(pmPtr->removeSignalListener);
+				
+				break;
+			
+			case PipeMessage::SIGNAL:
+				{
+				/* Find the signal listener with the given key in the map: */
+				SignalListener& sl=signalListeners.getEntry(pmPtr->signal.key).getDest();
+				
+				/* Call the callback: */
+				sl.callback(sl.key,pmPtr->signal.signalData,sl.callbackUserData);
+				
+				break;
+				}
+			
+			default:
+				/* Do nothing: */
+				
+				// DEBUGGING
+				Misc::formattedLogWarning("Threads::EventDispatcher::handlePipeMessages: Unknown pipe message %d",pmPtr->messageType);
+			}
+		}
+	
+	return true;
 	}
 
 EventDispatcher::EventDispatcher(void)
 	:numMessages(4096/sizeof(PipeMessage)),messages(new PipeMessage[numMessages]),messageReadSize(0),
 	 nextKey(0),
+	 ioEventListenerIndices(17),
 	 signalListeners(17),
+	 #if THREADS_CONFIG_HAVE_EPOLL
+	 epollFd(-1),timerFd(-1),timerFdArmed(false),numAlwaysReadyListeners(0)
+	 #else
 	 numReadFds(0),numWriteFds(0),numExceptionFds(0),
 	 hadBadFd(false)
+	 #endif
 	{
 	/* Create the self-pipe: */
 	pipeFds[1]=pipeFds[0]=-1;
 	if(pipe2(pipeFds,O_NONBLOCK)<0)
 		Misc::throwStdErr("Misc::EventDispatcher: Cannot open event pipe due to error %d (%s)",errno,strerror(errno));
 	
+	#if THREADS_CONFIG_HAVE_EPOLL
+	
+	/* Create the epoll instance and the timer descriptor: */
+	epollFd=epoll_create1(EPOLL_CLOEXEC);
+	if(epollFd>=0)
+		timerFd=timerfd_create(CLOCK_REALTIME,TFD_NONBLOCK|TFD_CLOEXEC);
+	
+	/* Watch the self-pipe and the timer descriptor for reads: */
+	bool ok=epollFd>=0&&timerFd>=0;
+	struct epoll_event event;
+	memset(&event,0,sizeof(struct epoll_event));
+	event.events=EPOLLIN;
+	event.data.u64=pipeEventTag;
+	ok=ok&&epoll_ctl(epollFd,EPOLL_CTL_ADD,pipeFds[0],&event)>=0;
+	event.data.u64=timerEventTag;
+	ok=ok&&epoll_ctl(epollFd,EPOLL_CTL_ADD,timerFd,&event)>=0;
+	if(!ok)
+		{
+		/* Clean up and signal an error: */
+		int error=errno;
+		if(timerFd>=0)
+			close(timerFd);
+		if(epollFd>=0)
+			close(epollFd);
+		close(pipeFds[0]);
+		close(pipeFds[1]);
+		delete[] messages;
+		Misc::throwStdErr("Misc::EventDispatcher: Cannot create event poller due to error %d (%s)",error,strerror(error));
+		}
+	
+	#else
+	
 	/* Initialize the three file descriptor sets: */
 	FD_ZERO(&readFds);
 	FD_ZERO(&writeFds);
@@ -396,10 +678,20 @@ EventDispatcher::EventDispatcher(void)
 	FD_SET(pipeFds[0],&readFds);
 	numReadFds=1;
 	maxFd=pipeFds[0];
+	
+	#endif
 	}
 
 EventDispatcher::~EventDispatcher(void)
 	{
+	#if THREADS_CONFIG_HAVE_EPOLL
+	
+	/* Close the epoll instance and the timer descriptor: */
+	close(timerFd);
+	close(epollFd);
+	
+	#endif
+	
 	/* Close the self-pipe: */
 	close(pipeFds[0]);
 	close(pipeFds[1]);
@@ -424,8 +716,8 @@ bool EventDispatcher::dispatchNextEvent(void)
 		interval=tel->time;
 		interval-=dispatchTime;
 		
-		/* Bail out if the event is still in the future: */
-		if(interval.tv_sec>=0)
+		/* Bail out if the event is still in the future; events due at exactly the current time are dispatched now, so that a timer armed for them can't fire repeatedly: */
+		if(interval.tv_sec>0||(interval.tv_sec==0&&interval.tv_usec>0))
 			break;
 		
 		/* Call the event callback: */
@@ -440,7 +732,7 @@ bool EventDispatcher::dispatchNextEvent(void)
 			/* Move the event time to the next iteration that is still in the future and count the number of missed events: */
 			tel->time+=tel->interval;
 			// unsigned int numMissedEvents=0; // Need to figure out how to communicate this to timer event handlers in a meaningful way
-			while(!(dispatchTime<=tel->time))
+			while(tel->time<=dispatchTime)
 				{
 				// ++numMissedEvents;
 				tel->time+=tel->interval;
@@ -451,6 +743,127 @@ bool EventDispatcher::dispatchNextEvent(void)
 			}
 		}
 	
+	#if THREADS_CONFIG_HAVE_EPOLL
+	
+	/* Arm the timer descriptor for the next timer event, or disarm it if there are no timer events: */
+	struct itimerspec timerSpec;
+	memset(&timerSpec,0,sizeof(struct itimerspec));
+	if(!timerEventListeners.isEmpty())
+		{
+		const Time& nextTime=timerEventListeners.getSmallest()->time;
+		if(!timerFdArmed||timerFdTime!=nextTime)
+			{
+			timerSpec.it_value.tv_sec=nextTime.tv_sec;
+			timerSpec.it_value.tv_nsec=nextTime.tv_usec*1000L;
+			if(timerfd_settime(timerFd,TFD_TIMER_ABSTIME,&timerSpec,0)<0)
+				{
+				int error=errno;
+				Misc::throwStdErr("Threads::EventDispatcher::dispatchNextEvent: Error %d (%s) while arming timer",error,strerror(error));
+				}
+			timerFdArmed=true;
+			timerFdTime=nextTime;
+			}
+		}
+	else if(timerFdArmed)
+		{
+		timerfd_settime(timerFd,0,&timerSpec,0);
+		timerFdArmed=false;
+		}
+	
+	/* Wait for the next event on any watched file descriptor, including the self-pipe and the timer descriptor, or only poll if there are always-ready file descriptors: */
+	struct epoll_event events[maxNumEpollEvents];
+	int numEvents=epoll_wait(epollFd,events,maxNumEpollEvents,numAlwaysReadyListeners>0?0:-1);
+	
+	/* Update the dispatch time point: */
+	dispatchTime=Time::now();
+	
+	/* Handle all received events: */
+	if(numEvents>0)
+		{
+		/* Handle messages on the self-pipe and timer expirations first: */
+		for(int i=0;i<numEvents;++i)
+			{
+			if(events[i].data.u64==pipeEventTag)
+				{
+				/* Read and handle pipe messages: */
+				if(!handlePipeMessages())
+					return false;
+				}
+			else if(events[i].data.u64==timerEventTag)
+				{
+				/* Reset the timer descriptor; the elapsed timer events will be dispatched on the next iteration: */
+				uint64_t numExpirations;
+				if(read(timerFd,&numExpirations,sizeof(uint64_t))<0&&errno!=EAGAIN&&errno!=EWOULDBLOCK)
+					Misc::formattedLogWarning("Threads::EventDispatcher::dispatchNextEvent: Error %d (%s) while reading timer",errno,strerror(errno));
+				timerFdArmed=false;
+				}
+			}
+		
+		/* Handle all input/output events: */
+		for(int i=0;i<numEvents;++i)
+			{
+			/* Skip events on the self-pipe or timer descriptor: */
+			if(events[i].data.u64>>32)
+				continue;
+			
+			/* Find the event's listener; it might have been removed by a pipe message or an earlier callback: */
+			IOEventListenerIndexMap::Iterator ielIt=ioEventListenerIndices.findEntry(ListenerKey(events[i].data.u64));
+			if(ielIt.isFinished())
+				continue;
+			size_t listenerIndex=ielIt->getDest();
+			IOEventListener& el=ioEventListeners[listenerIndex];
+			
+			/* Determine all event types on the listener's file descriptor; errors and hang-ups count as reads and writes like they do for select: */
+			int eventTypeMask=0x0;
+			if(events[i].events&(EPOLLIN|EPOLLERR|EPOLLHUP))
+				eventTypeMask|=Read;
+			if(events[i].events&(EPOLLOUT|EPOLLERR|EPOLLHUP))
+				eventTypeMask|=Write;
+			if(events[i].events&EPOLLPRI)
+				eventTypeMask|=Exception;
+			
+			/* Limit to events in which the listener is interested: */
+			eventTypeMask&=el.typeMask;
+			
+			if(eventTypeMask!=0x0)
+				{
+				/* Call the listener's event callback and check whether the listener wants to be removed: */
+				if(el.callback(el.key,eventTypeMask,el.callbackUserData))
+					removeIOEventListenerInternal(listenerIndex);
+				}
+			else if(events[i].events&(EPOLLERR|EPOLLHUP))
+				{
+				/* Take the file descriptor out of the epoll set, which would otherwise report the error or hang-up continuously: */
+				if(epoll_ctl(epollFd,EPOLL_CTL_DEL,el.fd,&events[i])<0&&errno!=EBADF&&errno!=ENOENT)
+					Misc::formattedLogWarning("Threads::EventDispatcher: Error %d (%s) while unwatching file descriptor %d",errno,strerror(errno),el.fd);
+				el.watchState=IOEventListener::HungUp;
+				}
+			}
+		}
+	else if(numEvents<0&&errno!=EINTR)
+		{
+		int error=errno;
+		Misc::throwStdErr("Threads::EventDispatcher::dispatchNextEvent: Error %d (%s) during epoll_wait",error,strerror(error));
+		}
+	
+	/* Signal read and write events on all always-ready file descriptors: */
+	if(numAlwaysReadyListeners>0)
+		{
+		for(size_t listenerIndex=0;listenerIndex<ioEventListeners.size();++listenerIndex)
+			{
+			IOEventListener& el=ioEventListeners[listenerIndex];
+			int eventTypeMask=el.typeMask&(Read|Write);
+			if(el.watchState==IOEventListener::AlwaysReady&&eventTypeMask!=0x0&&el.callback(el.key,eventTypeMask,el.callbackUserData))
+				{
+				/* Remove the event listener from the list and check the listener that took its place next: */
+				removeIOEventListenerInternal(listenerIndex);
+				--listenerIndex;
+				}
+			}
+		}
+	
+	#else
+	
 	/* Create lists of watched file descriptors: */
 	fd_set rds,wds,eds;
 	int numRfds,numWfds,numEfds,numFds;
@@ -503,172 +916,32 @@ bool EventDispatcher::dispatchNextEvent(void)
 		if(FD_ISSET(pipeFds[0],&rds))
 			{
 			/* Read and handle pipe messages: */
-			size_t numMessages=readPipeMessages();
-			PipeMessage* pmPtr=messages;
-			for(size_t i=0;i<numMessages;++i,++pmPtr)
-				{
-				switch(pmPtr->messageType)
-					{
-					case PipeMessage::INTERRUPT: // Interrupt wait
-						
-						/* Do nothing */
-						
-						break;
-					
-					case PipeMessage::STOP: // Stop dispatching events
-						return false;
-						break;
-					
-					case PipeMessage::ADD_IO_LISTENER: // Add input/output event listener
-						
-						/* Add the new input/output event listener to the list: */
-						ioEventListeners.push_back(IOEventListener(pmPtr->addIOListener.key,pmPtr->addIOListener.fd,pmPtr->addIOListener.typeMask,pmPtr->addIOListener.callback,pmPtr->addIOListener.callbackUserData));
-						
-						/* Update the file descriptor sets: */
-						updateFdSets(pmPtr->addIOListener.fd,0x0,pmPtr->addIOListener.typeMask);
-						
-						break;
-					
-					case PipeMessage::SET_IO_LISTENER_TYPEMASK: // Change the event type mask of an input/output event listener
-						
-						/* Find the input/output event listener with the given key: */
-						for(std::vector<IOEventListener>::iterator elIt=ioEventListeners.begin();elIt!=ioEventListeners.end();++elIt)
-							if(elIt->key==pmPtr->setIOListenerEventTypeMask.key)
-								{
-								/* Update the input/output event listener: */
-								int typeMask=elIt->typeMask;
-								elIt->typeMask=pmPtr->setIOListenerEventTypeMask.newTypeMask;
-								
-								/* Update the file descriptor sets: */
-								updateFdSets(elIt->fd,typeMask,elIt->typeMask);
-								
-								/* Stop looking: */
-								break;
-								}
-						
-						break;
-					
-					case PipeMessage::REMOVE_IO_LISTENER: // Remove input/output event listener
-						
-						/* Find the input/output event listener with the given key: */
-						for(std::vector<IOEventListener>::iterator elIt=ioEventListeners.begin();elIt!=ioEventListeners.end();++elIt)
-							if(elIt->key==pmPtr->removeIOListener)
-								{
-								/* Remove the input/output event listener from the list: */
-								int fd=elIt->fd;
-								int typeMask=elIt->typeMask;
-								*elIt=ioEventListeners.back();
-								ioEventListeners.pop_back();
-								
-								/* Update the file descriptor sets: */
-								updateFdSets(fd,typeMask,0x0);
-								
-								/* Stop looking: */
-								break;
-								}
-						
-						break;
-					
-					case PipeMessage::ADD_TIMER_LISTENER: // Add timer event listener
-						
-						/* Add the new timer event listener to the heap: */
-						timerEventListeners.insert(new TimerEventListener(pmPtr->addTimerListener.key,pmPtr->addTimerListener.time,pmPtr->addTimerListener.interval,pmPtr->addTimerListener.callback,pmPtr->addTimerListener.callbackUserData));
-						
-						break;
-					
-					case PipeMessage::REMOVE_TIMER_LISTENER: // Remove timer event listener
-						
-						/* Find the timer event listener with the given key: */
-						for(TimerEventListenerHeap::Iterator elIt=timerEventListeners.begin();elIt!=timerEventListeners.end();++elIt)
-							if((*elIt)->key==pmPtr->removeTimerListener)
-								{
-								/* Remove the timer event listener from the heap: */
-								delete *elIt;
-								timerEventListeners.remove(elIt);
-								
-								/* Stop looking: */
-								break;
-								}
-						
-						break;
-					
-					case PipeMessage::ADD_PROCESS_LISTENER:
-						
-						/* Add the new process listener to the list: */
-						processListeners.push_back(ProcessListener(pmPtr->addProcessListener.key,pmPtr->addProcessListener.callback,pmPtr->addProcessListener.callbackUserData));
-						
-						break;
-					
-					case PipeMessage::REMOVE_PROCESS_LISTENER:
-						
-						/* Find the process listener with the given key: */
-						for(std::vector<ProcessListener>::iterator plIt=processListeners.begin();plIt!=processListeners.end();++plIt)
-							if(plIt->key==pmPtr->removeProcessListener)
-								{
-								/* Remove the process listener from the list: */
-								*plIt=processListeners.back();
-								processListeners.pop_back();
-								
-								/* Stop looking: */
-								break;
-								}
-						
-						break;
-					
-					case PipeMessage::ADD_SIGNAL_LISTENER:
-						
-						/* Add the new signal listener to the map: */
-						signalListeners.setEntry(SignalListenerMap::Entry(pmPtr->addSignalListener.key,SignalListener(pmPtr->addSignalListener.key,pmPtr->addSignalListener.callback,pmPtr->addSignalListener.callbackUserData)));
-						
-						break;
-					
-					case PipeMessage::REMOVE_SIGNAL_LISTENER:
-						
-						/* Remove the signal listener with the given key from the map: */
-						signalListeners.removeEntry(pmPtr->removeSignalListener);
-						
-						break;
-					
-					case PipeMessage::SIGNAL:
-						{
-						/* Find the signal listener with the given key in the map: */
-						SignalListener& sl=signalListeners.getEntry(pmPtr->signal.key).getDest();
-						
-						/* Call the callback: */
-						sl.callback(sl.key,pmPtr->signal.signalData,sl.callbackUserData);
-						
-						break;
-						}
-						
-					default:
-						/* Do nothing: */
-						
-						// DEBUGGING
-						Misc::formattedLogWarning("Threads::EventDispatcher::dispatchNextEvent: Unknown pipe message %d",pmPtr->messageType);
-					}
-				}
+			if(!handlePipeMessages())
+				return false;
 			
 			--numSetFds;
 			}
 		
 		/* Handle all input/output events: */
-		for(std::vector<IOEventListener>::iterator elIt=ioEventListeners.begin();numSetFds>0&&elIt!=ioEventListeners.end();++elIt)
+		for(size_t listenerIndex=0;numSetFds>0&&listenerIndex<ioEventListeners.size();++listenerIndex)
 			{
+			IOEventListener& el=ioEventListeners[listenerIndex];
+			
 			/* Determine all event types on the listener's file descriptor: */
 			int eventTypeMask=0x0;
-			if(numRfds>0&&FD_ISSET(elIt->fd,&rds))
+			if(numRfds>0&&FD_ISSET(el.fd,&rds))
 				{
 				/* Signal a read event: */
 				eventTypeMask|=Read;
 				--numSetFds;
 				}
-			if(numWfds>0&&FD_ISSET(elIt->fd,&wds))
+			if(numWfds>0&&FD_ISSET(el.fd,&wds))
 				{
 				/* Signal a write event: */
 				eventTypeMask|=Write;
 				--numSetFds;
 				}
-			if(numEfds>0&&FD_ISSET(elIt->fd,&eds))
+			if(numEfds>0&&FD_ISSET(el.fd,&eds))
 				{
 				/* Signal an exception event: */
 				eventTypeMask|=Exception;
@@ -676,22 +949,18 @@ bool EventDispatcher::dispatchNextEvent(void)
 				}
 			
 			/* Limit to events in which the listener is interested: */
-			int interestEventTypeMask=eventTypeMask&elIt->typeMask;
+			int interestEventTypeMask=eventTypeMask&el.typeMask;
 			
 			/* Check for spurious events: */
 			if(interestEventTypeMask!=eventTypeMask)
 				Misc::logWarning("Threads::EventDispatcher::dispatchNextEvent: Spurious event");
 			
 			/* Call the listener's event callback and check whether the listener wants to be removed: */
-			if(interestEventTypeMask!=0x0&&elIt->callback(elIt->key,interestEventTypeMask,elIt->callbackUserData))
+			if(interestEventTypeMask!=0x0&&el.callback(el.key,interestEventTypeMask,el.callbackUserData))
 				{
-				/* Update the file descriptor sets: */
-				updateFdSets(elIt->fd,elIt->typeMask,0x0);
-				
-				/* Remove the event listener from the list: */
-				*elIt=ioEventListeners.back();
-				ioEventListeners.pop_back();
-				--elIt;
+				/* Remove the event listener from the list and check the listener that took its place next: */
+				removeIOEventListenerInternal(listenerIndex);
+				--listenerIndex;
 				}
 			}
 		}
@@ -712,6 +981,8 @@ bool EventDispatcher::dispatchNextEvent(void)
 			}
 		}
 	
+	#endif
+	
 	/* Call all process listeners: */
 	for(std::vector<ProcessListener>::iterator plIt=processListeners.begin();plIt!=processListeners.end();++plIt)
 		{
@@ -805,18 +1076,17 @@ void EventDispatcher::setIOEventListenerEventTypeMask(EventDispatcher::ListenerK
 void EventDispatcher::setIOEventListenerEventTypeMaskFromCallback(EventDispatcher::ListenerKey listenerKey,int newEventTypeMask)
 	{
 	/* Find the input/output event listener with the given key: */
-	for(std::vector<IOEventListener>::iterator elIt=ioEventListeners.begin();elIt!=ioEventListeners.end();++elIt)
-		if(elIt->key==listenerKey)
-			{
-			/* Update the file descriptor sets: */
-			updateFdSets(elIt->fd,elIt->typeMask,newEventTypeMask);
-			
-			/* Update the input/output event listener: */
-			elIt->typeMask=newEventTypeMask;
-			
-			/* Stop looking: */
-			break;
-			}
+	IOEventListenerIndexMap::Iterator ielIt=ioEventListenerIndices.findEntry(listenerKey);
+	if(!ielIt.isFinished())
+		{
+		/* Update the input/output event listener: */
+		IOEventListener& el=ioEventListeners[ielIt->getDest()];
+		int typeMask=el.typeMask;
+		el.typeMask=newEventTypeMask;
+		
+		/* Update the set of watched file descriptors: */
+		updateEventMask(el,typeMask);
+		}
 	}
 
 void EventDispatcher::removeIOEventListener(EventDispatcher::ListenerKey listenerKey)
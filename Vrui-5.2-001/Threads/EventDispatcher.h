@@ -1,7 +1,7 @@
 /***********************************************************************
 EventDispatcher - Class to dispatch events from a central listener to
 any number of interested clients.
-Copyright (c) 2016-2019 Oliver Kreylos
+Copyright (c) 2016-2020 Oliver Kreylos
 
 This file is part of the Portable Threading Library (Threads).
 
@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Misc/PriorityHeap.h>
 #include <Misc/StandardHashFunction.h>
 #include <Misc/HashTable.h>
+#include <Threads/Config.h>
 #include <Threads/Spinlock.h>
 
 namespace Threads {
@@ -137,6 +138,7 @@ class EventDispatcher
 	struct TimerEventListener; // Structure representing listeners that have registered interest in timer events
 	class TimerEventListenerComp; // Helper class to compare timer event listener structures by next event time
 	typedef Misc::PriorityHeap<TimerEventListener*,TimerEventListenerComp> TimerEventListenerHeap; // Type for heap of timer event listeners, ordered by next event time
+	typedef Misc::HashTable<ListenerKey,size_t> IOEventListenerIndexMap; // Hash table mapping listener keys to indices in the list of input/output event listeners
 	struct ProcessListener; // Structure representing listeners that are called after any event has been handled
 	struct SignalListener; // Structure representing listeners that react to user-defined signals
 	typedef Misc::HashTable<ListenerKey,SignalListener> SignalListenerMap; // Hash table mapping listener keys to signal listeners
@@ -151,20 +153,32 @@ class EventDispatcher
 	size_t messageReadSize; // Number of bytes read during previous call to readPipeMessages
 	ListenerKey nextKey; // Next key to be assigned to an event listener
 	std::vector<IOEventListener> ioEventListeners; // List of currently registered input/output event listeners
+	IOEventListenerIndexMap ioEventListenerIndices; // Map from listener keys to positions in the list of input/output event listeners
 	TimerEventListenerHeap timerEventListeners; // Heap of currently registered timer event listeners, sorted by next event time
 	std::vector<ProcessListener> processListeners; // List of currently registered process event listeners
 	SignalListenerMap signalListeners; // Map of currently registered signal event listeners
+	#if THREADS_CONFIG_HAVE_EPOLL
+	int epollFd; // An epoll instance watching the self-pipe, the timer descriptor, and all input/output event listeners' file descriptors
+	int timerFd; // A timer descriptor that becomes readable when the next timer event is due
+	bool timerFdArmed; // Flag if the timer descriptor is currently armed
+	Time timerFdTime; // Time point for which the timer descriptor is currently armed
+	size_t numAlwaysReadyListeners; // Number of interested input/output event listeners whose file descriptors don't support epoll
+	#else
 	fd_set readFds,writeFds,exceptionFds; // Three sets of file descriptors waiting for reads, writes, and exceptions, respectively
 	int numReadFds,numWriteFds,numExceptionFds; // Number of file descriptors in the three descriptor sets
 	int maxFd; // Largest file descriptor set in any of the three descriptor sets
 	bool hadBadFd; // Flag if the last invocation of dispatchNextEvent() tripped on a bad file descriptor
+	#endif
 	Time dispatchTime; // Time point of current iteration of dispatchNextEvent() method
 	
 	/* Private methods: */
 	ListenerKey getNextKey(void); // Returns a new listener key
 	size_t readPipeMessages(void); // Reads messages from the self-pipe; returns number of complete messages read
 	void writePipeMessage(const PipeMessage& pm,const char* methodName); // Writes a message to the self-pipe
-	void updateFdSets(int fd,int oldEventMask,int newEventMask); // Updates the three descriptor sets based on the given file descriptor changing its interest mask
+	void updateEventMask(IOEventListener& listener,int oldEventMask); // Updates the set of watched file descriptors based on the given input/output event listener changing its interest mask
+	void addIOEventListenerInternal(const IOEventListener& listener); // Adds the given input/output event listener to the list and the set of watched file descriptors
+	void removeIOEventListenerInternal(size_t listenerIndex); // Removes the input/output event listener at the given list position from the list and the set of watched file descriptors
+	bool handlePipeMessages(void); // Reads and handles messages from the self-pipe; returns false if the stop() method was called
 	
 	/* Constructors and destructors: */
 	public:
@@ -3,7 +3,7 @@ TripleBuffer - Class to allow one-way asynchronous non-blocking
 communication between a producer and a consumer, in which the producer
 writes a stream of data into a buffer, and the consumer can retrieve the
 most recently written value at any time.
-Copyright (c) 2005-2019 Oliver Kreylos
+Copyright (c) 2005-2020 Oliver Kreylos
 
 This file is part of the Portable Threading Library (Threads).
 
@@ -78,7 +78,7 @@ class TripleBuffer
 		/* Return the buffer slot currently locked for writing from shared memory: */
 		return buffer[(bufferState.get()&availableMask)>>availableShift];
 		}
-	void postNewValue(void) // Marks a new buffer value as most recent after data has been written
+	bool postNewValue(void) // Marks a new buffer value as most recent after data has been written; returns true if the previous value was never locked by the consumer
 		{
 		/* Read the current buffer state from shared memory: */
 		Misc::UInt8 bs=bufferState.get();
@@ -96,8 +96,11 @@ class TripleBuffer
 			/* Try again: */
 			bs=newBs;
 			}
+		
+		/* The previous value was overwritten unread if the "written" flag was still set: */
+		return (bs&writtenMask)!=0x00U;
 		}
-	void postNewValue(const Value& newValue) // Pushes a new data value into the buffer
+	bool postNewValue(const Value& newValue) // Pushes a new data value into the buffer; returns true if the previous value was never locked by the consumer
 		{
 		/* Read the current buffer state from shared memory: */
 		Misc::UInt8 bs=bufferState.get();
@@ -118,6 +121,9 @@ class TripleBuffer
 			/* Try again: */
 			bs=newBs;
 			}
+		
+		/* The previous value was overwritten unread if the "written" flag was still set: */
+		return (bs&writtenMask)!=0x00U;
 		}
 	const Value& getMostRecentValue(void) const // Returns the last posted value; must not be called in cases where consumer might change locked value
 		{
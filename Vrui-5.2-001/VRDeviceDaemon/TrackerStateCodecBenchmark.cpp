@@ -0,0 +1,229 @@
+/***********************************************************************
+TrackerStateCodecBenchmark - Utility to compare the size and accuracy of
+compressed STATE_UPDATE tracker batches with per-tracker TRACKER_UPDATE
+messages, using a set of synthetic trackers doing a random walk.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Vrui VR Device Driver Daemon (VRDeviceDaemon).
+
+The Vrui VR Device Driver Daemon is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Vrui VR Device Driver Daemon is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui VR Device Driver Daemon; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+#include <Misc/SizedTypes.h>
+#include <Misc/Marshaller.h>
+#include <Misc/Timer.h>
+#include <IO/VariableMemoryFile.h>
+#include <Math/Math.h>
+#include <Geometry/Vector.h>
+#include <Geometry/Rotation.h>
+#include <Geometry/GeometryMarshallers.h>
+#include <Vrui/Internal/VRDeviceState.h>
+#include <Vrui/Internal/VRDevicePipe.h>
+#include <Vrui/Internal/TrackerStateCodec.h>
+
+typedef Vrui::VRDeviceState VRDeviceState;
+typedef VRDeviceState::TrackerState TrackerState;
+typedef TrackerState::PositionOrientation PositionOrientation;
+typedef Geometry::Vector<double,3> Vector;
+typedef Geometry::Rotation<double,3> Rotation;
+
+/****************
+Helper functions:
+****************/
+
+inline double randUniform(void) // Returns a random number in [-1, 1]
+	{
+	return double(rand())*2.0/double(RAND_MAX)-1.0;
+	}
+
+double getAngle(const PositionOrientation::Rotation& r1,const PositionOrientation::Rotation& r2) // Returns the angle between two orientations in radians
+	{
+	Rotation delta=Rotation(r1)*Geometry::invert(Rotation(r2));
+	return Math::abs(delta.getAngle());
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	int numTrackers=32;
+	unsigned int numUpdates=5000;
+	double positionQuantum=1.0e-5;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"trackers")==0&&i+1<argc)
+				{
+				++i;
+				numTrackers=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"updates")==0&&i+1<argc)
+				{
+				++i;
+				numUpdates=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"quantum")==0&&i+1<argc)
+				{
+				++i;
+				positionQuantum=atof(argv[i]);
+				}
+			else
+				std::cerr<<"Ignoring unrecognized option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring command line argument "<<argv[i]<<std::endl;
+		}
+	if(numTrackers<1||numTrackers>65535||numUpdates<1)
+		{
+		std::cerr<<"Need between 1 and 65535 trackers and at least one update"<<std::endl;
+		return 1;
+		}
+	
+	/* Place the trackers randomly inside a room-sized volume: */
+	VRDeviceState state;
+	state.setLayout(numTrackers,0,0);
+	std::vector<Vector> positions(numTrackers);
+	std::vector<Vector> velocities(numTrackers,Vector::zero);
+	std::vector<Rotation> orientations(numTrackers,Rotation::identity);
+	for(int i=0;i<numTrackers;++i)
+		positions[i]=Vector(randUniform(),randUniform()+1.5,randUniform());
+	
+	/* Encode all updates as per-tracker update messages and as compressed state update messages, as VRDeviceServer would send them at 1 kHz: */
+	IO::VariableMemoryFile oldStream,newStream;
+	Vrui::TrackerStateCodec encoder(numTrackers,positionQuantum);
+	std::vector<TrackerState> truth;
+	truth.reserve(size_t(numUpdates)*size_t(numTrackers));
+	double oldEncodeTime=0.0,newEncodeTime=0.0;
+	for(unsigned int update=0;update<numUpdates;++update)
+		{
+		/* Advance the random walk by one millisecond: */
+		for(int i=0;i<numTrackers;++i)
+			{
+			for(int j=0;j<3;++j)
+				{
+				velocities[i][j]=velocities[i][j]*0.99+randUniform()*0.01;
+				positions[i][j]+=velocities[i][j]*0.001;
+				}
+			orientations[i]*=Rotation::rotateAxis(Vector(randUniform(),randUniform(),randUniform()),0.002);
+			
+			TrackerState ts;
+			ts.positionOrientation=PositionOrientation(PositionOrientation::Vector(positions[i]),PositionOrientation::Rotation(orientations[i]));
+			ts.linearVelocity=TrackerState::LinearVelocity(velocities[i]);
+			ts.angularVelocity=TrackerState::AngularVelocity(randUniform(),randUniform(),randUniform());
+			state.setTrackerState(i,ts);
+			state.setTrackerTimeStamp(i,VRDeviceState::TimeStamp(update*1000U+i));
+			state.setTrackerValid(i,true);
+			truth.push_back(ts);
+			}
+		
+		/* Write one tracker update message per tracker: */
+		Misc::Timer oldTimer;
+		for(int i=0;i<numTrackers;++i)
+			{
+			oldStream.write<Vrui::VRDevicePipe::MessageIdType>(Vrui::VRDevicePipe::TRACKER_UPDATE);
+			oldStream.write<Misc::UInt16>(Misc::UInt16(i));
+			Misc::Marshaller<TrackerState>::write(state.getTrackerState(i),oldStream);
+			oldStream.write<VRDeviceState::TimeStamp>(state.getTrackerTimeStamp(i));
+			oldStream.write<Misc::UInt8>(state.getTrackerValid(i)?1U:0U);
+			}
+		oldTimer.elapse();
+		oldEncodeTime+=oldTimer.getTime();
+		
+		/* Write one state update message with empty button and valuator sections: */
+		Misc::Timer newTimer;
+		newStream.write<Vrui::VRDevicePipe::MessageIdType>(Vrui::VRDevicePipe::STATE_UPDATE);
+		newStream.write<Misc::UInt16>(Misc::UInt16(numTrackers));
+		for(int i=0;i<numTrackers;++i)
+			encoder.writeTracker(i,state,newStream);
+		newStream.write<Misc::UInt16>(0);
+		newStream.write<Misc::UInt16>(0);
+		newTimer.elapse();
+		newEncodeTime+=newTimer.getTime();
+		}
+	oldStream.flush();
+	newStream.flush();
+	
+	/* Decode the per-tracker update messages: */
+	VRDeviceState received;
+	received.setLayout(numTrackers,0,0);
+	oldStream.rewind();
+	Misc::Timer oldTimer;
+	for(unsigned int update=0;update<numUpdates;++update)
+		for(int i=0;i<numTrackers;++i)
+			{
+			oldStream.read<Vrui::VRDevicePipe::MessageIdType>();
+			int trackerIndex=oldStream.read<Misc::UInt16>();
+			received.setTrackerState(trackerIndex,Misc::Marshaller<TrackerState>::read(oldStream));
+			received.setTrackerTimeStamp(trackerIndex,oldStream.read<VRDeviceState::TimeStamp>());
+			received.setTrackerValid(trackerIndex,oldStream.read<Misc::UInt8>()!=0);
+			}
+	oldTimer.elapse();
+	
+	/* Decode the state update messages and compare the received tracker states with the originals: */
+	Vrui::TrackerStateCodec decoder(numTrackers,positionQuantum);
+	newStream.rewind();
+	double maxPositionError=0.0,maxAngleError=0.0;
+	unsigned int numMismatches=0;
+	double newDecodeTime=0.0;
+	std::vector<int> trackerIndices;
+	for(unsigned int update=0;update<numUpdates;++update)
+		{
+		Misc::Timer newTimer;
+		newStream.read<Vrui::VRDevicePipe::MessageIdType>();
+		int numUpdatedTrackers=newStream.read<Misc::UInt16>();
+		trackerIndices.clear();
+		for(int i=0;i<numUpdatedTrackers;++i)
+			trackerIndices.push_back(decoder.readTracker(newStream,received));
+		newStream.read<Misc::UInt16>();
+		newStream.read<Misc::UInt16>();
+		newTimer.elapse();
+		newDecodeTime+=newTimer.getTime();
+		
+		for(std::vector<int>::iterator tiIt=trackerIndices.begin();tiIt!=trackerIndices.end();++tiIt)
+			{
+			const TrackerState& ts=received.getTrackerState(*tiIt);
+			const TrackerState& original=truth[size_t(update)*size_t(numTrackers)+*tiIt];
+			maxPositionError=Math::max(maxPositionError,double(Geometry::dist(ts.positionOrientation.getOrigin(),original.positionOrientation.getOrigin())));
+			maxAngleError=Math::max(maxAngleError,getAngle(ts.positionOrientation.getRotation(),original.positionOrientation.getRotation()));
+			if(received.getTrackerTimeStamp(*tiIt)!=VRDeviceState::TimeStamp(update*1000U+*tiIt)||!received.getTrackerValid(*tiIt))
+				++numMismatches;
+			}
+		}
+	
+	/* Print the results: */
+	double numBatches=double(numUpdates);
+	std::cout<<numTrackers<<" trackers, "<<numUpdates<<" updates"<<std::endl;
+	std::cout<<"TRACKER_UPDATE: "<<double(oldStream.getDataSize())/numBatches<<" bytes per update, "<<oldEncodeTime*1.0e6/numBatches<<" us to encode, "<<oldTimer.getTime()*1.0e6/numBatches<<" us to decode"<<std::endl;
+	std::cout<<"STATE_UPDATE:   "<<double(newStream.getDataSize())/numBatches<<" bytes per update, "<<newEncodeTime*1.0e6/numBatches<<" us to encode, "<<newDecodeTime*1.0e6/numBatches<<" us to decode"<<std::endl;
+	std::cout<<"Bandwidth at 1 kHz: "<<double(oldStream.getDataSize())*1.0e3/(numBatches*1024.0*1024.0)<<" MB/s -> "<<double(newStream.getDataSize())*1.0e3/(numBatches*1024.0*1024.0)<<" MB/s"<<std::endl;
+	std::cout<<"Max position error "<<maxPositionError<<" (quantum "<<positionQuantum<<"), max orientation error "<<maxAngleError<<" rad"<<std::endl;
+	if(numMismatches!=0)
+		{
+		std::cout<<"FAILED: "<<numMismatches<<" tracker time stamps or valid flags did not survive the round trip"<<std::endl;
+		return 1;
+		}
+	if(maxPositionError>positionQuantum)
+		{
+		std::cout<<"FAILED: position error exceeds the position quantum"<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
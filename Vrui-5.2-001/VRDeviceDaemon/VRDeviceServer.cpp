@@ -31,6 +31,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Misc/ConfigurationFile.h>
 #include <Vrui/Internal/VRDeviceDescriptor.h>
 #include <Vrui/Internal/HMDConfiguration.h>
+#include <Vrui/Internal/TrackerStateCodec.h>
 
 #define VRDEVICEDAEMON_DEBUG_PROTOCOL 0
 
@@ -55,7 +56,8 @@ VRDeviceServer::ClientState::ClientState(VRDeviceServer* sServer,Comm::Listening
 	:server(sServer),
 	 pipe(listenSocket),
 	 state(START),protocolVersion(Vrui::VRDevicePipe::protocolVersionNumber),clientExpectsTimeStamps(true),
-	 active(false),streaming(false)
+	 active(false),streaming(false),
+	 trackerStateCodec(0)
 	{
 	#ifdef VERBOSE
 	/* Assemble the client name: */
@@ -66,6 +68,11 @@ VRDeviceServer::ClientState::ClientState(VRDeviceServer* sServer,Comm::Listening
 	#endif
 	}
 
+VRDeviceServer::ClientState::~ClientState(void)
+	{
+	delete trackerStateCodec;
+	}
+
 /*******************************
 Methods of class VRDeviceServer:
 *******************************/
@@ -249,6 +256,14 @@ bool VRDeviceServer::clientMessageCallback(Threads::EventDispatcher::ListenerKey
 							client->pipe.write<Misc::UInt32>(thisPtr->deviceManager->getNumHapticFeatures());
 							}
 						
+						/* Check if the client understands compressed state updates: */
+						if(client->protocolVersion>=9U)
+							{
+							/* Send the tracker position quantum and create a tracker state codec: */
+							client->pipe.write<Misc::Float64>(thisPtr->trackerPositionQuantum);
+							client->trackerStateCodec=new Vrui::TrackerStateCodec(thisPtr->state.getNumTrackers(),thisPtr->trackerPositionQuantum);
+							}
+						
 						/* Finish the reply message: */
 						client->pipe.flush();
 						
@@ -314,6 +329,10 @@ bool VRDeviceServer::clientMessageCallback(Threads::EventDispatcher::ListenerKey
 						
 						if(message==Vrui::VRDevicePipe::STARTSTREAM_REQUEST)
 							{
+							/* Reset the client's compressed tracker states; the client does the same when requesting to stream: */
+							if(client->trackerStateCodec!=0)
+								client->trackerStateCodec->reset();
+							
 							/* Increase the number of streaming clients: */
 							++thisPtr->numStreamingClients;
 							
@@ -430,7 +449,6 @@ void VRDeviceServer::disconnectClientOnError(VRDeviceServer::ClientStateList::it
 	disconnectClient(*csIt,true,false);
 	
 	/* Remove the dead client from the list: */
-	delete *csIt;
 	*csIt=clientStates.back();
 	clientStates.pop_back();
 	}
@@ -445,6 +463,38 @@ bool VRDeviceServer::writeStateUpdates(VRDeviceServer::ClientStateList::iterator
 	/* Send state updates to client: */
 	try
 		{
+		if(client->trackerStateCodec!=0)
+			{
+			/* Send all updates as a single compressed state update message: */
+			client->pipe.writeMessage(Vrui::VRDevicePipe::STATE_UPDATE);
+			
+			/* Send compressed tracker states: */
+			client->pipe.write<Misc::UInt16>(Misc::UInt16(updatedTrackers.size()));
+			for(std::vector<int>::iterator utIt=updatedTrackers.begin();utIt!=updatedTrackers.end();++utIt)
+				client->trackerStateCodec->writeTracker(*utIt,state,client->pipe);
+			
+			/* Send button states: */
+			client->pipe.write<Misc::UInt16>(Misc::UInt16(updatedButtons.size()));
+			for(std::vector<int>::iterator ubIt=updatedButtons.begin();ubIt!=updatedButtons.end();++ubIt)
+				{
+				client->pipe.write<Misc::UInt16>(Misc::UInt16(*ubIt));
+				client->pipe.write<Misc::UInt8>(state.getButtonState(*ubIt)?1U:0U);
+				}
+			
+			/* Send valuator states: */
+			client->pipe.write<Misc::UInt16>(Misc::UInt16(updatedValuators.size()));
+			for(std::vector<int>::iterator uvIt=updatedValuators.begin();uvIt!=updatedValuators.end();++uvIt)
+				{
+				client->pipe.write<Misc::UInt16>(Misc::UInt16(*uvIt));
+				client->pipe.write<Vrui::VRDeviceState::ValuatorState>(state.getValuatorState(*uvIt));
+				}
+			
+			/* Finish the message: */
+			client->pipe.flush();
+			
+			return true;
+			}
+		
 		/* Send tracker state updates: */
 		for(std::vector<int>::iterator utIt=updatedTrackers.begin();utIt!=updatedTrackers.end();++utIt)
 			{
@@ -571,7 +621,8 @@ VRDeviceServer::VRDeviceServer(VRDeviceManager* sDeviceManager,const Misc::Confi
 	:VRDeviceManager::VRStreamer(sDeviceManager),
 	 listenSocket(configFile.retrieveValue<int>("./serverPort",-1),5),
 	 numActiveClients(0),numStreamingClients(0),
-	 haveUpdates(false),
+	 trackerPositionQuantum(configFile.retrieveValue<double>("./trackerPositionQuantum",1.0e-5)),
+	 haveUpdates(false),trackerUpdatePending(state.getNumTrackers(),false),
 	 managerTrackerStateVersion(0U),streamingTrackerStateVersion(0U),
 	 managerBatteryStateVersion(0U),streamingBatteryStateVersion(0U),batteryStateVersions(0),
 	 managerHmdConfigurationVersion(0U),streamingHmdConfigurationVersion(0U),
@@ -606,26 +657,41 @@ VRDeviceServer::~VRDeviceServer(void)
 
 void VRDeviceServer::trackerUpdated(int trackerIndex)
 	{
-	/* Remember the updated tracker's index and wake up the run loop: */
-	haveUpdates=true;
-	updatedTrackers.push_back(trackerIndex);
-	dispatcher.interrupt();
+	/* Remember the updated tracker's index unless it is already pending, as only the tracker's most recent state will be sent: */
+	if(!trackerUpdatePending[trackerIndex])
+		{
+		updatedTrackers.push_back(trackerIndex);
+		trackerUpdatePending[trackerIndex]=true;
+		}
+	
+	/* Wake up the run loop if it does not already have pending updates: */
+	if(!haveUpdates)
+		{
+		haveUpdates=true;
+		dispatcher.interrupt();
+		}
 	}
 
 void VRDeviceServer::buttonUpdated(int buttonIndex)
 	{
-	/* Remember the updated button's index and wake up the run loop: */
-	haveUpdates=true;
+	/* Remember the updated button's index and wake up the run loop if it does not already have pending updates: */
 	updatedButtons.push_back(buttonIndex);
-	dispatcher.interrupt();
+	if(!haveUpdates)
+		{
+		haveUpdates=true;
+		dispatcher.interrupt();
+		}
 	}
 
 void VRDeviceServer::valuatorUpdated(int valuatorIndex)
 	{
-	/* Remember the updated valuator's index and wake up the run loop: */
-	haveUpdates=true;
+	/* Remember the updated valuator's index and wake up the run loop if it does not already have pending updates: */
 	updatedValuators.push_back(valuatorIndex);
-	dispatcher.interrupt();
+	if(!haveUpdates)
+		{
+		haveUpdates=true;
+		dispatcher.interrupt();
+		}
 	}
 
 void VRDeviceServer::updateCompleted(void)
@@ -678,6 +744,8 @@ void VRDeviceServer::run(void)
 				
 				/* Reset the update arrays: */
 				haveUpdates=false;
+				for(std::vector<int>::iterator utIt=updatedTrackers.begin();utIt!=updatedTrackers.end();++utIt)
+					trackerUpdatePending[*utIt]=false;
 				updatedTrackers.clear();
 				updatedButtons.clear();
 				updatedValuators.clear();
@@ -1,7 +1,7 @@
 /***********************************************************************
 VRDeviceServer - Class encapsulating the VR device protocol's server
 side.
-Copyright (c) 2002-2018 Oliver Kreylos
+Copyright (c) 2002-2020 Oliver Kreylos
 
 This file is part of the Vrui VR Device Driver Daemon (VRDeviceDaemon).
 
@@ -36,6 +36,7 @@ class ConfigurationFile;
 namespace Vrui {
 class BatteryState;
 class HMDConfiguration;
+class TrackerStateCodec;
 }
 
 class VRDeviceServer:public VRDeviceManager::VRStreamer
@@ -58,9 +59,11 @@ class VRDeviceServer:public VRDeviceManager::VRStreamer
 		bool clientExpectsValidFlags; // Flag whether the connected client expects to receive tracker valid flags
 		bool active; // Flag whether the client is currently active
 		bool streaming; // Flag whether client is currently in streaming mode
+		Vrui::TrackerStateCodec* trackerStateCodec; // Codec to send compressed tracker states to clients using protocol version 9 or later; null otherwise
 		
 		/* Constructors and destructors: */
 		ClientState(VRDeviceServer* sServer,Comm::ListeningTCPSocket& listenSocket); // Accepts next incoming connection on given listening socket and establishes VR device connection
+		~ClientState(void);
 		};
 	
 	typedef std::vector<ClientState*> ClientStateList; // Data type for lists of states of connected clients
@@ -101,8 +104,10 @@ class VRDeviceServer:public VRDeviceManager::VRStreamer
 	ClientStateList clientStates; // List of currently connected clients
 	int numActiveClients; // Number of clients that are currently active
 	int numStreamingClients; // Number of clients that are currently streaming
+	double trackerPositionQuantum; // Resolution to which tracker positions are quantized when sent to clients in compressed form
 	bool haveUpdates; // Flag if any device state components have been updated since last status update was sent
 	std::vector<int> updatedTrackers; // List of trackers that have been updated since last status update was sent
+	std::vector<bool> trackerUpdatePending; // Flags whether each tracker is already in the list of updated trackers
 	std::vector<int> updatedButtons; // List of buttons that have been updated since last status update was sent
 	std::vector<int> updatedValuators; // List of valuators that have been updated since last status update was sent
 	unsigned int managerTrackerStateVersion; // Version number of tracker states in device manager
@@ -1,7 +1,7 @@
 /***********************************************************************
 ImageExtractorBA81 - Class to extract images from raw video frames
 encoded using an eight-bit Bayer pattern.
-Copyright (c) 2010-2016 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Basic Video Library (Video).
 
@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Misc/SizedTypes.h>
 #include <Video/FrameBuffer.h>
 #include <Video/Colorspaces.h>
+#include <Video/Internal/PixelConversion.h>
 
 namespace Video {
 
@@ -106,8 +107,11 @@ void ImageExtractorBA81::extractGreyFromBGGR(const FrameBuffer* frame,void* imag
 		*(cPtr++)=rgbToGrey(rPtr[1],rPtr[0],avg(rPtr[-stride],rPtr[stride]));
 		++rPtr;
 		
-		/* Convert the odd row's central pixels: */
-		for(unsigned x=1;x<size[0]-1;x+=2)
+		/* Convert the odd row's central pixels, in blocks where possible: */
+		unsigned int numOddBlockPixels=demosaicBayerRowToGrey(rPtr,stride,size[0]-2,true,true,cPtr);
+		rPtr+=numOddBlockPixels;
+		cPtr+=numOddBlockPixels;
+		for(unsigned x=1+numOddBlockPixels;x<size[0]-1;x+=2)
 			{
 			/* Convert the odd (R) pixel: */
 			*(cPtr++)=rgbToGrey(rPtr[0],avg(rPtr[-stride],rPtr[-1],rPtr[1],rPtr[stride]),avg(rPtr[-stride-1],rPtr[-stride+1],rPtr[stride-1],rPtr[stride+1]));
@@ -133,8 +137,11 @@ void ImageExtractorBA81::extractGreyFromBGGR(const FrameBuffer* frame,void* imag
 		*(cPtr++)=rgbToGrey(avg(rPtr[-stride+1],rPtr[stride+1]),avg(rPtr[-stride],rPtr[1],rPtr[stride]),rPtr[0]);
 		++rPtr;
 		
-		/* Convert the even row's central pixels: */
-		for(unsigned x=1;x<size[0]-1;x+=2)
+		/* Convert the even row's central pixels, in blocks where possible: */
+		unsigned int numEvenBlockPixels=demosaicBayerRowToGrey(rPtr,stride,size[0]-2,false,false,cPtr);
+		rPtr+=numEvenBlockPixels;
+		cPtr+=numEvenBlockPixels;
+		for(unsigned x=1+numEvenBlockPixels;x<size[0]-1;x+=2)
 			{
 			/* Convert the odd (G) pixel: */
 			*(cPtr++)=rgbToGrey(avg(rPtr[-stride],rPtr[stride]),rPtr[0],avg(rPtr[-1],rPtr[1]));
@@ -223,8 +230,11 @@ void ImageExtractorBA81::extractGreyFromRGGB(const FrameBuffer* frame,void* imag
 		*(cPtr++)=rgbToGrey(avg(rPtr[-stride],rPtr[stride]),rPtr[0],rPtr[1]);
 		++rPtr;
 		
-		/* Convert the odd row's central pixels: */
-		for(unsigned x=1;x<size[0]-1;x+=2)
+		/* Convert the odd row's central pixels, in blocks where possible: */
+		unsigned int numOddBlockPixels=demosaicBayerRowToGrey(rPtr,stride,size[0]-2,false,true,cPtr);
+		rPtr+=numOddBlockPixels;
+		cPtr+=numOddBlockPixels;
+		for(unsigned x=1+numOddBlockPixels;x<size[0]-1;x+=2)
 			{
 			/* Convert the odd (B) pixel: */
 			*(cPtr++)=rgbToGrey(avg(rPtr[-stride-1],rPtr[-stride+1],rPtr[stride-1],rPtr[stride+1]),avg(rPtr[-stride],rPtr[-1],rPtr[1],rPtr[stride]),rPtr[0]);
@@ -250,8 +260,11 @@ void ImageExtractorBA81::extractGreyFromRGGB(const FrameBuffer* frame,void* imag
 		*(cPtr++)=rgbToGrey(rPtr[0],avg(rPtr[-stride],rPtr[1],rPtr[stride]),avg(rPtr[-stride+1],rPtr[stride+1]));
 		++rPtr;
 		
-		/* Convert the even row's central pixels: */
-		for(unsigned x=1;x<size[0]-1;x+=2)
+		/* Convert the even row's central pixels, in blocks where possible: */
+		unsigned int numEvenBlockPixels=demosaicBayerRowToGrey(rPtr,stride,size[0]-2,true,false,cPtr);
+		rPtr+=numEvenBlockPixels;
+		cPtr+=numEvenBlockPixels;
+		for(unsigned x=1+numEvenBlockPixels;x<size[0]-1;x+=2)
 			{
 			/* Convert the odd (G) pixel: */
 			*(cPtr++)=rgbToGrey(avg(rPtr[-1],rPtr[1]),rPtr[0],avg(rPtr[-stride],rPtr[stride]));
@@ -350,8 +363,11 @@ void ImageExtractorBA81::extractRGBFromBGGR(const FrameBuffer* frame,void* image
 		*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
 		++rPtr;
 		
-		/* Convert the odd row's central pixels: */
-		for(unsigned x=1;x<size[0]-1;x+=2)
+		/* Convert the odd row's central pixels, in blocks where possible: */
+		unsigned int numOddBlockPixels=demosaicBayerRowToRgb(rPtr,stride,size[0]-2,true,true,cPtr);
+		rPtr+=numOddBlockPixels;
+		cPtr+=numOddBlockPixels*3;
+		for(unsigned x=1+numOddBlockPixels;x<size[0]-1;x+=2)
 			{
 			/* Convert the odd (R) pixel: */
 			*(cPtr++)=rPtr[0];
@@ -385,8 +401,11 @@ void ImageExtractorBA81::extractRGBFromBGGR(const FrameBuffer* frame,void* image
 		*(cPtr++)=rPtr[0];
 		++rPtr;
 		
-		/* Convert the even row's central pixels: */
-		for(unsigned x=1;x<size[0]-1;x+=2)
+		/* Convert the even row's central pixels, in blocks where possible: */
+		unsigned int numEvenBlockPixels=demosaicBayerRowToRgb(rPtr,stride,size[0]-2,false,false,cPtr);
+		rPtr+=numEvenBlockPixels;
+		cPtr+=numEvenBlockPixels*3;
+		for(unsigned x=1+numEvenBlockPixels;x<size[0]-1;x+=2)
 			{
 			/* Convert the odd (G) pixel: */
 			*(cPtr++)=avg(rPtr[-stride],rPtr[stride]);
@@ -499,8 +518,11 @@ void ImageExtractorBA81::extractRGBFromRGGB(const FrameBuffer* frame,void* image
 		*(cPtr++)=rPtr[1];
 		++rPtr;
 		
-		/* Convert the odd row's central pixels: */
-		for(unsigned x=1;x<size[0]-1;x+=2)
+		/* Convert the odd row's central pixels, in blocks where possible: */
+		unsigned int numOddBlockPixels=demosaicBayerRowToRgb(rPtr,stride,size[0]-2,false,true,cPtr);
+		rPtr+=numOddBlockPixels;
+		cPtr+=numOddBlockPixels*3;
+		for(unsigned x=1+numOddBlockPixels;x<size[0]-1;x+=2)
 			{
 			/* Convert the odd (B) pixel: */
 			*(cPtr++)=avg(rPtr[-stride-1],rPtr[-stride+1],rPtr[stride-1],rPtr[stride+1]);
@@ -534,8 +556,11 @@ void ImageExtractorBA81::extractRGBFromRGGB(const FrameBuffer* frame,void* image
 		*(cPtr++)=avg(rPtr[-stride+1],rPtr[stride+1]);
 		++rPtr;
 		
-		/* Convert the even row's central pixels: */
-		for(unsigned x=1;x<size[0]-1;x+=2)
+		/* Convert the even row's central pixels, in blocks where possible: */
+		unsigned int numEvenBlockPixels=demosaicBayerRowToRgb(rPtr,stride,size[0]-2,true,false,cPtr);
+		rPtr+=numEvenBlockPixels;
+		cPtr+=numEvenBlockPixels*3;
+		for(unsigned x=1+numEvenBlockPixels;x<size[0]-1;x+=2)
 			{
 			/* Convert the odd (G) pixel: */
 			*(cPtr++)=avg(rPtr[-1],rPtr[1]);
@@ -1,7 +1,7 @@
 /***********************************************************************
 ImageExtractorYUYV - Class to extract images from raw video frames
 encoded in YpCbCr 4:2:2 format.
-Copyright (c) 2010-2016 Oliver Kreylos
+Copyright (c) 2010-2020 Oliver Kreylos
 
 This file is part of the Basic Video Library (Video).
 
@@ -23,7 +23,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Video/ImageExtractorYUYV.h>
 
 #include <Video/FrameBuffer.h>
-#include <Video/Colorspaces.h>
+#include <Video/Internal/PixelConversion.h>
 
 namespace Video {
 
@@ -40,51 +40,22 @@ ImageExtractorYUYV::ImageExtractorYUYV(const unsigned int sSize[2])
 
 void ImageExtractorYUYV::extractGrey(const FrameBuffer* frame,void* image)
 	{
-	/* Convert the frame's Y' channel to Y: */
+	/* Convert the frame's Y' channel to Y while flipping it vertically: */
 	const unsigned char* rRowPtr=frame->start;
 	unsigned char* gRowPtr=static_cast<unsigned char*>(image);
 	gRowPtr+=(size[1]-1)*size[0];
 	for(unsigned int y=0;y<size[1];++y,rRowPtr+=size[0]*2,gRowPtr-=size[0])
-		{
-		const unsigned char* rPtr=rRowPtr;
-		unsigned char* gPtr=gRowPtr;
-		for(unsigned int x=0;x<size[0];++x,++gPtr,rPtr+=2)
-			{
-			/* Convert from Y' to Y: */
-			if(*rPtr<=16)
-				*gPtr=0;
-			else if(*rPtr>=236)
-				*gPtr=255;
-			else
-				*gPtr=(unsigned char)(((int(rPtr[0])-16)*256)/220);
-			}
-		}
+		convertYpCbCr422ToGrey(rRowPtr,YPCBCR422_YUYV,size[0],gRowPtr);
 	}
 
 void ImageExtractorYUYV::extractRGB(const FrameBuffer* frame,void* image)
 	{
-	/* Convert the frame from Y'CbCr to RGB: */
+	/* Convert the frame from Y'CbCr to RGB while flipping it vertically: */
 	const unsigned char* rRowPtr=frame->start;
 	unsigned char* cRowPtr=static_cast<unsigned char*>(image);
 	cRowPtr+=(size[1]-1)*size[0]*3;
 	for(unsigned int y=0;y<size[1];++y,rRowPtr+=size[0]*2,cRowPtr-=size[0]*3)
-		{
-		const unsigned char* rPtr=rRowPtr;
-		unsigned char* cPtr=cRowPtr;
-		for(unsigned int x=0;x<size[0];x+=2,cPtr+=2*3,rPtr+=4)
-			{
-			/* Convert first pixel: */
-			unsigned char ypcbcr[3];
-			ypcbcr[0]=rPtr[0];
-			ypcbcr[1]=rPtr[1];
-			ypcbcr[2]=rPtr[3];
-			Video::ypcbcrToRgb(ypcbcr,cPtr);
-			
-			/* Convert second pixel: */
-			ypcbcr[0]=rPtr[2];
-			Video::ypcbcrToRgb(ypcbcr,cPtr+3);
-			}
-		}
+		convertYpCbCr422ToRgb(rRowPtr,YPCBCR422_YUYV,size[0],cRowPtr);
 	}
 
 void ImageExtractorYUYV::extractYpCbCr(const FrameBuffer* frame,void* image)
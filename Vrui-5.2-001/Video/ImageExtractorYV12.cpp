@@ -1,7 +1,7 @@
 /***********************************************************************
 ImageExtractorYV12 - Class to extract images from raw video frames
 encoded in YpCbCr 4:2:0 format.
-Copyright (c) 2013-2018 Oliver Kreylos
+Copyright (c) 2013-2020 Oliver Kreylos
 
 This file is part of the Basic Video Library (Video).
 
@@ -24,7 +24,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include <string.h>
 #include <Video/FrameBuffer.h>
-#include <Video/Colorspaces.h>
+#include <Video/Internal/PixelConversion.h>
 
 namespace Video {
 
@@ -49,30 +49,38 @@ ImageExtractorYV12::ImageExtractorYV12(const unsigned int sSize[2],ptrdiff_t ypO
 
 void ImageExtractorYV12::extractGrey(const FrameBuffer* frame,void* image)
 	{
-	/* Convert the frame's Y' channel to Y: */
+	/* Convert the frame's Y' channel to Y while flipping it vertically: */
 	const unsigned char* rRowPtr=frame->start+planes[0].offset;
 	unsigned char* gRowPtr=static_cast<unsigned char*>(image);
 	gRowPtr+=(size[1]-1)*size[0];
 	for(unsigned int y=0;y<size[1];++y,rRowPtr+=planes[0].stride,gRowPtr-=size[0])
+		convertYpToGrey(rRowPtr,size[0],gRowPtr);
+	}
+
+void ImageExtractorYV12::extractRGB(const FrameBuffer* frame,void* image)
+	{
+	/* Convert the frame from Y'CbCr 4:2:0 to RGB by processing pairs of rows sharing the same chroma row: */
+	unsigned char* resultRowPtr=static_cast<unsigned char*>(image)+(size[1]-1)*size[0]*3;
+	const unsigned char* ypRowPtr=frame->start+planes[0].offset;
+	const unsigned char* cbRowPtr=frame->start+planes[1].offset;
+	const unsigned char* crRowPtr=frame->start+planes[2].offset;
+	for(unsigned int y=0;y<size[1];y+=2)
 		{
-		const unsigned char* rPtr=rRowPtr;
-		unsigned char* gPtr=gRowPtr;
-		for(unsigned int x=0;x<size[0];++x,++rPtr,++gPtr)
-			{
-			/* Convert from Y' to Y: */
-			if(*rPtr<=16)
-				*gPtr=0;
-			else if(*rPtr>=236)
-				*gPtr=255;
-			else
-				*gPtr=(unsigned char)(((int(rPtr[0])-16)*256)/220);
-			}
+		/* Convert both rows while flipping them vertically: */
+		convertYpCbCr420ToRgb(ypRowPtr,cbRowPtr,crRowPtr,size[0],resultRowPtr);
+		convertYpCbCr420ToRgb(ypRowPtr+planes[0].stride,cbRowPtr,crRowPtr,size[0],resultRowPtr-size[0]*3);
+		
+		/* Go to the next row: */
+		resultRowPtr-=2*size[0]*3;
+		ypRowPtr+=2*planes[0].stride;
+		cbRowPtr+=planes[1].stride;
+		crRowPtr+=planes[2].stride;
 		}
 	}
 
-void ImageExtractorYV12::extractRGB(const FrameBuffer* frame,void* image)
+void ImageExtractorYV12::extractYpCbCr(const FrameBuffer* frame,void* image)
 	{
-	/* Convert the frame from Y'CbCr 4:2:0 to RGB by processing blocks of 2x2 pixels: */
+	/* Unpack the frame from 4:2:0 downsampling to full format by processing blocks of 2x2 pixels: */
 	unsigned char* resultRowPtr=static_cast<unsigned char*>(image)+(size[1]-1)*size[0]*3;
 	const unsigned char* ypRowPtr=frame->start+planes[0].offset;
 	const unsigned char* cbRowPtr=frame->start+planes[1].offset;
@@ -83,31 +91,22 @@ void ImageExtractorYV12::extractRGB(const FrameBuffer* frame,void* image)
 		const unsigned char* ypPtr=ypRowPtr;
 		const unsigned char* cbPtr=cbRowPtr;
 		const unsigned char* crPtr=crRowPtr;
-		for(unsigned int x=0;x<size[0];x+=2)
+		for(unsigned int x=0;x<size[0];x+=2,resultPtr+=2*3,ypPtr+=2,++cbPtr,++crPtr)
 			{
-			/* Convert the four pixels in the 2x2 block from Y'CbCr to RGB: */
-			unsigned char ypcbcr[3];
-			ypcbcr[0]=ypPtr[0];
-			ypcbcr[1]=*cbPtr;
-			ypcbcr[2]=*crPtr;
-			ypcbcrToRgb(ypcbcr,resultPtr);
-			
-			ypcbcr[0]=ypPtr[1];
-			ypcbcrToRgb(ypcbcr,resultPtr+3);
-			
-			ypcbcr[0]=ypPtr[planes[0].stride];
-			ypcbcrToRgb(ypcbcr,resultPtr-size[0]*3);
-			
-			ypcbcr[0]=ypPtr[planes[0].stride+1];
-			ypcbcrToRgb(ypcbcr,resultPtr-size[0]*3+3);
-			
-			/* Go to the next pixel: */
-			resultPtr+=2*3;
-			ypPtr+=2;
-			++cbPtr;
-			++crPtr;
+			/* Unpack the four pixels in the 2x2 block: */
+			for(int i=0;i<2;++i)
+				{
+				unsigned char* rPtr=resultPtr-i*size[0]*3;
+				const unsigned char* yPtr=ypPtr+i*planes[0].stride;
+				for(int j=0;j<2;++j,rPtr+=3)
+					{
+					rPtr[0]=yPtr[j];
+					rPtr[1]=*cbPtr;
+					rPtr[2]=*crPtr;
+					}
+				}
 			}
-
+		
 		/* Go to the next row: */
 		resultRowPtr-=2*size[0]*3;
 		ypRowPtr+=2*planes[0].stride;
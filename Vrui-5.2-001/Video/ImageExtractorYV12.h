@@ -1,7 +1,7 @@
 /***********************************************************************
 ImageExtractorYV12 - Class to extract images from raw video frames
 encoded in YpCbCr 4:2:0 format.
-Copyright (c) 2013 Oliver Kreylos
+Copyright (c) 2013-2020 Oliver Kreylos
 
 This file is part of the Basic Video Library (Video).
 
@@ -53,6 +53,7 @@ class ImageExtractorYV12:public ImageExtractor
 	public:
 	virtual void extractGrey(const FrameBuffer* frame,void* image);
 	virtual void extractRGB(const FrameBuffer* frame,void* image);
+	virtual void extractYpCbCr(const FrameBuffer* frame,void* image);
 	virtual void extractYpCbCr420(const FrameBuffer* frame,void* yp,unsigned int ypStride,void* cb,unsigned int cbStride,void* cr,unsigned int crStride);
 	};
 
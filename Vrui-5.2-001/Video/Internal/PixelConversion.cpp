@@ -0,0 +1,401 @@
+/***********************************************************************
+PixelConversion - Helper functions to convert rows of pixels from
+common raw video formats to greyscale or RGB, using SIMD instructions
+where available.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Basic Video Library (Video).
+
+The Basic Video Library is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License as published
+by the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+The Basic Video Library is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Basic Video Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <Video/Internal/PixelConversion.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <Video/Colorspaces.h>
+
+namespace Video {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+inline unsigned char ypToGrey(unsigned char yp)
+	{
+	/* Convert from Y' to Y: */
+	if(yp<=16)
+		return 0;
+	else if(yp>=236)
+		return 255;
+	else
+		return (unsigned char)(((int(yp)-16)*256)/220);
+	}
+
+#ifdef __SSE2__
+
+inline __m128i ypToGrey(__m128i yp) // Converts sixteen Y' values to greyscale
+	{
+	/*********************************************************************
+	Calculate floor((Y'-16)*256/220) as ((Y'-16)*2*38131)>>16, which is
+	exact for all Y' in [17, 235]; smaller values are clamped to 0 by
+	the saturating subtraction, and larger values to 255 by the final
+	saturating pack.
+	*********************************************************************/
+	
+	__m128i zero=_mm_setzero_si128();
+	__m128i y=_mm_subs_epu8(yp,_mm_set1_epi8(16));
+	__m128i factor=_mm_set1_epi16(short(38131));
+	__m128i lo=_mm_mulhi_epu16(_mm_slli_epi16(_mm_unpacklo_epi8(y,zero),1),factor);
+	__m128i hi=_mm_mulhi_epu16(_mm_slli_epi16(_mm_unpackhi_epi8(y,zero),1),factor);
+	return _mm_packus_epi16(lo,hi);
+	}
+
+inline void convertYpCbCr(__m128i yp,__m128i cbcr,__m128i& r,__m128i& g,__m128i& b,int half) // Converts the low or high four of eight pixels given as unbiased 16-bit Y' values and 16-bit (Cb, Cr) pairs to 32-bit RGB
+	{
+	/*********************************************************************
+	Evaluate the formulas from Video::ypcbcrToRgb with 16-bit multiply-
+	adds by splitting all weights larger than 32767 into a power of two,
+	applied by shifting, and a remainder:
+	76309=65536+10773, 104597=131072-26475, 53279=65536-12257,
+	132202=131072+1130.
+	*********************************************************************/
+	
+	/* Get the Y' values and Cb/Cr pairs of the four pixels; each pair is shared by two pixels: */
+	__m128i y,c;
+	if(half==0)
+		{
+		y=_mm_unpacklo_epi16(yp,_mm_set1_epi16(2));
+		c=_mm_unpacklo_epi32(cbcr,cbcr);
+		}
+	else
+		{
+		y=_mm_unpackhi_epi16(yp,_mm_set1_epi16(2));
+		c=_mm_unpackhi_epi32(cbcr,cbcr);
+		}
+	
+	/* Calculate the shared luminance term from the (Y', 2) pairs, including the rounding offset of 2*16384: */
+	__m128i yTerm=_mm_add_epi32(_mm_slli_epi32(y,16),_mm_madd_epi16(y,_mm_setr_epi16(10773,16384,10773,16384,10773,16384,10773,16384)));
+	
+	/* Extract 65536*Cr from the high halves of the (Cb, Cr) pairs: */
+	__m128i cr16=_mm_and_si128(c,_mm_set1_epi32(int(0xffff0000U)));
+	
+	/* Calculate the three color components: */
+	r=_mm_add_epi32(_mm_add_epi32(yTerm,_mm_slli_epi32(cr16,1)),_mm_madd_epi16(c,_mm_setr_epi16(0,-26475,0,-26475,0,-26475,0,-26475)));
+	g=_mm_add_epi32(_mm_sub_epi32(yTerm,cr16),_mm_madd_epi16(c,_mm_setr_epi16(-25675,12257,-25675,12257,-25675,12257,-25675,12257)));
+	b=_mm_add_epi32(_mm_add_epi32(yTerm,_mm_slli_epi32(c,17)),_mm_madd_epi16(c,_mm_setr_epi16(1130,0,1130,0,1130,0,1130,0)));
+	r=_mm_srai_epi32(r,16);
+	g=_mm_srai_epi32(g,16);
+	b=_mm_srai_epi32(b,16);
+	}
+
+inline void convertYpCbCr8(__m128i yp,__m128i cbcr,__m128i& r,__m128i& g,__m128i& b) // Converts eight pixels from 16-bit Y' values and four 16-bit (Cb, Cr) pairs to 16-bit RGB
+	{
+	/* Remove the Y' and Cb/Cr offsets: */
+	yp=_mm_sub_epi16(yp,_mm_set1_epi16(16));
+	cbcr=_mm_sub_epi16(cbcr,_mm_set1_epi16(128));
+	
+	/* Convert the low and high four pixels and pack the results: */
+	__m128i r0,g0,b0,r1,g1,b1;
+	convertYpCbCr(yp,cbcr,r0,g0,b0,0);
+	convertYpCbCr(yp,cbcr,r1,g1,b1,1);
+	r=_mm_packs_epi32(r0,r1);
+	g=_mm_packs_epi32(g0,g1);
+	b=_mm_packs_epi32(b0,b1);
+	}
+
+inline __m128i compactRgbx(__m128i rgbx) // Removes the padding bytes from four 32-bit RGBx pixels, leaving twelve bytes of RGB in the low part of the result
+	{
+	/* Compact each pair of pixels into six bytes inside their 64-bit half: */
+	__m128i lo=_mm_and_si128(rgbx,_mm_set_epi32(0,0x00ffffff,0,0x00ffffff));
+	__m128i hi=_mm_and_si128(_mm_srli_epi64(rgbx,8),_mm_set_epi32(0x0000ffff,int(0xff000000U),0x0000ffff,int(0xff000000U)));
+	__m128i pairs=_mm_or_si128(lo,hi);
+	
+	/* Move the upper six bytes next to the lower six bytes: */
+	return _mm_or_si128(_mm_and_si128(pairs,_mm_set_epi32(0,0,0x0000ffff,int(0xffffffffU))),_mm_srli_si128(_mm_and_si128(pairs,_mm_set_epi32(0x0000ffff,int(0xffffffffU),0,0)),2));
+	}
+
+inline void storeRgb(__m128i r,__m128i g,__m128i b,unsigned char* rgb) // Interleaves sixteen 8-bit RGB pixels and stores them as 48 consecutive bytes
+	{
+	/* Interleave the components into four vectors of four 32-bit RGBx pixels each: */
+	__m128i zero=_mm_setzero_si128();
+	__m128i rgLo=_mm_unpacklo_epi8(r,g);
+	__m128i rgHi=_mm_unpackhi_epi8(r,g);
+	__m128i bxLo=_mm_unpacklo_epi8(b,zero);
+	__m128i bxHi=_mm_unpackhi_epi8(b,zero);
+	__m128i p0=compactRgbx(_mm_unpacklo_epi16(rgLo,bxLo));
+	__m128i p1=compactRgbx(_mm_unpackhi_epi16(rgLo,bxLo));
+	__m128i p2=compactRgbx(_mm_unpacklo_epi16(rgHi,bxHi));
+	__m128i p3=compactRgbx(_mm_unpackhi_epi16(rgHi,bxHi));
+	
+	/* Concatenate the four groups of twelve bytes into three vectors: */
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(rgb),_mm_or_si128(p0,_mm_slli_si128(p1,12)));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(rgb+16),_mm_or_si128(_mm_srli_si128(p1,4),_mm_slli_si128(p2,8)));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(rgb+32),_mm_or_si128(_mm_srli_si128(p2,8),_mm_slli_si128(p3,4)));
+	}
+
+inline __m128i load(const unsigned char* ptr)
+	{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+	}
+
+inline __m128i avg4(__m128i v1,__m128i v2,__m128i v3,__m128i v4) // Calculates the rounded averages of four vectors of sixteen 8-bit values
+	{
+	__m128i zero=_mm_setzero_si128();
+	__m128i two=_mm_set1_epi16(2);
+	__m128i lo=_mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(v1,zero),_mm_unpacklo_epi8(v2,zero)),_mm_add_epi16(_mm_unpacklo_epi8(v3,zero),_mm_unpacklo_epi8(v4,zero)));
+	__m128i hi=_mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(v1,zero),_mm_unpackhi_epi8(v2,zero)),_mm_add_epi16(_mm_unpackhi_epi8(v3,zero),_mm_unpackhi_epi8(v4,zero)));
+	return _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo,two),2),_mm_srli_epi16(_mm_add_epi16(hi,two),2));
+	}
+
+inline __m128i select(__m128i mask,__m128i v1,__m128i v2) // Selects bytes from the first vector where the mask is set, and from the second vector otherwise
+	{
+	return _mm_or_si128(_mm_and_si128(mask,v1),_mm_andnot_si128(mask,v2));
+	}
+
+inline void demosaicBayer16(const unsigned char* row,ptrdiff_t stride,bool primaryIsRed,__m128i primaryMask,__m128i& r,__m128i& g,__m128i& b) // Demosaics sixteen interior pixels of a Bayer-filtered row
+	{
+	/* Load the pixels and their eight neighbors: */
+	__m128i am=load(row-stride-1);
+	__m128i a0=load(row-stride);
+	__m128i ap=load(row-stride+1);
+	__m128i cm=load(row-1);
+	__m128i c0=load(row);
+	__m128i cp=load(row+1);
+	__m128i bm=load(row+stride-1);
+	__m128i b0=load(row+stride);
+	__m128i bp=load(row+stride+1);
+	
+	/* Calculate the primary, green, and secondary components for primary sites and green sites, and select per site: */
+	__m128i primary=select(primaryMask,c0,_mm_avg_epu8(cm,cp));
+	g=select(primaryMask,avg4(a0,cm,cp,b0),c0);
+	__m128i secondary=select(primaryMask,avg4(am,ap,bm,bp),_mm_avg_epu8(a0,b0));
+	
+	/* Assign the primary and secondary components to red and blue: */
+	if(primaryIsRed)
+		{
+		r=primary;
+		b=secondary;
+		}
+	else
+		{
+		r=secondary;
+		b=primary;
+		}
+	}
+
+inline __m128i rgbToGrey(__m128i r,__m128i g,__m128i b) // Converts sixteen RGB pixels to greyscale using the same weights as the scalar Bayer extractor
+	{
+	__m128i zero=_mm_setzero_si128();
+	__m128i one=_mm_set1_epi8(1);
+	__m128i rgWeights=_mm_setr_epi16(306,601,306,601,306,601,306,601);
+	__m128i b1Weights=_mm_setr_epi16(117,512,117,512,117,512,117,512);
+	
+	/* Interleave the components into (r, g) and (b, 1) pairs for 16-bit multiply-adds: */
+	__m128i rg=_mm_unpacklo_epi8(r,g);
+	__m128i b1=_mm_unpacklo_epi8(b,one);
+	__m128i v0=_mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(rg,zero),rgWeights),_mm_madd_epi16(_mm_unpacklo_epi8(b1,zero),b1Weights)),10);
+	__m128i v1=_mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi8(rg,zero),rgWeights),_mm_madd_epi16(_mm_unpackhi_epi8(b1,zero),b1Weights)),10);
+	rg=_mm_unpackhi_epi8(r,g);
+	b1=_mm_unpackhi_epi8(b,one);
+	__m128i v2=_mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(rg,zero),rgWeights),_mm_madd_epi16(_mm_unpacklo_epi8(b1,zero),b1Weights)),10);
+	__m128i v3=_mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi8(rg,zero),rgWeights),_mm_madd_epi16(_mm_unpackhi_epi8(b1,zero),b1Weights)),10);
+	return _mm_packus_epi16(_mm_packs_epi32(v0,v1),_mm_packs_epi32(v2,v3));
+	}
+
+#endif
+
+}
+
+void convertYpToGrey(const unsigned char* yp,unsigned int width,unsigned char* grey)
+	{
+	unsigned int x=0;
+	
+	#ifdef __SSE2__
+	
+	/* Convert blocks of sixteen pixels: */
+	for(;x+16<=width;x+=16)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(grey+x),ypToGrey(load(yp+x)));
+	
+	#endif
+	
+	/* Convert the remaining pixels: */
+	for(;x<width;++x)
+		grey[x]=ypToGrey(yp[x]);
+	}
+
+void convertYpCbCr422ToGrey(const unsigned char* row,YpCbCr422Layout layout,unsigned int width,unsigned char* grey)
+	{
+	unsigned int x=0;
+	
+	#ifdef __SSE2__
+	
+	/* Convert blocks of sixteen pixels: */
+	__m128i lowBytes=_mm_set1_epi16(0x00ff);
+	for(;x+16<=width;x+=16)
+		{
+		/* Extract the Y' values of sixteen pixels: */
+		__m128i raw0=load(row+x*2);
+		__m128i raw1=load(row+x*2+16);
+		__m128i yp;
+		if(layout==YPCBCR422_YUYV)
+			yp=_mm_packus_epi16(_mm_and_si128(raw0,lowBytes),_mm_and_si128(raw1,lowBytes));
+		else
+			yp=_mm_packus_epi16(_mm_srli_epi16(raw0,8),_mm_srli_epi16(raw1,8));
+		
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(grey+x),ypToGrey(yp));
+		}
+	
+	#endif
+	
+	/* Convert the remaining pixels: */
+	const unsigned char* ypPtr=row+x*2+(layout==YPCBCR422_YUYV?0:1);
+	for(;x<width;++x,ypPtr+=2)
+		grey[x]=ypToGrey(*ypPtr);
+	}
+
+void convertYpCbCr422ToRgb(const unsigned char* row,YpCbCr422Layout layout,unsigned int width,unsigned char* rgb)
+	{
+	unsigned int x=0;
+	
+	#ifdef __SSE2__
+	
+	/* Convert blocks of sixteen pixels: */
+	__m128i lowBytes=_mm_set1_epi16(0x00ff);
+	for(;x+16<=width;x+=16)
+		{
+		__m128i r[2],g[2],b[2];
+		for(int i=0;i<2;++i)
+			{
+			/* Split eight pixels into 16-bit Y' values and 16-bit (Cb, Cr) pairs: */
+			__m128i raw=load(row+x*2+i*16);
+			__m128i yp,cbcr;
+			if(layout==YPCBCR422_YUYV)
+				{
+				yp=_mm_and_si128(raw,lowBytes);
+				cbcr=_mm_srli_epi16(raw,8);
+				}
+			else
+				{
+				yp=_mm_srli_epi16(raw,8);
+				cbcr=_mm_and_si128(raw,lowBytes);
+				}
+			
+			convertYpCbCr8(yp,cbcr,r[i],g[i],b[i]);
+			}
+		
+		storeRgb(_mm_packus_epi16(r[0],r[1]),_mm_packus_epi16(g[0],g[1]),_mm_packus_epi16(b[0],b[1]),rgb+x*3);
+		}
+	
+	#endif
+	
+	/* Convert the remaining pairs of pixels: */
+	int ypIndex=layout==YPCBCR422_YUYV?0:1;
+	int cbIndex=layout==YPCBCR422_YUYV?1:0;
+	const unsigned char* rPtr=row+x*2;
+	unsigned char* cPtr=rgb+x*3;
+	for(;x<width;x+=2,rPtr+=4,cPtr+=2*3)
+		{
+		unsigned char ypcbcr[3];
+		ypcbcr[0]=rPtr[ypIndex];
+		ypcbcr[1]=rPtr[cbIndex];
+		ypcbcr[2]=rPtr[cbIndex+2];
+		ypcbcrToRgb(ypcbcr,cPtr);
+		ypcbcr[0]=rPtr[ypIndex+2];
+		ypcbcrToRgb(ypcbcr,cPtr+3);
+		}
+	}
+
+void convertYpCbCr420ToRgb(const unsigned char* yp,const unsigned char* cb,const unsigned char* cr,unsigned int width,unsigned char* rgb)
+	{
+	unsigned int x=0;
+	
+	#ifdef __SSE2__
+	
+	/* Convert blocks of sixteen pixels: */
+	__m128i zero=_mm_setzero_si128();
+	for(;x+16<=width;x+=16)
+		{
+		/* Load sixteen Y' values and eight Cb and Cr values each: */
+		__m128i ypv=load(yp+x);
+		__m128i cbcr=_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cb+x/2)),_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cr+x/2)));
+		
+		/* Convert the low and high eight pixels: */
+		__m128i r0,g0,b0,r1,g1,b1;
+		convertYpCbCr8(_mm_unpacklo_epi8(ypv,zero),_mm_unpacklo_epi8(cbcr,zero),r0,g0,b0);
+		convertYpCbCr8(_mm_unpackhi_epi8(ypv,zero),_mm_unpackhi_epi8(cbcr,zero),r1,g1,b1);
+		
+		storeRgb(_mm_packus_epi16(r0,r1),_mm_packus_epi16(g0,g1),_mm_packus_epi16(b0,b1),rgb+x*3);
+		}
+	
+	#endif
+	
+	/* Convert the remaining pairs of pixels: */
+	for(;x<width;x+=2)
+		{
+		unsigned char ypcbcr[3];
+		ypcbcr[0]=yp[x];
+		ypcbcr[1]=cb[x/2];
+		ypcbcr[2]=cr[x/2];
+		ypcbcrToRgb(ypcbcr,rgb+x*3);
+		ypcbcr[0]=yp[x+1];
+		ypcbcrToRgb(ypcbcr,rgb+x*3+3);
+		}
+	}
+
+unsigned int demosaicBayerRowToGrey(const unsigned char* row,ptrdiff_t stride,unsigned int width,bool primaryIsRed,bool firstIsPrimary,unsigned char* grey)
+	{
+	unsigned int x=0;
+	
+	#ifdef __SSE2__
+	
+	/* Convert blocks of sixteen pixels: */
+	__m128i primaryMask=_mm_set1_epi16(firstIsPrimary?0x00ff:short(0xff00));
+	for(;x+16<=width;x+=16)
+		{
+		__m128i r,g,b;
+		demosaicBayer16(row+x,stride,primaryIsRed,primaryMask,r,g,b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(grey+x),rgbToGrey(r,g,b));
+		}
+	
+	#endif
+	
+	return x;
+	}
+
+unsigned int demosaicBayerRowToRgb(const unsigned char* row,ptrdiff_t stride,unsigned int width,bool primaryIsRed,bool firstIsPrimary,unsigned char* rgb)
+	{
+	unsigned int x=0;
+	
+	#ifdef __SSE2__
+	
+	/* Convert blocks of sixteen pixels: */
+	__m128i primaryMask=_mm_set1_epi16(firstIsPrimary?0x00ff:short(0xff00));
+	for(;x+16<=width;x+=16)
+		{
+		__m128i r,g,b;
+		demosaicBayer16(row+x,stride,primaryIsRed,primaryMask,r,g,b);
+		storeRgb(r,g,b,rgb+x*3);
+		}
+	
+	#endif
+	
+	return x;
+	}
+
+}
@@ -0,0 +1,49 @@
+/***********************************************************************
+PixelConversion - Helper functions to convert rows of pixels from
+common raw video formats to greyscale or RGB, using SIMD instructions
+where available.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Basic Video Library (Video).
+
+The Basic Video Library is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License as published
+by the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+The Basic Video Library is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Basic Video Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef VIDEO_INTERNAL_PIXELCONVERSION_INCLUDED
+#define VIDEO_INTERNAL_PIXELCONVERSION_INCLUDED
+
+#include <stddef.h>
+
+namespace Video {
+
+enum YpCbCr422Layout // Enumerated type for byte orders of packed Y'CbCr 4:2:2 pixels
+	{
+	YPCBCR422_YUYV, // Y'0 Cb Y'1 Cr
+	YPCBCR422_UYVY // Cb Y'0 Cr Y'1
+	};
+
+/* All functions produce exactly the same results as the per-pixel conversions in Video/Colorspaces.h and the scalar extractors: */
+void convertYpToGrey(const unsigned char* yp,unsigned int width,unsigned char* grey); // Converts a row of Y' values to greyscale
+void convertYpCbCr422ToGrey(const unsigned char* row,YpCbCr422Layout layout,unsigned int width,unsigned char* grey); // Converts a row of packed Y'CbCr 4:2:2 pixels to greyscale; width must be even
+void convertYpCbCr422ToRgb(const unsigned char* row,YpCbCr422Layout layout,unsigned int width,unsigned char* rgb); // Converts a row of packed Y'CbCr 4:2:2 pixels to RGB; width must be even
+void convertYpCbCr420ToRgb(const unsigned char* yp,const unsigned char* cb,const unsigned char* cr,unsigned int width,unsigned char* rgb); // Converts a row of planar Y'CbCr 4:2:0 pixels to RGB; width must be even
+
+/* Functions to demosaic the interior of a row of a Bayer-filtered image; each row contains either red or blue sites, called primary sites, alternating with green sites: */
+unsigned int demosaicBayerRowToGrey(const unsigned char* row,ptrdiff_t stride,unsigned int width,bool primaryIsRed,bool firstIsPrimary,unsigned char* grey); // Converts pixels of a row starting at the given pixel, which must not be in the first or last row or column; returns the number of converted pixels, which is even
+unsigned int demosaicBayerRowToRgb(const unsigned char* row,ptrdiff_t stride,unsigned int width,bool primaryIsRed,bool firstIsPrimary,unsigned char* rgb); // Ditto, but converts to RGB
+
+}
+
+#endif
@@ -0,0 +1,305 @@
+/***********************************************************************
+TrackerStateCodec - Class to send tracker states in compressed form, as
+quantized differences against the states most recently sent to the same
+receiver.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Vrui/Internal/TrackerStateCodec.h>
+
+#include <string.h>
+#include <math.h>
+#include <Misc/ThrowStdErr.h>
+#include <IO/File.h>
+
+namespace Vrui {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+/* Flags sent with each tracker state: */
+const Misc::UInt8 validFlag=0x01U; // Tracker state is valid
+const int droppedComponentShift=1; // Position of the two-bit index of the quaternion component that was dropped
+const Misc::UInt8 linearVelocityFlag=0x08U; // Tracker state has non-zero linear velocity
+const Misc::UInt8 angularVelocityFlag=0x10U; // Tracker state has non-zero angular velocity
+
+const float orientationScale=float(32767.0*M_SQRT2); // Scale factor to map quaternion components in [-sqrt(1/2), sqrt(1/2)] to signed 16-bit integers
+
+inline void writeVarInt(Misc::UInt32 value,IO::File& sink) // Writes an unsigned integer in 7-bit groups, low-order group first
+	{
+	while(value>=0x80U)
+		{
+		sink.write<Misc::UInt8>(Misc::UInt8(value|0x80U));
+		value>>=7;
+		}
+	sink.write<Misc::UInt8>(Misc::UInt8(value));
+	}
+
+inline Misc::UInt32 readVarInt(IO::File& source) // Reads an unsigned integer written by writeVarInt
+	{
+	Misc::UInt32 result=0U;
+	for(int shift=0;shift<35;shift+=7)
+		{
+		Misc::UInt32 byte=source.read<Misc::UInt8>();
+		result|=(byte&0x7fU)<<shift;
+		if((byte&0x80U)==0U)
+			return result;
+		}
+	Misc::throwStdErr("Vrui::TrackerStateCodec: Malformed integer");
+	return result;
+	}
+
+inline void writeDelta(Misc::UInt32 value,Misc::UInt32& reference,IO::File& sink) // Writes the wrapped difference between the given value and the reference value, and updates the reference value
+	{
+	/* Map the signed difference to an unsigned integer with small magnitude for small positive or negative differences: */
+	Misc::SInt32 delta=Misc::SInt32(value-reference);
+	writeVarInt((Misc::UInt32(delta)<<1)^Misc::UInt32(delta>>31),sink);
+	reference=value;
+	}
+
+inline Misc::UInt32 readDelta(Misc::UInt32& reference,IO::File& source) // Reads a difference written by writeDelta and applies it to the reference value
+	{
+	Misc::UInt32 zigZag=readVarInt(source);
+	reference+=(zigZag>>1)^(0U-(zigZag&0x1U));
+	return reference;
+	}
+
+Misc::UInt16 floatToHalf(float value) // Converts a single-precision floating-point number to half precision, rounding to nearest
+	{
+	Misc::UInt32 bits;
+	memcpy(&bits,&value,sizeof(Misc::UInt32));
+	Misc::UInt32 sign=(bits>>16)&0x8000U;
+	int exponent=int((bits>>23)&0xffU)-127+15;
+	Misc::UInt32 mantissa=bits&0x7fffffU;
+	
+	/* Handle infinities, NaNs, and overflows: */
+	if(exponent>=31)
+		return Misc::UInt16(sign|0x7c00U|((bits&0x7f800000U)==0x7f800000U&&mantissa!=0U?0x200U:0x0U));
+	
+	/* Handle numbers that become denormalized or underflow: */
+	if(exponent<=0)
+		{
+		if(exponent<-10)
+			return Misc::UInt16(sign);
+		mantissa|=0x800000U;
+		int shift=14-exponent;
+		Misc::UInt32 result=mantissa>>shift;
+		if(mantissa&(0x1U<<(shift-1)))
+			++result;
+		return Misc::UInt16(sign|result);
+		}
+	
+	/* Assemble a normalized number; a carry out of the rounded mantissa correctly increments the exponent: */
+	Misc::UInt32 result=sign|(Misc::UInt32(exponent)<<10)|(mantissa>>13);
+	if(mantissa&0x1000U)
+		++result;
+	return Misc::UInt16(result);
+	}
+
+float halfToFloat(Misc::UInt16 value) // Converts a half-precision floating-point number to single precision
+	{
+	Misc::UInt32 sign=Misc::UInt32(value&0x8000U)<<16;
+	Misc::UInt32 exponent=(value>>10)&0x1fU;
+	Misc::UInt32 mantissa=value&0x3ffU;
+	
+	if(exponent==0U)
+		{
+		/* Convert a zero or denormalized number: */
+		float result=ldexpf(float(mantissa),-24);
+		return sign!=0U?-result:result;
+		}
+	
+	Misc::UInt32 bits;
+	if(exponent==31U)
+		bits=sign|0x7f800000U|(mantissa<<13); // Infinity or NaN
+	else
+		bits=sign|((exponent-15U+127U)<<23)|(mantissa<<13);
+	float result;
+	memcpy(&result,&bits,sizeof(float));
+	return result;
+	}
+
+template <class VectorParam>
+inline void writeHalfVector(const VectorParam& vector,IO::File& sink) // Writes a 3D vector in half precision
+	{
+	for(int i=0;i<3;++i)
+		sink.write<Misc::UInt16>(floatToHalf(vector[i]));
+	}
+
+template <class VectorParam>
+inline void readHalfVector(IO::File& source,VectorParam& vector) // Reads a 3D vector in half precision
+	{
+	for(int i=0;i<3;++i)
+		vector[i]=halfToFloat(source.read<Misc::UInt16>());
+	}
+
+}
+
+/**********************************
+Methods of class TrackerStateCodec:
+**********************************/
+
+TrackerStateCodec::TrackerStateCodec(int sNumTrackers,double sPositionQuantum)
+	:numTrackers(sNumTrackers),positionQuantum(sPositionQuantum),
+	 positions(new Misc::SInt32[numTrackers*3]),
+	 timeStamps(new VRDeviceState::TimeStamp[numTrackers])
+	{
+	/* Check the position quantum: */
+	if(!(positionQuantum>0.0))
+		{
+		delete[] positions;
+		delete[] timeStamps;
+		Misc::throwStdErr("Vrui::TrackerStateCodec: Invalid position quantum %g",positionQuantum);
+		}
+	
+	/* Initialize the reference states: */
+	reset();
+	}
+
+TrackerStateCodec::~TrackerStateCodec(void)
+	{
+	delete[] positions;
+	delete[] timeStamps;
+	}
+
+void TrackerStateCodec::reset(void)
+	{
+	/* Reset all reference positions and time stamps to zero: */
+	for(int i=0;i<numTrackers*3;++i)
+		positions[i]=0;
+	for(int i=0;i<numTrackers;++i)
+		timeStamps[i]=0;
+	}
+
+void TrackerStateCodec::writeTracker(int trackerIndex,const VRDeviceState& state,IO::File& sink)
+	{
+	const VRDeviceState::TrackerState& ts=state.getTrackerState(trackerIndex);
+	
+	/* Find the quaternion component with the largest magnitude, which will be reconstructed from the other three: */
+	const float* q=ts.positionOrientation.getRotation().getQuaternion();
+	int dropped=0;
+	for(int i=1;i<4;++i)
+		if(fabsf(q[dropped])<fabsf(q[i]))
+			dropped=i;
+	
+	/* Assemble the flags: */
+	Misc::UInt8 flags=Misc::UInt8(dropped<<droppedComponentShift);
+	if(state.getTrackerValid(trackerIndex))
+		flags|=validFlag;
+	if(ts.linearVelocity!=VRDeviceState::TrackerState::LinearVelocity::zero)
+		flags|=linearVelocityFlag;
+	if(ts.angularVelocity!=VRDeviceState::TrackerState::AngularVelocity::zero)
+		flags|=angularVelocityFlag;
+	
+	/* Write the tracker index and flags: */
+	sink.write<Misc::UInt16>(Misc::UInt16(trackerIndex));
+	sink.write<Misc::UInt8>(flags);
+	
+	/* Write the quantized position as differences against the previously sent position: */
+	const VRDeviceState::TrackerState::PositionOrientation::Vector& t=ts.positionOrientation.getTranslation();
+	Misc::SInt32* pos=positions+trackerIndex*3;
+	for(int i=0;i<3;++i)
+		{
+		double quantized=floor(double(t[i])/positionQuantum+0.5);
+		if(quantized<-2147483647.0)
+			quantized=-2147483647.0;
+		else if(quantized>2147483647.0)
+			quantized=2147483647.0;
+		Misc::UInt32 reference=Misc::UInt32(pos[i]);
+		writeDelta(Misc::UInt32(Misc::SInt32(quantized)),reference,sink);
+		pos[i]=Misc::SInt32(reference);
+		}
+	
+	/* Write the three smaller quaternion components, negating the quaternion if necessary so that the dropped component is positive: */
+	float sign=q[dropped]<0.0f?-1.0f:1.0f;
+	for(int i=0;i<4;++i)
+		if(i!=dropped)
+			sink.write<Misc::SInt16>(Misc::SInt16(floorf(q[i]*sign*orientationScale+0.5f)));
+	
+	/* Write the time stamp as difference against the previously sent time stamp: */
+	Misc::UInt32 reference=Misc::UInt32(timeStamps[trackerIndex]);
+	writeDelta(Misc::UInt32(state.getTrackerTimeStamp(trackerIndex)),reference,sink);
+	timeStamps[trackerIndex]=VRDeviceState::TimeStamp(reference);
+	
+	/* Write non-zero velocities in half precision: */
+	if(flags&linearVelocityFlag)
+		writeHalfVector(ts.linearVelocity,sink);
+	if(flags&angularVelocityFlag)
+		writeHalfVector(ts.angularVelocity,sink);
+	}
+
+int TrackerStateCodec::readTracker(IO::File& source,VRDeviceState& state)
+	{
+	/* Read the tracker index and flags: */
+	int trackerIndex=source.read<Misc::UInt16>();
+	if(trackerIndex>=numTrackers)
+		Misc::throwStdErr("Vrui::TrackerStateCodec: Invalid tracker index %d",trackerIndex);
+	Misc::UInt8 flags=source.read<Misc::UInt8>();
+	
+	/* Read the quantized position: */
+	VRDeviceState::TrackerState ts;
+	Misc::SInt32* pos=positions+trackerIndex*3;
+	VRDeviceState::TrackerState::PositionOrientation::Vector t;
+	for(int i=0;i<3;++i)
+		{
+		Misc::UInt32 reference=Misc::UInt32(pos[i]);
+		pos[i]=Misc::SInt32(readDelta(reference,source));
+		t[i]=float(double(pos[i])*positionQuantum);
+		}
+	
+	/* Read the three smaller quaternion components and reconstruct the dropped component: */
+	int dropped=(flags>>droppedComponentShift)&0x3;
+	float q[4];
+	float sqrSum=0.0f;
+	for(int i=0;i<4;++i)
+		if(i!=dropped)
+			{
+			q[i]=float(source.read<Misc::SInt16>())/orientationScale;
+			sqrSum+=q[i]*q[i];
+			}
+	q[dropped]=sqrSum<1.0f?sqrtf(1.0f-sqrSum):0.0f;
+	ts.positionOrientation=VRDeviceState::TrackerState::PositionOrientation(t,VRDeviceState::TrackerState::PositionOrientation::Rotation::fromQuaternion(q));
+	
+	/* Read the time stamp: */
+	Misc::UInt32 reference=Misc::UInt32(timeStamps[trackerIndex]);
+	timeStamps[trackerIndex]=VRDeviceState::TimeStamp(readDelta(reference,source));
+	
+	/* Read the velocities: */
+	if(flags&linearVelocityFlag)
+		readHalfVector(source,ts.linearVelocity);
+	else
+		ts.linearVelocity=VRDeviceState::TrackerState::LinearVelocity::zero;
+	if(flags&angularVelocityFlag)
+		readHalfVector(source,ts.angularVelocity);
+	else
+		ts.angularVelocity=VRDeviceState::TrackerState::AngularVelocity::zero;
+	
+	/* Update the device state: */
+	state.setTrackerState(trackerIndex,ts);
+	state.setTrackerTimeStamp(trackerIndex,timeStamps[trackerIndex]);
+	state.setTrackerValid(trackerIndex,(flags&validFlag)!=0x0U);
+	
+	return trackerIndex;
+	}
+
+}
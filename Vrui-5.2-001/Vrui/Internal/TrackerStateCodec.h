@@ -0,0 +1,68 @@
+/***********************************************************************
+TrackerStateCodec - Class to send tracker states in compressed form, as
+quantized differences against the states most recently sent to the same
+receiver.
+Copyright (c) 2020 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef VRUI_INTERNAL_TRACKERSTATECODEC_INCLUDED
+#define VRUI_INTERNAL_TRACKERSTATECODEC_INCLUDED
+
+#include <Misc/SizedTypes.h>
+#include <Vrui/Internal/VRDeviceState.h>
+
+/* Forward declarations: */
+namespace IO {
+class File;
+}
+
+namespace Vrui {
+
+class TrackerStateCodec
+	{
+	/* Elements: */
+	private:
+	int numTrackers; // Number of trackers whose states are sent
+	double positionQuantum; // Size of the grid to which tracker positions are quantized, in physical units
+	Misc::SInt32* positions; // Array of quantized tracker positions most recently sent to the receiver, three per tracker
+	VRDeviceState::TimeStamp* timeStamps; // Array of tracker time stamps most recently sent to the receiver
+	
+	/* Constructors and destructors: */
+	public:
+	TrackerStateCodec(int sNumTrackers,double sPositionQuantum); // Creates a codec for the given number of trackers and position quantum
+	private:
+	TrackerStateCodec(const TrackerStateCodec& source); // Prohibit copy constructor
+	TrackerStateCodec& operator=(const TrackerStateCodec& source); // Prohibit assignment operator
+	public:
+	~TrackerStateCodec(void);
+	
+	/* Methods: */
+	double getPositionQuantum(void) const // Returns the position quantum
+		{
+		return positionQuantum;
+		}
+	void reset(void); // Resets the reference states of all trackers; must be called on both ends whenever a receiver starts streaming
+	void writeTracker(int trackerIndex,const VRDeviceState& state,IO::File& sink); // Writes the given tracker's state, time stamp, and valid flag from the given device state to the given sink
+	int readTracker(IO::File& source,VRDeviceState& state); // Reads a tracker's state, time stamp, and valid flag from the given source into the given device state; returns the tracker's index
+	};
+
+}
+
+#endif
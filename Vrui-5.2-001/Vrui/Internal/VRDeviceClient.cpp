@@ -32,6 +32,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Realtime/Time.h>
 #include <Vrui/Internal/VRDeviceDescriptor.h>
 #include <Vrui/Internal/HMDConfiguration.h>
+#include <Vrui/Internal/TrackerStateCodec.h>
 
 #if DEBUG_PROTOCOL
 #include <iostream>
@@ -136,6 +137,49 @@ void* VRDeviceClient::streamReceiveThreadMethod(void)
 				/* Signal packet reception: */
 				packetSignalCond.broadcast();
 				
+				/* Invoke packet notification callback: */
+				if(packetNotificationCallback!=0)
+					(*packetNotificationCallback)(this);
+				}
+			else if(message==VRDevicePipe::STATE_UPDATE&&trackerStateCodec!=0)
+				{
+				/* Read a batch of compressed device state updates: */
+				{
+				Threads::Mutex::Lock stateLock(stateMutex);
+				
+				/* Read tracker states: */
+				unsigned int numTrackers=pipe.read<Misc::UInt16>();
+				for(unsigned int i=0;i<numTrackers;++i)
+					{
+					int trackerIndex=trackerStateCodec->readTracker(pipe,state);
+					if(!local)
+						state.setTrackerTimeStamp(trackerIndex,state.getTrackerTimeStamp(trackerIndex)+timeStampDelta);
+					}
+				
+				/* Read button states: */
+				unsigned int numButtons=pipe.read<Misc::UInt16>();
+				for(unsigned int i=0;i<numButtons;++i)
+					{
+					unsigned int buttonIndex=pipe.read<Misc::UInt16>();
+					state.setButtonState(buttonIndex,pipe.read<Misc::UInt8>()!=0U);
+					}
+				
+				/* Read valuator states: */
+				unsigned int numValuators=pipe.read<Misc::UInt16>();
+				for(unsigned int i=0;i<numValuators;++i)
+					{
+					unsigned int valuatorIndex=pipe.read<Misc::UInt16>();
+					state.setValuatorState(valuatorIndex,pipe.read<VRDeviceState::ValuatorState>());
+					}
+				
+				#if DEBUG_PROTOCOL
+				std::cout<<"Received STATE_UPDATE for "<<numTrackers<<" trackers, "<<numButtons<<" buttons, "<<numValuators<<" valuators"<<std::endl;
+				#endif
+				}
+				
+				/* Signal packet reception: */
+				packetSignalCond.broadcast();
+				
 				/* Invoke packet notification callback: */
 				if(packetNotificationCallback!=0)
 					(*packetNotificationCallback)(this);
@@ -355,11 +399,19 @@ void VRDeviceClient::initClient(void)
 		numPowerFeatures=pipe.read<Misc::UInt32>();
 		numHapticFeatures=pipe.read<Misc::UInt32>();
 		}
+	
+	/* Check if the server will send compressed state updates: */
+	if(serverProtocolVersionNumber>=9U)
+		{
+		/* Read the tracker position quantum and create a tracker state codec: */
+		double trackerPositionQuantum=pipe.read<Misc::Float64>();
+		trackerStateCodec=new TrackerStateCodec(state.getNumTrackers(),trackerPositionQuantum);
+		}
 	}
 
 VRDeviceClient::VRDeviceClient(const char* deviceServerName,int deviceServerPort)
 	:pipe(deviceServerName,deviceServerPort),
-	 serverProtocolVersionNumber(0),serverHasTimeStamps(false),
+	 serverProtocolVersionNumber(0),serverHasTimeStamps(false),trackerStateCodec(0),
 	 batteryStates(0),batteryStateUpdatedCallback(0),
 	 numHmdConfigurations(0),hmdConfigurations(0),hmdConfigurationUpdatedCallbacks(0),
 	 numPowerFeatures(0),numHapticFeatures(0),
@@ -371,7 +423,7 @@ VRDeviceClient::VRDeviceClient(const char* deviceServerName,int deviceServerPort
 
 VRDeviceClient::VRDeviceClient(const Misc::ConfigurationFileSection& configFileSection)
 	:pipe(configFileSection.retrieveString("./serverName").c_str(),configFileSection.retrieveValue<int>("./serverPort")),
-	 serverProtocolVersionNumber(0),serverHasTimeStamps(false),
+	 serverProtocolVersionNumber(0),serverHasTimeStamps(false),trackerStateCodec(0),
 	 batteryStates(0),batteryStateUpdatedCallback(0),
 	 numHmdConfigurations(0),hmdConfigurations(0),hmdConfigurationUpdatedCallbacks(0),
 	 numPowerFeatures(0),numHapticFeatures(0),
@@ -410,6 +462,9 @@ VRDeviceClient::~VRDeviceClient(void)
 	/* Delete battery states and HMD configurations: */
 	delete[] batteryStates;
 	delete[] hmdConfigurations;
+	
+	/* Delete the tracker state codec: */
+	delete trackerStateCodec;
 	}
 
 const HMDConfiguration& VRDeviceClient::getHmdConfiguration(unsigned int index) const
@@ -570,6 +625,10 @@ void VRDeviceClient::startStream(VRDeviceClient::Callback* newPacketNotification
 				(*batteryStateUpdatedCallback)(i);
 			}
 		
+		/* Reset the compressed tracker states; the server does the same when receiving the start streaming message: */
+		if(trackerStateCodec!=0)
+			trackerStateCodec->reset();
+		
 		/* Start the packet receiving thread: */
 		streamReceiveThread.start(this,&VRDeviceClient::streamReceiveThreadMethod);
 		
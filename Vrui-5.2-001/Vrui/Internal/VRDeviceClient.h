@@ -42,6 +42,7 @@ class ConfigurationFileSection;
 namespace Vrui {
 class VRDeviceDescriptor;
 class HMDConfiguration;
+class TrackerStateCodec;
 }
 
 namespace Vrui {
@@ -76,6 +77,7 @@ class VRDeviceClient
 	unsigned int serverProtocolVersionNumber; // Version number of server protocol
 	bool serverHasTimeStamps; // Flag whether the connected device server sends tracker state time stamps
 	bool serverHasValidFlags; // Flag whether the connected device server sends tracker valid flags
+	TrackerStateCodec* trackerStateCodec; // Codec to receive compressed tracker states if the server sends them; null otherwise
 	std::vector<VRDeviceDescriptor*> virtualDevices; // List of virtual input devices managed by the server
 	mutable Threads::Mutex stateMutex; // Mutex to serialize access to current state
 	VRDeviceState state; // Shadow of server's current state
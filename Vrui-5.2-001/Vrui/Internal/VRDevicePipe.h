@@ -1,7 +1,7 @@
 /***********************************************************************
 VRDevicePipe - Class defining the client-server protocol for remote VR
 devices and VR applications.
-Copyright (c) 2002-2018 Oliver Kreylos
+Copyright (c) 2002-2020 Oliver Kreylos
 
 This file is part of the Virtual Reality User Interface Library (Vrui).
 
@@ -54,7 +54,8 @@ class VRDevicePipe:public Comm::TCPPipe
 		HAPTICTICK_REQUEST, // Requests a haptic tick on a virtual input device
 		TRACKER_UPDATE, // Sends new state for a single tracker
 		BUTTON_UPDATE, // Sends new state for a single button
-		VALUATOR_UPDATE // Sends new state for a single valuator
+		VALUATOR_UPDATE, // Sends new state for a single valuator
+		STATE_UPDATE // Sends new states for a batch of trackers, buttons, and valuators, with tracker states in compressed form
 		};
 	
 	/* Constructors and destructors: */
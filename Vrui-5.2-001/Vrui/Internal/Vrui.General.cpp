@@ -692,6 +692,11 @@ void VruiState::initialize(const Misc::ConfigurationFileSection& configFileSecti
 		multiplexer->setPingTimeout(configFileSection.retrieveValue<double>("./multipipePingTimeout",10.0),configFileSection.retrieveValue<int>("./multipipePingRetries",3));
 		multiplexer->setReceiveWaitTimeout(configFileSection.retrieveValue<double>("./multipipeReceiveWaitTimeout",0.01));
 		multiplexer->setBarrierWaitTimeout(configFileSection.retrieveValue<double>("./multipipeBarrierWaitTimeout",0.01));
+		
+		/* Enable forward error correction on the main pipe if requested; all nodes read the same configuration: */
+		unsigned int multipipeFecGroupSize=configFileSection.retrieveValue<unsigned int>("./multipipeFecGroupSize",0);
+		if(multipipeFecGroupSize!=0)
+			pipe->setFecGroupSize(multipipeFecGroupSize);
 		}
 	
 	/* Create a Vrui-specific message logger: */